@@ -1151,6 +1151,7 @@ nvme_dump_tcp_statistics(struct spdk_nvme_transport_poll_group_stat *stat)
 	printf("\tnvme_completions:   %"PRIu64"\n", tcp_stat->nvme_completions);
 	printf("\tsubmitted_requests: %"PRIu64"\n", tcp_stat->submitted_requests);
 	printf("\tqueued_requests:    %"PRIu64"\n", tcp_stat->queued_requests);
+	printf("\tstriped_requests:   %"PRIu64"\n", tcp_stat->striped_requests);
 }
 
 static void
@@ -315,6 +315,7 @@ if [ $SPDK_RUN_FUNCTIONAL_TEST -eq 1 ]; then
 	if [ $SPDK_TEST_LVOL -eq 1 ]; then
 		run_test "lvol" $rootdir/test/lvol/lvol.sh
 		run_test "blob_io_wait" $rootdir/test/blobstore/blob_io_wait/blob_io_wait.sh
+		run_test "blob_thin_fill" $rootdir/test/blobstore/thin_fill/thin_fill.sh
 	fi
 
 	if [ $SPDK_TEST_VHOST_INIT -eq 1 ]; then
@@ -466,6 +466,42 @@ uint64_t spdk_bs_get_io_unit_size(struct spdk_blob_store *bs);
  */
 uint64_t spdk_bs_free_cluster_count(struct spdk_blob_store *bs);
 
+/**
+ * Find a range of free clusters.
+ *
+ * Clusters reserved by the I/O channels for thin provisioned blobs are not free.
+ *
+ * \param bs blobstore to query.
+ * \param start_cluster Cluster to start searching from.
+ * \param num_clusters Number of consecutive free clusters to find.
+ *
+ * \return the first cluster of the lowest free range at or after start_cluster,
+ * UINT64_MAX if there is no such range.
+ */
+uint64_t spdk_bs_find_free_clusters(struct spdk_blob_store *bs, uint64_t start_cluster,
+				    uint64_t num_clusters);
+
+/**
+ * Get the number of clusters saved by sharing clusters between blobs.
+ *
+ * Each additional blob referencing a shared cluster counts as one saved cluster.
+ *
+ * \param bs blobstore to query.
+ *
+ * \return the number of saved clusters.
+ */
+uint64_t spdk_bs_saved_cluster_count(struct spdk_blob_store *bs);
+
+/**
+ * Limit the bandwidth used to copy clusters from the backing device of a clone when
+ * the copy goes through host memory, i.e. for esnap clones and for devices that do
+ * not support the copy command. The limit applies to each I/O channel separately.
+ *
+ * \param bs blobstore.
+ * \param bytes_per_sec Maximum copy bandwidth in bytes per second, 0 for no limit.
+ */
+void spdk_bs_set_cow_bandwidth_limit(struct spdk_blob_store *bs, uint64_t bytes_per_sec);
+
 /**
  * Get the total number of clusters accessible by user.
  *
@@ -525,6 +561,38 @@ uint64_t spdk_blob_get_num_clusters(struct spdk_blob *blob);
  */
 uint64_t spdk_blob_get_num_allocated_clusters(struct spdk_blob *blob);
 
+/**
+ * Get the number of fragments of the blob.
+ *
+ * A fragment is a run of allocated clusters that follow each other both in the blob
+ * and on the device, unallocated clusters in between are skipped.
+ *
+ * \param blob Blob struct to query.
+ *
+ * \return the number of fragments, 0 if no cluster is allocated.
+ */
+uint64_t spdk_blob_get_num_fragments(struct spdk_blob *blob);
+
+/**
+ * Get the cluster on the device that backs a cluster of the blob.
+ *
+ * \param blob Blob struct to query.
+ * \param cluster_num Index of the cluster in the blob.
+ *
+ * \return the cluster on the device, UINT64_MAX if the cluster is not allocated.
+ */
+uint64_t spdk_blob_get_cluster_location(struct spdk_blob *blob, uint64_t cluster_num);
+
+/**
+ * Check if a cluster of the blob is shared with other blobs.
+ *
+ * \param blob Blob struct to query.
+ * \param cluster_num Index of the cluster in the blob.
+ *
+ * \return true if the cluster is allocated and other blobs reference it too.
+ */
+bool spdk_blob_is_cluster_shared(struct spdk_blob *blob, uint64_t cluster_num);
+
 /**
  * Get next allocated io_unit
  *
@@ -553,6 +621,24 @@ uint64_t spdk_blob_get_next_allocated_io_unit(struct spdk_blob *blob, uint64_t o
  */
 uint64_t spdk_blob_get_next_unallocated_io_unit(struct spdk_blob *blob, uint64_t offset);
 
+/**
+ * Get next cluster changed since an ancestor snapshot
+ *
+ * Starting at 'cluster_num', returns the first cluster allocated either to the blob
+ * or to one of the snapshots between the blob and the ancestor snapshot 'base_id'.
+ * The data of any other cluster reads the same from the blob and from 'base_id'.
+ * If 'base_id' is SPDK_BLOBID_INVALID, every cluster allocated in the lineage of the
+ * blob is returned.
+ *
+ * \param blob Blob struct to query.
+ * \param base_id The id of an ancestor snapshot of the blob or SPDK_BLOBID_INVALID.
+ * \param cluster_num Cluster to start from.
+ *
+ * \return cluster number or UINT64_MAX if no changed cluster found
+ */
+uint64_t spdk_blob_get_next_changed_cluster(struct spdk_blob *blob, spdk_blob_id base_id,
+		uint64_t cluster_num);
+
 struct spdk_blob_xattr_opts {
 	/* Number of attributes */
 	size_t	count;
@@ -597,8 +683,17 @@ struct spdk_blob_opts {
 	 * The size of data referenced by esnap_id, in bytes.
 	 */
 	uint64_t esnap_id_len;
+
+	/**
+	 * If not 0, copy-on-write of the blob is done in units of this many bytes instead of
+	 * whole clusters, so that a small write to a clone copies only the units it touches
+	 * from the parent. It must be a power of two, at least the io_unit size and smaller
+	 * than the cluster size, with at most 64 units in a cluster. Snapshots and clones
+	 * of the blob inherit it. Blobs using it cannot be opened by older versions.
+	 */
+	uint32_t cow_unit_size;
 };
-SPDK_STATIC_ASSERT(sizeof(struct spdk_blob_opts) == 80, "Incorrect size");
+SPDK_STATIC_ASSERT(sizeof(struct spdk_blob_opts) == 88, "Incorrect size");
 
 /**
  * Initialize a spdk_blob_opts structure to the default blob option values.
@@ -799,6 +894,22 @@ void spdk_bs_inflate_blob(struct spdk_blob_store *bs, struct spdk_io_channel *ch
 void spdk_bs_blob_decouple_parent(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
 				  spdk_blob_id blobid, spdk_blob_op_complete cb_fn, void *cb_arg);
 
+/**
+ * Complete the partially copied clusters of a blob.
+ *
+ * A blob created with a copy-on-write unit size copies only the units touched by a
+ * write into a newly allocated cluster, the rest of the cluster is read from the
+ * parent. This call copies the units still in the parent, the blob keeps its parent.
+ *
+ * \param bs blobstore.
+ * \param channel IO channel used to copy the data.
+ * \param blobid The id of the blob.
+ * \param cb_fn Called when the operation is complete.
+ * \param cb_arg Argument passed to function cb_fn.
+ */
+void spdk_bs_blob_cow_fill(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+			   spdk_blob_id blobid, spdk_blob_op_complete cb_fn, void *cb_arg);
+
 /**
  * Detach from parent blob without modifying data.
  *
@@ -840,6 +951,36 @@ int spdk_bs_blob_shallow_copy(struct spdk_blob_store *bs, struct spdk_io_channel
 			      spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
 			      spdk_blob_op_complete cb_fn, void *cb_arg);
 
+/**
+ * Copy the clusters of a blob changed since an ancestor snapshot to a blobstore device.
+ *
+ * Only the clusters returned by spdk_blob_get_next_changed_cluster() are read from
+ * the blob and written at the same offset on the device, so an incremental backup
+ * only transfers what changed between the two snapshots. Up to queue_depth clusters
+ * are copied at a time.
+ * Blob must be read only and blob size must be less or equal than device size.
+ * Blobstore block size must be a multiple of device block size.
+ *
+ * \param bs Blobstore
+ * \param channel IO channel used to copy the blob.
+ * \param blobid The id of the blob.
+ * \param base_blobid The id of an ancestor snapshot of the blob or SPDK_BLOBID_INVALID
+ * to copy every cluster allocated in the lineage of the blob.
+ * \param ext_dev The device to copy on
+ * \param queue_depth Maximum number of clusters copied at a time, 0 for the default.
+ * \param status_cb_fn Called repeatedly during operation with status updates
+ * \param status_cb_arg Argument passed to function status_cb_fn.
+ * \param cb_fn Called when the operation is complete.
+ * \param cb_arg Argument passed to function cb_fn.
+ *
+ * \return 0 if operation starts correctly, negative errno on failure.
+ */
+int spdk_bs_blob_diff_copy(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+			   spdk_blob_id blobid, spdk_blob_id base_blobid,
+			   struct spdk_bs_dev *ext_dev, uint32_t queue_depth,
+			   spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
+			   spdk_blob_op_complete cb_fn, void *cb_arg);
+
 
 /**
  * Set a snapshot as the parent of a blob
@@ -895,6 +1036,71 @@ void spdk_bs_snapshot_checksum(struct spdk_blob_store *bs, struct spdk_io_channe
 			       spdk_blob_id blob_id, const char *xattr_name,
 			       spdk_blob_op_complete cb_fn, void *cb_arg);
 
+/**
+ * Move a cluster of a blob to another location on the device.
+ *
+ * The data is copied to the destination cluster, the blob is updated to point at it
+ * and the old cluster is released. I/O to the blob is held back while the cluster is
+ * moved. Clusters of snapshots can be moved too, their clones follow the snapshot.
+ *
+ * \param bs Blobstore.
+ * \param blobid Id of the blob.
+ * \param cluster_num Index of the cluster in the blob, it must be allocated.
+ * \param dst_cluster Cluster on the device to move to, it must be free.
+ * \param cb_fn Called when the operation is complete. -EBUSY is reported if another
+ * operation is in progress on the blob or if dst_cluster is in use, -EPERM if the
+ * cluster is shared with other blobs.
+ * \param cb_arg Argument passed to function cb_fn.
+ */
+void spdk_bs_blob_move_cluster(struct spdk_blob_store *bs, spdk_blob_id blobid,
+			       uint64_t cluster_num, uint64_t dst_cluster,
+			       spdk_blob_op_complete cb_fn, void *cb_arg);
+
+/**
+ * Compute a fingerprint of the data of an allocated cluster of the blob.
+ *
+ * The fingerprint is a crc64 iso reflected checksum of the cluster. Clusters with
+ * different fingerprints hold different data, clusters with the same fingerprint
+ * likely hold the same data.
+ *
+ * \param bs Blobstore.
+ * \param channel I/O channel used to read the cluster.
+ * \param blobid Id of the blob.
+ * \param cluster_num Index of the cluster in the blob.
+ * \param fingerprint Filled in with the fingerprint once the operation is complete.
+ * \param cb_fn Called when the operation is complete. -EINVAL is reported if the
+ * cluster is not allocated.
+ * \param cb_arg Argument passed to function cb_fn.
+ */
+void spdk_bs_blob_cluster_fingerprint(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+				      spdk_blob_id blobid, uint64_t cluster_num, uint64_t *fingerprint,
+				      spdk_blob_op_complete cb_fn, void *cb_arg);
+
+/**
+ * Make a cluster of a blob share the cluster of another blob that holds the same data.
+ *
+ * The data of both clusters is compared first. If it is the same, the blob is updated
+ * to reference the cluster of src_blobid and its own cluster is released. A write to a
+ * shared cluster copies it first, so the blobs never see each other's changes. Both
+ * blobs must be thin provisioned or read-only, since writing to a shared cluster needs
+ * a new one. Once a cluster has been shared, the blobstore can't be loaded by versions
+ * of SPDK that don't support shared clusters.
+ *
+ * \param bs Blobstore.
+ * \param blobid Id of the blob whose cluster is released.
+ * \param cluster_num Index of the cluster in the blob, it must be allocated.
+ * \param src_blobid Id of the blob whose cluster is shared, it may be the same blob.
+ * \param src_cluster_num Index of the cluster in src_blobid, it must be allocated.
+ * \param cb_fn Called when the operation is complete. -EILSEQ is reported if the data
+ * differs, -EPERM if a blob is thick provisioned or the cluster is still partially in
+ * the parent, -EBUSY if another operation is in progress on one of the blobs.
+ * \param cb_arg Argument passed to function cb_fn.
+ */
+void spdk_bs_blob_share_cluster(struct spdk_blob_store *bs, spdk_blob_id blobid,
+				uint64_t cluster_num, spdk_blob_id src_blobid,
+				uint64_t src_cluster_num, spdk_blob_op_complete cb_fn,
+				void *cb_arg);
+
 struct spdk_blob_open_opts {
 	enum blob_clear_method  clear_method;
 
@@ -34,6 +34,26 @@ struct spdk_file_stat {
 	uint64_t	size;
 };
 
+/**
+ * Statistics of the file sync requests of a filesystem.
+ *
+ * Sync requests on a file that are covered by the same metadata update are
+ * completed together, so num_syncs / num_md_syncs is the average batch size.
+ */
+struct spdk_fs_sync_stats {
+	/** Number of sync requests completed by a metadata update. */
+	uint64_t	num_syncs;
+	/** Number of metadata updates issued to complete sync requests. */
+	uint64_t	num_md_syncs;
+	/** Largest number of sync requests completed by a single metadata update. */
+	uint64_t	max_batch_size;
+	/** Sync latency percentiles in microseconds. */
+	uint64_t	latency_p50_us;
+	uint64_t	latency_p99_us;
+	uint64_t	latency_p999_us;
+	uint64_t	max_latency_us;
+};
+
 /**
  * Filesystem operation completion callback with handle.
  *
@@ -335,7 +355,8 @@ int64_t spdk_file_read(struct spdk_file *file, struct spdk_fs_thread_ctx *ctx,
 /**
  * Set cache size for the blobstore filesystem.
  *
- * \param size_in_mb Cache size in megabytes.
+ * \param size_in_mb Cache size in megabytes. The cache must hold at least one
+ * cache buffer.
  *
  * \return 0 on success, negative errno on failure.
  */
@@ -348,6 +369,27 @@ int spdk_fs_set_cache_size(uint64_t size_in_mb);
  */
 uint64_t spdk_fs_get_cache_size(void);
 
+/**
+ * Set the size of a single cache buffer for the blobstore filesystem.
+ *
+ * Larger buffers let long sequential streams, such as RocksDB compaction
+ * reads, move more data per blob I/O. Like the cache size, this can only be
+ * changed while the cache is not allocated.
+ *
+ * \param size_in_kb Cache buffer size in kilobytes. Must be a power of two
+ * between 64 and 16384, and no larger than the cache size.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_fs_set_cache_buffer_size(uint32_t size_in_kb);
+
+/**
+ * Obtain the cache buffer size.
+ *
+ * \return cache buffer size in kilobytes.
+ */
+uint32_t spdk_fs_get_cache_buffer_size(void);
+
 #define SPDK_FILE_PRIORITY_LOW	0 /* default */
 #define SPDK_FILE_PRIORITY_HIGH	1
 
@@ -369,6 +411,14 @@ void spdk_file_set_priority(struct spdk_file *file, uint32_t priority);
  */
 int spdk_file_sync(struct spdk_file *file, struct spdk_fs_thread_ctx *ctx);
 
+/**
+ * Get the statistics of the file sync requests of the filesystem.
+ *
+ * \param fs Blobstore filesystem.
+ * \param stats Filled with the statistics.
+ */
+void spdk_fs_get_sync_stats(struct spdk_filesystem *fs, struct spdk_fs_sync_stats *stats);
+
 /**
  * Get the unique ID for the file.
  *
@@ -469,6 +469,31 @@ int spdk_lvol_shallow_copy(struct spdk_lvol *lvol, struct spdk_bs_dev *ext_dev,
 			   spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
 			   spdk_lvol_op_complete cb_fn, void *cb_arg);
 
+/**
+ * Copy the clusters of a lvol changed since one of its snapshots on given bs_dev.
+ *
+ * Only the clusters that differ between the lvol and the base snapshot are written,
+ * at the same offset they have in the lvol, so a backup taken from a previous copy
+ * of the base is brought up to date with the lvol.
+ * Lvol must be read only and lvol size must be less or equal than bs_dev size.
+ *
+ * \param lvol Handle to lvol
+ * \param base Handle to an ancestor snapshot of the lvol, NULL to copy every cluster
+ * allocated in the lineage of the lvol.
+ * \param ext_dev The bs_dev to copy on. This is created on the given bdev by using
+ * spdk_bdev_create_bs_dev_ext() beforehand
+ * \param queue_depth Maximum number of clusters copied at a time, 0 for the default.
+ * \param status_cb_fn Called repeatedly during operation with status updates
+ * \param status_cb_arg Argument passed to function status_cb_fn.
+ * \param cb_fn Completion callback
+ * \param cb_arg Completion callback custom arguments
+ *
+ * \return 0 if operation starts correctly, negative errno on failure.
+ */
+int spdk_lvol_diff_copy(struct spdk_lvol *lvol, struct spdk_lvol *base, struct spdk_bs_dev *ext_dev,
+			uint32_t queue_depth, spdk_blob_shallow_copy_status status_cb_fn,
+			void *status_cb_arg, spdk_lvol_op_complete cb_fn, void *cb_arg);
+
 /**
  * Set a snapshot as the parent of a lvol
  *
@@ -531,6 +556,64 @@ void spdk_lvol_register_snapshot_checksum(struct spdk_lvol *snapshot, spdk_lvol_
 int
 spdk_lvol_get_snapshot_checksum(struct spdk_lvol *snapshot, uint64_t *checksum);
 
+/**
+ * Start defragmentation of a lvolstore.
+ *
+ * Clusters of the lvols are relocated in the background, so that the allocated
+ * clusters of each lvol are contiguous on the device in the order of the lvol's
+ * data. Lvols are visited one after the other, defragmentation stops once all of
+ * them have been visited. If defragmentation is already in progress, only the
+ * bandwidth limit is updated.
+ *
+ * Must be called on the lvolstore's thread.
+ *
+ * \param lvs Pointer to lvolstore.
+ * \param max_bw_mbps Maximum bandwidth used to copy clusters in MiB/s, 0 for no limit.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_lvs_defrag_start(struct spdk_lvol_store *lvs, uint64_t max_bw_mbps);
+
+/**
+ * Stop defragmentation of a lvolstore.
+ *
+ * A cluster that is being moved finishes moving in the background.
+ *
+ * \param lvs Pointer to lvolstore.
+ *
+ * \return 0 on success, -ENOENT if there is no defragmentation in progress.
+ */
+int spdk_lvs_defrag_stop(struct spdk_lvol_store *lvs);
+
+/**
+ * Start deduplication of a lvolstore.
+ *
+ * The allocated clusters of the thin provisioned lvols and of the snapshots are read
+ * in the background, one lvol after the other. A cluster that holds the same data as a
+ * cluster read earlier is shared with it and its own cluster is released. A write to a
+ * shared cluster copies it first. Deduplication stops once all lvols have been visited.
+ * If deduplication is already in progress, only the bandwidth limit is updated.
+ *
+ * Must be called on the lvolstore's thread.
+ *
+ * \param lvs Pointer to lvolstore.
+ * \param max_bw_mbps Maximum bandwidth used to read clusters in MiB/s, 0 for no limit.
+ *
+ * \return 0 on success, negative errno on failure.
+ */
+int spdk_lvs_dedup_start(struct spdk_lvol_store *lvs, uint64_t max_bw_mbps);
+
+/**
+ * Stop deduplication of a lvolstore.
+ *
+ * A cluster that is being read or shared finishes in the background.
+ *
+ * \param lvs Pointer to lvolstore.
+ *
+ * \return 0 on success, -ENOENT if there is no deduplication in progress.
+ */
+int spdk_lvs_dedup_stop(struct spdk_lvol_store *lvs);
+
 
 #ifdef __cplusplus
 }
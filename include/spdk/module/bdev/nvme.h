@@ -26,6 +26,12 @@ enum spdk_bdev_nvme_multipath_policy {
 enum spdk_bdev_nvme_multipath_selector {
 	BDEV_NVME_MP_SELECTOR_ROUND_ROBIN = 1,
 	BDEV_NVME_MP_SELECTOR_QUEUE_DEPTH,
+	/* Select the path with the lowest expected service time, estimated from the moving
+	 * average latency and the number of outstanding bytes of each path.
+	 */
+	BDEV_NVME_MP_SELECTOR_SERVICE_TIME,
+	/* Distribute I/Os across paths in proportion to their configured weights. */
+	BDEV_NVME_MP_SELECTOR_WEIGHTED_ROUND_ROBIN,
 };
 
 struct spdk_bdev_nvme_ctrlr_opts {
@@ -46,6 +52,12 @@ struct spdk_bdev_nvme_ctrlr_opts {
 
 	/* Set to true if multipath enabled */
 	bool multipath;
+
+	/**
+	 * Number of connections each I/O qpair of the controller is striped across.  Only
+	 * supported by the TCP transport.
+	 */
+	uint8_t num_io_connections;
 };
 
 /**
@@ -79,7 +91,8 @@ int spdk_bdev_nvme_create(struct spdk_nvme_transport_id *trid,
  *
  * \param name NVMe bdev name.
  * \param policy Multipath policy (active-passive or active-active).
- * \param selector Multipath selector (round_robin, queue_depth).
+ * \param selector Multipath selector (round_robin, queue_depth, service_time,
+ * weighted_round_robin).
  * \param rr_min_io Number of IO to route to a path before switching to another for round-robin.
  * \param cb_fn Function to be called back after completion.
  * \param cb_arg Argument passed to the callback function.
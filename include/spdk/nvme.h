@@ -590,6 +590,7 @@ struct spdk_nvme_tcp_stat {
 	uint64_t nvme_completions;
 	uint64_t submitted_requests;
 	uint64_t queued_requests;
+	uint64_t striped_requests;
 };
 
 struct spdk_nvme_transport_poll_group_stat {
@@ -1797,8 +1798,18 @@ struct spdk_nvme_io_qpair_opts {
 	 */
 	bool disable_pcie_sgl_merge;
 
-	/* Hole at bytes 67-71. */
-	uint8_t reserved67[5];
+	/**
+	 * Number of transport connections the I/O qpair is striped across.  Only
+	 * supported by the TCP transport, where each additional connection is a
+	 * separate NVMe I/O queue (consuming its own qid) hidden behind the
+	 * returned qpair.  Submitted requests are dispatched to the least loaded
+	 * connection.  Values of 0 and 1 both mean a single connection.  Other
+	 * transports ignore this option.  Default is 1.
+	 */
+	uint8_t num_connections;
+
+	/* Hole at bytes 68-71. */
+	uint8_t reserved68[4];
 };
 SPDK_STATIC_ASSERT(sizeof(struct spdk_nvme_io_qpair_opts) == 72, "Incorrect size");
 
@@ -63,6 +63,14 @@ struct spdk_nvmf_target_opts {
 	uint32_t	discovery_filter;
 	uint32_t	dhchap_digests;
 	uint32_t	dhchap_dhgroups;
+	/* Period of the per-poll group load sampling.  When non-zero, new qpairs are
+	 * placed on the least loaded poll group instead of the transport's choice. */
+	uint64_t	load_sample_period_us;
+	/* Period of the qpair rebalancer.  0 disables live qpair migration. */
+	uint64_t	rebalance_period_us;
+	/* Minimum load imbalance (in percent of the least loaded poll group) that
+	 * triggers a qpair migration. */
+	uint32_t	rebalance_threshold;
 };
 
 struct spdk_nvmf_transport_opts {
@@ -172,6 +180,14 @@ struct spdk_nvmf_poll_group_stat {
 	uint64_t pending_bdev_io;
 	/* NVMe IO commands completed (excludes admin commands) */
 	uint64_t completed_nvme_io;
+	/* Bytes transferred by the completed NVMe IO commands */
+	uint64_t completed_nvme_io_bytes;
+	/* io qpairs migrated into / out of this poll group by the rebalancer */
+	uint64_t migrated_in_qpairs;
+	uint64_t migrated_out_qpairs;
+	/* Reads served from / missed in the namespace read caches */
+	uint64_t read_cache_hits;
+	uint64_t read_cache_misses;
 };
 
 /**
@@ -979,6 +995,63 @@ int spdk_nvmf_subsystem_get_ana_state(struct spdk_nvmf_subsystem *subsystem,
 int spdk_nvmf_subsystem_set_ns_ana_group(struct spdk_nvmf_subsystem *subsystem,
 		uint32_t nsid, uint32_t anagrpid);
 
+/**
+ * QoS limits of the I/O of hosts to namespaces.
+ */
+enum spdk_nvmf_qos_limit_type {
+	/** Maximum read/write I/O per second, must be a multiple of 1000 */
+	SPDK_NVMF_QOS_RW_IOPS_MAX = 0,
+	/** Maximum read/write bytes per second */
+	SPDK_NVMF_QOS_RW_BPS_MAX,
+	/** Read/write I/O per second of a host that aren't held back by the limits shared with
+	 *  other hosts, must be a multiple of 1000 */
+	SPDK_NVMF_QOS_RW_IOPS_MIN,
+	/** Read/write bytes per second of a host that aren't held back by the limits shared
+	 *  with other hosts */
+	SPDK_NVMF_QOS_RW_BPS_MIN,
+	/** Keep last */
+	SPDK_NVMF_QOS_NUM_LIMITS
+};
+
+/**
+ * Set the QoS limits of the I/O of a host to a namespace of a subsystem.
+ *
+ * The limits are enforced by the poll groups before the I/O is submitted to the bdev and apply
+ * to the I/O of all the controllers of the host together.  Without a host, they apply to the
+ * I/O of all hosts together, and without a namespace, to the I/O to all namespaces together.
+ * An I/O has to be within all the limits matching it, unless it's within the minimum limits of
+ * its host, in which case it's only held back by the limits specific to the host.
+ *
+ * May only be performed on subsystems in the INACTIVE or PAUSED state.
+ *
+ * \param subsystem Subsystem to set the limits of.
+ * \param hostnqn NQN of the host the limits apply to, or NULL for all hosts.
+ * \param nsid Namespace the limits apply to, or 0 for all namespaces.
+ * \param limits Array of SPDK_NVMF_QOS_NUM_LIMITS limits indexed by enum
+ * spdk_nvmf_qos_limit_type, 0 meaning unlimited.  The minimum limits can only be set for a host.
+ * If all the limits are 0, the limits of the host and namespace are removed.
+ *
+ * \return 0 on success, negated errno on failure.
+ */
+int spdk_nvmf_subsystem_set_qos_limits(struct spdk_nvmf_subsystem *subsystem,
+				       const char *hostnqn, uint32_t nsid, const uint64_t *limits);
+
+/**
+ * Enable or disable the I/O telemetry of a subsystem.
+ *
+ * The poll groups count the I/O, bytes and errors of each host on each namespace and tally
+ * their latency in log2 histograms.  The statistics are summed up over the poll groups by the
+ * nvmf_subsystem_get_telemetry RPC.  Disabling the telemetry drops the statistics.
+ *
+ * May only be performed on subsystems in the INACTIVE or PAUSED state.
+ *
+ * \param subsystem Subsystem to enable or disable the telemetry of.
+ * \param enable Whether to collect the telemetry.
+ *
+ * \return 0 on success, negated errno on failure.
+ */
+int spdk_nvmf_subsystem_set_telemetry(struct spdk_nvmf_subsystem *subsystem, bool enable);
+
 /**
  * Sets the controller ID range for a subsystem.
  *
@@ -1060,8 +1133,16 @@ struct spdk_nvmf_ns_opts {
 	 * after namespace has been added object becomes invalid.
 	 */
 	const struct spdk_json_val *transport_specific;
+
+	/**
+	 * Size of the read cache of the namespace in MiB, shared out evenly between the poll
+	 * groups.  The cache assumes that the bdev is only modified through this namespace.
+	 *
+	 * 0 (cache disabled) if not specified.
+	 */
+	uint32_t read_cache_size_mb;
 } __attribute__((packed));
-SPDK_STATIC_ASSERT(sizeof(struct spdk_nvmf_ns_opts) == 72, "Incorrect size");
+SPDK_STATIC_ASSERT(sizeof(struct spdk_nvmf_ns_opts) == 76, "Incorrect size");
 
 /**
  * Get default namespace creation options.
@@ -89,7 +89,10 @@ struct spdk_nvmf_request {
 			uint8_t data_from_pool		: 1;
 			uint8_t dif_enabled		: 1;
 			uint8_t first_fused		: 1;
-			uint8_t rsvd			: 5;
+			uint8_t qos_admitted		: 1;
+			uint8_t telemetry		: 1;
+			uint8_t zcopy_cached		: 1;
+			uint8_t rsvd			: 2;
 		};
 	};
 	uint8_t				zcopy_phase; /* type enum spdk_nvmf_zcopy_phase */
@@ -98,6 +101,8 @@ struct spdk_nvmf_request {
 	union nvmf_c2h_msg		*rsp;
 	STAILQ_ENTRY(spdk_nvmf_request)	buf_link;
 	TAILQ_ENTRY(spdk_nvmf_request)	link;
+	/* Throttled requests wait for the QoS limits while still on qpair->outstanding */
+	TAILQ_ENTRY(spdk_nvmf_request)	qos_link;
 
 	/* Memory domain which describes payload in this request. If the bdev doesn't support memory
 	 * domains, bdev layer will do the necessary push or pull operation. */
@@ -127,8 +132,11 @@ struct spdk_nvmf_request {
 
 	/* Timeout tracked for connect and abort flows. */
 	uint64_t timeout_tsc;
+
+	/* Submission time of the I/O tracked by the subsystem telemetry */
+	uint64_t submit_tsc;
 };
-SPDK_STATIC_ASSERT(sizeof(struct spdk_nvmf_request) == 808, "Incorrect size");
+SPDK_STATIC_ASSERT(sizeof(struct spdk_nvmf_request) == 832, "Incorrect size");
 
 enum spdk_nvmf_qpair_state {
 	SPDK_NVMF_QPAIR_UNINITIALIZED = 0,
@@ -167,6 +175,10 @@ struct spdk_nvmf_qpair {
 
 	bool					connect_received;
 	bool					disconnect_started;
+	/* Set while the qpair is in flight between two poll groups */
+	bool					migrating;
+	/* A disconnect arrived while migrating, it is issued once the qpair has arrived */
+	bool					disconnect_deferred;
 
 	uint16_t				trace_id;
 
@@ -175,6 +187,11 @@ struct spdk_nvmf_qpair {
 
 	struct spdk_nvmf_qpair_auth		*auth;
 
+	/* Telemetry of the host in the poll group, valid while telemetry_gen matches the one of
+	 * the subsystem poll group */
+	struct nvmf_telemetry_host		*telemetry_host;
+	uint64_t				telemetry_gen;
+
 	struct {
 		/* Indicates whether numa.id is valid, needed for numa.id == 0 case */
 		uint32_t			id_valid : 1;
@@ -219,6 +236,29 @@ struct spdk_nvmf_poll_group {
 	/* Statistics */
 	struct spdk_nvmf_poll_group_stat		stat;
 
+	/* Samples the statistics above to compute the load of the poll group */
+	struct spdk_poller				*load_poller;
+	uint64_t					load_last_tsc;
+	uint64_t					load_last_io;
+	uint64_t					load_last_bytes;
+	uint64_t					load_iops;
+	uint64_t					load_bytes_per_sec;
+	uint64_t					load_latency_us;
+
+	/* Protected by mutex. Load score and io qpair count as of the last sample,
+	 * read by the target when placing and rebalancing qpairs. */
+	uint64_t					load;
+	uint32_t					load_io_qpairs;
+
+	/* Protected by mutex. Qpairs on their way into this poll group, which
+	 * isn't destroyed until they arrive and accepts no new ones once its
+	 * destruction has started. */
+	uint32_t					migrating_in_qpairs;
+	bool						destroying;
+
+	/* Resubmits the requests queued by the per host and namespace QoS */
+	struct spdk_poller				*qos_poller;
+
 	spdk_nvmf_poll_group_destroy_done_fn		destroy_cb_fn;
 	void						*destroy_cb_arg;
 
@@ -404,6 +444,24 @@ struct spdk_nvmf_transport_ops {
 	 */
 	int (*poll_group_poll)(struct spdk_nvmf_transport_poll_group *group);
 
+	/**
+	 * Detach an idle qpair from its poll group so that it can be moved to
+	 * another one.  Called on the thread of the current poll group.  Returns
+	 * -EBUSY if the qpair has any transport level work in flight.
+	 * This callback is optional; qpairs of transports that don't implement it
+	 * are never migrated.
+	 */
+	int (*poll_group_migrate_out)(struct spdk_nvmf_transport_poll_group *group,
+				      struct spdk_nvmf_qpair *qpair);
+
+	/**
+	 * Attach a qpair detached by poll_group_migrate_out to a new poll group.
+	 * Called on the thread of the new poll group.  On failure the qpair must be
+	 * left in a state in which poll_group_remove can be called on it.
+	 */
+	int (*poll_group_migrate_in)(struct spdk_nvmf_transport_poll_group *group,
+				     struct spdk_nvmf_qpair *qpair);
+
 	/*
 	 * Free the request without sending a response
 	 * to the originator. Release memory tied to this request.
@@ -560,6 +618,20 @@ spdk_nvmf_request_using_zcopy(const struct spdk_nvmf_request *req)
 	return req->zcopy_phase != NVMF_ZCOPY_PHASE_NONE;
 }
 
+/**
+ * Check if the request holds zcopy buffers that still have to be released with
+ * spdk_nvmf_request_zcopy_end(), either a bdev_io or lines of the namespace read cache.
+ *
+ * \param req The request.
+ *
+ * \return true if the buffers have to be released, false otherwise.
+ */
+static inline bool
+spdk_nvmf_request_zcopy_buffers_held(const struct spdk_nvmf_request *req)
+{
+	return req->zcopy_bdev_io != NULL || req->zcopy_cached;
+}
+
 /**
  * Remove the given qpair from the poll group.
  *
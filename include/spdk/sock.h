@@ -526,6 +526,16 @@ bool spdk_sock_is_ipv4(struct spdk_sock *sock);
  */
 bool spdk_sock_is_connected(struct spdk_sock *sock);
 
+/**
+ * Check whether the socket still holds data of asynchronous writes, either not written yet,
+ * or, with zero copy, written but not completed yet.
+ *
+ * \param sock Socket to check
+ *
+ * \return true if the socket has unsent data or false otherwise.
+ */
+bool spdk_sock_has_unsent_data(struct spdk_sock *sock);
+
 /**
  * Callback function for spdk_sock_group_add_sock().
  *
@@ -90,6 +90,8 @@ struct spdk_lvol_bs_dev_req {
 };
 
 struct spdk_lvs_degraded_lvol_set;
+struct spdk_lvs_defrag;
+struct spdk_lvs_dedup;
 
 struct spdk_lvol_store {
 	struct spdk_bs_dev		*bs_dev;
@@ -110,6 +112,13 @@ struct spdk_lvol_store {
 	spdk_bs_esnap_dev_create	esnap_bs_dev_create;
 	RB_HEAD(degraded_lvol_sets_tree, spdk_lvs_degraded_lvol_set)	degraded_lvol_sets_tree;
 	struct spdk_thread		*thread;
+	/* Defragmentation in progress, NULL if there is none */
+	struct spdk_lvs_defrag		*defrag;
+	/* Deduplication scan in progress, NULL if there is none */
+	struct spdk_lvs_dedup		*dedup;
+	/* Clusters read and clusters shared by deduplication since the lvol store was loaded */
+	uint64_t			dedup_scanned_clusters;
+	uint64_t			dedup_shared_clusters;
 };
 
 typedef TAILQ_HEAD(, freeze_range) lvol_freeze_range_tailq_t;
@@ -142,6 +151,11 @@ struct spdk_lvol {
 	 * Protected by spinlock.
 	 */
 	lvol_freeze_range_tailq_t	pending_freezed_ranges;
+
+	/* Set while the lvol store defragmentation works on this lvol */
+	bool				defrag_in_progress;
+	/* Number of clusters of this lvol relocated by defragmentation */
+	uint64_t			defrag_clusters_moved;
 };
 
 struct spdk_fragmap {
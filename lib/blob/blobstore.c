@@ -13,6 +13,7 @@
 #include "spdk/thread.h"
 #include "spdk/bit_array.h"
 #include "spdk/bit_pool.h"
+#include "spdk/barrier.h"
 #include "spdk/likely.h"
 #include "spdk/util.h"
 #include "spdk/string.h"
@@ -31,7 +32,12 @@ static int bs_register_md_thread(struct spdk_blob_store *bs);
 static int bs_unregister_md_thread(struct spdk_blob_store *bs);
 static void blob_close_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno);
 static void blob_insert_cluster_on_md_thread(struct spdk_blob *blob, uint32_t cluster_num,
-		uint64_t cluster, uint32_t extent, struct spdk_blob_md_page *page,
+		uint64_t cluster, uint32_t extent, uint64_t cow_units, uint64_t replaced_lba,
+		spdk_blob_op_complete cb_fn, void *cb_arg);
+static void blob_cow_claim_on_md_thread(struct spdk_blob *blob, struct spdk_blob_cow_claim *claim,
+					uint32_t cluster_num, uint64_t units,
+					spdk_blob_op_complete cb_fn, void *cb_arg);
+static void blob_cow_commit_on_md_thread(struct spdk_blob_cow_claim *claim, int bserrno,
 		spdk_blob_op_complete cb_fn, void *cb_arg);
 static void blob_free_cluster_on_md_thread(struct spdk_blob *blob, uint32_t cluster_num,
 		uint32_t extent_page, struct spdk_blob_md_page *page, spdk_blob_op_complete cb_fn, void *cb_arg);
@@ -154,12 +160,71 @@ bs_release_cluster(struct spdk_blob_store *bs, uint32_t cluster_num)
 	assert(spdk_bit_pool_is_allocated(bs->used_clusters, cluster_num) == true);
 	assert(bs->num_free_clusters < bs->total_clusters);
 
+	if (spdk_unlikely(bs->cluster_refs != NULL) &&
+	    cluster_num < bs->cluster_refs->num_clusters &&
+	    bs->cluster_refs->refs[cluster_num] != 0) {
+		/* Other blobs still reference the cluster */
+		SPDK_DEBUGLOG(blob, "Dropping reference to shared cluster %u\n", cluster_num);
+		bs->cluster_refs->refs[cluster_num]--;
+		bs->num_saved_clusters--;
+		return;
+	}
+
 	SPDK_DEBUGLOG(blob, "Releasing cluster %u\n", cluster_num);
 
 	spdk_bit_pool_free_bit(bs->used_clusters, cluster_num);
 	bs->num_free_clusters++;
 }
 
+/* Take one more reference to an allocated cluster, shared by several blobs from now on */
+static int
+bs_ref_cluster(struct spdk_blob_store *bs, uint32_t cluster_num)
+{
+	struct spdk_bs_cluster_refs *cluster_refs = bs->cluster_refs;
+	struct spdk_bs_cluster_refs *new_refs;
+
+	assert(spdk_spin_held(&bs->used_lock));
+	assert(cluster_num < bs->total_clusters);
+
+	if (cluster_refs == NULL || cluster_num >= cluster_refs->num_clusters) {
+		new_refs = calloc(1, sizeof(*new_refs) + bs->total_clusters * sizeof(new_refs->refs[0]));
+		if (new_refs == NULL) {
+			return -ENOMEM;
+		}
+		new_refs->num_clusters = bs->total_clusters;
+		if (cluster_refs != NULL) {
+			memcpy(new_refs->refs, cluster_refs->refs,
+			       cluster_refs->num_clusters * sizeof(cluster_refs->refs[0]));
+		}
+		/* I/O threads may still look at the old array */
+		new_refs->prev = cluster_refs;
+		bs->cluster_refs = new_refs;
+		cluster_refs = new_refs;
+	}
+
+	if (cluster_refs->refs[cluster_num] == UINT32_MAX) {
+		return -EMLINK;
+	}
+
+	cluster_refs->refs[cluster_num]++;
+	bs->num_saved_clusters++;
+
+	return 0;
+}
+
+static void
+bs_free_cluster_refs(struct spdk_blob_store *bs)
+{
+	struct spdk_bs_cluster_refs *cluster_refs;
+
+	while (bs->cluster_refs != NULL) {
+		cluster_refs = bs->cluster_refs;
+		bs->cluster_refs = cluster_refs->prev;
+		free(cluster_refs);
+	}
+	bs->num_saved_clusters = 0;
+}
+
 static int
 blob_insert_cluster(struct spdk_blob *blob, uint32_t cluster_num, uint64_t cluster)
 {
@@ -223,6 +288,130 @@ bs_allocate_cluster(struct spdk_blob *blob, uint32_t cluster_num,
 	return 0;
 }
 
+static void
+bs_channel_reserve_clusters(struct spdk_bs_channel *ch)
+{
+	struct spdk_blob_store *bs = ch->bs;
+	uint64_t batch;
+	uint32_t cluster, tmp, i, n;
+
+	assert(spdk_spin_held(&bs->used_lock));
+	assert(ch->num_reserved_clusters == 0);
+
+	/* Keep the batch small relative to what is left, so that reserves held by
+	 * idle channels do not make allocations on other channels fail early. */
+	batch = spdk_min(BS_CLUSTER_RESERVE_BATCH, bs->num_free_clusters / BS_CLUSTER_RESERVE_DIVISOR);
+	batch = spdk_max(batch, 1);
+
+	while (ch->num_reserved_clusters < batch) {
+		cluster = bs_claim_cluster(bs);
+		if (cluster == UINT32_MAX) {
+			break;
+		}
+		ch->reserved_clusters[ch->num_reserved_clusters++] = cluster;
+	}
+
+	/* Clusters are taken from the end of the reserve, keep the lowest one there
+	 * so that consecutive allocations stay in ascending order. */
+	n = ch->num_reserved_clusters;
+	for (i = 0; i < n / 2; i++) {
+		tmp = ch->reserved_clusters[i];
+		ch->reserved_clusters[i] = ch->reserved_clusters[n - 1 - i];
+		ch->reserved_clusters[n - 1 - i] = tmp;
+	}
+
+	__atomic_fetch_add(&bs->num_reserved_clusters, ch->num_reserved_clusters, __ATOMIC_RELAXED);
+}
+
+static void
+bs_channel_release_clusters(struct spdk_bs_channel *ch)
+{
+	struct spdk_blob_store *bs = ch->bs;
+	uint32_t i;
+
+	if (ch->num_reserved_clusters == 0) {
+		return;
+	}
+
+	spdk_spin_lock(&bs->used_lock);
+	for (i = 0; i < ch->num_reserved_clusters; i++) {
+		bs_release_cluster(bs, ch->reserved_clusters[i]);
+	}
+	spdk_spin_unlock(&bs->used_lock);
+
+	__atomic_fetch_sub(&bs->num_reserved_clusters, ch->num_reserved_clusters, __ATOMIC_RELAXED);
+	ch->num_reserved_clusters = 0;
+}
+
+static void
+bs_channel_release_clusters_iter(struct spdk_io_channel_iter *i)
+{
+	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
+	struct spdk_bs_channel *ch = spdk_io_channel_get_ctx(_ch);
+
+	bs_channel_release_clusters(ch);
+	spdk_for_each_channel_continue(i, 0);
+}
+
+/*
+ * Clusters reserved by the channels are reported as free.  Operations that need more
+ * clusters than are left in the pool return them from all of the channels and retry
+ * before failing with -ENOSPC.
+ */
+static bool
+bs_has_reserved_clusters(struct spdk_blob_store *bs)
+{
+	return __atomic_load_n(&bs->num_reserved_clusters, __ATOMIC_RELAXED) != 0;
+}
+
+/*
+ * Same as bs_allocate_cluster() with update_map == false, but the cluster is taken
+ * from the channel's reserve. used_lock is only taken to refill the reserve or to
+ * claim a metadata page for a new extent page.
+ */
+static int
+bs_channel_allocate_cluster(struct spdk_bs_channel *ch, struct spdk_blob *blob,
+			    uint32_t cluster_num, uint64_t *cluster, uint32_t *extent_page)
+{
+	struct spdk_blob_store *bs = blob->bs;
+	bool need_extent_page;
+
+	*extent_page = 0;
+	need_extent_page = blob->use_extent_table && *bs_cluster_to_extent_page(blob, cluster_num) == 0;
+
+	if (ch->num_reserved_clusters == 0 || need_extent_page) {
+		spdk_spin_lock(&bs->used_lock);
+		if (ch->num_reserved_clusters == 0) {
+			bs_channel_reserve_clusters(ch);
+			if (ch->num_reserved_clusters == 0) {
+				/* No more free clusters. Cannot satisfy the request */
+				spdk_spin_unlock(&bs->used_lock);
+				return -ENOSPC;
+			}
+		}
+		if (need_extent_page) {
+			/* Extent page shall never occupy md_page so start the search from 1 */
+			*extent_page = spdk_bit_array_find_first_clear(bs->used_md_pages, 1);
+			if (*extent_page == UINT32_MAX) {
+				/* No more free md pages. Cannot satisfy the request */
+				*extent_page = 0;
+				spdk_spin_unlock(&bs->used_lock);
+				return -ENOSPC;
+			}
+			bs_claim_md_page(bs, *extent_page);
+		}
+		spdk_spin_unlock(&bs->used_lock);
+	}
+
+	*cluster = ch->reserved_clusters[--ch->num_reserved_clusters];
+	__atomic_fetch_sub(&bs->num_reserved_clusters, 1, __ATOMIC_RELAXED);
+
+	SPDK_DEBUGLOG(blob, "Claiming cluster %" PRIu64 " for blob 0x%" PRIx64 "\n", *cluster,
+		      blob->id);
+
+	return 0;
+}
+
 static void
 blob_xattrs_init(struct spdk_blob_xattr_opts *xattrs)
 {
@@ -331,6 +520,9 @@ blob_alloc(struct spdk_blob_store *bs, spdk_blob_id id)
 	TAILQ_INIT(&blob->xattrs_internal);
 	TAILQ_INIT(&blob->pending_persists);
 	TAILQ_INIT(&blob->persists_to_complete);
+	TAILQ_INIT(&blob->pending_cluster_inserts);
+	TAILQ_INIT(&blob->cow_claims);
+	TAILQ_INIT(&blob->cow_claims_waiting);
 
 	return blob;
 }
@@ -368,6 +560,7 @@ blob_free(struct spdk_blob *blob)
 	free(blob->clean.clusters);
 	free(blob->active.pages);
 	free(blob->clean.pages);
+	free(blob->cow_units);
 
 	xattrs_free(&blob->xattrs);
 	xattrs_free(&blob->xattrs_internal);
@@ -682,6 +875,72 @@ blob_deserialize_xattr(struct spdk_blob *blob,
 	return 0;
 }
 
+static bool
+blob_cow_unit_size_valid(struct spdk_blob_store *bs, uint32_t unit_size)
+{
+	return spdk_u32_is_pow2(unit_size) && unit_size >= bs->io_unit_size &&
+	       unit_size < bs->cluster_sz && bs->cluster_sz % unit_size == 0 &&
+	       bs->cluster_sz / unit_size <= 64;
+}
+
+/* Make room for the copy-on-write unit masks of at least num_clusters clusters */
+static int
+blob_cow_units_resize(struct spdk_blob *blob, uint64_t num_clusters)
+{
+	uint64_t *tmp;
+
+	if (num_clusters <= blob->cow_units_array_size) {
+		return 0;
+	}
+
+	tmp = realloc(blob->cow_units, num_clusters * sizeof(*blob->cow_units));
+	if (tmp == NULL) {
+		return -ENOMEM;
+	}
+	memset(tmp + blob->cow_units_array_size, 0,
+	       (num_clusters - blob->cow_units_array_size) * sizeof(*blob->cow_units));
+	blob->cow_units = tmp;
+	blob->cow_units_array_size = num_clusters;
+
+	return 0;
+}
+
+static int
+blob_cow_units_enable(struct spdk_blob *blob, uint32_t unit_size)
+{
+	int rc;
+
+	if (!blob_cow_unit_size_valid(blob->bs, unit_size)) {
+		SPDK_ERRLOG("Invalid copy-on-write unit size %" PRIu32 " for cluster size %" PRIu32 "\n",
+			    unit_size, blob->bs->cluster_sz);
+		return -EINVAL;
+	}
+
+	rc = blob_cow_units_resize(blob, blob->active.cluster_array_size);
+	if (rc != 0) {
+		return rc;
+	}
+
+	blob->cow_unit_size = unit_size;
+	blob->invalid_flags |= SPDK_BLOB_COW_UNITS;
+
+	return 0;
+}
+
+/* Check whether some allocated cluster of the blob was not entirely copied from the parent */
+static bool
+blob_has_cow_units(struct spdk_blob *blob)
+{
+	uint64_t i;
+
+	for (i = 0; i < blob->active.num_clusters; i++) {
+		if (bs_cluster_cow_units(blob, i) != 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
 
 static int
 blob_parse_page(const struct spdk_blob_md_page *page, struct spdk_blob *blob)
@@ -876,9 +1135,8 @@ blob_parse_page(const struct spdk_blob_md_page *page, struct spdk_blob *blob)
 				return -EINVAL;
 			}
 
-			/* When reading extent pages sequentially starting cluster idx should match
-			 * current size of a blob.
-			 * If changed to batch reading, this check shall be removed. */
+			/* Extent pages are parsed in order, even if they are read in batches,
+			 * so starting cluster idx should match current size of a blob. */
 			if (desc_extent->start_cluster_idx != blob->active.num_clusters) {
 				return -EINVAL;
 			}
@@ -905,6 +1163,52 @@ blob_parse_page(const struct spdk_blob_md_page *page, struct spdk_blob *blob)
 			assert(desc_extent->start_cluster_idx + cluster_count == blob->active.num_clusters);
 			assert(blob->remaining_clusters_in_et >= cluster_count);
 			blob->remaining_clusters_in_et -= cluster_count;
+		} else if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_COW_UNITS) {
+			struct spdk_blob_md_descriptor_cow_units	*desc_cow_units;
+			unsigned int					i;
+			uint32_t					cluster_idx;
+			uint64_t					num_clusters;
+			size_t						clusters_length;
+			int						rc;
+
+			desc_cow_units = (struct spdk_blob_md_descriptor_cow_units *)desc;
+
+			if (desc_cow_units->length < sizeof(desc_cow_units->unit_size)) {
+				return -EINVAL;
+			}
+
+			clusters_length = desc_cow_units->length - sizeof(desc_cow_units->unit_size);
+			if (clusters_length % sizeof(desc_cow_units->clusters[0]) != 0) {
+				return -EINVAL;
+			}
+
+			if (!blob_cow_unit_size_valid(blob->bs, desc_cow_units->unit_size) ||
+			    (blob->cow_unit_size != 0 && blob->cow_unit_size != desc_cow_units->unit_size)) {
+				return -EINVAL;
+			}
+			blob->cow_unit_size = desc_cow_units->unit_size;
+
+			/* The units are serialized after the extents, so the size of the blob is
+			 * known by now.  Clusters of an extent table are loaded from its extent
+			 * pages later on. */
+			num_clusters = blob->active.num_clusters;
+			if (blob->extent_table_found) {
+				num_clusters += blob->remaining_clusters_in_et;
+			}
+
+			for (i = 0; i < clusters_length / sizeof(desc_cow_units->clusters[0]); i++) {
+				cluster_idx = desc_cow_units->clusters[i].cluster_idx;
+				if (cluster_idx >= num_clusters) {
+					return -EINVAL;
+				}
+
+				rc = blob_cow_units_resize(blob, (uint64_t)cluster_idx + 1);
+				if (rc != 0) {
+					return rc;
+				}
+				blob->cow_units[cluster_idx] = desc_cow_units->clusters[i].units &
+							       bs_cow_units_all(blob);
+			}
 		} else if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_XATTR) {
 			int rc;
 
@@ -1293,6 +1597,87 @@ blob_serialize_extent_page(const struct spdk_blob *blob,
 			      sizeof(desc_extent->cluster_idx[0]) * extent_idx;
 }
 
+static uint64_t blob_cow_units_to_persist(const struct spdk_blob *blob, uint64_t cluster_num);
+
+/* Returns false if there was no room for the descriptor in the buffer */
+static bool
+blob_serialize_cow_units_desc(const struct spdk_blob *blob,
+			      uint64_t start_cluster, uint64_t *next_cluster,
+			      uint8_t **buf, size_t *buf_sz)
+{
+	struct spdk_blob_md_descriptor_cow_units *desc;
+	size_t cur_sz;
+	uint64_t i, idx, units;
+
+	cur_sz = sizeof(struct spdk_blob_md_descriptor) + sizeof(desc->unit_size);
+	if (*buf_sz < cur_sz) {
+		*next_cluster = start_cluster;
+		return false;
+	}
+
+	desc = (struct spdk_blob_md_descriptor_cow_units *)*buf;
+	desc->type = SPDK_MD_DESCRIPTOR_TYPE_COW_UNITS;
+	desc->unit_size = blob->cow_unit_size;
+
+	idx = 0;
+	for (i = start_cluster; i < blob->active.num_clusters; i++) {
+		if (i >= blob->cow_units_array_size || blob->cow_units[i] == 0) {
+			continue;
+		}
+
+		units = blob_cow_units_to_persist(blob, i);
+		if (units == 0) {
+			continue;
+		}
+
+		if (*buf_sz < cur_sz + sizeof(desc->clusters[0])) {
+			/* If we ran out of buffer space, return */
+			break;
+		}
+
+		desc->clusters[idx].cluster_idx = i;
+		desc->clusters[idx].units = units;
+		idx++;
+		cur_sz += sizeof(desc->clusters[0]);
+	}
+	*next_cluster = i;
+
+	desc->length = sizeof(desc->unit_size) + sizeof(desc->clusters[0]) * idx;
+	*buf_sz -= cur_sz;
+	*buf += cur_sz;
+
+	return true;
+}
+
+static int
+blob_serialize_cow_units(const struct spdk_blob *blob,
+			 struct spdk_blob_md_page **pages,
+			 struct spdk_blob_md_page *cur_page,
+			 uint32_t *page_count, uint8_t **buf,
+			 size_t *remaining_sz)
+{
+	uint64_t	next_cluster = 0;
+	int		rc;
+
+	if (blob->cow_unit_size == 0) {
+		return 0;
+	}
+
+	/* The descriptor is written even if no cluster is partially copied, it holds the unit size */
+	while (!blob_serialize_cow_units_desc(blob, next_cluster, &next_cluster, buf, remaining_sz) ||
+	       next_cluster < blob->active.num_clusters) {
+		rc = blob_serialize_add_page(blob, pages, page_count, &cur_page);
+		if (rc < 0) {
+			return rc;
+		}
+
+		*buf = (uint8_t *)cur_page->descriptors;
+		*remaining_sz = sizeof(cur_page->descriptors);
+	}
+
+	return 0;
+}
+
 static void
 blob_serialize_flags(const struct spdk_blob *blob,
 		     uint8_t *buf, size_t *buf_sz)
@@ -1418,8 +1803,12 @@ blob_serialize(const struct spdk_blob *blob, struct spdk_blob_md_page **pages,
 		/* Serialize extents */
 		rc = blob_serialize_extents_rle(blob, pages, cur_page, page_count, &buf, &remaining_sz);
 	}
+	if (rc < 0) {
+		return rc;
+	}
 
-	return rc;
+	/* Serialize the state of partially copied clusters */
+	return blob_serialize_cow_units(blob, pages, cur_page, page_count, &buf, &remaining_sz);
 }
 
 struct spdk_blob_load_ctx {
@@ -1428,6 +1817,8 @@ struct spdk_blob_load_ctx {
 	struct spdk_blob_md_page	*pages;
 	uint32_t			num_pages;
 	uint32_t			next_extent_page;
+	/* End of the extent table range whose extent pages are being read */
+	uint32_t			extent_page_batch_end;
 	spdk_bs_sequence_t	        *seq;
 
 	spdk_bs_sequence_cpl		cb_fn;
@@ -1538,6 +1929,42 @@ blob_load_esnap(struct spdk_blob *blob, void *blob_ctx)
 	return 0;
 }
 
+/* Called once all clusters of the blob are known */
+static int
+blob_load_cow_units(struct spdk_blob *blob)
+{
+	uint64_t	i;
+	int		rc;
+
+	if (!(blob->invalid_flags & SPDK_BLOB_COW_UNITS)) {
+		free(blob->cow_units);
+		blob->cow_units = NULL;
+		blob->cow_units_array_size = 0;
+		blob->cow_unit_size = 0;
+		return 0;
+	}
+
+	if (blob->cow_unit_size == 0) {
+		SPDK_ERRLOG("Blob 0x%" PRIx64 " has no copy-on-write unit size\n", blob->id);
+		return -EINVAL;
+	}
+
+	rc = blob_cow_units_resize(blob, blob->active.num_clusters);
+	if (rc != 0) {
+		return rc;
+	}
+
+	/* The units of a cluster are persisted before the cluster itself, ignore the ones
+	 * of clusters that did not make it to disk. */
+	for (i = 0; i < blob->cow_units_array_size; i++) {
+		if (i >= blob->active.num_clusters || blob->active.clusters[i] == 0) {
+			blob->cow_units[i] = 0;
+		}
+	}
+
+	return 0;
+}
+
 static void
 blob_load_backing_dev(spdk_bs_sequence_t *seq, void *cb_arg)
 {
@@ -1547,6 +1974,12 @@ blob_load_backing_dev(spdk_bs_sequence_t *seq, void *cb_arg)
 	size_t				len;
 	int				rc;
 
+	rc = blob_load_cow_units(blob);
+	if (rc != 0) {
+		blob_load_final(ctx, rc);
+		return;
+	}
+
 	if (blob_is_esnap_clone(blob)) {
 		rc = blob_load_esnap(blob, seq->cpl.u.blob_handle.esnap_ctx);
 		blob_load_final(ctx, rc);
@@ -1576,17 +2009,48 @@ blob_load_backing_dev(spdk_bs_sequence_t *seq, void *cb_arg)
 	blob_load_final(ctx, 0);
 }
 
+/* Thin provisioned blobs can point to unallocated extent pages. In this case blob size
+ * should be increased by up to the amount left in remaining_clusters_in_et. */
+static int
+blob_load_unallocated_extent_page(struct spdk_blob *blob, uint32_t extent_page)
+{
+	void	*tmp;
+	uint64_t sz;
+
+	sz = spdk_min(blob->remaining_clusters_in_et, SPDK_EXTENTS_PER_EP);
+	blob->active.num_clusters += sz;
+	blob->remaining_clusters_in_et -= sz;
+
+	assert(spdk_blob_is_thin_provisioned(blob));
+	assert(extent_page + 1 < blob->active.num_extent_pages || blob->remaining_clusters_in_et == 0);
+
+	tmp = realloc(blob->active.clusters, blob->active.num_clusters * sizeof(*blob->active.clusters));
+	if (tmp == NULL) {
+		return -ENOMEM;
+	}
+	memset(tmp + sizeof(*blob->active.clusters) * blob->active.cluster_array_size, 0,
+	       sizeof(*blob->active.clusters) * (blob->active.num_clusters - blob->active.cluster_array_size));
+	blob->active.clusters = tmp;
+	blob->active.cluster_array_size = blob->active.num_clusters;
+
+	return 0;
+}
+
+/*
+ * Extent pages are read BS_LOAD_EXTENT_PAGES_BATCH at a time, but parsed in the order of
+ * the extent table, so that the blob grows one extent page after another.
+ */
 static void
 blob_load_cpl_extents_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
 	struct spdk_blob_load_ctx	*ctx = cb_arg;
 	struct spdk_blob		*blob = ctx->blob;
 	struct spdk_blob_md_page	*page;
+	spdk_bs_batch_t			*batch;
 	uint64_t			i;
+	uint32_t			num_pages;
 	uint32_t			crc;
 	uint64_t			lba;
-	void				*tmp;
-	uint64_t			sz;
 
 	if (bserrno) {
 		SPDK_ERRLOG("Extent page read failed: %d\n", bserrno);
@@ -1595,17 +2059,30 @@ blob_load_cpl_extents_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 	}
 
 	if (ctx->pages == NULL) {
-		/* First iteration of this function, allocate buffer for single EXTENT_PAGE */
-		ctx->pages = spdk_zmalloc(SPDK_BS_PAGE_SIZE, 0,
+		/* First iteration of this function, allocate buffer for a batch of EXTENT_PAGEs */
+		ctx->pages = spdk_zmalloc(SPDK_BS_PAGE_SIZE * BS_LOAD_EXTENT_PAGES_BATCH, 0,
 					  NULL, SPDK_ENV_NUMA_ID_ANY, SPDK_MALLOC_DMA);
 		if (!ctx->pages) {
 			blob_load_final(ctx, -ENOMEM);
 			return;
 		}
-		ctx->num_pages = 1;
+		ctx->num_pages = BS_LOAD_EXTENT_PAGES_BATCH;
 		ctx->next_extent_page = 0;
-	} else {
-		page = &ctx->pages[0];
+		ctx->extent_page_batch_end = 0;
+	}
+
+	num_pages = 0;
+	for (i = ctx->next_extent_page; i < ctx->extent_page_batch_end; i++) {
+		if (blob->active.extent_pages[i] == 0) {
+			bserrno = blob_load_unallocated_extent_page(blob, i);
+			if (bserrno) {
+				blob_load_final(ctx, bserrno);
+				return;
+			}
+			continue;
+		}
+
+		page = &ctx->pages[num_pages++];
 		crc = blob_md_page_calc_crc(page);
 		if (crc != page->crc) {
 			blob_load_final(ctx, -EINVAL);
@@ -1623,41 +2100,41 @@ blob_load_cpl_extents_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 			return;
 		}
 	}
+	ctx->next_extent_page = ctx->extent_page_batch_end;
 
-	for (i = ctx->next_extent_page; i < blob->active.num_extent_pages; i++) {
-		if (blob->active.extent_pages[i] != 0) {
-			/* Extent page was allocated, read and parse it. */
-			lba = bs_md_page_to_lba(blob->bs, blob->active.extent_pages[i]);
-			ctx->next_extent_page = i + 1;
-
-			bs_sequence_read_dev(seq, &ctx->pages[0], lba,
-					     bs_byte_to_lba(blob->bs, SPDK_BS_PAGE_SIZE),
-					     blob_load_cpl_extents_cpl, ctx);
-			return;
-		} else {
-			/* Thin provisioned blobs can point to unallocated extent pages.
-			 * In this case blob size should be increased by up to the amount left in remaining_clusters_in_et. */
+	if (ctx->next_extent_page == blob->active.num_extent_pages) {
+		blob_load_backing_dev(seq, ctx);
+		return;
+	}
 
-			sz = spdk_min(blob->remaining_clusters_in_et, SPDK_EXTENTS_PER_EP);
-			blob->active.num_clusters += sz;
-			blob->remaining_clusters_in_et -= sz;
+	/* Read the next batch of allocated extent pages all at once */
+	num_pages = 0;
+	for (i = ctx->next_extent_page; i < blob->active.num_extent_pages; i++) {
+		if (num_pages == BS_LOAD_EXTENT_PAGES_BATCH) {
+			break;
+		}
+		if (blob->active.extent_pages[i] != 0) {
+			num_pages++;
+		}
+	}
+	ctx->extent_page_batch_end = i;
 
-			assert(spdk_blob_is_thin_provisioned(blob));
-			assert(i + 1 < blob->active.num_extent_pages || blob->remaining_clusters_in_et == 0);
+	if (num_pages == 0) {
+		/* Only unallocated extent pages are left */
+		blob_load_cpl_extents_cpl(seq, ctx, 0);
+		return;
+	}
 
-			tmp = realloc(blob->active.clusters, blob->active.num_clusters * sizeof(*blob->active.clusters));
-			if (tmp == NULL) {
-				blob_load_final(ctx, -ENOMEM);
-				return;
-			}
-			memset(tmp + sizeof(*blob->active.clusters) * blob->active.cluster_array_size, 0,
-			       sizeof(*blob->active.clusters) * (blob->active.num_clusters - blob->active.cluster_array_size));
-			blob->active.clusters = tmp;
-			blob->active.cluster_array_size = blob->active.num_clusters;
+	batch = bs_sequence_to_batch(seq, blob_load_cpl_extents_cpl, ctx);
+	num_pages = 0;
+	for (i = ctx->next_extent_page; i < ctx->extent_page_batch_end; i++) {
+		if (blob->active.extent_pages[i] != 0) {
+			lba = bs_md_page_to_lba(blob->bs, blob->active.extent_pages[i]);
+			bs_batch_read_dev(batch, &ctx->pages[num_pages++], lba,
+					  bs_byte_to_lba(blob->bs, SPDK_BS_PAGE_SIZE));
 		}
 	}
-
-	blob_load_backing_dev(seq, ctx);
+	bs_batch_close(batch);
 }
 
 static void
@@ -1828,7 +2305,7 @@ bs_super_validate(struct spdk_bs_super_block *super, struct spdk_blob_store *bs)
 	uint32_t	crc;
 	static const char zeros[SPDK_BLOBSTORE_TYPE_LENGTH];
 
-	if (super->version > SPDK_BS_VERSION ||
+	if (super->version > SPDK_BS_VERSION_SHARED_CLUSTERS ||
 	    super->version < SPDK_BS_INITIAL_VERSION) {
 		return -EILSEQ;
 	}
@@ -2049,6 +2526,11 @@ blob_persist_clear_clusters(spdk_bs_sequence_t *seq, struct spdk_blob_persist_ct
 		uint64_t next_lba = blob->active.clusters[i];
 		uint64_t next_lba_count = bs_cluster_to_lba(bs, 1);
 
+		if (bs_cluster_is_shared(bs, next_lba)) {
+			/* The data is still used by other blobs, the cluster is only dereferenced */
+			next_lba = 0;
+		}
+
 		if (next_lba > 0 && (lba + lba_count) == next_lba) {
 			/* This cluster is contiguous with the previous one. */
 			lba_count += next_lba_count;
@@ -2302,6 +2784,13 @@ blob_resize(struct spdk_blob *blob, uint64_t sz)
 		blob->active.clusters = tmp;
 		blob->active.cluster_array_size = sz;
 
+		if (blob->cow_unit_size != 0) {
+			rc = blob_cow_units_resize(blob, sz);
+			if (rc != 0) {
+				goto out;
+			}
+		}
+
 		/* Expand the extents table, only if enough clusters were added */
 		if (new_num_ep > current_num_ep && blob->use_extent_table) {
 			ep_tmp = realloc(blob->active.extent_pages, sizeof(*blob->active.extent_pages) * new_num_ep);
@@ -2337,6 +2826,9 @@ blob_resize(struct spdk_blob *blob, uint64_t sz)
 		if (blob->active.clusters[i] != 0) {
 			blob->active.num_allocated_clusters--;
 		}
+		if (i < blob->cow_units_array_size) {
+			blob->cow_units[i] = 0;
+		}
 	}
 
 	blob->active.num_clusters = sz;
@@ -2556,17 +3048,11 @@ bs_mark_dirty_write(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 }
 
 static void
-bs_mark_dirty(spdk_bs_sequence_t *seq, struct spdk_blob_store *bs,
-	      spdk_bs_sequence_cpl cb_fn, void *cb_arg)
+bs_update_super(spdk_bs_sequence_t *seq, struct spdk_blob_store *bs,
+		spdk_bs_sequence_cpl cb_fn, void *cb_arg)
 {
 	struct spdk_bs_mark_dirty *ctx;
 
-	/* Blobstore is already marked dirty */
-	if (bs->clean == 0) {
-		cb_fn(seq, cb_arg, 0);
-		return;
-	}
-
 	ctx = calloc(1, sizeof(*ctx));
 	if (!ctx) {
 		cb_fn(seq, cb_arg, -ENOMEM);
@@ -2589,6 +3075,33 @@ bs_mark_dirty(spdk_bs_sequence_t *seq, struct spdk_blob_store *bs,
 			     bs_mark_dirty_write, ctx);
 }
 
+static void
+bs_mark_dirty(spdk_bs_sequence_t *seq, struct spdk_blob_store *bs,
+	      spdk_bs_sequence_cpl cb_fn, void *cb_arg)
+{
+	/* Blobstore is already marked dirty */
+	if (bs->clean == 0) {
+		cb_fn(seq, cb_arg, 0);
+		return;
+	}
+
+	bs_update_super(seq, bs, cb_fn, cb_arg);
+}
+
+/* Mark the blobstore dirty and bump its version before the first cluster is shared */
+static void
+bs_mark_shared_clusters(spdk_bs_sequence_t *seq, struct spdk_blob_store *bs,
+			spdk_bs_sequence_cpl cb_fn, void *cb_arg)
+{
+	if (bs->shared_clusters) {
+		cb_fn(seq, cb_arg, 0);
+		return;
+	}
+
+	bs->shared_clusters = true;
+	bs_update_super(seq, bs, cb_fn, cb_arg);
+}
+
 /* Write a blob to disk */
 static void
 blob_persist(spdk_bs_sequence_t *seq, struct spdk_blob *blob,
@@ -2624,14 +3137,57 @@ blob_persist(spdk_bs_sequence_t *seq, struct spdk_blob *blob,
 	bs_mark_dirty(seq, blob->bs, blob_persist_start, ctx);
 }
 
+struct spdk_blob_cow_chunk {
+	struct spdk_blob_copy_cluster_ctx *ctx;
+	uint8_t *buf;
+	uint64_t offset;
+	uint64_t length;
+};
+
+/* Units of a partially copied cluster that one thread copies from the parent */
+struct spdk_blob_cow_claim {
+	struct spdk_thread		*thread;
+	struct spdk_blob		*blob;
+	uint32_t			cluster_num;
+	/* The units requested, and once claimed, the units to copy */
+	uint64_t			units;
+	/* The units were copied, the metadata sync that marks them local is in progress */
+	bool				committing;
+	int				rc;
+	spdk_blob_op_complete		cb_fn;
+	void				*cb_arg;
+	TAILQ_ENTRY(spdk_blob_cow_claim) link;
+};
+
 struct spdk_blob_copy_cluster_ctx {
 	struct spdk_blob *blob;
-	uint8_t *buf;
+	struct spdk_bs_channel *ch;
 	uint64_t page;
+	uint32_t cluster_num;
 	uint64_t new_cluster;
 	uint32_t new_extent_page;
 	spdk_bs_sequence_t *seq;
-	struct spdk_blob_md_page *new_cluster_page;
+	bool is_zeroes;
+	bool can_copy;
+	uint64_t copy_src_lba;
+	/* Units of the cluster to copy, 0 for the whole cluster */
+	uint64_t cow_units;
+	/* The cluster is allocated already, the units are copied into it */
+	bool cow_fill;
+	/* Shared cluster the data is copied from, 0 when copying from the parent */
+	uint64_t unshare_lba;
+	struct spdk_blob_cow_claim cow_claim;
+	/* User ops waiting for this cluster to be allocated */
+	TAILQ_HEAD(, spdk_bs_request_set) ops;
+	TAILQ_ENTRY(spdk_blob_copy_cluster_ctx) link;
+
+	/* Copy of the cluster through host memory, BS_COW_CHUNK_SIZE at a time */
+	struct spdk_blob_cow_chunk chunks[BS_COW_CHUNK_DEPTH];
+	uint64_t cow_offset;
+	uint32_t cow_inflight;
+	int cow_rc;
+	bool cow_waiting;
+	TAILQ_ENTRY(spdk_blob_copy_cluster_ctx) cow_link;
 };
 
 struct spdk_blob_free_cluster_ctx {
@@ -2643,20 +3199,48 @@ struct spdk_blob_free_cluster_ctx {
 	spdk_bs_sequence_t *seq;
 };
 
+/*
+ * Units of the cluster still in the parent, as they are to be persisted: the units
+ * being committed are written as local, but are read from the parent until the
+ * metadata sync completes.
+ */
+static uint64_t
+blob_cow_units_to_persist(const struct spdk_blob *blob, uint64_t cluster_num)
+{
+	struct spdk_blob_cow_claim *claim;
+	uint64_t units = blob->cow_units[cluster_num];
+
+	TAILQ_FOREACH(claim, &blob->cow_claims, link) {
+		if (claim->committing && claim->cluster_num == cluster_num) {
+			units &= ~claim->units;
+		}
+	}
+
+	return units;
+}
+
 static void
 blob_allocate_and_copy_cluster_cpl(void *cb_arg, int bserrno)
 {
 	struct spdk_blob_copy_cluster_ctx *ctx = cb_arg;
-	struct spdk_bs_request_set *set = (struct spdk_bs_request_set *)ctx->seq;
+	struct spdk_bs_channel *ch = ctx->ch;
 	TAILQ_HEAD(, spdk_bs_request_set) requests;
+	TAILQ_HEAD(, spdk_bs_request_set) ops;
 	spdk_bs_user_op_t *op;
 
-	TAILQ_INIT(&requests);
-	TAILQ_SWAP(&set->channel->need_cluster_alloc, &requests, spdk_bs_request_set, link);
+	TAILQ_REMOVE(&ch->cluster_allocs, ctx, link);
+	ch->num_cluster_allocs--;
 
-	while (!TAILQ_EMPTY(&requests)) {
-		op = TAILQ_FIRST(&requests);
-		TAILQ_REMOVE(&requests, op, link);
+	/* Return the context to the free list before the ops are executed, they may
+	 * need a new allocation for units still in the parent.
+	 */
+	TAILQ_INIT(&ops);
+	TAILQ_SWAP(&ctx->ops, &ops, spdk_bs_request_set, link);
+	TAILQ_INSERT_HEAD(&ch->free_cluster_allocs, ctx, link);
+
+	while (!TAILQ_EMPTY(&ops)) {
+		op = TAILQ_FIRST(&ops);
+		TAILQ_REMOVE(&ops, op, link);
 		if (bserrno == 0) {
 			bs_user_op_execute(op);
 		} else {
@@ -2664,8 +3248,15 @@ blob_allocate_and_copy_cluster_cpl(void *cb_arg, int bserrno)
 		}
 	}
 
-	spdk_free(ctx->buf);
-	free(ctx);
+	/* A slot for a new allocation is free now, resubmit the ops that waited for it */
+	TAILQ_INIT(&requests);
+	TAILQ_SWAP(&ch->need_cluster_alloc, &requests, spdk_bs_request_set, link);
+
+	while (!TAILQ_EMPTY(&requests)) {
+		op = TAILQ_FIRST(&requests);
+		TAILQ_REMOVE(&requests, op, link);
+		bs_user_op_execute(op);
+	}
 }
 
 static void
@@ -2753,11 +3344,26 @@ blob_insert_cluster_cpl(void *cb_arg, int bserrno)
 	bs_sequence_finish(ctx->seq, bserrno);
 }
 
+static void
+blob_cow_commit_cpl(void *cb_arg, int bserrno)
+{
+	struct spdk_blob_copy_cluster_ctx *ctx = cb_arg;
+
+	bs_sequence_finish(ctx->seq, bserrno);
+}
+
 static void
 blob_write_copy_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
 	struct spdk_blob_copy_cluster_ctx *ctx = cb_arg;
 	uint32_t cluster_number;
+	uint64_t cow_units = 0;
+
+	if (ctx->cow_fill) {
+		/* Mark the copied units as local, or release them on error */
+		blob_cow_commit_on_md_thread(&ctx->cow_claim, bserrno, blob_cow_commit_cpl, ctx);
+		return;
+	}
 
 	if (bserrno) {
 		/* The write failed, so jump to the final completion handler */
@@ -2767,190 +3373,514 @@ blob_write_copy_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 
 	cluster_number = bs_page_to_cluster(ctx->blob->bs, ctx->page);
 
+	if (ctx->cow_units != 0) {
+		/* Only part of the cluster was copied, the rest is still in the parent */
+		cow_units = bs_cow_units_all(ctx->blob) & ~ctx->cow_units;
+	}
+
 	blob_insert_cluster_on_md_thread(ctx->blob, cluster_number, ctx->new_cluster,
-					 ctx->new_extent_page, ctx->new_cluster_page, blob_insert_cluster_cpl, ctx);
+					 ctx->new_extent_page, cow_units, ctx->unshare_lba,
+					 blob_insert_cluster_cpl, ctx);
 }
 
-static void
-blob_write_copy(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+static void bs_channel_cow_resume(struct spdk_bs_channel *ch);
+
+static int
+bs_channel_cow_buf_init(struct spdk_bs_channel *ch)
 {
-	struct spdk_blob_copy_cluster_ctx *ctx = cb_arg;
+	uint32_t i;
 
-	if (bserrno != 0) {
-		/* The read failed, so jump to the final completion handler */
-		bs_sequence_finish(seq, bserrno);
-		return;
+	if (ch->cow_buf_mem != NULL) {
+		return 0;
+	}
+
+	ch->cow_buf_mem = spdk_malloc((size_t)BS_COW_BUFS_PER_CHANNEL * BS_COW_CHUNK_SIZE, 0x1000, NULL,
+				      SPDK_ENV_NUMA_ID_ANY, SPDK_MALLOC_DMA);
+	if (ch->cow_buf_mem == NULL) {
+		SPDK_ERRLOG("DMA allocation for copy-on-write buffers failed.\n");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < BS_COW_BUFS_PER_CHANNEL; i++) {
+		ch->cow_bufs[i] = ch->cow_buf_mem + (size_t)i * BS_COW_CHUNK_SIZE;
 	}
+	ch->num_cow_bufs = BS_COW_BUFS_PER_CHANNEL;
 
-	/* Write whole cluster */
-	bs_sequence_write_dev(seq, ctx->buf,
-			      bs_cluster_to_lba(ctx->blob->bs, ctx->new_cluster),
-			      bs_cluster_to_lba(ctx->blob->bs, 1),
-			      blob_write_copy_cpl, ctx);
+	return 0;
+}
+
+static int
+bs_channel_cow_poll(void *arg)
+{
+	struct spdk_bs_channel *ch = arg;
+
+	spdk_poller_unregister(&ch->cow_poller);
+	bs_channel_cow_resume(ch);
+
+	return SPDK_POLLER_BUSY;
 }
 
+/*
+ * Take len bytes of copy-on-write bandwidth. The bucket is allowed to go negative, the
+ * next chunk is admitted only once it has been refilled.
+ */
 static bool
-blob_can_copy(struct spdk_blob *blob, uint32_t cluster_start_page, uint64_t *base_lba)
+bs_channel_cow_admit(struct spdk_bs_channel *ch, uint64_t len)
 {
-	uint64_t lba = bs_dev_page_to_lba(blob->back_bs_dev, cluster_start_page);
+	uint64_t limit = ch->bs->cow_bw_limit;
+	uint64_t hz, now, elapsed, burst, wait_us;
 
-	return (!blob_is_esnap_clone(blob) && blob->bs->dev->copy != NULL) &&
-	       blob->back_bs_dev->translate_lba(blob->back_bs_dev, lba, base_lba);
+	if (limit == 0) {
+		return true;
+	}
+
+	hz = spdk_get_ticks_hz();
+	now = spdk_get_ticks();
+	elapsed = spdk_min(now - ch->cow_last_tsc, hz);
+	ch->cow_last_tsc = now;
+
+	burst = spdk_max(limit / 10, BS_COW_CHUNK_SIZE);
+	ch->cow_tokens = spdk_min(ch->cow_tokens + (int64_t)(elapsed * limit / hz), (int64_t)burst);
+	if (ch->cow_tokens > 0) {
+		ch->cow_tokens -= len;
+		return true;
+	}
+
+	if (ch->cow_poller == NULL) {
+		wait_us = ((uint64_t)(-ch->cow_tokens) + 1) * SPDK_SEC_TO_USEC / limit;
+		ch->cow_poller = SPDK_POLLER_REGISTER(bs_channel_cow_poll, ch, spdk_max(wait_us, 1));
+	}
+
+	return false;
 }
 
 static void
-blob_copy(struct spdk_blob_copy_cluster_ctx *ctx, spdk_bs_user_op_t *op, uint64_t src_lba)
+blob_cow_wait(struct spdk_blob_copy_cluster_ctx *ctx)
+{
+	if (!ctx->cow_waiting) {
+		ctx->cow_waiting = true;
+		TAILQ_INSERT_TAIL(&ctx->ch->cow_waiting, ctx, cow_link);
+	}
+}
+
+static void blob_cow_submit(struct spdk_blob_copy_cluster_ctx *ctx);
+
+/* Move cow_offset to the next byte of the cluster that has to be copied */
+static bool
+blob_cow_next_offset(struct spdk_blob_copy_cluster_ctx *ctx)
 {
 	struct spdk_blob *blob = ctx->blob;
-	uint64_t lba_count = bs_dev_byte_to_lba(blob->back_bs_dev, blob->bs->cluster_sz);
+	uint64_t units;
+
+	if (ctx->cow_units != 0 && ctx->cow_offset < blob->bs->cluster_sz) {
+		units = ctx->cow_units & ~((1ULL << (ctx->cow_offset / blob->cow_unit_size)) - 1);
+		if (units == 0) {
+			ctx->cow_offset = blob->bs->cluster_sz;
+		} else {
+			ctx->cow_offset = spdk_max(ctx->cow_offset,
+						   (uint64_t)__builtin_ctzll(units) * blob->cow_unit_size);
+		}
+	}
 
-	bs_sequence_copy_dev(ctx->seq,
-			     bs_cluster_to_lba(blob->bs, ctx->new_cluster),
-			     src_lba,
-			     lba_count,
-			     blob_write_copy_cpl, ctx);
+	return ctx->cow_offset < blob->bs->cluster_sz;
 }
 
 static void
-blob_write_zeros_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+blob_cow_chunk_cpl(void *cb_arg, int bserrno)
 {
-	struct spdk_blob_copy_cluster_ctx *ctx = cb_arg;
-	uint32_t cluster_number;
+	struct spdk_blob_cow_chunk *chunk = cb_arg;
+	struct spdk_blob_copy_cluster_ctx *ctx = chunk->ctx;
+	struct spdk_bs_channel *ch = ctx->ch;
 
-	if (bserrno) {
-		/* The write failed, so jump to the final completion handler */
-		bs_sequence_finish(seq, bserrno);
-		return;
-	}
+	ch->cow_bufs[ch->num_cow_bufs++] = chunk->buf;
+	chunk->buf = NULL;
 
-	cluster_number = bs_page_to_cluster(ctx->blob->bs, ctx->page);
+	assert(ctx->cow_inflight > 0);
+	ctx->cow_inflight--;
+	if (bserrno != 0 && ctx->cow_rc == 0) {
+		ctx->cow_rc = bserrno;
+	}
 
-	blob_insert_cluster_on_md_thread(ctx->blob, cluster_number, ctx->new_cluster,
-					 ctx->new_extent_page, ctx->new_cluster_page, blob_insert_cluster_cpl, ctx);
+	blob_cow_submit(ctx);
+	/* Other copies may be waiting for the buffer that was just returned */
+	bs_channel_cow_resume(ch);
 }
 
 static void
-bs_allocate_and_copy_cluster(struct spdk_blob *blob,
-			     struct spdk_io_channel *_ch,
-			     uint64_t io_unit, spdk_bs_user_op_t *op)
+blob_cow_chunk_cpl_seq(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
-	struct spdk_bs_cpl cpl;
-	struct spdk_bs_channel *ch;
-	struct spdk_blob_copy_cluster_ctx *ctx;
-	uint32_t cluster_start_page;
-	uint32_t cluster_number;
-	bool is_zeroes;
-	bool can_copy;
-	bool is_valid_range;
-	uint64_t copy_src_lba;
-	int rc;
+	bs_sequence_finish(seq, bserrno);
+}
 
-	ch = spdk_io_channel_get_ctx(_ch);
+static void
+blob_cow_chunk_write(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_blob_cow_chunk *chunk = cb_arg;
+	struct spdk_blob_store *bs = chunk->ctx->blob->bs;
 
-	if (!TAILQ_EMPTY(&ch->need_cluster_alloc)) {
-		/* There are already operations pending. Queue this user op
-		 * and return because it will be re-executed when the outstanding
-		 * cluster allocation completes. */
-		TAILQ_INSERT_TAIL(&ch->need_cluster_alloc, op, link);
+	if (bserrno != 0) {
+		/* The read failed, so jump to the final completion handler */
+		bs_sequence_finish(seq, bserrno);
 		return;
 	}
 
-	/* Round the io_unit offset down to the first page in the cluster */
-	cluster_start_page = bs_io_unit_to_cluster_start(blob, io_unit);
+	bs_sequence_write_dev(seq, chunk->buf,
+			      bs_cluster_to_lba(bs, chunk->ctx->new_cluster) + bs_byte_to_lba(bs, chunk->offset),
+			      bs_byte_to_lba(bs, chunk->length),
+			      blob_cow_chunk_cpl_seq, chunk);
+}
 
-	/* Calculate which index in the metadata cluster array the corresponding
-	 * cluster is supposed to be at. */
-	cluster_number = bs_io_unit_to_cluster_number(blob, io_unit);
+/*
+ * Copy the cluster from the backing device chunk by chunk. Up to BS_COW_CHUNK_DEPTH
+ * chunks are in flight, so that reading one chunk overlaps with writing the previous
+ * one, and the buffers come from a pool shared by all copies on the channel.
+ */
+static void
+blob_cow_submit(struct spdk_blob_copy_cluster_ctx *ctx)
+{
+	struct spdk_blob *blob = ctx->blob;
+	struct spdk_bs_channel *ch = ctx->ch;
+	struct spdk_bs_dev *back_dev = blob->back_bs_dev;
+	struct spdk_blob_cow_chunk *chunk;
+	struct spdk_bs_cpl cpl;
+	spdk_bs_sequence_t *seq;
+	uint32_t i;
 
-	ctx = calloc(1, sizeof(*ctx));
-	if (!ctx) {
-		bs_user_op_abort(op, -ENOMEM);
-		return;
+	if (ctx->cow_waiting) {
+		TAILQ_REMOVE(&ch->cow_waiting, ctx, cow_link);
+		ctx->cow_waiting = false;
 	}
 
-	assert(blob->bs->cluster_sz % blob->back_bs_dev->blocklen == 0);
-
-	ctx->blob = blob;
-	ctx->page = cluster_start_page;
-	ctx->new_cluster_page = ch->new_cluster_page;
-	memset(ctx->new_cluster_page, 0, SPDK_BS_PAGE_SIZE);
+	while (ctx->cow_rc == 0 && blob_cow_next_offset(ctx) &&
+	       ctx->cow_inflight < BS_COW_CHUNK_DEPTH) {
+		if (ch->num_cow_bufs == 0) {
+			blob_cow_wait(ctx);
+			return;
+		}
 
-	/* Check if the cluster that we intend to do CoW for is valid for
-	 * the backing dev. For zeroes backing dev, it'll be always valid.
-	 * For other backing dev e.g. a snapshot, it could be invalid if
-	 * the blob has been resized after snapshot was taken. */
-	is_valid_range = blob->back_bs_dev->is_range_valid(blob->back_bs_dev,
-			 bs_dev_page_to_lba(blob->back_bs_dev, cluster_start_page),
-			 bs_dev_byte_to_lba(blob->back_bs_dev, blob->bs->cluster_sz));
+		for (i = 0; i < BS_COW_CHUNK_DEPTH; i++) {
+			if (ctx->chunks[i].buf == NULL) {
+				break;
+			}
+		}
+		assert(i < BS_COW_CHUNK_DEPTH);
+		chunk = &ctx->chunks[i];
+		chunk->ctx = ctx;
+		chunk->offset = ctx->cow_offset;
+		chunk->length = spdk_min(BS_COW_CHUNK_SIZE, blob->bs->cluster_sz - ctx->cow_offset);
+		if (ctx->cow_units != 0) {
+			/* Do not run into the next unit, it may not need a copy */
+			chunk->length = spdk_min(chunk->length,
+						 blob->cow_unit_size - ctx->cow_offset % blob->cow_unit_size);
+		}
 
-	can_copy = is_valid_range && blob_can_copy(blob, cluster_start_page, &copy_src_lba);
-
-	is_zeroes = is_valid_range && blob->back_bs_dev->is_zeroes(blob->back_bs_dev,
-			bs_dev_page_to_lba(blob->back_bs_dev, cluster_start_page),
-			bs_dev_byte_to_lba(blob->back_bs_dev, blob->bs->cluster_sz));
-	if (blob->parent_id != SPDK_BLOBID_INVALID && !is_zeroes && !can_copy) {
-		ctx->buf = spdk_malloc(blob->bs->cluster_sz, blob->back_bs_dev->blocklen,
-				       NULL, SPDK_ENV_NUMA_ID_ANY, SPDK_MALLOC_DMA);
-		if (!ctx->buf) {
-			SPDK_ERRLOG("DMA allocation for cluster of size = %" PRIu32 " failed.\n",
-				    blob->bs->cluster_sz);
-			free(ctx);
-			bs_user_op_abort(op, -ENOMEM);
+		if (!bs_channel_cow_admit(ch, chunk->length)) {
+			blob_cow_wait(ctx);
 			return;
 		}
+
+		cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+		cpl.u.blob_basic.cb_fn = blob_cow_chunk_cpl;
+		cpl.u.blob_basic.cb_arg = chunk;
+
+		seq = bs_sequence_start_blob(spdk_io_channel_from_ctx(ch), &cpl, blob);
+		if (seq == NULL) {
+			ctx->cow_rc = -ENOMEM;
+			break;
+		}
+
+		chunk->buf = ch->cow_bufs[--ch->num_cow_bufs];
+		ctx->cow_offset += chunk->length;
+		ctx->cow_inflight++;
+
+		if (ctx->unshare_lba != 0) {
+			/* Read chunk from the shared cluster */
+			bs_sequence_read_dev(seq, chunk->buf,
+					     ctx->unshare_lba + bs_byte_to_lba(blob->bs, chunk->offset),
+					     bs_byte_to_lba(blob->bs, chunk->length),
+					     blob_cow_chunk_write, chunk);
+			continue;
+		}
+
+		/* Read chunk from backing device */
+		bs_sequence_read_bs_dev(seq, back_dev, chunk->buf,
+					bs_dev_page_to_lba(back_dev, ctx->page) + bs_dev_byte_to_lba(back_dev, chunk->offset),
+					bs_dev_byte_to_lba(back_dev, chunk->length),
+					blob_cow_chunk_write, chunk);
 	}
 
-	spdk_spin_lock(&blob->bs->used_lock);
-	rc = bs_allocate_cluster(blob, cluster_number, &ctx->new_cluster, &ctx->new_extent_page,
-				 false);
-	spdk_spin_unlock(&blob->bs->used_lock);
-	if (rc != 0) {
-		spdk_free(ctx->buf);
-		free(ctx);
-		bs_user_op_abort(op, rc);
+	if (ctx->cow_inflight > 0 || ctx->cow_waiting) {
 		return;
 	}
 
-	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
-	cpl.u.blob_basic.cb_fn = blob_allocate_and_copy_cluster_cpl;
-	cpl.u.blob_basic.cb_arg = ctx;
-
-	ctx->seq = bs_sequence_start_blob(_ch, &cpl, blob);
-	if (!ctx->seq) {
-		spdk_spin_lock(&blob->bs->used_lock);
-		bs_release_cluster(blob->bs, ctx->new_cluster);
-		spdk_spin_unlock(&blob->bs->used_lock);
-		spdk_free(ctx->buf);
-		free(ctx);
-		bs_user_op_abort(op, -ENOMEM);
+	if (ctx->cow_rc != 0 && !ctx->cow_fill) {
+		blob_insert_cluster_revert(ctx);
+		bs_sequence_finish(ctx->seq, ctx->cow_rc);
 		return;
 	}
 
-	/* Queue the user op to block other incoming operations */
-	TAILQ_INSERT_TAIL(&ch->need_cluster_alloc, op, link);
+	assert(ctx->cow_rc != 0 || ctx->cow_offset == blob->bs->cluster_sz);
+	blob_write_copy_cpl(ctx->seq, ctx, ctx->cow_rc);
+}
 
-	if (blob->parent_id != SPDK_BLOBID_INVALID && !is_zeroes) {
-		if (can_copy) {
-			blob_copy(ctx, op, copy_src_lba);
-		} else {
-			/* Read cluster from backing device */
-			bs_sequence_read_bs_dev(ctx->seq, blob->back_bs_dev, ctx->buf,
-						bs_dev_page_to_lba(blob->back_bs_dev, cluster_start_page),
-						bs_dev_byte_to_lba(blob->back_bs_dev, blob->bs->cluster_sz),
-						blob_write_copy, ctx);
-		}
+static void
+bs_channel_cow_resume(struct spdk_bs_channel *ch)
+{
+	TAILQ_HEAD(, spdk_blob_copy_cluster_ctx) waiting;
+	struct spdk_blob_copy_cluster_ctx *ctx;
 
-	} else {
-		if (is_zeroes) {
-			bs_sequence_write_zeroes_dev(ctx->seq,
-						     bs_cluster_to_lba(blob->bs, ctx->new_cluster),
-						     bs_cluster_to_lba(blob->bs, 1),
-						     blob_write_zeros_cpl, ctx);
+	TAILQ_INIT(&waiting);
+	TAILQ_SWAP(&ch->cow_waiting, &waiting, spdk_blob_copy_cluster_ctx, cow_link);
+
+	while (!TAILQ_EMPTY(&waiting)) {
+		ctx = TAILQ_FIRST(&waiting);
+		TAILQ_REMOVE(&waiting, ctx, cow_link);
+		ctx->cow_waiting = false;
+		blob_cow_submit(ctx);
+	}
+}
+
+static bool
+blob_can_copy(struct spdk_blob *blob, uint32_t cluster_start_page, uint64_t *base_lba)
+{
+	uint64_t lba = bs_dev_page_to_lba(blob->back_bs_dev, cluster_start_page);
+
+	return (!blob_is_esnap_clone(blob) && blob->bs->dev->copy != NULL) &&
+	       blob->back_bs_dev->translate_lba(blob->back_bs_dev, lba, base_lba);
+}
+
+/* Units of the cluster touched by the op, all of them for an op without length */
+static uint64_t
+blob_cow_op_units(struct spdk_blob *blob, spdk_bs_user_op_t *op)
+{
+	uint64_t io_units_per_unit = bs_io_units_per_cow_unit(blob);
+	uint64_t offset = op->u.user_op.offset % bs_io_units_per_cluster(blob);
+	uint64_t first, last;
+
+	if (op->u.user_op.length == 0) {
+		return bs_cow_units_all(blob);
+	}
+
+	first = offset / io_units_per_unit;
+	last = (offset + op->u.user_op.length - 1) / io_units_per_unit;
+
+	return bs_cow_units_all(blob) & ((2ULL << last) - 1) & ~((1ULL << first) - 1);
+}
+
+/* Copy the units of the cluster selected in ctx, or the whole cluster */
+static void
+blob_cow_dispatch(struct spdk_blob_copy_cluster_ctx *ctx)
+{
+	struct spdk_blob *blob = ctx->blob;
+	struct spdk_bs_dev *back_dev = blob->back_bs_dev;
+	uint64_t offset = 0, length = blob->bs->cluster_sz;
+	uint64_t units, lba;
+	bool contiguous = true;
+
+	if (ctx->cow_units != 0) {
+		units = ctx->cow_units >> __builtin_ctzll(ctx->cow_units);
+		contiguous = (units & (units + 1)) == 0;
+		offset = (uint64_t)__builtin_ctzll(ctx->cow_units) * blob->cow_unit_size;
+		length = (uint64_t)__builtin_popcountll(ctx->cow_units) * blob->cow_unit_size;
+	}
+
+	lba = bs_cluster_to_lba(blob->bs, ctx->new_cluster) + bs_byte_to_lba(blob->bs, offset);
+
+	if (ctx->unshare_lba != 0) {
+		if (ctx->can_copy) {
+			bs_sequence_copy_dev(ctx->seq, lba, ctx->unshare_lba, bs_byte_to_lba(blob->bs, length),
+					     blob_write_copy_cpl, ctx);
+		} else {
+			blob_cow_submit(ctx);
+		}
+	} else if (blob->parent_id != SPDK_BLOBID_INVALID && !ctx->is_zeroes) {
+		if (ctx->can_copy && contiguous) {
+			bs_sequence_copy_dev(ctx->seq, lba,
+					     ctx->copy_src_lba + bs_dev_byte_to_lba(back_dev, offset),
+					     bs_dev_byte_to_lba(back_dev, length),
+					     blob_write_copy_cpl, ctx);
 		} else {
-			blob_insert_cluster_on_md_thread(ctx->blob, cluster_number, ctx->new_cluster,
-							 ctx->new_extent_page, ctx->new_cluster_page, blob_insert_cluster_cpl, ctx);
+			/* Copy cluster from backing device through the channel's chunk buffers */
+			blob_cow_submit(ctx);
+		}
+	} else if (ctx->is_zeroes) {
+		bs_sequence_write_zeroes_dev(ctx->seq, lba, bs_byte_to_lba(blob->bs, length),
+					     blob_write_copy_cpl, ctx);
+	} else {
+		blob_write_copy_cpl(ctx->seq, ctx, 0);
+	}
+}
+
+static void
+blob_cow_claim_cpl(void *cb_arg, int bserrno)
+{
+	struct spdk_blob_copy_cluster_ctx *ctx = cb_arg;
+	int rc;
+
+	if (bserrno != 0 || ctx->cow_claim.units == 0) {
+		/* Nothing left to copy, other threads copied the units in the meantime */
+		bs_sequence_finish(ctx->seq, bserrno);
+		return;
+	}
+
+	ctx->cow_units = ctx->cow_claim.units;
+	if (ctx->cow_units == bs_cow_units_all(ctx->blob)) {
+		ctx->cow_units = 0;
+	}
+
+	rc = bs_channel_cow_buf_init(ctx->ch);
+	if (rc != 0) {
+		blob_write_copy_cpl(ctx->seq, ctx, rc);
+		return;
+	}
+
+	blob_cow_dispatch(ctx);
+}
+
+static void
+bs_allocate_and_copy_cluster(struct spdk_blob *blob,
+			     struct spdk_io_channel *_ch,
+			     uint64_t io_unit, spdk_bs_user_op_t *op)
+{
+	struct spdk_bs_cpl cpl;
+	struct spdk_bs_channel *ch;
+	struct spdk_blob_copy_cluster_ctx *ctx;
+	uint32_t cluster_start_page;
+	uint32_t cluster_number;
+	uint64_t cow_units;
+	bool is_valid_range;
+	int rc;
+
+	ch = spdk_io_channel_get_ctx(_ch);
+
+	/* Round the io_unit offset down to the first page in the cluster */
+	cluster_start_page = bs_io_unit_to_cluster_start(blob, io_unit);
+
+	/* Calculate which index in the metadata cluster array the corresponding
+	 * cluster is supposed to be at. */
+	cluster_number = bs_io_unit_to_cluster_number(blob, io_unit);
+
+	TAILQ_FOREACH(ctx, &ch->cluster_allocs, link) {
+		if (ctx->blob == blob && ctx->cluster_num == cluster_number) {
+			/* This cluster is already being allocated. Queue this user op
+			 * and return because it will be re-executed when that
+			 * cluster allocation completes. */
+			TAILQ_INSERT_TAIL(&ctx->ops, op, link);
+			return;
+		}
+	}
+
+	if (ch->num_cluster_allocs >= BS_MAX_CLUSTER_ALLOCS_PER_CHANNEL) {
+		/* Too many allocations in progress. The user op will be re-executed
+		 * once one of them completes. */
+		TAILQ_INSERT_TAIL(&ch->need_cluster_alloc, op, link);
+		return;
+	}
+
+	/* There is a context for each of the BS_MAX_CLUSTER_ALLOCS_PER_CHANNEL slots */
+	ctx = TAILQ_FIRST(&ch->free_cluster_allocs);
+	assert(ctx != NULL);
+	TAILQ_REMOVE(&ch->free_cluster_allocs, ctx, link);
+
+	assert(blob->bs->cluster_sz % blob->back_bs_dev->blocklen == 0);
+	assert(BS_COW_CHUNK_SIZE % blob->back_bs_dev->blocklen == 0);
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->blob = blob;
+	ctx->ch = ch;
+	ctx->page = cluster_start_page;
+	ctx->cluster_num = cluster_number;
+	TAILQ_INIT(&ctx->ops);
+
+	/* Check if the cluster that we intend to do CoW for is valid for
+	 * the backing dev. For zeroes backing dev, it'll be always valid.
+	 * For other backing dev e.g. a snapshot, it could be invalid if
+	 * the blob has been resized after snapshot was taken. */
+	is_valid_range = blob->back_bs_dev->is_range_valid(blob->back_bs_dev,
+			 bs_dev_page_to_lba(blob->back_bs_dev, cluster_start_page),
+			 bs_dev_byte_to_lba(blob->back_bs_dev, blob->bs->cluster_sz));
+
+	ctx->can_copy = is_valid_range && blob_can_copy(blob, cluster_start_page, &ctx->copy_src_lba);
+
+	ctx->is_zeroes = is_valid_range && blob->back_bs_dev->is_zeroes(blob->back_bs_dev,
+			 bs_dev_page_to_lba(blob->back_bs_dev, cluster_start_page),
+			 bs_dev_byte_to_lba(blob->back_bs_dev, blob->bs->cluster_sz));
+
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = blob_allocate_and_copy_cluster_cpl;
+	cpl.u.blob_basic.cb_arg = ctx;
+
+	if (bs_cluster_is_shared(blob->bs, blob->active.clusters[cluster_number])) {
+		/* The cluster is shared with other blobs, write to a private copy of it */
+		ctx->unshare_lba = blob->active.clusters[cluster_number];
+		ctx->copy_src_lba = ctx->unshare_lba;
+		ctx->can_copy = blob->bs->dev->copy != NULL;
+		ctx->is_zeroes = false;
+	} else if (blob->active.clusters[cluster_number] != 0) {
+		/* The cluster is allocated already, but the op touches units still in the parent */
+		assert(blob->cow_unit_size != 0);
+		ctx->cow_fill = true;
+		ctx->new_cluster = bs_lba_to_cluster(blob->bs, blob->active.clusters[cluster_number]);
+
+		ctx->seq = bs_sequence_start_blob(_ch, &cpl, blob);
+		if (!ctx->seq) {
+			TAILQ_INSERT_HEAD(&ch->free_cluster_allocs, ctx, link);
+			bs_user_op_abort(op, -ENOMEM);
+			return;
+		}
+
+		TAILQ_INSERT_TAIL(&ctx->ops, op, link);
+		TAILQ_INSERT_TAIL(&ch->cluster_allocs, ctx, link);
+		ch->num_cluster_allocs++;
+
+		blob_cow_claim_on_md_thread(blob, &ctx->cow_claim, cluster_number,
+					    blob_cow_op_units(blob, op), blob_cow_claim_cpl, ctx);
+		return;
+	}
+
+	if (blob->cow_unit_size != 0 && blob->parent_id != SPDK_BLOBID_INVALID && !ctx->is_zeroes &&
+	    ctx->unshare_lba == 0) {
+		/* Copy only the units touched by the op, unless little would be left in the parent */
+		cow_units = blob_cow_op_units(blob, op);
+		if ((uint32_t)__builtin_popcountll(bs_cow_units_all(blob) & ~cow_units) >
+		    bs_cow_units_per_cluster(blob) / BS_COW_FILL_DIVISOR) {
+			ctx->cow_units = cow_units;
+		}
+	}
+
+	if ((ctx->unshare_lba != 0 && !ctx->can_copy) ||
+	    (blob->parent_id != SPDK_BLOBID_INVALID && !ctx->is_zeroes &&
+	     (!ctx->can_copy || ctx->cow_units != 0))) {
+		rc = bs_channel_cow_buf_init(ch);
+		if (rc != 0) {
+			TAILQ_INSERT_HEAD(&ch->free_cluster_allocs, ctx, link);
+			bs_user_op_abort(op, rc);
+			return;
 		}
 	}
+
+	rc = bs_channel_allocate_cluster(ch, blob, cluster_number, &ctx->new_cluster,
+					 &ctx->new_extent_page);
+	if (rc != 0) {
+		TAILQ_INSERT_HEAD(&ch->free_cluster_allocs, ctx, link);
+		bs_user_op_abort(op, rc);
+		return;
+	}
+
+	ctx->seq = bs_sequence_start_blob(_ch, &cpl, blob);
+	if (!ctx->seq) {
+		blob_insert_cluster_revert(ctx);
+		TAILQ_INSERT_HEAD(&ch->free_cluster_allocs, ctx, link);
+		bs_user_op_abort(op, -ENOMEM);
+		return;
+	}
+
+	/* Queue the user op to block other incoming operations to this cluster */
+	TAILQ_INSERT_TAIL(&ctx->ops, op, link);
+	TAILQ_INSERT_TAIL(&ch->cluster_allocs, ctx, link);
+	ch->num_cluster_allocs++;
+
+	blob_cow_dispatch(ctx);
 }
 
 static inline bool
@@ -2970,6 +3900,22 @@ blob_calculate_lba_and_lba_count(struct spdk_blob *blob, uint64_t io_unit, uint6
 	}
 }
 
+/* Given an io_unit offset into a blob, look up the number of io_units that can be
+ * submitted to the device as a single operation. I/O is only split where clusters
+ * that are adjacent in the blob are not adjacent on the device. Unmaps are still
+ * split at every cluster boundary, so that whole clusters can be released.
+ */
+static inline uint64_t
+blob_io_units_to_boundary(struct spdk_blob *blob, uint64_t io_unit, uint64_t length,
+			  enum spdk_blob_op_type op_type)
+{
+	if (op_type == SPDK_BLOB_UNMAP) {
+		return bs_num_io_units_to_cluster_boundary(blob, io_unit);
+	}
+
+	return bs_num_io_units_to_extent_boundary(blob, io_unit, length);
+}
+
 struct op_split_ctx {
 	struct spdk_blob *blob;
 	struct spdk_io_channel *channel;
@@ -3024,8 +3970,7 @@ blob_request_submit_op_split_next(void *cb_arg, int bserrno)
 		offset = ctx->io_unit_offset;
 		length = ctx->io_units_remaining;
 		buf = ctx->curr_payload;
-		op_length = spdk_min(length, bs_num_io_units_to_cluster_boundary(blob,
-				     offset));
+		op_length = spdk_min(length, blob_io_units_to_boundary(blob, offset, length, op_type));
 
 		/* Update length and payload for next operation */
 		ctx->io_units_remaining -= op_length;
@@ -3109,7 +4054,8 @@ blob_request_submit_op_split(struct spdk_io_channel *ch, struct spdk_blob *blob,
 	cpl.u.blob_basic.cb_fn = cb_fn;
 	cpl.u.blob_basic.cb_arg = cb_arg;
 
-	seq = bs_sequence_start_blob(ch, &cpl, blob);
+	/* The parts are submitted as separate blob I/O, the sequence itself doesn't touch the blob */
+	seq = bs_sequence_start_bs(ch, &cpl);
 	if (!seq) {
 		free(ctx);
 		cb_fn(cb_arg, -ENOMEM);
@@ -3151,6 +4097,7 @@ blob_request_submit_op_single(struct spdk_io_channel *_ch, struct spdk_blob *blo
 	uint64_t lba;
 	uint64_t lba_count;
 	bool is_allocated;
+	bool is_shared;
 
 	assert(blob != NULL);
 
@@ -3175,6 +4122,8 @@ blob_request_submit_op_single(struct spdk_io_channel *_ch, struct spdk_blob *blo
 	}
 
 	is_allocated = blob_calculate_lba_and_lba_count(blob, offset, length, &lba, &lba_count);
+	/* A shared cluster is copied before it is modified */
+	is_shared = is_allocated && bs_cluster_is_shared(blob->bs, lba);
 
 	switch (op_type) {
 	case SPDK_BLOB_READ: {
@@ -3199,7 +4148,7 @@ blob_request_submit_op_single(struct spdk_io_channel *_ch, struct spdk_blob *blo
 	}
 	case SPDK_BLOB_WRITE:
 	case SPDK_BLOB_WRITE_ZEROES: {
-		if (is_allocated) {
+		if (is_allocated && !is_shared) {
 			/* Write to the blob */
 			spdk_bs_batch_t *batch;
 
@@ -3294,7 +4243,8 @@ blob_request_submit_op_single(struct spdk_io_channel *_ch, struct spdk_blob *blo
 			return;
 		}
 
-		if (is_allocated) {
+		if (is_allocated && !is_shared) {
+			/* Data of a shared cluster stays in place for the other blobs */
 			bs_batch_unmap_dev(batch, lba, lba_count);
 		}
 
@@ -3330,7 +4280,7 @@ blob_request_submit_op(struct spdk_blob *blob, struct spdk_io_channel *_channel,
 		cb_fn(cb_arg, -EINVAL);
 		return;
 	}
-	if (length <= bs_num_io_units_to_cluster_boundary(blob, offset)) {
+	if (length <= blob_io_units_to_boundary(blob, offset, length, op_type)) {
 		blob_request_submit_op_single(_channel, blob, payload, offset, length,
 					      cb_fn, cb_arg, op_type);
 	} else {
@@ -3379,7 +4329,8 @@ rw_iov_split_next(void *cb_arg, int bserrno)
 	}
 
 	io_unit_offset = ctx->io_unit_offset;
-	io_units_to_boundary = bs_num_io_units_to_cluster_boundary(blob, io_unit_offset);
+	io_units_to_boundary = bs_num_io_units_to_extent_boundary(blob, io_unit_offset,
+			       ctx->io_units_remaining);
 	io_units_count = spdk_min(ctx->io_units_remaining, io_units_to_boundary);
 	/*
 	 * Get index and offset into the original iov array for our current position in the I/O sequence.
@@ -3458,7 +4409,8 @@ blob_request_submit_rw_iov(struct spdk_blob *blob, struct spdk_io_channel *_chan
 
 	/*
 	 * For now, we implement readv/writev using a sequence (instead of a batch) to account for having
-	 *  to split a request that spans a cluster boundary.  For I/O that do not span a cluster boundary,
+	 *  to split a request that spans a cluster boundary.  A request that spans clusters which are
+	 *  also adjacent on the device is not split.  For I/O that do not span a cluster boundary,
 	 *  there will be no noticeable difference compared to using a batch.  For I/O that do span a cluster
 	 *  boundary, the target LBAs (after blob offset to LBA translation) may not be contiguous, so we need
 	 *  to allocate a separate iov array and split the I/O such that none of the resulting
@@ -3470,7 +4422,7 @@ blob_request_submit_rw_iov(struct spdk_blob *blob, struct spdk_io_channel *_chan
 	 *  in a batch.  That would also require creating an intermediate spdk_bs_cpl that would get called
 	 *  when the batch was completed, to allow for freeing the memory for the iov arrays.
 	 */
-	if (spdk_likely(length <= bs_num_io_units_to_cluster_boundary(blob, offset))) {
+	if (spdk_likely(length <= bs_num_io_units_to_extent_boundary(blob, offset, length))) {
 		uint64_t lba_count;
 		uint64_t lba;
 		bool is_allocated;
@@ -3517,7 +4469,7 @@ blob_request_submit_rw_iov(struct spdk_blob *blob, struct spdk_io_channel *_chan
 							 rw_iov_done, NULL);
 			}
 		} else {
-			if (is_allocated) {
+			if (is_allocated && !bs_cluster_is_shared(blob->bs, lba)) {
 				spdk_bs_sequence_t *seq;
 
 				seq = bs_sequence_start_blob(_channel, &cpl, blob);
@@ -3653,7 +4605,30 @@ bs_channel_create(void *io_device, void *ctx_buf)
 		return -1;
 	}
 
+	channel->cluster_alloc_mem = calloc(BS_MAX_CLUSTER_ALLOCS_PER_CHANNEL,
+					    sizeof(struct spdk_blob_copy_cluster_ctx));
+	if (!channel->cluster_alloc_mem) {
+		free(channel->req_mem);
+		spdk_free(channel->new_cluster_page);
+		channel->dev->destroy_channel(channel->dev, channel->dev_channel);
+		return -1;
+	}
+
+	TAILQ_INIT(&channel->free_cluster_allocs);
+	for (i = 0; i < BS_MAX_CLUSTER_ALLOCS_PER_CHANNEL; i++) {
+		TAILQ_INSERT_TAIL(&channel->free_cluster_allocs, &channel->cluster_alloc_mem[i], link);
+	}
+
+	channel->num_reserved_clusters = 0;
+	TAILQ_INIT(&channel->cluster_allocs);
+	channel->num_cluster_allocs = 0;
 	TAILQ_INIT(&channel->need_cluster_alloc);
+	channel->cow_buf_mem = NULL;
+	channel->num_cow_bufs = 0;
+	TAILQ_INIT(&channel->cow_waiting);
+	channel->cow_tokens = 0;
+	channel->cow_last_tsc = spdk_get_ticks();
+	channel->cow_poller = NULL;
 	TAILQ_INIT(&channel->queued_io);
 	RB_INIT(&channel->esnap_channels);
 
@@ -3664,8 +4639,17 @@ static void
 bs_channel_destroy(void *io_device, void *ctx_buf)
 {
 	struct spdk_bs_channel *channel = ctx_buf;
+	struct spdk_blob_copy_cluster_ctx *alloc;
 	spdk_bs_user_op_t *op;
 
+	TAILQ_FOREACH(alloc, &channel->cluster_allocs, link) {
+		while (!TAILQ_EMPTY(&alloc->ops)) {
+			op = TAILQ_FIRST(&alloc->ops);
+			TAILQ_REMOVE(&alloc->ops, op, link);
+			bs_user_op_abort(op, -EIO);
+		}
+	}
+
 	while (!TAILQ_EMPTY(&channel->need_cluster_alloc)) {
 		op = TAILQ_FIRST(&channel->need_cluster_alloc);
 		TAILQ_REMOVE(&channel->need_cluster_alloc, op, link);
@@ -3679,8 +4663,12 @@ bs_channel_destroy(void *io_device, void *ctx_buf)
 	}
 
 	blob_esnap_destroy_bs_channel(channel);
+	bs_channel_release_clusters(channel);
+	spdk_poller_unregister(&channel->cow_poller);
 
 	free(channel->req_mem);
+	free(channel->cluster_alloc_mem);
+	spdk_free(channel->cow_buf_mem);
 	spdk_free(channel->new_cluster_page);
 	channel->dev->destroy_channel(channel->dev, channel->dev_channel);
 }
@@ -3705,6 +4693,7 @@ bs_dev_destroy(void *io_device)
 	spdk_bit_array_free(&bs->used_blobids);
 	spdk_bit_array_free(&bs->used_md_pages);
 	spdk_bit_pool_free(&bs->used_clusters);
+	bs_free_cluster_refs(bs);
 	/*
 	 * If this function is called for any reason except a successful unload,
 	 * the unload_cpl type will be NONE and this will be a nop.
@@ -3871,6 +4860,18 @@ bs_opts_verify(struct spdk_bs_opts *opts)
 
 /* spdk_bs_load_ctx is used for init, load, unload and dump code paths. */
 
+struct spdk_bs_load_ctx;
+
+/* A range of the metadata region read ahead during recovery */
+struct spdk_bs_load_replay_window {
+	struct spdk_bs_load_ctx		*ctx;
+	/* Window number, the window starts at page num * BS_LOAD_REPLAY_WINDOW_PAGES */
+	uint32_t			num;
+	bool				reading;
+	int				rc;
+	struct spdk_blob_md_page	*pages;
+};
+
 struct spdk_bs_load_ctx {
 	struct spdk_blob_store		*bs;
 	struct spdk_bs_super_block	*super;
@@ -3881,6 +4882,15 @@ struct spdk_bs_load_ctx {
 	uint32_t			cur_page;
 	struct spdk_blob_md_page	*page;
 
+	struct spdk_bs_load_replay_window	windows[BS_LOAD_REPLAY_WINDOWS];
+	struct spdk_blob_md_page		*window_pages;
+	/* Lowest window number that has a slot in windows */
+	uint32_t				window_base;
+	uint32_t				windows_outstanding;
+	bool					window_wait;
+	bool					replay_done;
+	int					replay_rc;
+
 	uint64_t			num_extent_pages;
 	uint32_t			*extent_page_num;
 	struct spdk_blob_md_page	*extent_pages;
@@ -4028,6 +5038,10 @@ bs_write_super(spdk_bs_sequence_t *seq, struct spdk_blob_store *bs,
 	/* Update the values in the super block */
 	super->super_blob = bs->super_blob;
 	memcpy(&super->bstype, &bs->bstype, sizeof(bs->bstype));
+	if (bs->shared_clusters) {
+		/* Older versions would free clusters still referenced by other blobs */
+		super->version = SPDK_BS_VERSION_SHARED_CLUSTERS;
+	}
 	super->crc = blob_md_page_calc_crc(super);
 	bs_sequence_write_dev(seq, super, bs_page_to_lba(bs, 0),
 			      bs_byte_to_lba(bs, sizeof(*super)),
@@ -4479,11 +5493,34 @@ bs_load_read_used_pages(struct spdk_bs_load_ctx *ctx)
 }
 
 static int
-bs_load_replay_md_parse_page(struct spdk_bs_load_ctx *ctx, struct spdk_blob_md_page *page)
+bs_load_replay_claim_cluster(struct spdk_bs_load_ctx *ctx, uint32_t cluster_idx)
 {
 	struct spdk_blob_store *bs = ctx->bs;
+	int rc;
+
+	if (bs->shared_clusters && spdk_bit_array_get(ctx->used_clusters, cluster_idx)) {
+		/* The cluster is shared with a blob found earlier */
+		spdk_spin_lock(&bs->used_lock);
+		rc = bs_ref_cluster(bs, cluster_idx);
+		spdk_spin_unlock(&bs->used_lock);
+		return rc;
+	}
+
+	spdk_bit_array_set(ctx->used_clusters, cluster_idx);
+	if (bs->num_free_clusters == 0) {
+		return -ENOSPC;
+	}
+	bs->num_free_clusters--;
+
+	return 0;
+}
+
+static int
+bs_load_replay_md_parse_page(struct spdk_bs_load_ctx *ctx, struct spdk_blob_md_page *page)
+{
 	struct spdk_blob_md_descriptor *desc;
 	size_t	cur_desc = 0;
+	int rc;
 
 	desc = (struct spdk_blob_md_descriptor *)page->descriptors;
 	while (cur_desc < sizeof(page->descriptors)) {
@@ -4509,11 +5546,10 @@ bs_load_replay_md_parse_page(struct spdk_bs_load_ctx *ctx, struct spdk_blob_md_p
 					 */
 					if (cluster_idx != 0) {
 						SPDK_NOTICELOG("Recover: cluster %" PRIu32 "\n", cluster_idx + j);
-						spdk_bit_array_set(ctx->used_clusters, cluster_idx + j);
-						if (bs->num_free_clusters == 0) {
-							return -ENOSPC;
+						rc = bs_load_replay_claim_cluster(ctx, cluster_idx + j);
+						if (rc != 0) {
+							return rc;
 						}
-						bs->num_free_clusters--;
 					}
 					cluster_count++;
 				}
@@ -4547,11 +5583,10 @@ bs_load_replay_md_parse_page(struct spdk_bs_load_ctx *ctx, struct spdk_blob_md_p
 					    cluster_idx >= desc_extent->start_cluster_idx + cluster_count) {
 						return -EINVAL;
 					}
-					spdk_bit_array_set(ctx->used_clusters, cluster_idx);
-					if (bs->num_free_clusters == 0) {
-						return -ENOSPC;
+					rc = bs_load_replay_claim_cluster(ctx, cluster_idx);
+					if (rc != 0) {
+						return rc;
 					}
-					bs->num_free_clusters--;
 				}
 				cluster_count++;
 			}
@@ -4733,115 +5768,249 @@ bs_load_write_used_md(struct spdk_bs_load_ctx *ctx)
 	bs_write_used_md(ctx->seq, ctx, bs_load_write_used_pages_cpl);
 }
 
+/* Complete the replay once no read-ahead is in progress anymore */
 static void
-bs_load_replay_md_chain_cpl(struct spdk_bs_load_ctx *ctx)
+bs_load_replay_finish(struct spdk_bs_load_ctx *ctx, int bserrno)
 {
 	uint64_t num_md_clusters;
 	uint64_t i;
 
-	ctx->in_page_chain = false;
-
-	do {
-		ctx->page_index++;
-	} while (spdk_bit_array_get(ctx->bs->used_md_pages, ctx->page_index) == true);
-
-	if (ctx->page_index < ctx->super->md_len) {
-		ctx->cur_page = ctx->page_index;
-		bs_load_replay_cur_md_page(ctx);
-	} else {
-		/* Claim all of the clusters used by the metadata */
-		num_md_clusters = spdk_divide_round_up(
-					  ctx->super->md_start + ctx->super->md_len, ctx->bs->pages_per_cluster);
-		for (i = 0; i < num_md_clusters; i++) {
-			spdk_bit_array_set(ctx->used_clusters, i);
-		}
-		ctx->bs->num_free_clusters -= num_md_clusters;
-		spdk_free(ctx->page);
-		bs_load_write_used_md(ctx);
+	ctx->replay_done = true;
+	ctx->replay_rc = bserrno;
+	if (ctx->windows_outstanding > 0) {
+		return;
 	}
-}
 
-static void
-bs_load_replay_extent_page_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
-{
-	struct spdk_bs_load_ctx *ctx = cb_arg;
-	uint32_t page_num;
-	uint64_t i;
+	spdk_free(ctx->window_pages);
+	ctx->window_pages = NULL;
+	spdk_free(ctx->page);
+	ctx->page = NULL;
 
 	if (bserrno != 0) {
-		spdk_free(ctx->extent_pages);
 		bs_load_ctx_fail(ctx, bserrno);
 		return;
 	}
 
-	for (i = 0; i < ctx->num_extent_pages; i++) {
-		/* Extent pages are only read when present within in chain md.
-		 * Integrity of md is not right if that page was not a valid extent page. */
-		if (bs_load_cur_extent_page_valid(&ctx->extent_pages[i]) != true) {
-			spdk_free(ctx->extent_pages);
-			bs_load_ctx_fail(ctx, -EILSEQ);
-			return;
-		}
-
-		page_num = ctx->extent_page_num[i];
-		spdk_bit_array_set(ctx->bs->used_md_pages, page_num);
-		if (bs_load_replay_md_parse_page(ctx, &ctx->extent_pages[i])) {
-			spdk_free(ctx->extent_pages);
-			bs_load_ctx_fail(ctx, -EILSEQ);
-			return;
-		}
+	/* Claim all of the clusters used by the metadata */
+	num_md_clusters = spdk_divide_round_up(
+				  ctx->super->md_start + ctx->super->md_len, ctx->bs->pages_per_cluster);
+	for (i = 0; i < num_md_clusters; i++) {
+		spdk_bit_array_set(ctx->used_clusters, i);
 	}
+	ctx->bs->num_free_clusters -= num_md_clusters;
+	bs_load_write_used_md(ctx);
+}
 
-	spdk_free(ctx->extent_pages);
-	free(ctx->extent_page_num);
-	ctx->extent_page_num = NULL;
-	ctx->num_extent_pages = 0;
+static void bs_load_replay_window_cpl(void *cb_arg, int bserrno);
 
-	bs_load_replay_md_chain_cpl(ctx);
+static void
+bs_load_replay_window_read_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	bs_sequence_finish(seq, bserrno);
 }
 
 static void
-bs_load_replay_extent_pages(struct spdk_bs_load_ctx *ctx)
+bs_load_replay_window_read(struct spdk_bs_load_ctx *ctx, uint32_t num)
 {
-	spdk_bs_batch_t *batch;
-	uint32_t page;
-	uint64_t lba;
-	uint64_t i;
+	struct spdk_bs_load_replay_window *window = &ctx->windows[num % BS_LOAD_REPLAY_WINDOWS];
+	uint64_t start = (uint64_t)num * BS_LOAD_REPLAY_WINDOW_PAGES;
+	uint64_t num_pages;
+	struct spdk_bs_cpl cpl;
+	spdk_bs_sequence_t *seq;
 
-	ctx->extent_pages = spdk_zmalloc(SPDK_BS_PAGE_SIZE * ctx->num_extent_pages, 0,
-					 NULL, SPDK_ENV_NUMA_ID_ANY, SPDK_MALLOC_DMA);
-	if (!ctx->extent_pages) {
-		bs_load_ctx_fail(ctx, -ENOMEM);
+	assert(!window->reading);
+	window->num = num;
+	window->rc = -ENOENT;
+	if (start >= ctx->super->md_len) {
 		return;
 	}
 
-	batch = bs_sequence_to_batch(ctx->seq, bs_load_replay_extent_page_cpl, ctx);
+	cpl.type = SPDK_BS_CPL_TYPE_BS_BASIC;
+	cpl.u.bs_basic.cb_fn = bs_load_replay_window_cpl;
+	cpl.u.bs_basic.cb_arg = window;
 
-	for (i = 0; i < ctx->num_extent_pages; i++) {
-		page = ctx->extent_page_num[i];
-		assert(page < ctx->super->md_len);
-		lba = bs_md_page_to_lba(ctx->bs, page);
-		bs_batch_read_dev(batch, &ctx->extent_pages[i], lba,
-				  bs_byte_to_lba(ctx->bs, SPDK_BS_PAGE_SIZE));
+	seq = bs_sequence_start_bs(ctx->bs->md_channel, &cpl);
+	if (!seq) {
+		/* The pages of the window will be read one by one */
+		return;
 	}
 
-	bs_batch_close(batch);
+	num_pages = spdk_min(BS_LOAD_REPLAY_WINDOW_PAGES, ctx->super->md_len - start);
+	window->reading = true;
+	ctx->windows_outstanding++;
+	bs_sequence_read_dev(seq, window->pages, bs_md_page_to_lba(ctx->bs, start),
+			     bs_byte_to_lba(ctx->bs, num_pages * SPDK_BS_PAGE_SIZE),
+			     bs_load_replay_window_read_cpl, window);
 }
 
+/* Reuse the slots of the windows that the scan of the metadata region is done with */
 static void
-bs_load_replay_md_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+bs_load_replay_window_advance(struct spdk_bs_load_ctx *ctx)
 {
-	struct spdk_bs_load_ctx *ctx = cb_arg;
-	uint32_t page_num;
-	struct spdk_blob_md_page *page;
+	uint32_t num = ctx->page_index / BS_LOAD_REPLAY_WINDOW_PAGES;
 
-	if (bserrno != 0) {
-		bs_load_ctx_fail(ctx, bserrno);
+	while (ctx->window_base < num) {
+		if (ctx->windows[ctx->window_base % BS_LOAD_REPLAY_WINDOWS].reading) {
+			break;
+		}
+		ctx->window_base++;
+		bs_load_replay_window_read(ctx, ctx->window_base + BS_LOAD_REPLAY_WINDOWS - 1);
+	}
+}
+
+/* Return the page if it has been read ahead, set pending if it is being read */
+static struct spdk_blob_md_page *
+bs_load_replay_window_page(struct spdk_bs_load_ctx *ctx, uint32_t page, bool *pending)
+{
+	uint32_t num = page / BS_LOAD_REPLAY_WINDOW_PAGES;
+	struct spdk_bs_load_replay_window *window = &ctx->windows[num % BS_LOAD_REPLAY_WINDOWS];
+
+	*pending = false;
+	if (num < ctx->window_base || num >= ctx->window_base + BS_LOAD_REPLAY_WINDOWS ||
+	    window->num != num) {
+		return NULL;
+	}
+
+	if (window->reading) {
+		*pending = true;
+		return NULL;
+	}
+
+	return window->rc == 0 ? &window->pages[page % BS_LOAD_REPLAY_WINDOW_PAGES] : NULL;
+}
+
+static void
+bs_load_replay_window_cpl(void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_replay_window *window = cb_arg;
+	struct spdk_bs_load_ctx *ctx = window->ctx;
+
+	assert(ctx->windows_outstanding > 0);
+	ctx->windows_outstanding--;
+	window->reading = false;
+	/* A page of a window that failed to be read is read again on its own */
+	window->rc = bserrno;
+
+	if (ctx->replay_done) {
+		if (ctx->windows_outstanding == 0) {
+			bs_load_replay_finish(ctx, ctx->replay_rc);
+		}
+		return;
+	}
+
+	bs_load_replay_window_advance(ctx);
+
+	if (ctx->window_wait) {
+		ctx->window_wait = false;
+		bs_load_replay_cur_md_page(ctx);
+	}
+}
+
+/* Move on to the next page that is not claimed yet, return false once all of them are done */
+static bool
+bs_load_replay_md_next(struct spdk_bs_load_ctx *ctx)
+{
+	ctx->in_page_chain = false;
+
+	do {
+		ctx->page_index++;
+	} while (spdk_bit_array_get(ctx->bs->used_md_pages, ctx->page_index) == true);
+
+	if (ctx->page_index >= ctx->super->md_len) {
+		bs_load_replay_finish(ctx, 0);
+		return false;
+	}
+
+	ctx->cur_page = ctx->page_index;
+	bs_load_replay_window_advance(ctx);
+	return true;
+}
+
+static void
+bs_load_replay_md_chain_cpl(struct spdk_bs_load_ctx *ctx)
+{
+	if (bs_load_replay_md_next(ctx)) {
+		bs_load_replay_cur_md_page(ctx);
+	}
+}
+
+static void
+bs_load_replay_extent_page_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx *ctx = cb_arg;
+	uint32_t page_num;
+	uint64_t i;
+
+	if (bserrno != 0) {
+		spdk_free(ctx->extent_pages);
+		bs_load_replay_finish(ctx, bserrno);
+		return;
+	}
+
+	for (i = 0; i < ctx->num_extent_pages; i++) {
+		/* Extent pages are only read when present within in chain md.
+		 * Integrity of md is not right if that page was not a valid extent page. */
+		if (bs_load_cur_extent_page_valid(&ctx->extent_pages[i]) != true) {
+			spdk_free(ctx->extent_pages);
+			bs_load_replay_finish(ctx, -EILSEQ);
+			return;
+		}
+
+		page_num = ctx->extent_page_num[i];
+		spdk_bit_array_set(ctx->bs->used_md_pages, page_num);
+		if (bs_load_replay_md_parse_page(ctx, &ctx->extent_pages[i])) {
+			spdk_free(ctx->extent_pages);
+			bs_load_replay_finish(ctx, -EILSEQ);
+			return;
+		}
+	}
+
+	spdk_free(ctx->extent_pages);
+	free(ctx->extent_page_num);
+	ctx->extent_page_num = NULL;
+	ctx->num_extent_pages = 0;
+
+	bs_load_replay_md_chain_cpl(ctx);
+}
+
+static void
+bs_load_replay_extent_pages(struct spdk_bs_load_ctx *ctx)
+{
+	spdk_bs_batch_t *batch;
+	uint32_t page;
+	uint64_t lba;
+	uint64_t i;
+
+	ctx->extent_pages = spdk_zmalloc(SPDK_BS_PAGE_SIZE * ctx->num_extent_pages, 0,
+					 NULL, SPDK_ENV_NUMA_ID_ANY, SPDK_MALLOC_DMA);
+	if (!ctx->extent_pages) {
+		bs_load_replay_finish(ctx, -ENOMEM);
 		return;
 	}
 
-	page_num = ctx->cur_page;
-	page = ctx->page;
+	batch = bs_sequence_to_batch(ctx->seq, bs_load_replay_extent_page_cpl, ctx);
+
+	for (i = 0; i < ctx->num_extent_pages; i++) {
+		page = ctx->extent_page_num[i];
+		assert(page < ctx->super->md_len);
+		lba = bs_md_page_to_lba(ctx->bs, page);
+		bs_batch_read_dev(batch, &ctx->extent_pages[i], lba,
+				  bs_byte_to_lba(ctx->bs, SPDK_BS_PAGE_SIZE));
+	}
+
+	bs_batch_close(batch);
+}
+
+/*
+ * Replay the page at cur_page, which is in ctx->page. Returns 0 if the replay continues
+ * with cur_page, a positive value if it continues asynchronously, or a negative errno.
+ */
+static int
+bs_load_replay_md_page(struct spdk_bs_load_ctx *ctx)
+{
+	uint32_t page_num = ctx->cur_page;
+	struct spdk_blob_md_page *page = ctx->page;
+
 	if (bs_load_cur_md_page_valid(ctx) == true) {
 		if (page->sequence_num == 0 || ctx->in_page_chain == true) {
 			spdk_spin_lock(&ctx->bs->used_lock);
@@ -4852,28 +6021,67 @@ bs_load_replay_md_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 				spdk_bit_array_set(ctx->bs->used_blobids, page_num);
 			}
 			if (bs_load_replay_md_parse_page(ctx, page)) {
-				bs_load_ctx_fail(ctx, -EILSEQ);
-				return;
+				return -EILSEQ;
 			}
 			if (page->next != SPDK_INVALID_MD_PAGE) {
 				ctx->in_page_chain = true;
 				ctx->cur_page = page->next;
-				bs_load_replay_cur_md_page(ctx);
-				return;
+				return 0;
 			}
 			if (ctx->num_extent_pages != 0) {
 				bs_load_replay_extent_pages(ctx);
-				return;
+				return 1;
 			}
 		}
 	}
-	bs_load_replay_md_chain_cpl(ctx);
+
+	return bs_load_replay_md_next(ctx) ? 0 : 1;
+}
+
+static void
+bs_load_replay_md_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_ctx *ctx = cb_arg;
+	int rc;
+
+	if (bserrno != 0) {
+		bs_load_replay_finish(ctx, bserrno);
+		return;
+	}
+
+	rc = bs_load_replay_md_page(ctx);
+	if (rc < 0) {
+		bs_load_replay_finish(ctx, rc);
+	} else if (rc == 0) {
+		bs_load_replay_cur_md_page(ctx);
+	}
 }
 
 static void
 bs_load_replay_cur_md_page(struct spdk_bs_load_ctx *ctx)
 {
+	struct spdk_blob_md_page *page;
+	bool pending;
 	uint64_t lba;
+	int rc;
+
+	/* Replay the pages that were read ahead without going back to the device */
+	while ((page = bs_load_replay_window_page(ctx, ctx->cur_page, &pending)) != NULL) {
+		memcpy(ctx->page, page, sizeof(*page));
+		rc = bs_load_replay_md_page(ctx);
+		if (rc != 0) {
+			if (rc < 0) {
+				bs_load_replay_finish(ctx, rc);
+			}
+			return;
+		}
+	}
+
+	if (pending) {
+		/* Continues once the window with the page is read */
+		ctx->window_wait = true;
+		return;
+	}
 
 	assert(ctx->cur_page < ctx->super->md_len);
 	lba = bs_md_page_to_lba(ctx->bs, ctx->cur_page);
@@ -4882,9 +6090,16 @@ bs_load_replay_cur_md_page(struct spdk_bs_load_ctx *ctx)
 			     bs_load_replay_md_cpl, ctx);
 }
 
+/*
+ * Replay the metadata of a blobstore that was not cleanly unloaded. The metadata region
+ * is scanned in page order, BS_LOAD_REPLAY_WINDOWS windows of pages are read ahead of the
+ * scan, and only the pages of md chains outside of them are read one by one.
+ */
 static void
 bs_load_replay_md(struct spdk_bs_load_ctx *ctx)
 {
+	uint32_t i;
+
 	ctx->page_index = 0;
 	ctx->cur_page = 0;
 	ctx->page = spdk_zmalloc(SPDK_BS_PAGE_SIZE, 0,
@@ -4893,6 +6108,24 @@ bs_load_replay_md(struct spdk_bs_load_ctx *ctx)
 		bs_load_ctx_fail(ctx, -ENOMEM);
 		return;
 	}
+
+	ctx->window_pages = spdk_zmalloc((size_t)BS_LOAD_REPLAY_WINDOWS * BS_LOAD_REPLAY_WINDOW_PAGES *
+					 SPDK_BS_PAGE_SIZE, 0, NULL, SPDK_ENV_NUMA_ID_ANY,
+					 SPDK_MALLOC_DMA);
+	if (!ctx->window_pages) {
+		spdk_free(ctx->page);
+		ctx->page = NULL;
+		bs_load_ctx_fail(ctx, -ENOMEM);
+		return;
+	}
+
+	ctx->window_base = 0;
+	for (i = 0; i < BS_LOAD_REPLAY_WINDOWS; i++) {
+		ctx->windows[i].ctx = ctx;
+		ctx->windows[i].pages = &ctx->window_pages[i * BS_LOAD_REPLAY_WINDOW_PAGES];
+		bs_load_replay_window_read(ctx, i);
+	}
+
 	bs_load_replay_cur_md_page(ctx);
 }
 
@@ -4944,6 +6177,7 @@ bs_parse_super(struct spdk_bs_load_ctx *ctx)
 	}
 
 	ctx->bs->clean = 1;
+	ctx->bs->shared_clusters = ctx->super->version >= SPDK_BS_VERSION_SHARED_CLUSTERS;
 	ctx->bs->cluster_sz = ctx->super->cluster_size;
 	ctx->bs->total_clusters = ctx->super->size / ctx->super->cluster_size;
 	ctx->bs->pages_per_cluster = ctx->bs->cluster_sz / SPDK_BS_PAGE_SIZE;
@@ -4988,7 +6222,9 @@ bs_load_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 		return;
 	}
 
-	if (ctx->super->used_blobid_mask_len == 0 || ctx->super->clean == 0 || ctx->force_recover) {
+	/* The reference counts of shared clusters are rebuilt from the metadata by the recovery */
+	if (ctx->super->used_blobid_mask_len == 0 || ctx->super->clean == 0 || ctx->force_recover ||
+	    ctx->bs->shared_clusters) {
 		bs_recover(ctx);
 	} else {
 		bs_load_read_used_pages(ctx);
@@ -5826,6 +7062,14 @@ bs_unload_write_used_clusters_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bse
 
 	ctx->super->clean = 1;
 
+	if (ctx->bs->shared_clusters && ctx->bs->num_saved_clusters == 0) {
+		/* No cluster is shared anymore, so the reference counts don't need to be
+		 * rebuilt by the next load.
+		 */
+		ctx->bs->shared_clusters = false;
+		ctx->super->version = SPDK_BS_VERSION;
+	}
+
 	bs_write_super(seq, ctx->bs, ctx->super, bs_unload_write_super_cpl, ctx);
 }
 
@@ -5881,6 +7125,20 @@ bs_unload_read_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 	bs_write_used_md(seq, cb_arg, bs_unload_write_used_pages_cpl);
 }
 
+static void
+bs_unload_release_reserved_clusters_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct spdk_bs_load_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_blob_store *bs = ctx->bs;
+
+	assert(bs->num_reserved_clusters == 0);
+
+	/* Read super block */
+	bs_sequence_read_dev(ctx->seq, ctx->super, bs_page_to_lba(bs, 0),
+			     bs_byte_to_lba(bs, sizeof(*ctx->super)),
+			     bs_unload_read_super_cpl, ctx);
+}
+
 void
 spdk_bs_unload(struct spdk_blob_store *bs, spdk_bs_op_complete cb_fn, void *cb_arg)
 {
@@ -5947,10 +7205,10 @@ spdk_bs_unload(struct spdk_blob_store *bs, spdk_bs_op_complete cb_fn, void *cb_a
 		return;
 	}
 
-	/* Read super block */
-	bs_sequence_read_dev(ctx->seq, ctx->super, bs_page_to_lba(bs, 0),
-			     bs_byte_to_lba(bs, sizeof(*ctx->super)),
-			     bs_unload_read_super_cpl, ctx);
+	/* Return the clusters reserved by the channels that are still around,
+	 * so that they are not persisted as used in the cluster mask. */
+	spdk_for_each_channel(bs, bs_channel_release_clusters_iter, ctx,
+			      bs_unload_release_reserved_clusters_done);
 }
 
 /* END spdk_bs_unload */
@@ -6084,7 +7342,43 @@ spdk_bs_get_io_unit_size(struct spdk_blob_store *bs)
 uint64_t
 spdk_bs_free_cluster_count(struct spdk_blob_store *bs)
 {
-	return bs->num_free_clusters;
+	/* Clusters reserved by the channels are not used by any blob yet */
+	return bs->num_free_clusters + __atomic_load_n(&bs->num_reserved_clusters, __ATOMIC_RELAXED);
+}
+
+uint64_t
+spdk_bs_saved_cluster_count(struct spdk_blob_store *bs)
+{
+	uint64_t num_saved_clusters;
+
+	spdk_spin_lock(&bs->used_lock);
+	num_saved_clusters = bs->num_saved_clusters;
+	spdk_spin_unlock(&bs->used_lock);
+
+	return num_saved_clusters;
+}
+
+uint64_t
+spdk_bs_find_free_clusters(struct spdk_blob_store *bs, uint64_t start_cluster,
+			   uint64_t num_clusters)
+{
+	uint32_t cluster;
+
+	if (start_cluster >= bs->total_clusters || num_clusters > bs->total_clusters) {
+		return UINT64_MAX;
+	}
+
+	spdk_spin_lock(&bs->used_lock);
+	cluster = spdk_bit_pool_find_free_range(bs->used_clusters, start_cluster, num_clusters);
+	spdk_spin_unlock(&bs->used_lock);
+
+	return cluster == UINT32_MAX ? UINT64_MAX : cluster;
+}
+
+void
+spdk_bs_set_cow_bandwidth_limit(struct spdk_blob_store *bs, uint64_t bytes_per_sec)
+{
+	bs->cow_bw_limit = bytes_per_sec;
 }
 
 uint64_t
@@ -6153,6 +7447,51 @@ spdk_blob_get_num_allocated_clusters(struct spdk_blob *blob)
 	return blob->active.num_allocated_clusters;
 }
 
+uint64_t
+spdk_blob_get_num_fragments(struct spdk_blob *blob)
+{
+	uint64_t lba_per_cluster = bs_cluster_to_lba(blob->bs, 1);
+	uint64_t i, prev_lba = 0, num_fragments = 0;
+
+	assert(blob != NULL);
+
+	for (i = 0; i < blob->active.num_clusters; i++) {
+		if (blob->active.clusters[i] == 0) {
+			continue;
+		}
+		if (prev_lba == 0 || blob->active.clusters[i] != prev_lba + lba_per_cluster) {
+			num_fragments++;
+		}
+		prev_lba = blob->active.clusters[i];
+	}
+
+	return num_fragments;
+}
+
+uint64_t
+spdk_blob_get_cluster_location(struct spdk_blob *blob, uint64_t cluster_num)
+{
+	assert(blob != NULL);
+
+	if (cluster_num >= blob->active.num_clusters || blob->active.clusters[cluster_num] == 0) {
+		return UINT64_MAX;
+	}
+
+	return bs_lba_to_cluster(blob->bs, blob->active.clusters[cluster_num]);
+}
+
+bool
+spdk_blob_is_cluster_shared(struct spdk_blob *blob, uint64_t cluster_num)
+{
+	assert(blob != NULL);
+
+	if (cluster_num >= blob->active.num_clusters) {
+		return false;
+	}
+
+	return bs_cluster_is_shared(blob->bs, blob->active.clusters[cluster_num]);
+}
+
 static uint64_t
 blob_find_io_unit(struct spdk_blob *blob, uint64_t offset, bool is_allocated)
 {
@@ -6181,6 +7520,39 @@ spdk_blob_get_next_unallocated_io_unit(struct spdk_blob *blob, uint64_t offset)
 	return blob_find_io_unit(blob, offset, false);
 }
 
+static bool
+blob_cluster_changed(struct spdk_blob *blob, spdk_blob_id base_id, uint64_t cluster_num)
+{
+	while (true) {
+		if (cluster_num < blob->active.num_clusters && blob->active.clusters[cluster_num] != 0) {
+			return true;
+		}
+
+		if (blob->parent_id == base_id || blob->parent_id == SPDK_BLOBID_INVALID ||
+		    blob->parent_id == SPDK_BLOBID_EXTERNAL_SNAPSHOT) {
+			return false;
+		}
+
+		/* Snapshots of an open blob are open as well */
+		blob = ((struct spdk_blob_bs_dev *)blob->back_bs_dev)->blob;
+	}
+}
+
+uint64_t
+spdk_blob_get_next_changed_cluster(struct spdk_blob *blob, spdk_blob_id base_id,
+				   uint64_t cluster_num)
+{
+	assert(blob != NULL);
+
+	for (; cluster_num < blob->active.num_clusters; cluster_num++) {
+		if (blob_cluster_changed(blob, base_id, cluster_num)) {
+			return cluster_num;
+		}
+	}
+
+	return UINT64_MAX;
+}
+
 /* START spdk_bs_create_blob */
 
 static void
@@ -6247,29 +7619,107 @@ blob_opts_copy(const struct spdk_blob_opts *src, struct spdk_blob_opts *dst)
 	SET_FIELD(use_extent_table);
 	SET_FIELD(esnap_id);
 	SET_FIELD(esnap_id_len);
+	SET_FIELD(cow_unit_size);
 
 	dst->opts_size = src->opts_size;
 
 	/* You should not remove this statement, but need to update the assert statement
 	 * if you add a new field, and also add a corresponding SET_FIELD statement */
-	SPDK_STATIC_ASSERT(sizeof(struct spdk_blob_opts) == 80, "Incorrect size");
+	SPDK_STATIC_ASSERT(sizeof(struct spdk_blob_opts) == 88, "Incorrect size");
 
 #undef FIELD_OK
 #undef SET_FIELD
 }
 
 static void
-bs_create_blob(struct spdk_blob_store *bs,
-	       const struct spdk_blob_opts *opts,
-	       const struct spdk_blob_xattr_opts *internal_xattrs,
-	       spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
+bs_create_blob_fail(struct spdk_blob_store *bs, struct spdk_blob *blob, uint32_t page_idx,
+		    uint64_t num_clusters, int rc, spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
 {
-	struct spdk_blob	*blob;
-	uint32_t		page_idx;
-	struct spdk_bs_cpl	cpl;
+	SPDK_ERRLOG("Failed to create blob: %s, size in clusters/size: %lu (clusters)\n",
+		    spdk_strerror(rc), num_clusters);
+	if (blob != NULL) {
+		blob_free(blob);
+	}
+	spdk_spin_lock(&bs->used_lock);
+	spdk_bit_array_clear(bs->used_blobids, page_idx);
+	bs_release_md_page(bs, page_idx);
+	spdk_spin_unlock(&bs->used_lock);
+	cb_fn(cb_arg, 0, rc);
+}
+
+struct spdk_bs_create_resize_ctx {
+	struct spdk_blob		*blob;
+	uint64_t			num_clusters;
+	spdk_blob_op_with_id_complete	cb_fn;
+	void				*cb_arg;
+};
+
+static void bs_create_blob_resize(struct spdk_blob *blob, uint64_t num_clusters,
+				  bool release_reserves, spdk_blob_op_with_id_complete cb_fn,
+				  void *cb_arg);
+
+static void
+bs_create_blob_reserves_released(struct spdk_io_channel_iter *i, int status)
+{
+	struct spdk_bs_create_resize_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	bs_create_blob_resize(ctx->blob, ctx->num_clusters, false, ctx->cb_fn, ctx->cb_arg);
+	free(ctx);
+}
+
+static void
+bs_create_blob_resize(struct spdk_blob *blob, uint64_t num_clusters, bool release_reserves,
+		      spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
+{
+	struct spdk_blob_store *bs = blob->bs;
+	struct spdk_bs_create_resize_ctx *ctx;
+	struct spdk_bs_cpl cpl;
+	spdk_bs_sequence_t *seq;
+	int rc;
+
+	rc = blob_resize(blob, num_clusters);
+	if (rc == -ENOSPC && release_reserves && bs_has_reserved_clusters(bs)) {
+		ctx = calloc(1, sizeof(*ctx));
+		if (ctx != NULL) {
+			ctx->blob = blob;
+			ctx->num_clusters = num_clusters;
+			ctx->cb_fn = cb_fn;
+			ctx->cb_arg = cb_arg;
+			spdk_for_each_channel(bs, bs_channel_release_clusters_iter, ctx,
+					      bs_create_blob_reserves_released);
+			return;
+		}
+	}
+	if (rc < 0) {
+		bs_create_blob_fail(bs, blob, bs_blobid_to_page(blob->id), num_clusters, rc, cb_fn, cb_arg);
+		return;
+	}
+
+	cpl.type = SPDK_BS_CPL_TYPE_BLOBID;
+	cpl.u.blobid.cb_fn = cb_fn;
+	cpl.u.blobid.cb_arg = cb_arg;
+	cpl.u.blobid.blobid = blob->id;
+
+	seq = bs_sequence_start_bs(bs->md_channel, &cpl);
+	if (!seq) {
+		bs_create_blob_fail(bs, blob, bs_blobid_to_page(blob->id), num_clusters, -ENOMEM,
+				    cb_fn, cb_arg);
+		return;
+	}
+
+	blob_persist(seq, blob, bs_create_blob_cpl, blob);
+}
+
+static void
+bs_create_blob(struct spdk_blob_store *bs,
+	       const struct spdk_blob_opts *opts,
+	       const struct spdk_blob_xattr_opts *internal_xattrs,
+	       spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
+{
+	struct spdk_blob	*blob;
+	uint32_t		page_idx;
 	struct spdk_blob_opts	opts_local;
 	struct spdk_blob_xattr_opts internal_xattrs_default;
-	spdk_bs_sequence_t	*seq;
 	spdk_blob_id		id;
 	int rc;
 
@@ -6344,35 +7794,18 @@ bs_create_blob(struct spdk_blob_store *bs,
 		}
 	}
 
-	rc = blob_resize(blob, opts_local.num_clusters);
-	if (rc < 0) {
-		goto error;
-	}
-	cpl.type = SPDK_BS_CPL_TYPE_BLOBID;
-	cpl.u.blobid.cb_fn = cb_fn;
-	cpl.u.blobid.cb_arg = cb_arg;
-	cpl.u.blobid.blobid = blob->id;
-
-	seq = bs_sequence_start_bs(bs->md_channel, &cpl);
-	if (!seq) {
-		rc = -ENOMEM;
-		goto error;
+	if (opts_local.cow_unit_size != 0) {
+		rc = blob_cow_units_enable(blob, opts_local.cow_unit_size);
+		if (rc != 0) {
+			goto error;
+		}
 	}
 
-	blob_persist(seq, blob, bs_create_blob_cpl, blob);
+	bs_create_blob_resize(blob, opts_local.num_clusters, true, cb_fn, cb_arg);
 	return;
 
 error:
-	SPDK_ERRLOG("Failed to create blob: %s, size in clusters/size: %lu (clusters)\n",
-		    spdk_strerror(rc), opts_local.num_clusters);
-	if (blob != NULL) {
-		blob_free(blob);
-	}
-	spdk_spin_lock(&bs->used_lock);
-	spdk_bit_array_clear(bs->used_blobids, page_idx);
-	bs_release_md_page(bs, page_idx);
-	spdk_spin_unlock(&bs->used_lock);
-	cb_fn(cb_arg, 0, rc);
+	bs_create_blob_fail(bs, blob, page_idx, opts_local.num_clusters, rc, cb_fn, cb_arg);
 }
 
 void
@@ -6408,6 +7841,11 @@ enum blob_inflate_type {
 	   filled if not allocated in the parent.
 	 */
 	BLOB_INFLATE_ALLOCATE_ALL,
+	/*
+	 * Stay with the parent, copy the units of partially copied clusters that are still
+	   only in the parent.
+	 */
+	BLOB_INFLATE_ALLOCATE_COW_UNITS,
 };
 
 struct spdk_clone_snapshot_ctx {
@@ -6542,11 +7980,22 @@ bs_snapshot_swap_cluster_maps(struct spdk_blob *blob1, struct spdk_blob *blob2)
 	uint64_t *cluster_temp;
 	uint64_t num_allocated_clusters_temp;
 	uint32_t *extent_page_temp;
+	size_t cow_units_size_temp;
 
 	cluster_temp = blob1->active.clusters;
 	blob1->active.clusters = blob2->active.clusters;
 	blob2->active.clusters = cluster_temp;
 
+	/* Neither blob has partially copied clusters, only the arrays sized for them move */
+	assert(blob1->cow_unit_size == blob2->cow_unit_size);
+	cluster_temp = blob1->cow_units;
+	blob1->cow_units = blob2->cow_units;
+	blob2->cow_units = cluster_temp;
+
+	cow_units_size_temp = blob1->cow_units_array_size;
+	blob1->cow_units_array_size = blob2->cow_units_array_size;
+	blob2->cow_units_array_size = cow_units_size_temp;
+
 	num_allocated_clusters_temp = blob1->active.num_allocated_clusters;
 	blob1->active.num_allocated_clusters = blob2->active.num_allocated_clusters;
 	blob2->active.num_allocated_clusters = num_allocated_clusters_temp;
@@ -6700,6 +8149,13 @@ bs_snapshot_freeze_cpl(void *cb_arg, int rc)
 
 	ctx->frozen = true;
 
+	if (blob_has_cow_units(origblob)) {
+		/* A write may have partially copied a cluster since the blob was opened */
+		SPDK_ERRLOG("Cannot snapshot a blob whose clusters are not entirely copied.\n");
+		bs_clone_snapshot_newblob_cleanup(ctx, -EBUSY);
+		return;
+	}
+
 	if (blob_is_esnap_clone(origblob)) {
 		/* Clean up any channels associated with the original blob id because future IO will
 		 * perform IO using the snapshot blob_id.
@@ -6827,6 +8283,15 @@ bs_snapshot_origblob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno
 		return;
 	}
 
+	if (blob_has_cow_units(_blob)) {
+		/* The snapshot would be read-only and could never complete them, which would keep
+		 * it from being deleted.  They have to be filled first. */
+		SPDK_ERRLOG("Cannot snapshot a blob whose clusters are not entirely copied.\n");
+		ctx->bserrno = -EBUSY;
+		spdk_blob_close(_blob, bs_clone_snapshot_cleanup_finish, ctx);
+		return;
+	}
+
 	_blob->locked_operation_in_progress = true;
 
 	spdk_blob_opts_init(&opts, sizeof(opts));
@@ -6837,6 +8302,7 @@ bs_snapshot_origblob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno
 	opts.thin_provision = true;
 	opts.num_clusters = spdk_blob_get_num_clusters(_blob);
 	opts.use_extent_table = _blob->use_extent_table;
+	opts.cow_unit_size = _blob->cow_unit_size;
 
 	/* If there are any xattrs specified for snapshot, set them now */
 	if (ctx->xattrs) {
@@ -6948,6 +8414,7 @@ bs_clone_origblob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
 	opts.thin_provision = true;
 	opts.num_clusters = spdk_blob_get_num_clusters(_blob);
 	opts.use_extent_table = _blob->use_extent_table;
+	opts.cow_unit_size = _blob->cow_unit_size;
 	if (ctx->xattrs) {
 		memcpy(&opts.xattrs, ctx->xattrs, sizeof(*ctx->xattrs));
 	}
@@ -7027,6 +8494,11 @@ bs_inflate_blob_done(struct spdk_clone_snapshot_ctx *ctx)
 	struct spdk_blob *_blob = ctx->original.blob;
 	struct spdk_blob *_parent;
 
+	if (ctx->allocate_type == BLOB_INFLATE_ALLOCATE_COW_UNITS) {
+		bs_clone_snapshot_origblob_cleanup(ctx, 0);
+		return;
+	}
+
 	if (ctx->allocate_type == BLOB_INFLATE_ALLOCATE_ALL) {
 		/* remove thin provisioning */
 		bs_blob_list_remove(_blob);
@@ -7074,8 +8546,8 @@ bs_cluster_needs_allocation(struct spdk_blob *blob, uint64_t cluster, bool alloc
 	assert(blob != NULL);
 
 	if (blob->active.clusters[cluster] != 0) {
-		/* Cluster is already allocated */
-		return false;
+		/* Cluster is already allocated, but part of it may still be only in the parent */
+		return bs_cluster_cow_units(blob, cluster) != 0;
 	}
 
 	if (blob->parent_id == SPDK_BLOBID_INVALID) {
@@ -7091,6 +8563,19 @@ bs_cluster_needs_allocation(struct spdk_blob *blob, uint64_t cluster, bool alloc
 	return (allocate_all || b->blob->active.clusters[cluster] != 0);
 }
 
+static bool
+bs_inflate_cluster_needs_copy(struct spdk_clone_snapshot_ctx *ctx, uint64_t cluster)
+{
+	struct spdk_blob *blob = ctx->original.blob;
+
+	if (ctx->allocate_type == BLOB_INFLATE_ALLOCATE_COW_UNITS) {
+		return blob->active.clusters[cluster] != 0 && bs_cluster_cow_units(blob, cluster) != 0;
+	}
+
+	return bs_cluster_needs_allocation(blob, cluster,
+					   ctx->allocate_type == BLOB_INFLATE_ALLOCATE_ALL);
+}
+
 static void
 bs_inflate_blob_touch_next(void *cb_arg, int bserrno)
 {
@@ -7106,8 +8591,7 @@ bs_inflate_blob_touch_next(void *cb_arg, int bserrno)
 	}
 
 	for (; ctx->cluster < _blob->active.num_clusters; ctx->cluster++) {
-		if (bs_cluster_needs_allocation(_blob, ctx->cluster,
-						ctx->allocate_type == BLOB_INFLATE_ALLOCATE_ALL)) {
+		if (bs_inflate_cluster_needs_copy(ctx, ctx->cluster)) {
 			break;
 		}
 	}
@@ -7136,13 +8620,52 @@ bs_inflate_blob_touch_next(void *cb_arg, int bserrno)
 	}
 }
 
+static void bs_inflate_blob_allocate(struct spdk_clone_snapshot_ctx *ctx, bool release_reserves);
+
 static void
-bs_inflate_blob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
+bs_inflate_blob_reserves_released(struct spdk_io_channel_iter *i, int status)
 {
-	struct spdk_clone_snapshot_ctx *ctx = (struct spdk_clone_snapshot_ctx *)cb_arg;
+	bs_inflate_blob_allocate(spdk_io_channel_iter_get_ctx(i), false);
+}
+
+static void
+bs_inflate_blob_allocate(struct spdk_clone_snapshot_ctx *ctx, bool release_reserves)
+{
+	struct spdk_blob *_blob = ctx->original.blob;
 	uint64_t clusters_needed;
 	uint64_t i;
 
+	/* Do two passes - one to verify that we can obtain enough clusters
+	 * and another to actually claim them.
+	 */
+	clusters_needed = 0;
+	for (i = 0; i < _blob->active.num_clusters; i++) {
+		if (_blob->active.clusters[i] == 0 &&
+		    bs_cluster_needs_allocation(_blob, i, ctx->allocate_type == BLOB_INFLATE_ALLOCATE_ALL)) {
+			clusters_needed++;
+		}
+	}
+
+	if (clusters_needed > _blob->bs->num_free_clusters) {
+		if (release_reserves && bs_has_reserved_clusters(_blob->bs)) {
+			spdk_for_each_channel(_blob->bs, bs_channel_release_clusters_iter, ctx,
+					      bs_inflate_blob_reserves_released);
+			return;
+		}
+		/* Not enough free clusters. Cannot satisfy the request. */
+		bs_clone_snapshot_origblob_cleanup(ctx, -ENOSPC);
+		return;
+	}
+
+	ctx->cluster = 0;
+	bs_inflate_blob_touch_next(ctx, 0);
+}
+
+static void
+bs_inflate_blob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
+{
+	struct spdk_clone_snapshot_ctx *ctx = (struct spdk_clone_snapshot_ctx *)cb_arg;
+
 	if (bserrno != 0) {
 		bs_clone_snapshot_cleanup_finish(ctx, bserrno);
 		return;
@@ -7160,6 +8683,13 @@ bs_inflate_blob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
 
 	_blob->locked_operation_in_progress = true;
 
+	if (ctx->allocate_type == BLOB_INFLATE_ALLOCATE_COW_UNITS) {
+		/* Only the partially copied clusters are completed, the parent stays */
+		ctx->cluster = 0;
+		bs_inflate_blob_touch_next(ctx, 0);
+		return;
+	}
+
 	switch (_blob->parent_id) {
 	case SPDK_BLOBID_INVALID:
 		if (ctx->allocate_type != BLOB_INFLATE_ALLOCATE_ALL) {
@@ -7196,28 +8726,16 @@ bs_inflate_blob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
 
 	/* Skip allocation anc copy phase if not requested */
 	if (ctx->allocate_type == BLOB_INFLATE_ALLOCATE_NONE) {
-		bs_inflate_blob_done(ctx);
-		return;
-	}
-
-	/* Do two passes - one to verify that we can obtain enough clusters
-	 * and another to actually claim them.
-	 */
-	clusters_needed = 0;
-	for (i = 0; i < _blob->active.num_clusters; i++) {
-		if (bs_cluster_needs_allocation(_blob, i, ctx->allocate_type == BLOB_INFLATE_ALLOCATE_ALL)) {
-			clusters_needed++;
+		if (blob_has_cow_units(_blob)) {
+			SPDK_ERRLOG("Cannot detach a blob whose clusters are not entirely copied.\n");
+			bs_clone_snapshot_origblob_cleanup(ctx, -EBUSY);
+			return;
 		}
-	}
-
-	if (clusters_needed > _blob->bs->num_free_clusters) {
-		/* Not enough free clusters. Cannot satisfy the request. */
-		bs_clone_snapshot_origblob_cleanup(ctx, -ENOSPC);
+		bs_inflate_blob_done(ctx);
 		return;
 	}
 
-	ctx->cluster = 0;
-	bs_inflate_blob_touch_next(ctx, 0);
+	bs_inflate_blob_allocate(ctx, true);
 }
 
 static void
@@ -7256,6 +8774,13 @@ spdk_bs_blob_decouple_parent(struct spdk_blob_store *bs, struct spdk_io_channel
 	bs_inflate_blob(bs, channel, blobid, BLOB_INFLATE_ALLOCATE_UNALLOCATED, cb_fn, cb_arg);
 }
 
+void
+spdk_bs_blob_cow_fill(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+		      spdk_blob_id blobid, spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	bs_inflate_blob(bs, channel, blobid, BLOB_INFLATE_ALLOCATE_COW_UNITS, cb_fn, cb_arg);
+}
+
 void
 spdk_bs_blob_detach_parent(struct spdk_blob_store *bs, spdk_blob_id blobid,
 			   spdk_blob_op_complete cb_fn, void *cb_arg)
@@ -7266,6 +8791,24 @@ spdk_bs_blob_detach_parent(struct spdk_blob_store *bs, spdk_blob_id blobid,
 
 /* START spdk_bs_blob_shallow_copy */
 
+/* Clusters copied at a time by spdk_bs_blob_diff_copy() unless told otherwise */
+#define BLOB_DIFF_COPY_DEFAULT_QUEUE_DEPTH 4
+
+struct shallow_copy_ctx;
+
+struct shallow_copy_io {
+	struct shallow_copy_ctx *ctx;
+
+	/* Cluster being copied, UINT64_MAX if the slot is free */
+	uint64_t cluster;
+
+	/* Buffer for blob reading */
+	uint8_t *read_buff;
+
+	/* Struct for external device writing */
+	struct spdk_bs_dev_cb_args ext_args;
+};
+
 struct shallow_copy_ctx {
 	struct spdk_bs_cpl cpl;
 	int bserrno;
@@ -7276,18 +8819,26 @@ struct shallow_copy_ctx {
 	struct spdk_blob *blob;
 	struct spdk_io_channel *blob_channel;
 
+	/* Only clusters changed since this ancestor are copied */
+	spdk_blob_id base_blobid;
+
+	/* The ancestor is the parent of the blob */
+	bool shallow;
+
 	/* Destination device for copy */
 	struct spdk_bs_dev *ext_dev;
 	struct spdk_io_channel *ext_channel;
 
-	/* Current cluster for copy operation */
+	/* Next cluster to look at for copy */
 	uint64_t cluster;
 
-	/* Buffer for blob reading */
-	uint8_t *read_buff;
+	/* Copies in flight and the slots they use */
+	uint32_t queue_depth;
+	uint32_t outstanding;
+	struct shallow_copy_io *ios;
 
-	/* Struct for external device writing */
-	struct spdk_bs_dev_cb_args ext_args;
+	/* Set while new copies are being submitted */
+	bool submitting;
 
 	/* Actual number of copied clusters */
 	uint64_t copied_clusters_count;
@@ -7299,6 +8850,18 @@ struct shallow_copy_ctx {
 	void *status_cb_arg;
 };
 
+static void
+bs_shallow_copy_free(struct shallow_copy_ctx *ctx)
+{
+	uint32_t i;
+
+	for (i = 0; i < ctx->queue_depth; i++) {
+		spdk_free(ctx->ios[i].read_buff);
+	}
+	free(ctx->ios);
+	free(ctx);
+}
+
 static void
 bs_shallow_copy_cleanup_finish(void *cb_arg, int bserrno)
 {
@@ -7311,29 +8874,27 @@ bs_shallow_copy_cleanup_finish(void *cb_arg, int bserrno)
 	}
 
 	ctx->ext_dev->destroy_channel(ctx->ext_dev, ctx->ext_channel);
-	spdk_free(ctx->read_buff);
 
 	cpl->u.blob_basic.cb_fn(cpl->u.blob_basic.cb_arg, ctx->bserrno);
 
-	free(ctx);
+	bs_shallow_copy_free(ctx);
 }
 
 static void
 bs_shallow_copy_bdev_write_cpl(struct spdk_io_channel *channel, void *cb_arg, int bserrno)
 {
-	struct shallow_copy_ctx *ctx = cb_arg;
-	struct spdk_blob *_blob = ctx->blob;
+	struct shallow_copy_io *io = cb_arg;
+	struct shallow_copy_ctx *ctx = io->ctx;
+
+	io->cluster = UINT64_MAX;
+	ctx->outstanding--;
 
 	if (bserrno != 0) {
 		SPDK_ERRLOG("blob 0x%" PRIx64 " shallow copy, ext dev write error %d\n", ctx->blob->id, bserrno);
-		ctx->bserrno = bserrno;
-		_blob->locked_operation_in_progress = false;
-		spdk_blob_close(_blob, bs_shallow_copy_cleanup_finish, ctx);
-		return;
-	}
-
-	ctx->cluster++;
-	if (ctx->status_cb) {
+		if (ctx->bserrno == 0) {
+			ctx->bserrno = bserrno;
+		}
+	} else if (ctx->status_cb) {
 		ctx->copied_clusters_count++;
 		ctx->status_cb(ctx->copied_clusters_count, ctx->status_cb_arg);
 	}
@@ -7344,26 +8905,30 @@ bs_shallow_copy_bdev_write_cpl(struct spdk_io_channel *channel, void *cb_arg, in
 static void
 bs_shallow_copy_blob_read_cpl(void *cb_arg, int bserrno)
 {
-	struct shallow_copy_ctx *ctx = cb_arg;
+	struct shallow_copy_io *io = cb_arg;
+	struct shallow_copy_ctx *ctx = io->ctx;
 	struct spdk_bs_dev *ext_dev = ctx->ext_dev;
 	struct spdk_blob *_blob = ctx->blob;
 
 	if (bserrno != 0) {
 		SPDK_ERRLOG("blob 0x%" PRIx64 " shallow copy, blob read error %d\n", ctx->blob->id, bserrno);
-		ctx->bserrno = bserrno;
-		_blob->locked_operation_in_progress = false;
-		spdk_blob_close(_blob, bs_shallow_copy_cleanup_finish, ctx);
+		if (ctx->bserrno == 0) {
+			ctx->bserrno = bserrno;
+		}
+		io->cluster = UINT64_MAX;
+		ctx->outstanding--;
+		bs_shallow_copy_cluster_find_next(ctx);
 		return;
 	}
 
-	ctx->ext_args.channel = ctx->ext_channel;
-	ctx->ext_args.cb_fn = bs_shallow_copy_bdev_write_cpl;
-	ctx->ext_args.cb_arg = ctx;
+	io->ext_args.channel = ctx->ext_channel;
+	io->ext_args.cb_fn = bs_shallow_copy_bdev_write_cpl;
+	io->ext_args.cb_arg = io;
 
-	ext_dev->write(ext_dev, ctx->ext_channel, ctx->read_buff,
-		       bs_cluster_to_lba(_blob->bs, ctx->cluster),
+	ext_dev->write(ext_dev, ctx->ext_channel, io->read_buff,
+		       bs_cluster_to_lba(_blob->bs, io->cluster),
 		       bs_dev_byte_to_lba(_blob->bs->dev, _blob->bs->cluster_sz),
-		       &ctx->ext_args);
+		       &io->ext_args);
 }
 
 static void
@@ -7371,26 +8936,56 @@ bs_shallow_copy_cluster_find_next(void *cb_arg)
 {
 	struct shallow_copy_ctx *ctx = cb_arg;
 	struct spdk_blob *_blob = ctx->blob;
+	struct shallow_copy_io *io;
+	uint32_t i;
 
-	while (ctx->cluster < _blob->active.num_clusters) {
-		if (_blob->active.clusters[ctx->cluster] != 0) {
+	if (ctx->submitting) {
+		/* A copy completed right away, the loop below picks up the free slot */
+		return;
+	}
+
+	ctx->submitting = true;
+	while (ctx->bserrno == 0 && ctx->outstanding < ctx->queue_depth) {
+		ctx->cluster = spdk_blob_get_next_changed_cluster(_blob, ctx->base_blobid, ctx->cluster);
+		if (ctx->cluster == UINT64_MAX) {
 			break;
 		}
 
-		ctx->cluster++;
+		for (i = 0; ctx->ios[i].cluster != UINT64_MAX; i++) {
+			assert(i + 1 < ctx->queue_depth);
+		}
+		io = &ctx->ios[i];
+		io->cluster = ctx->cluster++;
+		ctx->outstanding++;
+
+		/* A partially copied cluster is read in pieces from the blob and its parent */
+		blob_request_submit_op(_blob, ctx->blob_channel, io->read_buff,
+				       bs_cluster_to_lba(_blob->bs, io->cluster),
+				       bs_dev_byte_to_lba(_blob->bs->dev, _blob->bs->cluster_sz),
+				       bs_shallow_copy_blob_read_cpl, io, SPDK_BLOB_READ);
 	}
+	ctx->submitting = false;
 
-	if (ctx->cluster < _blob->active.num_clusters) {
-		blob_request_submit_op_single(ctx->blob_channel, _blob, ctx->read_buff,
-					      bs_cluster_to_lba(_blob->bs, ctx->cluster),
-					      bs_dev_byte_to_lba(_blob->bs->dev, _blob->bs->cluster_sz),
-					      bs_shallow_copy_blob_read_cpl, ctx, SPDK_BLOB_READ);
-	} else {
+	if (ctx->outstanding == 0) {
 		_blob->locked_operation_in_progress = false;
 		spdk_blob_close(_blob, bs_shallow_copy_cleanup_finish, ctx);
 	}
 }
 
+static bool
+bs_shallow_copy_is_ancestor(struct spdk_blob *blob, spdk_blob_id base_id)
+{
+	while (blob->parent_id != SPDK_BLOBID_INVALID &&
+	       blob->parent_id != SPDK_BLOBID_EXTERNAL_SNAPSHOT) {
+		if (blob->parent_id == base_id) {
+			return true;
+		}
+		blob = ((struct spdk_blob_bs_dev *)blob->back_bs_dev)->blob;
+	}
+
+	return false;
+}
+
 static void
 bs_shallow_copy_blob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
 {
@@ -7432,6 +9027,17 @@ blobstore block size\n", _blob->id);
 		return;
 	}
 
+	if (ctx->shallow) {
+		ctx->base_blobid = _blob->parent_id;
+	} else if (ctx->base_blobid != SPDK_BLOBID_INVALID &&
+		   !bs_shallow_copy_is_ancestor(_blob, ctx->base_blobid)) {
+		SPDK_ERRLOG("blob 0x%" PRIx64 " diff copy, blob 0x%" PRIx64 " is not one of its snapshots\n",
+			    _blob->id, ctx->base_blobid);
+		ctx->bserrno = -EINVAL;
+		spdk_blob_close(_blob, bs_shallow_copy_cleanup_finish, ctx);
+		return;
+	}
+
 	ctx->blob = _blob;
 
 	if (_blob->locked_operation_in_progress) {
@@ -7447,14 +9053,16 @@ blobstore block size\n", _blob->id);
 	bs_shallow_copy_cluster_find_next(ctx);
 }
 
-int
-spdk_bs_blob_shallow_copy(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
-			  spdk_blob_id blobid, struct spdk_bs_dev *ext_dev,
-			  spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
-			  spdk_blob_op_complete cb_fn, void *cb_arg)
+static int
+bs_blob_shallow_copy(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+		     spdk_blob_id blobid, spdk_blob_id base_blobid, bool shallow,
+		     struct spdk_bs_dev *ext_dev, uint32_t queue_depth,
+		     spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
+		     spdk_blob_op_complete cb_fn, void *cb_arg)
 {
 	struct shallow_copy_ctx *ctx;
 	struct spdk_io_channel *ext_channel;
+	uint32_t i;
 
 	ctx = calloc(1, sizeof(*ctx));
 	if (!ctx) {
@@ -7463,6 +9071,8 @@ spdk_bs_blob_shallow_copy(struct spdk_blob_store *bs, struct spdk_io_channel *ch
 
 	ctx->bs = bs;
 	ctx->blobid = blobid;
+	ctx->base_blobid = base_blobid;
+	ctx->shallow = shallow;
 	ctx->cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
 	ctx->cpl.u.bs_basic.cb_fn = cb_fn;
 	ctx->cpl.u.bs_basic.cb_arg = cb_arg;
@@ -7470,17 +9080,27 @@ spdk_bs_blob_shallow_copy(struct spdk_blob_store *bs, struct spdk_io_channel *ch
 	ctx->blob_channel = channel;
 	ctx->status_cb = status_cb_fn;
 	ctx->status_cb_arg = status_cb_arg;
-	ctx->read_buff = spdk_malloc(bs->cluster_sz, bs->dev->blocklen, NULL,
-				     SPDK_ENV_LCORE_ID_ANY, SPDK_MALLOC_DMA);
-	if (!ctx->read_buff) {
+	ctx->ios = calloc(queue_depth, sizeof(*ctx->ios));
+	if (!ctx->ios) {
 		free(ctx);
 		return -ENOMEM;
 	}
+	ctx->queue_depth = queue_depth;
+
+	for (i = 0; i < queue_depth; i++) {
+		ctx->ios[i].ctx = ctx;
+		ctx->ios[i].cluster = UINT64_MAX;
+		ctx->ios[i].read_buff = spdk_malloc(bs->cluster_sz, bs->dev->blocklen, NULL,
+						    SPDK_ENV_LCORE_ID_ANY, SPDK_MALLOC_DMA);
+		if (!ctx->ios[i].read_buff) {
+			bs_shallow_copy_free(ctx);
+			return -ENOMEM;
+		}
+	}
 
 	ext_channel = ext_dev->create_channel(ext_dev);
 	if (!ext_channel) {
-		spdk_free(ctx->read_buff);
-		free(ctx);
+		bs_shallow_copy_free(ctx);
 		return -ENOMEM;
 	}
 	ctx->ext_dev = ext_dev;
@@ -7490,6 +9110,35 @@ spdk_bs_blob_shallow_copy(struct spdk_blob_store *bs, struct spdk_io_channel *ch
 
 	return 0;
 }
+
+int
+spdk_bs_blob_shallow_copy(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+			  spdk_blob_id blobid, struct spdk_bs_dev *ext_dev,
+			  spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
+			  spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	return bs_blob_shallow_copy(bs, channel, blobid, SPDK_BLOBID_INVALID, true, ext_dev, 1,
+				    status_cb_fn, status_cb_arg, cb_fn, cb_arg);
+}
+
+int
+spdk_bs_blob_diff_copy(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+		       spdk_blob_id blobid, spdk_blob_id base_blobid,
+		       struct spdk_bs_dev *ext_dev, uint32_t queue_depth,
+		       spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
+		       spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	if (blobid == base_blobid) {
+		return -EINVAL;
+	}
+
+	if (queue_depth == 0) {
+		queue_depth = BLOB_DIFF_COPY_DEFAULT_QUEUE_DEPTH;
+	}
+
+	return bs_blob_shallow_copy(bs, channel, blobid, base_blobid, false, ext_dev, queue_depth,
+				    status_cb_fn, status_cb_arg, cb_fn, cb_arg);
+}
 /* END spdk_bs_blob_shallow_copy */
 
 /* START spdk_bs_blob_set_parent */
@@ -7643,6 +9292,13 @@ bs_set_parent_snapshot_open_cpl(void *cb_arg, struct spdk_blob *snapshot, int bs
 		return;
 	}
 
+	if (blob_has_cow_units(blob)) {
+		SPDK_ERRLOG("cannot set parent of blob, its clusters are not entirely copied\n");
+		ctx->bserrno = -EBUSY;
+		spdk_blob_close(blob, bs_set_parent_close_snapshot, ctx);
+		return;
+	}
+
 	blob->locked_operation_in_progress = true;
 	snapshot->locked_operation_in_progress = true;
 
@@ -7841,6 +9497,12 @@ bs_set_external_parent_blob_open_cpl(void *cb_arg, struct spdk_blob *blob, int b
 		goto error;
 	}
 
+	if (blob_has_cow_units(blob)) {
+		SPDK_ERRLOG("cannot set external parent of blob, its clusters are not entirely copied\n");
+		ctx->bserrno = -EBUSY;
+		goto error;
+	}
+
 	blob->locked_operation_in_progress = true;
 
 	/* Temporarily override md_ro flag for MD modification */
@@ -7850,57 +9512,1021 @@ bs_set_external_parent_blob_open_cpl(void *cb_arg, struct spdk_blob *blob, int b
 			     &ctx->parent, bs_set_external_parent_unfrozen, ctx);
 	return;
 
-error:
-	spdk_blob_close(blob, bs_set_external_parent_cleanup_finish, ctx);
+error:
+	spdk_blob_close(blob, bs_set_external_parent_cleanup_finish, ctx);
+}
+
+void
+spdk_bs_blob_set_external_parent(struct spdk_blob_store *bs, spdk_blob_id blob_id,
+				 struct spdk_bs_dev *esnap_bs_dev, const void *esnap_id,
+				 uint32_t esnap_id_len, spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	struct set_parent_ctx *ctx;
+	uint64_t esnap_dev_size, cluster_sz;
+
+	if (sizeof(blob_id) == esnap_id_len && memcmp(&blob_id, esnap_id, sizeof(blob_id)) == 0) {
+		SPDK_ERRLOG("blob id and external snapshot id cannot be the same\n");
+		cb_fn(cb_arg, -EINVAL);
+		return;
+	}
+
+	esnap_dev_size = esnap_bs_dev->blockcnt * esnap_bs_dev->blocklen;
+	cluster_sz = spdk_bs_get_cluster_size(bs);
+	if ((esnap_dev_size % cluster_sz) != 0) {
+		SPDK_ERRLOG("Esnap device size %" PRIu64 " is not an integer multiple of "
+			    "cluster size %" PRIu64 "\n", esnap_dev_size, cluster_sz);
+		cb_fn(cb_arg, -EINVAL);
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->parent.u.esnap.id = calloc(1, esnap_id_len);
+	if (!ctx->parent.u.esnap.id) {
+		free(ctx);
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->bs = bs;
+	ctx->parent.u.esnap.back_bs_dev = esnap_bs_dev;
+	memcpy(ctx->parent.u.esnap.id, esnap_id, esnap_id_len);
+	ctx->parent.u.esnap.id_len = esnap_id_len;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+	ctx->bserrno = 0;
+
+	spdk_bs_open_blob(bs, blob_id, bs_set_external_parent_blob_open_cpl, ctx);
+}
+/* END spdk_bs_blob_set_external_parent */
+
+/* START spdk_bs_blob_move_cluster */
+
+struct move_cluster_ctx {
+	struct spdk_blob_store *bs;
+	spdk_blob_id blobid;
+	struct spdk_blob *blob;
+	uint64_t cluster_num;
+	uint32_t dst_cluster;
+	uint64_t src_lba;
+	uint64_t dst_lba;
+	bool dst_claimed;
+	bool frozen;
+	bool locked;
+	bool md_ro;
+	/* The blob points at the new cluster, only copies out of the old one are waited for */
+	bool moved;
+	/* The extent page pointing at the new cluster is on disk */
+	bool ep_written;
+	struct spdk_poller *drain_poller;
+	uint8_t *buf;
+	struct spdk_blob_md_page *page;
+	int bserrno;
+	spdk_blob_op_complete cb_fn;
+	void *cb_arg;
+};
+
+static void bs_move_cluster_drain(struct move_cluster_ctx *ctx);
+
+static void
+bs_move_cluster_finish(void *cb_arg, int bserrno)
+{
+	struct move_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0 && ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
+
+	spdk_free(ctx->buf);
+	spdk_free(ctx->page);
+	ctx->cb_fn(ctx->cb_arg, ctx->bserrno);
+	free(ctx);
+}
+
+static void
+bs_move_cluster_close(void *cb_arg, int bserrno)
+{
+	struct move_cluster_ctx *ctx = cb_arg;
+	struct spdk_blob *blob = ctx->blob;
+
+	if (bserrno != 0 && ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
+
+	if (ctx->locked) {
+		blob->locked_operation_in_progress = false;
+	}
+	spdk_blob_close(blob, bs_move_cluster_finish, ctx);
+}
+
+static void
+bs_move_cluster_cleanup(struct move_cluster_ctx *ctx, int bserrno)
+{
+	if (bserrno != 0 && ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
+
+	if (ctx->dst_claimed) {
+		spdk_spin_lock(&ctx->bs->used_lock);
+		bs_release_cluster(ctx->bs, ctx->dst_cluster);
+		spdk_spin_unlock(&ctx->bs->used_lock);
+		ctx->dst_claimed = false;
+	}
+
+	if (ctx->frozen) {
+		blob_unfreeze_io(ctx->blob, bs_move_cluster_close, ctx);
+	} else {
+		bs_move_cluster_close(ctx, 0);
+	}
+}
+
+static void
+bs_move_cluster_release_src(struct move_cluster_ctx *ctx)
+{
+	/* The cluster now belongs to the blob, only the old one is released */
+	ctx->dst_claimed = false;
+
+	spdk_spin_lock(&ctx->bs->used_lock);
+	bs_release_cluster(ctx->bs, bs_lba_to_cluster(ctx->bs, ctx->src_lba));
+	spdk_spin_unlock(&ctx->bs->used_lock);
+
+	bs_move_cluster_cleanup(ctx, 0);
+}
+
+static void
+bs_move_cluster_sync_cpl(void *cb_arg, int bserrno)
+{
+	struct move_cluster_ctx *ctx = cb_arg;
+	struct spdk_blob *blob = ctx->blob;
+
+	blob->md_ro = ctx->md_ro;
+
+	if (bserrno != 0) {
+		SPDK_ERRLOG("blob 0x%" PRIx64 " failed to persist moved cluster %" PRIu64 ": %d\n",
+			    blob->id, ctx->cluster_num, bserrno);
+		if (!ctx->ep_written) {
+			/* Keep reading from the old cluster, which still holds the same data */
+			blob->active.clusters[ctx->cluster_num] = ctx->src_lba;
+			bs_move_cluster_cleanup(ctx, bserrno);
+			return;
+		}
+		/* The extent page on disk already points at the new cluster, so the move has to
+		 * be completed.  The blob stays dirty for the next sync to retry. */
+		ctx->bserrno = bserrno;
+	}
+
+	/* Copies out of the old cluster by clones that translated to it must be done before it is freed */
+	ctx->moved = true;
+	bs_move_cluster_drain(ctx);
+}
+
+static void
+bs_move_cluster_ep_cpl(void *cb_arg, int bserrno)
+{
+	struct move_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0) {
+		bs_move_cluster_sync_cpl(ctx, bserrno);
+		return;
+	}
+
+	ctx->ep_written = true;
+	ctx->blob->state = SPDK_BLOB_STATE_DIRTY;
+	blob_sync_md(ctx->blob, bs_move_cluster_sync_cpl, ctx);
+}
+
+static void
+bs_move_cluster_copy_cpl(void *cb_arg, int bserrno)
+{
+	struct move_cluster_ctx *ctx = cb_arg;
+	struct spdk_blob *blob = ctx->blob;
+
+	if (bserrno != 0) {
+		bs_move_cluster_cleanup(ctx, bserrno);
+		return;
+	}
+
+	if (blob->active.clusters[ctx->cluster_num] != ctx->src_lba) {
+		/* The cluster was released while it was copied */
+		bs_move_cluster_cleanup(ctx, -EAGAIN);
+		return;
+	}
+
+	blob->active.clusters[ctx->cluster_num] = ctx->dst_lba;
+
+	/* Temporarily override md_ro flag for MD modification */
+	ctx->md_ro = blob->md_ro;
+	blob->md_ro = false;
+
+	if (blob->use_extent_table) {
+		blob_write_extent_page(blob, *bs_cluster_to_extent_page(blob, ctx->cluster_num),
+				       ctx->cluster_num, ctx->page, bs_move_cluster_ep_cpl, ctx);
+	} else {
+		blob->state = SPDK_BLOB_STATE_DIRTY;
+		blob_sync_md(blob, bs_move_cluster_sync_cpl, ctx);
+	}
+}
+
+static void
+bs_move_cluster_write_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	bs_sequence_finish(seq, bserrno);
+}
+
+static void
+bs_move_cluster_read_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct move_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0) {
+		bs_sequence_finish(seq, bserrno);
+		return;
+	}
+
+	bs_sequence_write_dev(seq, ctx->buf, ctx->dst_lba, bs_cluster_to_lba(ctx->bs, 1),
+			      bs_move_cluster_write_cpl, ctx);
+}
+
+static void
+bs_move_cluster_copy(struct move_cluster_ctx *ctx)
+{
+	struct spdk_bs_cpl cpl;
+	spdk_bs_sequence_t *seq;
+
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = bs_move_cluster_copy_cpl;
+	cpl.u.blob_basic.cb_arg = ctx;
+
+	seq = bs_sequence_start_bs(ctx->bs->md_channel, &cpl);
+	if (!seq) {
+		bs_move_cluster_cleanup(ctx, -ENOMEM);
+		return;
+	}
+
+	if (ctx->buf == NULL) {
+		bs_sequence_copy_dev(seq, ctx->dst_lba, ctx->src_lba, bs_cluster_to_lba(ctx->bs, 1),
+				     bs_move_cluster_write_cpl, ctx);
+	} else {
+		bs_sequence_read_dev(seq, ctx->buf, ctx->src_lba, bs_cluster_to_lba(ctx->bs, 1),
+				     bs_move_cluster_read_cpl, ctx);
+	}
+}
+
+static void
+bs_move_cluster_drain_channel(struct spdk_io_channel_iter *i)
+{
+	struct move_cluster_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
+	struct spdk_bs_channel *ch = spdk_io_channel_get_ctx(_ch);
+	struct spdk_blob_copy_cluster_ctx *alloc;
+	uint64_t lba_count = bs_cluster_to_lba(ctx->bs, 1);
+	uint32_t j;
+
+	/* Freezing the blob holds new I/O back, but doesn't wait for the I/O already translated */
+	if (!ctx->moved) {
+		for (j = 0; j < ctx->bs->max_channel_ops; j++) {
+			if (ch->req_mem[j].io_blob == ctx->blob) {
+				spdk_for_each_channel_continue(i, -EBUSY);
+				return;
+			}
+		}
+	}
+
+	/* Clones copy data straight out of the blob's clusters when the device supports it */
+	TAILQ_FOREACH(alloc, &ch->cluster_allocs, link) {
+		if ((alloc->can_copy || alloc->unshare_lba != 0) &&
+		    alloc->copy_src_lba < ctx->src_lba + lba_count &&
+		    ctx->src_lba < alloc->copy_src_lba + lba_count) {
+			spdk_for_each_channel_continue(i, -EBUSY);
+			return;
+		}
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static int
+bs_move_cluster_drain_poll(void *arg)
+{
+	struct move_cluster_ctx *ctx = arg;
+
+	spdk_poller_unregister(&ctx->drain_poller);
+	bs_move_cluster_drain(ctx);
+
+	return SPDK_POLLER_BUSY;
+}
+
+static void
+bs_move_cluster_drain_cpl(struct spdk_io_channel_iter *i, int status)
+{
+	struct move_cluster_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	if (status == -EBUSY) {
+		/* Give the I/O some time to complete before checking again */
+		ctx->drain_poller = SPDK_POLLER_REGISTER(bs_move_cluster_drain_poll, ctx,
+				    BS_CLUSTER_DRAIN_RETRY_US);
+	} else if (!ctx->moved) {
+		bs_move_cluster_copy(ctx);
+	} else {
+		bs_move_cluster_release_src(ctx);
+	}
+}
+
+static void
+bs_move_cluster_drain(struct move_cluster_ctx *ctx)
+{
+	spdk_for_each_channel(ctx->bs, bs_move_cluster_drain_channel, ctx, bs_move_cluster_drain_cpl);
+}
+
+static void
+bs_move_cluster_frozen(void *cb_arg, int bserrno)
+{
+	struct move_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0) {
+		bs_move_cluster_cleanup(ctx, bserrno);
+		return;
+	}
+
+	ctx->frozen = true;
+	bs_move_cluster_drain(ctx);
+}
+
+static void
+bs_move_cluster_open_cpl(void *cb_arg, struct spdk_blob *blob, int bserrno)
+{
+	struct move_cluster_ctx *ctx = cb_arg;
+	struct spdk_blob_store *bs = ctx->bs;
+	bool claimed;
+
+	if (bserrno != 0) {
+		bs_move_cluster_finish(ctx, bserrno);
+		return;
+	}
+
+	ctx->blob = blob;
+
+	if (ctx->cluster_num >= blob->active.num_clusters ||
+	    blob->active.clusters[ctx->cluster_num] == 0) {
+		bs_move_cluster_cleanup(ctx, -EINVAL);
+		return;
+	}
+
+	if (blob->locked_operation_in_progress) {
+		SPDK_DEBUGLOG(blob, "blob 0x%" PRIx64 " move cluster - another operation in progress\n",
+			      blob->id);
+		bs_move_cluster_cleanup(ctx, -EBUSY);
+		return;
+	}
+
+	if (bs_cluster_is_shared(bs, blob->active.clusters[ctx->cluster_num])) {
+		/* The other blobs referencing the cluster would keep pointing at the old location */
+		bs_move_cluster_cleanup(ctx, -EPERM);
+		return;
+	}
+
+	spdk_spin_lock(&bs->used_lock);
+	claimed = spdk_bit_pool_allocate_bit_at(bs->used_clusters, ctx->dst_cluster);
+	if (claimed) {
+		bs->num_free_clusters--;
+	}
+	spdk_spin_unlock(&bs->used_lock);
+
+	if (!claimed) {
+		bs_move_cluster_cleanup(ctx, -EBUSY);
+		return;
+	}
+
+	blob->locked_operation_in_progress = true;
+	ctx->locked = true;
+	ctx->dst_claimed = true;
+	ctx->src_lba = blob->active.clusters[ctx->cluster_num];
+	ctx->dst_lba = bs_cluster_to_lba(bs, ctx->dst_cluster);
+
+	if (bs->dev->copy == NULL) {
+		ctx->buf = spdk_malloc(bs->cluster_sz, bs->dev->blocklen, NULL,
+				       SPDK_ENV_NUMA_ID_ANY, SPDK_MALLOC_DMA);
+		if (ctx->buf == NULL) {
+			bs_move_cluster_cleanup(ctx, -ENOMEM);
+			return;
+		}
+	}
+
+	if (blob->use_extent_table) {
+		ctx->page = spdk_zmalloc(SPDK_BS_PAGE_SIZE, 0, NULL, SPDK_ENV_NUMA_ID_ANY, SPDK_MALLOC_DMA);
+		if (ctx->page == NULL) {
+			bs_move_cluster_cleanup(ctx, -ENOMEM);
+			return;
+		}
+	}
+
+	blob_freeze_io(blob, bs_move_cluster_frozen, ctx);
+}
+
+void
+spdk_bs_blob_move_cluster(struct spdk_blob_store *bs, spdk_blob_id blobid, uint64_t cluster_num,
+			  uint64_t dst_cluster, spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	struct move_cluster_ctx *ctx;
+
+	if (dst_cluster >= bs->total_clusters) {
+		cb_fn(cb_arg, -EINVAL);
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->bs = bs;
+	ctx->blobid = blobid;
+	ctx->cluster_num = cluster_num;
+	ctx->dst_cluster = dst_cluster;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+
+	spdk_bs_open_blob(bs, blobid, bs_move_cluster_open_cpl, ctx);
+}
+/* END spdk_bs_blob_move_cluster */
+
+/* START spdk_bs_blob_share_cluster */
+
+struct share_cluster_ctx {
+	struct spdk_blob_store *bs;
+	spdk_blob_id blobid;
+	spdk_blob_id src_blobid;
+	struct spdk_blob *blob;
+	struct spdk_blob *src_blob;
+	uint64_t cluster_num;
+	uint64_t src_cluster_num;
+	uint64_t old_lba;
+	uint64_t shared_lba;
+	bool frozen;
+	bool src_frozen;
+	bool locked;
+	bool src_locked;
+	bool shared_ref;
+	bool md_ro;
+	/* The blob points at the shared cluster, only I/O to the old one is waited for */
+	bool shared;
+	struct spdk_poller *drain_poller;
+	uint8_t *buf;
+	struct spdk_blob_md_page *page;
+	int bserrno;
+	spdk_blob_op_complete cb_fn;
+	void *cb_arg;
+};
+
+static void bs_share_cluster_drain(struct share_cluster_ctx *ctx);
+
+static void
+bs_share_cluster_finish(void *cb_arg, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0 && ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
+
+	spdk_free(ctx->buf);
+	spdk_free(ctx->page);
+	ctx->cb_fn(ctx->cb_arg, ctx->bserrno);
+	free(ctx);
+}
+
+static void
+bs_share_cluster_close_src(void *cb_arg, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0 && ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
+
+	if (ctx->src_blob == NULL) {
+		bs_share_cluster_finish(ctx, 0);
+		return;
+	}
+
+	if (ctx->src_locked) {
+		ctx->src_blob->locked_operation_in_progress = false;
+	}
+	spdk_blob_close(ctx->src_blob, bs_share_cluster_finish, ctx);
+}
+
+static void
+bs_share_cluster_close(void *cb_arg, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0 && ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
+
+	if (ctx->locked) {
+		ctx->blob->locked_operation_in_progress = false;
+	}
+	spdk_blob_close(ctx->blob, bs_share_cluster_close_src, ctx);
+}
+
+static void
+bs_share_cluster_unfreeze(void *cb_arg, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0 && ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
+
+	if (ctx->src_frozen) {
+		ctx->src_frozen = false;
+		blob_unfreeze_io(ctx->src_blob, bs_share_cluster_unfreeze, ctx);
+	} else if (ctx->frozen) {
+		ctx->frozen = false;
+		blob_unfreeze_io(ctx->blob, bs_share_cluster_close, ctx);
+	} else {
+		bs_share_cluster_close(ctx, 0);
+	}
+}
+
+static void
+bs_share_cluster_cleanup(struct share_cluster_ctx *ctx, int bserrno)
+{
+	if (bserrno != 0 && ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
+
+	if (ctx->shared_ref) {
+		spdk_spin_lock(&ctx->bs->used_lock);
+		bs_release_cluster(ctx->bs, bs_lba_to_cluster(ctx->bs, ctx->shared_lba));
+		spdk_spin_unlock(&ctx->bs->used_lock);
+		ctx->shared_ref = false;
+	}
+
+	bs_share_cluster_unfreeze(ctx, 0);
+}
+
+static void
+bs_share_cluster_release_old(struct share_cluster_ctx *ctx)
+{
+	/* The reference now belongs to the blob, only its old cluster is released */
+	ctx->shared_ref = false;
+
+	spdk_spin_lock(&ctx->bs->used_lock);
+	bs_release_cluster(ctx->bs, bs_lba_to_cluster(ctx->bs, ctx->old_lba));
+	spdk_spin_unlock(&ctx->bs->used_lock);
+
+	bs_share_cluster_cleanup(ctx, 0);
+}
+
+static void
+bs_share_cluster_sync_cpl(void *cb_arg, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+	struct spdk_blob *blob = ctx->blob;
+
+	blob->md_ro = ctx->md_ro;
+
+	if (bserrno != 0) {
+		SPDK_ERRLOG("blob 0x%" PRIx64 " failed to persist shared cluster %" PRIu64 ": %d\n",
+			    blob->id, ctx->cluster_num, bserrno);
+		/* Keep reading from the old cluster, which still holds the same data */
+		blob->active.clusters[ctx->cluster_num] = ctx->old_lba;
+		bs_share_cluster_cleanup(ctx, bserrno);
+		return;
+	}
+
+	/* Reads translated to the old cluster must be done before it is freed */
+	ctx->shared = true;
+	bs_share_cluster_drain(ctx);
+}
+
+static void
+bs_share_cluster_ep_cpl(void *cb_arg, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0) {
+		bs_share_cluster_sync_cpl(ctx, bserrno);
+		return;
+	}
+
+	ctx->blob->state = SPDK_BLOB_STATE_DIRTY;
+	blob_sync_md(ctx->blob, bs_share_cluster_sync_cpl, ctx);
+}
+
+static void
+bs_share_cluster_compare_cpl(void *cb_arg, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+	struct spdk_blob *blob = ctx->blob;
+	int rc;
+
+	if (bserrno != 0) {
+		bs_share_cluster_cleanup(ctx, bserrno);
+		return;
+	}
+
+	if (blob->active.clusters[ctx->cluster_num] != ctx->old_lba ||
+	    ctx->src_blob->active.clusters[ctx->src_cluster_num] != ctx->shared_lba) {
+		/* The clusters were released while they were compared */
+		bs_share_cluster_cleanup(ctx, -EAGAIN);
+		return;
+	}
+
+	spdk_spin_lock(&ctx->bs->used_lock);
+	rc = bs_ref_cluster(ctx->bs, bs_lba_to_cluster(ctx->bs, ctx->shared_lba));
+	spdk_spin_unlock(&ctx->bs->used_lock);
+	if (rc != 0) {
+		bs_share_cluster_cleanup(ctx, rc);
+		return;
+	}
+
+	ctx->shared_ref = true;
+	blob->active.clusters[ctx->cluster_num] = ctx->shared_lba;
+
+	/* Temporarily override md_ro flag for MD modification */
+	ctx->md_ro = blob->md_ro;
+	blob->md_ro = false;
+
+	if (blob->use_extent_table) {
+		blob_write_extent_page(blob, *bs_cluster_to_extent_page(blob, ctx->cluster_num),
+				       ctx->cluster_num, ctx->page, bs_share_cluster_ep_cpl, ctx);
+	} else {
+		blob->state = SPDK_BLOB_STATE_DIRTY;
+		blob_sync_md(blob, bs_share_cluster_sync_cpl, ctx);
+	}
+}
+
+static void
+bs_share_cluster_marked_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	bs_sequence_finish(seq, bserrno);
+}
+
+static void
+bs_share_cluster_read_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0) {
+		bs_sequence_finish(seq, bserrno);
+		return;
+	}
+
+	if (memcmp(ctx->buf, ctx->buf + ctx->bs->cluster_sz, ctx->bs->cluster_sz) != 0) {
+		bs_sequence_finish(seq, -EILSEQ);
+		return;
+	}
+
+	/* Older versions must not load a blobstore where a cluster belongs to several blobs */
+	bs_mark_shared_clusters(seq, ctx->bs, bs_share_cluster_marked_cpl, ctx);
+}
+
+static void
+bs_share_cluster_read_src(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0) {
+		bs_sequence_finish(seq, bserrno);
+		return;
+	}
+
+	bs_sequence_read_dev(seq, ctx->buf + ctx->bs->cluster_sz, ctx->shared_lba,
+			     bs_cluster_to_lba(ctx->bs, 1), bs_share_cluster_read_cpl, ctx);
+}
+
+static void
+bs_share_cluster_compare(struct share_cluster_ctx *ctx)
+{
+	struct spdk_bs_cpl cpl;
+	spdk_bs_sequence_t *seq;
+
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = bs_share_cluster_compare_cpl;
+	cpl.u.blob_basic.cb_arg = ctx;
+
+	seq = bs_sequence_start_bs(ctx->bs->md_channel, &cpl);
+	if (!seq) {
+		bs_share_cluster_cleanup(ctx, -ENOMEM);
+		return;
+	}
+
+	/* The clusters are only shared when their data is the same, not just the fingerprint */
+	bs_sequence_read_dev(seq, ctx->buf, ctx->old_lba, bs_cluster_to_lba(ctx->bs, 1),
+			     bs_share_cluster_read_src, ctx);
+}
+
+static void
+bs_share_cluster_drain_channel(struct spdk_io_channel_iter *i)
+{
+	struct share_cluster_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
+	struct spdk_bs_channel *ch = spdk_io_channel_get_ctx(_ch);
+	struct spdk_blob_copy_cluster_ctx *alloc;
+	uint64_t lba_count = bs_cluster_to_lba(ctx->bs, 1);
+	uint32_t j;
+
+	/* Writes translated before the blobs were frozen may still change the clusters */
+	for (j = 0; j < ctx->bs->max_channel_ops; j++) {
+		if (ch->req_mem[j].io_blob == ctx->blob || ch->req_mem[j].io_blob == ctx->src_blob) {
+			spdk_for_each_channel_continue(i, -EBUSY);
+			return;
+		}
+	}
+
+	/* Clones copy data straight out of the old cluster when the device supports it */
+	TAILQ_FOREACH(alloc, &ch->cluster_allocs, link) {
+		if ((alloc->can_copy || alloc->unshare_lba != 0) &&
+		    alloc->copy_src_lba < ctx->old_lba + lba_count &&
+		    ctx->old_lba < alloc->copy_src_lba + lba_count) {
+			spdk_for_each_channel_continue(i, -EBUSY);
+			return;
+		}
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static int
+bs_share_cluster_drain_poll(void *arg)
+{
+	struct share_cluster_ctx *ctx = arg;
+
+	spdk_poller_unregister(&ctx->drain_poller);
+	bs_share_cluster_drain(ctx);
+
+	return SPDK_POLLER_BUSY;
+}
+
+static void
+bs_share_cluster_drain_cpl(struct spdk_io_channel_iter *i, int status)
+{
+	struct share_cluster_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	if (status == -EBUSY) {
+		/* Give the I/O some time to complete before checking again */
+		ctx->drain_poller = SPDK_POLLER_REGISTER(bs_share_cluster_drain_poll, ctx,
+				    BS_CLUSTER_DRAIN_RETRY_US);
+	} else if (!ctx->shared) {
+		bs_share_cluster_compare(ctx);
+	} else {
+		bs_share_cluster_release_old(ctx);
+	}
+}
+
+static void
+bs_share_cluster_drain(struct share_cluster_ctx *ctx)
+{
+	spdk_for_each_channel(ctx->bs, bs_share_cluster_drain_channel, ctx, bs_share_cluster_drain_cpl);
+}
+
+static void
+bs_share_cluster_frozen(void *cb_arg, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0) {
+		bs_share_cluster_cleanup(ctx, bserrno);
+		return;
+	}
+
+	if (!ctx->frozen) {
+		ctx->frozen = true;
+		if (ctx->src_blob != ctx->blob) {
+			blob_freeze_io(ctx->src_blob, bs_share_cluster_frozen, ctx);
+			return;
+		}
+	} else {
+		ctx->src_frozen = true;
+	}
+
+	bs_share_cluster_drain(ctx);
+}
+
+static bool
+bs_share_cluster_allowed(struct spdk_blob *blob, uint64_t cluster_num)
+{
+	/* A write to a shared cluster needs a new one, which a thick provisioned blob can't expect */
+	if (!spdk_blob_is_thin_provisioned(blob) && !spdk_blob_is_read_only(blob)) {
+		return false;
+	}
+
+	return bs_cluster_cow_units(blob, cluster_num) == 0;
+}
+
+static void
+bs_share_cluster_src_open_cpl(void *cb_arg, struct spdk_blob *src_blob, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+	struct spdk_blob_store *bs = ctx->bs;
+	struct spdk_blob *blob = ctx->blob;
+
+	if (bserrno != 0) {
+		bs_share_cluster_cleanup(ctx, bserrno);
+		return;
+	}
+
+	ctx->src_blob = src_blob;
+
+	if (ctx->cluster_num >= blob->active.num_clusters ||
+	    blob->active.clusters[ctx->cluster_num] == 0 ||
+	    ctx->src_cluster_num >= src_blob->active.num_clusters ||
+	    src_blob->active.clusters[ctx->src_cluster_num] == 0) {
+		bs_share_cluster_cleanup(ctx, -EINVAL);
+		return;
+	}
+
+	ctx->old_lba = blob->active.clusters[ctx->cluster_num];
+	ctx->shared_lba = src_blob->active.clusters[ctx->src_cluster_num];
+	if (ctx->old_lba == ctx->shared_lba) {
+		/* Nothing to do, the cluster is shared already */
+		bs_share_cluster_cleanup(ctx, 0);
+		return;
+	}
+
+	if (!bs_share_cluster_allowed(blob, ctx->cluster_num) ||
+	    !bs_share_cluster_allowed(src_blob, ctx->src_cluster_num)) {
+		bs_share_cluster_cleanup(ctx, -EPERM);
+		return;
+	}
+
+	if (blob->locked_operation_in_progress || src_blob->locked_operation_in_progress) {
+		SPDK_DEBUGLOG(blob, "blob 0x%" PRIx64 " share cluster - another operation in progress\n",
+			      blob->id);
+		bs_share_cluster_cleanup(ctx, -EBUSY);
+		return;
+	}
+
+	blob->locked_operation_in_progress = true;
+	ctx->locked = true;
+	if (src_blob != blob) {
+		src_blob->locked_operation_in_progress = true;
+		ctx->src_locked = true;
+	}
+
+	ctx->buf = spdk_malloc(2 * bs->cluster_sz, bs->dev->blocklen, NULL,
+			       SPDK_ENV_NUMA_ID_ANY, SPDK_MALLOC_DMA);
+	if (ctx->buf == NULL) {
+		bs_share_cluster_cleanup(ctx, -ENOMEM);
+		return;
+	}
+
+	if (blob->use_extent_table) {
+		ctx->page = spdk_zmalloc(SPDK_BS_PAGE_SIZE, 0, NULL, SPDK_ENV_NUMA_ID_ANY, SPDK_MALLOC_DMA);
+		if (ctx->page == NULL) {
+			bs_share_cluster_cleanup(ctx, -ENOMEM);
+			return;
+		}
+	}
+
+	blob_freeze_io(blob, bs_share_cluster_frozen, ctx);
+}
+
+static void
+bs_share_cluster_open_cpl(void *cb_arg, struct spdk_blob *blob, int bserrno)
+{
+	struct share_cluster_ctx *ctx = cb_arg;
+
+	if (bserrno != 0) {
+		bs_share_cluster_finish(ctx, bserrno);
+		return;
+	}
+
+	ctx->blob = blob;
+	spdk_bs_open_blob(ctx->bs, ctx->src_blobid, bs_share_cluster_src_open_cpl, ctx);
+}
+
+void
+spdk_bs_blob_share_cluster(struct spdk_blob_store *bs, spdk_blob_id blobid, uint64_t cluster_num,
+			   spdk_blob_id src_blobid, uint64_t src_cluster_num,
+			   spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	struct share_cluster_ctx *ctx;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->bs = bs;
+	ctx->blobid = blobid;
+	ctx->src_blobid = src_blobid;
+	ctx->cluster_num = cluster_num;
+	ctx->src_cluster_num = src_cluster_num;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+
+	spdk_bs_open_blob(bs, blobid, bs_share_cluster_open_cpl, ctx);
+}
+/* END spdk_bs_blob_share_cluster */
+
+/* START spdk_bs_blob_cluster_fingerprint */
+
+struct cluster_fingerprint_ctx {
+	struct spdk_blob_store *bs;
+	struct spdk_io_channel *channel;
+	struct spdk_blob *blob;
+	uint64_t cluster_num;
+	uint8_t *buf;
+	uint64_t *fingerprint;
+	int bserrno;
+	spdk_blob_op_complete cb_fn;
+	void *cb_arg;
+};
+
+static void
+bs_cluster_fingerprint_finish(void *cb_arg, int bserrno)
+{
+	struct cluster_fingerprint_ctx *ctx = cb_arg;
+
+	if (bserrno != 0 && ctx->bserrno == 0) {
+		ctx->bserrno = bserrno;
+	}
+
+	spdk_free(ctx->buf);
+	ctx->cb_fn(ctx->cb_arg, ctx->bserrno);
+	free(ctx);
+}
+
+static void
+bs_cluster_fingerprint_read_cpl(void *cb_arg, int bserrno)
+{
+	struct cluster_fingerprint_ctx *ctx = cb_arg;
+
+	if (bserrno == 0) {
+		*ctx->fingerprint = spdk_crc64_iso_refl(ctx->buf, ctx->bs->cluster_sz, 0);
+	}
+
+	ctx->bserrno = bserrno;
+	spdk_blob_close(ctx->blob, bs_cluster_fingerprint_finish, ctx);
 }
 
-void
-spdk_bs_blob_set_external_parent(struct spdk_blob_store *bs, spdk_blob_id blob_id,
-				 struct spdk_bs_dev *esnap_bs_dev, const void *esnap_id,
-				 uint32_t esnap_id_len, spdk_blob_op_complete cb_fn, void *cb_arg)
+static void
+bs_cluster_fingerprint_open_cpl(void *cb_arg, struct spdk_blob *blob, int bserrno)
 {
-	struct set_parent_ctx *ctx;
-	uint64_t esnap_dev_size, cluster_sz;
+	struct cluster_fingerprint_ctx *ctx = cb_arg;
 
-	if (sizeof(blob_id) == esnap_id_len && memcmp(&blob_id, esnap_id, sizeof(blob_id)) == 0) {
-		SPDK_ERRLOG("blob id and external snapshot id cannot be the same\n");
-		cb_fn(cb_arg, -EINVAL);
+	if (bserrno != 0) {
+		bs_cluster_fingerprint_finish(ctx, bserrno);
 		return;
 	}
 
-	esnap_dev_size = esnap_bs_dev->blockcnt * esnap_bs_dev->blocklen;
-	cluster_sz = spdk_bs_get_cluster_size(bs);
-	if ((esnap_dev_size % cluster_sz) != 0) {
-		SPDK_ERRLOG("Esnap device size %" PRIu64 " is not an integer multiple of "
-			    "cluster size %" PRIu64 "\n", esnap_dev_size, cluster_sz);
-		cb_fn(cb_arg, -EINVAL);
+	ctx->blob = blob;
+
+	if (ctx->cluster_num >= blob->active.num_clusters ||
+	    blob->active.clusters[ctx->cluster_num] == 0) {
+		ctx->bserrno = -EINVAL;
+		spdk_blob_close(blob, bs_cluster_fingerprint_finish, ctx);
 		return;
 	}
 
+	blob_request_submit_op(blob, ctx->channel, ctx->buf,
+			       ctx->cluster_num * bs_io_units_per_cluster(blob),
+			       bs_io_units_per_cluster(blob), bs_cluster_fingerprint_read_cpl, ctx,
+			       SPDK_BLOB_READ);
+}
+
+void
+spdk_bs_blob_cluster_fingerprint(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+				 spdk_blob_id blobid, uint64_t cluster_num, uint64_t *fingerprint,
+				 spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	struct cluster_fingerprint_ctx *ctx;
+
 	ctx = calloc(1, sizeof(*ctx));
 	if (!ctx) {
 		cb_fn(cb_arg, -ENOMEM);
 		return;
 	}
 
-	ctx->parent.u.esnap.id = calloc(1, esnap_id_len);
-	if (!ctx->parent.u.esnap.id) {
+	ctx->buf = spdk_malloc(bs->cluster_sz, bs->dev->blocklen, NULL,
+			       SPDK_ENV_NUMA_ID_ANY, SPDK_MALLOC_DMA);
+	if (!ctx->buf) {
 		free(ctx);
 		cb_fn(cb_arg, -ENOMEM);
 		return;
 	}
 
 	ctx->bs = bs;
-	ctx->parent.u.esnap.back_bs_dev = esnap_bs_dev;
-	memcpy(ctx->parent.u.esnap.id, esnap_id, esnap_id_len);
-	ctx->parent.u.esnap.id_len = esnap_id_len;
+	ctx->channel = channel;
+	ctx->cluster_num = cluster_num;
+	ctx->fingerprint = fingerprint;
 	ctx->cb_fn = cb_fn;
 	ctx->cb_arg = cb_arg;
-	ctx->bserrno = 0;
 
-	spdk_bs_open_blob(bs, blob_id, bs_set_external_parent_blob_open_cpl, ctx);
+	spdk_bs_open_blob(bs, blobid, bs_cluster_fingerprint_open_cpl, ctx);
 }
-/* END spdk_bs_blob_set_external_parent */
+/* END spdk_bs_blob_cluster_fingerprint */
+
 
 /* START spdk_bs_snapshot_checksum */
 
@@ -8014,10 +10640,10 @@ bs_snapshot_checksum_cluster_find_next(void *cb_arg)
 	}
 
 	if (ctx->cluster < _blob->active.num_clusters) {
-		blob_request_submit_op_single(ctx->blob_channel, _blob, ctx->read_buff,
-					      bs_cluster_to_lba(_blob->bs, ctx->cluster),
-					      bs_dev_byte_to_lba(_blob->bs->dev, _blob->bs->cluster_sz),
-					      bs_snapshot_checksum_blob_read_cpl, ctx, SPDK_BLOB_READ);
+		blob_request_submit_op(_blob, ctx->blob_channel, ctx->read_buff,
+				       bs_cluster_to_lba(_blob->bs, ctx->cluster),
+				       bs_dev_byte_to_lba(_blob->bs->dev, _blob->bs->cluster_sz),
+				       bs_snapshot_checksum_blob_read_cpl, ctx, SPDK_BLOB_READ);
 	} else {
 		bs_snapshot_checksum_store_xattr(ctx);
 	}
@@ -8098,6 +10724,7 @@ struct spdk_bs_resize_ctx {
 	struct spdk_blob *blob;
 	uint64_t sz;
 	int rc;
+	bool reserves_released;
 };
 
 static void
@@ -8120,6 +10747,15 @@ bs_resize_unfreeze_cpl(void *cb_arg, int rc)
 	free(ctx);
 }
 
+static void
+bs_resize_freeze_cpl(void *cb_arg, int rc);
+
+static void
+bs_resize_reserves_released(struct spdk_io_channel_iter *i, int status)
+{
+	bs_resize_freeze_cpl(spdk_io_channel_iter_get_ctx(i), 0);
+}
+
 static void
 bs_resize_freeze_cpl(void *cb_arg, int rc)
 {
@@ -8133,6 +10769,12 @@ bs_resize_freeze_cpl(void *cb_arg, int rc)
 	}
 
 	ctx->rc = blob_resize(ctx->blob, ctx->sz);
+	if (ctx->rc == -ENOSPC && !ctx->reserves_released && bs_has_reserved_clusters(ctx->blob->bs)) {
+		ctx->reserves_released = true;
+		spdk_for_each_channel(ctx->blob->bs, bs_channel_release_clusters_iter, ctx,
+				      bs_resize_reserves_released);
+		return;
+	}
 
 	blob_unfreeze_io(ctx->blob, bs_resize_unfreeze_cpl, ctx);
 }
@@ -8580,6 +11222,13 @@ delete_snapshot_open_clone_cb(void *cb_arg, struct spdk_blob *clone, int bserrno
 		return;
 	}
 
+	if (blob_has_cow_units(clone) || blob_has_cow_units(ctx->snapshot)) {
+		SPDK_ERRLOG("Cannot remove snapshot - clusters of its clone are not entirely copied\n");
+		ctx->bserrno = -EBUSY;
+		spdk_blob_close(ctx->clone, delete_snapshot_cleanup_snapshot, ctx);
+		return;
+	}
+
 	clone->locked_operation_in_progress = true;
 
 	blob_freeze_io(clone, delete_snapshot_freeze_io_cb, ctx);
@@ -8988,9 +11637,13 @@ struct spdk_blob_cluster_op_ctx {
 	uint32_t		cluster;	/* cluster on disk */
 	uint32_t		extent_page;	/* extent page on disk */
 	struct spdk_blob_md_page *page; /* preallocated extent page */
+	uint64_t		cow_units;	/* units of the cluster still in the parent */
+	uint64_t		replaced_lba;	/* shared cluster replaced by a private copy */
 	int			rc;
 	spdk_blob_op_complete	cb_fn;
 	void			*cb_arg;
+	bool			write_extent_page;
+	TAILQ_ENTRY(spdk_blob_cluster_op_ctx) link;
 };
 
 static void
@@ -9011,18 +11664,6 @@ blob_op_cluster_msg_cb(void *arg, int bserrno)
 	spdk_thread_send_msg(ctx->thread, blob_op_cluster_msg_cpl, ctx);
 }
 
-static void
-blob_insert_new_ep_cb(void *arg, int bserrno)
-{
-	struct spdk_blob_cluster_op_ctx *ctx = arg;
-	uint32_t *extent_page;
-
-	extent_page = bs_cluster_to_extent_page(ctx->blob, ctx->cluster_num);
-	*extent_page = ctx->extent_page;
-	ctx->blob->state = SPDK_BLOB_STATE_DIRTY;
-	blob_sync_md(ctx->blob, blob_op_cluster_msg_cb, ctx);
-}
-
 struct spdk_blob_write_extent_page_ctx {
 	struct spdk_blob_store		*bs;
 
@@ -9135,55 +11776,296 @@ blob_write_extent_page(struct spdk_blob *blob, uint32_t extent, uint64_t cluster
 	bs_mark_dirty(seq, blob->bs, blob_write_extent_page_ready, ctx);
 }
 
+struct spdk_blob_insert_flush_ctx {
+	struct spdk_blob			*blob;
+	TAILQ_HEAD(, spdk_blob_cluster_op_ctx)	inserts;
+	struct spdk_blob_md_page		*pages;
+	uint32_t				num_pages;
+	uint32_t				outstanding;
+	bool					new_extent_pages;
+	int					rc;
+};
+
+static void blob_insert_cluster_flush(struct spdk_blob *blob);
+
 static void
-blob_insert_cluster_msg(void *arg)
+blob_insert_cluster_complete(struct spdk_blob_cluster_op_ctx *ctx, int bserrno)
 {
-	struct spdk_blob_cluster_op_ctx *ctx = arg;
+	struct spdk_blob *blob = ctx->blob;
+
+	if (ctx->replaced_lba != 0) {
+		if (bserrno != 0 &&
+		    blob->active.clusters[ctx->cluster_num] == bs_cluster_to_lba(blob->bs, ctx->cluster)) {
+			/* Keep using the shared cluster */
+			blob->active.clusters[ctx->cluster_num] = ctx->replaced_lba;
+		} else if (bserrno == 0) {
+			/* Drop the reference of this blob to the shared cluster */
+			spdk_spin_lock(&blob->bs->used_lock);
+			bs_release_cluster(blob->bs, bs_lba_to_cluster(blob->bs, ctx->replaced_lba));
+			spdk_spin_unlock(&blob->bs->used_lock);
+		}
+	} else if (bserrno != 0 &&
+		   blob->active.clusters[ctx->cluster_num] == bs_cluster_to_lba(blob->bs, ctx->cluster)) {
+		/* The cluster is released by the originating thread, drop it from the map */
+		blob->active.clusters[ctx->cluster_num] = 0;
+		blob->active.num_allocated_clusters--;
+		if (ctx->cow_units != 0) {
+			blob->cow_units[ctx->cluster_num] = 0;
+		}
+	}
+
+	blob_op_cluster_msg_cb(ctx, bserrno);
+}
+
+static void
+blob_insert_cluster_flush_cpl(void *arg, int bserrno)
+{
+	struct spdk_blob_insert_flush_ctx *flush = arg;
+	struct spdk_blob *blob = flush->blob;
+	struct spdk_blob_cluster_op_ctx *ctx;
+
+	while (!TAILQ_EMPTY(&flush->inserts)) {
+		ctx = TAILQ_FIRST(&flush->inserts);
+		TAILQ_REMOVE(&flush->inserts, ctx, link);
+		blob_insert_cluster_complete(ctx, bserrno);
+	}
+
+	spdk_free(flush->pages);
+	free(flush);
+
+	if (!TAILQ_EMPTY(&blob->pending_cluster_inserts)) {
+		/* Commit everything that arrived while this flush was in progress */
+		blob_insert_cluster_flush(blob);
+		return;
+	}
+
+	blob->cluster_insert_flush_in_progress = false;
+}
+
+static void
+blob_insert_cluster_flush_ep_cpl(void *arg, int bserrno)
+{
+	struct spdk_blob_insert_flush_ctx *flush = arg;
+	struct spdk_blob *blob = flush->blob;
+	struct spdk_blob_cluster_op_ctx *ctx;
+
+	if (bserrno != 0) {
+		flush->rc = bserrno;
+	}
+
+	assert(flush->outstanding > 0);
+	if (--flush->outstanding > 0) {
+		return;
+	}
+
+	if (flush->rc != 0 || !flush->new_extent_pages) {
+		blob_insert_cluster_flush_cpl(flush, flush->rc);
+		return;
+	}
+
+	/* New extent pages are on disk, so they can be referenced from the extent table now */
+	TAILQ_FOREACH(ctx, &flush->inserts, link) {
+		if (ctx->write_extent_page && ctx->extent_page != 0) {
+			*bs_cluster_to_extent_page(blob, ctx->cluster_num) = ctx->extent_page;
+			ctx->extent_page = 0;
+		}
+	}
+
+	blob->state = SPDK_BLOB_STATE_DIRTY;
+	blob_sync_md(blob, blob_insert_cluster_flush_cpl, flush);
+}
+
+static struct spdk_blob_cluster_op_ctx *
+blob_insert_cluster_flush_find_ep_writer(struct spdk_blob_insert_flush_ctx *flush,
+		struct spdk_blob_cluster_op_ctx *ctx)
+{
+	uint64_t extent_table_id = bs_cluster_to_extent_table_id(ctx->cluster_num);
+	struct spdk_blob_cluster_op_ctx *tmp;
+
+	TAILQ_FOREACH(tmp, &flush->inserts, link) {
+		if (tmp == ctx) {
+			break;
+		}
+		if (tmp->write_extent_page &&
+		    bs_cluster_to_extent_table_id(tmp->cluster_num) == extent_table_id) {
+			return tmp;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+blob_insert_cluster_flush_write_eps(void *arg, int bserrno)
+{
+	struct spdk_blob_insert_flush_ctx *flush = arg;
+	struct spdk_blob *blob = flush->blob;
+	struct spdk_blob_cluster_op_ctx *ctx;
 	uint32_t *extent_page;
+	uint32_t i = 0;
 
-	ctx->rc = blob_insert_cluster(ctx->blob, ctx->cluster_num, ctx->cluster);
-	if (ctx->rc != 0) {
-		spdk_thread_send_msg(ctx->thread, blob_op_cluster_msg_cpl, ctx);
+	if (bserrno != 0) {
+		blob_insert_cluster_flush_cpl(flush, bserrno);
 		return;
 	}
 
-	if (ctx->blob->use_extent_table == false) {
+	/* Hold an extra reference so that a synchronous failure does not complete the flush early */
+	flush->outstanding = flush->num_pages + 1;
+	TAILQ_FOREACH(ctx, &flush->inserts, link) {
+		if (!ctx->write_extent_page) {
+			continue;
+		}
+		extent_page = bs_cluster_to_extent_page(blob, ctx->cluster_num);
+		blob_write_extent_page(blob, *extent_page != 0 ? *extent_page : ctx->extent_page,
+				       ctx->cluster_num, &flush->pages[i++],
+				       blob_insert_cluster_flush_ep_cpl, flush);
+	}
+	blob_insert_cluster_flush_ep_cpl(flush, 0);
+}
+
+/*
+ * Persist all pending cluster insertions of the blob at once. Every extent page touched
+ * by the batch is written once, and the blob metadata is synced once if any extent page
+ * had to be allocated (or if the blob does not use the extent table).
+ */
+static void
+blob_insert_cluster_flush(struct spdk_blob *blob)
+{
+	struct spdk_blob_insert_flush_ctx *flush;
+	struct spdk_blob_cluster_op_ctx *ctx;
+	uint32_t *extent_page;
+	uint32_t num_pages = 0;
+
+	assert(blob->cluster_insert_flush_in_progress);
+
+	flush = calloc(1, sizeof(*flush));
+	if (!flush) {
+		while (!TAILQ_EMPTY(&blob->pending_cluster_inserts)) {
+			ctx = TAILQ_FIRST(&blob->pending_cluster_inserts);
+			TAILQ_REMOVE(&blob->pending_cluster_inserts, ctx, link);
+			blob_insert_cluster_complete(ctx, -ENOMEM);
+		}
+		blob->cluster_insert_flush_in_progress = false;
+		return;
+	}
+
+	flush->blob = blob;
+	TAILQ_INIT(&flush->inserts);
+	TAILQ_SWAP(&flush->inserts, &blob->pending_cluster_inserts, spdk_blob_cluster_op_ctx, link);
+
+	if (blob->use_extent_table == false) {
 		/* Extent table is not used, proceed with sync of md that will only use extents_rle. */
-		ctx->blob->state = SPDK_BLOB_STATE_DIRTY;
-		blob_sync_md(ctx->blob, blob_op_cluster_msg_cb, ctx);
+		blob->state = SPDK_BLOB_STATE_DIRTY;
+		blob_sync_md(blob, blob_insert_cluster_flush_cpl, flush);
+		return;
+	}
+
+	TAILQ_FOREACH(ctx, &flush->inserts, link) {
+		extent_page = bs_cluster_to_extent_page(blob, ctx->cluster_num);
+		if (blob_insert_cluster_flush_find_ep_writer(flush, ctx) == NULL) {
+			ctx->write_extent_page = true;
+			num_pages++;
+		}
+
+		if (*extent_page == 0 && ctx->write_extent_page) {
+			/* Extent page requires allocation.
+			 * It was already claimed in the used_md_pages map and placed in ctx. */
+			assert(ctx->extent_page != 0);
+			assert(spdk_bit_array_get(blob->bs->used_md_pages, ctx->extent_page) == true);
+			flush->new_extent_pages = true;
+		} else if (ctx->extent_page != 0) {
+			/* It is possible for original thread to allocate extent page for
+			 * different cluster in the same extent page. In such case proceed with
+			 * updating the existing extent page, but release the additional one. */
+			spdk_spin_lock(&blob->bs->used_lock);
+			assert(spdk_bit_array_get(blob->bs->used_md_pages, ctx->extent_page) == true);
+			bs_release_md_page(blob->bs, ctx->extent_page);
+			spdk_spin_unlock(&blob->bs->used_lock);
+			ctx->extent_page = 0;
+		}
+	}
+
+	flush->pages = spdk_zmalloc(num_pages * SPDK_BS_PAGE_SIZE, 0, NULL, SPDK_ENV_NUMA_ID_ANY,
+				    SPDK_MALLOC_DMA);
+	if (!flush->pages) {
+		blob_insert_cluster_flush_cpl(flush, -ENOMEM);
 		return;
 	}
+	flush->num_pages = num_pages;
 
-	extent_page = bs_cluster_to_extent_page(ctx->blob, ctx->cluster_num);
-	if (*extent_page == 0) {
-		/* Extent page requires allocation.
-		 * It was already claimed in the used_md_pages map and placed in ctx. */
-		assert(ctx->extent_page != 0);
-		assert(spdk_bit_array_get(ctx->blob->bs->used_md_pages, ctx->extent_page) == true);
-		blob_write_extent_page(ctx->blob, ctx->extent_page, ctx->cluster_num, ctx->page,
-				       blob_insert_new_ep_cb, ctx);
+	if (blob->cow_unit_size != 0) {
+		/* The units still in the parent have to be on disk before the extent pages
+		 * that make their clusters allocated. */
+		blob->state = SPDK_BLOB_STATE_DIRTY;
+		blob_sync_md(blob, blob_insert_cluster_flush_write_eps, flush);
+		return;
+	}
+
+	blob_insert_cluster_flush_write_eps(flush, 0);
+}
+
+static void
+blob_insert_cluster_flush_msg(void *arg)
+{
+	blob_insert_cluster_flush(arg);
+}
+
+static void
+blob_insert_cluster_msg(void *arg)
+{
+	struct spdk_blob_cluster_op_ctx *ctx = arg;
+	struct spdk_blob *blob = ctx->blob;
+	uint64_t cow_units = 0;
+	bool cow_units_set = false;
+
+	if (ctx->cow_units != 0 && blob->active.clusters[ctx->cluster_num] == ctx->replaced_lba) {
+		/* Threads doing I/O look the units up once they see the cluster in the map,
+		 * so they have to be in place before it is inserted */
+		assert(ctx->cluster_num < blob->cow_units_array_size);
+		cow_units = blob->cow_units[ctx->cluster_num];
+		blob->cow_units[ctx->cluster_num] = ctx->cow_units;
+		cow_units_set = true;
+		spdk_smp_wmb();
+	}
+
+	if (ctx->replaced_lba != 0) {
+		/* The shared cluster may have been replaced already by another thread */
+		if (blob->active.clusters[ctx->cluster_num] != ctx->replaced_lba) {
+			ctx->rc = -EEXIST;
+		} else {
+			blob_verify_md_op(blob);
+			blob->active.clusters[ctx->cluster_num] = bs_cluster_to_lba(blob->bs, ctx->cluster);
+			ctx->rc = 0;
+		}
 	} else {
-		/* It is possible for original thread to allocate extent page for
-		 * different cluster in the same extent page. In such case proceed with
-		 * updating the existing extent page, but release the additional one. */
-		if (ctx->extent_page != 0) {
-			spdk_spin_lock(&ctx->blob->bs->used_lock);
-			assert(spdk_bit_array_get(ctx->blob->bs->used_md_pages, ctx->extent_page) == true);
-			bs_release_md_page(ctx->blob->bs, ctx->extent_page);
-			spdk_spin_unlock(&ctx->blob->bs->used_lock);
-			ctx->extent_page = 0;
+		ctx->rc = blob_insert_cluster(blob, ctx->cluster_num, ctx->cluster);
+	}
+	if (ctx->rc != 0) {
+		if (cow_units_set) {
+			blob->cow_units[ctx->cluster_num] = cow_units;
 		}
-		/* Extent page already allocated.
-		 * Every cluster allocation, requires just an update of single extent page. */
-		blob_write_extent_page(ctx->blob, *extent_page, ctx->cluster_num, ctx->page,
-				       blob_op_cluster_msg_cb, ctx);
+		spdk_thread_send_msg(ctx->thread, blob_op_cluster_msg_cpl, ctx);
+		return;
+	}
+
+	TAILQ_INSERT_TAIL(&blob->pending_cluster_inserts, ctx, link);
+	if (blob->cluster_insert_flush_in_progress) {
+		/* Will be persisted by the flush following the current one */
+		return;
+	}
+
+	blob->cluster_insert_flush_in_progress = true;
+	/* Defer the flush, so that the insertions already queued on the md thread
+	 * are committed together with this one. */
+	if (spdk_thread_send_msg(spdk_get_thread(), blob_insert_cluster_flush_msg, blob) != 0) {
+		blob_insert_cluster_flush(blob);
 	}
 }
 
 static void
 blob_insert_cluster_on_md_thread(struct spdk_blob *blob, uint32_t cluster_num,
-				 uint64_t cluster, uint32_t extent_page, struct spdk_blob_md_page *page,
-				 spdk_blob_op_complete cb_fn, void *cb_arg)
+				 uint64_t cluster, uint32_t extent_page, uint64_t cow_units,
+				 uint64_t replaced_lba, spdk_blob_op_complete cb_fn, void *cb_arg)
 {
 	struct spdk_blob_cluster_op_ctx *ctx;
 
@@ -9198,13 +12080,160 @@ blob_insert_cluster_on_md_thread(struct spdk_blob *blob, uint32_t cluster_num,
 	ctx->cluster_num = cluster_num;
 	ctx->cluster = cluster;
 	ctx->extent_page = extent_page;
-	ctx->page = page;
+	ctx->cow_units = cow_units;
+	ctx->replaced_lba = replaced_lba;
 	ctx->cb_fn = cb_fn;
 	ctx->cb_arg = cb_arg;
 
 	spdk_thread_send_msg(blob->bs->md_thread, blob_insert_cluster_msg, ctx);
 }
 
+static void
+blob_cow_claim_msg_cpl(void *arg)
+{
+	struct spdk_blob_cow_claim *claim = arg;
+
+	claim->cb_fn(claim->cb_arg, claim->rc);
+}
+
+/*
+ * Hand out the requested units of a partially copied cluster that are still in the
+ * parent and not being copied by another thread. A claim that overlaps units being
+ * copied waits until that copy is committed. Once only a few units of the cluster
+ * would remain in the parent, they are added to the claim to complete the cluster.
+ */
+static void
+blob_cow_claim_process(struct spdk_blob_cow_claim *claim)
+{
+	struct spdk_blob *blob = claim->blob;
+	struct spdk_blob_cow_claim *tmp;
+	uint64_t missing, claimed = 0, rest;
+
+	TAILQ_FOREACH(tmp, &blob->cow_claims, link) {
+		if (tmp->cluster_num != claim->cluster_num) {
+			continue;
+		}
+		if (tmp->units & claim->units) {
+			TAILQ_INSERT_TAIL(&blob->cow_claims_waiting, claim, link);
+			return;
+		}
+		claimed |= tmp->units;
+	}
+
+	missing = 0;
+	if (claim->cluster_num < blob->active.num_clusters &&
+	    blob->active.clusters[claim->cluster_num] != 0) {
+		missing = bs_cluster_cow_units(blob, claim->cluster_num);
+	}
+	claim->units &= missing;
+
+	rest = missing & ~claimed & ~claim->units;
+	if (claim->units != 0 && (uint32_t)__builtin_popcountll(rest) <=
+	    bs_cow_units_per_cluster(blob) / BS_COW_FILL_DIVISOR) {
+		claim->units |= rest;
+	}
+
+	if (claim->units != 0) {
+		TAILQ_INSERT_TAIL(&blob->cow_claims, claim, link);
+	}
+
+	spdk_thread_send_msg(claim->thread, blob_cow_claim_msg_cpl, claim);
+}
+
+static void
+blob_cow_claim_msg(void *arg)
+{
+	blob_cow_claim_process(arg);
+}
+
+static void
+blob_cow_claim_on_md_thread(struct spdk_blob *blob, struct spdk_blob_cow_claim *claim,
+			    uint32_t cluster_num, uint64_t units,
+			    spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	claim->thread = spdk_get_thread();
+	claim->blob = blob;
+	claim->cluster_num = cluster_num;
+	claim->units = units;
+	claim->committing = false;
+	claim->rc = 0;
+	claim->cb_fn = cb_fn;
+	claim->cb_arg = cb_arg;
+
+	spdk_thread_send_msg(blob->bs->md_thread, blob_cow_claim_msg, claim);
+}
+
+static void
+blob_cow_commit_release(struct spdk_blob_cow_claim *claim, int bserrno)
+{
+	struct spdk_blob *blob = claim->blob;
+	TAILQ_HEAD(, spdk_blob_cow_claim) waiting;
+	struct spdk_blob_cow_claim *tmp;
+
+	TAILQ_REMOVE(&blob->cow_claims, claim, link);
+	claim->committing = false;
+
+	/* Let the claims that waited for these units have another look */
+	TAILQ_INIT(&waiting);
+	TAILQ_SWAP(&blob->cow_claims_waiting, &waiting, spdk_blob_cow_claim, link);
+	while (!TAILQ_EMPTY(&waiting)) {
+		tmp = TAILQ_FIRST(&waiting);
+		TAILQ_REMOVE(&waiting, tmp, link);
+		blob_cow_claim_process(tmp);
+	}
+
+	claim->rc = bserrno;
+	spdk_thread_send_msg(claim->thread, blob_cow_claim_msg_cpl, claim);
+}
+
+static void
+blob_cow_commit_sync_cpl(void *arg, int bserrno)
+{
+	struct spdk_blob_cow_claim *claim = arg;
+	struct spdk_blob *blob = claim->blob;
+
+	if (bserrno == 0 && claim->cluster_num < blob->cow_units_array_size) {
+		/* The units are persisted as local, the parent is not read for them anymore */
+		blob->cow_units[claim->cluster_num] &= ~claim->units;
+	}
+
+	blob_cow_commit_release(claim, bserrno);
+}
+
+static void
+blob_cow_commit_msg(void *arg)
+{
+	struct spdk_blob_cow_claim *claim = arg;
+	struct spdk_blob *blob = claim->blob;
+
+	if (claim->rc != 0 || claim->cluster_num >= blob->active.num_clusters ||
+	    blob->active.clusters[claim->cluster_num] == 0) {
+		blob_cow_commit_release(claim, claim->rc);
+		return;
+	}
+
+	/*
+	 * The units hold their own data now. They are still read from the parent until
+	 * the metadata is persisted, writes to them wait for the claim to be released,
+	 * so that they can't be acknowledged before the units are local on disk.
+	 */
+	claim->committing = true;
+	blob->state = SPDK_BLOB_STATE_DIRTY;
+	blob_sync_md(blob, blob_cow_commit_sync_cpl, claim);
+}
+
+static void
+blob_cow_commit_on_md_thread(struct spdk_blob_cow_claim *claim, int bserrno,
+			     spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	claim->thread = spdk_get_thread();
+	claim->rc = bserrno;
+	claim->cb_fn = cb_fn;
+	claim->cb_arg = cb_arg;
+
+	spdk_thread_send_msg(claim->blob->bs->md_thread, blob_cow_commit_msg, claim);
+}
+
 static void
 blob_free_cluster_msg(void *arg)
 {
@@ -9226,6 +12255,9 @@ blob_free_cluster_msg(void *arg)
 	if (ctx->cluster != 0) {
 		ctx->blob->active.num_allocated_clusters--;
 	}
+	if (bs_cluster_cow_units(ctx->blob, ctx->cluster_num) != 0) {
+		ctx->blob->cow_units[ctx->cluster_num] = 0;
+	}
 
 	if (ctx->blob->use_extent_table == false) {
 		/* Extent table is not used, proceed with sync of md that will only use extents_rle. */
@@ -9879,6 +12911,7 @@ bs_load_grow_continue(struct spdk_bs_load_ctx *ctx)
 
 	/* Parse the super block */
 	ctx->bs->clean = 1;
+	ctx->bs->shared_clusters = ctx->super->version >= SPDK_BS_VERSION_SHARED_CLUSTERS;
 	ctx->bs->cluster_sz = ctx->super->cluster_size;
 	ctx->bs->total_clusters = ctx->super->size / ctx->super->cluster_size;
 	ctx->bs->pages_per_cluster = ctx->bs->cluster_sz / SPDK_BS_PAGE_SIZE;
@@ -9908,6 +12941,10 @@ bs_load_grow_continue(struct spdk_bs_load_ctx *ctx)
 		SPDK_ERRLOG("Can not grow an unclean blobstore, please load it normally to clean it.\n");
 		bs_load_ctx_fail(ctx, -EIO);
 		return;
+	} else if (ctx->bs->shared_clusters) {
+		SPDK_ERRLOG("Can not grow a blobstore with shared clusters offline.\n");
+		bs_load_ctx_fail(ctx, -EIO);
+		return;
 	} else {
 		bs_load_read_used_pages(ctx);
 	}
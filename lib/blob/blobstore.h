@@ -27,6 +27,32 @@
 #define SPDK_BLOB_OPTS_DEFAULT_CHANNEL_OPS 512
 #define SPDK_BLOB_BLOBID_HIGH_BIT (1ULL << 32)
 
+/* Maximum number of clusters a channel claims at once for thin provisioning */
+#define BS_CLUSTER_RESERVE_BATCH 32
+/* A channel never holds more than 1/BS_CLUSTER_RESERVE_DIVISOR of the free clusters */
+#define BS_CLUSTER_RESERVE_DIVISOR 64
+/* Maximum number of cluster allocations in progress on a single channel */
+#define BS_MAX_CLUSTER_ALLOCS_PER_CHANNEL 16
+
+/* Copy-on-write through host memory is done in chunks of this size */
+#define BS_COW_CHUNK_SIZE (64 * 1024)
+/* Number of chunks a single cluster copy keeps in flight */
+#define BS_COW_CHUNK_DEPTH 4
+/* Number of chunk buffers shared by the cluster copies on a channel */
+#define BS_COW_BUFS_PER_CHANNEL 16
+/* A partially copied cluster is completed once at most 1/BS_COW_FILL_DIVISOR of it is left */
+#define BS_COW_FILL_DIVISOR 4
+
+/* Delay before checking again whether the I/O to a cluster being moved or shared is done */
+#define BS_CLUSTER_DRAIN_RETRY_US 100
+
+/* Recovery reads the metadata region ahead in windows of this many pages */
+#define BS_LOAD_REPLAY_WINDOW_PAGES 64
+/* Number of metadata windows read ahead during recovery */
+#define BS_LOAD_REPLAY_WINDOWS 4
+/* Number of extent pages read at once when a blob is opened */
+#define BS_LOAD_EXTENT_PAGES_BATCH 32
+
 struct spdk_xattr {
 	uint32_t	index;
 	uint16_t	value_len;
@@ -148,9 +174,39 @@ struct spdk_blob {
 	TAILQ_HEAD(, spdk_blob_persist_ctx) pending_persists;
 	TAILQ_HEAD(, spdk_blob_persist_ctx) persists_to_complete;
 
+	/* Cluster insertions received on the md thread that wait for the next
+	 * extent page / metadata flush. Only one flush is in progress at a time,
+	 * insertions arriving meanwhile are committed together by the next one. */
+	TAILQ_HEAD(, spdk_blob_cluster_op_ctx) pending_cluster_inserts;
+	bool		cluster_insert_flush_in_progress;
+
 	/* Number of data clusters retrieved from extent table,
 	 * that many have to be read from extent pages. */
 	uint64_t	remaining_clusters_in_et;
+
+	/* Sub-cluster copy-on-write. When cow_unit_size is not 0, an allocated cluster
+	 * may be only partially copied from the parent. A bit set in cow_units[cluster_num]
+	 * marks a unit of cow_unit_size bytes whose data is still only in the parent.
+	 * The array is updated on the md thread and holds at least num_clusters entries. */
+	uint32_t	cow_unit_size;
+	uint64_t	*cow_units;
+	size_t		cow_units_array_size;
+
+	/* Units being copied from the parent, and requests waiting for them to be
+	 * copied. Only accessed on the md thread. */
+	TAILQ_HEAD(, spdk_blob_cow_claim) cow_claims;
+	TAILQ_HEAD(, spdk_blob_cow_claim) cow_claims_waiting;
+};
+
+/*
+ * Number of references to each cluster in addition to the first one, for clusters shared by
+ * several blobs. The array is replaced when it has to grow, the old ones are kept until the
+ * blobstore is unloaded, because I/O threads read it without taking used_lock.
+ */
+struct spdk_bs_cluster_refs {
+	uint64_t			num_clusters;
+	struct spdk_bs_cluster_refs	*prev;
+	uint32_t			refs[];
 };
 
 struct spdk_blob_store {
@@ -166,6 +222,8 @@ struct spdk_blob_store {
 
 	struct spdk_bit_array		*used_md_pages;		/* Protected by used_lock */
 	struct spdk_bit_pool		*used_clusters;		/* Protected by used_lock */
+	struct spdk_bs_cluster_refs	*cluster_refs;		/* Protected by used_lock */
+	uint64_t			num_saved_clusters;	/* Protected by used_lock */
 	struct spdk_bit_array		*used_blobids;
 	struct spdk_bit_array		*open_blobids;
 
@@ -175,6 +233,8 @@ struct spdk_blob_store {
 	uint64_t			total_clusters;
 	uint64_t			total_data_clusters;
 	uint64_t			num_free_clusters;	/* Protected by used_lock */
+	uint64_t			num_reserved_clusters;	/* Held by bs_channel reserves */
+	uint64_t			cow_bw_limit;		/* Bytes per second per channel, 0 = unlimited */
 	uint64_t			pages_per_cluster;
 	uint8_t				pages_per_cluster_shift;
 	uint32_t			io_unit_size;
@@ -189,6 +249,8 @@ struct spdk_blob_store {
 	TAILQ_HEAD(, spdk_blob_list)	snapshots;
 
 	bool				clean;
+	/* Blobs may share clusters, the super block is written with SPDK_BS_VERSION_SHARED_CLUSTERS */
+	bool				shared_clusters;
 
 	spdk_bs_esnap_dev_create	esnap_bs_dev_create;
 	void				*esnap_ctx;
@@ -211,10 +273,34 @@ struct spdk_bs_channel {
 	struct spdk_bs_dev		*dev;
 	struct spdk_io_channel		*dev_channel;
 
-	/* This page is only used during insert of a new cluster. */
+	/* This page is only used during release of a cluster. */
 	struct spdk_blob_md_page	*new_cluster_page;
 
+	/* Clusters claimed from used_clusters ahead of time, so that allocating
+	 * a cluster for a thin provisioned blob does not take used_lock. */
+	uint32_t			reserved_clusters[BS_CLUSTER_RESERVE_BATCH];
+	uint32_t			num_reserved_clusters;
+
+	/* Cluster allocations in progress on this channel */
+	TAILQ_HEAD(, spdk_blob_copy_cluster_ctx) cluster_allocs;
+	uint32_t			num_cluster_allocs;
+
+	/* Preallocated contexts for cluster_allocs */
+	struct spdk_blob_copy_cluster_ctx *cluster_alloc_mem;
+	TAILQ_HEAD(, spdk_blob_copy_cluster_ctx) free_cluster_allocs;
+
+	/* User ops waiting for a free slot in cluster_allocs */
 	TAILQ_HEAD(, spdk_bs_request_set) need_cluster_alloc;
+
+	/* Chunk buffers for copy-on-write, allocated on first use */
+	uint8_t				*cow_buf_mem;
+	uint8_t				*cow_bufs[BS_COW_BUFS_PER_CHANNEL];
+	uint32_t			num_cow_bufs;
+	/* Cluster copies waiting for a chunk buffer or for cow bandwidth */
+	TAILQ_HEAD(, spdk_blob_copy_cluster_ctx) cow_waiting;
+	int64_t				cow_tokens;
+	uint64_t			cow_last_tsc;
+	struct spdk_poller		*cow_poller;
 	TAILQ_HEAD(, spdk_bs_request_set) queued_io;
 
 	RB_HEAD(blob_esnap_channel_tree, blob_esnap_channel) esnap_channels;
@@ -248,6 +334,11 @@ struct spdk_blob_bs_dev {
  */
 #define SPDK_BS_INITIAL_VERSION 1
 #define SPDK_BS_VERSION 3 /* current version */
+/*
+ * Blobs may share clusters. The reference counts of the clusters are not stored on disk,
+ * they are rebuilt from the metadata of all blobs every time the blobstore is loaded.
+ */
+#define SPDK_BS_VERSION_SHARED_CLUSTERS 4
 
 #pragma pack(push, 1)
 
@@ -286,6 +377,12 @@ struct spdk_bs_md_mask {
  * serialized metadata chain for a blob. */
 #define SPDK_MD_DESCRIPTOR_TYPE_EXTENT_PAGE 6
 
+/* COW_UNITS descriptor holds the size of the sub-cluster copy-on-write unit
+ * and, for every partially copied cluster, the mask of units that are still
+ * in the parent. It is part of serialized metadata chain for a blob and is
+ * present only in blobs with SPDK_BLOB_COW_UNITS set. */
+#define SPDK_MD_DESCRIPTOR_TYPE_COW_UNITS 7
+
 struct spdk_blob_md_descriptor_xattr {
 	uint8_t		type;
 	uint32_t	length;
@@ -330,12 +427,27 @@ struct spdk_blob_md_descriptor_extent_page {
 	uint32_t	cluster_idx[0];
 };
 
+struct spdk_blob_md_descriptor_cow_units {
+	uint8_t		type;
+	uint32_t	length;
+
+	/* Size of the copy-on-write unit, in bytes */
+	uint32_t	unit_size;
+
+	struct {
+		uint32_t	cluster_idx;
+		uint64_t	units; /* Bit set for a unit still in the parent */
+	} clusters[0];
+};
+
 #define SPDK_BLOB_THIN_PROV		(1ULL << 0)
 #define SPDK_BLOB_INTERNAL_XATTR	(1ULL << 1)
 #define SPDK_BLOB_EXTENT_TABLE		(1ULL << 2)
 #define SPDK_BLOB_EXTERNAL_SNAPSHOT	(1ULL << 3)
+#define SPDK_BLOB_COW_UNITS		(1ULL << 4)
 #define SPDK_BLOB_INVALID_FLAGS_MASK	(SPDK_BLOB_THIN_PROV | SPDK_BLOB_INTERNAL_XATTR | \
-					 SPDK_BLOB_EXTENT_TABLE | SPDK_BLOB_EXTERNAL_SNAPSHOT)
+					 SPDK_BLOB_EXTENT_TABLE | SPDK_BLOB_EXTERNAL_SNAPSHOT | \
+					 SPDK_BLOB_COW_UNITS)
 
 #define SPDK_BLOB_READ_ONLY (1ULL << 0)
 #define SPDK_BLOB_DATA_RO_FLAGS_MASK	SPDK_BLOB_READ_ONLY
@@ -569,6 +681,45 @@ bs_io_units_per_cluster(struct spdk_blob *blob)
 	return io_units_per_cluster;
 }
 
+/* Number of io_units in a sub-cluster copy-on-write unit */
+static inline uint64_t
+bs_io_units_per_cow_unit(struct spdk_blob *blob)
+{
+	assert(blob->cow_unit_size != 0);
+
+	return blob->cow_unit_size / blob->bs->io_unit_size;
+}
+
+/* Number of sub-cluster copy-on-write units in a cluster */
+static inline uint32_t
+bs_cow_units_per_cluster(struct spdk_blob *blob)
+{
+	assert(blob->cow_unit_size != 0);
+
+	return blob->bs->cluster_sz / blob->cow_unit_size;
+}
+
+/* Mask with a bit set for every copy-on-write unit of a cluster */
+static inline uint64_t
+bs_cow_units_all(struct spdk_blob *blob)
+{
+	uint32_t num_units = bs_cow_units_per_cluster(blob);
+
+	return num_units == 64 ? UINT64_MAX : (1ULL << num_units) - 1;
+}
+
+/* Units of the cluster that were not copied from the parent yet, 0 if the whole
+ * cluster is local (or unallocated). */
+static inline uint64_t
+bs_cluster_cow_units(struct spdk_blob *blob, uint64_t cluster_num)
+{
+	if (spdk_likely(blob->cow_units == NULL) || cluster_num >= blob->cow_units_array_size) {
+		return 0;
+	}
+
+	return blob->cow_units[cluster_num];
+}
+
 /* End basic conversions */
 
 static inline uint64_t
@@ -623,16 +774,36 @@ bs_blob_io_unit_to_lba(struct spdk_blob *blob, uint64_t io_unit)
 }
 
 /* Given an io_unit offset into a blob, look up the number of io_units until the
- * next cluster boundary.
+ * next cluster boundary. In a partially copied cluster, this is the number of
+ * io_units until the next copy-on-write unit that is on the other side (local
+ * or parent), so that an I/O never spans both.
  */
 static inline uint32_t
 bs_num_io_units_to_cluster_boundary(struct spdk_blob *blob, uint64_t io_unit)
 {
 	uint64_t	io_units_per_cluster;
+	uint64_t	io_units_per_unit;
+	uint64_t	units, other;
+	uint32_t	unit;
 
 	io_units_per_cluster = bs_io_units_per_cluster(blob);
 
-	return io_units_per_cluster - (io_unit % io_units_per_cluster);
+	units = bs_cluster_cow_units(blob, io_unit / io_units_per_cluster);
+	if (spdk_likely(units == 0)) {
+		return io_units_per_cluster - (io_unit % io_units_per_cluster);
+	}
+
+	io_units_per_unit = bs_io_units_per_cow_unit(blob);
+	unit = (io_unit % io_units_per_cluster) / io_units_per_unit;
+
+	/* Units after this one, that are in a different state */
+	other = ((units >> unit) & 1) ? ~units & bs_cow_units_all(blob) : units;
+	other &= ~((2ULL << unit) - 1);
+	if (other == 0) {
+		return io_units_per_cluster - (io_unit % io_units_per_cluster);
+	}
+
+	return __builtin_ctzll(other) * io_units_per_unit - (io_unit % io_units_per_cluster);
 }
 
 /* Given an io_unit offset into a blob, look up the number of pages into blob to beginning of current cluster */
@@ -688,9 +859,79 @@ bs_io_unit_is_allocated(struct spdk_blob *blob, uint64_t io_unit)
 	if (lba == 0) {
 		assert(spdk_blob_is_thin_provisioned(blob));
 		return false;
-	} else {
-		return true;
 	}
+
+	if (spdk_unlikely(blob->cow_units != NULL)) {
+		uint64_t units = bs_cluster_cow_units(blob, bs_io_unit_to_cluster_number(blob, io_unit));
+
+		if (units != 0 && ((units >> ((io_unit % bs_io_units_per_cluster(blob)) /
+					      bs_io_units_per_cow_unit(blob))) & 1)) {
+			/* This part of the cluster was not copied from the parent yet */
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Whether the cluster at the lba is shared with other blobs. Sharing starts only while the
+ * blobs are frozen, so a stale count read without used_lock can only cause an unneeded copy
+ * of a cluster that is no longer shared.
+ */
+static inline bool
+bs_cluster_is_shared(struct spdk_blob_store *bs, uint64_t lba)
+{
+	struct spdk_bs_cluster_refs *cluster_refs = bs->cluster_refs;
+	uint64_t cluster;
+
+	if (spdk_likely(cluster_refs == NULL) || lba == 0) {
+		return false;
+	}
+
+	cluster = bs_lba_to_cluster(bs, lba);
+	return cluster < cluster_refs->num_clusters && cluster_refs->refs[cluster] != 0;
+}
+
+/* Given an io_unit offset into a blob, look up the number of io_units until the
+ * end of the physically contiguous run of allocated clusters it is in, scanning
+ * no further than max_io_units. If the io_unit is not allocated, or is in a
+ * partially copied cluster, this is the number of io_units to the cluster boundary.
+ */
+static inline uint64_t
+bs_num_io_units_to_extent_boundary(struct spdk_blob *blob, uint64_t io_unit,
+				   uint64_t max_io_units)
+{
+	uint64_t	io_units_per_cluster;
+	uint64_t	lbas_per_cluster;
+	uint64_t	cluster;
+	uint64_t	count;
+
+	count = bs_num_io_units_to_cluster_boundary(blob, io_unit);
+	if (count >= max_io_units || !bs_io_unit_is_allocated(blob, io_unit)) {
+		return count;
+	}
+
+	cluster = bs_io_unit_to_cluster_number(blob, io_unit);
+	if (spdk_unlikely(bs_cluster_cow_units(blob, cluster) != 0 ||
+			  bs_cluster_is_shared(blob->bs, blob->active.clusters[cluster]))) {
+		return count;
+	}
+
+	io_units_per_cluster = bs_io_units_per_cluster(blob);
+	lbas_per_cluster = bs_cluster_to_lba(blob->bs, 1);
+	while (count < max_io_units && cluster + 1 < blob->active.num_clusters) {
+		if (blob->active.clusters[cluster + 1] != blob->active.clusters[cluster] + lbas_per_cluster ||
+		    blob->active.clusters[cluster + 1] == 0 ||
+		    bs_cluster_cow_units(blob, cluster + 1) != 0 ||
+		    bs_cluster_is_shared(blob->bs, blob->active.clusters[cluster + 1])) {
+			break;
+		}
+		cluster++;
+		count += io_units_per_cluster;
+	}
+
+	return count;
 }
 
 #endif
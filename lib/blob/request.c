@@ -63,6 +63,7 @@ bs_request_set_complete(struct spdk_bs_request_set *set)
 	spdk_trace_record(TRACE_BLOB_REQ_SET_COMPLETE, 0, 0, (uintptr_t)&set->cb_args,
 			  (uintptr_t)set->cpl.u.blob_basic.cb_arg);
 
+	set->io_blob = NULL;
 	TAILQ_INSERT_TAIL(&set->channel->reqs, set, link);
 
 	bs_call_cpl(&cpl, bserrno);
@@ -99,6 +100,7 @@ bs_sequence_start(struct spdk_io_channel *_channel, struct spdk_bs_cpl *cpl,
 	set->bserrno = 0;
 	set->channel = channel;
 	set->back_channel = back_channel;
+	set->io_blob = NULL;
 
 	set->cb_args.cb_fn = bs_sequence_completion;
 	set->cb_args.cb_arg = set;
@@ -121,6 +123,7 @@ bs_sequence_start_blob(struct spdk_io_channel *_channel, struct spdk_bs_cpl *cpl
 		       struct spdk_blob *blob)
 {
 	struct spdk_io_channel	*esnap_ch = _channel;
+	spdk_bs_sequence_t	*seq;
 
 	if (spdk_blob_is_esnap_clone(blob)) {
 		esnap_ch = blob_esnap_get_io_channel(_channel, blob);
@@ -137,7 +140,13 @@ bs_sequence_start_blob(struct spdk_io_channel *_channel, struct spdk_bs_cpl *cpl
 			return NULL;
 		}
 	}
-	return bs_sequence_start(_channel, cpl, esnap_ch);
+
+	seq = bs_sequence_start(_channel, cpl, esnap_ch);
+	if (seq != NULL) {
+		seq->io_blob = blob;
+	}
+
+	return seq;
 }
 
 void
@@ -361,6 +370,7 @@ bs_batch_open(struct spdk_io_channel *_channel, struct spdk_bs_cpl *cpl, struct
 	set->bserrno = 0;
 	set->channel = channel;
 	set->back_channel = back_channel;
+	set->io_blob = blob;
 
 	set->u.batch.cb_fn = NULL;
 	set->u.batch.cb_arg = NULL;
@@ -500,6 +510,7 @@ bs_user_op_alloc(struct spdk_io_channel *_channel, struct spdk_bs_cpl *cpl,
 	set->cpl = *cpl;
 	set->channel = channel;
 	set->back_channel = NULL;
+	set->io_blob = NULL;
 	set->ext_io_opts = NULL;
 
 	args = &set->u.user_op;
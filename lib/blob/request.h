@@ -96,6 +96,12 @@ struct spdk_bs_request_set {
 	 */
 	struct spdk_io_channel		*back_channel;
 
+	/*
+	 * The blob whose data is being read or written by this request set, NULL for
+	 * metadata I/O and user ops. Used to wait for the I/O in flight on a frozen blob.
+	 */
+	struct spdk_blob		*io_blob;
+
 	struct spdk_bs_dev_cb_args	cb_args;
 
 	union {
@@ -15,6 +15,7 @@
 #include "spdk/util.h"
 #include "spdk/log.h"
 #include "spdk/trace.h"
+#include "spdk/histogram_data.h"
 
 #include "spdk_internal/trace_defs.h"
 
@@ -86,6 +87,16 @@ cache_buffer_free(struct cache_buffer *cache_buffer)
 }
 
 #define CACHE_READAHEAD_THRESHOLD	(128 * 1024)
+/* Number of cache buffers read ahead once a sequential stream is detected. The
+ *  depth doubles each time the stream catches up with the readahead, up to
+ *  CACHE_READAHEAD_MAX_SIZE bytes in flight, but at least a single buffer.
+ */
+#define CACHE_READAHEAD_MIN_DEPTH	2
+#define CACHE_READAHEAD_MAX_SIZE	(8 * 1024 * 1024)
+#define CACHE_READAHEAD_MAX_DEPTH	spdk_max(CACHE_READAHEAD_MAX_SIZE >> CACHE_BUFFER_SHIFT, 1)
+#define CACHE_READAHEAD_START_DEPTH	spdk_min(CACHE_READAHEAD_MIN_DEPTH, CACHE_READAHEAD_MAX_DEPTH)
+/* Fraction of the cache pool released by a single pass of the reclaim poller */
+#define CACHE_RECLAIM_BATCH_DIVISOR	10
 
 struct spdk_file {
 	struct spdk_filesystem	*fs;
@@ -99,6 +110,7 @@ struct spdk_file {
 	uint64_t		append_pos;
 	uint64_t		seq_byte_count;
 	uint64_t		next_seq_offset;
+	uint32_t		readahead_depth;
 	uint32_t		priority;
 	TAILQ_ENTRY(spdk_file)	tailq;
 	spdk_blob_id		blobid;
@@ -106,6 +118,8 @@ struct spdk_file {
 	pthread_spinlock_t	lock;
 	struct cache_buffer	*last;
 	struct cache_tree	*tree;
+	/* Cache buffers of this file, least recently used first */
+	TAILQ_HEAD(cache_lru_head, cache_buffer) cache_lru;
 	TAILQ_HEAD(open_requests_head, spdk_fs_request) open_requests;
 	TAILQ_HEAD(sync_requests_head, spdk_fs_request) sync_requests;
 	TAILQ_ENTRY(spdk_file)	cache_tailq;
@@ -138,6 +152,16 @@ struct spdk_filesystem {
 	struct {
 		uint32_t		max_ops;
 	} io_target;
+
+	struct {
+		pthread_spinlock_t		lock;
+		/* Latency of the sync requests, in ticks */
+		struct spdk_histogram_data	*latency;
+		uint64_t			max_latency;
+		uint64_t			num_syncs;
+		uint64_t			num_md_syncs;
+		uint64_t			max_batch_size;
+	} sync_stats;
 };
 
 struct spdk_fs_cb_args {
@@ -192,6 +216,8 @@ struct spdk_fs_cb_args {
 			uint64_t			offset;
 			TAILQ_ENTRY(spdk_fs_request)	tailq;
 			bool				xattr_in_progress;
+			/* tick count when the sync request was made */
+			uint64_t			start_tsc;
 			/* length written to the xattr for this file - this should
 			 * always be the same as the offset if only one thread is
 			 * writing to the file, but could differ if multiple threads
@@ -273,6 +299,13 @@ static void
 allocate_cache_pool(void)
 {
 	assert(g_cache_pool == NULL);
+	if (g_fs_cache_size < CACHE_BUFFER_SIZE) {
+		SPDK_ERRLOG("Cache size %" PRIu64 " is smaller than a cache buffer (%u)\n",
+			    g_fs_cache_size, CACHE_BUFFER_SIZE);
+		assert(false);
+		return;
+	}
+
 	g_cache_pool = spdk_mempool_create("spdk_fs_cache",
 					   g_fs_cache_size / CACHE_BUFFER_SIZE,
 					   CACHE_BUFFER_SIZE,
@@ -522,6 +555,8 @@ init_cb(void *ctx, struct spdk_blob_store *bs, int bserrno)
 	if (bserrno == 0) {
 		common_fs_bs_init(fs, bs);
 	} else {
+		pthread_spin_destroy(&fs->sync_stats.lock);
+		spdk_histogram_data_free(fs->sync_stats.latency);
 		free(fs);
 		fs = NULL;
 	}
@@ -540,6 +575,18 @@ fs_alloc(struct spdk_bs_dev *dev, fs_send_request_fn send_request_fn)
 		return NULL;
 	}
 
+	fs->sync_stats.latency = spdk_histogram_data_alloc();
+	if (fs->sync_stats.latency == NULL) {
+		free(fs);
+		return NULL;
+	}
+
+	if (pthread_spin_init(&fs->sync_stats.lock, 0)) {
+		spdk_histogram_data_free(fs->sync_stats.latency);
+		free(fs);
+		return NULL;
+	}
+
 	fs->bdev = dev;
 	fs->send_request = send_request_fn;
 	TAILQ_INIT(&fs->files);
@@ -637,8 +684,10 @@ file_alloc(struct spdk_filesystem *fs)
 	file->fs = fs;
 	TAILQ_INIT(&file->open_requests);
 	TAILQ_INIT(&file->sync_requests);
+	TAILQ_INIT(&file->cache_lru);
 	TAILQ_INSERT_TAIL(&fs->files, file, tailq);
 	file->priority = SPDK_FILE_PRIORITY_LOW;
+	file->readahead_depth = CACHE_READAHEAD_START_DEPTH;
 	return file;
 }
 
@@ -806,6 +855,8 @@ fs_io_device_unregister(struct spdk_filesystem *fs)
 	spdk_io_device_unregister(&fs->md_target, NULL);
 	spdk_io_device_unregister(&fs->sync_target, NULL);
 	spdk_io_device_unregister(&fs->io_target, NULL);
+	pthread_spin_destroy(&fs->sync_stats.lock);
+	spdk_histogram_data_free(fs->sync_stats.latency);
 	free(fs);
 }
 
@@ -1985,6 +2036,12 @@ spdk_fs_set_cache_size(uint64_t size_in_mb)
 		return -EPERM;
 	}
 
+	/* The cache has to hold at least one buffer */
+	if (size_in_mb > UINT64_MAX / (1024 * 1024) ||
+	    size_in_mb * 1024 * 1024 < CACHE_BUFFER_SIZE) {
+		return -EINVAL;
+	}
+
 	g_fs_cache_size = size_in_mb * 1024 * 1024;
 
 	return 0;
@@ -1996,13 +2053,59 @@ spdk_fs_get_cache_size(void)
 	return g_fs_cache_size / (1024 * 1024);
 }
 
+int
+spdk_fs_set_cache_buffer_size(uint32_t size_in_kb)
+{
+	uint32_t shift;
+
+	/* The size of the cache buffers is baked into the cache pool, so it
+	 * can only be changed before the pool is allocated.
+	 */
+	if (g_cache_pool != NULL) {
+		return -EPERM;
+	}
+
+	if (!spdk_u32_is_pow2(size_in_kb)) {
+		return -EINVAL;
+	}
+
+	shift = spdk_u32log2(size_in_kb) + 10;
+	if (shift < CACHE_BUFFER_MIN_SHIFT || shift > CACHE_BUFFER_MAX_SHIFT) {
+		return -EINVAL;
+	}
+
+	if (g_fs_cache_size < (1ULL << shift)) {
+		return -EINVAL;
+	}
+
+	g_cache_buffer_shift = shift;
+
+	return 0;
+}
+
+uint32_t
+spdk_fs_get_cache_buffer_size(void)
+{
+	return CACHE_BUFFER_SIZE / 1024;
+}
+
 static void __file_flush(void *ctx);
 
-/* Try to free some cache buffers from this file.
+static void
+cache_remove_buffer(struct spdk_file *file, struct cache_buffer *buf)
+{
+	TAILQ_REMOVE(&file->cache_lru, buf, lru_tailq);
+	tree_remove_buffer(file->tree, buf);
+}
+
+/* Try to free up to max_count of the least recently used cache buffers
+ * from this file.
  */
 static int
-reclaim_cache_buffers(struct spdk_file *file)
+reclaim_cache_buffers(struct spdk_file *file, uint32_t max_count)
 {
+	struct cache_buffer *buf, *tmp;
+	uint32_t count = 0;
 	int rc;
 
 	BLOBFS_TRACE(file, "free=%s\n", file->name);
@@ -2020,7 +2123,18 @@ reclaim_cache_buffers(struct spdk_file *file)
 		pthread_spin_unlock(&file->lock);
 		return -1;
 	}
-	tree_free_buffers(file->tree);
+
+	TAILQ_FOREACH_SAFE(buf, &file->cache_lru, lru_tailq, tmp) {
+		if (count == max_count) {
+			break;
+		}
+		/* Skip buffers with readahead in flight or data not yet flushed */
+		if (buf->in_progress || buf->bytes_filled != buf->bytes_flushed) {
+			continue;
+		}
+		cache_remove_buffer(file, buf);
+		count++;
+	}
 
 	TAILQ_REMOVE(&g_caches, file, cache_tailq);
 	/* If not freed, put it in the end of the queue */
@@ -2028,7 +2142,7 @@ reclaim_cache_buffers(struct spdk_file *file)
 		TAILQ_INSERT_TAIL(&g_caches, file, cache_tailq);
 	}
 
-	/* tree_free_buffers() may have freed the buffer pointed to by file->last.
+	/* The loop above may have freed the buffer pointed to by file->last.
 	 * So check if current append_pos is still in the cache, and if not, clear
 	 * file->last.
 	 */
@@ -2038,23 +2152,26 @@ reclaim_cache_buffers(struct spdk_file *file)
 
 	pthread_spin_unlock(&file->lock);
 
-	return 0;
+	return count > 0 ? 0 : -1;
 }
 
 static int
 _blobfs_cache_pool_reclaim(void *arg)
 {
 	struct spdk_file *file, *tmp;
+	uint32_t batch;
 	int rc;
 
 	if (!blobfs_cache_pool_need_reclaim()) {
 		return SPDK_POLLER_IDLE;
 	}
 
+	batch = spdk_max(g_fs_cache_size / CACHE_BUFFER_SIZE / CACHE_RECLAIM_BATCH_DIVISOR, 1);
+
 	TAILQ_FOREACH_SAFE(file, &g_caches, cache_tailq, tmp) {
 		if (!file->open_for_writing &&
 		    file->priority == SPDK_FILE_PRIORITY_LOW) {
-			rc = reclaim_cache_buffers(file);
+			rc = reclaim_cache_buffers(file, batch);
 			if (rc < 0) {
 				continue;
 			}
@@ -2067,7 +2184,7 @@ _blobfs_cache_pool_reclaim(void *arg)
 
 	TAILQ_FOREACH_SAFE(file, &g_caches, cache_tailq, tmp) {
 		if (!file->open_for_writing) {
-			rc = reclaim_cache_buffers(file);
+			rc = reclaim_cache_buffers(file, batch);
 			if (rc < 0) {
 				continue;
 			}
@@ -2079,7 +2196,7 @@ _blobfs_cache_pool_reclaim(void *arg)
 	}
 
 	TAILQ_FOREACH_SAFE(file, &g_caches, cache_tailq, tmp) {
-		rc = reclaim_cache_buffers(file);
+		rc = reclaim_cache_buffers(file, batch);
 		if (rc < 0) {
 			continue;
 		}
@@ -2139,6 +2256,7 @@ cache_insert_buffer(struct spdk_file *file, uint64_t offset)
 		need_update = true;
 	}
 	file->tree = tree_insert_buffer(file->tree, buf);
+	TAILQ_INSERT_TAIL(&file->cache_lru, buf, lru_tailq);
 
 	if (need_update) {
 		spdk_thread_send_msg(g_cache_pool_thread, _add_file_to_cache_pool, file);
@@ -2168,12 +2286,34 @@ cache_append_buffer(struct spdk_file *file)
 
 static void __check_sync_reqs(struct spdk_file *file);
 
+static void
+fs_sync_stats_update(struct spdk_filesystem *fs, struct sync_requests_head *completed)
+{
+	struct spdk_fs_request *req;
+	uint64_t now, latency, batch_size = 0;
+
+	now = spdk_get_ticks();
+
+	pthread_spin_lock(&fs->sync_stats.lock);
+	TAILQ_FOREACH(req, completed, args.op.sync.tailq) {
+		latency = now - req->args.op.sync.start_tsc;
+		spdk_histogram_data_tally(fs->sync_stats.latency, latency);
+		fs->sync_stats.max_latency = spdk_max(fs->sync_stats.max_latency, latency);
+		batch_size++;
+	}
+	fs->sync_stats.num_syncs += batch_size;
+	fs->sync_stats.num_md_syncs++;
+	fs->sync_stats.max_batch_size = spdk_max(fs->sync_stats.max_batch_size, batch_size);
+	pthread_spin_unlock(&fs->sync_stats.lock);
+}
+
 static void
 __file_cache_finish_sync(void *ctx, int bserrno)
 {
 	struct spdk_file *file;
-	struct spdk_fs_request *sync_req = ctx;
+	struct spdk_fs_request *sync_req = ctx, *req, *tmp;
 	struct spdk_fs_cb_args *sync_args;
+	struct sync_requests_head completed = TAILQ_HEAD_INITIALIZER(completed);
 
 	sync_args = &sync_req->args;
 	file = sync_args->file;
@@ -2183,12 +2323,26 @@ __file_cache_finish_sync(void *ctx, int bserrno)
 	spdk_trace_record(TRACE_BLOBFS_XATTR_END, 0, sync_args->op.sync.offset,
 			  0, file->name);
 	BLOBFS_TRACE(file, "sync done offset=%jx\n", sync_args->op.sync.offset);
-	TAILQ_REMOVE(&file->sync_requests, sync_req, args.op.sync.tailq);
+	/* Group commit: the length just persisted also covers the sync requests
+	 * queued by other threads while the xattr was being written, so complete
+	 * all of them instead of persisting the metadata again for each one.
+	 */
+	TAILQ_FOREACH_SAFE(req, &file->sync_requests, args.op.sync.tailq, tmp) {
+		if (req == sync_req || (!req->args.op.sync.xattr_in_progress &&
+					req->args.op.sync.offset <= sync_args->op.sync.length)) {
+			TAILQ_REMOVE(&file->sync_requests, req, args.op.sync.tailq);
+			TAILQ_INSERT_TAIL(&completed, req, args.op.sync.tailq);
+		}
+	}
 	pthread_spin_unlock(&file->lock);
 
-	sync_args->fn.file_op(sync_args->arg, bserrno);
+	fs_sync_stats_update(file->fs, &completed);
+
+	TAILQ_FOREACH_SAFE(req, &completed, args.op.sync.tailq, tmp) {
+		req->args.fn.file_op(req->args.arg, bserrno);
+		free_fs_request(req);
+	}
 
-	free_fs_request(sync_req);
 	__check_sync_reqs(file);
 }
 
@@ -2575,7 +2729,7 @@ __next_cache_buffer_offset(uint64_t offset)
 	return (offset + CACHE_BUFFER_SIZE) & ~(CACHE_TREE_LEVEL_MASK(0));
 }
 
-static void
+static int
 check_readahead(struct spdk_file *file, uint64_t offset,
 		struct spdk_fs_channel *channel)
 {
@@ -2584,12 +2738,12 @@ check_readahead(struct spdk_file *file, uint64_t offset,
 
 	offset = __next_cache_buffer_offset(offset);
 	if (tree_find_buffer(file->tree, offset) != NULL || file->length <= offset) {
-		return;
+		return 0;
 	}
 
 	req = alloc_fs_request(channel);
 	if (req == NULL) {
-		return;
+		return -ENOMEM;
 	}
 	args = &req->args;
 
@@ -2601,7 +2755,7 @@ check_readahead(struct spdk_file *file, uint64_t offset,
 	if (!args->op.readahead.cache_buffer) {
 		BLOBFS_TRACE(file, "Cannot allocate buf for offset=%jx\n", offset);
 		free_fs_request(req);
-		return;
+		return -ENOMEM;
 	}
 
 	args->op.readahead.cache_buffer->in_progress = true;
@@ -2611,6 +2765,29 @@ check_readahead(struct spdk_file *file, uint64_t offset,
 		args->op.readahead.length = CACHE_BUFFER_SIZE;
 	}
 	file->fs->send_request(__readahead, req);
+	return 0;
+}
+
+static void
+file_readahead(struct spdk_file *file, uint64_t offset, struct spdk_fs_channel *channel)
+{
+	uint32_t max_depth, i;
+
+	/* The stream caught up with the data read ahead so far, read further ahead */
+	max_depth = CACHE_READAHEAD_MAX_DEPTH;
+	if (tree_find_filled_buffer(file->tree, offset) == NULL && file->readahead_depth < max_depth) {
+		file->readahead_depth = spdk_min(file->readahead_depth * 2, max_depth);
+	}
+
+	for (i = 0; i < file->readahead_depth; i++) {
+		/* Don't let a deep readahead push other files out of a cache under pressure */
+		if (i >= CACHE_READAHEAD_START_DEPTH && blobfs_cache_pool_need_reclaim()) {
+			break;
+		}
+		if (check_readahead(file, offset + (uint64_t)i * CACHE_BUFFER_SIZE, channel) != 0) {
+			break;
+		}
+	}
 }
 
 int64_t
@@ -2641,12 +2818,12 @@ spdk_file_read(struct spdk_file *file, struct spdk_fs_thread_ctx *ctx,
 
 	if (offset != file->next_seq_offset) {
 		file->seq_byte_count = 0;
+		file->readahead_depth = CACHE_READAHEAD_START_DEPTH;
 	}
 	file->seq_byte_count += length;
 	file->next_seq_offset = offset + length;
 	if (file->seq_byte_count >= CACHE_READAHEAD_THRESHOLD) {
-		check_readahead(file, offset, channel);
-		check_readahead(file, offset + CACHE_BUFFER_SIZE, channel);
+		file_readahead(file, offset, channel);
 	}
 
 	arg.channel = channel;
@@ -2676,10 +2853,13 @@ spdk_file_read(struct spdk_file *file, struct spdk_fs_thread_ctx *ctx,
 			BLOBFS_TRACE(file, "read %p offset=%ju length=%ju\n", payload, offset, read_len);
 			memcpy(payload, &buf->buf[offset - buf->offset], read_len);
 			if ((offset + read_len) % CACHE_BUFFER_SIZE == 0) {
-				tree_remove_buffer(file->tree, buf);
+				cache_remove_buffer(file, buf);
 				if (file->tree->present_mask == 0) {
 					spdk_thread_send_msg(g_cache_pool_thread, _remove_file_from_cache_pool, file);
 				}
+			} else {
+				TAILQ_REMOVE(&file->cache_lru, buf, lru_tailq);
+				TAILQ_INSERT_TAIL(&file->cache_lru, buf, lru_tailq);
 			}
 		}
 
@@ -2747,6 +2927,7 @@ _file_sync(struct spdk_file *file, struct spdk_fs_channel *channel,
 	sync_args->arg = cb_arg;
 	sync_args->op.sync.offset = file->append_pos;
 	sync_args->op.sync.xattr_in_progress = false;
+	sync_args->op.sync.start_tsc = spdk_get_ticks();
 	TAILQ_INSERT_TAIL(&file->sync_requests, sync_req, args.op.sync.tailq);
 	pthread_spin_unlock(&file->lock);
 
@@ -2776,6 +2957,59 @@ spdk_file_sync_async(struct spdk_file *file, struct spdk_io_channel *_channel,
 	_file_sync(file, channel, cb_fn, cb_arg);
 }
 
+struct fs_sync_latency_ctx {
+	uint64_t	p50;
+	uint64_t	p99;
+	uint64_t	p999;
+};
+
+static void
+fs_sync_latency_percentiles(void *cb_arg, uint64_t start, uint64_t end, uint64_t count,
+			    uint64_t total, uint64_t so_far)
+{
+	struct fs_sync_latency_ctx *ctx = cb_arg;
+
+	if (count == 0) {
+		return;
+	}
+
+	if (ctx->p50 == 0 && so_far * 2 >= total) {
+		ctx->p50 = end;
+	}
+	if (ctx->p99 == 0 && so_far * 100 >= total * 99) {
+		ctx->p99 = end;
+	}
+	if (ctx->p999 == 0 && so_far * 1000 >= total * 999) {
+		ctx->p999 = end;
+	}
+}
+
+void
+spdk_fs_get_sync_stats(struct spdk_filesystem *fs, struct spdk_fs_sync_stats *stats)
+{
+	struct fs_sync_latency_ctx ctx = {};
+	uint64_t ticks_hz = spdk_get_ticks_hz();
+
+	memset(stats, 0, sizeof(*stats));
+
+	pthread_spin_lock(&fs->sync_stats.lock);
+	stats->num_syncs = fs->sync_stats.num_syncs;
+	stats->num_md_syncs = fs->sync_stats.num_md_syncs;
+	stats->max_batch_size = fs->sync_stats.max_batch_size;
+	stats->max_latency_us = fs->sync_stats.max_latency * SPDK_SEC_TO_USEC / ticks_hz;
+	if (fs->sync_stats.num_syncs != 0) {
+		spdk_histogram_data_iterate(fs->sync_stats.latency, fs_sync_latency_percentiles, &ctx);
+	}
+	pthread_spin_unlock(&fs->sync_stats.lock);
+
+	/* The percentiles are the upper bounds of the histogram buckets, so keep
+	 * them within the largest latency actually observed.
+	 */
+	stats->latency_p50_us = spdk_min(ctx.p50 * SPDK_SEC_TO_USEC / ticks_hz, stats->max_latency_us);
+	stats->latency_p99_us = spdk_min(ctx.p99 * SPDK_SEC_TO_USEC / ticks_hz, stats->max_latency_us);
+	stats->latency_p999_us = spdk_min(ctx.p999 * SPDK_SEC_TO_USEC / ticks_hz, stats->max_latency_us);
+}
+
 void
 spdk_file_set_priority(struct spdk_file *file, uint32_t priority)
 {
@@ -2939,6 +3173,7 @@ file_free(struct spdk_file *file)
 
 	tree_free_buffers(file->tree);
 	assert(file->tree->present_mask == 0);
+	TAILQ_INIT(&file->cache_lru);
 	spdk_thread_send_msg(g_cache_pool_thread, _file_free, file);
 	pthread_spin_unlock(&file->lock);
 }
@@ -6,6 +6,8 @@
 #ifndef SPDK_TREE_H_
 #define SPDK_TREE_H_
 
+#include "spdk/queue.h"
+
 struct cache_buffer {
 	uint8_t			*buf;
 	uint64_t		offset;
@@ -13,9 +15,16 @@ struct cache_buffer {
 	uint32_t		bytes_filled;
 	uint32_t		bytes_flushed;
 	bool			in_progress;
+	TAILQ_ENTRY(cache_buffer)	lru_tailq;
 };
 
-#define CACHE_BUFFER_SHIFT (18)
+/* The cache buffer size can only change while the cache pool is not allocated */
+extern uint32_t g_cache_buffer_shift;
+
+#define CACHE_BUFFER_DEFAULT_SHIFT (18)
+#define CACHE_BUFFER_MIN_SHIFT (16)
+#define CACHE_BUFFER_MAX_SHIFT (24)
+#define CACHE_BUFFER_SHIFT g_cache_buffer_shift
 #define CACHE_BUFFER_SIZE (1U << CACHE_BUFFER_SHIFT)
 #define NEXT_CACHE_BUFFER_OFFSET(offset)	\
 	(((offset + CACHE_BUFFER_SIZE) >> CACHE_BUFFER_SHIFT) << CACHE_BUFFER_SHIFT)
@@ -13,6 +13,8 @@
 #include "spdk/env.h"
 #include "spdk/log.h"
 
+uint32_t g_cache_buffer_shift = CACHE_BUFFER_DEFAULT_SHIFT;
+
 struct cache_buffer *
 tree_find_buffer(struct cache_tree *tree, uint64_t offset)
 {
@@ -41,6 +41,10 @@ static void lvs_degraded_lvol_set_add(struct spdk_lvs_degraded_lvol_set *degrade
 				      struct spdk_lvol *lvol);
 static void lvs_degraded_lvol_set_remove(struct spdk_lvs_degraded_lvol_set *degraded_set,
 		struct spdk_lvol *lvol);
+static int lvs_defrag_detach(struct spdk_lvol_store *lvs);
+static int lvs_defrag_release_lvol(struct spdk_lvol *lvol);
+static int lvs_dedup_detach(struct spdk_lvol_store *lvs);
+static int lvs_dedup_release_lvol(struct spdk_lvol *lvol);
 
 static int
 add_lvs_to_list(struct spdk_lvol_store *lvs)
@@ -953,6 +957,18 @@ spdk_lvs_unload(struct spdk_lvol_store *lvs, spdk_lvs_op_complete cb_fn,
 		}
 	}
 
+	if (lvs_defrag_detach(lvs) != 0) {
+		SPDK_ERRLOG("Cannot unload lvol store - cluster of a lvol being moved\n");
+		cb_fn(cb_arg, -EBUSY);
+		return -EBUSY;
+	}
+
+	if (lvs_dedup_detach(lvs) != 0) {
+		SPDK_ERRLOG("Cannot unload lvol store - cluster of a lvol being deduplicated\n");
+		cb_fn(cb_arg, -EBUSY);
+		return -EBUSY;
+	}
+
 	TAILQ_FOREACH_SAFE(lvol, &lvs->lvols, link, tmp) {
 		spdk_lvs_esnap_missing_remove(lvol);
 		TAILQ_REMOVE(&lvs->lvols, lvol, link);
@@ -1023,6 +1039,18 @@ spdk_lvs_destroy(struct spdk_lvol_store *lvs, spdk_lvs_op_complete cb_fn,
 		}
 	}
 
+	if (lvs_defrag_detach(lvs) != 0) {
+		SPDK_ERRLOG("Cannot destroy lvol store - cluster of a lvol being moved\n");
+		cb_fn(cb_arg, -EBUSY);
+		return -EBUSY;
+	}
+
+	if (lvs_dedup_detach(lvs) != 0) {
+		SPDK_ERRLOG("Cannot destroy lvol store - cluster of a lvol being deduplicated\n");
+		cb_fn(cb_arg, -EBUSY);
+		return -EBUSY;
+	}
+
 	TAILQ_FOREACH_SAFE(iter_lvol, &lvs->lvols, link, tmp) {
 		lvol_free(iter_lvol);
 	}
@@ -1872,6 +1900,19 @@ spdk_lvol_destroy(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, void *cb_
 		return;
 	}
 
+	if (lvs_defrag_release_lvol(lvol) != 0) {
+		SPDK_ERRLOG("Cannot destroy lvol %s because its cluster is being moved\n", lvol->unique_id);
+		cb_fn(cb_arg, -EBUSY);
+		return;
+	}
+
+	if (lvs_dedup_release_lvol(lvol) != 0) {
+		SPDK_ERRLOG("Cannot destroy lvol %s because its cluster is being deduplicated\n",
+			    lvol->unique_id);
+		cb_fn(cb_arg, -EBUSY);
+		return;
+	}
+
 	req = calloc(1, sizeof(*req));
 	if (!req) {
 		SPDK_ERRLOG("Cannot alloc memory for lvol request pointer\n");
@@ -2586,7 +2627,7 @@ spdk_lvol_is_degraded(const struct spdk_lvol *lvol)
 }
 
 static void
-lvol_shallow_copy_cb(void *cb_arg, int lvolerrno)
+lvol_copy_cb(void *cb_arg, int lvolerrno)
 {
 	struct spdk_lvol_copy_req *req = cb_arg;
 	struct spdk_lvol *lvol = req->lvol;
@@ -2594,13 +2635,37 @@ lvol_shallow_copy_cb(void *cb_arg, int lvolerrno)
 	spdk_bs_free_io_channel(req->channel);
 
 	if (lvolerrno < 0) {
-		SPDK_ERRLOG("Could not make a shallow copy of lvol %s, error %d\n", lvol->unique_id, lvolerrno);
+		SPDK_ERRLOG("Could not make a copy of lvol %s, error %d\n", lvol->unique_id, lvolerrno);
 	}
 
 	req->cb_fn(req->cb_arg, lvolerrno);
 	free(req);
 }
 
+static struct spdk_lvol_copy_req *
+lvol_copy_req_alloc(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, void *cb_arg)
+{
+	struct spdk_lvol_copy_req *req;
+
+	req = calloc(1, sizeof(*req));
+	if (!req) {
+		SPDK_ERRLOG("lvol %s copy, cannot alloc memory for lvol request\n", lvol->unique_id);
+		return NULL;
+	}
+
+	req->lvol = lvol;
+	req->cb_fn = cb_fn;
+	req->cb_arg = cb_arg;
+	req->channel = spdk_bs_alloc_io_channel(lvol->lvol_store->blobstore);
+	if (req->channel == NULL) {
+		SPDK_ERRLOG("lvol %s copy, cannot alloc io channel for lvol request\n", lvol->unique_id);
+		free(req);
+		return NULL;
+	}
+
+	return req;
+}
+
 int
 spdk_lvol_shallow_copy(struct spdk_lvol *lvol, struct spdk_bs_dev *ext_dev,
 		       spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
@@ -2624,26 +2689,15 @@ spdk_lvol_shallow_copy(struct spdk_lvol *lvol, struct spdk_bs_dev *ext_dev,
 		return -EINVAL;
 	}
 
-	req = calloc(1, sizeof(*req));
-	if (!req) {
-		SPDK_ERRLOG("lvol %s shallow copy, cannot alloc memory for lvol request\n", lvol->unique_id);
-		return -ENOMEM;
-	}
-
-	req->lvol = lvol;
-	req->cb_fn = cb_fn;
-	req->cb_arg = cb_arg;
-	req->channel = spdk_bs_alloc_io_channel(lvol->lvol_store->blobstore);
-	if (req->channel == NULL) {
-		SPDK_ERRLOG("lvol %s shallow copy, cannot alloc io channel for lvol request\n", lvol->unique_id);
-		free(req);
+	req = lvol_copy_req_alloc(lvol, cb_fn, cb_arg);
+	if (req == NULL) {
 		return -ENOMEM;
 	}
 
 	blob_id = spdk_blob_get_id(lvol->blob);
 
 	rc = spdk_bs_blob_shallow_copy(lvol->lvol_store->blobstore, req->channel, blob_id, ext_dev,
-				       status_cb_fn, status_cb_arg, lvol_shallow_copy_cb, req);
+				       status_cb_fn, status_cb_arg, lvol_copy_cb, req);
 
 	if (rc < 0) {
 		SPDK_ERRLOG("Could not make a shallow copy of lvol %s\n", lvol->unique_id);
@@ -2654,6 +2708,55 @@ spdk_lvol_shallow_copy(struct spdk_lvol *lvol, struct spdk_bs_dev *ext_dev,
 	return rc;
 }
 
+int
+spdk_lvol_diff_copy(struct spdk_lvol *lvol, struct spdk_lvol *base, struct spdk_bs_dev *ext_dev,
+		    uint32_t queue_depth, spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
+		    spdk_lvol_op_complete cb_fn, void *cb_arg)
+{
+	struct spdk_lvol_copy_req *req;
+	spdk_blob_id base_id = SPDK_BLOBID_INVALID;
+	int rc;
+
+	assert(cb_fn != NULL);
+
+	if (lvol == NULL) {
+		SPDK_ERRLOG("lvol must not be NULL\n");
+		return -EINVAL;
+	}
+
+	assert(lvol->lvol_store->thread == spdk_get_thread());
+
+	if (ext_dev == NULL) {
+		SPDK_ERRLOG("lvol %s diff copy, ext_dev must not be NULL\n", lvol->unique_id);
+		return -EINVAL;
+	}
+
+	if (base != NULL) {
+		if (base->lvol_store != lvol->lvol_store) {
+			SPDK_ERRLOG("lvol %s diff copy, base lvol %s is in another lvol store\n",
+				    lvol->unique_id, base->unique_id);
+			return -EINVAL;
+		}
+		base_id = base->blob_id;
+	}
+
+	req = lvol_copy_req_alloc(lvol, cb_fn, cb_arg);
+	if (req == NULL) {
+		return -ENOMEM;
+	}
+
+	rc = spdk_bs_blob_diff_copy(lvol->lvol_store->blobstore, req->channel, lvol->blob_id, base_id,
+				    ext_dev, queue_depth, status_cb_fn, status_cb_arg, lvol_copy_cb, req);
+
+	if (rc < 0) {
+		SPDK_ERRLOG("Could not make a diff copy of lvol %s\n", lvol->unique_id);
+		spdk_bs_free_io_channel(req->channel);
+		free(req);
+	}
+
+	return rc;
+}
+
 static void
 lvol_set_parent_cb(void *cb_arg, int lvolerrno)
 {
@@ -2863,3 +2966,636 @@ spdk_lvol_get_snapshot_checksum(struct spdk_lvol *snapshot, uint64_t *checksum)
 	*checksum = *(uint64_t *)attr;
 	return 0;
 }
+
+#define LVS_DEFRAG_POLL_PERIOD_US 1000
+
+struct spdk_lvs_defrag {
+	struct spdk_lvol_store	*lvs;
+	struct spdk_poller	*poller;
+	/* Bandwidth limit in bytes per second, 0 for no limit */
+	uint64_t		bw_limit;
+	int64_t			tokens;
+	uint64_t		last_tsc;
+	/* Lvol being defragmented and the next of its clusters to look at */
+	struct spdk_lvol	*lvol;
+	uint64_t		cluster_num;
+	/* Free range the lvol is compacted into, UINT64_MAX if there was none large enough */
+	uint64_t		target;
+	/* Location of the previous allocated cluster of the lvol */
+	uint64_t		prev;
+	uint64_t		dst;
+	bool			move_in_progress;
+	/* Stopped while a cluster was being moved, freed once it is done */
+	bool			stopping;
+};
+
+static void lvs_defrag_next(struct spdk_lvs_defrag *defrag);
+
+static void
+lvs_defrag_free(struct spdk_lvs_defrag *defrag)
+{
+	if (defrag->lvol != NULL) {
+		defrag->lvol->defrag_in_progress = false;
+	}
+	spdk_poller_unregister(&defrag->poller);
+	defrag->lvs->defrag = NULL;
+	free(defrag);
+}
+
+static int
+lvs_defrag_detach(struct spdk_lvol_store *lvs)
+{
+	if (lvs->defrag == NULL) {
+		return 0;
+	}
+
+	if (lvs->defrag->move_in_progress) {
+		return -EBUSY;
+	}
+
+	lvs_defrag_free(lvs->defrag);
+	return 0;
+}
+
+static void
+lvs_defrag_lvol_done(struct spdk_lvs_defrag *defrag)
+{
+	defrag->lvol->defrag_in_progress = false;
+	defrag->lvol = TAILQ_NEXT(defrag->lvol, link);
+	defrag->cluster_num = 0;
+}
+
+static int
+lvs_defrag_release_lvol(struct spdk_lvol *lvol)
+{
+	struct spdk_lvs_defrag *defrag = lvol->lvol_store->defrag;
+
+	if (defrag == NULL || defrag->lvol != lvol) {
+		return 0;
+	}
+
+	if (defrag->move_in_progress) {
+		return -EBUSY;
+	}
+
+	lvs_defrag_lvol_done(defrag);
+	return 0;
+}
+
+static void
+lvs_defrag_cluster_placed(struct spdk_lvs_defrag *defrag, uint64_t location)
+{
+	defrag->prev = location;
+	if (defrag->target != UINT64_MAX) {
+		defrag->target++;
+	}
+	defrag->cluster_num++;
+}
+
+static void
+lvs_defrag_move_cpl(void *cb_arg, int bserrno)
+{
+	struct spdk_lvs_defrag *defrag = cb_arg;
+	struct spdk_lvol *lvol = defrag->lvol;
+
+	defrag->move_in_progress = false;
+	if (bserrno == 0) {
+		lvol->defrag_clusters_moved++;
+	}
+
+	if (defrag->stopping) {
+		lvs_defrag_free(defrag);
+		return;
+	}
+
+	if (bserrno == 0) {
+		lvs_defrag_cluster_placed(defrag, defrag->dst);
+	} else if (bserrno == -EBUSY && defrag->target != UINT64_MAX) {
+		/* The free range is taken, only move clusters next to their predecessor from now on */
+		defrag->target = UINT64_MAX;
+	} else {
+		SPDK_INFOLOG(lvol, "Lvol %s: defragmentation skipped, error %d\n", lvol->unique_id, bserrno);
+		lvs_defrag_lvol_done(defrag);
+	}
+
+	if (defrag->bw_limit == 0) {
+		lvs_defrag_next(defrag);
+	}
+}
+
+/*
+ * Start moving the next cluster of the lvol that is out of place. Returns false once
+ * there is nothing left to move in the lvol.
+ */
+static bool
+lvs_defrag_lvol_next(struct spdk_lvs_defrag *defrag)
+{
+	struct spdk_lvol *lvol = defrag->lvol;
+	struct spdk_blob_store *bs = defrag->lvs->blobstore;
+	struct spdk_blob *blob = lvol->blob;
+	uint64_t num_clusters, location, dst;
+
+	if (blob == NULL) {
+		/* The lvol is closed */
+		return false;
+	}
+
+	if (!lvol->defrag_in_progress) {
+		if (spdk_blob_get_num_fragments(blob) <= 1) {
+			return false;
+		}
+
+		/*
+		 * Compact the lvol into a free range if there is one large enough. Otherwise
+		 * clusters are only moved right after their predecessor, where that is free.
+		 */
+		lvol->defrag_in_progress = true;
+		defrag->cluster_num = 0;
+		defrag->prev = UINT64_MAX;
+		defrag->target = spdk_bs_find_free_clusters(bs, 0,
+				 spdk_blob_get_num_allocated_clusters(blob));
+	}
+
+	num_clusters = spdk_blob_get_num_clusters(blob);
+	while (defrag->cluster_num < num_clusters) {
+		location = spdk_blob_get_cluster_location(blob, defrag->cluster_num);
+		if (location == UINT64_MAX) {
+			defrag->cluster_num++;
+			continue;
+		}
+
+		if (spdk_blob_is_cluster_shared(blob, defrag->cluster_num)) {
+			/* Other lvols reference the cluster too, it stays where it is */
+			lvs_defrag_cluster_placed(defrag, location);
+			continue;
+		}
+
+		if (defrag->target != UINT64_MAX) {
+			dst = defrag->target;
+		} else if (defrag->prev != UINT64_MAX && location != defrag->prev + 1 &&
+			   spdk_bs_find_free_clusters(bs, defrag->prev + 1, 1) == defrag->prev + 1) {
+			dst = defrag->prev + 1;
+		} else {
+			dst = location;
+		}
+
+		if (dst != location) {
+			defrag->dst = dst;
+			defrag->move_in_progress = true;
+			spdk_bs_blob_move_cluster(bs, lvol->blob_id, defrag->cluster_num, dst,
+						  lvs_defrag_move_cpl, defrag);
+			return true;
+		}
+
+		lvs_defrag_cluster_placed(defrag, location);
+	}
+
+	return false;
+}
+
+static void
+lvs_defrag_next(struct spdk_lvs_defrag *defrag)
+{
+	while (defrag->lvol != NULL) {
+		if (lvs_defrag_lvol_next(defrag)) {
+			return;
+		}
+		lvs_defrag_lvol_done(defrag);
+	}
+
+	SPDK_INFOLOG(lvol, "Lvol store %s defragmentation complete\n", defrag->lvs->name);
+	lvs_defrag_free(defrag);
+}
+
+/*
+ * Take the bandwidth for copying or reading a cluster in the background. The bucket
+ * may go negative, as for copy-on-write.
+ */
+static bool
+lvs_bg_admit(struct spdk_lvol_store *lvs, uint64_t bw_limit, int64_t *tokens, uint64_t *last_tsc)
+{
+	uint64_t cluster_sz = spdk_bs_get_cluster_size(lvs->blobstore);
+	uint64_t hz, now, elapsed;
+
+	if (bw_limit == 0) {
+		return true;
+	}
+
+	hz = spdk_get_ticks_hz();
+	now = spdk_get_ticks();
+	elapsed = spdk_min(now - *last_tsc, hz);
+	*last_tsc = now;
+
+	*tokens = spdk_min(*tokens + (int64_t)(elapsed * bw_limit / hz), (int64_t)cluster_sz);
+	if (*tokens <= 0) {
+		return false;
+	}
+
+	*tokens -= cluster_sz;
+	return true;
+}
+
+static int
+lvs_defrag_poll(void *arg)
+{
+	struct spdk_lvs_defrag *defrag = arg;
+
+	if (defrag->move_in_progress ||
+	    !lvs_bg_admit(defrag->lvs, defrag->bw_limit, &defrag->tokens, &defrag->last_tsc)) {
+		return SPDK_POLLER_IDLE;
+	}
+
+	lvs_defrag_next(defrag);
+
+	return SPDK_POLLER_BUSY;
+}
+
+int
+spdk_lvs_defrag_start(struct spdk_lvol_store *lvs, uint64_t max_bw_mbps)
+{
+	struct spdk_lvs_defrag *defrag;
+
+	assert(spdk_get_thread() == lvs->thread);
+
+	if (lvs->defrag != NULL) {
+		if (lvs->defrag->stopping) {
+			return -EBUSY;
+		}
+		lvs->defrag->bw_limit = max_bw_mbps * 1024 * 1024;
+		return 0;
+	}
+
+	defrag = calloc(1, sizeof(*defrag));
+	if (defrag == NULL) {
+		return -ENOMEM;
+	}
+
+	defrag->lvs = lvs;
+	defrag->bw_limit = max_bw_mbps * 1024 * 1024;
+	defrag->last_tsc = spdk_get_ticks();
+	defrag->lvol = TAILQ_FIRST(&lvs->lvols);
+	defrag->poller = SPDK_POLLER_REGISTER(lvs_defrag_poll, defrag, LVS_DEFRAG_POLL_PERIOD_US);
+	if (defrag->poller == NULL) {
+		free(defrag);
+		return -ENOMEM;
+	}
+
+	lvs->defrag = defrag;
+	SPDK_INFOLOG(lvol, "Lvol store %s defragmentation started\n", lvs->name);
+
+	return 0;
+}
+
+int
+spdk_lvs_defrag_stop(struct spdk_lvol_store *lvs)
+{
+	struct spdk_lvs_defrag *defrag = lvs->defrag;
+
+	if (defrag == NULL || defrag->stopping) {
+		return -ENOENT;
+	}
+
+	if (defrag->move_in_progress) {
+		defrag->stopping = true;
+		spdk_poller_unregister(&defrag->poller);
+		return 0;
+	}
+
+	lvs_defrag_free(defrag);
+	return 0;
+}
+
+#define LVS_DEDUP_POLL_PERIOD_US 1000
+
+struct lvs_dedup_entry {
+	uint64_t			fingerprint;
+	spdk_blob_id			blob_id;
+	uint64_t			cluster_num;
+	RB_ENTRY(lvs_dedup_entry)	node;
+};
+
+static int
+lvs_dedup_entry_cmp(struct lvs_dedup_entry *e1, struct lvs_dedup_entry *e2)
+{
+	if (e1->fingerprint == e2->fingerprint) {
+		return 0;
+	}
+	return (e1->fingerprint > e2->fingerprint) ? 1 : -1;
+}
+
+RB_HEAD(lvs_dedup_tree, lvs_dedup_entry);
+RB_GENERATE_STATIC(lvs_dedup_tree, lvs_dedup_entry, node, lvs_dedup_entry_cmp)
+
+struct spdk_lvs_dedup {
+	struct spdk_lvol_store	*lvs;
+	struct spdk_poller	*poller;
+	struct spdk_io_channel	*channel;
+	/* Bandwidth limit in bytes per second, 0 for no limit */
+	uint64_t		bw_limit;
+	int64_t			tokens;
+	uint64_t		last_tsc;
+	/* Lvol being scanned and the next of its clusters to look at */
+	struct spdk_lvol	*lvol;
+	uint64_t		cluster_num;
+	uint64_t		fingerprint;
+	/* Cluster found earlier with the same fingerprint as the current one */
+	struct lvs_dedup_entry	*match;
+	/* One cluster per fingerprint, for the clusters scanned so far */
+	struct lvs_dedup_tree	index;
+	bool			op_in_progress;
+	/* Stopped while a cluster was being read or shared, freed once it is done */
+	bool			stopping;
+};
+
+static void lvs_dedup_next(struct spdk_lvs_dedup *dedup);
+
+static void
+lvs_dedup_free(struct spdk_lvs_dedup *dedup)
+{
+	struct lvs_dedup_entry *entry, *tmp;
+
+	RB_FOREACH_SAFE(entry, lvs_dedup_tree, &dedup->index, tmp) {
+		RB_REMOVE(lvs_dedup_tree, &dedup->index, entry);
+		free(entry);
+	}
+
+	spdk_poller_unregister(&dedup->poller);
+	if (dedup->channel != NULL) {
+		spdk_bs_free_io_channel(dedup->channel);
+	}
+	dedup->lvs->dedup = NULL;
+	free(dedup);
+}
+
+static int
+lvs_dedup_detach(struct spdk_lvol_store *lvs)
+{
+	if (lvs->dedup == NULL) {
+		return 0;
+	}
+
+	if (lvs->dedup->op_in_progress) {
+		return -EBUSY;
+	}
+
+	lvs_dedup_free(lvs->dedup);
+	return 0;
+}
+
+static void
+lvs_dedup_lvol_done(struct spdk_lvs_dedup *dedup)
+{
+	dedup->lvol = TAILQ_NEXT(dedup->lvol, link);
+	dedup->cluster_num = 0;
+	dedup->match = NULL;
+}
+
+static int
+lvs_dedup_release_lvol(struct spdk_lvol *lvol)
+{
+	struct spdk_lvs_dedup *dedup = lvol->lvol_store->dedup;
+	struct lvs_dedup_entry *entry, *tmp;
+
+	if (dedup == NULL) {
+		return 0;
+	}
+
+	if (dedup->op_in_progress &&
+	    (dedup->lvol == lvol || (dedup->match != NULL && dedup->match->blob_id == lvol->blob_id))) {
+		return -EBUSY;
+	}
+
+	if (dedup->lvol == lvol) {
+		lvs_dedup_lvol_done(dedup);
+	}
+
+	/* The clusters of the lvol can't be shared anymore */
+	RB_FOREACH_SAFE(entry, lvs_dedup_tree, &dedup->index, tmp) {
+		if (entry->blob_id == lvol->blob_id) {
+			if (dedup->match == entry) {
+				dedup->match = NULL;
+			}
+			RB_REMOVE(lvs_dedup_tree, &dedup->index, entry);
+			free(entry);
+		}
+	}
+
+	return 0;
+}
+
+static void
+lvs_dedup_share_cpl(void *cb_arg, int bserrno)
+{
+	struct spdk_lvs_dedup *dedup = cb_arg;
+	struct spdk_lvol *lvol = dedup->lvol;
+
+	dedup->op_in_progress = false;
+	if (bserrno == 0) {
+		dedup->lvs->dedup_shared_clusters++;
+	}
+
+	if (dedup->stopping) {
+		lvs_dedup_free(dedup);
+		return;
+	}
+
+	if (bserrno != 0 && bserrno != -EBUSY && bserrno != -ENOMEM) {
+		/*
+		 * The data differs despite the same fingerprint, or the indexed cluster was
+		 * released or rewritten since. Keep the current cluster in the index instead.
+		 */
+		SPDK_DEBUGLOG(lvol, "Lvol %s: cluster %" PRIu64 " not shared, error %d\n",
+			      lvol->unique_id, dedup->cluster_num, bserrno);
+		dedup->match->blob_id = lvol->blob_id;
+		dedup->match->cluster_num = dedup->cluster_num;
+	}
+
+	dedup->match = NULL;
+	dedup->cluster_num++;
+
+	if (dedup->bw_limit == 0) {
+		lvs_dedup_next(dedup);
+	}
+}
+
+static void
+lvs_dedup_fingerprint_cpl(void *cb_arg, int bserrno)
+{
+	struct spdk_lvs_dedup *dedup = cb_arg;
+	struct spdk_lvol *lvol = dedup->lvol;
+	struct lvs_dedup_entry find = {}, *entry;
+
+	dedup->op_in_progress = false;
+	if (bserrno == 0) {
+		dedup->lvs->dedup_scanned_clusters++;
+	}
+
+	if (dedup->stopping) {
+		lvs_dedup_free(dedup);
+		return;
+	}
+
+	if (bserrno != 0) {
+		SPDK_DEBUGLOG(lvol, "Lvol %s: cluster %" PRIu64 " skipped, error %d\n",
+			      lvol->unique_id, dedup->cluster_num, bserrno);
+		dedup->cluster_num++;
+	} else {
+		find.fingerprint = dedup->fingerprint;
+		entry = RB_FIND(lvs_dedup_tree, &dedup->index, &find);
+		if (entry != NULL) {
+			/* Shared on the next poll, once the bandwidth for reading both clusters is there */
+			dedup->match = entry;
+		} else {
+			entry = calloc(1, sizeof(*entry));
+			if (entry != NULL) {
+				entry->fingerprint = dedup->fingerprint;
+				entry->blob_id = lvol->blob_id;
+				entry->cluster_num = dedup->cluster_num;
+				RB_INSERT(lvs_dedup_tree, &dedup->index, entry);
+			}
+			dedup->cluster_num++;
+		}
+	}
+
+	if (dedup->bw_limit == 0) {
+		lvs_dedup_next(dedup);
+	}
+}
+
+/*
+ * Start reading the next allocated cluster of the lvol, or sharing the cluster that was
+ * just read. Returns false once all clusters of the lvol have been looked at.
+ */
+static bool
+lvs_dedup_lvol_next(struct spdk_lvs_dedup *dedup)
+{
+	struct spdk_lvol *lvol = dedup->lvol;
+	struct spdk_blob_store *bs = dedup->lvs->blobstore;
+	struct spdk_blob *blob = lvol->blob;
+	uint64_t num_clusters;
+
+	if (blob == NULL) {
+		/* The lvol is closed */
+		return false;
+	}
+
+	if (!spdk_blob_is_thin_provisioned(blob) && !spdk_blob_is_read_only(blob)) {
+		/* Clusters of thick provisioned lvols are never shared */
+		return false;
+	}
+
+	if (dedup->match != NULL) {
+		dedup->op_in_progress = true;
+		spdk_bs_blob_share_cluster(bs, lvol->blob_id, dedup->cluster_num,
+					   dedup->match->blob_id, dedup->match->cluster_num,
+					   lvs_dedup_share_cpl, dedup);
+		return true;
+	}
+
+	num_clusters = spdk_blob_get_num_clusters(blob);
+	while (dedup->cluster_num < num_clusters) {
+		if (spdk_blob_get_cluster_location(blob, dedup->cluster_num) == UINT64_MAX) {
+			dedup->cluster_num++;
+			continue;
+		}
+
+		dedup->op_in_progress = true;
+		spdk_bs_blob_cluster_fingerprint(bs, dedup->channel, lvol->blob_id, dedup->cluster_num,
+						 &dedup->fingerprint, lvs_dedup_fingerprint_cpl, dedup);
+		return true;
+	}
+
+	return false;
+}
+
+static void
+lvs_dedup_next(struct spdk_lvs_dedup *dedup)
+{
+	while (dedup->lvol != NULL) {
+		if (lvs_dedup_lvol_next(dedup)) {
+			return;
+		}
+		lvs_dedup_lvol_done(dedup);
+	}
+
+	SPDK_INFOLOG(lvol, "Lvol store %s deduplication complete\n", dedup->lvs->name);
+	lvs_dedup_free(dedup);
+}
+
+static int
+lvs_dedup_poll(void *arg)
+{
+	struct spdk_lvs_dedup *dedup = arg;
+
+	if (dedup->op_in_progress ||
+	    !lvs_bg_admit(dedup->lvs, dedup->bw_limit, &dedup->tokens, &dedup->last_tsc)) {
+		return SPDK_POLLER_IDLE;
+	}
+
+	lvs_dedup_next(dedup);
+
+	return SPDK_POLLER_BUSY;
+}
+
+int
+spdk_lvs_dedup_start(struct spdk_lvol_store *lvs, uint64_t max_bw_mbps)
+{
+	struct spdk_lvs_dedup *dedup;
+
+	assert(spdk_get_thread() == lvs->thread);
+
+	if (lvs->dedup != NULL) {
+		if (lvs->dedup->stopping) {
+			return -EBUSY;
+		}
+		lvs->dedup->bw_limit = max_bw_mbps * 1024 * 1024;
+		return 0;
+	}
+
+	dedup = calloc(1, sizeof(*dedup));
+	if (dedup == NULL) {
+		return -ENOMEM;
+	}
+
+	dedup->lvs = lvs;
+	RB_INIT(&dedup->index);
+	dedup->bw_limit = max_bw_mbps * 1024 * 1024;
+	dedup->last_tsc = spdk_get_ticks();
+	dedup->lvol = TAILQ_FIRST(&lvs->lvols);
+	dedup->channel = spdk_bs_alloc_io_channel(lvs->blobstore);
+	if (dedup->channel == NULL) {
+		free(dedup);
+		return -ENOMEM;
+	}
+
+	dedup->poller = SPDK_POLLER_REGISTER(lvs_dedup_poll, dedup, LVS_DEDUP_POLL_PERIOD_US);
+	if (dedup->poller == NULL) {
+		spdk_bs_free_io_channel(dedup->channel);
+		free(dedup);
+		return -ENOMEM;
+	}
+
+	lvs->dedup = dedup;
+	SPDK_INFOLOG(lvol, "Lvol store %s deduplication started\n", lvs->name);
+
+	return 0;
+}
+
+int
+spdk_lvs_dedup_stop(struct spdk_lvol_store *lvs)
+{
+	struct spdk_lvs_dedup *dedup = lvs->dedup;
+
+	if (dedup == NULL || dedup->stopping) {
+		return -ENOENT;
+	}
+
+	if (dedup->op_in_progress) {
+		dedup->stopping = true;
+		spdk_poller_unregister(&dedup->poller);
+		return 0;
+	}
+
+	lvs_dedup_free(dedup);
+	return 0;
+}
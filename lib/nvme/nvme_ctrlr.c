@@ -358,6 +358,10 @@ spdk_nvme_ctrlr_get_default_io_qpair_opts(struct spdk_nvme_ctrlr *ctrlr,
 		opts->async_mode = false;
 	}
 
+	if (FIELD_OK(num_connections)) {
+		opts->num_connections = 1;
+	}
+
 #undef FIELD_OK
 }
 
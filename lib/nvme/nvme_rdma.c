@@ -135,6 +135,12 @@ struct nvme_rdma_poller {
 	uint32_t			refcnt;
 	int				required_num_wc;
 	int				current_num_wc;
+	/*
+	 * Number of receives the SRQ should keep posted, i.e. the sum of the queue depths
+	 * of the qpairs using it.  Receives beyond that are parked on free_recv_wrs.
+	 */
+	uint32_t			required_num_recvs;
+	struct ibv_recv_wr		*free_recv_wrs;
 	struct nvme_rdma_poller_stats	stats;
 	struct nvme_rdma_poll_group	*group;
 	STAILQ_ENTRY(nvme_rdma_poller)	link;
@@ -307,6 +313,8 @@ static struct nvme_rdma_poller *nvme_rdma_poll_group_get_poller(struct nvme_rdma
 		struct ibv_context *device);
 static void nvme_rdma_poll_group_put_poller(struct nvme_rdma_poll_group *group,
 		struct nvme_rdma_poller *poller);
+static inline int nvme_rdma_poller_submit_recvs(struct nvme_rdma_poller *poller);
+static void nvme_rdma_poller_refill_recvs(struct nvme_rdma_poller *poller);
 
 static int nvme_rdma_ctrlr_delete_io_qpair(struct spdk_nvme_ctrlr *ctrlr,
 		struct spdk_nvme_qpair *qpair);
@@ -660,6 +668,12 @@ nvme_rdma_qpair_set_poller(struct spdk_nvme_qpair *qpair)
 	rqpair->srq = poller->srq;
 	if (rqpair->srq) {
 		rqpair->rsps = poller->rsps;
+
+		poller->required_num_recvs += rqpair->num_entries;
+		nvme_rdma_poller_refill_recvs(poller);
+		if (nvme_rdma_poller_submit_recvs(poller)) {
+			SPDK_ERRLOG("Unable to post receives to the SRQ of poller %p\n", poller);
+		}
 	}
 	rqpair->poller = poller;
 	return 0;
@@ -673,6 +687,7 @@ nvme_rdma_qpair_init(struct nvme_rdma_qpair *rqpair)
 	struct ibv_device_attr	dev_attr;
 	struct nvme_rdma_ctrlr	*rctrlr;
 	uint32_t num_cqe, max_num_cqe;
+	uint32_t num_send_sge;
 
 	rc = ibv_query_device(rqpair->cm_id->verbs, &dev_attr);
 	if (rc != 0) {
@@ -717,7 +732,15 @@ nvme_rdma_qpair_init(struct nvme_rdma_qpair *rqpair)
 	} else {
 		attr.cap.max_recv_wr = rqpair->num_entries; /* RECV operations */
 	}
-	attr.cap.max_send_sge	= spdk_min(NVME_RDMA_DEFAULT_TX_SGE, dev_attr.max_sge);
+	/*
+	 * The second send SGE is only used to carry in-capsule data. Size the send queue
+	 * for the command capsule alone if the controller did not report any in-capsule
+	 * data support (ioccsz), which is also the case for the admin queue before the
+	 * controller has been identified.
+	 */
+	num_send_sge = (rctrlr->ctrlr.ioccsz_bytes > 0 && rctrlr->ctrlr.icdoff == 0) ?
+		       NVME_RDMA_DEFAULT_TX_SGE : 1;
+	attr.cap.max_send_sge	= spdk_min(num_send_sge, (uint32_t)dev_attr.max_sge);
 	attr.cap.max_recv_sge	= spdk_min(NVME_RDMA_DEFAULT_RX_SGE, dev_attr.max_sge);
 
 	rqpair->rdma_qp = spdk_rdma_provider_qp_create(rqpair->cm_id, &attr);
@@ -733,7 +756,7 @@ nvme_rdma_qpair_init(struct nvme_rdma_qpair *rqpair)
 	}
 
 	/* ibv_create_qp will change the values in attr.cap. Make sure we store the proper value. */
-	rqpair->max_send_sge = spdk_min(NVME_RDMA_DEFAULT_TX_SGE, attr.cap.max_send_sge);
+	rqpair->max_send_sge = spdk_min(num_send_sge, attr.cap.max_send_sge);
 	rqpair->max_recv_sge = spdk_min(NVME_RDMA_DEFAULT_RX_SGE, attr.cap.max_recv_sge);
 	rqpair->current_num_sends = 0;
 
@@ -811,6 +834,48 @@ nvme_rdma_poller_submit_recvs(struct nvme_rdma_poller *poller)
 	return rc;
 }
 
+/*
+ * Return a receive to the SRQ of the poller. If the SRQ already has enough receives
+ * posted for the qpairs that currently use it, park the receive instead so that the
+ * SRQ shrinks back after qpairs went away.
+ */
+static inline void
+nvme_rdma_poller_queue_recv(struct nvme_rdma_poller *poller, struct ibv_recv_wr *recv_wr)
+{
+	struct nvme_rdma_rsps *rsps = poller->rsps;
+
+	if (spdk_unlikely(rsps->current_num_recvs >= poller->required_num_recvs)) {
+		recv_wr->next = poller->free_recv_wrs;
+		poller->free_recv_wrs = recv_wr;
+		return;
+	}
+
+	assert(rsps->current_num_recvs < rsps->num_entries);
+	rsps->current_num_recvs++;
+	recv_wr->next = NULL;
+	spdk_rdma_provider_srq_queue_recv_wrs(poller->srq, recv_wr);
+}
+
+/*
+ * Post parked receives until the SRQ holds as many receives as required by the qpairs
+ * using it, or until all receives are posted.
+ */
+static void
+nvme_rdma_poller_refill_recvs(struct nvme_rdma_poller *poller)
+{
+	struct nvme_rdma_rsps *rsps = poller->rsps;
+	struct ibv_recv_wr *recv_wr;
+
+	while (rsps->current_num_recvs < poller->required_num_recvs && poller->free_recv_wrs != NULL) {
+		recv_wr = poller->free_recv_wrs;
+		poller->free_recv_wrs = recv_wr->next;
+
+		rsps->current_num_recvs++;
+		recv_wr->next = NULL;
+		spdk_rdma_provider_srq_queue_recv_wrs(poller->srq, recv_wr);
+	}
+}
+
 #define nvme_rdma_trace_ibv_sge(sg_list) \
 	if (sg_list) { \
 		SPDK_DEBUGLOG(nvme, "local addr %p length 0x%x lkey 0x%x\n", \
@@ -888,15 +953,14 @@ nvme_rdma_create_rsps(struct nvme_rdma_rsp_opts *opts)
 
 		nvme_rdma_trace_ibv_sge(recv_wr->sg_list);
 
+		/* Receives of a SRQ are posted on demand by nvme_rdma_poller_refill_recvs(). */
 		if (opts->rqpair) {
 			spdk_rdma_provider_qp_queue_recv_wrs(opts->rqpair->rdma_qp, recv_wr);
-		} else {
-			spdk_rdma_provider_srq_queue_recv_wrs(opts->srq, recv_wr);
 		}
 	}
 
 	rsps->num_entries = opts->num_entries;
-	rsps->current_num_recvs = opts->num_entries;
+	rsps->current_num_recvs = opts->rqpair ? opts->num_entries : 0;
 
 	return rsps;
 fail:
@@ -1723,7 +1787,8 @@ nvme_rdma_req_init(struct nvme_rdma_qpair *rqpair, struct nvme_request *req,
 	 * will currently just not use inline data for now.
 	 */
 	icd_supported = spdk_nvme_opc_get_data_transfer(req->cmd.opc) == SPDK_NVME_DATA_HOST_TO_CONTROLLER
-			&& req->payload_size <= ctrlr->ioccsz_bytes && ctrlr->icdoff == 0;
+			&& req->payload_size <= ctrlr->ioccsz_bytes && ctrlr->icdoff == 0
+			&& rqpair->max_send_sge > 1;
 
 	if (req->payload_size == 0) {
 		rc = nvme_rdma_build_null_request(rdma_req);
@@ -1837,6 +1902,10 @@ nvme_rdma_qpair_destroy(struct nvme_rdma_qpair *rqpair)
 		assert(qpair->poll_group);
 		group = nvme_rdma_poll_group(qpair->poll_group);
 
+		if (rqpair->srq) {
+			assert(rqpair->poller->required_num_recvs >= rqpair->num_entries);
+			rqpair->poller->required_num_recvs -= rqpair->num_entries;
+		}
 		nvme_rdma_poll_group_put_poller(group, rqpair->poller);
 
 		rqpair->poller = NULL;
@@ -2382,16 +2451,16 @@ nvme_rdma_request_ready(struct nvme_rdma_qpair *rqpair, struct spdk_nvme_rdma_re
 
 	nvme_rdma_req_complete(rdma_req, &rdma_rsp->cpl, true);
 
-	assert(rqpair->rsps->current_num_recvs < rqpair->rsps->num_entries);
-	rqpair->rsps->current_num_recvs++;
-
-	recv_wr->next = NULL;
 	nvme_rdma_trace_ibv_sge(recv_wr->sg_list);
 
 	if (!rqpair->srq) {
+		assert(rqpair->rsps->current_num_recvs < rqpair->rsps->num_entries);
+		rqpair->rsps->current_num_recvs++;
+
+		recv_wr->next = NULL;
 		spdk_rdma_provider_qp_queue_recv_wrs(rqpair->rdma_qp, recv_wr);
 	} else {
-		spdk_rdma_provider_srq_queue_recv_wrs(rqpair->srq, recv_wr);
+		nvme_rdma_poller_queue_recv(rqpair->poller, recv_wr);
 	}
 }
 
@@ -2470,7 +2539,9 @@ nvme_rdma_process_recv_completion(struct nvme_rdma_poller *poller, struct ibv_wc
 			 * However, for the SRQ, this is not any error. Hence, just re-post the
 			 * receive request to the SRQ to reuse for other QPs, and return 0.
 			 */
-			spdk_rdma_provider_srq_queue_recv_wrs(poller->srq, rdma_rsp->recv_wr);
+			assert(poller->rsps->current_num_recvs > 0);
+			poller->rsps->current_num_recvs--;
+			nvme_rdma_poller_queue_recv(poller, rdma_rsp->recv_wr);
 			return 0;
 		}
 	} else {
@@ -2524,7 +2595,7 @@ nvme_rdma_process_recv_completion(struct nvme_rdma_poller *poller, struct ibv_wc
 err_wc:
 	nvme_rdma_fail_qpair(&rqpair->qpair, 0);
 	if (poller && poller->srq) {
-		spdk_rdma_provider_srq_queue_recv_wrs(poller->srq, rdma_rsp->recv_wr);
+		nvme_rdma_poller_queue_recv(poller, rdma_rsp->recv_wr);
 	}
 	return -ENXIO;
 }
@@ -2558,7 +2629,7 @@ nvme_rdma_process_send_completion(struct nvme_rdma_poller *poller,
 		nvme_rdma_log_wc_status(rqpair, wc);
 		nvme_rdma_fail_qpair(&rqpair->qpair, 0);
 		if (rdma_req->rdma_rsp && poller && poller->srq) {
-			spdk_rdma_provider_srq_queue_recv_wrs(poller->srq, rdma_req->rdma_rsp->recv_wr);
+			nvme_rdma_poller_queue_recv(poller, rdma_req->rdma_rsp->recv_wr);
 		}
 		return -ENXIO;
 	}
@@ -2877,7 +2948,9 @@ nvme_rdma_poller_create(struct nvme_rdma_poll_group *group, struct ibv_context *
 	struct ibv_device_attr dev_attr;
 	struct spdk_rdma_provider_srq_init_attr srq_init_attr = {};
 	struct nvme_rdma_rsp_opts opts;
+	struct ibv_recv_wr *recv_wr;
 	int num_cqe, max_num_cqe;
+	uint16_t i;
 	int rc;
 
 	poller = calloc(1, sizeof(*poller));
@@ -2933,10 +3006,11 @@ nvme_rdma_poller_create(struct nvme_rdma_poll_group *group, struct ibv_context *
 			goto fail;
 		}
 
-		rc = nvme_rdma_poller_submit_recvs(poller);
-		if (rc) {
-			SPDK_ERRLOG("Unable to submit poller RDMA responses.\n");
-			goto fail;
+		/* Receives are posted as qpairs start using the SRQ. */
+		for (i = poller->rsps->num_entries; i > 0; i--) {
+			recv_wr = &poller->rsps->rsp_recv_wrs[i - 1];
+			recv_wr->next = poller->free_recv_wrs;
+			poller->free_recv_wrs = recv_wr;
 		}
 
 		/*
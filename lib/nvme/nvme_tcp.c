@@ -36,6 +36,26 @@
 #define NVME_TCP_MAX_R2T_DEFAULT		1
 #define NVME_TCP_PDU_H2C_MIN_DATA_SIZE		4096
 
+/*
+ * Number of receive data digest contexts allocated per queue entry.  These are used to chain the
+ * data digest of each C2H PDU into the request's accel sequence when a transfer spans multiple
+ * PDUs.  If they run out, the digest of the remaining PDUs is calculated in place.
+ */
+#define NVME_TCP_RECV_DDGST_PER_REQ		4
+
+/*
+ * Maximum number of connections a single I/O qpair can be striped across (including the
+ * connection of the qpair itself).
+ */
+#define NVME_TCP_MAX_CONNS_PER_QPAIR		8
+
+/*
+ * Number of generic requests allocated for each additional connection of a striped qpair.
+ * These are only used for the connection's own fabrics commands (CONNECT, authentication),
+ * as I/O is submitted through the qpair the connection belongs to.
+ */
+#define NVME_TCP_CONN_NUM_REQUESTS		4
+
 /*
  * Maximum value of transport_ack_timeout used by TCP controller
  */
@@ -114,6 +134,20 @@ struct nvme_tcp_qpair {
 	uint64_t				icreq_timeout_tsc;
 
 	bool					shared_stats;
+
+	struct nvme_tcp_recv_ddgst		*recv_ddgsts;
+	STAILQ_HEAD(, nvme_tcp_recv_ddgst)	free_recv_ddgsts;
+
+	/* Offset of the CIDs of this connection's requests within its striped qpair */
+	uint16_t				cid_base;
+
+	/* Additional connections of a striped qpair */
+	uint8_t					num_conns;
+	uint8_t					next_conn;
+	struct nvme_tcp_qpair			*conns[NVME_TCP_MAX_CONNS_PER_QPAIR - 1];
+
+	/* Set on additional connections, points to the qpair the connection belongs to */
+	struct nvme_tcp_qpair			*parent;
 };
 
 enum nvme_tcp_req_state {
@@ -169,6 +203,16 @@ struct nvme_tcp_req {
 };
 SPDK_STATIC_ASSERT(sizeof(struct nvme_tcp_req) % SPDK_CACHE_LINE_SIZE == 0, "unaligned size");
 
+/* Holds the data digest of a single C2H PDU until the request's accel sequence is executed */
+struct nvme_tcp_recv_ddgst {
+	struct nvme_tcp_req			*treq;
+	uint32_t				crc32c;
+	uint8_t					data_digest[SPDK_NVME_TCP_DIGEST_LEN];
+	struct iovec				iov[NVME_TCP_MAX_SGL_DESCRIPTORS];
+	uint32_t				iovcnt;
+	STAILQ_ENTRY(nvme_tcp_recv_ddgst)	link;
+};
+
 static struct spdk_nvme_tcp_stat g_dummy_stats = {};
 
 static void nvme_tcp_send_h2c_data(struct nvme_tcp_req *tcp_req);
@@ -198,6 +242,13 @@ nvme_tcp_ctrlr(struct spdk_nvme_ctrlr *ctrlr)
 	return SPDK_CONTAINEROF(ctrlr, struct nvme_tcp_ctrlr, ctrlr);
 }
 
+/* Returns the qpair visible to the user, i.e. the qpair an additional connection belongs to */
+static inline struct spdk_nvme_qpair *
+nvme_tcp_qpair_owner(struct nvme_tcp_qpair *tqpair)
+{
+	return tqpair->parent != NULL ? &tqpair->parent->qpair : &tqpair->qpair;
+}
+
 static struct nvme_tcp_req *
 nvme_tcp_req_get(struct nvme_tcp_qpair *tqpair)
 {
@@ -282,12 +333,15 @@ nvme_tcp_free_reqs(struct nvme_tcp_qpair *tqpair)
 
 	spdk_free(tqpair->send_pdus);
 	tqpair->send_pdus = NULL;
+
+	free(tqpair->recv_ddgsts);
+	tqpair->recv_ddgsts = NULL;
 }
 
 static int
 nvme_tcp_alloc_reqs(struct nvme_tcp_qpair *tqpair)
 {
-	uint16_t i;
+	uint32_t i, num_recv_ddgsts;
 	struct nvme_tcp_req *tcp_req;
 
 	tqpair->tcp_reqs = aligned_alloc(SPDK_CACHE_LINE_SIZE,
@@ -323,6 +377,20 @@ nvme_tcp_alloc_reqs(struct nvme_tcp_qpair *tqpair)
 	tqpair->send_pdu = &tqpair->send_pdus[i];
 	tqpair->recv_pdu = &tqpair->send_pdus[i + 1];
 
+	STAILQ_INIT(&tqpair->free_recv_ddgsts);
+	if (tqpair->qpair.ctrlr != NULL && tqpair->qpair.ctrlr->opts.data_digest) {
+		num_recv_ddgsts = tqpair->num_entries * NVME_TCP_RECV_DDGST_PER_REQ;
+		tqpair->recv_ddgsts = calloc(num_recv_ddgsts, sizeof(*tqpair->recv_ddgsts));
+		if (tqpair->recv_ddgsts == NULL) {
+			SPDK_ERRLOG("Failed to allocate recv_ddgsts on tqpair=%p\n", tqpair);
+			goto fail;
+		}
+
+		for (i = 0; i < num_recv_ddgsts; i++) {
+			STAILQ_INSERT_TAIL(&tqpair->free_recv_ddgsts, &tqpair->recv_ddgsts[i], link);
+		}
+	}
+
 	return 0;
 fail:
 	nvme_tcp_free_reqs(tqpair);
@@ -348,13 +416,62 @@ nvme_tcp_qpair_set_recv_state(struct nvme_tcp_qpair *tqpair,
 
 static void nvme_tcp_qpair_abort_reqs(struct spdk_nvme_qpair *qpair, uint32_t dnr);
 
+static bool
+nvme_tcp_qpair_outstanding_empty(struct nvme_tcp_qpair *tqpair)
+{
+	uint8_t i;
+
+	if (!TAILQ_EMPTY(&tqpair->outstanding_reqs)) {
+		return false;
+	}
+
+	for (i = 0; i < tqpair->num_conns; i++) {
+		if (!TAILQ_EMPTY(&tqpair->conns[i]->outstanding_reqs)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static void
+nvme_tcp_qpair_disconnect_done(struct nvme_tcp_qpair *tqpair)
+{
+	struct nvme_tcp_qpair *conn;
+	uint8_t i;
+
+	for (i = 0; i < tqpair->num_conns; i++) {
+		conn = tqpair->conns[i];
+		if (nvme_qpair_get_state(&conn->qpair) != NVME_QPAIR_DISCONNECTED) {
+			nvme_transport_ctrlr_disconnect_qpair_done(&conn->qpair);
+		}
+	}
+
+	nvme_transport_ctrlr_disconnect_qpair_done(&tqpair->qpair);
+}
+
 static void
 nvme_tcp_ctrlr_disconnect_qpair(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_qpair *qpair)
 {
 	struct nvme_tcp_qpair *tqpair = nvme_tcp_qpair(qpair);
+	struct nvme_tcp_qpair *conn;
 	struct nvme_tcp_pdu *pdu;
 	int rc;
 	struct nvme_tcp_poll_group *group;
+	uint8_t i;
+
+	/* The additional connections of a striped qpair are torn down along with it */
+	for (i = 0; i < tqpair->num_conns; i++) {
+		conn = tqpair->conns[i];
+		if (nvme_qpair_get_state(&conn->qpair) == NVME_QPAIR_DISCONNECTING ||
+		    nvme_qpair_get_state(&conn->qpair) == NVME_QPAIR_DISCONNECTED) {
+			continue;
+		}
+
+		nvme_qpair_set_state(&conn->qpair, NVME_QPAIR_DISCONNECTING);
+		conn->qpair.abort_dnr = qpair->abort_dnr;
+		nvme_tcp_ctrlr_disconnect_qpair(ctrlr, &conn->qpair);
+	}
 
 	if (tqpair->needs_poll) {
 		group = nvme_tcp_poll_group(qpair->poll_group);
@@ -389,8 +506,8 @@ nvme_tcp_ctrlr_disconnect_qpair(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_
 	if (qpair->async) {
 		nvme_tcp_qpair_set_recv_state(tqpair, NVME_TCP_PDU_RECV_STATE_QUIESCING);
 	} else {
-		assert(TAILQ_EMPTY(&tqpair->outstanding_reqs));
-		nvme_transport_ctrlr_disconnect_qpair_done(qpair);
+		assert(nvme_tcp_qpair_outstanding_empty(tqpair));
+		nvme_tcp_qpair_disconnect_done(tqpair);
 	}
 }
 
@@ -398,10 +515,22 @@ static int
 nvme_tcp_ctrlr_delete_io_qpair(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_qpair *qpair)
 {
 	struct nvme_tcp_qpair *tqpair = nvme_tcp_qpair(qpair);
+	struct nvme_tcp_qpair *conn;
+	uint8_t i;
 
 	assert(qpair != NULL);
 	nvme_tcp_qpair_abort_reqs(qpair, qpair->abort_dnr);
-	assert(TAILQ_EMPTY(&tqpair->outstanding_reqs));
+	assert(nvme_tcp_qpair_outstanding_empty(tqpair));
+
+	for (i = 0; i < tqpair->num_conns; i++) {
+		conn = tqpair->conns[i];
+		if (conn->sock != NULL) {
+			spdk_sock_close(&conn->sock);
+		}
+
+		spdk_nvme_ctrlr_free_qid(ctrlr, conn->qpair.id);
+		nvme_tcp_ctrlr_delete_io_qpair(ctrlr, &conn->qpair);
+	}
 
 	nvme_qpair_deinit(qpair);
 	nvme_tcp_free_reqs(tqpair);
@@ -454,7 +583,7 @@ nvme_tcp_cond_schedule_qpair_polling(struct nvme_tcp_qpair *tqpair)
 		return;
 	}
 
-	if (STAILQ_EMPTY(&tqpair->qpair.queued_req) &&
+	if (STAILQ_EMPTY(&nvme_tcp_qpair_owner(tqpair)->queued_req) &&
 	    spdk_likely(tqpair->state != NVME_TCP_QPAIR_STATE_FABRIC_CONNECT_POLL &&
 			tqpair->state != NVME_TCP_QPAIR_STATE_INITIALIZING)) {
 		return;
@@ -475,7 +604,7 @@ pdu_write_done(void *cb_arg, int err)
 	TAILQ_REMOVE(&tqpair->send_queue, pdu, tailq);
 
 	if (err != 0) {
-		nvme_transport_ctrlr_disconnect_qpair(tqpair->qpair.ctrlr, &tqpair->qpair);
+		nvme_transport_ctrlr_disconnect_qpair(tqpair->qpair.ctrlr, nvme_tcp_qpair_owner(tqpair));
 		return;
 	}
 
@@ -1023,6 +1152,46 @@ end:
 
 }
 
+static inline bool
+nvme_tcp_conn_is_running(struct nvme_tcp_qpair *conn)
+{
+	return conn->state == NVME_TCP_QPAIR_STATE_RUNNING &&
+	       nvme_qpair_get_state(&conn->qpair) == NVME_QPAIR_CONNECTED;
+}
+
+/*
+ * Selects the connection of a striped qpair a request is sent on.  The connection with the
+ * fewest outstanding requests is used, ties are resolved in a round-robin fashion, so that
+ * consecutive requests are spread across the connections even at low queue depths.
+ */
+static struct nvme_tcp_qpair *
+nvme_tcp_qpair_select_conn(struct nvme_tcp_qpair *tqpair)
+{
+	struct nvme_tcp_qpair *conn, *selected = NULL;
+	uint8_t i, idx, selected_idx = 0, num_conns = tqpair->num_conns + 1;
+
+	for (i = 0; i < num_conns; i++) {
+		idx = (tqpair->next_conn + i) % num_conns;
+		if (idx == 0) {
+			conn = tqpair;
+		} else {
+			conn = tqpair->conns[idx - 1];
+			if (!nvme_tcp_conn_is_running(conn)) {
+				continue;
+			}
+		}
+
+		if (selected == NULL || conn->qpair.queue_depth < selected->qpair.queue_depth) {
+			selected = conn;
+			selected_idx = idx;
+		}
+	}
+
+	tqpair->next_conn = (selected_idx + 1) % num_conns;
+
+	return selected;
+}
+
 static int
 nvme_tcp_qpair_submit_request(struct spdk_nvme_qpair *qpair,
 			      struct nvme_request *req)
@@ -1034,6 +1203,13 @@ nvme_tcp_qpair_submit_request(struct spdk_nvme_qpair *qpair,
 	assert(tqpair != NULL);
 	assert(req != NULL);
 
+	if (tqpair->num_conns > 0 && spdk_likely(tqpair->state == NVME_TCP_QPAIR_STATE_RUNNING)) {
+		tqpair = nvme_tcp_qpair_select_conn(tqpair);
+		if (tqpair->parent != NULL) {
+			tqpair->stats->striped_requests++;
+		}
+	}
+
 	tcp_req = nvme_tcp_req_get(tqpair);
 	if (!tcp_req) {
 		tqpair->stats->queued_requests++;
@@ -1111,6 +1287,7 @@ nvme_tcp_qpair_abort_reqs(struct spdk_nvme_qpair *qpair, uint32_t dnr)
 	struct nvme_tcp_req *tcp_req, *tmp;
 	struct spdk_nvme_cpl cpl = {};
 	struct nvme_tcp_qpair *tqpair = nvme_tcp_qpair(qpair);
+	uint8_t i;
 
 	cpl.sqid = qpair->id;
 	cpl.status.sc = SPDK_NVME_SC_ABORTED_SQ_DELETION;
@@ -1125,6 +1302,10 @@ nvme_tcp_qpair_abort_reqs(struct spdk_nvme_qpair *qpair, uint32_t dnr)
 
 		nvme_tcp_req_complete(tcp_req, tqpair, &cpl, true);
 	}
+
+	for (i = 0; i < tqpair->num_conns; i++) {
+		nvme_tcp_qpair_abort_reqs(&tqpair->conns[i]->qpair, dnr);
+	}
 }
 
 static void
@@ -1280,7 +1461,12 @@ static struct nvme_tcp_req *
 get_nvme_active_req_by_cid(struct nvme_tcp_qpair *tqpair, uint32_t cid)
 {
 	assert(tqpair != NULL);
-	if ((cid >= tqpair->num_entries) || (tqpair->tcp_reqs[cid].state == NVME_TCP_REQ_FREE)) {
+	if ((cid < tqpair->cid_base) || (cid - tqpair->cid_base >= tqpair->num_entries)) {
+		return NULL;
+	}
+
+	cid -= tqpair->cid_base;
+	if (tqpair->tcp_reqs[cid].state == NVME_TCP_REQ_FREE) {
 		return NULL;
 	}
 
@@ -1519,6 +1705,75 @@ nvme_tcp_accel_recv_compute_crc32(struct nvme_tcp_req *treq, struct nvme_tcp_pdu
 	return false;
 }
 
+static void
+nvme_tcp_accel_seq_recv_ddgst_done(void *cb_arg)
+{
+	struct nvme_tcp_recv_ddgst *ddgst = cb_arg;
+	struct nvme_tcp_req *treq = ddgst->treq;
+	struct nvme_tcp_qpair *tqpair = treq->tqpair;
+	bool result;
+
+	ddgst->crc32c ^= SPDK_CRC32C_XOR;
+	result = MATCH_DIGEST_WORD(ddgst->data_digest, ddgst->crc32c);
+	if (spdk_unlikely(!result)) {
+		SPDK_ERRLOG("data digest error on tqpair=(%p)\n", tqpair);
+		treq->rsp.status.sc = SPDK_NVME_SC_COMMAND_TRANSIENT_TRANSPORT_ERROR;
+	}
+
+	STAILQ_INSERT_HEAD(&tqpair->free_recv_ddgsts, ddgst, link);
+}
+
+/*
+ * Append the data digest calculation of a C2H PDU that carries only a part of the request's
+ * payload to the request's accel sequence.  The data has already been received into the
+ * request's buffers, so only the digest and the iovecs need to be kept until the sequence is
+ * executed, which is done once the last PDU of the request is received.
+ */
+static bool
+nvme_tcp_accel_recv_append_crc32(struct nvme_tcp_req *treq, struct nvme_tcp_pdu *pdu)
+{
+	struct nvme_tcp_qpair *tqpair = treq->tqpair;
+	struct nvme_tcp_poll_group *tgroup = nvme_tcp_poll_group(tqpair->qpair.poll_group);
+	struct nvme_request *req = treq->req;
+	struct nvme_tcp_recv_ddgst *ddgst;
+	int rc;
+
+	if (spdk_unlikely(nvme_qpair_get_state(&tqpair->qpair) < NVME_QPAIR_CONNECTED ||
+			  tqpair->qpair.poll_group == NULL || pdu->dif_ctx != NULL ||
+			  pdu->data_len % SPDK_NVME_TCP_DIGEST_ALIGNMENT != 0 ||
+			  pdu->data_len == req->payload_size)) {
+		return false;
+	}
+
+	ddgst = STAILQ_FIRST(&tqpair->free_recv_ddgsts);
+	if (ddgst == NULL || tgroup->group.group->accel_fn_table.append_crc32c == NULL) {
+		return false;
+	}
+
+	ddgst->treq = treq;
+	memcpy(ddgst->data_digest, pdu->data_digest, sizeof(ddgst->data_digest));
+	memcpy(ddgst->iov, pdu->data_iov, sizeof(pdu->data_iov[0]) * pdu->data_iovcnt);
+	ddgst->iovcnt = pdu->data_iovcnt;
+
+	rc = nvme_tcp_accel_append_crc32c(tgroup, &req->accel_sequence, &ddgst->crc32c,
+					  ddgst->iov, ddgst->iovcnt, 0,
+					  nvme_tcp_accel_seq_recv_ddgst_done, ddgst);
+	if (spdk_unlikely(rc != 0)) {
+		/* If accel is out of resources, fall back to non-accelerated crc32 */
+		if (rc == -ENOMEM) {
+			return false;
+		}
+
+		SPDK_ERRLOG("Failed to append crc32c operation: %d\n", rc);
+		treq->rsp.status.sc = SPDK_NVME_SC_COMMAND_TRANSIENT_TRANSPORT_ERROR;
+		return true;
+	}
+
+	STAILQ_REMOVE_HEAD(&tqpair->free_recv_ddgsts, link);
+
+	return true;
+}
+
 static void
 nvme_tcp_pdu_payload_handle(struct nvme_tcp_qpair *tqpair,
 			    uint32_t *reaped)
@@ -1544,14 +1799,16 @@ nvme_tcp_pdu_payload_handle(struct nvme_tcp_qpair *tqpair,
 			return;
 		}
 
-		crc32c = nvme_tcp_pdu_calc_data_digest(pdu);
-		crc32c = crc32c ^ SPDK_CRC32C_XOR;
-		rc = MATCH_DIGEST_WORD(pdu->data_digest, crc32c);
-		if (rc == 0) {
-			SPDK_ERRLOG("data digest error on tqpair=(%p) with pdu=%p\n", tqpair, pdu);
-			tcp_req = pdu->req;
-			assert(tcp_req != NULL);
-			tcp_req->rsp.status.sc = SPDK_NVME_SC_COMMAND_TRANSIENT_TRANSPORT_ERROR;
+		if (!nvme_tcp_accel_recv_append_crc32(tcp_req, pdu)) {
+			crc32c = nvme_tcp_pdu_calc_data_digest(pdu);
+			crc32c = crc32c ^ SPDK_CRC32C_XOR;
+			rc = MATCH_DIGEST_WORD(pdu->data_digest, crc32c);
+			if (rc == 0) {
+				SPDK_ERRLOG("data digest error on tqpair=(%p) with pdu=%p\n", tqpair, pdu);
+				tcp_req = pdu->req;
+				assert(tcp_req != NULL);
+				tcp_req->rsp.status.sc = SPDK_NVME_SC_COMMAND_TRANSIENT_TRANSPORT_ERROR;
+			}
 		}
 	}
 
@@ -2117,9 +2374,9 @@ nvme_tcp_read_pdu(struct nvme_tcp_qpair *tqpair, uint32_t *reaped, uint32_t max_
 			nvme_tcp_pdu_payload_handle(tqpair, reaped);
 			break;
 		case NVME_TCP_PDU_RECV_STATE_QUIESCING:
-			if (TAILQ_EMPTY(&tqpair->outstanding_reqs)) {
+			if (nvme_tcp_qpair_outstanding_empty(tqpair)) {
 				if (nvme_qpair_get_state(&tqpair->qpair) == NVME_QPAIR_DISCONNECTING) {
-					nvme_transport_ctrlr_disconnect_qpair_done(&tqpair->qpair);
+					nvme_tcp_qpair_disconnect_done(tqpair);
 				}
 
 				nvme_tcp_qpair_set_recv_state(tqpair, NVME_TCP_PDU_RECV_STATE_ERROR);
@@ -2182,12 +2439,15 @@ nvme_tcp_qpair_check_timeout(struct spdk_nvme_qpair *qpair)
 
 static int nvme_tcp_ctrlr_connect_qpair_poll(struct spdk_nvme_ctrlr *ctrlr,
 		struct spdk_nvme_qpair *qpair);
+static int nvme_tcp_conn_process_completions(struct nvme_tcp_qpair *conn,
+		uint32_t max_completions);
 
 static int
 nvme_tcp_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_completions)
 {
 	struct nvme_tcp_qpair *tqpair = nvme_tcp_qpair(qpair);
 	uint32_t reaped;
+	uint8_t i;
 	int rc;
 
 	if (qpair->poll_group == NULL) {
@@ -2200,8 +2460,8 @@ nvme_tcp_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_c
 			}
 
 			if (nvme_qpair_get_state(qpair) == NVME_QPAIR_DISCONNECTING) {
-				if (TAILQ_EMPTY(&tqpair->outstanding_reqs)) {
-					nvme_transport_ctrlr_disconnect_qpair_done(qpair);
+				if (nvme_tcp_qpair_outstanding_empty(tqpair)) {
+					nvme_tcp_qpair_disconnect_done(tqpair);
 				}
 
 				/* Don't return errors until the qpair gets disconnected */
@@ -2241,8 +2501,26 @@ nvme_tcp_qpair_process_completions(struct spdk_nvme_qpair *qpair, uint32_t max_c
 		}
 	}
 
+	/* Without a poll group, the additional connections of a striped qpair are polled here */
+	if (qpair->poll_group == NULL) {
+		for (i = 0; i < tqpair->num_conns; i++) {
+			rc = nvme_tcp_conn_process_completions(tqpair->conns[i], max_completions);
+			if (rc < 0) {
+				goto fail;
+			}
+
+			reaped += rc;
+		}
+	}
+
 	return reaped;
 fail:
+	/* A failure of any of the connections of a striped qpair fails the whole qpair */
+	if (spdk_unlikely(tqpair->parent != NULL)) {
+		tqpair->parent->qpair.transport_failure_reason = SPDK_NVME_QPAIR_FAILURE_UNKNOWN;
+		nvme_ctrlr_disconnect_qpair(&tqpair->parent->qpair);
+		return -ENXIO;
+	}
 
 	/*
 	 * Since admin queues take the ctrlr_lock before entering this function,
@@ -2266,6 +2544,50 @@ fail:
 	return -ENXIO;
 }
 
+/*
+ * Reaps the completions of an additional connection of a striped qpair.  The requests sent on
+ * the connection belong to the qpair exposed to the user, so its completion context is
+ * entered too, to make sure the qpair isn't freed from a completion callback.
+ */
+static int
+nvme_tcp_conn_process_completions(struct nvme_tcp_qpair *conn, uint32_t max_completions)
+{
+	struct spdk_nvme_qpair *qpair = &conn->parent->qpair;
+	enum nvme_qpair_state state = nvme_qpair_get_state(&conn->qpair);
+	uint8_t in_completion_context;
+	int rc;
+
+	if (state != NVME_QPAIR_CONNECTING && state != NVME_QPAIR_CONNECTED) {
+		return 0;
+	}
+
+	if (spdk_unlikely(qpair->ctrlr->is_failed &&
+			  nvme_qpair_get_state(qpair) != NVME_QPAIR_DISCONNECTING)) {
+		return -ENXIO;
+	}
+
+	in_completion_context = qpair->in_completion_context;
+	qpair->in_completion_context = 1;
+	conn->qpair.in_completion_context = 1;
+	rc = nvme_tcp_qpair_process_completions(&conn->qpair, max_completions);
+	conn->qpair.in_completion_context = 0;
+	qpair->in_completion_context = in_completion_context;
+
+	/* If called from the qpair's own completion context, it's up to the caller to do this */
+	if (!in_completion_context) {
+		if (qpair->delete_after_completion_context) {
+			spdk_nvme_ctrlr_free_io_qpair(qpair);
+			return rc;
+		}
+
+		if (rc > 0) {
+			nvme_qpair_resubmit_requests(qpair, rc);
+		}
+	}
+
+	return rc;
+}
+
 static void
 nvme_tcp_qpair_sock_cb(void *ctx, struct spdk_sock_group *group, struct spdk_sock *sock)
 {
@@ -2279,7 +2601,11 @@ nvme_tcp_qpair_sock_cb(void *ctx, struct spdk_sock_group *group, struct spdk_soc
 		tqpair->needs_poll = false;
 	}
 
-	num_completions = spdk_nvme_qpair_process_completions(qpair, pgroup->completions_per_qpair);
+	if (spdk_unlikely(tqpair->parent != NULL)) {
+		num_completions = nvme_tcp_conn_process_completions(tqpair, pgroup->completions_per_qpair);
+	} else {
+		num_completions = spdk_nvme_qpair_process_completions(qpair, pgroup->completions_per_qpair);
+	}
 
 	if (pgroup->num_completions >= 0 && num_completions >= 0) {
 		pgroup->num_completions += num_completions;
@@ -2479,12 +2805,36 @@ nvme_tcp_ctrlr_connect_qpair_poll(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvm
 	return rc;
 }
 
+/*
+ * Starts connecting an additional connection of a striped qpair.  It goes through the same
+ * ICReq/CONNECT sequence as any other qpair and is used for I/O once it gets to the running
+ * state.
+ */
+static int
+nvme_tcp_conn_connect(struct nvme_tcp_qpair *tqpair, struct nvme_tcp_qpair *conn)
+{
+	conn->qpair.transport = tqpair->qpair.transport;
+	conn->qpair.active_proc = tqpair->qpair.active_proc;
+	conn->stats = tqpair->stats;
+	conn->shared_stats = true;
+	conn->maxr2t = NVME_TCP_MAX_R2T_DEFAULT;
+	conn->state = NVME_TCP_QPAIR_STATE_INVALID;
+	if (conn->recv_state != NVME_TCP_PDU_RECV_STATE_AWAIT_PDU_READY) {
+		nvme_tcp_qpair_set_recv_state(conn, NVME_TCP_PDU_RECV_STATE_AWAIT_PDU_READY);
+	}
+
+	nvme_qpair_set_state(&conn->qpair, NVME_QPAIR_CONNECTING);
+
+	return nvme_tcp_qpair_icreq_send(conn);
+}
+
 static int
 nvme_tcp_ctrlr_connect_qpair(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_qpair *qpair)
 {
 	int rc = 0;
 	struct nvme_tcp_qpair *tqpair;
 	struct nvme_tcp_poll_group *tgroup;
+	uint8_t i;
 
 	tqpair = nvme_tcp_qpair(qpair);
 
@@ -2495,6 +2845,15 @@ nvme_tcp_ctrlr_connect_qpair(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_qpa
 		}
 	}
 
+	for (i = 0; i < tqpair->num_conns; i++) {
+		if (!tqpair->conns[i]->sock) {
+			rc = nvme_tcp_qpair_connect_sock(ctrlr, &tqpair->conns[i]->qpair);
+			if (rc < 0) {
+				return rc;
+			}
+		}
+	}
+
 	if (qpair->poll_group) {
 		rc = nvme_poll_group_connect_qpair(qpair);
 		if (rc) {
@@ -2530,6 +2889,14 @@ nvme_tcp_ctrlr_connect_qpair(struct spdk_nvme_ctrlr *ctrlr, struct spdk_nvme_qpa
 		return rc;
 	}
 
+	for (i = 0; i < tqpair->num_conns; i++) {
+		rc = nvme_tcp_conn_connect(tqpair, tqpair->conns[i]);
+		if (rc != 0) {
+			SPDK_ERRLOG("Unable to connect connection %u of the tqpair\n", i + 1);
+			return rc;
+		}
+	}
+
 	return rc;
 }
 
@@ -2584,12 +2951,75 @@ nvme_tcp_ctrlr_create_qpair(struct spdk_nvme_ctrlr *ctrlr,
 	return qpair;
 }
 
+static void
+nvme_tcp_qpair_set_cid_base(struct nvme_tcp_qpair *tqpair, uint16_t cid_base)
+{
+	uint16_t i;
+
+	tqpair->cid_base = cid_base;
+	for (i = 0; i < tqpair->num_entries; i++) {
+		tqpair->tcp_reqs[i].cid = cid_base + i;
+	}
+}
+
+/*
+ * Creates the additional connections of a striped qpair.  Each one is a separate NVMe I/O
+ * queue with its own qid.  The CIDs of their requests are offset, so that they're unique
+ * across the whole qpair.  Striping is done on a best-effort basis: if a connection can't be
+ * created, the qpair uses fewer connections.
+ */
+static void
+nvme_tcp_qpair_create_conns(struct spdk_nvme_ctrlr *ctrlr, struct nvme_tcp_qpair *tqpair,
+			    const struct spdk_nvme_io_qpair_opts *opts)
+{
+	struct spdk_nvme_qpair *qpair;
+	struct nvme_tcp_qpair *conn;
+	uint32_t num_conns;
+	int32_t qid;
+
+	num_conns = spdk_min(opts->num_connections, NVME_TCP_MAX_CONNS_PER_QPAIR) - 1;
+	while (tqpair->num_conns < num_conns) {
+		if ((uint32_t)(tqpair->num_conns + 2) * tqpair->num_entries > UINT16_MAX + 1) {
+			break;
+		}
+
+		qid = spdk_nvme_ctrlr_alloc_qid(ctrlr);
+		if (qid < 0) {
+			break;
+		}
+
+		qpair = nvme_tcp_ctrlr_create_qpair(ctrlr, qid, opts->io_queue_size, opts->qprio,
+						    NVME_TCP_CONN_NUM_REQUESTS, opts->async_mode);
+		if (qpair == NULL) {
+			spdk_nvme_ctrlr_free_qid(ctrlr, qid);
+			break;
+		}
+
+		conn = nvme_tcp_qpair(qpair);
+		conn->parent = tqpair;
+		nvme_tcp_qpair_set_cid_base(conn, (tqpair->num_conns + 1) * tqpair->num_entries);
+		tqpair->conns[tqpair->num_conns++] = conn;
+	}
+
+	if (tqpair->num_conns < num_conns) {
+		SPDK_NOTICELOG("tqpair=%p striped across %u instead of %u connections\n", tqpair,
+			       tqpair->num_conns + 1, num_conns + 1);
+	}
+}
+
 static struct spdk_nvme_qpair *
 nvme_tcp_ctrlr_create_io_qpair(struct spdk_nvme_ctrlr *ctrlr, uint16_t qid,
 			       const struct spdk_nvme_io_qpair_opts *opts)
 {
-	return nvme_tcp_ctrlr_create_qpair(ctrlr, qid, opts->io_queue_size, opts->qprio,
-					   opts->io_queue_requests, opts->async_mode);
+	struct spdk_nvme_qpair *qpair;
+
+	qpair = nvme_tcp_ctrlr_create_qpair(ctrlr, qid, opts->io_queue_size, opts->qprio,
+					    opts->io_queue_requests, opts->async_mode);
+	if (qpair != NULL && opts->num_connections > 1) {
+		nvme_tcp_qpair_create_conns(ctrlr, nvme_tcp_qpair(qpair), opts);
+	}
+
+	return qpair;
 }
 
 static int
@@ -2758,6 +3188,7 @@ nvme_tcp_qpair_iterate_requests(struct spdk_nvme_qpair *qpair,
 {
 	struct nvme_tcp_qpair *tqpair = nvme_tcp_qpair(qpair);
 	struct nvme_tcp_req *tcp_req, *tmp;
+	uint8_t i;
 	int rc;
 
 	assert(iter_fn != NULL);
@@ -2771,6 +3202,13 @@ nvme_tcp_qpair_iterate_requests(struct spdk_nvme_qpair *qpair,
 		}
 	}
 
+	for (i = 0; i < tqpair->num_conns; i++) {
+		rc = nvme_tcp_qpair_iterate_requests(&tqpair->conns[i]->qpair, iter_fn, arg);
+		if (rc != 0) {
+			return rc;
+		}
+	}
+
 	return 0;
 }
 
@@ -2858,10 +3296,25 @@ nvme_tcp_poll_group_connect_qpair(struct spdk_nvme_qpair *qpair)
 {
 	struct nvme_tcp_poll_group *group = nvme_tcp_poll_group(qpair->poll_group);
 	struct nvme_tcp_qpair *tqpair = nvme_tcp_qpair(qpair);
+	struct nvme_tcp_qpair *conn;
+	uint8_t i;
 
 	if (spdk_sock_group_add_sock(group->sock_group, tqpair->sock, nvme_tcp_qpair_sock_cb, qpair)) {
 		return -EPROTO;
 	}
+
+	for (i = 0; i < tqpair->num_conns; i++) {
+		conn = tqpair->conns[i];
+		if (spdk_sock_group_add_sock(group->sock_group, conn->sock, nvme_tcp_qpair_sock_cb,
+					     &conn->qpair)) {
+			while (i-- > 0) {
+				spdk_sock_group_remove_sock(group->sock_group, tqpair->conns[i]->sock);
+			}
+			spdk_sock_group_remove_sock(group->sock_group, tqpair->sock);
+			return -EPROTO;
+		}
+	}
+
 	return 0;
 }
 
@@ -2870,6 +3323,15 @@ nvme_tcp_poll_group_disconnect_qpair(struct spdk_nvme_qpair *qpair)
 {
 	struct nvme_tcp_poll_group *group = nvme_tcp_poll_group(qpair->poll_group);
 	struct nvme_tcp_qpair *tqpair = nvme_tcp_qpair(qpair);
+	uint8_t i;
+	int rc;
+
+	for (i = 0; i < tqpair->num_conns; i++) {
+		rc = nvme_tcp_poll_group_disconnect_qpair(&tqpair->conns[i]->qpair);
+		if (rc != 0) {
+			return rc;
+		}
+	}
 
 	if (tqpair->needs_poll) {
 		TAILQ_REMOVE(&group->needs_poll, tqpair, link);
@@ -2890,6 +3352,11 @@ nvme_tcp_poll_group_add(struct spdk_nvme_transport_poll_group *tgroup,
 {
 	struct nvme_tcp_qpair *tqpair = nvme_tcp_qpair(qpair);
 	struct nvme_tcp_poll_group *group = nvme_tcp_poll_group(tgroup);
+	uint8_t i;
+
+	for (i = 0; i < tqpair->num_conns; i++) {
+		tqpair->conns[i]->qpair.poll_group = tgroup;
+	}
 
 	/* disconnected qpairs won't have a sock to add. */
 	if (nvme_qpair_get_state(qpair) >= NVME_QPAIR_CONNECTED) {
@@ -2905,8 +3372,9 @@ static int
 nvme_tcp_poll_group_remove(struct spdk_nvme_transport_poll_group *tgroup,
 			   struct spdk_nvme_qpair *qpair)
 {
-	struct nvme_tcp_qpair *tqpair;
+	struct nvme_tcp_qpair *tqpair, *conn;
 	struct nvme_tcp_poll_group *group;
+	uint8_t i;
 
 	assert(qpair->poll_group_tailq_head == &tgroup->disconnected_qpairs);
 
@@ -2921,6 +3389,16 @@ nvme_tcp_poll_group_remove(struct spdk_nvme_transport_poll_group *tgroup,
 		tqpair->needs_poll = false;
 	}
 
+	for (i = 0; i < tqpair->num_conns; i++) {
+		conn = tqpair->conns[i];
+		conn->stats = &g_dummy_stats;
+		if (conn->needs_poll) {
+			TAILQ_REMOVE(&group->needs_poll, conn, link);
+			conn->needs_poll = false;
+		}
+		conn->qpair.poll_group = NULL;
+	}
+
 	return 0;
 }
 
@@ -2942,8 +3420,8 @@ nvme_tcp_poll_group_process_completions(struct spdk_nvme_transport_poll_group *t
 	STAILQ_FOREACH_SAFE(qpair, &tgroup->disconnected_qpairs, poll_group_stailq, tmp_qpair) {
 		tqpair = nvme_tcp_qpair(qpair);
 		if (nvme_qpair_get_state(qpair) == NVME_QPAIR_DISCONNECTING) {
-			if (TAILQ_EMPTY(&tqpair->outstanding_reqs)) {
-				nvme_transport_ctrlr_disconnect_qpair_done(qpair);
+			if (nvme_tcp_qpair_outstanding_empty(tqpair)) {
+				nvme_tcp_qpair_disconnect_done(tqpair);
 			}
 		}
 		/* Wait until the qpair transitions to the DISCONNECTED state, otherwise user might
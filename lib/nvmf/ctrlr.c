@@ -44,6 +44,9 @@
 
 #define NVMF_ABORT_COMMAND_LIMIT 3
 
+/* Number of hosts whose namespace state each subsystem keeps for their next controllers */
+#define NVMF_CTRLR_MAX_HOST_STATES 256
+
 /*
  * Support for custom admin command handlers
  */
@@ -429,6 +432,114 @@ nvmf_ctrlr_init_visible_ns(struct spdk_nvmf_ctrlr *ctrlr)
 	}
 }
 
+/*
+ * Namespace state of a subsystem as seen by a host.  It's computed when a controller of the
+ * host is created and reused by the controllers the host creates later (e.g. when it
+ * reconnects after a path failure), as long as the namespaces don't change in between.
+ */
+struct nvmf_ctrlr_host_state {
+	char					hostnqn[SPDK_NVMF_NQN_MAX_LEN + 1];
+	struct spdk_uuid			hostid;
+	uint64_t				ns_gen;
+	bool					multi_iocs;
+	TAILQ_ENTRY(nvmf_ctrlr_host_state)	link;
+	/* Mask of the visible namespaces */
+	uint8_t					visible_ns[];
+};
+
+/* Must hold subsystem->mutex while calling this function */
+static struct nvmf_ctrlr_host_state *
+nvmf_ctrlr_find_host_state(struct spdk_nvmf_ctrlr *ctrlr)
+{
+	struct nvmf_ctrlr_host_state *state;
+
+	TAILQ_FOREACH(state, &ctrlr->subsys->host_states, link) {
+		if (spdk_uuid_compare(&state->hostid, &ctrlr->hostid) == 0 &&
+		    strcmp(state->hostnqn, ctrlr->hostnqn) == 0) {
+			return state;
+		}
+	}
+
+	return NULL;
+}
+
+/* Must hold subsystem->mutex while calling this function */
+static void
+nvmf_ctrlr_save_host_state(struct spdk_nvmf_ctrlr *ctrlr, uint64_t ns_gen, bool multi_iocs)
+{
+	struct spdk_nvmf_subsystem *subsystem = ctrlr->subsys;
+	struct nvmf_ctrlr_host_state *state;
+
+	state = nvmf_ctrlr_find_host_state(ctrlr);
+	if (state != NULL) {
+		TAILQ_REMOVE(&subsystem->host_states, state, link);
+	} else if (subsystem->num_host_states < NVMF_CTRLR_MAX_HOST_STATES) {
+		state = calloc(1, sizeof(*state) + spdk_divide_round_up(subsystem->max_nsid, 8));
+		if (state == NULL) {
+			return;
+		}
+		subsystem->num_host_states++;
+	} else {
+		/* Replace the least recently used one */
+		state = TAILQ_LAST(&subsystem->host_states, nvmf_ctrlr_host_states);
+		TAILQ_REMOVE(&subsystem->host_states, state, link);
+	}
+
+	snprintf(state->hostnqn, sizeof(state->hostnqn), "%s", ctrlr->hostnqn);
+	spdk_uuid_copy(&state->hostid, &ctrlr->hostid);
+	state->ns_gen = ns_gen;
+	state->multi_iocs = multi_iocs;
+	spdk_bit_array_store_mask(ctrlr->visible_ns, state->visible_ns);
+	TAILQ_INSERT_HEAD(&subsystem->host_states, state, link);
+}
+
+/* Initialize the visible namespaces of a controller and tell if it supports multiple I/O
+ * command sets, from the state saved for the host if it's still valid. */
+static bool
+nvmf_ctrlr_init_ns_state(struct spdk_nvmf_ctrlr *ctrlr)
+{
+	struct spdk_nvmf_subsystem *subsystem = ctrlr->subsys;
+	struct nvmf_ctrlr_host_state *state;
+	uint64_t ns_gen;
+	bool multi_iocs;
+
+	ns_gen = __atomic_load_n(&subsystem->ns_gen, __ATOMIC_ACQUIRE);
+
+	pthread_mutex_lock(&subsystem->mutex);
+	state = nvmf_ctrlr_find_host_state(ctrlr);
+	if (state != NULL && state->ns_gen == ns_gen) {
+		spdk_bit_array_load_mask(ctrlr->visible_ns, state->visible_ns);
+		multi_iocs = state->multi_iocs;
+		TAILQ_REMOVE(&subsystem->host_states, state, link);
+		TAILQ_INSERT_HEAD(&subsystem->host_states, state, link);
+		pthread_mutex_unlock(&subsystem->mutex);
+		return multi_iocs;
+	}
+	pthread_mutex_unlock(&subsystem->mutex);
+
+	/* Don't hold the mutex while walking the namespaces, it's needed by the other CONNECTs */
+	nvmf_ctrlr_init_visible_ns(ctrlr);
+	multi_iocs = nvmf_subsystem_has_zns_iocs(subsystem);
+
+	pthread_mutex_lock(&subsystem->mutex);
+	nvmf_ctrlr_save_host_state(ctrlr, ns_gen, multi_iocs);
+	pthread_mutex_unlock(&subsystem->mutex);
+
+	return multi_iocs;
+}
+
+void
+nvmf_ctrlr_free_host_states(struct spdk_nvmf_subsystem *subsystem)
+{
+	struct nvmf_ctrlr_host_state *state;
+
+	while ((state = TAILQ_FIRST(&subsystem->host_states)) != NULL) {
+		TAILQ_REMOVE(&subsystem->host_states, state, link);
+		free(state);
+	}
+	subsystem->num_host_states = 0;
+}
+
 static struct spdk_nvmf_ctrlr *
 nvmf_ctrlr_create(struct spdk_nvmf_subsystem *subsystem,
 		  struct spdk_nvmf_request *req,
@@ -533,7 +644,7 @@ nvmf_ctrlr_create(struct spdk_nvmf_subsystem *subsystem,
 		SPDK_ERRLOG("Failed to allocate visible namespace array\n");
 		goto err_visible_ns;
 	}
-	nvmf_ctrlr_init_visible_ns(ctrlr);
+	subsys_has_multi_iocs = nvmf_ctrlr_init_ns_state(ctrlr);
 
 	ctrlr->vcprop.cap.raw = 0;
 	ctrlr->vcprop.cap.bits.cqr = 1; /* NVMe-oF specification required */
@@ -543,7 +654,6 @@ nvmf_ctrlr_create(struct spdk_nvmf_subsystem *subsystem,
 	/* ready timeout - 500 msec units */
 	ctrlr->vcprop.cap.bits.to = NVMF_CTRLR_RESET_SHN_TIMEOUT_IN_MS / 500;
 	ctrlr->vcprop.cap.bits.dstrd = 0; /* fixed to 0 for NVMe-oF */
-	subsys_has_multi_iocs = nvmf_subsystem_has_zns_iocs(subsystem);
 	if (subsys_has_multi_iocs) {
 		ctrlr->vcprop.cap.bits.css =
 			SPDK_NVME_CAP_CSS_IOCS; /* One or more I/O command sets supported */
@@ -730,10 +840,15 @@ end:
 	spdk_nvmf_request_complete(req);
 }
 
+/*
+ * Look up the controller of an I/O queue CONNECT on the thread of the qpair and pass the
+ * request on to the controller's thread.  The controller can only be removed from the
+ * subsystem with subsystem->mutex held, and the message to destroy it is sent after that, so
+ * sending the request while holding the mutex guarantees that it's processed first.
+ */
 static void
-_nvmf_ctrlr_add_io_qpair(void *ctx)
+_nvmf_ctrlr_add_io_qpair(struct spdk_nvmf_request *req)
 {
-	struct spdk_nvmf_request *req = ctx;
 	struct spdk_nvmf_fabric_connect_rsp *rsp = &req->rsp->connect_rsp;
 	struct spdk_nvmf_fabric_connect_data *data;
 	struct spdk_nvmf_ctrlr *ctrlr;
@@ -757,20 +872,19 @@ _nvmf_ctrlr_add_io_qpair(void *ctx)
 	/* We already checked this in spdk_nvmf_ctrlr_connect */
 	assert(subsystem != NULL);
 
+	pthread_mutex_lock(&subsystem->mutex);
 	ctrlr = nvmf_subsystem_get_ctrlr(subsystem, data->cntlid);
 	if (ctrlr == NULL) {
 		SPDK_ERRLOG("Unknown controller ID 0x%x\n", data->cntlid);
 		SPDK_NVMF_INVALID_CONNECT_DATA(rsp, cntlid);
-		spdk_nvmf_request_complete(req);
-		return;
+		goto err;
 	}
 
 	/* fail before passing a message to the controller thread. */
 	if (ctrlr->in_destruct) {
 		SPDK_ERRLOG("Got I/O connect while ctrlr was being destroyed.\n");
 		SPDK_NVMF_INVALID_CONNECT_CMD(rsp, qid);
-		spdk_nvmf_request_complete(req);
-		return;
+		goto err;
 	}
 
 	/* If ANA reporting is enabled, check if I/O connect is on the same listener. */
@@ -778,16 +892,14 @@ _nvmf_ctrlr_add_io_qpair(void *ctx)
 		if (spdk_nvmf_qpair_get_listen_trid(req->qpair, &listen_trid) != 0) {
 			SPDK_ERRLOG("Could not get listener transport ID\n");
 			SPDK_NVMF_INVALID_CONNECT_CMD(rsp, qid);
-			spdk_nvmf_request_complete(req);
-			return;
+			goto err;
 		}
 
 		listener = nvmf_subsystem_find_listener(subsystem, &listen_trid);
 		if (listener != ctrlr->listener) {
 			SPDK_ERRLOG("I/O connect is on a listener different from admin connect\n");
 			SPDK_NVMF_INVALID_CONNECT_CMD(rsp, qid);
-			spdk_nvmf_request_complete(req);
-			return;
+			goto err;
 		}
 	}
 
@@ -806,11 +918,15 @@ _nvmf_ctrlr_add_io_qpair(void *ctx)
 		 * state to DEACTIVATING and removing it from poll group */
 		SPDK_ERRLOG("Inactive admin qpair (state %d, group %p)\n", admin_qpair_state, admin_qpair_group);
 		SPDK_NVMF_INVALID_CONNECT_CMD(rsp, qid);
-		spdk_nvmf_request_complete(req);
-		return;
+		goto err;
 	}
 	qpair->ctrlr = ctrlr;
 	spdk_thread_send_msg(admin_qpair_group->thread, nvmf_ctrlr_add_io_qpair, req);
+	pthread_mutex_unlock(&subsystem->mutex);
+	return;
+err:
+	pthread_mutex_unlock(&subsystem->mutex);
+	spdk_nvmf_request_complete(req);
 }
 
 static bool
@@ -939,7 +1055,7 @@ _nvmf_ctrlr_connect(struct spdk_nvmf_request *req)
 			return SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS;
 		}
 	} else {
-		spdk_thread_send_msg(subsystem->thread, _nvmf_ctrlr_add_io_qpair, req);
+		_nvmf_ctrlr_add_io_qpair(req);
 		return SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS;
 	}
 }
@@ -4480,6 +4596,7 @@ nvmf_ctrlr_process_io_cmd(struct spdk_nvmf_request *req)
 	struct spdk_nvmf_ctrlr *ctrlr = qpair->ctrlr;
 	struct spdk_nvme_cmd *cmd = &req->cmd->nvme_cmd;
 	struct spdk_nvme_cpl *response = &req->rsp->nvme_cpl;
+	struct spdk_nvmf_subsystem_poll_group *sgroup;
 	struct spdk_nvmf_subsystem_pg_ns_info *ns_info;
 	enum spdk_nvme_ana_state ana_state;
 
@@ -4503,6 +4620,15 @@ nvmf_ctrlr_process_io_cmd(struct spdk_nvmf_request *req)
 		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
 	}
 
+	/* scan-build falsely reporting dereference of null pointer */
+	assert(group != NULL && group->sgroups != NULL);
+	sgroup = &group->sgroups[ctrlr->subsys->id];
+	if (spdk_unlikely(sgroup->telemetry) && !req->qos_admitted) {
+		/* Accounted for on completion, including the time spent queued by the QoS */
+		req->telemetry = 1;
+		req->submit_tsc = spdk_get_ticks();
+	}
+
 	ana_state = nvmf_ctrlr_get_ana_state(ctrlr, ns->anagrpid);
 	if (spdk_unlikely(ana_state != SPDK_NVME_ANA_OPTIMIZED_STATE &&
 			  ana_state != SPDK_NVME_ANA_NON_OPTIMIZED_STATE)) {
@@ -4519,19 +4645,28 @@ nvmf_ctrlr_process_io_cmd(struct spdk_nvmf_request *req)
 					 ctrlr->listener->trid->trsvcid);
 	}
 
-	/* scan-build falsely reporting dereference of null pointer */
-	assert(group != NULL && group->sgroups != NULL);
-	ns_info = &group->sgroups[ctrlr->subsys->id].ns_info[nsid - 1];
+	ns_info = &sgroup->ns_info[nsid - 1];
 	if (nvmf_ns_reservation_request_check(ns_info, ctrlr, req)) {
 		SPDK_DEBUGLOG(nvmf, "Reservation Conflict for nsid %u, opcode %u\n",
 			      cmd->nsid, cmd->opc);
 		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
 	}
 
+	if (spdk_unlikely(!TAILQ_EMPTY(&sgroup->qos_rules)) && !req->qos_admitted) {
+		if (!nvmf_qos_admit(group, sgroup, req)) {
+			/* Queued until the QoS limits allow it, see nvmf_qos_resubmit() */
+			return SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS;
+		}
+	}
+
 	bdev = ns->bdev;
 	desc = ns->desc;
 	ch = ns_info->channel;
 
+	if (spdk_unlikely(ns_info->read_cache != NULL) && nvmf_ns_read_cache_cmd_modifies(cmd)) {
+		nvmf_ns_read_cache_invalidate(ns_info->read_cache, cmd);
+	}
+
 	if (spdk_unlikely(cmd->fuse & SPDK_NVME_CMD_FUSE_MASK)) {
 		return nvmf_ctrlr_process_io_fused_cmd(req, bdev, desc, ch);
 	} else if (spdk_unlikely(qpair->first_fused_req != NULL)) {
@@ -4557,10 +4692,16 @@ nvmf_ctrlr_process_io_cmd(struct spdk_nvmf_request *req)
 
 	if (spdk_nvmf_request_using_zcopy(req)) {
 		assert(req->zcopy_phase == NVMF_ZCOPY_PHASE_INIT);
+		if (spdk_unlikely(ns_info->read_cache_shard != NULL)) {
+			return nvmf_bdev_ctrlr_cached_zcopy_start(bdev, desc, ch, req, ns_info->read_cache_shard);
+		}
 		return nvmf_bdev_ctrlr_zcopy_start(bdev, desc, ch, req);
 	} else {
 		switch (cmd->opc) {
 		case SPDK_NVME_OPC_READ:
+			if (spdk_unlikely(ns_info->read_cache_shard != NULL)) {
+				return nvmf_bdev_ctrlr_cached_read_cmd(bdev, desc, ch, req, ns_info->read_cache_shard);
+			}
 			return nvmf_bdev_ctrlr_read_cmd(bdev, desc, ch, req);
 		case SPDK_NVME_OPC_WRITE:
 			return nvmf_bdev_ctrlr_write_cmd(bdev, desc, ch, req);
@@ -4666,6 +4807,16 @@ _nvmf_request_complete(void *ctx)
 		is_aer = req->cmd->nvme_cmd.opc == SPDK_NVME_OPC_ASYNC_EVENT_REQUEST;
 		if (spdk_likely(qpair->qid != 0)) {
 			qpair->group->stat.completed_nvme_io++;
+			qpair->group->stat.completed_nvme_io_bytes += req->length;
+
+			/* Invalidate the read cache again before the host can see the completion */
+			if (spdk_likely(nsid - 1 < sgroup->num_ns)) {
+				ns_info = &sgroup->ns_info[nsid - 1];
+				if (spdk_unlikely(ns_info->read_cache != NULL) &&
+				    nvmf_ns_read_cache_cmd_modifies(&req->cmd->nvme_cmd)) {
+					nvmf_ns_read_cache_invalidate(ns_info->read_cache, &req->cmd->nvme_cmd);
+				}
+			}
 		}
 
 		/*
@@ -4709,6 +4860,13 @@ _nvmf_request_complete(void *ctx)
 		break;
 	}
 
+	if (spdk_unlikely(req->telemetry) &&
+	    (req->zcopy_phase == NVMF_ZCOPY_PHASE_NONE ||
+	     req->zcopy_phase == NVMF_ZCOPY_PHASE_COMPLETE ||
+	     req->zcopy_phase == NVMF_ZCOPY_PHASE_INIT_FAILED)) {
+		nvmf_telemetry_record(sgroup, req);
+	}
+
 	if (spdk_unlikely(nvmf_transport_req_complete(req))) {
 		SPDK_ERRLOG("Transport request completion error!\n");
 	}
@@ -4910,6 +5068,8 @@ spdk_nvmf_request_exec(struct spdk_nvmf_request *req)
 
 	/* Place the request on the outstanding list so we can keep track of it */
 	TAILQ_INSERT_TAIL(&qpair->outstanding, req, link);
+	req->qos_admitted = 0;
+	req->telemetry = 0;
 
 	if (spdk_unlikely(req->cmd->nvmf_cmd.opcode == SPDK_NVME_OPC_FABRIC)) {
 		status = nvmf_ctrlr_process_fabrics_cmd(req);
@@ -4924,6 +5084,24 @@ spdk_nvmf_request_exec(struct spdk_nvmf_request *req)
 	}
 }
 
+void
+nvmf_qos_resubmit(struct spdk_nvmf_request *req)
+{
+	struct spdk_nvme_cpl *rsp = &req->rsp->nvme_cpl;
+
+	if (spdk_unlikely(!spdk_nvmf_qpair_is_active(req->qpair))) {
+		rsp->status.sct = SPDK_NVME_SCT_GENERIC;
+		rsp->status.sc = SPDK_NVME_SC_ABORTED_SQ_DELETION;
+		_nvmf_request_complete(req);
+		return;
+	}
+
+	req->qos_admitted = 1;
+	if (nvmf_ctrlr_process_io_cmd(req) == SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE) {
+		_nvmf_request_complete(req);
+	}
+}
+
 static bool
 nvmf_ctrlr_get_dif_ctx(struct spdk_nvmf_ctrlr *ctrlr, struct spdk_nvme_cmd *cmd,
 		       struct spdk_dif_ctx *dif_ctx)
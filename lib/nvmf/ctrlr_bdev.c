@@ -382,6 +382,82 @@ nvmf_bdev_ctrlr_read_cmd(struct spdk_bdev *bdev, struct spdk_bdev_desc *desc,
 	return SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS;
 }
 
+/* Whether a read can be served from or inserted into the namespace read cache */
+static bool
+nvmf_bdev_ctrlr_read_cacheable(struct spdk_bdev *bdev, struct spdk_nvmf_request *req,
+			       uint64_t *start_lba, uint64_t *num_blocks)
+{
+	struct spdk_nvme_cmd *cmd = &req->cmd->nvme_cmd;
+
+	/* Buffers described by a memory domain may not be accessible by the CPU */
+	if (req->memory_domain != NULL || req->accel_sequence != NULL || req->dif_enabled) {
+		return false;
+	}
+
+	if (from_le32(&cmd->cdw12) & SPDK_NVME_IO_FLAGS_FORCE_UNIT_ACCESS) {
+		return false;
+	}
+
+	nvmf_bdev_ctrlr_get_rw_params(cmd, start_lba, num_blocks);
+
+	return nvmf_bdev_ctrlr_lba_in_range(spdk_bdev_get_num_blocks(bdev), *start_lba, *num_blocks) &&
+	       *num_blocks * spdk_bdev_get_block_size(bdev) <= req->length;
+}
+
+static void
+nvmf_bdev_ctrlr_cached_read_complete(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct nvmf_ns_read_cache_fill	*fill = cb_arg;
+	struct spdk_nvmf_request	*req = nvmf_ns_read_cache_fill_get_req(fill);
+
+	nvmf_ns_read_cache_fill_done(fill, success, req->iov, req->iovcnt);
+	nvmf_bdev_ctrlr_complete_cmd(bdev_io, success, req);
+}
+
+int
+nvmf_bdev_ctrlr_cached_read_cmd(struct spdk_bdev *bdev, struct spdk_bdev_desc *desc,
+				struct spdk_io_channel *ch, struct spdk_nvmf_request *req,
+				struct nvmf_ns_read_cache_shard *shard)
+{
+	struct spdk_nvmf_poll_group *group = req->qpair->group;
+	struct spdk_nvme_cpl *rsp = &req->rsp->nvme_cpl;
+	struct nvmf_ns_read_cache_fill *fill;
+	uint64_t start_lba;
+	uint64_t num_blocks;
+	int rc;
+
+	if (!nvmf_bdev_ctrlr_read_cacheable(bdev, req, &start_lba, &num_blocks)) {
+		return nvmf_bdev_ctrlr_read_cmd(bdev, desc, ch, req);
+	}
+
+	if (nvmf_ns_read_cache_read(shard, start_lba, num_blocks, req->iov, req->iovcnt)) {
+		group->stat.read_cache_hits++;
+		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
+	}
+
+	fill = nvmf_ns_read_cache_fill_start(shard, req, start_lba, num_blocks);
+	if (spdk_unlikely(fill == NULL)) {
+		return nvmf_bdev_ctrlr_read_cmd(bdev, desc, ch, req);
+	}
+
+	rc = spdk_bdev_readv_blocks(desc, ch, req->iov, req->iovcnt, start_lba, num_blocks,
+				    nvmf_bdev_ctrlr_cached_read_complete, fill);
+	if (spdk_unlikely(rc)) {
+		nvmf_ns_read_cache_fill_done(fill, false, NULL, 0);
+		if (rc == -ENOMEM) {
+			nvmf_bdev_ctrl_queue_io(req, bdev, ch, nvmf_ctrlr_process_io_cmd_resubmit, req);
+			return SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS;
+		}
+		rsp->status.sct = SPDK_NVME_SCT_GENERIC;
+		rsp->status.sc = SPDK_NVME_SC_INTERNAL_DEVICE_ERROR;
+		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
+	}
+
+	group->stat.read_cache_misses++;
+
+	return SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS;
+}
+
 int
 nvmf_bdev_ctrlr_write_cmd(struct spdk_bdev *bdev, struct spdk_bdev_desc *desc,
 			  struct spdk_io_channel *ch, struct spdk_nvmf_request *req)
@@ -1045,6 +1121,72 @@ nvmf_bdev_ctrlr_zcopy_start(struct spdk_bdev *bdev,
 	return SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS;
 }
 
+static void
+nvmf_bdev_ctrlr_cached_zcopy_start_complete(struct spdk_bdev_io *bdev_io, bool success,
+		void *cb_arg)
+{
+	struct nvmf_ns_read_cache_fill	*fill = cb_arg;
+	struct spdk_nvmf_request	*req = nvmf_ns_read_cache_fill_get_req(fill);
+	struct iovec			*iov = NULL;
+	int				iovcnt = 0;
+
+	if (success) {
+		spdk_bdev_io_get_iovec(bdev_io, &iov, &iovcnt);
+	}
+	nvmf_ns_read_cache_fill_done(fill, success, iov, iovcnt);
+	nvmf_bdev_ctrlr_zcopy_start_complete(bdev_io, success, req);
+}
+
+int
+nvmf_bdev_ctrlr_cached_zcopy_start(struct spdk_bdev *bdev, struct spdk_bdev_desc *desc,
+				   struct spdk_io_channel *ch, struct spdk_nvmf_request *req,
+				   struct nvmf_ns_read_cache_shard *shard)
+{
+	struct spdk_nvmf_poll_group *group = req->qpair->group;
+	struct spdk_nvme_cpl *rsp = &req->rsp->nvme_cpl;
+	struct nvmf_ns_read_cache_fill *fill;
+	uint64_t start_lba;
+	uint64_t num_blocks;
+	int iovcnt, rc;
+
+	if (req->cmd->nvme_cmd.opc != SPDK_NVME_OPC_READ ||
+	    !nvmf_bdev_ctrlr_read_cacheable(bdev, req, &start_lba, &num_blocks)) {
+		return nvmf_bdev_ctrlr_zcopy_start(bdev, desc, ch, req);
+	}
+
+	/* Hand the cached lines to the transport, they're held until zcopy end */
+	iovcnt = nvmf_ns_read_cache_get(shard, start_lba, num_blocks, req->iov, NVMF_REQ_MAX_BUFFERS);
+	if (iovcnt > 0) {
+		req->iovcnt = iovcnt;
+		req->zcopy_bdev_io = NULL;
+		req->zcopy_cached = 1;
+		group->stat.read_cache_hits++;
+		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
+	}
+
+	fill = nvmf_ns_read_cache_fill_start(shard, req, start_lba, num_blocks);
+	if (spdk_unlikely(fill == NULL)) {
+		return nvmf_bdev_ctrlr_zcopy_start(bdev, desc, ch, req);
+	}
+
+	rc = spdk_bdev_zcopy_start(desc, ch, req->iov, req->iovcnt, start_lba, num_blocks, true,
+				   nvmf_bdev_ctrlr_cached_zcopy_start_complete, fill);
+	if (spdk_unlikely(rc != 0)) {
+		nvmf_ns_read_cache_fill_done(fill, false, NULL, 0);
+		if (rc == -ENOMEM) {
+			nvmf_bdev_ctrl_queue_io(req, bdev, ch, nvmf_ctrlr_process_io_cmd_resubmit, req);
+			return SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS;
+		}
+		rsp->status.sct = SPDK_NVME_SCT_GENERIC;
+		rsp->status.sc = SPDK_NVME_SC_INTERNAL_DEVICE_ERROR;
+		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
+	}
+
+	group->stat.read_cache_misses++;
+
+	return SPDK_NVMF_REQUEST_EXEC_STATUS_ASYNCHRONOUS;
+}
+
 static void
 nvmf_bdev_ctrlr_zcopy_end_complete(struct spdk_bdev_io *bdev_io, bool success,
 				   void *cb_arg)
@@ -1070,8 +1212,22 @@ nvmf_bdev_ctrlr_zcopy_end_complete(struct spdk_bdev_io *bdev_io, bool success,
 void
 nvmf_bdev_ctrlr_zcopy_end(struct spdk_nvmf_request *req, bool commit)
 {
+	struct spdk_nvmf_qpair *qpair = req->qpair;
+	struct spdk_nvmf_subsystem_poll_group *sgroup;
+	struct spdk_nvmf_subsystem_pg_ns_info *ns_info;
 	int rc __attribute__((unused));
 
+	if (req->zcopy_cached) {
+		/* The buffers are lines of the read cache */
+		req->zcopy_cached = 0;
+		sgroup = &qpair->group->sgroups[qpair->ctrlr->subsys->id];
+		ns_info = &sgroup->ns_info[req->cmd->nvme_cmd.nsid - 1];
+		assert(ns_info->read_cache_shard != NULL);
+		nvmf_ns_read_cache_put(ns_info->read_cache_shard, req->iov, req->iovcnt);
+		spdk_nvmf_request_complete(req);
+		return;
+	}
+
 	rc = spdk_bdev_zcopy_end(req->zcopy_bdev_io, commit, nvmf_bdev_ctrlr_zcopy_end_complete, req);
 
 	/* The only way spdk_bdev_zcopy_end() can fail is if we pass a bdev_io type that isn't ZCOPY */
@@ -0,0 +1,520 @@
+/*   SPDX-License-Identifier: BSD-3-Clause
+ *   Copyright (C) 2026 agent. All rights reserved.
+ */
+
+/*
+ * Namespace read cache
+ *
+ * The data is cached per poll group: each poll group has its own shard holding the lines
+ * read through it, which is only accessed from the poll group's thread.  The only state
+ * shared between the shards is a table of write sequence numbers, bumped by the commands
+ * modifying the namespace when they start and when they complete.  A line is only valid as
+ * long as the sequence number of its bucket hasn't changed since it was filled.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "nvmf_internal.h"
+
+#include "spdk/bdev.h"
+#include "spdk/endian.h"
+#include "spdk/env.h"
+#include "spdk/likely.h"
+#include "spdk/log.h"
+#include "spdk/nvme_spec.h"
+#include "spdk/util.h"
+
+#define NVMF_NS_READ_CACHE_LINE_SIZE	0x1000
+#define NVMF_NS_READ_CACHE_MIN_LINES	64
+#define NVMF_NS_READ_CACHE_SEQ_BUCKETS	4096
+#define NVMF_NS_READ_CACHE_MAX_FILLS	64
+
+struct nvmf_ns_read_cache {
+	uint64_t				size;
+	uint32_t				block_size;
+	uint32_t				line_size;
+	uint32_t				line_blocks;
+
+	/* Bumped by every modifying command, when it starts and when it completes */
+	uint64_t				gen;
+	/* Bumped by the modifying commands that don't describe a single LBA range */
+	uint64_t				epoch;
+	uint32_t				seq[NVMF_NS_READ_CACHE_SEQ_BUCKETS];
+};
+
+struct nvmf_ns_read_cache_line {
+	uint64_t				line;
+	uint64_t				epoch;
+	uint32_t				seq;
+	uint32_t				ref;
+	bool					valid;
+	void					*buf;
+	struct nvmf_ns_read_cache_line		*hash_next;
+	TAILQ_ENTRY(nvmf_ns_read_cache_line)	lru_link;
+};
+
+struct nvmf_ns_read_cache_fill {
+	struct nvmf_ns_read_cache_shard		*shard;
+	struct spdk_nvmf_request		*req;
+	uint64_t				gen;
+	uint64_t				start_lba;
+	uint64_t				num_blocks;
+	STAILQ_ENTRY(nvmf_ns_read_cache_fill)	link;
+};
+
+struct nvmf_ns_read_cache_shard {
+	struct nvmf_ns_read_cache		*cache;
+	uint32_t				num_lines;
+	uint32_t				hash_mask;
+	void					*buf;
+	struct nvmf_ns_read_cache_line		*lines;
+	struct nvmf_ns_read_cache_line		**hash;
+	/* Unreferenced lines, least recently used first.  Invalid lines are kept at the head. */
+	TAILQ_HEAD(, nvmf_ns_read_cache_line)	lru;
+	struct nvmf_ns_read_cache_fill		fills[NVMF_NS_READ_CACHE_MAX_FILLS];
+	STAILQ_HEAD(, nvmf_ns_read_cache_fill)	free_fills;
+};
+
+struct nvmf_ns_read_cache *
+nvmf_ns_read_cache_create(struct spdk_bdev *bdev, uint32_t size_mb)
+{
+	struct nvmf_ns_read_cache *cache;
+	uint32_t block_size = spdk_bdev_get_block_size(bdev);
+
+	if (spdk_bdev_get_md_size(bdev) != 0) {
+		SPDK_ERRLOG("Read cache is not supported on bdev %s with metadata\n",
+			    spdk_bdev_get_name(bdev));
+		return NULL;
+	}
+
+	cache = calloc(1, sizeof(*cache));
+	if (cache == NULL) {
+		SPDK_ERRLOG("Read cache allocation failed\n");
+		return NULL;
+	}
+
+	cache->size = (uint64_t)size_mb * 1024 * 1024;
+	cache->block_size = block_size;
+	cache->line_size = spdk_max(block_size, NVMF_NS_READ_CACHE_LINE_SIZE);
+	if (cache->line_size % block_size != 0) {
+		SPDK_ERRLOG("Read cache is not supported on bdev %s with block size %u\n",
+			    spdk_bdev_get_name(bdev), block_size);
+		free(cache);
+		return NULL;
+	}
+	cache->line_blocks = cache->line_size / block_size;
+
+	return cache;
+}
+
+void
+nvmf_ns_read_cache_destroy(struct nvmf_ns_read_cache *cache)
+{
+	free(cache);
+}
+
+static inline uint32_t *
+nvmf_ns_read_cache_seq(struct nvmf_ns_read_cache *cache, uint64_t line)
+{
+	return &cache->seq[line % NVMF_NS_READ_CACHE_SEQ_BUCKETS];
+}
+
+bool
+nvmf_ns_read_cache_cmd_modifies(const struct spdk_nvme_cmd *cmd)
+{
+	switch (cmd->opc) {
+	case SPDK_NVME_OPC_READ:
+	case SPDK_NVME_OPC_FLUSH:
+	case SPDK_NVME_OPC_COMPARE:
+	case SPDK_NVME_OPC_RESERVATION_REGISTER:
+	case SPDK_NVME_OPC_RESERVATION_REPORT:
+	case SPDK_NVME_OPC_RESERVATION_ACQUIRE:
+	case SPDK_NVME_OPC_RESERVATION_RELEASE:
+		return false;
+	default:
+		/* Includes passthru commands we know nothing about */
+		return true;
+	}
+}
+
+void
+nvmf_ns_read_cache_invalidate(struct nvmf_ns_read_cache *cache, const struct spdk_nvme_cmd *cmd)
+{
+	uint64_t start_lba, num_blocks, first, last, line;
+
+	/* Bump gen before the sequence numbers.  A fill that sees any of the new sequence
+	 * numbers is then guaranteed to also see the new gen, see nvmf_ns_read_cache_fill_done() */
+	__atomic_fetch_add(&cache->gen, 1, __ATOMIC_RELEASE);
+
+	switch (cmd->opc) {
+	case SPDK_NVME_OPC_WRITE:
+	case SPDK_NVME_OPC_WRITE_ZEROES:
+	case SPDK_NVME_OPC_WRITE_UNCORRECTABLE:
+		start_lba = from_le64(&cmd->cdw10);
+		num_blocks = (from_le32(&cmd->cdw12) & 0xFFFFu) + 1;
+		first = start_lba / cache->line_blocks;
+		last = (start_lba + num_blocks - 1) / cache->line_blocks;
+		if (spdk_likely(last >= first && last - first < NVMF_NS_READ_CACHE_SEQ_BUCKETS)) {
+			for (line = first; line <= last; line++) {
+				__atomic_fetch_add(nvmf_ns_read_cache_seq(cache, line), 1, __ATOMIC_RELEASE);
+			}
+			break;
+		}
+	/* fallthrough */
+	default:
+		__atomic_fetch_add(&cache->epoch, 1, __ATOMIC_RELEASE);
+		break;
+	}
+}
+
+struct nvmf_ns_read_cache_shard *
+nvmf_ns_read_cache_shard_create(struct nvmf_ns_read_cache *cache, uint32_t num_shards)
+{
+	struct nvmf_ns_read_cache_shard *shard;
+	struct nvmf_ns_read_cache_line *line;
+	uint64_t num_lines;
+	uint32_t i;
+
+	shard = calloc(1, sizeof(*shard));
+	if (shard == NULL) {
+		return NULL;
+	}
+
+	num_lines = cache->size / spdk_max(num_shards, 1) / cache->line_size;
+	num_lines = spdk_max(num_lines, NVMF_NS_READ_CACHE_MIN_LINES);
+	num_lines = spdk_min(num_lines, UINT32_MAX / 2);
+
+	shard->cache = cache;
+	shard->num_lines = num_lines;
+	shard->hash_mask = spdk_align32pow2(shard->num_lines) - 1;
+	shard->buf = spdk_zmalloc(num_lines * cache->line_size, NVMF_NS_READ_CACHE_LINE_SIZE, NULL,
+				  SPDK_ENV_NUMA_ID_ANY, SPDK_MALLOC_DMA);
+	shard->lines = calloc(shard->num_lines, sizeof(*shard->lines));
+	shard->hash = calloc(shard->hash_mask + 1, sizeof(*shard->hash));
+	if (shard->buf == NULL || shard->lines == NULL || shard->hash == NULL) {
+		SPDK_ERRLOG("Unable to allocate %" PRIu64 " read cache lines\n", num_lines);
+		nvmf_ns_read_cache_shard_destroy(shard);
+		return NULL;
+	}
+
+	TAILQ_INIT(&shard->lru);
+	for (i = 0; i < shard->num_lines; i++) {
+		line = &shard->lines[i];
+		line->buf = (uint8_t *)shard->buf + (uint64_t)i * cache->line_size;
+		TAILQ_INSERT_TAIL(&shard->lru, line, lru_link);
+	}
+
+	STAILQ_INIT(&shard->free_fills);
+	for (i = 0; i < NVMF_NS_READ_CACHE_MAX_FILLS; i++) {
+		shard->fills[i].shard = shard;
+		STAILQ_INSERT_TAIL(&shard->free_fills, &shard->fills[i], link);
+	}
+
+	return shard;
+}
+
+void
+nvmf_ns_read_cache_shard_destroy(struct nvmf_ns_read_cache_shard *shard)
+{
+	if (shard == NULL) {
+		return;
+	}
+
+	spdk_free(shard->buf);
+	free(shard->lines);
+	free(shard->hash);
+	free(shard);
+}
+
+static void
+nvmf_ns_read_cache_unhash(struct nvmf_ns_read_cache_shard *shard,
+			  struct nvmf_ns_read_cache_line *line)
+{
+	struct nvmf_ns_read_cache_line **prev;
+
+	assert(line->valid);
+	prev = &shard->hash[line->line & shard->hash_mask];
+	while (*prev != line) {
+		assert(*prev != NULL);
+		prev = &(*prev)->hash_next;
+	}
+	*prev = line->hash_next;
+	line->hash_next = NULL;
+	line->valid = false;
+}
+
+/* Find a valid line, dropping it if it was invalidated */
+static struct nvmf_ns_read_cache_line *
+nvmf_ns_read_cache_lookup(struct nvmf_ns_read_cache_shard *shard, uint64_t index)
+{
+	struct nvmf_ns_read_cache *cache = shard->cache;
+	struct nvmf_ns_read_cache_line *line;
+	uint64_t epoch;
+	uint32_t seq;
+
+	for (line = shard->hash[index & shard->hash_mask]; line != NULL; line = line->hash_next) {
+		if (line->line == index) {
+			break;
+		}
+	}
+
+	if (line == NULL) {
+		return NULL;
+	}
+
+	seq = __atomic_load_n(nvmf_ns_read_cache_seq(cache, index), __ATOMIC_ACQUIRE);
+	epoch = __atomic_load_n(&cache->epoch, __ATOMIC_ACQUIRE);
+	if (spdk_unlikely(line->seq != seq || line->epoch != epoch)) {
+		nvmf_ns_read_cache_unhash(shard, line);
+		if (line->ref == 0) {
+			TAILQ_REMOVE(&shard->lru, line, lru_link);
+			TAILQ_INSERT_HEAD(&shard->lru, line, lru_link);
+		}
+		return NULL;
+	}
+
+	return line;
+}
+
+static void
+nvmf_ns_read_cache_touch(struct nvmf_ns_read_cache_shard *shard,
+			 struct nvmf_ns_read_cache_line *line)
+{
+	if (line->ref == 0) {
+		TAILQ_REMOVE(&shard->lru, line, lru_link);
+		TAILQ_INSERT_TAIL(&shard->lru, line, lru_link);
+	}
+}
+
+static inline void
+nvmf_ns_read_cache_range(struct nvmf_ns_read_cache *cache, uint64_t start_lba, uint64_t num_blocks,
+			 uint64_t *first, uint64_t *last)
+{
+	*first = start_lba / cache->line_blocks;
+	*last = (start_lba + num_blocks - 1) / cache->line_blocks;
+}
+
+bool
+nvmf_ns_read_cache_read(struct nvmf_ns_read_cache_shard *shard, uint64_t start_lba,
+			uint64_t num_blocks, struct iovec *iovs, int iovcnt)
+{
+	struct nvmf_ns_read_cache *cache = shard->cache;
+	struct nvmf_ns_read_cache_line *line;
+	struct spdk_iov_xfer ix;
+	uint64_t first, last, index, offset, len, remaining;
+
+	nvmf_ns_read_cache_range(cache, start_lba, num_blocks, &first, &last);
+	for (index = first; index <= last; index++) {
+		if (nvmf_ns_read_cache_lookup(shard, index) == NULL) {
+			return false;
+		}
+	}
+
+	spdk_iov_xfer_init(&ix, iovs, iovcnt);
+	offset = (start_lba % cache->line_blocks) * cache->block_size;
+	remaining = num_blocks * cache->block_size;
+	for (index = first; index <= last; index++) {
+		line = nvmf_ns_read_cache_lookup(shard, index);
+		assert(line != NULL);
+		len = spdk_min(cache->line_size - offset, remaining);
+		spdk_iov_xfer_from_buf(&ix, (uint8_t *)line->buf + offset, len);
+		nvmf_ns_read_cache_touch(shard, line);
+		remaining -= len;
+		offset = 0;
+	}
+
+	return true;
+}
+
+int
+nvmf_ns_read_cache_get(struct nvmf_ns_read_cache_shard *shard, uint64_t start_lba,
+		       uint64_t num_blocks, struct iovec *iovs, int iovcnt)
+{
+	struct nvmf_ns_read_cache *cache = shard->cache;
+	struct nvmf_ns_read_cache_line *line;
+	uint64_t first, last, index, offset, remaining;
+	int i = 0;
+
+	nvmf_ns_read_cache_range(cache, start_lba, num_blocks, &first, &last);
+	if (last - first >= (uint64_t)iovcnt) {
+		return 0;
+	}
+
+	for (index = first; index <= last; index++) {
+		if (nvmf_ns_read_cache_lookup(shard, index) == NULL) {
+			return 0;
+		}
+	}
+
+	offset = (start_lba % cache->line_blocks) * cache->block_size;
+	remaining = num_blocks * cache->block_size;
+	for (index = first; index <= last; index++, i++) {
+		line = nvmf_ns_read_cache_lookup(shard, index);
+		assert(line != NULL);
+		iovs[i].iov_base = (uint8_t *)line->buf + offset;
+		iovs[i].iov_len = spdk_min(cache->line_size - offset, remaining);
+		if (line->ref++ == 0) {
+			TAILQ_REMOVE(&shard->lru, line, lru_link);
+		}
+		remaining -= iovs[i].iov_len;
+		offset = 0;
+	}
+
+	return i;
+}
+
+void
+nvmf_ns_read_cache_put(struct nvmf_ns_read_cache_shard *shard, struct iovec *iovs, int iovcnt)
+{
+	struct nvmf_ns_read_cache_line *line;
+	uintptr_t offset;
+	int i;
+
+	for (i = 0; i < iovcnt; i++) {
+		offset = (uintptr_t)iovs[i].iov_base - (uintptr_t)shard->buf;
+		line = &shard->lines[offset / shard->cache->line_size];
+		assert(line->ref > 0);
+		if (--line->ref == 0) {
+			if (line->valid) {
+				TAILQ_INSERT_TAIL(&shard->lru, line, lru_link);
+			} else {
+				TAILQ_INSERT_HEAD(&shard->lru, line, lru_link);
+			}
+		}
+	}
+}
+
+struct nvmf_ns_read_cache_fill *
+nvmf_ns_read_cache_fill_start(struct nvmf_ns_read_cache_shard *shard, struct spdk_nvmf_request *req,
+			      uint64_t start_lba, uint64_t num_blocks)
+{
+	struct nvmf_ns_read_cache_fill *fill;
+
+	fill = STAILQ_FIRST(&shard->free_fills);
+	if (spdk_unlikely(fill == NULL)) {
+		return NULL;
+	}
+	STAILQ_REMOVE_HEAD(&shard->free_fills, link);
+
+	fill->req = req;
+	fill->start_lba = start_lba;
+	fill->num_blocks = num_blocks;
+	fill->gen = __atomic_load_n(&shard->cache->gen, __ATOMIC_ACQUIRE);
+
+	return fill;
+}
+
+struct spdk_nvmf_request *
+nvmf_ns_read_cache_fill_get_req(struct nvmf_ns_read_cache_fill *fill)
+{
+	return fill->req;
+}
+
+static void
+nvmf_ns_read_cache_xfer_skip(struct spdk_iov_xfer *ix, size_t len)
+{
+	size_t n;
+
+	while (len > 0 && ix->cur_iov_idx < ix->iovcnt) {
+		n = spdk_min(len, ix->iovs[ix->cur_iov_idx].iov_len - ix->cur_iov_offset);
+		ix->cur_iov_offset += n;
+		len -= n;
+		if (ix->cur_iov_offset == ix->iovs[ix->cur_iov_idx].iov_len) {
+			ix->cur_iov_idx++;
+			ix->cur_iov_offset = 0;
+		}
+	}
+}
+
+/* Drop the lines of a fill that turned out to race with a modifying command */
+static void
+nvmf_ns_read_cache_fill_abort(struct nvmf_ns_read_cache_shard *shard, uint64_t first, uint64_t last)
+{
+	struct nvmf_ns_read_cache_line *line;
+	uint64_t index;
+
+	for (index = first; index < last; index++) {
+		for (line = shard->hash[index & shard->hash_mask]; line != NULL; line = line->hash_next) {
+			if (line->line == index) {
+				break;
+			}
+		}
+		if (line == NULL) {
+			continue;
+		}
+
+		nvmf_ns_read_cache_unhash(shard, line);
+		if (line->ref == 0) {
+			TAILQ_REMOVE(&shard->lru, line, lru_link);
+			TAILQ_INSERT_HEAD(&shard->lru, line, lru_link);
+		}
+	}
+}
+
+/*
+ * Insert the lines fully covered by a read into the cache.  Nothing is inserted if the
+ * namespace was modified while the read was outstanding, as the data might be stale.
+ */
+void
+nvmf_ns_read_cache_fill_done(struct nvmf_ns_read_cache_fill *fill, bool success,
+			     struct iovec *iovs, int iovcnt)
+{
+	struct nvmf_ns_read_cache_shard *shard = fill->shard;
+	struct nvmf_ns_read_cache *cache = shard->cache;
+	struct nvmf_ns_read_cache_line *line;
+	struct spdk_iov_xfer ix;
+	uint64_t first, last, index, epoch;
+
+	STAILQ_INSERT_HEAD(&shard->free_fills, fill, link);
+
+	if (spdk_unlikely(!success) ||
+	    fill->gen != __atomic_load_n(&cache->gen, __ATOMIC_ACQUIRE)) {
+		return;
+	}
+
+	first = spdk_divide_round_up(fill->start_lba, cache->line_blocks);
+	last = (fill->start_lba + fill->num_blocks) / cache->line_blocks;
+	if (first >= last) {
+		return;
+	}
+
+	epoch = __atomic_load_n(&cache->epoch, __ATOMIC_ACQUIRE);
+	spdk_iov_xfer_init(&ix, iovs, iovcnt);
+	nvmf_ns_read_cache_xfer_skip(&ix, (first * cache->line_blocks - fill->start_lba) *
+				     cache->block_size);
+	for (index = first; index < last; index++) {
+		line = nvmf_ns_read_cache_lookup(shard, index);
+		if (line != NULL) {
+			nvmf_ns_read_cache_touch(shard, line);
+			nvmf_ns_read_cache_xfer_skip(&ix, cache->line_size);
+			continue;
+		}
+
+		line = TAILQ_FIRST(&shard->lru);
+		if (spdk_unlikely(line == NULL)) {
+			/* All lines are held by zero-copy requests */
+			last = index;
+			break;
+		}
+		if (line->valid) {
+			nvmf_ns_read_cache_unhash(shard, line);
+		}
+
+		spdk_iov_xfer_to_buf(&ix, line->buf, cache->line_size);
+		line->line = index;
+		line->seq = __atomic_load_n(nvmf_ns_read_cache_seq(cache, index), __ATOMIC_ACQUIRE);
+		line->epoch = epoch;
+		line->valid = true;
+		line->hash_next = shard->hash[index & shard->hash_mask];
+		shard->hash[index & shard->hash_mask] = line;
+		TAILQ_REMOVE(&shard->lru, line, lru_link);
+		TAILQ_INSERT_TAIL(&shard->lru, line, lru_link);
+	}
+
+	/* A modifying command may have started or completed while the lines were filled.  If
+	 * any of them was tagged with a sequence number bumped by it, gen has changed too, as
+	 * it's bumped first, so the lines can't be trusted. */
+	if (spdk_unlikely(fill->gen != __atomic_load_n(&cache->gen, __ATOMIC_ACQUIRE))) {
+		nvmf_ns_read_cache_fill_abort(shard, first, last);
+	}
+}
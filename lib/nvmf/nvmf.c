@@ -21,6 +21,11 @@
 SPDK_LOG_REGISTER_COMPONENT(nvmf)
 
 #define SPDK_NVMF_DEFAULT_MAX_SUBSYSTEMS 1024
+#define SPDK_NVMF_DEFAULT_REBALANCE_THRESHOLD 50
+
+/* Bytes per second are converted into 4KiB operations when computing the load score,
+ * so that a poll group serving large I/Os isn't mistaken for an idle one. */
+#define NVMF_LOAD_BYTES_PER_OP 4096
 
 static TAILQ_HEAD(, spdk_nvmf_tgt) g_nvmf_tgts = TAILQ_HEAD_INITIALIZER(g_nvmf_tgts);
 
@@ -45,6 +50,14 @@ struct nvmf_qpair_disconnect_many_ctx {
 	void *cpl_ctx;
 };
 
+/* Moves a qpair, or the first eligible qpair of src, between two poll groups */
+struct nvmf_qpair_migrate_ctx {
+	struct spdk_nvmf_tgt *tgt;
+	struct spdk_nvmf_qpair *qpair;
+	struct spdk_nvmf_poll_group *src;
+	struct spdk_nvmf_poll_group *dst;
+};
+
 static struct spdk_nvmf_referral *
 nvmf_tgt_find_referral(struct spdk_nvmf_tgt *tgt,
 		       const struct spdk_nvme_transport_id *trid)
@@ -190,14 +203,19 @@ nvmf_tgt_cleanup_poll_group(struct spdk_nvmf_poll_group *group)
 				spdk_put_io_channel(sgroup->ns_info[nsid].channel);
 				sgroup->ns_info[nsid].channel = NULL;
 			}
+			nvmf_ns_read_cache_shard_destroy(sgroup->ns_info[nsid].read_cache_shard);
 		}
 
+		nvmf_poll_group_qos_destroy(sgroup);
+		nvmf_poll_group_telemetry_destroy(sgroup);
 		free(sgroup->ns_info);
 	}
 
 	free(group->sgroups);
 
 	spdk_poller_unregister(&group->poller);
+	spdk_poller_unregister(&group->load_poller);
+	spdk_poller_unregister(&group->qos_poller);
 
 	if (group->destroy_cb_fn) {
 		group->destroy_cb_fn(group->destroy_cb_arg, 0);
@@ -249,6 +267,47 @@ nvmf_poll_group_add_transport(struct spdk_nvmf_poll_group *group,
 	return 0;
 }
 
+static int
+nvmf_poll_group_sample_load(void *ctx)
+{
+	struct spdk_nvmf_poll_group *group = ctx;
+	struct spdk_nvmf_qpair *qpair;
+	uint64_t now, elapsed_us, ios, bytes, queue_depth = 0, load;
+
+	now = spdk_get_ticks();
+	elapsed_us = (now - group->load_last_tsc) * SPDK_SEC_TO_USEC / spdk_get_ticks_hz();
+	if (elapsed_us == 0) {
+		return SPDK_POLLER_IDLE;
+	}
+
+	ios = group->stat.completed_nvme_io - group->load_last_io;
+	bytes = group->stat.completed_nvme_io_bytes - group->load_last_bytes;
+	group->load_last_tsc = now;
+	group->load_last_io = group->stat.completed_nvme_io;
+	group->load_last_bytes = group->stat.completed_nvme_io_bytes;
+
+	group->load_iops = ios * SPDK_SEC_TO_USEC / elapsed_us;
+	group->load_bytes_per_sec = bytes * SPDK_SEC_TO_USEC / elapsed_us;
+
+	/* Little's law: the average latency is the number of I/Os in flight divided by the rate
+	 * at which they complete. */
+	TAILQ_FOREACH(qpair, &group->qpairs, link) {
+		queue_depth += qpair->queue_depth;
+	}
+	group->load_latency_us = group->load_iops ?
+				 queue_depth * SPDK_SEC_TO_USEC / group->load_iops : 0;
+
+	load = group->load_iops + group->load_bytes_per_sec / NVMF_LOAD_BYTES_PER_OP;
+
+	pthread_mutex_lock(&group->mutex);
+	/* Average with the previous sample to dampen short bursts */
+	group->load = (group->load + load) / 2;
+	group->load_io_qpairs = group->stat.current_io_qpairs;
+	pthread_mutex_unlock(&group->mutex);
+
+	return SPDK_POLLER_BUSY;
+}
+
 static int
 nvmf_tgt_create_poll_group(void *io_device, void *ctx_buf)
 {
@@ -269,6 +328,12 @@ nvmf_tgt_create_poll_group(void *io_device, void *ctx_buf)
 	group->poller = SPDK_POLLER_REGISTER(nvmf_poll_group_poll, group, 0);
 	spdk_poller_register_interrupt(group->poller, NULL, NULL);
 
+	if (tgt->load_sample_period_us != 0) {
+		group->load_last_tsc = spdk_get_ticks();
+		group->load_poller = SPDK_POLLER_REGISTER(nvmf_poll_group_sample_load, group,
+				     tgt->load_sample_period_us);
+	}
+
 	SPDK_DTRACE_PROBE1_TICKS(nvmf_create_poll_group, spdk_thread_get_id(thread));
 
 	TAILQ_FOREACH(transport, &tgt->transports, link) {
@@ -288,6 +353,8 @@ nvmf_tgt_create_poll_group(void *io_device, void *ctx_buf)
 
 	for (i = 0; i < tgt->max_subsystems; i++) {
 		TAILQ_INIT(&group->sgroups[i].queued);
+		TAILQ_INIT(&group->sgroups[i].qos_rules);
+		TAILQ_INIT(&group->sgroups[i].telemetry_hosts);
 	}
 
 	for (subsystem = spdk_nvmf_subsystem_get_first(tgt);
@@ -314,6 +381,7 @@ _nvmf_tgt_disconnect_qpairs(void *ctx)
 	struct nvmf_qpair_disconnect_many_ctx *qpair_ctx = ctx;
 	struct spdk_nvmf_poll_group *group = qpair_ctx->group;
 	struct spdk_io_channel *ch;
+	uint32_t migrating_in;
 	int rc;
 
 	TAILQ_FOREACH_SAFE(qpair, &group->qpairs, link, qpair_tmp) {
@@ -323,7 +391,12 @@ _nvmf_tgt_disconnect_qpairs(void *ctx)
 		}
 	}
 
-	if (TAILQ_EMPTY(&group->qpairs)) {
+	/* Qpairs moved here by the rebalancer still reference the poll group */
+	pthread_mutex_lock(&group->mutex);
+	migrating_in = group->migrating_in_qpairs;
+	pthread_mutex_unlock(&group->mutex);
+
+	if (TAILQ_EMPTY(&group->qpairs) && migrating_in == 0) {
 		/* When the refcount from the channels reaches 0, nvmf_tgt_destroy_poll_group will be called. */
 		ch = spdk_io_channel_from_ctx(group);
 		spdk_put_io_channel(ch);
@@ -342,6 +415,10 @@ nvmf_tgt_destroy_poll_group_qpairs(struct spdk_nvmf_poll_group *group)
 
 	SPDK_DTRACE_PROBE1_TICKS(nvmf_destroy_poll_group_qpairs, spdk_thread_get_id(group->thread));
 
+	pthread_mutex_lock(&group->mutex);
+	group->destroying = true;
+	pthread_mutex_unlock(&group->mutex);
+
 	ctx = calloc(1, sizeof(struct nvmf_qpair_disconnect_many_ctx));
 	if (!ctx) {
 		SPDK_ERRLOG("Failed to allocate memory for destroy poll group ctx\n");
@@ -352,6 +429,120 @@ nvmf_tgt_destroy_poll_group_qpairs(struct spdk_nvmf_poll_group *group)
 	_nvmf_tgt_disconnect_qpairs(ctx);
 }
 
+static bool
+nvmf_tgt_has_poll_group(struct spdk_nvmf_tgt *tgt, struct spdk_nvmf_poll_group *group)
+{
+	struct spdk_nvmf_poll_group *tmp;
+
+	TAILQ_FOREACH(tmp, &tgt->poll_groups, link) {
+		if (tmp == group) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void
+_nvmf_poll_group_rebalance(void *_ctx)
+{
+	struct nvmf_qpair_migrate_ctx *ctx = _ctx;
+	struct spdk_nvmf_tgt *tgt = ctx->tgt;
+	struct spdk_nvmf_poll_group *group = ctx->src;
+	struct spdk_nvmf_qpair *qpair, *tmp;
+
+	/* Either poll group may have been destroyed since the target picked them.  The
+	 * target's mutex keeps them from being freed while the qpair is handed over. */
+	pthread_mutex_lock(&tgt->mutex);
+	if (!nvmf_tgt_has_poll_group(tgt, group) || !nvmf_tgt_has_poll_group(tgt, ctx->dst) ||
+	    group->thread != spdk_get_thread()) {
+		pthread_mutex_unlock(&tgt->mutex);
+		free(ctx);
+		return;
+	}
+
+	/* Move the first io qpair that is idle at the moment.  Qpairs with I/O in flight can't
+	 * be quiesced without stalling the host, so they're left for the next round. */
+	TAILQ_FOREACH_SAFE(qpair, &group->qpairs, link, tmp) {
+		if (nvmf_poll_group_migrate_qpair(qpair, ctx->dst) == 0) {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&tgt->mutex);
+
+	free(ctx);
+}
+
+static int
+nvmf_tgt_rebalance(void *ctx)
+{
+	struct spdk_nvmf_tgt *tgt = ctx;
+	struct spdk_nvmf_poll_group *group, *busiest = NULL, *idlest = NULL;
+	struct nvmf_qpair_migrate_ctx *migrate_ctx;
+	uint64_t load, busiest_load = 0, idlest_load = UINT64_MAX, avg;
+	uint32_t io_qpairs, busiest_qpairs = 0;
+
+	if (tgt->state != NVMF_TGT_RUNNING) {
+		return SPDK_POLLER_IDLE;
+	}
+
+	pthread_mutex_lock(&tgt->mutex);
+	TAILQ_FOREACH(group, &tgt->poll_groups, link) {
+		pthread_mutex_lock(&group->mutex);
+		load = group->load;
+		io_qpairs = group->load_io_qpairs;
+		pthread_mutex_unlock(&group->mutex);
+
+		if (busiest == NULL || load > busiest_load) {
+			busiest = group;
+			busiest_load = load;
+			busiest_qpairs = io_qpairs;
+		}
+		if (idlest == NULL || load < idlest_load) {
+			idlest = group;
+			idlest_load = load;
+		}
+	}
+
+	if (busiest == idlest || busiest_qpairs < 2 ||
+	    busiest_load * 100 <= idlest_load * (100 + tgt->rebalance_threshold)) {
+		pthread_mutex_unlock(&tgt->mutex);
+		return SPDK_POLLER_IDLE;
+	}
+
+	/* Don't move a qpair if that would just swap which of the two poll groups is the busy one */
+	avg = busiest_load / busiest_qpairs;
+	if (idlest_load + avg > busiest_load - avg) {
+		pthread_mutex_unlock(&tgt->mutex);
+		return SPDK_POLLER_IDLE;
+	}
+
+	migrate_ctx = calloc(1, sizeof(*migrate_ctx));
+	if (!migrate_ctx) {
+		pthread_mutex_unlock(&tgt->mutex);
+		return SPDK_POLLER_IDLE;
+	}
+
+	/* Account for the move right away so that the next round, which may run before the poll
+	 * groups are sampled again, doesn't pick the same pair of poll groups. */
+	pthread_mutex_lock(&busiest->mutex);
+	busiest->load -= spdk_min(avg, busiest->load);
+	pthread_mutex_unlock(&busiest->mutex);
+	pthread_mutex_lock(&idlest->mutex);
+	idlest->load += avg;
+	pthread_mutex_unlock(&idlest->mutex);
+
+	migrate_ctx->tgt = tgt;
+	migrate_ctx->src = busiest;
+	migrate_ctx->dst = idlest;
+	if (spdk_thread_send_msg(busiest->thread, _nvmf_poll_group_rebalance, migrate_ctx) != 0) {
+		free(migrate_ctx);
+	}
+	pthread_mutex_unlock(&tgt->mutex);
+
+	return SPDK_POLLER_BUSY;
+}
+
 struct spdk_nvmf_tgt *
 spdk_nvmf_tgt_create(struct spdk_nvmf_target_opts *_opts)
 {
@@ -394,6 +585,15 @@ spdk_nvmf_tgt_create(struct spdk_nvmf_target_opts *_opts)
 	tgt->discovery_genctr = 0;
 	tgt->dhchap_digests = opts.dhchap_digests;
 	tgt->dhchap_dhgroups = opts.dhchap_dhgroups;
+	tgt->load_sample_period_us = opts.load_sample_period_us;
+	tgt->rebalance_period_us = opts.rebalance_period_us;
+	/* 0 is a valid threshold, so the default only applies to callers that predate the field */
+	if (offsetof(struct spdk_nvmf_target_opts, rebalance_threshold) +
+	    sizeof(opts.rebalance_threshold) <= _opts->size) {
+		tgt->rebalance_threshold = opts.rebalance_threshold;
+	} else {
+		tgt->rebalance_threshold = SPDK_NVMF_DEFAULT_REBALANCE_THRESHOLD;
+	}
 	TAILQ_INIT(&tgt->transports);
 	TAILQ_INIT(&tgt->poll_groups);
 	TAILQ_INIT(&tgt->referrals);
@@ -417,6 +617,12 @@ spdk_nvmf_tgt_create(struct spdk_nvmf_target_opts *_opts)
 
 	tgt->state = NVMF_TGT_RUNNING;
 
+	/* The rebalancer relies on the load computed by the poll groups */
+	if (tgt->rebalance_period_us != 0 && tgt->load_sample_period_us != 0) {
+		tgt->rebalance_poller = SPDK_POLLER_REGISTER(nvmf_tgt_rebalance, tgt,
+					tgt->rebalance_period_us);
+	}
+
 	TAILQ_INSERT_HEAD(&g_nvmf_tgts, tgt, link);
 
 	return tgt;
@@ -495,6 +701,8 @@ spdk_nvmf_tgt_destroy(struct spdk_nvmf_tgt *tgt,
 	tgt->destroy_cb_fn = cb_fn;
 	tgt->destroy_cb_arg = cb_arg;
 
+	spdk_poller_unregister(&tgt->rebalance_poller);
+
 	TAILQ_REMOVE(&g_nvmf_tgts, tgt, link);
 
 	spdk_io_device_unregister(tgt, nvmf_tgt_destroy_cb);
@@ -659,6 +867,10 @@ nvmf_write_nvme_subsystem_config(struct spdk_json_write_ctx *w,
 
 		spdk_json_write_named_bool(w, "no_auto_visible", !ns->always_visible);
 
+		if (ns_opts.read_cache_size_mb != 0) {
+			spdk_json_write_named_uint32(w, "read_cache_size_mb", ns_opts.read_cache_size_mb);
+		}
+
 		/*     "namespace" */
 		spdk_json_write_object_end(w);
 
@@ -679,6 +891,9 @@ nvmf_write_nvme_subsystem_config(struct spdk_json_write_ctx *w,
 			spdk_json_write_object_end(w);
 		}
 	}
+
+	nvmf_subsystem_qos_write_config_json(subsystem, w);
+	nvmf_subsystem_telemetry_write_config_json(subsystem, w);
 }
 
 static void
@@ -1150,13 +1365,50 @@ _nvmf_poll_group_add(void *_ctx)
 	}
 }
 
+static struct spdk_nvmf_poll_group *
+nvmf_tgt_get_least_loaded_poll_group(struct spdk_nvmf_tgt *tgt)
+{
+	struct spdk_nvmf_poll_group *group, *best = NULL;
+	uint64_t load, best_load = 0;
+	uint32_t qpairs, best_qpairs = 0;
+
+	pthread_mutex_lock(&tgt->mutex);
+	TAILQ_FOREACH(group, &tgt->poll_groups, link) {
+		pthread_mutex_lock(&group->mutex);
+		load = group->load;
+		qpairs = group->load_io_qpairs + group->current_unassociated_qpairs;
+		pthread_mutex_unlock(&group->mutex);
+
+		if (best == NULL || load < best_load || (load == best_load && qpairs < best_qpairs)) {
+			best = group;
+			best_load = load;
+			best_qpairs = qpairs;
+		}
+	}
+
+	if (best != NULL) {
+		/* Charge the poll group with the load of an average qpair until the next sample,
+		 * so that a burst of connections gets spread across poll groups. */
+		pthread_mutex_lock(&best->mutex);
+		best->load += spdk_max(best->load / spdk_max(best->load_io_qpairs, 1), 1);
+		pthread_mutex_unlock(&best->mutex);
+	}
+	pthread_mutex_unlock(&tgt->mutex);
+
+	return best;
+}
+
 void
 spdk_nvmf_tgt_new_qpair(struct spdk_nvmf_tgt *tgt, struct spdk_nvmf_qpair *qpair)
 {
 	struct spdk_nvmf_poll_group *group;
 	struct nvmf_new_qpair_ctx *ctx;
 
-	group = spdk_nvmf_get_optimal_poll_group(qpair);
+	if (tgt->load_sample_period_us != 0) {
+		group = nvmf_tgt_get_least_loaded_poll_group(tgt);
+	} else {
+		group = spdk_nvmf_get_optimal_poll_group(qpair);
+	}
 	if (group == NULL) {
 		if (tgt->next_poll_group == NULL) {
 			tgt->next_poll_group = TAILQ_FIRST(&tgt->poll_groups);
@@ -1225,6 +1477,10 @@ spdk_nvmf_poll_group_add(struct spdk_nvmf_poll_group *group,
 	qpair->group = group;
 	qpair->ctrlr = NULL;
 	qpair->disconnect_started = false;
+	qpair->migrating = false;
+	qpair->disconnect_deferred = false;
+	qpair->telemetry_host = NULL;
+	qpair->telemetry_gen = 0;
 
 	tgroup = nvmf_get_transport_poll_group(group, qpair->transport);
 	if (tgroup == NULL) {
@@ -1243,6 +1499,128 @@ spdk_nvmf_poll_group_add(struct spdk_nvmf_poll_group *group,
 	return rc;
 }
 
+static void
+_nvmf_poll_group_migrate_in(void *_ctx)
+{
+	struct nvmf_qpair_migrate_ctx *ctx = _ctx;
+	struct spdk_nvmf_qpair *qpair = ctx->qpair;
+	struct spdk_nvmf_poll_group *group = ctx->dst;
+	struct spdk_nvmf_transport_poll_group *tgroup;
+	struct spdk_nvmf_ctrlr *ctrlr = qpair->ctrlr;
+	bool destroying;
+	int rc = -EINVAL;
+
+	free(ctx);
+
+	pthread_mutex_lock(&group->mutex);
+	assert(group->migrating_in_qpairs > 0);
+	group->migrating_in_qpairs--;
+	destroying = group->destroying;
+	pthread_mutex_unlock(&group->mutex);
+
+	assert(qpair->group == group);
+	TAILQ_INSERT_TAIL(&group->qpairs, qpair, link);
+	group->stat.current_io_qpairs++;
+	group->stat.migrated_in_qpairs++;
+	qpair->migrating = false;
+
+	tgroup = nvmf_get_transport_poll_group(group, qpair->transport);
+	if (tgroup != NULL) {
+		rc = nvmf_transport_poll_group_migrate_in(tgroup, qpair);
+	}
+
+	if (rc != 0) {
+		SPDK_ERRLOG("Unable to move qpair %p (qid %u) to poll group %p: %d\n",
+			    qpair, qpair->qid, group, rc);
+		qpair->disconnect_deferred = false;
+		spdk_nvmf_qpair_disconnect(qpair);
+		return;
+	}
+
+	/* The controller might have swept its io qpairs while this one was in flight, or the
+	 * poll group started tearing down its qpairs */
+	if (qpair->disconnect_deferred || ctrlr->in_destruct || ctrlr->disconnect_in_progress ||
+	    destroying) {
+		qpair->disconnect_deferred = false;
+		spdk_nvmf_qpair_disconnect(qpair);
+	}
+}
+
+int
+nvmf_poll_group_migrate_qpair(struct spdk_nvmf_qpair *qpair, struct spdk_nvmf_poll_group *dst)
+{
+	struct spdk_nvmf_poll_group *src = qpair->group;
+	struct spdk_nvmf_transport_poll_group *tgroup;
+	struct nvmf_qpair_migrate_ctx *ctx;
+	int rc;
+
+	assert(src->thread == spdk_get_thread());
+
+	if (src == dst) {
+		return -EINVAL;
+	}
+
+	/* Only io qpairs of an active controller with nothing in flight are moved */
+	if (qpair->qid == 0 || qpair->ctrlr == NULL || qpair->state != SPDK_NVMF_QPAIR_ENABLED ||
+	    qpair->disconnect_started || !TAILQ_EMPTY(&qpair->outstanding)) {
+		return -EBUSY;
+	}
+
+	if (qpair->ctrlr->in_destruct || qpair->ctrlr->disconnect_in_progress ||
+	    src->sgroups[qpair->ctrlr->subsys->id].state != SPDK_NVMF_SUBSYSTEM_ACTIVE) {
+		return -EBUSY;
+	}
+
+	tgroup = nvmf_get_transport_poll_group(src, qpair->transport);
+	if (tgroup == NULL) {
+		return -EINVAL;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		return -ENOMEM;
+	}
+
+	/* Keep dst around until the qpair arrives */
+	pthread_mutex_lock(&dst->mutex);
+	if (dst->destroying) {
+		pthread_mutex_unlock(&dst->mutex);
+		free(ctx);
+		return -EBUSY;
+	}
+	dst->migrating_in_qpairs++;
+	pthread_mutex_unlock(&dst->mutex);
+
+	rc = nvmf_transport_poll_group_migrate_out(tgroup, qpair);
+	if (rc != 0) {
+		pthread_mutex_lock(&dst->mutex);
+		dst->migrating_in_qpairs--;
+		pthread_mutex_unlock(&dst->mutex);
+		free(ctx);
+		return rc;
+	}
+
+	SPDK_DEBUGLOG(nvmf, "Moving qpair %p (qid %u) from poll group %p to %p\n",
+		      qpair, qpair->qid, src, dst);
+
+	TAILQ_REMOVE(&src->qpairs, qpair, link);
+	assert(src->stat.current_io_qpairs > 0);
+	src->stat.current_io_qpairs--;
+	src->stat.migrated_out_qpairs++;
+
+	qpair->migrating = true;
+	qpair->group = dst;
+	/* The telemetry of the host is kept per poll group */
+	qpair->telemetry_host = NULL;
+	qpair->telemetry_gen = 0;
+
+	ctx->qpair = qpair;
+	ctx->dst = dst;
+	spdk_thread_send_msg(dst->thread, _nvmf_poll_group_migrate_in, ctx);
+
+	return 0;
+}
+
 static void
 _nvmf_ctrlr_destruct(void *ctx)
 {
@@ -1406,6 +1784,14 @@ spdk_nvmf_qpair_disconnect(struct spdk_nvmf_qpair *qpair)
 	}
 
 	assert(group != NULL);
+	if (spdk_get_thread() == group->thread && qpair->migrating) {
+		/* The qpair is still on its way to this poll group, the disconnect is issued once
+		 * it has arrived.  Clear the atomic so we can set it again then. */
+		__atomic_clear(&qpair->disconnect_started, __ATOMIC_RELAXED);
+		qpair->disconnect_deferred = true;
+		return 0;
+	}
+
 	if (spdk_get_thread() != group->thread) {
 		/* clear the atomic so we can set it on the next call on the proper thread. */
 		__atomic_clear(&qpair->disconnect_started, __ATOMIC_RELAXED);
@@ -1470,6 +1856,24 @@ spdk_nvmf_qpair_get_listen_trid(struct spdk_nvmf_qpair *qpair,
 	return nvmf_transport_qpair_get_listen_trid(qpair, trid);
 }
 
+static void
+poll_group_ns_read_cache_create(struct spdk_nvmf_poll_group *group, struct spdk_nvmf_ns *ns,
+				struct spdk_nvmf_subsystem_pg_ns_info *ns_info)
+{
+	assert(ns_info->read_cache_shard == NULL);
+	if (ns->read_cache == NULL) {
+		return;
+	}
+
+	/* Not fatal, the reads just won't be cached on this poll group */
+	ns_info->read_cache_shard = nvmf_ns_read_cache_shard_create(ns->read_cache,
+				    group->tgt->num_poll_groups);
+	if (ns_info->read_cache_shard == NULL) {
+		SPDK_ERRLOG("Could not allocate the read cache of namespace %u on poll group %p\n",
+			    ns->nsid, group);
+	}
+}
+
 static int
 poll_group_update_subsystem(struct spdk_nvmf_poll_group *group,
 			    struct spdk_nvmf_subsystem *subsystem)
@@ -1482,6 +1886,7 @@ poll_group_update_subsystem(struct spdk_nvmf_poll_group *group,
 	struct spdk_nvmf_subsystem_pg_ns_info *ns_info;
 	struct spdk_nvmf_ctrlr *ctrlr;
 	bool ns_changed;
+	int rc;
 
 	/* Make sure our poll group has memory for this subsystem allocated */
 	if (subsystem->id >= group->num_sgroups) {
@@ -1515,6 +1920,8 @@ poll_group_update_subsystem(struct spdk_nvmf_poll_group *group,
 			ns_changed = true;
 			spdk_put_io_channel(ch);
 			ns_info->channel = NULL;
+			nvmf_ns_read_cache_shard_destroy(ns_info->read_cache_shard);
+			ns_info->read_cache_shard = NULL;
 		} else if (ns != NULL && ch == NULL) {
 			/* A namespace appeared but there is no channel yet */
 			ns_changed = true;
@@ -1524,10 +1931,12 @@ poll_group_update_subsystem(struct spdk_nvmf_poll_group *group,
 				return -ENOMEM;
 			}
 			ns_info->channel = ch;
+			poll_group_ns_read_cache_create(group, ns, ns_info);
 		} else if (spdk_uuid_compare(&ns_info->uuid, spdk_bdev_get_uuid(ns->bdev)) != 0) {
 			/* A namespace was here before, but was replaced by a new one. */
 			ns_changed = true;
 			spdk_put_io_channel(ns_info->channel);
+			nvmf_ns_read_cache_shard_destroy(ns_info->read_cache_shard);
 			memset(ns_info, 0, sizeof(*ns_info));
 
 			ch = spdk_bdev_get_io_channel(ns->desc);
@@ -1536,6 +1945,7 @@ poll_group_update_subsystem(struct spdk_nvmf_poll_group *group,
 				return -ENOMEM;
 			}
 			ns_info->channel = ch;
+			poll_group_ns_read_cache_create(group, ns, ns_info);
 		} else if (ns_info->num_blocks != spdk_bdev_get_num_blocks(ns->bdev)) {
 			/* Namespace is still there but size has changed */
 			SPDK_DEBUGLOG(nvmf, "Namespace resized: subsystem_id %u,"
@@ -1561,6 +1971,7 @@ poll_group_update_subsystem(struct spdk_nvmf_poll_group *group,
 		if (ns == NULL) {
 			memset(ns_info, 0, sizeof(*ns_info));
 		} else {
+			ns_info->read_cache = ns->read_cache;
 			ns_info->uuid = *spdk_bdev_get_uuid(ns->bdev);
 			ns_info->num_blocks = spdk_bdev_get_num_blocks(ns->bdev);
 			ns_info->anagrpid = ns->anagrpid;
@@ -1600,6 +2011,14 @@ poll_group_update_subsystem(struct spdk_nvmf_poll_group *group,
 		}
 	}
 
+	rc = nvmf_poll_group_qos_update(sgroup, subsystem);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not update the QoS limits.\n");
+		return rc;
+	}
+
+	nvmf_poll_group_telemetry_update(sgroup, subsystem);
+
 	return 0;
 }
 
@@ -1679,8 +2098,12 @@ _nvmf_poll_group_remove_subsystem_cb(void *ctx, int status)
 			spdk_put_io_channel(sgroup->ns_info[nsid].channel);
 			sgroup->ns_info[nsid].channel = NULL;
 		}
+		nvmf_ns_read_cache_shard_destroy(sgroup->ns_info[nsid].read_cache_shard);
+		sgroup->ns_info[nsid].read_cache_shard = NULL;
 	}
 
+	nvmf_poll_group_qos_destroy(sgroup);
+	nvmf_poll_group_telemetry_destroy(sgroup);
 	sgroup->num_ns = 0;
 	free(sgroup->ns_info);
 	sgroup->ns_info = NULL;
@@ -1911,6 +2334,19 @@ spdk_nvmf_poll_group_dump_stat(struct spdk_nvmf_poll_group *group, struct spdk_j
 	spdk_json_write_named_uint32(w, "current_io_qpairs", group->stat.current_io_qpairs);
 	spdk_json_write_named_uint64(w, "pending_bdev_io", group->stat.pending_bdev_io);
 	spdk_json_write_named_uint64(w, "completed_nvme_io", group->stat.completed_nvme_io);
+	spdk_json_write_named_uint64(w, "completed_nvme_io_bytes", group->stat.completed_nvme_io_bytes);
+	spdk_json_write_named_uint64(w, "migrated_in_qpairs", group->stat.migrated_in_qpairs);
+	spdk_json_write_named_uint64(w, "migrated_out_qpairs", group->stat.migrated_out_qpairs);
+	spdk_json_write_named_uint64(w, "read_cache_hits", group->stat.read_cache_hits);
+	spdk_json_write_named_uint64(w, "read_cache_misses", group->stat.read_cache_misses);
+	if (group->load_poller != NULL) {
+		spdk_json_write_named_object_begin(w, "load");
+		spdk_json_write_named_uint64(w, "iops", group->load_iops);
+		spdk_json_write_named_uint64(w, "bytes_per_sec", group->load_bytes_per_sec);
+		spdk_json_write_named_uint64(w, "latency_us", group->load_latency_us);
+		spdk_json_write_object_end(w);
+	}
+	nvmf_poll_group_qos_dump_stat(group, w);
 
 	spdk_json_write_named_array_begin(w, "transports");
 
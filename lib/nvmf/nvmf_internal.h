@@ -82,6 +82,12 @@ struct spdk_nvmf_tgt {
 	uint32_t				dhchap_digests;
 	uint32_t				dhchap_dhgroups;
 
+	/* Load-aware placement and qpair rebalancing */
+	uint64_t				load_sample_period_us;
+	uint64_t				rebalance_period_us;
+	uint32_t				rebalance_threshold;
+	struct spdk_poller			*rebalance_poller;
+
 	TAILQ_ENTRY(spdk_nvmf_tgt)		link;
 };
 
@@ -130,6 +136,10 @@ struct spdk_nvmf_subsystem_pg_ns_info {
 	/* I/O outstanding to this namespace */
 	uint64_t			io_outstanding;
 	enum spdk_nvmf_subsystem_state	state;
+
+	/* Read cache of the namespace and this poll group's shard of it */
+	struct nvmf_ns_read_cache	*read_cache;
+	struct nvmf_ns_read_cache_shard	*read_cache_shard;
 };
 
 typedef void(*spdk_nvmf_poll_group_mod_done)(void *cb_arg, int status);
@@ -146,6 +156,15 @@ struct spdk_nvmf_subsystem_poll_group {
 	void					*cb_arg;
 
 	TAILQ_HEAD(, spdk_nvmf_request)		queued;
+
+	/* Poll group state of the QoS rules of the subsystem */
+	TAILQ_HEAD(, nvmf_qos_pg_rule)		qos_rules;
+
+	/* I/O telemetry of the hosts, see spdk_nvmf_subsystem_set_telemetry() */
+	bool					telemetry;
+	/* Changed whenever the hosts are dropped, so that the qpairs look theirs up again */
+	uint64_t				telemetry_gen;
+	TAILQ_HEAD(, nvmf_telemetry_host)	telemetry_hosts;
 };
 
 struct spdk_nvmf_registrant {
@@ -188,6 +207,8 @@ struct spdk_nvmf_ns {
 	bool always_visible;
 	/* Namespace id of the underlying device, used for passthrough commands */
 	uint32_t passthrough_nsid;
+	/* Read cache, NULL if disabled */
+	struct nvmf_ns_read_cache *read_cache;
 };
 
 /*
@@ -267,6 +288,11 @@ struct spdk_nvmf_ctrlr {
 
 #define NVMF_MAX_LISTENERS_PER_SUBSYSTEM	16
 
+/* Controllers are indexed by cntlid in chunks allocated on first use */
+#define NVMF_CNTLID_CHUNK_SHIFT			8
+#define NVMF_CNTLID_CHUNK_SIZE			(1u << NVMF_CNTLID_CHUNK_SHIFT)
+#define NVMF_CNTLID_NUM_CHUNKS			((UINT16_MAX + 1) >> NVMF_CNTLID_CHUNK_SHIFT)
+
 struct nvmf_subsystem_state_change_ctx {
 	struct spdk_nvmf_subsystem			*subsystem;
 	uint16_t					nsid;
@@ -322,6 +348,10 @@ struct spdk_nvmf_subsystem {
 	uint64_t					max_write_zeroes_size_kib;
 
 	TAILQ_HEAD(, spdk_nvmf_ctrlr)			ctrlrs;
+	/* Controllers indexed by cntlid.  Only changed on the subsystem's thread with ->mutex
+	 * held, so that the CONNECTs of I/O queues can look them up from the poll groups.
+	 */
+	struct spdk_nvmf_ctrlr				**ctrlr_chunks[NVMF_CNTLID_NUM_CHUNKS];
 
 	/* This mutex is used to protect fields that aren't touched on the I/O path (e.g. it's
 	 * needed for handling things like the CONNECT command) instead of requiring the subsystem
@@ -333,6 +363,13 @@ struct spdk_nvmf_subsystem {
 	TAILQ_HEAD(, spdk_nvmf_host)			hosts;
 	TAILQ_HEAD(, spdk_nvmf_subsystem_listener)	listeners;
 	struct spdk_bit_array				*used_listener_ids;
+	/* Namespace state of the hosts that connected recently, most recent first, protected
+	 * by ->mutex.  Valid as long as their generation matches ns_gen, which is bumped
+	 * whenever namespaces are added, removed or change visibility.
+	 */
+	TAILQ_HEAD(nvmf_ctrlr_host_states, nvmf_ctrlr_host_state) host_states;
+	uint32_t					num_host_states;
+	uint64_t					ns_gen;
 
 	TAILQ_ENTRY(spdk_nvmf_subsystem)		entries;
 
@@ -352,6 +389,13 @@ struct spdk_nvmf_subsystem {
 	/* In-band authentication sequence number, protected by ->mutex */
 	uint32_t					auth_seqnum;
 	bool						passthrough;
+	/* QoS rules, only changed while the subsystem is paused */
+	TAILQ_HEAD(, nvmf_qos_rule)			qos_rules;
+	/* I/O telemetry, only changed while the subsystem is paused */
+	bool						telemetry;
+	/* Sums of the statistics at the previous delta read */
+	TAILQ_HEAD(nvmf_telemetry_entries, nvmf_telemetry_entry)	telemetry_baseline;
+	uint64_t					telemetry_baseline_tsc;
 };
 
 static int
@@ -375,6 +419,10 @@ void nvmf_poll_group_pause_subsystem(struct spdk_nvmf_poll_group *group,
 				     spdk_nvmf_poll_group_mod_done cb_fn, void *cb_arg);
 void nvmf_poll_group_resume_subsystem(struct spdk_nvmf_poll_group *group,
 				      struct spdk_nvmf_subsystem *subsystem, spdk_nvmf_poll_group_mod_done cb_fn, void *cb_arg);
+/* Move an idle io qpair to another poll group.  Must be called on the qpair's current poll group
+ * thread, with dst kept from being freed by the caller (e.g. by holding the target's mutex while
+ * dst is on its poll group list).  Returns -EBUSY if the qpair can't be moved right now. */
+int nvmf_poll_group_migrate_qpair(struct spdk_nvmf_qpair *qpair, struct spdk_nvmf_poll_group *dst);
 
 void nvmf_update_discovery_log(struct spdk_nvmf_tgt *tgt, const char *hostnqn);
 void nvmf_get_discovery_log_page(struct spdk_nvmf_tgt *tgt, const char *hostnqn, struct iovec *iov,
@@ -382,6 +430,7 @@ void nvmf_get_discovery_log_page(struct spdk_nvmf_tgt *tgt, const char *hostnqn,
 				 struct spdk_nvme_transport_id *cmd_source_trid);
 
 void nvmf_ctrlr_destruct(struct spdk_nvmf_ctrlr *ctrlr);
+void nvmf_ctrlr_free_host_states(struct spdk_nvmf_subsystem *subsystem);
 int nvmf_ctrlr_process_admin_cmd(struct spdk_nvmf_request *req);
 int nvmf_ctrlr_process_io_cmd(struct spdk_nvmf_request *req);
 bool nvmf_ctrlr_dsm_supported(struct spdk_nvmf_ctrlr *ctrlr);
@@ -415,6 +464,84 @@ int nvmf_bdev_ctrlr_nvme_passthru_io(struct spdk_bdev *bdev, struct spdk_bdev_de
 bool nvmf_bdev_ctrlr_get_dif_ctx(struct spdk_bdev *bdev, struct spdk_nvme_cmd *cmd,
 				 struct spdk_dif_ctx *dif_ctx);
 bool nvmf_bdev_zcopy_enabled(struct spdk_bdev *bdev);
+int nvmf_bdev_ctrlr_cached_read_cmd(struct spdk_bdev *bdev, struct spdk_bdev_desc *desc,
+				    struct spdk_io_channel *ch, struct spdk_nvmf_request *req,
+				    struct nvmf_ns_read_cache_shard *shard);
+int nvmf_bdev_ctrlr_cached_zcopy_start(struct spdk_bdev *bdev, struct spdk_bdev_desc *desc,
+				       struct spdk_io_channel *ch, struct spdk_nvmf_request *req,
+				       struct nvmf_ns_read_cache_shard *shard);
+
+/*
+ * Namespace read cache.  The cache is shared by all poll groups, but the cached data is held
+ * in per poll group shards.  Commands modifying the namespace must call
+ * nvmf_ns_read_cache_invalidate() both when they are submitted and when they complete.
+ */
+struct nvmf_ns_read_cache *nvmf_ns_read_cache_create(struct spdk_bdev *bdev, uint32_t size_mb);
+void nvmf_ns_read_cache_destroy(struct nvmf_ns_read_cache *cache);
+struct nvmf_ns_read_cache_shard *nvmf_ns_read_cache_shard_create(struct nvmf_ns_read_cache *cache,
+		uint32_t num_shards);
+void nvmf_ns_read_cache_shard_destroy(struct nvmf_ns_read_cache_shard *shard);
+bool nvmf_ns_read_cache_cmd_modifies(const struct spdk_nvme_cmd *cmd);
+void nvmf_ns_read_cache_invalidate(struct nvmf_ns_read_cache *cache, const struct spdk_nvme_cmd *cmd);
+/* Copy the range to iovs if it's fully cached */
+bool nvmf_ns_read_cache_read(struct nvmf_ns_read_cache_shard *shard, uint64_t start_lba,
+			     uint64_t num_blocks, struct iovec *iovs, int iovcnt);
+/* Point iovs to the cached range and hold the lines until nvmf_ns_read_cache_put() */
+int nvmf_ns_read_cache_get(struct nvmf_ns_read_cache_shard *shard, uint64_t start_lba,
+			   uint64_t num_blocks, struct iovec *iovs, int iovcnt);
+void nvmf_ns_read_cache_put(struct nvmf_ns_read_cache_shard *shard, struct iovec *iovs, int iovcnt);
+struct nvmf_ns_read_cache_fill *nvmf_ns_read_cache_fill_start(struct nvmf_ns_read_cache_shard *shard,
+		struct spdk_nvmf_request *req, uint64_t start_lba, uint64_t num_blocks);
+struct spdk_nvmf_request *nvmf_ns_read_cache_fill_get_req(struct nvmf_ns_read_cache_fill *fill);
+void nvmf_ns_read_cache_fill_done(struct nvmf_ns_read_cache_fill *fill, bool success,
+				  struct iovec *iovs, int iovcnt);
+
+/*
+ * Per host and namespace QoS.  The rules are only changed while the subsystem is paused and
+ * picked up by the poll groups when it's resumed.
+ */
+void nvmf_subsystem_qos_free(struct spdk_nvmf_subsystem *subsystem);
+void nvmf_subsystem_qos_write_config_json(struct spdk_nvmf_subsystem *subsystem,
+		struct spdk_json_write_ctx *w);
+int nvmf_poll_group_qos_update(struct spdk_nvmf_subsystem_poll_group *sgroup,
+			       struct spdk_nvmf_subsystem *subsystem);
+void nvmf_poll_group_qos_destroy(struct spdk_nvmf_subsystem_poll_group *sgroup);
+void nvmf_poll_group_qos_dump_stat(struct spdk_nvmf_poll_group *group,
+				   struct spdk_json_write_ctx *w);
+/* Returns false if the request was queued until it's within the limits */
+bool nvmf_qos_admit(struct spdk_nvmf_poll_group *group,
+		    struct spdk_nvmf_subsystem_poll_group *sgroup, struct spdk_nvmf_request *req);
+/* Submit a request that was queued by nvmf_qos_admit() */
+void nvmf_qos_resubmit(struct spdk_nvmf_request *req);
+
+/*
+ * Per host and namespace I/O telemetry.  The poll groups pick up whether it's enabled when the
+ * subsystem is resumed.
+ */
+struct nvmf_telemetry_report;
+typedef void (*nvmf_telemetry_collect_cb)(void *cb_arg, struct nvmf_telemetry_report *report,
+		int status);
+
+void nvmf_subsystem_telemetry_free(struct spdk_nvmf_subsystem *subsystem);
+void nvmf_subsystem_telemetry_write_config_json(struct spdk_nvmf_subsystem *subsystem,
+		struct spdk_json_write_ctx *w);
+void nvmf_poll_group_telemetry_update(struct spdk_nvmf_subsystem_poll_group *sgroup,
+				      struct spdk_nvmf_subsystem *subsystem);
+void nvmf_poll_group_telemetry_destroy(struct spdk_nvmf_subsystem_poll_group *sgroup);
+/* Account for a completed I/O that was submitted while the telemetry was enabled */
+void nvmf_telemetry_record(struct spdk_nvmf_subsystem_poll_group *sgroup,
+			   struct spdk_nvmf_request *req);
+/*
+ * Sum up the statistics of the poll groups, optionally of a single host and namespace.  With
+ * delta, the statistics since the previous delta read are reported.  The report is passed to
+ * cb_fn, which has to free it with nvmf_telemetry_report_free().
+ */
+int nvmf_subsystem_telemetry_collect(struct spdk_nvmf_subsystem *subsystem, const char *hostnqn,
+				     uint32_t nsid, bool delta, nvmf_telemetry_collect_cb cb_fn,
+				     void *cb_arg);
+void nvmf_telemetry_report_write_json(struct nvmf_telemetry_report *report,
+				      struct spdk_json_write_ctx *w);
+void nvmf_telemetry_report_free(struct nvmf_telemetry_report *report);
 
 int nvmf_subsystem_add_ctrlr(struct spdk_nvmf_subsystem *subsystem,
 			     struct spdk_nvmf_ctrlr *ctrlr);
@@ -253,6 +253,10 @@ dump_nvmf_subsystem(struct spdk_json_write_ctx *w, struct spdk_nvmf_subsystem *s
 				spdk_json_write_named_uint32(w, "anagrpid", ns_opts.anagrpid);
 			}
 
+			if (ns_opts.read_cache_size_mb != 0) {
+				spdk_json_write_named_uint32(w, "read_cache_size_mb", ns_opts.read_cache_size_mb);
+			}
+
 			spdk_json_write_object_end(w);
 		}
 		spdk_json_write_array_end(w);
@@ -1377,6 +1381,7 @@ struct nvmf_rpc_ns_params {
 	struct spdk_uuid uuid;
 	uint32_t anagrpid;
 	bool no_auto_visible;
+	uint32_t read_cache_size_mb;
 };
 
 static const struct spdk_json_object_decoder rpc_ns_params_decoders[] = {
@@ -1388,6 +1393,7 @@ static const struct spdk_json_object_decoder rpc_ns_params_decoders[] = {
 	{"uuid", offsetof(struct nvmf_rpc_ns_params, uuid), spdk_json_decode_uuid, true},
 	{"anagrpid", offsetof(struct nvmf_rpc_ns_params, anagrpid), spdk_json_decode_uint32, true},
 	{"no_auto_visible", offsetof(struct nvmf_rpc_ns_params, no_auto_visible), spdk_json_decode_bool, true},
+	{"read_cache_size_mb", offsetof(struct nvmf_rpc_ns_params, read_cache_size_mb), spdk_json_decode_uint32, true},
 };
 
 static int
@@ -1509,6 +1515,7 @@ nvmf_rpc_ns_paused(struct spdk_nvmf_subsystem *subsystem,
 
 	ns_opts.anagrpid = ctx->ns_params.anagrpid;
 	ns_opts.no_auto_visible = ctx->ns_params.no_auto_visible;
+	ns_opts.read_cache_size_mb = ctx->ns_params.read_cache_size_mb;
 
 	ctx->ns_params.nsid = spdk_nvmf_subsystem_add_ns_ext(subsystem, ctx->ns_params.bdev_name,
 			      &ns_opts, sizeof(ns_opts),
@@ -1698,6 +1705,336 @@ rpc_nvmf_subsystem_set_ns_ana_group(struct spdk_jsonrpc_request *request,
 SPDK_RPC_REGISTER("nvmf_subsystem_set_ns_ana_group", rpc_nvmf_subsystem_set_ns_ana_group,
 		  SPDK_RPC_RUNTIME)
 
+struct nvmf_rpc_qos_ctx {
+	char *nqn;
+	char *tgt_name;
+	char *host;
+	uint32_t nsid;
+	uint64_t rw_ios_per_sec;
+	uint64_t rw_mbytes_per_sec;
+	uint64_t min_rw_ios_per_sec;
+	uint64_t min_rw_mbytes_per_sec;
+
+	struct spdk_jsonrpc_request *request;
+	bool response_sent;
+};
+
+static const struct spdk_json_object_decoder nvmf_rpc_subsystem_qos_decoder[] = {
+	{"nqn", offsetof(struct nvmf_rpc_qos_ctx, nqn), spdk_json_decode_string},
+	{"tgt_name", offsetof(struct nvmf_rpc_qos_ctx, tgt_name), spdk_json_decode_string, true},
+	{"host", offsetof(struct nvmf_rpc_qos_ctx, host), spdk_json_decode_string, true},
+	{"nsid", offsetof(struct nvmf_rpc_qos_ctx, nsid), spdk_json_decode_uint32, true},
+	{"rw_ios_per_sec", offsetof(struct nvmf_rpc_qos_ctx, rw_ios_per_sec), spdk_json_decode_uint64, true},
+	{"rw_mbytes_per_sec", offsetof(struct nvmf_rpc_qos_ctx, rw_mbytes_per_sec), spdk_json_decode_uint64, true},
+	{"min_rw_ios_per_sec", offsetof(struct nvmf_rpc_qos_ctx, min_rw_ios_per_sec), spdk_json_decode_uint64, true},
+	{"min_rw_mbytes_per_sec", offsetof(struct nvmf_rpc_qos_ctx, min_rw_mbytes_per_sec), spdk_json_decode_uint64, true},
+};
+
+static void
+nvmf_rpc_qos_ctx_free(struct nvmf_rpc_qos_ctx *ctx)
+{
+	free(ctx->nqn);
+	free(ctx->tgt_name);
+	free(ctx->host);
+	free(ctx);
+}
+
+static void
+nvmf_rpc_qos_resumed(struct spdk_nvmf_subsystem *subsystem,
+		     void *cb_arg, int status)
+{
+	struct nvmf_rpc_qos_ctx *ctx = cb_arg;
+	struct spdk_jsonrpc_request *request = ctx->request;
+	bool response_sent = ctx->response_sent;
+
+	nvmf_rpc_qos_ctx_free(ctx);
+
+	if (response_sent) {
+		return;
+	}
+
+	spdk_jsonrpc_send_bool_response(request, true);
+}
+
+static void
+nvmf_rpc_qos_paused(struct spdk_nvmf_subsystem *subsystem,
+		    void *cb_arg, int status)
+{
+	struct nvmf_rpc_qos_ctx *ctx = cb_arg;
+	uint64_t limits[SPDK_NVMF_QOS_NUM_LIMITS];
+	int rc;
+
+	limits[SPDK_NVMF_QOS_RW_IOPS_MAX] = ctx->rw_ios_per_sec;
+	limits[SPDK_NVMF_QOS_RW_BPS_MAX] = ctx->rw_mbytes_per_sec * 1024 * 1024;
+	limits[SPDK_NVMF_QOS_RW_IOPS_MIN] = ctx->min_rw_ios_per_sec;
+	limits[SPDK_NVMF_QOS_RW_BPS_MIN] = ctx->min_rw_mbytes_per_sec * 1024 * 1024;
+
+	rc = spdk_nvmf_subsystem_set_qos_limits(subsystem, ctx->host, ctx->nsid, limits);
+	if (rc != 0) {
+		SPDK_ERRLOG("Unable to set the QoS limits of subsystem %s\n", ctx->nqn);
+		spdk_jsonrpc_send_error_response(ctx->request, rc, spdk_strerror(-rc));
+		ctx->response_sent = true;
+	}
+
+	if (spdk_nvmf_subsystem_resume(subsystem, nvmf_rpc_qos_resumed, ctx)) {
+		if (!ctx->response_sent) {
+			spdk_jsonrpc_send_error_response(ctx->request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+							 "Internal error");
+		}
+		nvmf_rpc_qos_ctx_free(ctx);
+	}
+}
+
+static void
+rpc_nvmf_subsystem_set_qos(struct spdk_jsonrpc_request *request,
+			   const struct spdk_json_val *params)
+{
+	struct nvmf_rpc_qos_ctx *ctx;
+	struct spdk_nvmf_subsystem *subsystem;
+	struct spdk_nvmf_tgt *tgt;
+	int rc;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR, "Out of memory");
+		return;
+	}
+
+	if (spdk_json_decode_object(params, nvmf_rpc_subsystem_qos_decoder,
+				    SPDK_COUNTOF(nvmf_rpc_subsystem_qos_decoder), ctx)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS, "Invalid parameters");
+		nvmf_rpc_qos_ctx_free(ctx);
+		return;
+	}
+
+	ctx->request = request;
+	ctx->response_sent = false;
+
+	tgt = spdk_nvmf_get_tgt(ctx->tgt_name);
+	if (!tgt) {
+		SPDK_ERRLOG("Unable to find a target object.\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "Unable to find a target.");
+		nvmf_rpc_qos_ctx_free(ctx);
+		return;
+	}
+
+	subsystem = spdk_nvmf_tgt_find_subsystem(tgt, ctx->nqn);
+	if (!subsystem) {
+		SPDK_ERRLOG("Unable to find subsystem with NQN %s\n", ctx->nqn);
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS, "Invalid parameters");
+		nvmf_rpc_qos_ctx_free(ctx);
+		return;
+	}
+
+	rc = spdk_nvmf_subsystem_pause(subsystem, 0, nvmf_rpc_qos_paused, ctx);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR, "Internal error");
+		nvmf_rpc_qos_ctx_free(ctx);
+	}
+}
+SPDK_RPC_REGISTER("nvmf_subsystem_set_qos", rpc_nvmf_subsystem_set_qos, SPDK_RPC_RUNTIME)
+
+struct nvmf_rpc_telemetry_ctx {
+	char *nqn;
+	char *tgt_name;
+	char *host;
+	uint32_t nsid;
+	bool enable;
+	bool delta;
+
+	struct spdk_jsonrpc_request *request;
+	bool response_sent;
+};
+
+static const struct spdk_json_object_decoder nvmf_rpc_subsystem_set_telemetry_decoder[] = {
+	{"nqn", offsetof(struct nvmf_rpc_telemetry_ctx, nqn), spdk_json_decode_string},
+	{"tgt_name", offsetof(struct nvmf_rpc_telemetry_ctx, tgt_name), spdk_json_decode_string, true},
+	{"enable", offsetof(struct nvmf_rpc_telemetry_ctx, enable), spdk_json_decode_bool},
+};
+
+static void
+nvmf_rpc_telemetry_ctx_free(struct nvmf_rpc_telemetry_ctx *ctx)
+{
+	free(ctx->nqn);
+	free(ctx->tgt_name);
+	free(ctx->host);
+	free(ctx);
+}
+
+static void
+nvmf_rpc_telemetry_resumed(struct spdk_nvmf_subsystem *subsystem,
+			   void *cb_arg, int status)
+{
+	struct nvmf_rpc_telemetry_ctx *ctx = cb_arg;
+	struct spdk_jsonrpc_request *request = ctx->request;
+	bool response_sent = ctx->response_sent;
+
+	nvmf_rpc_telemetry_ctx_free(ctx);
+
+	if (response_sent) {
+		return;
+	}
+
+	spdk_jsonrpc_send_bool_response(request, true);
+}
+
+static void
+nvmf_rpc_telemetry_paused(struct spdk_nvmf_subsystem *subsystem,
+			  void *cb_arg, int status)
+{
+	struct nvmf_rpc_telemetry_ctx *ctx = cb_arg;
+	int rc;
+
+	rc = spdk_nvmf_subsystem_set_telemetry(subsystem, ctx->enable);
+	if (rc != 0) {
+		SPDK_ERRLOG("Unable to set the telemetry of subsystem %s\n", ctx->nqn);
+		spdk_jsonrpc_send_error_response(ctx->request, rc, spdk_strerror(-rc));
+		ctx->response_sent = true;
+	}
+
+	if (spdk_nvmf_subsystem_resume(subsystem, nvmf_rpc_telemetry_resumed, ctx)) {
+		if (!ctx->response_sent) {
+			spdk_jsonrpc_send_error_response(ctx->request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+							 "Internal error");
+		}
+		nvmf_rpc_telemetry_ctx_free(ctx);
+	}
+}
+
+static struct spdk_nvmf_subsystem *
+nvmf_rpc_telemetry_find_subsystem(struct nvmf_rpc_telemetry_ctx *ctx)
+{
+	struct spdk_nvmf_subsystem *subsystem;
+	struct spdk_nvmf_tgt *tgt;
+
+	tgt = spdk_nvmf_get_tgt(ctx->tgt_name);
+	if (!tgt) {
+		SPDK_ERRLOG("Unable to find a target object.\n");
+		spdk_jsonrpc_send_error_response(ctx->request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "Unable to find a target.");
+		return NULL;
+	}
+
+	subsystem = spdk_nvmf_tgt_find_subsystem(tgt, ctx->nqn);
+	if (!subsystem) {
+		SPDK_ERRLOG("Unable to find subsystem with NQN %s\n", ctx->nqn);
+		spdk_jsonrpc_send_error_response(ctx->request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "Invalid parameters");
+		return NULL;
+	}
+
+	return subsystem;
+}
+
+static void
+rpc_nvmf_subsystem_set_telemetry(struct spdk_jsonrpc_request *request,
+				 const struct spdk_json_val *params)
+{
+	struct nvmf_rpc_telemetry_ctx *ctx;
+	struct spdk_nvmf_subsystem *subsystem;
+	int rc;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR, "Out of memory");
+		return;
+	}
+
+	if (spdk_json_decode_object(params, nvmf_rpc_subsystem_set_telemetry_decoder,
+				    SPDK_COUNTOF(nvmf_rpc_subsystem_set_telemetry_decoder), ctx)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS, "Invalid parameters");
+		nvmf_rpc_telemetry_ctx_free(ctx);
+		return;
+	}
+
+	ctx->request = request;
+	ctx->response_sent = false;
+
+	subsystem = nvmf_rpc_telemetry_find_subsystem(ctx);
+	if (!subsystem) {
+		nvmf_rpc_telemetry_ctx_free(ctx);
+		return;
+	}
+
+	rc = spdk_nvmf_subsystem_pause(subsystem, 0, nvmf_rpc_telemetry_paused, ctx);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR, "Internal error");
+		nvmf_rpc_telemetry_ctx_free(ctx);
+	}
+}
+SPDK_RPC_REGISTER("nvmf_subsystem_set_telemetry", rpc_nvmf_subsystem_set_telemetry,
+		  SPDK_RPC_RUNTIME)
+
+static const struct spdk_json_object_decoder nvmf_rpc_subsystem_get_telemetry_decoder[] = {
+	{"nqn", offsetof(struct nvmf_rpc_telemetry_ctx, nqn), spdk_json_decode_string},
+	{"tgt_name", offsetof(struct nvmf_rpc_telemetry_ctx, tgt_name), spdk_json_decode_string, true},
+	{"host", offsetof(struct nvmf_rpc_telemetry_ctx, host), spdk_json_decode_string, true},
+	{"nsid", offsetof(struct nvmf_rpc_telemetry_ctx, nsid), spdk_json_decode_uint32, true},
+	{"delta", offsetof(struct nvmf_rpc_telemetry_ctx, delta), spdk_json_decode_bool, true},
+};
+
+static void
+nvmf_rpc_telemetry_collected(void *cb_arg, struct nvmf_telemetry_report *report, int status)
+{
+	struct nvmf_rpc_telemetry_ctx *ctx = cb_arg;
+	struct spdk_json_write_ctx *w;
+
+	if (status != 0) {
+		spdk_jsonrpc_send_error_response(ctx->request, status, spdk_strerror(-status));
+	} else {
+		w = spdk_jsonrpc_begin_result(ctx->request);
+		nvmf_telemetry_report_write_json(report, w);
+		spdk_jsonrpc_end_result(ctx->request, w);
+		nvmf_telemetry_report_free(report);
+	}
+
+	nvmf_rpc_telemetry_ctx_free(ctx);
+}
+
+static void
+rpc_nvmf_subsystem_get_telemetry(struct spdk_jsonrpc_request *request,
+				 const struct spdk_json_val *params)
+{
+	struct nvmf_rpc_telemetry_ctx *ctx;
+	struct spdk_nvmf_subsystem *subsystem;
+	int rc;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR, "Out of memory");
+		return;
+	}
+
+	if (spdk_json_decode_object(params, nvmf_rpc_subsystem_get_telemetry_decoder,
+				    SPDK_COUNTOF(nvmf_rpc_subsystem_get_telemetry_decoder), ctx)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS, "Invalid parameters");
+		nvmf_rpc_telemetry_ctx_free(ctx);
+		return;
+	}
+
+	ctx->request = request;
+
+	subsystem = nvmf_rpc_telemetry_find_subsystem(ctx);
+	if (!subsystem) {
+		nvmf_rpc_telemetry_ctx_free(ctx);
+		return;
+	}
+
+	rc = nvmf_subsystem_telemetry_collect(subsystem, ctx->host, ctx->nsid, ctx->delta,
+					      nvmf_rpc_telemetry_collected, ctx);
+	if (rc != 0) {
+		SPDK_ERRLOG("Unable to get the telemetry of subsystem %s\n", ctx->nqn);
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		nvmf_rpc_telemetry_ctx_free(ctx);
+	}
+}
+SPDK_RPC_REGISTER("nvmf_subsystem_get_telemetry", rpc_nvmf_subsystem_get_telemetry,
+		  SPDK_RPC_RUNTIME)
+
 struct nvmf_rpc_remove_ns_ctx {
 	char *nqn;
 	char *tgt_name;
@@ -0,0 +1,621 @@
+/*   SPDX-License-Identifier: BSD-3-Clause
+ *   Copyright (C) 2026 agent. All rights reserved.
+ */
+
+/*
+ * Per host and per namespace QoS
+ *
+ * Each rule of a subsystem has shared token buckets, refilled every timeslice by whichever poll
+ * group notices first that a new timeslice has started.  Poll groups take tokens from the shared
+ * buckets in batches into their own local buckets, so that the I/O path only touches the shared
+ * state once every few I/O and no single thread has to account for the I/O of all the others.
+ * Requests that are over the limits are queued in the poll group and resubmitted by a poller
+ * once tokens are available again.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "nvmf_internal.h"
+
+#include "spdk/json.h"
+#include "spdk/likely.h"
+#include "spdk/log.h"
+#include "spdk/string.h"
+#include "spdk/util.h"
+
+#define NVMF_QOS_TIMESLICE_IN_USEC		1000
+#define NVMF_QOS_MIN_IOS_PER_SEC		1000
+#define NVMF_QOS_MIN_BYTES_PER_TIMESLICE	512
+/* A poll group takes 1 / (1 << NVMF_QOS_BATCH_SHIFT) of the quota of a timeslice at once */
+#define NVMF_QOS_BATCH_SHIFT			4
+/* At most one rule of each kind (host and namespace, host, namespace, subsystem) matches */
+#define NVMF_QOS_MAX_MATCHES			4
+
+enum nvmf_qos_counter {
+	NVMF_QOS_IOS = 0,
+	NVMF_QOS_BYTES,
+	NVMF_QOS_NUM_COUNTERS,
+};
+
+struct nvmf_qos_bucket {
+	/* Tokens added per timeslice, 0 if unlimited */
+	int64_t					quota;
+	int64_t					tokens;
+};
+
+struct nvmf_qos_rule {
+	struct spdk_nvmf_subsystem		*subsystem;
+	/* Empty if the rule applies to all hosts */
+	char					hostnqn[SPDK_NVMF_NQN_MAX_LEN + 1];
+	/* 0 if the rule applies to all namespaces */
+	uint32_t				nsid;
+	uint64_t				limits[SPDK_NVMF_QOS_NUM_LIMITS];
+
+	struct nvmf_qos_bucket			max[NVMF_QOS_NUM_COUNTERS];
+	struct nvmf_qos_bucket			min[NVMF_QOS_NUM_COUNTERS];
+	/* Timeslice of the last refill */
+	uint64_t				slice;
+	/* Held by the subsystem and the poll groups using the rule */
+	uint32_t				ref;
+
+	TAILQ_ENTRY(nvmf_qos_rule)		link;
+};
+
+struct nvmf_qos_pg_rule {
+	struct nvmf_qos_rule			*rule;
+	uint64_t				slice;
+	int64_t					max[NVMF_QOS_NUM_COUNTERS];
+	int64_t					min[NVMF_QOS_NUM_COUNTERS];
+	TAILQ_HEAD(, spdk_nvmf_request)		queued;
+
+	/* Statistics */
+	uint64_t				ios;
+	uint64_t				bytes;
+	uint64_t				throttled_ios;
+	uint64_t				queued_ios;
+
+	TAILQ_ENTRY(nvmf_qos_pg_rule)		link;
+};
+
+static uint64_t g_nvmf_qos_slice_ticks;
+
+static inline uint64_t
+nvmf_qos_get_slice(void)
+{
+	if (spdk_unlikely(g_nvmf_qos_slice_ticks == 0)) {
+		g_nvmf_qos_slice_ticks = spdk_max(spdk_get_ticks_hz() * NVMF_QOS_TIMESLICE_IN_USEC /
+						  SPDK_SEC_TO_USEC, 1);
+	}
+
+	return spdk_get_ticks() / g_nvmf_qos_slice_ticks;
+}
+
+static void
+nvmf_qos_rule_put(struct nvmf_qos_rule *rule)
+{
+	if (__atomic_sub_fetch(&rule->ref, 1, __ATOMIC_ACQ_REL) == 0) {
+		free(rule);
+	}
+}
+
+static void
+nvmf_qos_bucket_set(struct nvmf_qos_bucket *bucket, uint64_t limit, int64_t min_quota)
+{
+	bucket->quota = 0;
+	if (limit != 0) {
+		bucket->quota = spdk_max((int64_t)(limit * NVMF_QOS_TIMESLICE_IN_USEC / SPDK_SEC_TO_USEC),
+					 min_quota);
+	}
+	bucket->tokens = bucket->quota;
+}
+
+static void
+nvmf_qos_rule_set_limits(struct nvmf_qos_rule *rule, const uint64_t *limits)
+{
+	memcpy(rule->limits, limits, sizeof(rule->limits));
+	nvmf_qos_bucket_set(&rule->max[NVMF_QOS_IOS], limits[SPDK_NVMF_QOS_RW_IOPS_MAX], 1);
+	nvmf_qos_bucket_set(&rule->max[NVMF_QOS_BYTES], limits[SPDK_NVMF_QOS_RW_BPS_MAX],
+			    NVMF_QOS_MIN_BYTES_PER_TIMESLICE);
+	nvmf_qos_bucket_set(&rule->min[NVMF_QOS_IOS], limits[SPDK_NVMF_QOS_RW_IOPS_MIN], 1);
+	nvmf_qos_bucket_set(&rule->min[NVMF_QOS_BYTES], limits[SPDK_NVMF_QOS_RW_BPS_MIN],
+			    NVMF_QOS_MIN_BYTES_PER_TIMESLICE);
+	rule->slice = nvmf_qos_get_slice();
+}
+
+static bool
+nvmf_qos_limits_valid(const char *hostnqn, const uint64_t *limits)
+{
+	int i;
+
+	for (i = SPDK_NVMF_QOS_RW_IOPS_MAX; i < SPDK_NVMF_QOS_NUM_LIMITS; i++) {
+		if ((i == SPDK_NVMF_QOS_RW_IOPS_MAX || i == SPDK_NVMF_QOS_RW_IOPS_MIN) &&
+		    limits[i] % NVMF_QOS_MIN_IOS_PER_SEC != 0) {
+			SPDK_ERRLOG("IOPS limits must be a multiple of %u\n", NVMF_QOS_MIN_IOS_PER_SEC);
+			return false;
+		}
+	}
+
+	if (hostnqn == NULL &&
+	    (limits[SPDK_NVMF_QOS_RW_IOPS_MIN] != 0 || limits[SPDK_NVMF_QOS_RW_BPS_MIN] != 0)) {
+		SPDK_ERRLOG("Minimum limits can only be set for a host\n");
+		return false;
+	}
+
+	if ((limits[SPDK_NVMF_QOS_RW_IOPS_MAX] != 0 &&
+	     limits[SPDK_NVMF_QOS_RW_IOPS_MIN] > limits[SPDK_NVMF_QOS_RW_IOPS_MAX]) ||
+	    (limits[SPDK_NVMF_QOS_RW_BPS_MAX] != 0 &&
+	     limits[SPDK_NVMF_QOS_RW_BPS_MIN] > limits[SPDK_NVMF_QOS_RW_BPS_MAX])) {
+		SPDK_ERRLOG("Minimum limits cannot exceed the maximum limits\n");
+		return false;
+	}
+
+	return true;
+}
+
+int
+spdk_nvmf_subsystem_set_qos_limits(struct spdk_nvmf_subsystem *subsystem, const char *hostnqn,
+				   uint32_t nsid, const uint64_t *limits)
+{
+	struct nvmf_qos_rule *rule;
+	bool remove = true;
+	int i;
+
+	if (!(subsystem->state == SPDK_NVMF_SUBSYSTEM_INACTIVE ||
+	      subsystem->state == SPDK_NVMF_SUBSYSTEM_PAUSED)) {
+		return -EAGAIN;
+	}
+
+	if (hostnqn != NULL && strlen(hostnqn) > SPDK_NVMF_NQN_MAX_LEN) {
+		return -EINVAL;
+	}
+
+	if (!nvmf_qos_limits_valid(hostnqn, limits)) {
+		return -EINVAL;
+	}
+
+	for (i = SPDK_NVMF_QOS_RW_IOPS_MAX; i < SPDK_NVMF_QOS_NUM_LIMITS; i++) {
+		if (limits[i] != 0) {
+			remove = false;
+		}
+	}
+
+	TAILQ_FOREACH(rule, &subsystem->qos_rules, link) {
+		if (rule->nsid == nsid && strcmp(rule->hostnqn, hostnqn ? hostnqn : "") == 0) {
+			break;
+		}
+	}
+
+	if (remove) {
+		if (rule == NULL) {
+			return -ENOENT;
+		}
+		TAILQ_REMOVE(&subsystem->qos_rules, rule, link);
+		nvmf_qos_rule_put(rule);
+		return 0;
+	}
+
+	if (rule == NULL) {
+		rule = calloc(1, sizeof(*rule));
+		if (rule == NULL) {
+			return -ENOMEM;
+		}
+		rule->subsystem = subsystem;
+		rule->nsid = nsid;
+		rule->ref = 1;
+		if (hostnqn != NULL) {
+			snprintf(rule->hostnqn, sizeof(rule->hostnqn), "%s", hostnqn);
+		}
+		TAILQ_INSERT_TAIL(&subsystem->qos_rules, rule, link);
+	}
+
+	nvmf_qos_rule_set_limits(rule, limits);
+
+	return 0;
+}
+
+void
+nvmf_subsystem_qos_free(struct spdk_nvmf_subsystem *subsystem)
+{
+	struct nvmf_qos_rule *rule;
+
+	while ((rule = TAILQ_FIRST(&subsystem->qos_rules))) {
+		TAILQ_REMOVE(&subsystem->qos_rules, rule, link);
+		nvmf_qos_rule_put(rule);
+	}
+}
+
+void
+nvmf_subsystem_qos_write_config_json(struct spdk_nvmf_subsystem *subsystem,
+				     struct spdk_json_write_ctx *w)
+{
+	struct nvmf_qos_rule *rule;
+
+	TAILQ_FOREACH(rule, &subsystem->qos_rules, link) {
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_string(w, "method", "nvmf_subsystem_set_qos");
+		spdk_json_write_named_object_begin(w, "params");
+		spdk_json_write_named_string(w, "nqn", subsystem->subnqn);
+		if (rule->hostnqn[0] != '\0') {
+			spdk_json_write_named_string(w, "host", rule->hostnqn);
+		}
+		if (rule->nsid != 0) {
+			spdk_json_write_named_uint32(w, "nsid", rule->nsid);
+		}
+		spdk_json_write_named_uint64(w, "rw_ios_per_sec", rule->limits[SPDK_NVMF_QOS_RW_IOPS_MAX]);
+		spdk_json_write_named_uint64(w, "rw_mbytes_per_sec",
+					     rule->limits[SPDK_NVMF_QOS_RW_BPS_MAX] / 1024 / 1024);
+		spdk_json_write_named_uint64(w, "min_rw_ios_per_sec",
+					     rule->limits[SPDK_NVMF_QOS_RW_IOPS_MIN]);
+		spdk_json_write_named_uint64(w, "min_rw_mbytes_per_sec",
+					     rule->limits[SPDK_NVMF_QOS_RW_BPS_MIN] / 1024 / 1024);
+		spdk_json_write_object_end(w);
+		spdk_json_write_object_end(w);
+	}
+}
+
+/* Add the quota of a new timeslice to the shared buckets, without accumulating unused tokens */
+static void
+nvmf_qos_rule_refill(struct nvmf_qos_rule *rule, uint64_t now)
+{
+	struct nvmf_qos_bucket *buckets[] = { rule->max, rule->min };
+	struct nvmf_qos_bucket *bucket;
+	uint64_t slice;
+	int64_t tokens;
+	int i, j;
+
+	slice = __atomic_load_n(&rule->slice, __ATOMIC_RELAXED);
+	if (slice >= now ||
+	    !__atomic_compare_exchange_n(&rule->slice, &slice, now, false, __ATOMIC_RELAXED,
+					 __ATOMIC_RELAXED)) {
+		return;
+	}
+
+	for (i = 0; i < (int)SPDK_COUNTOF(buckets); i++) {
+		for (j = 0; j < NVMF_QOS_NUM_COUNTERS; j++) {
+			bucket = &buckets[i][j];
+			if (bucket->quota == 0) {
+				continue;
+			}
+			tokens = __atomic_add_fetch(&bucket->tokens, bucket->quota, __ATOMIC_RELAXED);
+			if (tokens > bucket->quota) {
+				__atomic_sub_fetch(&bucket->tokens, tokens - bucket->quota, __ATOMIC_RELAXED);
+			}
+		}
+	}
+}
+
+static void
+nvmf_qos_pg_rule_refresh(struct nvmf_qos_pg_rule *pg_rule, uint64_t now)
+{
+	int i;
+
+	if (spdk_likely(pg_rule->slice == now)) {
+		return;
+	}
+
+	nvmf_qos_rule_refill(pg_rule->rule, now);
+
+	/* Unused local tokens expire with their timeslice, but debt is kept */
+	for (i = 0; i < NVMF_QOS_NUM_COUNTERS; i++) {
+		pg_rule->max[i] = spdk_min(pg_rule->max[i], 0);
+		pg_rule->min[i] = spdk_min(pg_rule->min[i], 0);
+	}
+	pg_rule->slice = now;
+}
+
+/*
+ * Make sure there's at least one local token, taking a batch from the shared bucket if needed.
+ * Requests larger than the remaining tokens are let through and leave a debt, the same way the
+ * bdev QoS does, so that requests larger than the quota of a timeslice aren't blocked forever.
+ */
+static bool
+nvmf_qos_reserve(struct nvmf_qos_bucket *bucket, int64_t *local)
+{
+	int64_t want, avail;
+
+	if (bucket->quota == 0 || *local > 0) {
+		return true;
+	}
+
+	want = spdk_max(1 - *local, bucket->quota >> NVMF_QOS_BATCH_SHIFT);
+	avail = __atomic_fetch_sub(&bucket->tokens, want, __ATOMIC_RELAXED);
+	if (avail < want) {
+		/* Give back what wasn't there */
+		__atomic_fetch_add(&bucket->tokens, want - spdk_max(avail, 0), __ATOMIC_RELAXED);
+		want = spdk_max(avail, 0);
+	}
+	*local += want;
+
+	return *local > 0;
+}
+
+static bool
+nvmf_qos_reserve_all(struct nvmf_qos_bucket *buckets, int64_t *local)
+{
+	bool ok = true;
+	int i;
+
+	for (i = 0; i < NVMF_QOS_NUM_COUNTERS; i++) {
+		ok = nvmf_qos_reserve(&buckets[i], &local[i]) && ok;
+	}
+
+	return ok;
+}
+
+static inline bool
+nvmf_qos_rule_has_min(struct nvmf_qos_rule *rule)
+{
+	return rule->min[NVMF_QOS_IOS].quota != 0 || rule->min[NVMF_QOS_BYTES].quota != 0;
+}
+
+static int
+nvmf_qos_match(struct spdk_nvmf_subsystem_poll_group *sgroup, struct spdk_nvmf_request *req,
+	       struct nvmf_qos_pg_rule **matches)
+{
+	struct spdk_nvmf_ctrlr *ctrlr = req->qpair->ctrlr;
+	uint32_t nsid = req->cmd->nvme_cmd.nsid;
+	struct nvmf_qos_pg_rule *pg_rule;
+	struct nvmf_qos_rule *rule;
+	int count = 0;
+
+	TAILQ_FOREACH(pg_rule, &sgroup->qos_rules, link) {
+		rule = pg_rule->rule;
+		if ((rule->nsid == 0 || rule->nsid == nsid) &&
+		    (rule->hostnqn[0] == '\0' || strcmp(rule->hostnqn, ctrlr->hostnqn) == 0)) {
+			matches[count++] = pg_rule;
+			if (count == NVMF_QOS_MAX_MATCHES) {
+				break;
+			}
+		}
+	}
+
+	return count;
+}
+
+static void
+nvmf_qos_charge(struct nvmf_qos_pg_rule *pg_rule, struct spdk_nvmf_request *req)
+{
+	struct nvmf_qos_rule *rule = pg_rule->rule;
+	int64_t cost[NVMF_QOS_NUM_COUNTERS] = { 1, req->length };
+	int i;
+
+	for (i = 0; i < NVMF_QOS_NUM_COUNTERS; i++) {
+		if (rule->max[i].quota != 0) {
+			pg_rule->max[i] -= cost[i];
+		}
+		if (rule->min[i].quota != 0) {
+			pg_rule->min[i] -= cost[i];
+		}
+	}
+	pg_rule->ios++;
+	pg_rule->bytes += req->length;
+}
+
+/*
+ * Try to admit a request.  Returns the rule that's over its limits, if any.  A request can
+ * always go if it's within the minimum of its host, in which case the limits of the rules
+ * that aren't specific to the host are exceeded.
+ */
+static struct nvmf_qos_pg_rule *
+nvmf_qos_try_admit(struct spdk_nvmf_subsystem_poll_group *sgroup, struct spdk_nvmf_request *req,
+		   bool from_queue)
+{
+	struct nvmf_qos_pg_rule *matches[NVMF_QOS_MAX_MATCHES];
+	struct nvmf_qos_pg_rule *pg_rule, *limited = NULL, *shared_limited = NULL;
+	uint64_t now;
+	bool guaranteed = false;
+	int count, i;
+
+	count = nvmf_qos_match(sgroup, req, matches);
+	if (count == 0) {
+		return NULL;
+	}
+
+	now = nvmf_qos_get_slice();
+	for (i = 0; i < count; i++) {
+		pg_rule = matches[i];
+		nvmf_qos_pg_rule_refresh(pg_rule, now);
+
+		/* Don't overtake the requests that are already waiting */
+		if (!from_queue && !TAILQ_EMPTY(&pg_rule->queued)) {
+			return pg_rule;
+		}
+
+		if (!nvmf_qos_reserve_all(pg_rule->rule->max, pg_rule->max)) {
+			if (pg_rule->rule->hostnqn[0] != '\0') {
+				limited = limited ? limited : pg_rule;
+			} else {
+				shared_limited = shared_limited ? shared_limited : pg_rule;
+			}
+		}
+	}
+
+	if (limited != NULL) {
+		return limited;
+	}
+
+	if (shared_limited != NULL) {
+		for (i = 0; i < count && !guaranteed; i++) {
+			pg_rule = matches[i];
+			if (pg_rule->rule->hostnqn[0] != '\0' && nvmf_qos_rule_has_min(pg_rule->rule)) {
+				guaranteed = nvmf_qos_reserve_all(pg_rule->rule->min, pg_rule->min);
+			}
+		}
+		if (!guaranteed) {
+			return shared_limited;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		nvmf_qos_charge(matches[i], req);
+	}
+
+	return NULL;
+}
+
+static int
+nvmf_poll_group_qos_poll(void *ctx)
+{
+	struct spdk_nvmf_poll_group *group = ctx;
+	struct spdk_nvmf_subsystem_poll_group *sgroup;
+	struct nvmf_qos_pg_rule *pg_rule;
+	struct spdk_nvmf_request *req;
+	uint64_t queued = 0;
+	uint32_t sid;
+	int count = 0;
+
+	for (sid = 0; sid < group->num_sgroups; sid++) {
+		sgroup = &group->sgroups[sid];
+		TAILQ_FOREACH(pg_rule, &sgroup->qos_rules, link) {
+			while ((req = TAILQ_FIRST(&pg_rule->queued)) != NULL) {
+				if (spdk_likely(spdk_nvmf_qpair_is_active(req->qpair)) &&
+				    nvmf_qos_try_admit(sgroup, req, true) != NULL) {
+					break;
+				}
+				TAILQ_REMOVE(&pg_rule->queued, req, qos_link);
+				pg_rule->queued_ios--;
+				count++;
+				nvmf_qos_resubmit(req);
+			}
+			queued += pg_rule->queued_ios;
+		}
+	}
+
+	if (queued == 0) {
+		spdk_poller_unregister(&group->qos_poller);
+	}
+
+	return count > 0 ? SPDK_POLLER_BUSY : SPDK_POLLER_IDLE;
+}
+
+bool
+nvmf_qos_admit(struct spdk_nvmf_poll_group *group, struct spdk_nvmf_subsystem_poll_group *sgroup,
+	       struct spdk_nvmf_request *req)
+{
+	struct nvmf_qos_pg_rule *pg_rule;
+
+	/* The first command of a fused pair has to be followed by the second one */
+	if (spdk_unlikely(req->cmd->nvme_cmd.fuse != SPDK_NVME_CMD_FUSE_NONE)) {
+		return true;
+	}
+
+	pg_rule = nvmf_qos_try_admit(sgroup, req, false);
+	if (pg_rule == NULL) {
+		return true;
+	}
+
+	if (group->qos_poller == NULL) {
+		group->qos_poller = SPDK_POLLER_REGISTER(nvmf_poll_group_qos_poll, group,
+				    NVMF_QOS_TIMESLICE_IN_USEC);
+		if (group->qos_poller == NULL) {
+			SPDK_ERRLOG("Unable to register the QoS poller, not throttling\n");
+			return true;
+		}
+	}
+
+	TAILQ_INSERT_TAIL(&pg_rule->queued, req, qos_link);
+	pg_rule->throttled_ios++;
+	pg_rule->queued_ios++;
+
+	return false;
+}
+
+static void
+nvmf_qos_pg_rule_free(struct nvmf_qos_pg_rule *pg_rule)
+{
+	struct spdk_nvmf_request *req;
+
+	/* The rule is gone, so let its queued requests through */
+	while ((req = TAILQ_FIRST(&pg_rule->queued)) != NULL) {
+		TAILQ_REMOVE(&pg_rule->queued, req, qos_link);
+		nvmf_qos_resubmit(req);
+	}
+
+	nvmf_qos_rule_put(pg_rule->rule);
+	free(pg_rule);
+}
+
+int
+nvmf_poll_group_qos_update(struct spdk_nvmf_subsystem_poll_group *sgroup,
+			   struct spdk_nvmf_subsystem *subsystem)
+{
+	struct nvmf_qos_pg_rule *pg_rule, *tmp;
+	struct nvmf_qos_rule *rule;
+	TAILQ_HEAD(, nvmf_qos_pg_rule) old_rules = TAILQ_HEAD_INITIALIZER(old_rules);
+
+	TAILQ_CONCAT(&old_rules, &sgroup->qos_rules, link);
+
+	TAILQ_FOREACH(rule, &subsystem->qos_rules, link) {
+		TAILQ_FOREACH(pg_rule, &old_rules, link) {
+			if (pg_rule->rule == rule) {
+				break;
+			}
+		}
+
+		if (pg_rule != NULL) {
+			TAILQ_REMOVE(&old_rules, pg_rule, link);
+		} else {
+			pg_rule = calloc(1, sizeof(*pg_rule));
+			if (pg_rule == NULL) {
+				SPDK_ERRLOG("Unable to allocate the QoS state of subsystem %s\n",
+					    subsystem->subnqn);
+				TAILQ_CONCAT(&sgroup->qos_rules, &old_rules, link);
+				return -ENOMEM;
+			}
+			pg_rule->rule = rule;
+			TAILQ_INIT(&pg_rule->queued);
+			__atomic_fetch_add(&rule->ref, 1, __ATOMIC_RELAXED);
+		}
+
+		TAILQ_INSERT_TAIL(&sgroup->qos_rules, pg_rule, link);
+	}
+
+	TAILQ_FOREACH_SAFE(pg_rule, &old_rules, link, tmp) {
+		TAILQ_REMOVE(&old_rules, pg_rule, link);
+		nvmf_qos_pg_rule_free(pg_rule);
+	}
+
+	return 0;
+}
+
+void
+nvmf_poll_group_qos_destroy(struct spdk_nvmf_subsystem_poll_group *sgroup)
+{
+	struct nvmf_qos_pg_rule *pg_rule;
+
+	while ((pg_rule = TAILQ_FIRST(&sgroup->qos_rules)) != NULL) {
+		TAILQ_REMOVE(&sgroup->qos_rules, pg_rule, link);
+		nvmf_qos_pg_rule_free(pg_rule);
+	}
+}
+
+void
+nvmf_poll_group_qos_dump_stat(struct spdk_nvmf_poll_group *group, struct spdk_json_write_ctx *w)
+{
+	struct spdk_nvmf_subsystem_poll_group *sgroup;
+	struct nvmf_qos_pg_rule *pg_rule;
+	struct nvmf_qos_rule *rule;
+	uint32_t sid;
+
+	spdk_json_write_named_array_begin(w, "qos");
+	for (sid = 0; sid < group->num_sgroups; sid++) {
+		sgroup = &group->sgroups[sid];
+		TAILQ_FOREACH(pg_rule, &sgroup->qos_rules, link) {
+			rule = pg_rule->rule;
+			spdk_json_write_object_begin(w);
+			spdk_json_write_named_string(w, "nqn", rule->subsystem->subnqn);
+			if (rule->hostnqn[0] != '\0') {
+				spdk_json_write_named_string(w, "host", rule->hostnqn);
+			}
+			if (rule->nsid != 0) {
+				spdk_json_write_named_uint32(w, "nsid", rule->nsid);
+			}
+			spdk_json_write_named_uint64(w, "ios", pg_rule->ios);
+			spdk_json_write_named_uint64(w, "bytes", pg_rule->bytes);
+			spdk_json_write_named_uint64(w, "throttled_ios", pg_rule->throttled_ios);
+			spdk_json_write_named_uint64(w, "queued_ios", pg_rule->queued_ios);
+			spdk_json_write_object_end(w);
+		}
+	}
+	spdk_json_write_array_end(w);
+}
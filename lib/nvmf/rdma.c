@@ -38,6 +38,10 @@ const struct spdk_nvmf_transport_ops spdk_nvmf_transport_rdma;
 
 #define NVMF_RDMA_MAX_EVENTS_PER_POLL	32
 
+/* Granularity of the SRQ receive buffer allocations when the SRQ depth is adaptive */
+#define NVMF_RDMA_SRQ_CHUNK_SIZE	128
+#define NVMF_RDMA_SRQ_SCALE_PERIOD_US	(1000 * 1000)
+
 SPDK_STATIC_ASSERT(NVMF_DEFAULT_MSDBD <= SPDK_NVMF_MAX_SGL_ENTRIES,
 		   "MSDBD must not exceed SPDK_NVMF_MAX_SGL_ENTRIES");
 
@@ -268,6 +272,9 @@ struct spdk_nvmf_rdma_resource_opts {
 	struct spdk_rdma_utils_mem_map	*map;
 	uint32_t			max_queue_depth;
 	uint32_t			in_capsule_data_size;
+	/* When non-zero, in capsule data buffers are allocated on demand for this many receives
+	 * at a time and the receives aren't posted at creation. */
+	uint32_t			buf_chunk_size;
 	bool				shared;
 };
 
@@ -293,6 +300,16 @@ struct spdk_nvmf_rdma_resources {
 	 */
 	void					*bufs;
 
+	/* Array of in capsule data buffers allocated on demand, each of them
+	 * covering "buf_chunk_size" receives. Used instead of bufs when
+	 * buf_chunk_size is non-zero.
+	 */
+	void					**buf_chunks;
+	uint32_t				buf_chunk_size;
+	uint32_t				max_queue_depth;
+	uint32_t				in_capsule_data_size;
+	struct spdk_rdma_utils_mem_map		*map;
+
 	/* Receives that are waiting for a request object */
 	STAILQ_HEAD(, spdk_nvmf_rdma_recv)	incoming_queue;
 
@@ -403,6 +420,10 @@ struct spdk_nvmf_rdma_poller_stat {
 	uint64_t				pending_rdma_read;
 	uint64_t				pending_rdma_write;
 	uint64_t				pending_rdma_send;
+	uint64_t				srq_grows;
+	uint64_t				srq_shrinks;
+	uint64_t				srq_limit_events;
+	uint64_t				srq_budget_exhausted;
 	struct spdk_rdma_provider_qp_stats	qp_stats;
 };
 
@@ -421,6 +442,24 @@ struct spdk_nvmf_rdma_poller {
 	/* Shared receive queue */
 	struct spdk_rdma_provider_srq		*srq;
 
+	/* Adaptive SRQ depth, only the first srq_depth receives are posted */
+	struct spdk_nvmf_rdma_transport		*rtransport;
+	bool					srq_autoscale;
+	/* Set by the SRQ limit reached async event */
+	bool					srq_limit_reached;
+	bool					srq_grow_failed;
+	uint16_t				min_srq_depth;
+	uint16_t				srq_depth;
+	/* Number of receives with in capsule data buffers */
+	uint16_t				srq_alloc_depth;
+	/* Receives consumed by incoming commands and not returned to the SRQ yet */
+	uint16_t				srq_in_use;
+	uint16_t				srq_peak_in_use;
+	uint64_t				srq_next_scale_tsc;
+	/* Returned receives above srq_depth, kept off the SRQ */
+	STAILQ_HEAD(, spdk_nvmf_rdma_recv)	srq_parked;
+	uint32_t				srq_num_parked;
+
 	struct spdk_nvmf_rdma_resources		*resources;
 	struct spdk_nvmf_rdma_poller_stat	stat;
 
@@ -478,6 +517,8 @@ struct spdk_nvmf_rdma_port {
 struct rdma_transport_opts {
 	int		num_cqe;
 	uint32_t	max_srq_depth;
+	uint32_t	min_srq_depth;
+	uint32_t	srq_mem_budget_mb;
 	bool		no_srq;
 	bool		no_wr_batching;
 	int		acceptor_backlog;
@@ -493,6 +534,9 @@ struct spdk_nvmf_rdma_transport {
 
 	struct spdk_mempool		*data_wr_pool;
 
+	/* Memory used by the in capsule data buffers of adaptive SRQs, in bytes */
+	uint64_t			srq_buf_mem;
+
 	struct spdk_poller		*accept_poller;
 
 	/* fields used to poll RDMA/IB events */
@@ -526,6 +570,14 @@ static const struct spdk_json_object_decoder rdma_transport_opts_decoder[] = {
 		"max_srq_depth", offsetof(struct rdma_transport_opts, max_srq_depth),
 		spdk_json_decode_uint32, true
 	},
+	{
+		"min_srq_depth", offsetof(struct rdma_transport_opts, min_srq_depth),
+		spdk_json_decode_uint32, true
+	},
+	{
+		"srq_mem_budget_mb", offsetof(struct rdma_transport_opts, srq_mem_budget_mb),
+		spdk_json_decode_uint32, true
+	},
 	{
 		"no_srq", offsetof(struct rdma_transport_opts, no_srq),
 		spdk_json_decode_bool, true
@@ -660,6 +712,14 @@ nvmf_rdma_dump_qpair_contents(struct spdk_nvmf_rdma_qpair *rqpair)
 static void
 nvmf_rdma_resources_destroy(struct spdk_nvmf_rdma_resources *resources)
 {
+	uint32_t i;
+
+	if (resources->buf_chunks != NULL) {
+		for (i = 0; i < spdk_divide_round_up(resources->max_queue_depth, resources->buf_chunk_size); i++) {
+			spdk_free(resources->buf_chunks[i]);
+		}
+		free(resources->buf_chunks);
+	}
 	spdk_free(resources->cmds);
 	spdk_free(resources->cpls);
 	spdk_free(resources->bufs);
@@ -697,14 +757,26 @@ nvmf_rdma_resources_create(struct spdk_nvmf_rdma_resource_opts *opts)
 	resources->cpls = spdk_zmalloc(opts->max_queue_depth * sizeof(*resources->cpls),
 				       0x1000, NULL, SPDK_ENV_LCORE_ID_ANY, SPDK_MALLOC_DMA);
 
-	if (opts->in_capsule_data_size > 0) {
+	resources->max_queue_depth = opts->max_queue_depth;
+	resources->in_capsule_data_size = opts->in_capsule_data_size;
+	resources->buf_chunk_size = opts->buf_chunk_size;
+	resources->map = opts->map;
+
+	if (opts->buf_chunk_size > 0) {
+		resources->buf_chunks = calloc(spdk_divide_round_up(opts->max_queue_depth, opts->buf_chunk_size),
+					       sizeof(*resources->buf_chunks));
+		if (!resources->buf_chunks) {
+			SPDK_ERRLOG("Unable to allocate sufficient memory for RDMA queue.\n");
+			goto cleanup;
+		}
+	} else if (opts->in_capsule_data_size > 0) {
 		resources->bufs = spdk_zmalloc(opts->max_queue_depth * opts->in_capsule_data_size,
 					       0x1000, NULL, SPDK_ENV_LCORE_ID_ANY,
 					       SPDK_MALLOC_DMA);
 	}
 
 	if (!resources->reqs || !resources->recvs || !resources->cmds ||
-	    !resources->cpls || (opts->in_capsule_data_size && !resources->bufs)) {
+	    !resources->cpls || (opts->in_capsule_data_size && !opts->buf_chunk_size && !resources->bufs)) {
 		SPDK_ERRLOG("Unable to allocate sufficient memory for RDMA queue.\n");
 		goto cleanup;
 	}
@@ -765,6 +837,10 @@ nvmf_rdma_resources_create(struct spdk_nvmf_rdma_resource_opts *opts)
 
 		rdma_recv->wr.wr_id = (uintptr_t)&rdma_recv->rdma_wr;
 		rdma_recv->wr.sg_list = rdma_recv->sgl;
+		if (opts->buf_chunk_size > 0) {
+			/* Posted by the owner once the buffers are allocated */
+			continue;
+		}
 		if (srq) {
 			spdk_rdma_provider_srq_queue_recv_wrs(srq, &rdma_recv->wr);
 		} else {
@@ -834,6 +910,272 @@ cleanup:
 	return NULL;
 }
 
+static int
+nvmf_rdma_resources_alloc_buf_chunk(struct spdk_nvmf_rdma_resources *resources, uint32_t chunk)
+{
+	struct spdk_nvmf_rdma_recv		*rdma_recv;
+	struct spdk_rdma_utils_memory_translation translation;
+	uint32_t				i, first, last;
+	void					*bufs;
+	int					rc;
+
+	assert(resources->buf_chunks != NULL);
+	assert(resources->buf_chunks[chunk] == NULL);
+
+	if (resources->in_capsule_data_size == 0) {
+		return 0;
+	}
+
+	first = chunk * resources->buf_chunk_size;
+	last = spdk_min(first + resources->buf_chunk_size, resources->max_queue_depth);
+
+	bufs = spdk_zmalloc((last - first) * resources->in_capsule_data_size, 0x1000, NULL,
+			    SPDK_ENV_LCORE_ID_ANY, SPDK_MALLOC_DMA);
+	if (!bufs) {
+		return -ENOMEM;
+	}
+
+	for (i = first; i < last; i++) {
+		rdma_recv = &resources->recvs[i];
+		rdma_recv->buf = (void *)((uintptr_t)bufs + (i - first) * resources->in_capsule_data_size);
+		rdma_recv->sgl[1].addr = (uintptr_t)rdma_recv->buf;
+		rdma_recv->sgl[1].length = resources->in_capsule_data_size;
+		rc = spdk_rdma_utils_get_translation(resources->map, rdma_recv->buf,
+						     resources->in_capsule_data_size, &translation);
+		if (rc) {
+			spdk_free(bufs);
+			return rc;
+		}
+		rdma_recv->sgl[1].lkey = spdk_rdma_utils_memory_translation_get_lkey(&translation);
+		rdma_recv->wr.num_sge = 2;
+	}
+
+	resources->buf_chunks[chunk] = bufs;
+
+	return 0;
+}
+
+static void
+nvmf_rdma_resources_free_buf_chunk(struct spdk_nvmf_rdma_resources *resources, uint32_t chunk)
+{
+	uint32_t i, first, last;
+
+	first = chunk * resources->buf_chunk_size;
+	last = spdk_min(first + resources->buf_chunk_size, resources->max_queue_depth);
+
+	for (i = first; i < last; i++) {
+		resources->recvs[i].buf = NULL;
+		resources->recvs[i].wr.num_sge = 1;
+	}
+
+	spdk_free(resources->buf_chunks[chunk]);
+	resources->buf_chunks[chunk] = NULL;
+}
+
+static inline uint32_t
+nvmf_rdma_recv_index(struct spdk_nvmf_rdma_resources *resources, struct spdk_nvmf_rdma_recv *rdma_recv)
+{
+	return rdma_recv - resources->recvs;
+}
+
+/* Return a consumed receive to the poller's SRQ. With an adaptive SRQ depth, receives
+ * above the current depth are parked instead, so that their buffers can be released. */
+static void
+nvmf_rdma_srq_queue_recv(struct spdk_nvmf_rdma_poller *rpoller, struct spdk_nvmf_rdma_recv *rdma_recv)
+{
+	assert(rpoller->srq_in_use > 0);
+	rpoller->srq_in_use--;
+
+	if (spdk_unlikely(rpoller->srq_autoscale &&
+			  nvmf_rdma_recv_index(rpoller->resources, rdma_recv) >= rpoller->srq_depth)) {
+		STAILQ_INSERT_HEAD(&rpoller->srq_parked, rdma_recv, link);
+		rpoller->srq_num_parked++;
+		return;
+	}
+
+	spdk_rdma_provider_srq_queue_recv_wrs(rpoller->srq, &rdma_recv->wr);
+}
+
+static bool
+nvmf_rdma_srq_mem_get(struct spdk_nvmf_rdma_transport *rtransport, uint64_t size, bool force)
+{
+	uint64_t budget = (uint64_t)rtransport->rdma_opts.srq_mem_budget_mb * 1024 * 1024;
+	uint64_t cur = __atomic_load_n(&rtransport->srq_buf_mem, __ATOMIC_RELAXED);
+
+	do {
+		if (!force && budget != 0 && cur + size > budget) {
+			return false;
+		}
+	} while (!__atomic_compare_exchange_n(&rtransport->srq_buf_mem, &cur, cur + size, true,
+					      __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	return true;
+}
+
+static void
+nvmf_rdma_srq_mem_put(struct spdk_nvmf_rdma_transport *rtransport, uint64_t size)
+{
+	__atomic_fetch_sub(&rtransport->srq_buf_mem, size, __ATOMIC_RELAXED);
+}
+
+static void
+nvmf_rdma_poller_srq_arm_limit(struct spdk_nvmf_rdma_poller *rpoller)
+{
+	struct ibv_srq_attr attr = {};
+
+	if (rpoller->srq_depth >= rpoller->max_srq_depth) {
+		/* Nothing left to grow */
+		return;
+	}
+
+	/* The event fires once fewer than srq_limit receives are left posted */
+	attr.srq_limit = rpoller->srq_depth / 4;
+	if (ibv_modify_srq(rpoller->srq->srq, &attr, IBV_SRQ_LIMIT)) {
+		SPDK_DEBUGLOG(rdma, "Unable to arm the limit of SRQ %p, errno %d\n", rpoller->srq, errno);
+	}
+}
+
+/* Grow the number of receives posted to the SRQ up to depth, allocating the in capsule
+ * data buffers as needed. Unless forced, the allocations are bound by the transport's
+ * memory budget. */
+static int
+nvmf_rdma_poller_srq_grow(struct spdk_nvmf_rdma_transport *rtransport,
+			  struct spdk_nvmf_rdma_poller *rpoller, uint16_t depth, bool force)
+{
+	struct spdk_nvmf_rdma_resources	*resources = rpoller->resources;
+	STAILQ_HEAD(, spdk_nvmf_rdma_recv) parked = STAILQ_HEAD_INITIALIZER(parked);
+	struct spdk_nvmf_rdma_recv	*rdma_recv;
+	struct ibv_recv_wr		*bad_wr = NULL;
+	uint32_t			chunk, num_recvs;
+	uint64_t			size;
+	int				rc;
+
+	depth = spdk_min(depth, rpoller->max_srq_depth);
+	while (rpoller->srq_alloc_depth < depth) {
+		chunk = rpoller->srq_alloc_depth / resources->buf_chunk_size;
+		num_recvs = spdk_min(resources->buf_chunk_size,
+				     (uint32_t)(rpoller->max_srq_depth - rpoller->srq_alloc_depth));
+		size = (uint64_t)num_recvs * resources->in_capsule_data_size;
+
+		if (!nvmf_rdma_srq_mem_get(rtransport, size, force)) {
+			rpoller->stat.srq_budget_exhausted++;
+			break;
+		}
+
+		rc = nvmf_rdma_resources_alloc_buf_chunk(resources, chunk);
+		if (rc) {
+			nvmf_rdma_srq_mem_put(rtransport, size);
+			SPDK_ERRLOG("Unable to allocate SRQ receive buffers for poller %p, rc %d\n", rpoller, rc);
+			break;
+		}
+		rpoller->srq_alloc_depth += num_recvs;
+	}
+
+	depth = spdk_min(depth, rpoller->srq_alloc_depth);
+	if (depth <= rpoller->srq_depth) {
+		return -ENOMEM;
+	}
+
+	SPDK_DEBUGLOG(rdma, "Growing SRQ of poller %p from %u to %u\n", rpoller, rpoller->srq_depth, depth);
+	rpoller->srq_depth = depth;
+	if (!force) {
+		rpoller->stat.srq_grows++;
+	}
+
+	STAILQ_CONCAT(&parked, &rpoller->srq_parked);
+	while ((rdma_recv = STAILQ_FIRST(&parked)) != NULL) {
+		STAILQ_REMOVE_HEAD(&parked, link);
+		if (nvmf_rdma_recv_index(resources, rdma_recv) < depth) {
+			rdma_recv->wr.next = NULL;
+			spdk_rdma_provider_srq_queue_recv_wrs(rpoller->srq, &rdma_recv->wr);
+			rpoller->srq_num_parked--;
+		} else {
+			STAILQ_INSERT_TAIL(&rpoller->srq_parked, rdma_recv, link);
+		}
+	}
+
+	rc = spdk_rdma_provider_srq_flush_recv_wrs(rpoller->srq, &bad_wr);
+	if (rc) {
+		SPDK_ERRLOG("Unable to post receives to SRQ %p, rc %d\n", rpoller->srq, rc);
+		return rc;
+	}
+
+	nvmf_rdma_poller_srq_arm_limit(rpoller);
+
+	return 0;
+}
+
+/* Release the buffers above the SRQ depth once all of their receives are parked */
+static void
+nvmf_rdma_poller_srq_release(struct spdk_nvmf_rdma_transport *rtransport,
+			     struct spdk_nvmf_rdma_poller *rpoller)
+{
+	struct spdk_nvmf_rdma_resources	*resources = rpoller->resources;
+	uint32_t			chunk, num_recvs;
+
+	if (rpoller->srq_alloc_depth <= rpoller->srq_depth ||
+	    rpoller->srq_num_parked != (uint32_t)(rpoller->max_srq_depth - rpoller->srq_depth)) {
+		return;
+	}
+
+	while (rpoller->srq_alloc_depth > rpoller->srq_depth) {
+		chunk = (rpoller->srq_alloc_depth - 1) / resources->buf_chunk_size;
+		num_recvs = rpoller->srq_alloc_depth - chunk * resources->buf_chunk_size;
+		if (resources->buf_chunks[chunk] != NULL) {
+			nvmf_rdma_resources_free_buf_chunk(resources, chunk);
+		}
+		nvmf_rdma_srq_mem_put(rtransport, (uint64_t)num_recvs * resources->in_capsule_data_size);
+		rpoller->srq_alloc_depth -= num_recvs;
+	}
+}
+
+/*
+ * Adjust the number of receives posted to the SRQ to the load. The depth doubles when the
+ * SRQ limit event fires or when 3/4 of the receives are in use, and goes down one chunk per
+ * period when less than 1/4 of them were used during the last period.
+ */
+static void
+nvmf_rdma_poller_srq_scale(struct spdk_nvmf_rdma_transport *rtransport,
+			   struct spdk_nvmf_rdma_poller *rpoller, uint64_t now)
+{
+	uint16_t depth;
+
+	rpoller->srq_peak_in_use = spdk_max(rpoller->srq_peak_in_use, rpoller->srq_in_use);
+
+	/* The flag is set by the thread handling the async events */
+	if (spdk_unlikely(__atomic_load_n(&rpoller->srq_limit_reached, __ATOMIC_RELAXED))) {
+		__atomic_store_n(&rpoller->srq_limit_reached, false, __ATOMIC_RELAXED);
+		rpoller->stat.srq_limit_events++;
+		if (nvmf_rdma_poller_srq_grow(rtransport, rpoller, rpoller->srq_depth * 2, false) != 0) {
+			/* Keep listening for the event, it may be possible to grow later */
+			nvmf_rdma_poller_srq_arm_limit(rpoller);
+		}
+	} else if (rpoller->srq_in_use >= rpoller->srq_depth / 4 * 3 &&
+		   rpoller->srq_depth < rpoller->max_srq_depth && !rpoller->srq_grow_failed) {
+		/* Don't retry a failed grow until the next period */
+		rpoller->srq_grow_failed = nvmf_rdma_poller_srq_grow(rtransport, rpoller,
+					   rpoller->srq_depth * 2, false) != 0;
+	}
+
+	if (now < rpoller->srq_next_scale_tsc) {
+		return;
+	}
+	rpoller->srq_next_scale_tsc = now + NVMF_RDMA_SRQ_SCALE_PERIOD_US * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+
+	if (rpoller->srq_peak_in_use < rpoller->srq_depth / 4 && rpoller->srq_depth > rpoller->min_srq_depth) {
+		depth = SPDK_ALIGN_FLOOR(rpoller->srq_depth - 1, NVMF_RDMA_SRQ_CHUNK_SIZE);
+		depth = spdk_max(depth, rpoller->min_srq_depth);
+		SPDK_DEBUGLOG(rdma, "Shrinking SRQ of poller %p from %u to %u\n", rpoller, rpoller->srq_depth, depth);
+		rpoller->srq_depth = depth;
+		rpoller->stat.srq_shrinks++;
+		nvmf_rdma_poller_srq_arm_limit(rpoller);
+	}
+	rpoller->srq_peak_in_use = rpoller->srq_in_use;
+	rpoller->srq_grow_failed = false;
+
+	nvmf_rdma_poller_srq_release(rtransport, rpoller);
+}
+
 static void
 nvmf_rdma_qpair_clean_ibv_events(struct spdk_nvmf_rdma_qpair *rqpair)
 {
@@ -892,7 +1234,7 @@ nvmf_rdma_qpair_destroy(struct spdk_nvmf_rdma_qpair *rqpair)
 			STAILQ_FOREACH_SAFE(rdma_recv, &rqpair->resources->incoming_queue, link, recv_tmp) {
 				if (rqpair == rdma_recv->qpair) {
 					STAILQ_REMOVE(&rqpair->resources->incoming_queue, rdma_recv, spdk_nvmf_rdma_recv, link);
-					spdk_rdma_provider_srq_queue_recv_wrs(rqpair->srq, &rdma_recv->wr);
+					nvmf_rdma_srq_queue_recv(rqpair->poller, rdma_recv);
 					rc = spdk_rdma_provider_srq_flush_recv_wrs(rqpair->srq, &bad_recv_wr);
 					if (rc) {
 						SPDK_ERRLOG("Unable to re-post rx descriptor\n");
@@ -1071,7 +1413,8 @@ nvmf_rdma_qpair_queue_recv_wrs(struct spdk_nvmf_rdma_qpair *rqpair, struct ibv_r
 			struct spdk_nvmf_rdma_transport, transport);
 
 	if (rqpair->srq != NULL) {
-		spdk_rdma_provider_srq_queue_recv_wrs(rqpair->srq, first);
+		assert(first->next == NULL);
+		nvmf_rdma_srq_queue_recv(rqpair->poller, SPDK_CONTAINEROF(first, struct spdk_nvmf_rdma_recv, wr));
 	} else {
 		if (spdk_rdma_provider_qp_queue_recv_wrs(rqpair->rdma_qp, first)) {
 			STAILQ_INSERT_TAIL(&rqpair->poller->qpairs_pending_recv, rqpair, recv_link);
@@ -2678,6 +3021,7 @@ nvmf_rdma_create(struct spdk_nvmf_transport_opts *opts)
 		     "  max_io_qpairs_per_ctrlr=%d, io_unit_size=%d,\n"
 		     "  in_capsule_data_size=%d, max_aq_depth=%d,\n"
 		     "  num_shared_buffers=%d, num_cqe=%d, max_srq_depth=%d, no_srq=%d,"
+		     "  min_srq_depth=%u, srq_mem_budget_mb=%u,"
 		     "  acceptor_backlog=%d, no_wr_batching=%d abort_timeout_sec=%d\n",
 		     opts->max_queue_depth,
 		     opts->max_io_size,
@@ -2689,6 +3033,8 @@ nvmf_rdma_create(struct spdk_nvmf_transport_opts *opts)
 		     rtransport->rdma_opts.num_cqe,
 		     rtransport->rdma_opts.max_srq_depth,
 		     rtransport->rdma_opts.no_srq,
+		     rtransport->rdma_opts.min_srq_depth,
+		     rtransport->rdma_opts.srq_mem_budget_mb,
 		     rtransport->rdma_opts.acceptor_backlog,
 		     rtransport->rdma_opts.no_wr_batching,
 		     opts->abort_timeout_sec);
@@ -2704,6 +3050,12 @@ nvmf_rdma_create(struct spdk_nvmf_transport_opts *opts)
 		rtransport->rdma_opts.acceptor_backlog = SPDK_NVMF_RDMA_ACCEPTOR_BACKLOG;
 	}
 
+	if (rtransport->rdma_opts.min_srq_depth > rtransport->rdma_opts.max_srq_depth) {
+		SPDK_WARNLOG("min_srq_depth (%u) is larger than max_srq_depth (%u), the SRQ depth will not be adaptive\n",
+			     rtransport->rdma_opts.min_srq_depth, rtransport->rdma_opts.max_srq_depth);
+		rtransport->rdma_opts.min_srq_depth = 0;
+	}
+
 	if (opts->num_shared_buffers < (SPDK_NVMF_MAX_SGL_ENTRIES * 2)) {
 		SPDK_ERRLOG("The number of shared data buffers (%d) is less than"
 			    "the minimum number required to guarantee that forward progress can be made (%d)\n",
@@ -2851,6 +3203,8 @@ nvmf_rdma_dump_opts(struct spdk_nvmf_transport *transport, struct spdk_json_writ
 
 	rtransport = SPDK_CONTAINEROF(transport, struct spdk_nvmf_rdma_transport, transport);
 	spdk_json_write_named_uint32(w, "max_srq_depth", rtransport->rdma_opts.max_srq_depth);
+	spdk_json_write_named_uint32(w, "min_srq_depth", rtransport->rdma_opts.min_srq_depth);
+	spdk_json_write_named_uint32(w, "srq_mem_budget_mb", rtransport->rdma_opts.srq_mem_budget_mb);
 	spdk_json_write_named_bool(w, "no_srq", rtransport->rdma_opts.no_srq);
 	if (rtransport->rdma_opts.no_srq == true) {
 		spdk_json_write_named_int32(w, "num_cqe", rtransport->rdma_opts.num_cqe);
@@ -3794,6 +4148,7 @@ nvmf_process_ib_event(struct spdk_nvmf_rdma_device *device)
 {
 	int				rc;
 	struct spdk_nvmf_rdma_qpair	*rqpair = NULL;
+	struct spdk_nvmf_rdma_poller	*rpoller;
 	struct ibv_async_event		event;
 
 	rc = ibv_get_async_event(device->context, &event);
@@ -3862,8 +4217,15 @@ nvmf_process_ib_event(struct spdk_nvmf_rdma_device *device)
 	case IBV_EVENT_LID_CHANGE:
 	case IBV_EVENT_PKEY_CHANGE:
 	case IBV_EVENT_SM_CHANGE:
-	case IBV_EVENT_SRQ_ERR:
 	case IBV_EVENT_SRQ_LIMIT_REACHED:
+		/* Only armed by pollers with an adaptive SRQ depth, which grow on their own thread */
+		rpoller = event.element.srq->srq_context;
+		if (rpoller != NULL) {
+			__atomic_store_n(&rpoller->srq_limit_reached, true, __ATOMIC_RELAXED);
+			break;
+		}
+	/* fallthrough */
+	case IBV_EVENT_SRQ_ERR:
 	case IBV_EVENT_CLIENT_REREGISTER:
 	case IBV_EVENT_GID_CHANGE:
 	case IBV_EVENT_SQ_DRAINED:
@@ -3991,7 +4353,9 @@ nvmf_rdma_poller_create(struct spdk_nvmf_rdma_transport *rtransport,
 {
 	struct spdk_nvmf_rdma_poller		*poller;
 	struct spdk_rdma_provider_srq_init_attr	srq_init_attr;
-	struct spdk_nvmf_rdma_resource_opts	opts;
+	struct spdk_nvmf_rdma_resource_opts	opts = {};
+	struct spdk_nvmf_rdma_recv		*rdma_recv;
+	uint32_t				min_srq_depth, i;
 	int					num_cqe;
 
 	poller = calloc(1, sizeof(*poller));
@@ -4007,6 +4371,7 @@ nvmf_rdma_poller_create(struct spdk_nvmf_rdma_transport *rtransport,
 	RB_INIT(&poller->qpairs);
 	STAILQ_INIT(&poller->qpairs_pending_send);
 	STAILQ_INIT(&poller->qpairs_pending_recv);
+	STAILQ_INIT(&poller->srq_parked);
 
 	TAILQ_INSERT_TAIL(&rgroup->pollers, poller, link);
 	SPDK_DEBUGLOG(rdma, "Create poller %p on device %p in poll group %p.\n", poller, device, rgroup);
@@ -4017,12 +4382,23 @@ nvmf_rdma_poller_create(struct spdk_nvmf_rdma_transport *rtransport,
 		}
 		poller->max_srq_depth = spdk_min((int)rtransport->rdma_opts.max_srq_depth, device->attr.max_srq_wr);
 
+		min_srq_depth = SPDK_ALIGN_CEIL(rtransport->rdma_opts.min_srq_depth, NVMF_RDMA_SRQ_CHUNK_SIZE);
+		if (min_srq_depth != 0 && min_srq_depth < poller->max_srq_depth &&
+		    rtransport->transport.opts.in_capsule_data_size != 0) {
+			poller->srq_autoscale = true;
+			poller->min_srq_depth = min_srq_depth;
+			opts.buf_chunk_size = NVMF_RDMA_SRQ_CHUNK_SIZE;
+		}
+
 		device->num_srq++;
 		memset(&srq_init_attr, 0, sizeof(srq_init_attr));
 		srq_init_attr.pd = device->pd;
 		srq_init_attr.stats = &poller->stat.qp_stats.recv;
 		srq_init_attr.srq_init_attr.attr.max_wr = poller->max_srq_depth;
 		srq_init_attr.srq_init_attr.attr.max_sge = spdk_min(device->attr.max_sge, NVMF_DEFAULT_RX_SGE);
+		if (poller->srq_autoscale) {
+			srq_init_attr.srq_init_attr.srq_context = poller;
+		}
 		poller->srq = spdk_rdma_provider_srq_create(&srq_init_attr);
 		if (!poller->srq) {
 			SPDK_ERRLOG("Unable to create shared receive queue, errno %d\n", errno);
@@ -4041,6 +4417,20 @@ nvmf_rdma_poller_create(struct spdk_nvmf_rdma_transport *rtransport,
 			SPDK_ERRLOG("Unable to allocate resources for shared receive queue.\n");
 			return -1;
 		}
+
+		if (poller->srq_autoscale) {
+			/* Start with all receives parked and post the minimal depth */
+			poller->rtransport = rtransport;
+			for (i = 0; i < poller->max_srq_depth; i++) {
+				rdma_recv = &poller->resources->recvs[i];
+				STAILQ_INSERT_TAIL(&poller->srq_parked, rdma_recv, link);
+			}
+			poller->srq_num_parked = poller->max_srq_depth;
+			if (nvmf_rdma_poller_srq_grow(rtransport, poller, poller->min_srq_depth, true) != 0) {
+				SPDK_ERRLOG("Unable to post the minimal SRQ depth %u\n", poller->min_srq_depth);
+				return -1;
+			}
+		}
 	}
 
 	/*
@@ -4213,6 +4603,10 @@ nvmf_rdma_poller_destroy(struct spdk_nvmf_rdma_poller *poller)
 
 	if (poller->srq) {
 		if (poller->resources) {
+			if (poller->rtransport != NULL) {
+				nvmf_rdma_srq_mem_put(poller->rtransport,
+						      (uint64_t)poller->srq_alloc_depth * poller->resources->in_capsule_data_size);
+			}
 			nvmf_rdma_resources_destroy(poller->resources);
 		}
 		spdk_rdma_provider_srq_destroy(poller->srq);
@@ -4378,7 +4772,7 @@ nvmf_rdma_request_free(struct spdk_nvmf_request *req)
 		int rc;
 		struct ibv_recv_wr *bad_recv_wr;
 
-		spdk_rdma_provider_srq_queue_recv_wrs(rqpair->srq, &rdma_req->recv->wr);
+		nvmf_rdma_srq_queue_recv(rqpair->poller, rdma_req->recv);
 		rc = spdk_rdma_provider_srq_flush_recv_wrs(rqpair->srq, &bad_recv_wr);
 		if (rc) {
 			SPDK_ERRLOG("Unable to re-post rx descriptor\n");
@@ -4474,6 +4868,7 @@ _poller_reset_failed_recvs(struct spdk_nvmf_rdma_poller *rpoller, struct ibv_rec
 		rdma_recv = SPDK_CONTAINEROF(bad_rdma_wr, struct spdk_nvmf_rdma_recv, rdma_wr);
 
 		rdma_recv->qpair->current_recv_depth++;
+		rpoller->srq_in_use++;
 		bad_recv_wr = bad_recv_wr->next;
 		SPDK_ERRLOG("Failed to post a recv for the qpair %p with errno %d\n", rdma_recv->qpair, -rc);
 		spdk_nvmf_qpair_disconnect(&rdma_recv->qpair->qpair);
@@ -4699,6 +5094,7 @@ nvmf_rdma_poller_poll(struct spdk_nvmf_rdma_transport *rtransport,
 			/* rdma_recv->qpair will be invalid if using an SRQ.  In that case we have to get the qpair from the wc. */
 			rdma_recv = SPDK_CONTAINEROF(rdma_wr, struct spdk_nvmf_rdma_recv, rdma_wr);
 			if (rpoller->srq != NULL) {
+				rpoller->srq_in_use++;
 				rdma_recv->qpair = get_rdma_qpair_from_wc(rpoller, &wc[i]);
 				/* It is possible that there are still some completions for destroyed QP
 				 * associated with SRQ. We just ignore these late completions and re-post
@@ -4708,7 +5104,7 @@ nvmf_rdma_poller_poll(struct spdk_nvmf_rdma_transport *rtransport,
 					struct ibv_recv_wr *bad_wr;
 
 					rdma_recv->wr.next = NULL;
-					spdk_rdma_provider_srq_queue_recv_wrs(rpoller->srq, &rdma_recv->wr);
+					nvmf_rdma_srq_queue_recv(rpoller, rdma_recv);
 					rc = spdk_rdma_provider_srq_flush_recv_wrs(rpoller->srq, &bad_wr);
 					if (rc) {
 						SPDK_ERRLOG("Failed to re-post recv WR to SRQ, err %d\n", rc);
@@ -4723,6 +5119,11 @@ nvmf_rdma_poller_poll(struct spdk_nvmf_rdma_transport *rtransport,
 				assert(wc[i].opcode == IBV_WC_RECV);
 				if (rqpair->current_recv_depth >= rqpair->max_queue_depth) {
 					spdk_nvmf_qpair_disconnect(&rqpair->qpair);
+					/* The receive isn't handed to the qpair, so give it back to the SRQ */
+					if (rpoller->srq != NULL) {
+						rdma_recv->wr.next = NULL;
+						nvmf_rdma_srq_queue_recv(rpoller, rdma_recv);
+					}
 					break;
 				}
 			}
@@ -4816,6 +5217,10 @@ nvmf_rdma_poller_poll(struct spdk_nvmf_rdma_transport *rtransport,
 		nvmf_rdma_poller_process_pending_buf_queue(rtransport, rpoller);
 	}
 
+	if (rpoller->srq_autoscale) {
+		nvmf_rdma_poller_srq_scale(rtransport, rpoller, poll_tsc);
+	}
+
 	/* submit outstanding work requests. */
 	_poller_submit_recvs(rtransport, rpoller);
 	_poller_submit_sends(rtransport, rpoller);
@@ -5155,6 +5560,15 @@ nvmf_rdma_poll_group_dump_stat(struct spdk_nvmf_transport_poll_group *group,
 					     rpoller->stat.qp_stats.recv.num_submitted_wrs);
 		spdk_json_write_named_uint64(w, "recv_doorbell_updates",
 					     rpoller->stat.qp_stats.recv.doorbell_updates);
+		if (rpoller->srq_autoscale) {
+			spdk_json_write_named_uint32(w, "srq_depth", rpoller->srq_depth);
+			spdk_json_write_named_uint32(w, "srq_allocated_depth", rpoller->srq_alloc_depth);
+			spdk_json_write_named_uint32(w, "srq_in_use", rpoller->srq_in_use);
+			spdk_json_write_named_uint64(w, "srq_grows", rpoller->stat.srq_grows);
+			spdk_json_write_named_uint64(w, "srq_shrinks", rpoller->stat.srq_shrinks);
+			spdk_json_write_named_uint64(w, "srq_limit_events", rpoller->stat.srq_limit_events);
+			spdk_json_write_named_uint64(w, "srq_budget_exhausted", rpoller->stat.srq_budget_exhausted);
+		}
 		spdk_json_write_object_end(w);
 	}
 
@@ -271,6 +271,9 @@ spdk_nvmf_subsystem_create(struct spdk_nvmf_tgt *tgt,
 	TAILQ_INIT(&subsystem->hosts);
 	TAILQ_INIT(&subsystem->ctrlrs);
 	TAILQ_INIT(&subsystem->state_changes);
+	TAILQ_INIT(&subsystem->qos_rules);
+	TAILQ_INIT(&subsystem->telemetry_baseline);
+	TAILQ_INIT(&subsystem->host_states);
 	subsystem->used_listener_ids = spdk_bit_array_create(NVMF_MAX_LISTENERS_PER_SUBSYSTEM);
 	if (subsystem->used_listener_ids == NULL) {
 		pthread_mutex_destroy(&subsystem->mutex);
@@ -376,6 +379,7 @@ _nvmf_subsystem_destroy(struct spdk_nvmf_subsystem *subsystem)
 	struct spdk_nvmf_ns		*ns;
 	nvmf_subsystem_destroy_cb	async_destroy_cb = NULL;
 	void				*async_destroy_cb_arg = NULL;
+	uint32_t			i;
 	int				rc;
 
 	if (!TAILQ_EMPTY(&subsystem->ctrlrs)) {
@@ -407,6 +411,12 @@ _nvmf_subsystem_destroy(struct spdk_nvmf_subsystem *subsystem)
 		free(ctx);
 	}
 
+	nvmf_subsystem_qos_free(subsystem);
+	nvmf_subsystem_telemetry_free(subsystem);
+	nvmf_ctrlr_free_host_states(subsystem);
+	for (i = 0; i < NVMF_CNTLID_NUM_CHUNKS; i++) {
+		free(subsystem->ctrlr_chunks[i]);
+	}
 	free(subsystem->ns);
 	free(subsystem->ana_group);
 
@@ -872,6 +882,13 @@ send_async_event_ns_notice(struct spdk_nvmf_ctrlr *ctrlr)
 	spdk_thread_send_msg(ctrlr->thread, _async_event_ns_notice, ctrlr);
 }
 
+/* Make the next controllers of each host recompute their namespace state */
+static inline void
+nvmf_subsystem_invalidate_host_states(struct spdk_nvmf_subsystem *subsystem)
+{
+	__atomic_fetch_add(&subsystem->ns_gen, 1, __ATOMIC_RELEASE);
+}
+
 static int
 nvmf_ns_visible(struct spdk_nvmf_subsystem *subsystem,
 		uint32_t nsid,
@@ -917,6 +934,7 @@ nvmf_ns_visible(struct spdk_nvmf_subsystem *subsystem,
 	} else if (!visible && host != NULL) {
 		nvmf_ns_remove_host(ns, host);
 	}
+	nvmf_subsystem_invalidate_host_states(subsystem);
 
 	/* Also apply to existing controllers. */
 	TAILQ_FOREACH(ctrlr, &subsystem->ctrlrs, link) {
@@ -1784,11 +1802,13 @@ spdk_nvmf_subsystem_remove_ns(struct spdk_nvmf_subsystem *subsystem, uint32_t ns
 	TAILQ_FOREACH_SAFE(host, &ns->hosts, link, tmp) {
 		nvmf_ns_remove_host(ns, host);
 	}
+	nvmf_subsystem_invalidate_host_states(subsystem);
 
 	free(ns->ptpl_file);
 	nvmf_ns_reservation_clear_all_registrants(ns);
 	spdk_bdev_module_release_bdev(ns->bdev);
 	spdk_bdev_close(ns->desc);
+	nvmf_ns_read_cache_destroy(ns->read_cache);
 	free(ns);
 
 	if (subsystem->fdp_supported && !spdk_nvmf_subsystem_get_first_ns(subsystem)) {
@@ -2000,6 +2020,7 @@ spdk_nvmf_ns_opts_get_defaults(struct spdk_nvmf_ns_opts *opts, size_t opts_size)
 	}
 	SET_FIELD(anagrpid, 0);
 	SET_FIELD(transport_specific, NULL);
+	SET_FIELD(read_cache_size_mb, 0);
 
 #undef FIELD_OK
 #undef SET_FIELD
@@ -2031,13 +2052,14 @@ nvmf_ns_opts_copy(struct spdk_nvmf_ns_opts *opts,
 	SET_FIELD(anagrpid);
 	SET_FIELD(no_auto_visible);
 	SET_FIELD(transport_specific);
+	SET_FIELD(read_cache_size_mb);
 
 	opts->opts_size = user_opts->opts_size;
 
 	/* We should not remove this statement, but need to update the assert statement
 	 * if we add a new field, and also add a corresponding SET_FIELD statement.
 	 */
-	SPDK_STATIC_ASSERT(sizeof(struct spdk_nvmf_ns_opts) == 72, "Incorrect size");
+	SPDK_STATIC_ASSERT(sizeof(struct spdk_nvmf_ns_opts) == 76, "Incorrect size");
 
 #undef FIELD_OK
 #undef SET_FIELD
@@ -2198,6 +2220,13 @@ spdk_nvmf_subsystem_add_ns_ext(struct spdk_nvmf_subsystem *subsystem, const char
 	/* Cache the zcopy capability of the bdev device */
 	ns->zcopy = spdk_bdev_io_type_supported(ns->bdev, SPDK_BDEV_IO_TYPE_ZCOPY);
 
+	if (opts.read_cache_size_mb != 0) {
+		ns->read_cache = nvmf_ns_read_cache_create(ns->bdev, opts.read_cache_size_mb);
+		if (ns->read_cache == NULL) {
+			goto err;
+		}
+	}
+
 	if (spdk_uuid_is_null(&opts.uuid)) {
 		opts.uuid = *spdk_bdev_get_uuid(ns->bdev);
 	}
@@ -2246,6 +2275,7 @@ spdk_nvmf_subsystem_add_ns_ext(struct spdk_nvmf_subsystem *subsystem, const char
 	ns->opts = opts;
 	ns->subsystem = subsystem;
 	subsystem->ns[opts.nsid - 1] = ns;
+	nvmf_subsystem_invalidate_host_states(subsystem);
 	ns->nsid = opts.nsid;
 	ns->anagrpid = opts.anagrpid;
 	subsystem->ana_group[ns->anagrpid - 1]++;
@@ -2301,6 +2331,7 @@ err:
 	subsystem->ns[opts.nsid - 1] = NULL;
 	spdk_bdev_module_release_bdev(ns->bdev);
 	spdk_bdev_close(ns->desc);
+	nvmf_ns_read_cache_destroy(ns->read_cache);
 	free(ns->ptpl_file);
 	free(ns);
 
@@ -2550,6 +2581,7 @@ nvmf_subsystem_gen_cntlid(struct spdk_nvmf_subsystem *subsystem)
 int
 nvmf_subsystem_add_ctrlr(struct spdk_nvmf_subsystem *subsystem, struct spdk_nvmf_ctrlr *ctrlr)
 {
+	struct spdk_nvmf_ctrlr ***chunk;
 
 	if (ctrlr->dynamic_ctrlr) {
 		ctrlr->cntlid = nvmf_subsystem_gen_cntlid(subsystem);
@@ -2563,6 +2595,20 @@ nvmf_subsystem_add_ctrlr(struct spdk_nvmf_subsystem *subsystem, struct spdk_nvmf
 		return -EEXIST;
 	}
 
+	/* Lookups from other threads may walk the index while the chunk is installed */
+	pthread_mutex_lock(&subsystem->mutex);
+	chunk = &subsystem->ctrlr_chunks[ctrlr->cntlid >> NVMF_CNTLID_CHUNK_SHIFT];
+	if (*chunk == NULL) {
+		*chunk = calloc(NVMF_CNTLID_CHUNK_SIZE, sizeof(**chunk));
+		if (*chunk == NULL) {
+			pthread_mutex_unlock(&subsystem->mutex);
+			SPDK_ERRLOG("Unable to allocate the controller index\n");
+			return -ENOMEM;
+		}
+	}
+	(*chunk)[ctrlr->cntlid & (NVMF_CNTLID_CHUNK_SIZE - 1)] = ctrlr;
+	pthread_mutex_unlock(&subsystem->mutex);
+
 	TAILQ_INSERT_TAIL(&subsystem->ctrlrs, ctrlr, link);
 
 	SPDK_DTRACE_PROBE3(nvmf_subsystem_add_ctrlr, subsystem->subnqn, ctrlr, ctrlr->hostnqn);
@@ -2574,6 +2620,8 @@ void
 nvmf_subsystem_remove_ctrlr(struct spdk_nvmf_subsystem *subsystem,
 			    struct spdk_nvmf_ctrlr *ctrlr)
 {
+	struct spdk_nvmf_ctrlr **chunk;
+
 	SPDK_DTRACE_PROBE3(nvmf_subsystem_remove_ctrlr, subsystem->subnqn, ctrlr, ctrlr->hostnqn);
 
 	assert(spdk_get_thread() == subsystem->thread);
@@ -2581,20 +2629,27 @@ nvmf_subsystem_remove_ctrlr(struct spdk_nvmf_subsystem *subsystem,
 	SPDK_DEBUGLOG(nvmf, "remove ctrlr %p id 0x%x from subsys %p %s\n", ctrlr, ctrlr->cntlid, subsystem,
 		      subsystem->subnqn);
 	TAILQ_REMOVE(&subsystem->ctrlrs, ctrlr, link);
+
+	chunk = subsystem->ctrlr_chunks[ctrlr->cntlid >> NVMF_CNTLID_CHUNK_SHIFT];
+	if (chunk != NULL && chunk[ctrlr->cntlid & (NVMF_CNTLID_CHUNK_SIZE - 1)] == ctrlr) {
+		pthread_mutex_lock(&subsystem->mutex);
+		chunk[ctrlr->cntlid & (NVMF_CNTLID_CHUNK_SIZE - 1)] = NULL;
+		pthread_mutex_unlock(&subsystem->mutex);
+	}
 }
 
+/* Callers outside of the subsystem's thread must hold subsystem->mutex */
 struct spdk_nvmf_ctrlr *
 nvmf_subsystem_get_ctrlr(struct spdk_nvmf_subsystem *subsystem, uint16_t cntlid)
 {
-	struct spdk_nvmf_ctrlr *ctrlr;
+	struct spdk_nvmf_ctrlr **chunk;
 
-	TAILQ_FOREACH(ctrlr, &subsystem->ctrlrs, link) {
-		if (ctrlr->cntlid == cntlid) {
-			return ctrlr;
-		}
+	chunk = subsystem->ctrlr_chunks[cntlid >> NVMF_CNTLID_CHUNK_SHIFT];
+	if (chunk == NULL) {
+		return NULL;
 	}
 
-	return NULL;
+	return chunk[cntlid & (NVMF_CNTLID_CHUNK_SIZE - 1)];
 }
 
 uint32_t
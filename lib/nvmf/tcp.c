@@ -31,6 +31,12 @@
 #define SPDK_NVMF_TCP_DEFAULT_SOCK_PRIORITY 0
 #define SPDK_NVMF_TCP_DEFAULT_CONTROL_MSG_NUM 32
 #define SPDK_NVMF_TCP_DEFAULT_SUCCESS_OPTIMIZATION true
+#define SPDK_NVMF_TCP_DEFAULT_SHARED_BUF_POOL false
+
+/* Number of request PDUs and in-capsule data buffers added to a poll group's shared pool at once */
+#define NVMF_TCP_BUF_POOL_CHUNK_SIZE 32
+/* Number of PDUs a qpair receives headers into when using the shared pool */
+#define NVMF_TCP_QPAIR_RECV_PDU_NUM 4
 
 #define SPDK_NVMF_TCP_MIN_IO_QUEUE_DEPTH 2
 #define SPDK_NVMF_TCP_MAX_IO_QUEUE_DEPTH 65535
@@ -235,6 +241,9 @@ struct spdk_nvmf_tcp_req  {
 	/* In-capsule data buffer */
 	uint8_t					*buf;
 
+	/* Entry of the poll group's shared pool backing pdu and buf, if the pool is used */
+	struct spdk_nvmf_tcp_buf		*pool_buf;
+
 	struct spdk_nvmf_tcp_req		*fused_pair;
 
 	/*
@@ -325,7 +334,12 @@ struct spdk_nvmf_tcp_qpair {
 	void					*fini_cb_arg;
 
 	TAILQ_ENTRY(spdk_nvmf_tcp_qpair)	link;
+
+	/* Set while the qpair is on its poll group's flush list */
 	bool					pending_flush;
+	/* Number of PDUs queued to the socket since it was last flushed */
+	uint32_t				unflushed_pdus;
+	TAILQ_ENTRY(spdk_nvmf_tcp_qpair)	flush_link;
 };
 
 struct spdk_nvmf_tcp_control_msg {
@@ -338,15 +352,69 @@ struct spdk_nvmf_tcp_control_msg_list {
 	STAILQ_HEAD(, spdk_nvmf_tcp_req) waiting_for_msg_reqs;
 };
 
+struct spdk_nvmf_tcp_buf_chunk;
+
+/* A request PDU and an in-capsule data buffer handed out together by the shared pool */
+struct spdk_nvmf_tcp_buf {
+	struct nvme_tcp_pdu			*pdu;
+	void					*buf;
+	struct spdk_nvmf_tcp_buf_chunk		*chunk;
+	TAILQ_ENTRY(spdk_nvmf_tcp_buf)		link;
+};
+
+struct spdk_nvmf_tcp_buf_pool;
+
+struct spdk_nvmf_tcp_buf_chunk {
+	struct spdk_nvmf_tcp_buf_pool		*pool;
+	void					*bufs;
+	struct nvme_tcp_pdu			*pdus;
+	uint32_t				num_free;
+	TAILQ_ENTRY(spdk_nvmf_tcp_buf_chunk)	link;
+	struct spdk_nvmf_tcp_buf		entries[NVMF_TCP_BUF_POOL_CHUNK_SIZE];
+};
+
+/*
+ * Pool of request PDUs and in-capsule data buffers shared by all qpairs of a poll group,
+ * so that the memory used scales with the number of requests in flight rather than with
+ * the number of connections.  It grows by a chunk whenever it runs dry and releases a chunk
+ * once none of its entries is in use and at least another chunk worth of entries is free.
+ */
+struct spdk_nvmf_tcp_buf_pool {
+	TAILQ_HEAD(, spdk_nvmf_tcp_buf)		free_bufs;
+	TAILQ_HEAD(, spdk_nvmf_tcp_buf_chunk)	chunks;
+	uint32_t				buf_size;
+	uint32_t				num_free;
+	uint32_t				num_chunks;
+	uint64_t				num_grows;
+	uint64_t				num_shrinks;
+	/* The poll group is gone, free the pool once the last entry is returned */
+	bool					orphaned;
+};
+
+struct spdk_nvmf_tcp_poll_group_stat {
+	/* PDUs written by the batched per poll group flushes */
+	uint64_t				flushed_pdus;
+	/* Batched flushes that wrote data, i.e. writev/sendmsg calls */
+	uint64_t				flushes;
+	/* C2H data PDUs that carried the SUCCESS flag in place of a capsule response */
+	uint64_t				c2h_success;
+};
+
 struct spdk_nvmf_tcp_poll_group {
 	struct spdk_nvmf_transport_poll_group	group;
 	struct spdk_sock_group			*sock_group;
 
 	TAILQ_HEAD(, spdk_nvmf_tcp_qpair)	qpairs;
 	TAILQ_HEAD(, spdk_nvmf_tcp_qpair)	await_req;
+	/* Qpairs that queued PDUs since the last flush */
+	TAILQ_HEAD(, spdk_nvmf_tcp_qpair)	flush_qpairs;
+	bool					flush_msg_pending;
+
+	struct spdk_nvmf_tcp_poll_group_stat	stat;
 
 	struct spdk_io_channel			*accel_channel;
 	struct spdk_nvmf_tcp_control_msg_list	*control_msg_list;
+	struct spdk_nvmf_tcp_buf_pool		*buf_pool;
 
 	TAILQ_ENTRY(spdk_nvmf_tcp_poll_group)	link;
 };
@@ -360,6 +428,7 @@ struct spdk_nvmf_tcp_port {
 
 struct tcp_transport_opts {
 	bool		c2h_success;
+	bool		shared_buf_pool;
 	uint16_t	control_msg_num;
 	uint32_t	sock_priority;
 };
@@ -404,6 +473,10 @@ static const struct spdk_json_object_decoder tcp_transport_opts_decoder[] = {
 		"sock_priority", offsetof(struct tcp_transport_opts, sock_priority),
 		spdk_json_decode_uint32, true
 	},
+	{
+		"shared_buf_pool", offsetof(struct tcp_transport_opts, shared_buf_pool),
+		spdk_json_decode_bool, true
+	},
 };
 
 static bool nvmf_tcp_req_process(struct spdk_nvmf_tcp_transport *ttransport,
@@ -413,6 +486,170 @@ static void nvmf_tcp_poll_group_destroy(struct spdk_nvmf_transport_poll_group *g
 static void _nvmf_tcp_send_c2h_data(struct spdk_nvmf_tcp_qpair *tqpair,
 				    struct spdk_nvmf_tcp_req *tcp_req);
 
+static void
+nvmf_tcp_buf_chunk_free(struct spdk_nvmf_tcp_buf_chunk *chunk)
+{
+	spdk_free(chunk->bufs);
+	spdk_dma_free(chunk->pdus);
+	free(chunk);
+}
+
+static int
+nvmf_tcp_buf_pool_grow(struct spdk_nvmf_tcp_buf_pool *pool)
+{
+	struct spdk_nvmf_tcp_buf_chunk *chunk;
+	struct spdk_nvmf_tcp_buf *buf;
+	uint32_t i;
+
+	chunk = calloc(1, sizeof(*chunk));
+	if (!chunk) {
+		return -ENOMEM;
+	}
+
+	chunk->pdus = spdk_dma_zmalloc(NVMF_TCP_BUF_POOL_CHUNK_SIZE * sizeof(*chunk->pdus), 0x1000, NULL);
+	if (!chunk->pdus) {
+		nvmf_tcp_buf_chunk_free(chunk);
+		return -ENOMEM;
+	}
+
+	if (pool->buf_size) {
+		chunk->bufs = spdk_zmalloc(NVMF_TCP_BUF_POOL_CHUNK_SIZE * pool->buf_size, 0x1000,
+					   NULL, SPDK_ENV_LCORE_ID_ANY, SPDK_MALLOC_DMA);
+		if (!chunk->bufs) {
+			nvmf_tcp_buf_chunk_free(chunk);
+			return -ENOMEM;
+		}
+	}
+
+	chunk->pool = pool;
+	for (i = 0; i < NVMF_TCP_BUF_POOL_CHUNK_SIZE; i++) {
+		buf = &chunk->entries[i];
+		buf->chunk = chunk;
+		buf->pdu = &chunk->pdus[i];
+		if (chunk->bufs) {
+			buf->buf = (void *)((uintptr_t)chunk->bufs + i * pool->buf_size);
+		}
+		TAILQ_INSERT_TAIL(&pool->free_bufs, buf, link);
+	}
+
+	chunk->num_free = NVMF_TCP_BUF_POOL_CHUNK_SIZE;
+	pool->num_free += NVMF_TCP_BUF_POOL_CHUNK_SIZE;
+	pool->num_chunks++;
+	pool->num_grows++;
+	TAILQ_INSERT_TAIL(&pool->chunks, chunk, link);
+
+	return 0;
+}
+
+static void
+nvmf_tcp_buf_pool_shrink(struct spdk_nvmf_tcp_buf_pool *pool, struct spdk_nvmf_tcp_buf_chunk *chunk)
+{
+	uint32_t i;
+
+	assert(chunk->num_free == NVMF_TCP_BUF_POOL_CHUNK_SIZE);
+	for (i = 0; i < NVMF_TCP_BUF_POOL_CHUNK_SIZE; i++) {
+		TAILQ_REMOVE(&pool->free_bufs, &chunk->entries[i], link);
+	}
+
+	TAILQ_REMOVE(&pool->chunks, chunk, link);
+	pool->num_free -= NVMF_TCP_BUF_POOL_CHUNK_SIZE;
+	pool->num_chunks--;
+	pool->num_shrinks++;
+	nvmf_tcp_buf_chunk_free(chunk);
+}
+
+static struct spdk_nvmf_tcp_buf_pool *
+nvmf_tcp_buf_pool_create(uint32_t buf_size)
+{
+	struct spdk_nvmf_tcp_buf_pool *pool;
+
+	pool = calloc(1, sizeof(*pool));
+	if (!pool) {
+		SPDK_ERRLOG("Failed to allocate memory for the shared buffer pool\n");
+		return NULL;
+	}
+
+	TAILQ_INIT(&pool->free_bufs);
+	TAILQ_INIT(&pool->chunks);
+	pool->buf_size = buf_size;
+
+	return pool;
+}
+
+static void
+nvmf_tcp_buf_pool_free(struct spdk_nvmf_tcp_buf_pool *pool)
+{
+	struct spdk_nvmf_tcp_buf_chunk *chunk;
+
+	while ((chunk = TAILQ_FIRST(&pool->chunks))) {
+		TAILQ_REMOVE(&pool->chunks, chunk, link);
+		nvmf_tcp_buf_chunk_free(chunk);
+	}
+
+	free(pool);
+}
+
+static void
+nvmf_tcp_buf_pool_destroy(struct spdk_nvmf_tcp_buf_pool *pool)
+{
+	if (!pool) {
+		return;
+	}
+
+	/* Requests of qpairs that are still being torn down may hold on to some entries */
+	if (pool->num_free != pool->num_chunks * NVMF_TCP_BUF_POOL_CHUNK_SIZE) {
+		pool->orphaned = true;
+		return;
+	}
+
+	nvmf_tcp_buf_pool_free(pool);
+}
+
+static struct spdk_nvmf_tcp_buf *
+nvmf_tcp_buf_pool_get(struct spdk_nvmf_tcp_buf_pool *pool)
+{
+	struct spdk_nvmf_tcp_buf *buf;
+
+	buf = TAILQ_FIRST(&pool->free_bufs);
+	if (spdk_unlikely(!buf)) {
+		if (nvmf_tcp_buf_pool_grow(pool) != 0) {
+			SPDK_DEBUGLOG(nvmf_tcp, "Unable to grow the shared buffer pool %p\n", pool);
+			return NULL;
+		}
+		buf = TAILQ_FIRST(&pool->free_bufs);
+	}
+
+	TAILQ_REMOVE(&pool->free_bufs, buf, link);
+	pool->num_free--;
+	buf->chunk->num_free--;
+
+	return buf;
+}
+
+static void
+nvmf_tcp_buf_pool_put(struct spdk_nvmf_tcp_buf *buf)
+{
+	struct spdk_nvmf_tcp_buf_chunk *chunk = buf->chunk;
+	struct spdk_nvmf_tcp_buf_pool *pool = chunk->pool;
+
+	/* Reuse the most recently released entries first, they're likely still in cache */
+	TAILQ_INSERT_HEAD(&pool->free_bufs, buf, link);
+	pool->num_free++;
+	chunk->num_free++;
+
+	if (spdk_unlikely(pool->orphaned)) {
+		if (pool->num_free == pool->num_chunks * NVMF_TCP_BUF_POOL_CHUNK_SIZE) {
+			nvmf_tcp_buf_pool_free(pool);
+		}
+		return;
+	}
+
+	if (chunk->num_free == NVMF_TCP_BUF_POOL_CHUNK_SIZE &&
+	    pool->num_free >= 2 * NVMF_TCP_BUF_POOL_CHUNK_SIZE) {
+		nvmf_tcp_buf_pool_shrink(pool, chunk);
+	}
+}
+
 static inline void
 nvmf_tcp_req_set_state(struct spdk_nvmf_tcp_req *tcp_req,
 		       enum spdk_nvmf_tcp_req_state state)
@@ -445,12 +682,25 @@ static struct spdk_nvmf_tcp_req *
 nvmf_tcp_req_get(struct spdk_nvmf_tcp_qpair *tqpair)
 {
 	struct spdk_nvmf_tcp_req *tcp_req;
+	struct spdk_nvmf_tcp_buf *buf;
 
 	tcp_req = TAILQ_FIRST(&tqpair->tcp_req_free_queue);
 	if (spdk_unlikely(!tcp_req)) {
 		return NULL;
 	}
 
+	if (tqpair->group->buf_pool != NULL) {
+		buf = nvmf_tcp_buf_pool_get(tqpair->group->buf_pool);
+		if (spdk_unlikely(!buf)) {
+			return NULL;
+		}
+
+		buf->pdu->qpair = tqpair;
+		tcp_req->pool_buf = buf;
+		tcp_req->pdu = buf->pdu;
+		tcp_req->buf = buf->buf;
+	}
+
 	memset(&tcp_req->rsp, 0, sizeof(tcp_req->rsp));
 	tcp_req->h2c_offset = 0;
 	tcp_req->has_in_capsule_data = false;
@@ -469,6 +719,13 @@ nvmf_tcp_req_put(struct spdk_nvmf_tcp_qpair *tqpair, struct spdk_nvmf_tcp_req *t
 {
 	assert(!tcp_req->pdu_in_use);
 
+	if (tcp_req->pool_buf != NULL) {
+		nvmf_tcp_buf_pool_put(tcp_req->pool_buf);
+		tcp_req->pool_buf = NULL;
+		tcp_req->pdu = NULL;
+		tcp_req->buf = NULL;
+	}
+
 	TAILQ_REMOVE(&tqpair->tcp_req_working_queue, tcp_req, state_link);
 	TAILQ_INSERT_TAIL(&tqpair->tcp_req_free_queue, tcp_req, state_link);
 	tqpair->qpair.queue_depth--;
@@ -659,6 +916,7 @@ nvmf_tcp_dump_opts(struct spdk_nvmf_transport *transport, struct spdk_json_write
 	ttransport = SPDK_CONTAINEROF(transport, struct spdk_nvmf_tcp_transport, transport);
 	spdk_json_write_named_bool(w, "c2h_success", ttransport->tcp_opts.c2h_success);
 	spdk_json_write_named_uint32(w, "sock_priority", ttransport->tcp_opts.sock_priority);
+	spdk_json_write_named_bool(w, "shared_buf_pool", ttransport->tcp_opts.shared_buf_pool);
 }
 
 static void
@@ -726,6 +984,7 @@ nvmf_tcp_create(struct spdk_nvmf_transport_opts *opts)
 	ttransport->tcp_opts.c2h_success = SPDK_NVMF_TCP_DEFAULT_SUCCESS_OPTIMIZATION;
 	ttransport->tcp_opts.sock_priority = SPDK_NVMF_TCP_DEFAULT_SOCK_PRIORITY;
 	ttransport->tcp_opts.control_msg_num = SPDK_NVMF_TCP_DEFAULT_CONTROL_MSG_NUM;
+	ttransport->tcp_opts.shared_buf_pool = SPDK_NVMF_TCP_DEFAULT_SHARED_BUF_POOL;
 	if (opts->transport_specific != NULL &&
 	    spdk_json_decode_object_relaxed(opts->transport_specific, tcp_transport_opts_decoder,
 					    SPDK_COUNTOF(tcp_transport_opts_decoder),
@@ -744,7 +1003,7 @@ nvmf_tcp_create(struct spdk_nvmf_transport_opts *opts)
 		     "  num_shared_buffers=%d, c2h_success=%d,\n"
 		     "  dif_insert_or_strip=%d, sock_priority=%d\n"
 		     "  abort_timeout_sec=%d, control_msg_num=%hu\n"
-		     "  ack_timeout=%d\n",
+		     "  ack_timeout=%d, shared_buf_pool=%d\n",
 		     opts->max_queue_depth,
 		     opts->max_io_size,
 		     opts->max_qpairs_per_ctrlr - 1,
@@ -757,7 +1016,8 @@ nvmf_tcp_create(struct spdk_nvmf_transport_opts *opts)
 		     ttransport->tcp_opts.sock_priority,
 		     opts->abort_timeout_sec,
 		     ttransport->tcp_opts.control_msg_num,
-		     opts->ack_timeout);
+		     opts->ack_timeout,
+		     ttransport->tcp_opts.shared_buf_pool);
 
 	if (ttransport->tcp_opts.sock_priority > SPDK_NVMF_TCP_DEFAULT_MAX_SOCK_PRIORITY) {
 		SPDK_ERRLOG("Unsupported socket_priority=%d, the current range is: 0 to %d\n"
@@ -1180,23 +1440,110 @@ _pdu_write_done(struct nvme_tcp_pdu *pdu, int err)
 	pdu->sock_req.cb_fn(pdu->sock_req.cb_arg, err);
 }
 
+static void
+nvmf_tcp_qpair_remove_flush(struct spdk_nvmf_tcp_qpair *tqpair)
+{
+	if (tqpair->pending_flush) {
+		TAILQ_REMOVE(&tqpair->group->flush_qpairs, tqpair, flush_link);
+		tqpair->pending_flush = false;
+	}
+}
+
+static void nvmf_tcp_qpair_add_flush(struct spdk_nvmf_tcp_qpair *tqpair);
+
+static void
+nvmf_tcp_qpair_flush(struct spdk_nvmf_tcp_qpair *tqpair)
+{
+	struct spdk_nvmf_tcp_poll_group *tgroup = tqpair->group;
+	uint32_t unflushed_pdus = tqpair->unflushed_pdus;
+	int rc, err;
+
+	/* The completions of the PDUs written out may queue new ones, putting the qpair back
+	 * on the list, so it has to be taken off before the socket is flushed */
+	tqpair->unflushed_pdus = 0;
+	nvmf_tcp_qpair_remove_flush(tqpair);
+
+	rc = spdk_sock_flush(tqpair->sock);
+	err = errno;
+	if (rc < 0 && err == EAGAIN) {
+		/* Retry on the next flush */
+		tqpair->unflushed_pdus += unflushed_pdus;
+		nvmf_tcp_qpair_add_flush(tqpair);
+		return;
+	}
+
+	if (rc > 0) {
+		tgroup->stat.flushes++;
+		tgroup->stat.flushed_pdus += unflushed_pdus;
+		if (!TAILQ_EMPTY(&tqpair->sock->queued_reqs)) {
+			/* Partial write, the rest goes out on the next flush */
+			nvmf_tcp_qpair_add_flush(tqpair);
+		}
+	} else if (rc < 0) {
+		SPDK_ERRLOG("Could not write to socket: rc=%d, errno=%d\n", rc, err);
+	}
+}
+
+/* Write out everything the poll group's qpairs queued since the last call, so that all
+ * the PDUs pending on a socket (e.g. C2H data followed by the capsule response) go out
+ * in a single writev/sendmsg instead of one call per PDU. */
+static void
+nvmf_tcp_poll_group_flush(struct spdk_nvmf_tcp_poll_group *tgroup)
+{
+	struct spdk_nvmf_tcp_qpair *tqpair;
+	uint32_t count = 0;
+
+	/* Qpairs that can't be flushed completely are queued again at the tail, so only those
+	 * on the list now are flushed */
+	TAILQ_FOREACH(tqpair, &tgroup->flush_qpairs, flush_link) {
+		count++;
+	}
+
+	while (count-- > 0 && (tqpair = TAILQ_FIRST(&tgroup->flush_qpairs)) != NULL) {
+		nvmf_tcp_qpair_flush(tqpair);
+	}
+}
+
 static void
 tcp_sock_flush_cb(void *arg)
 {
-	struct spdk_nvmf_tcp_qpair *tqpair = arg;
-	int rc = spdk_sock_flush(tqpair->sock);
+	struct spdk_nvmf_tcp_poll_group *tgroup = arg;
+
+	tgroup->flush_msg_pending = false;
+	nvmf_tcp_poll_group_flush(tgroup);
+
+	if (!TAILQ_EMPTY(&tgroup->flush_qpairs)) {
+		tgroup->flush_msg_pending = true;
+		spdk_thread_send_msg(spdk_get_thread(), tcp_sock_flush_cb, tgroup);
+	}
+}
+
+static void
+nvmf_tcp_qpair_add_flush(struct spdk_nvmf_tcp_qpair *tqpair)
+{
+	struct spdk_nvmf_tcp_poll_group *tgroup = tqpair->group;
 
-	if (rc < 0 && errno == EAGAIN) {
-		spdk_thread_send_msg(spdk_get_thread(), tcp_sock_flush_cb, tqpair);
+	if (tqpair->pending_flush) {
 		return;
 	}
 
-	tqpair->pending_flush = false;
-	if (rc < 0) {
-		SPDK_ERRLOG("Could not write to socket: rc=%d, errno=%d\n", rc, errno);
+	tqpair->pending_flush = true;
+	TAILQ_INSERT_TAIL(&tgroup->flush_qpairs, tqpair, flush_link);
+
+	/* In interrupt mode the poll group isn't polled unless a socket has data to read */
+	if (spdk_interrupt_mode_is_enabled() && !tgroup->flush_msg_pending) {
+		tgroup->flush_msg_pending = true;
+		spdk_thread_send_msg(spdk_get_thread(), tcp_sock_flush_cb, tgroup);
 	}
 }
 
+static void
+nvmf_tcp_qpair_queue_flush(struct spdk_nvmf_tcp_qpair *tqpair)
+{
+	tqpair->unflushed_pdus++;
+	nvmf_tcp_qpair_add_flush(tqpair);
+}
+
 static void
 _tcp_write_pdu(struct nvme_tcp_pdu *pdu)
 {
@@ -1220,12 +1567,9 @@ _tcp_write_pdu(struct nvme_tcp_pdu *pdu)
 				    "IC_RESP" : "TERM_REQ", rc, errno);
 			_pdu_write_done(pdu, rc >= 0 ? -EAGAIN : -errno);
 		}
-	} else if (spdk_interrupt_mode_is_enabled()) {
-		/* Async writes must be flushed */
-		if (!tqpair->pending_flush) {
-			tqpair->pending_flush = true;
-			spdk_thread_send_msg(spdk_get_thread(), tcp_sock_flush_cb, tqpair);
-		}
+	} else if (tqpair->group != NULL) {
+		/* Async writes are flushed in a batch by the poll group */
+		nvmf_tcp_qpair_queue_flush(tqpair);
 	}
 }
 
@@ -1335,8 +1679,11 @@ nvmf_tcp_qpair_init_mem_resource(struct spdk_nvmf_tcp_qpair *tqpair)
 	uint32_t i;
 	struct spdk_nvmf_transport_opts *opts;
 	uint32_t in_capsule_data_size;
+	uint32_t num_req_pdus, num_recv_pdus;
+	bool use_pool;
 
 	opts = &tqpair->qpair.transport->opts;
+	use_pool = tqpair->group != NULL && tqpair->group->buf_pool != NULL;
 
 	in_capsule_data_size = opts->in_capsule_data_size;
 	if (opts->dif_insert_or_strip) {
@@ -1345,13 +1692,23 @@ nvmf_tcp_qpair_init_mem_resource(struct spdk_nvmf_tcp_qpair *tqpair)
 
 	tqpair->resource_count = opts->max_queue_depth;
 
+	/* With the shared pool, requests get their PDU and in-capsule data buffer from the poll
+	 * group when they're started and the qpair only keeps a few PDUs to receive headers into. */
+	if (use_pool) {
+		num_req_pdus = 0;
+		num_recv_pdus = spdk_min(tqpair->resource_count, NVMF_TCP_QPAIR_RECV_PDU_NUM);
+	} else {
+		num_req_pdus = tqpair->resource_count;
+		num_recv_pdus = tqpair->resource_count;
+	}
+
 	tqpair->reqs = calloc(tqpair->resource_count, sizeof(*tqpair->reqs));
 	if (!tqpair->reqs) {
 		SPDK_ERRLOG("Unable to allocate reqs on tqpair=%p\n", tqpair);
 		return -1;
 	}
 
-	if (in_capsule_data_size) {
+	if (in_capsule_data_size && !use_pool) {
 		tqpair->bufs = spdk_zmalloc(tqpair->resource_count * in_capsule_data_size, 0x1000,
 					    NULL, SPDK_ENV_LCORE_ID_ANY,
 					    SPDK_MALLOC_DMA);
@@ -1362,7 +1719,7 @@ nvmf_tcp_qpair_init_mem_resource(struct spdk_nvmf_tcp_qpair *tqpair)
 	}
 	/* prepare memory space for receiving pdus and tcp_req */
 	/* Add additional 1 member, which will be used for mgmt_pdu owned by the tqpair */
-	tqpair->pdus = spdk_dma_zmalloc((2 * tqpair->resource_count + 1) * sizeof(*tqpair->pdus), 0x1000,
+	tqpair->pdus = spdk_dma_zmalloc((num_req_pdus + num_recv_pdus + 1) * sizeof(*tqpair->pdus), 0x1000,
 					NULL);
 	if (!tqpair->pdus) {
 		SPDK_ERRLOG("Unable to allocate pdu pool on tqpair =%p.\n", tqpair);
@@ -1375,8 +1732,10 @@ nvmf_tcp_qpair_init_mem_resource(struct spdk_nvmf_tcp_qpair *tqpair)
 		tcp_req->ttag = i + 1;
 		tcp_req->req.qpair = &tqpair->qpair;
 
-		tcp_req->pdu = &tqpair->pdus[i];
-		tcp_req->pdu->qpair = tqpair;
+		if (num_req_pdus) {
+			tcp_req->pdu = &tqpair->pdus[i];
+			tcp_req->pdu->qpair = tqpair;
+		}
 
 		/* Set up memory to receive commands */
 		if (tqpair->bufs) {
@@ -1395,7 +1754,7 @@ nvmf_tcp_qpair_init_mem_resource(struct spdk_nvmf_tcp_qpair *tqpair)
 		tqpair->state_cntr[TCP_REQUEST_STATE_FREE]++;
 	}
 
-	for (; i < 2 * tqpair->resource_count; i++) {
+	for (i = num_req_pdus; i < num_req_pdus + num_recv_pdus; i++) {
 		struct nvme_tcp_pdu *pdu = &tqpair->pdus[i];
 
 		pdu->qpair = tqpair;
@@ -1636,6 +1995,7 @@ nvmf_tcp_poll_group_create(struct spdk_nvmf_transport *transport,
 {
 	struct spdk_nvmf_tcp_transport	*ttransport;
 	struct spdk_nvmf_tcp_poll_group *tgroup;
+	uint32_t in_capsule_data_size;
 	int rc;
 
 	tgroup = calloc(1, sizeof(*tgroup));
@@ -1650,6 +2010,7 @@ nvmf_tcp_poll_group_create(struct spdk_nvmf_transport *transport,
 
 	TAILQ_INIT(&tgroup->qpairs);
 	TAILQ_INIT(&tgroup->await_req);
+	TAILQ_INIT(&tgroup->flush_qpairs);
 
 	ttransport = SPDK_CONTAINEROF(transport, struct spdk_nvmf_tcp_transport, transport);
 
@@ -1663,6 +2024,18 @@ nvmf_tcp_poll_group_create(struct spdk_nvmf_transport *transport,
 		}
 	}
 
+	if (ttransport->tcp_opts.shared_buf_pool) {
+		in_capsule_data_size = transport->opts.in_capsule_data_size;
+		if (transport->opts.dif_insert_or_strip) {
+			in_capsule_data_size = SPDK_BDEV_BUF_SIZE_WITH_MD(in_capsule_data_size);
+		}
+
+		tgroup->buf_pool = nvmf_tcp_buf_pool_create(in_capsule_data_size);
+		if (!tgroup->buf_pool) {
+			goto cleanup;
+		}
+	}
+
 	tgroup->accel_channel = spdk_accel_get_io_channel();
 	if (spdk_unlikely(!tgroup->accel_channel)) {
 		SPDK_ERRLOG("Cannot create accel_channel for tgroup=%p\n", tgroup);
@@ -1740,6 +2113,8 @@ nvmf_tcp_poll_group_destroy(struct spdk_nvmf_transport_poll_group *group)
 		nvmf_tcp_control_msg_list_free(tgroup->control_msg_list);
 	}
 
+	nvmf_tcp_buf_pool_destroy(tgroup->buf_pool);
+
 	if (tgroup->accel_channel) {
 		spdk_put_io_channel(tgroup->accel_channel);
 	}
@@ -1884,6 +2259,12 @@ nvmf_tcp_capsule_cmd_hdr_handle(struct spdk_nvmf_tcp_transport *ttransport,
 			return;
 		}
 
+		/* The shared buffer pool couldn't grow, retry once other requests release their
+		 * buffers. */
+		if (!TAILQ_EMPTY(&tqpair->tcp_req_free_queue)) {
+			return;
+		}
+
 		/* The host sent more commands than the maximum queue depth. */
 		SPDK_ERRLOG("Cannot allocate tcp_req on tqpair=%p\n", tqpair);
 		nvmf_tcp_qpair_set_recv_state(tqpair, NVME_TCP_PDU_RECV_STATE_QUIESCING);
@@ -2049,6 +2430,9 @@ nvmf_tcp_pdu_c2h_data_complete(void *cb_arg)
 	}
 
 	if (tcp_req->pdu->hdr.c2h_data.common.flags & SPDK_NVME_TCP_C2H_DATA_FLAGS_SUCCESS) {
+		if (tqpair->group != NULL) {
+			tqpair->group->stat.c2h_success++;
+		}
 		nvmf_tcp_request_free(tcp_req);
 	} else {
 		nvmf_tcp_send_capsule_resp_pdu(tcp_req, tqpair);
@@ -3348,8 +3732,8 @@ nvmf_tcp_req_process(struct spdk_nvmf_tcp_transport *ttransport,
 				SPDK_DEBUGLOG(nvmf_tcp, "Put buf to control msg list\n");
 				nvmf_tcp_control_msg_put(tgroup->control_msg_list,
 							 tcp_req->req.iov[0].iov_base);
-			} else if (tcp_req->req.zcopy_bdev_io != NULL) {
-				/* If the request has an unreleased zcopy bdev_io, it's either a
+			} else if (spdk_nvmf_request_zcopy_buffers_held(&tcp_req->req)) {
+				/* If the request has unreleased zcopy buffers, it's either a
 				 * read, a failed write, or the qpair is being disconnected */
 				assert(spdk_nvmf_request_using_zcopy(&tcp_req->req));
 				assert(tcp_req->req.xfer == SPDK_NVME_DATA_CONTROLLER_TO_HOST ||
@@ -3435,6 +3819,8 @@ nvmf_tcp_poll_group_add(struct spdk_nvmf_transport_poll_group *group,
 		return -1;
 	}
 
+	/* The memory resources depend on whether the poll group shares a buffer pool */
+	tqpair->group = tgroup;
 	rc = nvmf_tcp_qpair_init_mem_resource(tqpair);
 	if (rc < 0) {
 		SPDK_ERRLOG("Cannot init memory resource info for tqpair=%p\n", tqpair);
@@ -3449,7 +3835,6 @@ nvmf_tcp_poll_group_add(struct spdk_nvmf_transport_poll_group *group,
 		return -1;
 	}
 
-	tqpair->group = tgroup;
 	nvmf_tcp_qpair_set_state(tqpair, NVMF_TCP_QPAIR_STATE_INVALID);
 	TAILQ_INSERT_TAIL(&tgroup->qpairs, tqpair, link);
 
@@ -3478,6 +3863,7 @@ nvmf_tcp_poll_group_remove(struct spdk_nvmf_transport_poll_group *group,
 	TAILQ_REMOVE(&tgroup->qpairs, tqpair, link);
 
 	/* Try to force out any pending writes */
+	nvmf_tcp_qpair_remove_flush(tqpair);
 	spdk_sock_flush(tqpair->sock);
 
 	rc = spdk_sock_group_remove_sock(tgroup->sock_group, tqpair->sock);
@@ -3489,6 +3875,82 @@ nvmf_tcp_poll_group_remove(struct spdk_nvmf_transport_poll_group *group,
 	return rc;
 }
 
+static int
+nvmf_tcp_poll_group_migrate_out(struct spdk_nvmf_transport_poll_group *group,
+				struct spdk_nvmf_qpair *qpair)
+{
+	struct spdk_nvmf_tcp_poll_group	*tgroup;
+	struct spdk_nvmf_tcp_qpair	*tqpair;
+	int				rc;
+
+	tgroup = SPDK_CONTAINEROF(group, struct spdk_nvmf_tcp_poll_group, group);
+	tqpair = SPDK_CONTAINEROF(qpair, struct spdk_nvmf_tcp_qpair, qpair);
+
+	assert(tqpair->group == tgroup);
+
+	/* The qpair can only be moved between PDUs, with every request free and nothing left
+	 * to be written to the socket, as all of that is tied to the current poll group. */
+	if (tqpair->state != NVMF_TCP_QPAIR_STATE_RUNNING ||
+	    tqpair->recv_state != NVME_TCP_PDU_RECV_STATE_AWAIT_PDU_READY ||
+	    tqpair->state_cntr[TCP_REQUEST_STATE_FREE] != tqpair->resource_count ||
+	    tqpair->timeout_poller != NULL) {
+		return -EBUSY;
+	}
+
+	/* A flush that can't complete keeps the qpair on the flush list for the next attempt */
+	if (tqpair->pending_flush) {
+		nvmf_tcp_qpair_flush(tqpair);
+	}
+
+	if (spdk_sock_has_unsent_data(tqpair->sock)) {
+		return -EBUSY;
+	}
+
+	assert(!tqpair->pending_flush);
+
+	rc = spdk_sock_group_remove_sock(tgroup->sock_group, tqpair->sock);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not remove sock from sock_group: %s (%d)\n",
+			    spdk_strerror(errno), errno);
+		return rc;
+	}
+
+	SPDK_DEBUGLOG(nvmf_tcp, "migrate tqpair=%p out of the tgroup=%p\n", tqpair, tgroup);
+	TAILQ_REMOVE(&tgroup->qpairs, tqpair, link);
+	tqpair->group = NULL;
+
+	return 0;
+}
+
+static int
+nvmf_tcp_poll_group_migrate_in(struct spdk_nvmf_transport_poll_group *group,
+			       struct spdk_nvmf_qpair *qpair)
+{
+	struct spdk_nvmf_tcp_poll_group	*tgroup;
+	struct spdk_nvmf_tcp_qpair	*tqpair;
+	int				rc;
+
+	tgroup = SPDK_CONTAINEROF(group, struct spdk_nvmf_tcp_poll_group, group);
+	tqpair = SPDK_CONTAINEROF(qpair, struct spdk_nvmf_tcp_qpair, qpair);
+
+	assert(tqpair->group == NULL);
+
+	/* Link the qpair first, so that it can be removed from the group if the sock can't be added */
+	SPDK_DEBUGLOG(nvmf_tcp, "migrate tqpair=%p into the tgroup=%p\n", tqpair, tgroup);
+	tqpair->group = tgroup;
+	TAILQ_INSERT_TAIL(&tgroup->qpairs, tqpair, link);
+
+	rc = spdk_sock_group_add_sock(tgroup->sock_group, tqpair->sock,
+				      nvmf_tcp_sock_cb, tqpair);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not add sock to sock_group: %s (%d)\n",
+			    spdk_strerror(errno), errno);
+		return rc;
+	}
+
+	return 0;
+}
+
 static int
 nvmf_tcp_req_complete(struct spdk_nvmf_request *req)
 {
@@ -3563,6 +4025,10 @@ nvmf_tcp_poll_group_poll(struct spdk_nvmf_transport_poll_group *group)
 		return 0;
 	}
 
+	/* Flush what was queued since the last poll before the sock group gets to it, so
+	 * that everything pending on a socket is written by a single call */
+	nvmf_tcp_poll_group_flush(tgroup);
+
 	num_events = spdk_sock_group_poll(tgroup->sock_group);
 	if (spdk_unlikely(num_events < 0)) {
 		SPDK_ERRLOG("Failed to poll sock_group=%p\n", tgroup->sock_group);
@@ -3736,6 +4202,31 @@ nvmf_tcp_qpair_abort_request(struct spdk_nvmf_qpair *qpair,
 	_nvmf_tcp_qpair_abort_request(req);
 }
 
+static void
+nvmf_tcp_poll_group_dump_stat(struct spdk_nvmf_transport_poll_group *group,
+			      struct spdk_json_write_ctx *w)
+{
+	struct spdk_nvmf_tcp_poll_group *tgroup;
+	struct spdk_nvmf_tcp_buf_pool *pool;
+
+	tgroup = SPDK_CONTAINEROF(group, struct spdk_nvmf_tcp_poll_group, group);
+	spdk_json_write_named_uint64(w, "flushed_pdus", tgroup->stat.flushed_pdus);
+	spdk_json_write_named_uint64(w, "flushes", tgroup->stat.flushes);
+	spdk_json_write_named_uint64(w, "c2h_success", tgroup->stat.c2h_success);
+
+	pool = tgroup->buf_pool;
+	if (pool == NULL) {
+		return;
+	}
+
+	spdk_json_write_named_object_begin(w, "shared_buf_pool");
+	spdk_json_write_named_uint32(w, "total", pool->num_chunks * NVMF_TCP_BUF_POOL_CHUNK_SIZE);
+	spdk_json_write_named_uint32(w, "free", pool->num_free);
+	spdk_json_write_named_uint64(w, "grows", pool->num_grows);
+	spdk_json_write_named_uint64(w, "shrinks", pool->num_shrinks);
+	spdk_json_write_object_end(w);
+}
+
 struct tcp_subsystem_add_host_opts {
 	char *psk;
 };
@@ -3962,6 +4453,8 @@ const struct spdk_nvmf_transport_ops spdk_nvmf_transport_tcp = {
 	.poll_group_destroy = nvmf_tcp_poll_group_destroy,
 	.poll_group_add = nvmf_tcp_poll_group_add,
 	.poll_group_remove = nvmf_tcp_poll_group_remove,
+	.poll_group_migrate_out = nvmf_tcp_poll_group_migrate_out,
+	.poll_group_migrate_in = nvmf_tcp_poll_group_migrate_in,
 	.poll_group_poll = nvmf_tcp_poll_group_poll,
 
 	.req_free = nvmf_tcp_req_free,
@@ -3973,6 +4466,7 @@ const struct spdk_nvmf_transport_ops spdk_nvmf_transport_tcp = {
 	.qpair_get_peer_trid = nvmf_tcp_qpair_get_peer_trid,
 	.qpair_get_listen_trid = nvmf_tcp_qpair_get_listen_trid,
 	.qpair_abort_request = nvmf_tcp_qpair_abort_request,
+	.poll_group_dump_stat = nvmf_tcp_poll_group_dump_stat,
 	.subsystem_add_host = nvmf_tcp_subsystem_add_host,
 	.subsystem_remove_host = nvmf_tcp_subsystem_remove_host,
 	.subsystem_dump_host = nvmf_tcp_subsystem_dump_host,
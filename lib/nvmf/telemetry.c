@@ -0,0 +1,634 @@
+/*   SPDX-License-Identifier: BSD-3-Clause
+ *   Copyright (C) 2026 agent. All rights reserved.
+ */
+
+/*
+ * Per host and per namespace I/O telemetry
+ *
+ * Each poll group counts the I/O of the hosts to the namespaces of a subsystem in its own
+ * structures, so the I/O path doesn't take any lock or touch any shared cacheline.  A qpair
+ * remembers the state of its host in its poll group, which only leaves a timestamp on submission
+ * and a few increments on completion.  The counters of all the poll groups are only summed up
+ * when they're read, and the sums of the previous read are kept in the subsystem so that the
+ * difference since then can be reported.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "nvmf_internal.h"
+
+#include "spdk/env.h"
+#include "spdk/histogram_data.h"
+#include "spdk/json.h"
+#include "spdk/likely.h"
+#include "spdk/log.h"
+#include "spdk/string.h"
+#include "spdk/util.h"
+
+/* Latency buckets are powers of two of ticks */
+#define NVMF_TELEMETRY_BUCKET_SHIFT	0
+
+struct nvmf_telemetry_stat {
+	uint64_t				read_ios;
+	uint64_t				write_ios;
+	uint64_t				other_ios;
+	uint64_t				bytes_read;
+	uint64_t				bytes_written;
+	uint64_t				errors;
+	uint64_t				latency_ticks;
+	struct spdk_histogram_data		*latency;
+};
+
+/* Statistics of a namespace in a poll group */
+struct nvmf_telemetry_ns {
+	/* Namespace the statistics were collected for, to drop them if it's replaced */
+	struct spdk_uuid			uuid;
+	struct nvmf_telemetry_stat		stat;
+};
+
+/* Statistics of a host in a poll group */
+struct nvmf_telemetry_host {
+	char					hostnqn[SPDK_NVMF_NQN_MAX_LEN + 1];
+	/* Indexed by nsid - 1, allocated on the first I/O to the namespace */
+	struct nvmf_telemetry_ns		**ns;
+	uint32_t				num_ns;
+
+	TAILQ_ENTRY(nvmf_telemetry_host)	link;
+};
+
+/* Statistics of a host on a namespace summed up over the poll groups */
+struct nvmf_telemetry_entry {
+	char					hostnqn[SPDK_NVMF_NQN_MAX_LEN + 1];
+	uint32_t				nsid;
+	struct nvmf_telemetry_stat		stat;
+
+	TAILQ_ENTRY(nvmf_telemetry_entry)	link;
+};
+
+struct nvmf_telemetry_report {
+	uint64_t				tick_rate;
+	/* Ticks since the previous delta read, 0 if the statistics are the totals */
+	uint64_t				interval_ticks;
+	bool					delta;
+	struct nvmf_telemetry_entries		entries;
+};
+
+struct nvmf_telemetry_collect_ctx {
+	struct spdk_nvmf_tgt			*tgt;
+	char					subnqn[SPDK_NVMF_NQN_MAX_LEN + 1];
+	uint32_t				subsystem_id;
+	char					*hostnqn;
+	uint32_t				nsid;
+	struct nvmf_telemetry_report		*report;
+	int					rc;
+
+	nvmf_telemetry_collect_cb		cb_fn;
+	void					*cb_arg;
+};
+
+static int
+nvmf_telemetry_stat_init(struct nvmf_telemetry_stat *stat)
+{
+	memset(stat, 0, sizeof(*stat));
+	stat->latency = spdk_histogram_data_alloc_sized(NVMF_TELEMETRY_BUCKET_SHIFT);
+
+	return stat->latency != NULL ? 0 : -ENOMEM;
+}
+
+static void
+nvmf_telemetry_stat_fini(struct nvmf_telemetry_stat *stat)
+{
+	spdk_histogram_data_free(stat->latency);
+	stat->latency = NULL;
+}
+
+static void
+nvmf_telemetry_stat_add(struct nvmf_telemetry_stat *dst, const struct nvmf_telemetry_stat *src)
+{
+	dst->read_ios += src->read_ios;
+	dst->write_ios += src->write_ios;
+	dst->other_ios += src->other_ios;
+	dst->bytes_read += src->bytes_read;
+	dst->bytes_written += src->bytes_written;
+	dst->errors += src->errors;
+	dst->latency_ticks += src->latency_ticks;
+	spdk_histogram_data_merge(dst->latency, src->latency);
+}
+
+static inline uint64_t
+nvmf_telemetry_stat_ios(const struct nvmf_telemetry_stat *stat)
+{
+	return stat->read_ios + stat->write_ios + stat->other_ios;
+}
+
+static void
+nvmf_telemetry_stat_reset(struct nvmf_telemetry_stat *stat)
+{
+	struct spdk_histogram_data *latency = stat->latency;
+
+	memset(stat, 0, sizeof(*stat));
+	stat->latency = latency;
+	spdk_histogram_data_reset(latency);
+}
+
+#define NVMF_TELEMETRY_SUB(dst, src) ((dst) -= spdk_min((dst), (src)))
+
+/*
+ * Subtract the sums of a previous read.  The counters don't go below 0 in case the statistics
+ * of a namespace were dropped by some of the poll groups in the meantime.
+ */
+static void
+nvmf_telemetry_stat_sub(struct nvmf_telemetry_stat *dst, const struct nvmf_telemetry_stat *src)
+{
+	uint64_t i;
+
+	NVMF_TELEMETRY_SUB(dst->read_ios, src->read_ios);
+	NVMF_TELEMETRY_SUB(dst->write_ios, src->write_ios);
+	NVMF_TELEMETRY_SUB(dst->other_ios, src->other_ios);
+	NVMF_TELEMETRY_SUB(dst->bytes_read, src->bytes_read);
+	NVMF_TELEMETRY_SUB(dst->bytes_written, src->bytes_written);
+	NVMF_TELEMETRY_SUB(dst->errors, src->errors);
+	NVMF_TELEMETRY_SUB(dst->latency_ticks, src->latency_ticks);
+	for (i = 0; i < SPDK_HISTOGRAM_NUM_BUCKETS(dst->latency); i++) {
+		NVMF_TELEMETRY_SUB(dst->latency->bucket[i], src->latency->bucket[i]);
+	}
+}
+
+static void
+nvmf_telemetry_host_free(struct nvmf_telemetry_host *host)
+{
+	uint32_t i;
+
+	for (i = 0; i < host->num_ns; i++) {
+		if (host->ns[i] != NULL) {
+			nvmf_telemetry_stat_fini(&host->ns[i]->stat);
+			free(host->ns[i]);
+		}
+	}
+	free(host->ns);
+	free(host);
+}
+
+static void
+nvmf_telemetry_entry_free(struct nvmf_telemetry_entry *entry)
+{
+	nvmf_telemetry_stat_fini(&entry->stat);
+	free(entry);
+}
+
+static void
+nvmf_telemetry_entries_free(struct nvmf_telemetry_entries *entries)
+{
+	struct nvmf_telemetry_entry *entry;
+
+	while ((entry = TAILQ_FIRST(entries)) != NULL) {
+		TAILQ_REMOVE(entries, entry, link);
+		nvmf_telemetry_entry_free(entry);
+	}
+}
+
+static struct nvmf_telemetry_entry *
+nvmf_telemetry_entry_get(struct nvmf_telemetry_entries *entries, const char *hostnqn,
+			 uint32_t nsid)
+{
+	struct nvmf_telemetry_entry *entry;
+
+	TAILQ_FOREACH(entry, entries, link) {
+		if (entry->nsid == nsid && strcmp(entry->hostnqn, hostnqn) == 0) {
+			return entry;
+		}
+	}
+
+	entry = calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	if (nvmf_telemetry_stat_init(&entry->stat) != 0) {
+		free(entry);
+		return NULL;
+	}
+	snprintf(entry->hostnqn, sizeof(entry->hostnqn), "%s", hostnqn);
+	entry->nsid = nsid;
+	TAILQ_INSERT_TAIL(entries, entry, link);
+
+	return entry;
+}
+
+int
+spdk_nvmf_subsystem_set_telemetry(struct spdk_nvmf_subsystem *subsystem, bool enable)
+{
+	if (!(subsystem->state == SPDK_NVMF_SUBSYSTEM_INACTIVE ||
+	      subsystem->state == SPDK_NVMF_SUBSYSTEM_PAUSED)) {
+		return -EAGAIN;
+	}
+
+	if (subsystem->telemetry == enable) {
+		return 0;
+	}
+
+	subsystem->telemetry = enable;
+	/* The poll groups drop their statistics along with the telemetry */
+	nvmf_telemetry_entries_free(&subsystem->telemetry_baseline);
+	subsystem->telemetry_baseline_tsc = spdk_get_ticks();
+
+	return 0;
+}
+
+void
+nvmf_subsystem_telemetry_free(struct spdk_nvmf_subsystem *subsystem)
+{
+	nvmf_telemetry_entries_free(&subsystem->telemetry_baseline);
+}
+
+void
+nvmf_subsystem_telemetry_write_config_json(struct spdk_nvmf_subsystem *subsystem,
+		struct spdk_json_write_ctx *w)
+{
+	if (!subsystem->telemetry) {
+		return;
+	}
+
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_string(w, "method", "nvmf_subsystem_set_telemetry");
+	spdk_json_write_named_object_begin(w, "params");
+	spdk_json_write_named_string(w, "nqn", subsystem->subnqn);
+	spdk_json_write_named_bool(w, "enable", true);
+	spdk_json_write_object_end(w);
+	spdk_json_write_object_end(w);
+}
+
+static struct nvmf_telemetry_host *
+nvmf_telemetry_host_get(struct spdk_nvmf_subsystem_poll_group *sgroup, const char *hostnqn)
+{
+	struct nvmf_telemetry_host *host;
+
+	TAILQ_FOREACH(host, &sgroup->telemetry_hosts, link) {
+		if (strcmp(host->hostnqn, hostnqn) == 0) {
+			return host;
+		}
+	}
+
+	host = calloc(1, sizeof(*host));
+	if (host == NULL) {
+		return NULL;
+	}
+
+	snprintf(host->hostnqn, sizeof(host->hostnqn), "%s", hostnqn);
+	TAILQ_INSERT_TAIL(&sgroup->telemetry_hosts, host, link);
+
+	return host;
+}
+
+static struct nvmf_telemetry_ns *
+nvmf_telemetry_ns_get(struct spdk_nvmf_subsystem_poll_group *sgroup,
+		      struct nvmf_telemetry_host *host, uint32_t nsid)
+{
+	struct nvmf_telemetry_ns **ns_array, *ns;
+
+	if (spdk_unlikely(nsid > host->num_ns)) {
+		ns_array = realloc(host->ns, nsid * sizeof(*ns_array));
+		if (ns_array == NULL) {
+			return NULL;
+		}
+		memset(&ns_array[host->num_ns], 0, (nsid - host->num_ns) * sizeof(*ns_array));
+		host->ns = ns_array;
+		host->num_ns = nsid;
+	}
+
+	ns = host->ns[nsid - 1];
+	if (spdk_likely(ns != NULL)) {
+		return ns;
+	}
+
+	ns = calloc(1, sizeof(*ns));
+	if (ns == NULL) {
+		return NULL;
+	}
+
+	if (nvmf_telemetry_stat_init(&ns->stat) != 0) {
+		free(ns);
+		return NULL;
+	}
+	ns->uuid = sgroup->ns_info[nsid - 1].uuid;
+	host->ns[nsid - 1] = ns;
+
+	return ns;
+}
+
+void
+nvmf_telemetry_record(struct spdk_nvmf_subsystem_poll_group *sgroup, struct spdk_nvmf_request *req)
+{
+	struct spdk_nvmf_qpair *qpair = req->qpair;
+	struct spdk_nvme_cmd *cmd = &req->cmd->nvme_cmd;
+	struct spdk_nvme_cpl *rsp = &req->rsp->nvme_cpl;
+	struct nvmf_telemetry_host *host;
+	struct nvmf_telemetry_ns *ns;
+	struct nvmf_telemetry_stat *stat;
+	uint64_t ticks;
+
+	/* The telemetry might have been disabled while the request was queued by the QoS */
+	if (spdk_unlikely(!sgroup->telemetry || cmd->nsid == 0 || cmd->nsid > sgroup->num_ns)) {
+		return;
+	}
+
+	if (spdk_unlikely(qpair->telemetry_gen != sgroup->telemetry_gen)) {
+		host = nvmf_telemetry_host_get(sgroup, qpair->ctrlr->hostnqn);
+		if (host == NULL) {
+			return;
+		}
+		qpair->telemetry_host = host;
+		qpair->telemetry_gen = sgroup->telemetry_gen;
+	}
+
+	ns = nvmf_telemetry_ns_get(sgroup, qpair->telemetry_host, cmd->nsid);
+	if (spdk_unlikely(ns == NULL)) {
+		return;
+	}
+
+	stat = &ns->stat;
+	switch (cmd->opc) {
+	case SPDK_NVME_OPC_READ:
+		stat->read_ios++;
+		stat->bytes_read += req->length;
+		break;
+	case SPDK_NVME_OPC_WRITE:
+		stat->write_ios++;
+		stat->bytes_written += req->length;
+		break;
+	default:
+		stat->other_ios++;
+		break;
+	}
+
+	if (spdk_unlikely(spdk_nvme_cpl_is_error(rsp))) {
+		stat->errors++;
+	}
+
+	ticks = spdk_get_ticks() - req->submit_tsc;
+	stat->latency_ticks += ticks;
+	spdk_histogram_data_tally(stat->latency, ticks);
+}
+
+static void
+nvmf_poll_group_telemetry_reset(struct spdk_nvmf_subsystem_poll_group *sgroup)
+{
+	struct nvmf_telemetry_host *host;
+
+	while ((host = TAILQ_FIRST(&sgroup->telemetry_hosts)) != NULL) {
+		TAILQ_REMOVE(&sgroup->telemetry_hosts, host, link);
+		nvmf_telemetry_host_free(host);
+	}
+
+	/* Make the qpairs look their host up again */
+	sgroup->telemetry_gen++;
+}
+
+void
+nvmf_poll_group_telemetry_update(struct spdk_nvmf_subsystem_poll_group *sgroup,
+				 struct spdk_nvmf_subsystem *subsystem)
+{
+	struct nvmf_telemetry_host *host;
+	struct nvmf_telemetry_ns *ns;
+	uint32_t i;
+
+	if (sgroup->telemetry != subsystem->telemetry) {
+		nvmf_poll_group_telemetry_reset(sgroup);
+		sgroup->telemetry = subsystem->telemetry;
+		return;
+	}
+
+	/* Drop the statistics of the namespaces that were removed or replaced */
+	TAILQ_FOREACH(host, &sgroup->telemetry_hosts, link) {
+		for (i = 0; i < host->num_ns; i++) {
+			ns = host->ns[i];
+			if (ns != NULL && (i >= sgroup->num_ns ||
+					   spdk_uuid_compare(&ns->uuid, &sgroup->ns_info[i].uuid) != 0)) {
+				nvmf_telemetry_stat_fini(&ns->stat);
+				free(ns);
+				host->ns[i] = NULL;
+			}
+		}
+	}
+}
+
+void
+nvmf_poll_group_telemetry_destroy(struct spdk_nvmf_subsystem_poll_group *sgroup)
+{
+	nvmf_poll_group_telemetry_reset(sgroup);
+	sgroup->telemetry = false;
+}
+
+static void
+nvmf_telemetry_collect_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct nvmf_telemetry_collect_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct nvmf_telemetry_report *report = ctx->report;
+	struct spdk_nvmf_subsystem *subsystem;
+	struct nvmf_telemetry_entry *entry, *base;
+	uint64_t now = spdk_get_ticks();
+
+	/* The subsystem might have been destroyed in the meantime */
+	subsystem = spdk_nvmf_tgt_find_subsystem(ctx->tgt, ctx->subnqn);
+	if (subsystem == NULL || !subsystem->telemetry) {
+		ctx->rc = -ENODEV;
+	}
+
+	if (ctx->rc == 0 && report->delta) {
+		report->interval_ticks = now - subsystem->telemetry_baseline_tsc;
+		subsystem->telemetry_baseline_tsc = now;
+
+		TAILQ_FOREACH(entry, &report->entries, link) {
+			base = nvmf_telemetry_entry_get(&subsystem->telemetry_baseline, entry->hostnqn,
+							entry->nsid);
+			if (base == NULL) {
+				ctx->rc = -ENOMEM;
+				break;
+			}
+
+			if (nvmf_telemetry_stat_ios(&entry->stat) < nvmf_telemetry_stat_ios(&base->stat)) {
+				/* The statistics were dropped and collected again since the previous read */
+				nvmf_telemetry_stat_reset(&base->stat);
+			}
+
+			/* Report the difference and keep the current sums for the next delta read */
+			nvmf_telemetry_stat_sub(&entry->stat, &base->stat);
+			nvmf_telemetry_stat_add(&base->stat, &entry->stat);
+		}
+	}
+
+	if (ctx->rc != 0) {
+		nvmf_telemetry_report_free(report);
+		report = NULL;
+	}
+
+	ctx->cb_fn(ctx->cb_arg, report, ctx->rc);
+	free(ctx->hostnqn);
+	free(ctx);
+}
+
+static void
+nvmf_telemetry_collect_pg(struct spdk_io_channel_iter *i)
+{
+	struct nvmf_telemetry_collect_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct spdk_nvmf_poll_group *group = spdk_io_channel_get_ctx(ch);
+	struct spdk_nvmf_subsystem_poll_group *sgroup;
+	struct nvmf_telemetry_host *host;
+	struct nvmf_telemetry_entry *entry;
+	uint32_t nsid;
+
+	if (ctx->rc != 0 || ctx->subsystem_id >= group->num_sgroups) {
+		goto done;
+	}
+
+	sgroup = &group->sgroups[ctx->subsystem_id];
+	TAILQ_FOREACH(host, &sgroup->telemetry_hosts, link) {
+		if (ctx->hostnqn != NULL && strcmp(ctx->hostnqn, host->hostnqn) != 0) {
+			continue;
+		}
+		for (nsid = 1; nsid <= host->num_ns; nsid++) {
+			if (host->ns[nsid - 1] == NULL || (ctx->nsid != 0 && ctx->nsid != nsid)) {
+				continue;
+			}
+			entry = nvmf_telemetry_entry_get(&ctx->report->entries, host->hostnqn, nsid);
+			if (entry == NULL) {
+				ctx->rc = -ENOMEM;
+				goto done;
+			}
+			nvmf_telemetry_stat_add(&entry->stat, &host->ns[nsid - 1]->stat);
+		}
+	}
+
+done:
+	spdk_for_each_channel_continue(i, 0);
+}
+
+int
+nvmf_subsystem_telemetry_collect(struct spdk_nvmf_subsystem *subsystem, const char *hostnqn,
+				 uint32_t nsid, bool delta, nvmf_telemetry_collect_cb cb_fn, void *cb_arg)
+{
+	struct nvmf_telemetry_collect_ctx *ctx;
+
+	if (!subsystem->telemetry) {
+		return -EINVAL;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		return -ENOMEM;
+	}
+
+	ctx->report = calloc(1, sizeof(*ctx->report));
+	if (ctx->report == NULL) {
+		free(ctx);
+		return -ENOMEM;
+	}
+	TAILQ_INIT(&ctx->report->entries);
+	ctx->report->tick_rate = spdk_get_ticks_hz();
+	ctx->report->delta = delta;
+
+	if (hostnqn != NULL) {
+		ctx->hostnqn = strdup(hostnqn);
+		if (ctx->hostnqn == NULL) {
+			nvmf_telemetry_report_free(ctx->report);
+			free(ctx);
+			return -ENOMEM;
+		}
+	}
+
+	ctx->tgt = subsystem->tgt;
+	snprintf(ctx->subnqn, sizeof(ctx->subnqn), "%s", subsystem->subnqn);
+	ctx->subsystem_id = subsystem->id;
+	ctx->nsid = nsid;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+
+	spdk_for_each_channel(subsystem->tgt, nvmf_telemetry_collect_pg, ctx,
+			      nvmf_telemetry_collect_done);
+
+	return 0;
+}
+
+static inline uint64_t
+nvmf_telemetry_ticks_to_nsec(uint64_t ticks, uint64_t tick_rate)
+{
+	return (uint64_t)((double)ticks * SPDK_SEC_TO_NSEC / tick_rate);
+}
+
+struct nvmf_telemetry_histogram_ctx {
+	struct spdk_json_write_ctx	*w;
+	uint64_t			tick_rate;
+};
+
+static void
+nvmf_telemetry_write_bucket(void *cb_arg, uint64_t start, uint64_t end, uint64_t count,
+			    uint64_t total, uint64_t so_far)
+{
+	struct nvmf_telemetry_histogram_ctx *ctx = cb_arg;
+
+	if (count == 0) {
+		return;
+	}
+
+	spdk_json_write_object_begin(ctx->w);
+	spdk_json_write_named_uint64(ctx->w, "start_ns",
+				     nvmf_telemetry_ticks_to_nsec(start, ctx->tick_rate));
+	spdk_json_write_named_uint64(ctx->w, "end_ns",
+				     nvmf_telemetry_ticks_to_nsec(end, ctx->tick_rate));
+	spdk_json_write_named_uint64(ctx->w, "count", count);
+	spdk_json_write_object_end(ctx->w);
+}
+
+void
+nvmf_telemetry_report_write_json(struct nvmf_telemetry_report *report,
+				 struct spdk_json_write_ctx *w)
+{
+	struct nvmf_telemetry_histogram_ctx hctx = { .w = w, .tick_rate = report->tick_rate };
+	struct nvmf_telemetry_entry *entry;
+	struct nvmf_telemetry_stat *stat;
+	uint64_t ios;
+
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_uint64(w, "tick_rate", report->tick_rate);
+	if (report->delta) {
+		spdk_json_write_named_uint64(w, "interval_us",
+					     report->interval_ticks * SPDK_SEC_TO_USEC / report->tick_rate);
+	}
+
+	spdk_json_write_named_array_begin(w, "stats");
+	TAILQ_FOREACH(entry, &report->entries, link) {
+		stat = &entry->stat;
+		ios = nvmf_telemetry_stat_ios(stat);
+
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_string(w, "host", entry->hostnqn);
+		spdk_json_write_named_uint32(w, "nsid", entry->nsid);
+		spdk_json_write_named_uint64(w, "read_ios", stat->read_ios);
+		spdk_json_write_named_uint64(w, "write_ios", stat->write_ios);
+		spdk_json_write_named_uint64(w, "other_ios", stat->other_ios);
+		spdk_json_write_named_uint64(w, "bytes_read", stat->bytes_read);
+		spdk_json_write_named_uint64(w, "bytes_written", stat->bytes_written);
+		spdk_json_write_named_uint64(w, "errors", stat->errors);
+		spdk_json_write_named_uint64(w, "avg_latency_ns",
+					     ios ? nvmf_telemetry_ticks_to_nsec(stat->latency_ticks / ios,
+							     report->tick_rate) : 0);
+		spdk_json_write_named_array_begin(w, "latency_histogram");
+		spdk_histogram_data_iterate(stat->latency, nvmf_telemetry_write_bucket, &hctx);
+		spdk_json_write_array_end(w);
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+	spdk_json_write_object_end(w);
+}
+
+void
+nvmf_telemetry_report_free(struct nvmf_telemetry_report *report)
+{
+	if (report == NULL) {
+		return;
+	}
+
+	nvmf_telemetry_entries_free(&report->entries);
+	free(report);
+}
@@ -31,6 +31,12 @@ int nvmf_transport_poll_group_remove(struct spdk_nvmf_transport_poll_group *grou
 
 int nvmf_transport_poll_group_poll(struct spdk_nvmf_transport_poll_group *group);
 
+int nvmf_transport_poll_group_migrate_out(struct spdk_nvmf_transport_poll_group *group,
+		struct spdk_nvmf_qpair *qpair);
+
+int nvmf_transport_poll_group_migrate_in(struct spdk_nvmf_transport_poll_group *group,
+		struct spdk_nvmf_qpair *qpair);
+
 int nvmf_transport_req_free(struct spdk_nvmf_request *req);
 
 int nvmf_transport_req_complete(struct spdk_nvmf_request *req);
@@ -311,6 +311,8 @@ struct nvmf_vfio_user_sq {
 
 	/* Whether a shadow doorbell eventidx needs setting. */
 	bool					need_rearm;
+	/* Consecutive polls that found no new commands in the SQ. */
+	uint32_t				idle_polls;
 
 	/* multiple SQs can be mapped to the same CQ */
 	uint16_t				cqid;
@@ -356,6 +358,10 @@ struct nvmf_vfio_user_cq {
 
 	uint32_t				last_head;
 	uint32_t				last_trigger_irq_tail;
+
+	/* Completions posted since the last IRQ when interrupt coalescing is on. */
+	uint32_t				coalesced_cpls;
+	uint64_t				coalesce_deadline;
 };
 
 struct nvmf_vfio_user_poll_group {
@@ -364,6 +370,8 @@ struct nvmf_vfio_user_poll_group {
 	TAILQ_HEAD(, nvmf_vfio_user_sq)		sqs;
 	struct spdk_interrupt			*intr;
 	int					intr_fd;
+	/* Fires the coalesced IRQs whose aggregation time expired. */
+	struct spdk_poller			*coalesce_poller;
 	struct {
 
 		/*
@@ -409,6 +417,19 @@ struct nvmf_vfio_user_poll_group {
 		 */
 		uint64_t rearms;
 
+		/*
+		 * Number of times an SQ was kept in polling mode instead of
+		 * being rearmed, as it had been active recently.
+		 */
+		uint64_t adaptive_polls;
+
+		/*
+		 * IRQs held back by interrupt coalescing, and the ones fired
+		 * because the aggregation time expired.
+		 */
+		uint64_t coalesced_irqs;
+		uint64_t coalesce_timeouts;
+
 		uint64_t pg_process_count;
 		uint64_t intr;
 		uint64_t polls;
@@ -472,6 +493,11 @@ struct nvmf_vfio_user_ctrlr {
 	uint64_t				eventidx_buffer;
 
 	bool					adaptive_irqs_enabled;
+
+	/* Interrupt coalescing as set by the host, see Set Features. */
+	union spdk_nvme_feat_interrupt_coalescing intr_coalescing;
+	uint64_t				intr_coalescing_ticks;
+	uint8_t					intr_coalescing_disabled[NVME_IRQ_MSIX_NUM / CHAR_BIT];
 };
 
 /* Endpoint in vfio-user is associated with a socket file, which
@@ -524,6 +550,7 @@ struct nvmf_vfio_user_transport_opts {
 	bool					disable_shadow_doorbells;
 	bool					disable_compare;
 	bool					enable_intr_mode_sq_spreading;
+	uint32_t				intr_mode_idle_polls;
 };
 
 struct nvmf_vfio_user_transport {
@@ -1250,6 +1277,11 @@ static const struct spdk_json_object_decoder vfio_user_transport_opts_decoder[]
 		offsetof(struct nvmf_vfio_user_transport, transport_opts.enable_intr_mode_sq_spreading),
 		spdk_json_decode_bool, true
 	},
+	{
+		"intr_mode_idle_polls",
+		offsetof(struct nvmf_vfio_user_transport, transport_opts.intr_mode_idle_polls),
+		spdk_json_decode_uint32, true
+	},
 };
 
 static struct spdk_nvmf_transport *
@@ -1330,6 +1362,8 @@ nvmf_vfio_user_create(struct spdk_nvmf_transport_opts *opts)
 		      vu_transport->transport_opts.disable_adaptive_irq);
 	SPDK_DEBUGLOG(nvmf_vfio, "vfio_user transport: disable_shadow_doorbells=%d\n",
 		      vu_transport->transport_opts.disable_shadow_doorbells);
+	SPDK_DEBUGLOG(nvmf_vfio, "vfio_user transport: intr_mode_idle_polls=%u\n",
+		      vu_transport->transport_opts.intr_mode_idle_polls);
 
 	return &vu_transport->transport;
 
@@ -1590,6 +1624,27 @@ vfio_user_sq_rearm(struct nvmf_vfio_user_ctrlr *ctrlr,
 	return count;
 }
 
+/*
+ * In interrupt mode, an SQ that had new commands within the last
+ * intr_mode_idle_polls polls is likely to get more soon: rather than having
+ * the host write to BAR0 for each of them, keep its eventidx in polling mode
+ * and keep polling it. Returns true if the SQ should be polled again.
+ */
+static bool
+vfio_user_sq_keep_polling(struct nvmf_vfio_user_sq *sq)
+{
+	struct nvmf_vfio_user_ctrlr *ctrlr = sq->ctrlr;
+
+	if (!ctrlr->endpoint->interrupt_mode ||
+	    sq->idle_polls >= ctrlr->transport->transport_opts.intr_mode_idle_polls) {
+		return false;
+	}
+
+	ctrlr->sdbl->eventidxs[queue_index(sq->qid, false)] = NVMF_VFIO_USER_EVENTIDX_POLL;
+
+	return true;
+}
+
 /*
  * We're in interrupt mode, and potentially about to go to sleep. We need to
  * make sure any further I/O submissions are guaranteed to wake us up: for
@@ -1602,6 +1657,7 @@ static int
 vfio_user_poll_group_rearm(struct nvmf_vfio_user_poll_group *vu_group)
 {
 	struct nvmf_vfio_user_sq *sq;
+	bool keep_polling = false;
 	int count = 0;
 
 	vu_group->stats.rearms++;
@@ -1612,10 +1668,21 @@ vfio_user_poll_group_rearm(struct nvmf_vfio_user_poll_group *vu_group)
 		}
 
 		if (sq->need_rearm) {
+			if (vfio_user_sq_keep_polling(sq)) {
+				keep_polling = true;
+				continue;
+			}
+
 			count += vfio_user_sq_rearm(sq->ctrlr, sq, vu_group);
 		}
 	}
 
+	if (keep_polling) {
+		/* Make sure we're called again rather than going to sleep. */
+		vu_group->stats.adaptive_polls++;
+		eventfd_write(vu_group->intr_fd, 1);
+	}
+
 	return count;
 }
 
@@ -1735,6 +1802,46 @@ cq_is_full(struct nvmf_vfio_user_cq *cq)
 	return free_cq_slots == 0;
 }
 
+static int vfio_user_poll_group_coalesce(void *ctx);
+
+/*
+ * Tells whether the IRQ for a completion just posted to an I/O CQ can be held
+ * back, as per the interrupt coalescing set by the host: it's fired once
+ * the aggregation threshold is reached, or by the poll group's coalesce_poller
+ * once the aggregation time since the first held back completion expired.
+ */
+static bool
+cq_coalesce_irq(struct nvmf_vfio_user_ctrlr *ctrlr, struct nvmf_vfio_user_cq *cq)
+{
+	struct nvmf_vfio_user_poll_group *vu_group;
+	union spdk_nvme_feat_interrupt_coalescing *coalescing = &ctrlr->intr_coalescing;
+
+	/* The threshold is 0's based and a time of 0 means no delay. */
+	if (coalescing->bits.thr == 0 || coalescing->bits.time == 0 ||
+	    (ctrlr->intr_coalescing_disabled[cq->iv / CHAR_BIT] & (1u << (cq->iv % CHAR_BIT)))) {
+		return false;
+	}
+
+	if (cq->coalesced_cpls++ >= coalescing->bits.thr) {
+		cq->coalesced_cpls = 0;
+		return false;
+	}
+
+	vu_group = SPDK_CONTAINEROF(cq->group, struct nvmf_vfio_user_poll_group, group);
+	if (cq->coalesced_cpls == 1) {
+		cq->coalesce_deadline = spdk_get_ticks() + ctrlr->intr_coalescing_ticks;
+		if (vu_group->coalesce_poller == NULL) {
+			/* The aggregation time is in 100 microsecond units */
+			vu_group->coalesce_poller = SPDK_POLLER_REGISTER(vfio_user_poll_group_coalesce,
+						    vu_group, 100);
+		}
+	}
+
+	vu_group->stats.coalesced_irqs++;
+
+	return true;
+}
+
 /*
  * Posts a CQE in the completion queue.
  *
@@ -1809,6 +1916,10 @@ post_completion(struct nvmf_vfio_user_ctrlr *ctrlr, struct nvmf_vfio_user_cq *cq
 
 	if ((cq->qid == 0 || !ctrlr->adaptive_irqs_enabled) &&
 	    cq->ien && ctrlr_interrupt_enabled(ctrlr)) {
+		if (cq->qid != 0 && cq_coalesce_irq(ctrlr, cq)) {
+			return 0;
+		}
+
 		err = vfu_irq_trigger(ctrlr->endpoint->vfu_ctx, cq->iv);
 		if (err != 0) {
 			SPDK_ERRLOG("%s: failed to trigger interrupt: %m\n",
@@ -1836,6 +1947,7 @@ delete_cq_done(struct nvmf_vfio_user_ctrlr *ctrlr, struct nvmf_vfio_user_cq *cq)
 	assert(cq->cq_ref == 0);
 	unmap_q(ctrlr, &cq->mapping);
 	cq->size = 0;
+	cq->coalesced_cpls = 0;
 	cq->cq_state = VFIO_USER_CQ_DELETED;
 	cq->group = NULL;
 }
@@ -2469,6 +2581,80 @@ out:
 	return post_completion(ctrlr, ctrlr->cqs[0], 0, 0, cmd->cid, sc, sct);
 }
 
+static bool
+is_intr_feature(uint8_t fid)
+{
+	return fid == SPDK_NVME_FEAT_INTERRUPT_COALESCING ||
+	       fid == SPDK_NVME_FEAT_INTERRUPT_VECTOR_CONFIGURATION;
+}
+
+/*
+ * Interrupt coalescing doesn't apply to NVMe-oF, so the NVMf library rejects
+ * it: handle its Get/Set Features here.
+ */
+static int
+handle_intr_feature(struct nvmf_vfio_user_ctrlr *ctrlr, struct spdk_nvme_cmd *cmd)
+{
+	union spdk_nvme_feat_interrupt_vector_configuration iv_conf;
+	uint16_t sc = SPDK_NVME_SC_SUCCESS;
+	uint16_t sct = SPDK_NVME_SCT_GENERIC;
+	uint32_t cdw0 = 0;
+	uint8_t iv_bit;
+
+	if (cmd->opc == SPDK_NVME_OPC_SET_FEATURES && cmd->cdw10_bits.set_features.sv) {
+		sct = SPDK_NVME_SCT_COMMAND_SPECIFIC;
+		sc = SPDK_NVME_SC_FEATURE_ID_NOT_SAVEABLE;
+		goto out;
+	}
+
+	if (cmd->cdw10_bits.get_features.fid == SPDK_NVME_FEAT_INTERRUPT_COALESCING) {
+		if (cmd->opc == SPDK_NVME_OPC_GET_FEATURES) {
+			cdw0 = ctrlr->intr_coalescing.raw;
+			goto out;
+		}
+
+		ctrlr->intr_coalescing.raw = cmd->cdw11_bits.feat_interrupt_coalescing.raw;
+		ctrlr->intr_coalescing.bits.reserved = 0;
+		/* The aggregation time is in 100 microsecond units */
+		ctrlr->intr_coalescing_ticks = ctrlr->intr_coalescing.bits.time * 100 *
+					       spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+		SPDK_DEBUGLOG(nvmf_vfio, "%s: interrupt coalescing threshold=%u time=%u00us\n",
+			      ctrlr_id(ctrlr), ctrlr->intr_coalescing.bits.thr + 1,
+			      ctrlr->intr_coalescing.bits.time);
+		goto out;
+	}
+
+	iv_conf.raw = cmd->cdw11_bits.feat_interrupt_vector_configuration.raw;
+	if (iv_conf.bits.iv >= NVME_IRQ_MSIX_NUM) {
+		sc = SPDK_NVME_SC_INVALID_FIELD;
+		goto out;
+	}
+
+	iv_bit = 1u << (iv_conf.bits.iv % CHAR_BIT);
+	if (cmd->opc == SPDK_NVME_OPC_GET_FEATURES) {
+		/* Coalescing never applies to the admin CQ's vector. */
+		iv_conf.bits.cd = iv_conf.bits.iv == 0 ||
+				  (ctrlr->intr_coalescing_disabled[iv_conf.bits.iv / CHAR_BIT] & iv_bit) != 0;
+		iv_conf.bits.reserved = 0;
+		cdw0 = iv_conf.raw;
+		goto out;
+	}
+
+	if (iv_conf.bits.iv == 0 && !iv_conf.bits.cd) {
+		sc = SPDK_NVME_SC_INVALID_FIELD;
+		goto out;
+	}
+
+	if (iv_conf.bits.cd) {
+		ctrlr->intr_coalescing_disabled[iv_conf.bits.iv / CHAR_BIT] |= iv_bit;
+	} else {
+		ctrlr->intr_coalescing_disabled[iv_conf.bits.iv / CHAR_BIT] &= ~iv_bit;
+	}
+
+out:
+	return post_completion(ctrlr, ctrlr->cqs[0], cdw0, 0, cmd->cid, sc, sct);
+}
+
 /* Returns 0 on success and -errno on error. */
 static int
 consume_admin_cmd(struct nvmf_vfio_user_ctrlr *ctrlr, struct spdk_nvme_cmd *cmd)
@@ -2492,6 +2678,12 @@ consume_admin_cmd(struct nvmf_vfio_user_ctrlr *ctrlr, struct spdk_nvme_cmd *cmd)
 	case SPDK_NVME_OPC_DELETE_IO_CQ:
 		return handle_del_io_q(ctrlr, cmd,
 				       cmd->opc == SPDK_NVME_OPC_DELETE_IO_CQ);
+	case SPDK_NVME_OPC_GET_FEATURES:
+	case SPDK_NVME_OPC_SET_FEATURES:
+		if (is_intr_feature(cmd->cdw10_bits.get_features.fid)) {
+			return handle_intr_feature(ctrlr, cmd);
+		}
+		return handle_cmd_req(ctrlr, cmd, ctrlr->sqs[0]);
 	case SPDK_NVME_OPC_DOORBELL_BUFFER_CONFIG:
 		SPDK_NOTICELOG("%s: requested shadow doorbells (supported: %d)\n",
 			       ctrlr_id(ctrlr),
@@ -4845,6 +5037,7 @@ nvmf_vfio_user_poll_group_destroy(struct spdk_nvmf_transport_poll_group *group)
 	if (in_interrupt_mode(vu_transport)) {
 		vfio_user_poll_group_del_intr(vu_group);
 	}
+	spdk_poller_unregister(&vu_group->coalesce_poller);
 
 	pthread_mutex_lock(&vu_transport->pg_lock);
 	next_tgroup = TAILQ_NEXT(vu_group, link);
@@ -4979,6 +5172,52 @@ vfio_user_poll_group_process(void *ctx)
 	return ret != 0 ? SPDK_POLLER_BUSY : SPDK_POLLER_IDLE;
 }
 
+/*
+ * Fire the IRQs held back by interrupt coalescing once their aggregation time
+ * expired. The poller is unregistered when there are none left.
+ */
+static int
+vfio_user_poll_group_coalesce(void *ctx)
+{
+	struct nvmf_vfio_user_poll_group *vu_group = ctx;
+	struct nvmf_vfio_user_ctrlr *ctrlr;
+	struct nvmf_vfio_user_sq *sq;
+	struct nvmf_vfio_user_cq *cq;
+	uint64_t now = spdk_get_ticks();
+	bool pending = false;
+	int count = 0;
+
+	TAILQ_FOREACH(sq, &vu_group->sqs, link) {
+		ctrlr = sq->ctrlr;
+		cq = ctrlr->cqs[sq->cqid];
+		if (cq == NULL || cq->coalesced_cpls == 0) {
+			continue;
+		}
+
+		/* A quiesced controller must not fire IRQs, keep them for later. */
+		if (now < cq->coalesce_deadline || ctrlr->state != VFIO_USER_CTRLR_RUNNING) {
+			pending = true;
+			continue;
+		}
+
+		cq->coalesced_cpls = 0;
+		if (cq->ien && ctrlr_interrupt_enabled(ctrlr)) {
+			if (vfu_irq_trigger(ctrlr->endpoint->vfu_ctx, cq->iv) != 0) {
+				SPDK_ERRLOG("%s: failed to trigger interrupt: %m\n",
+					    ctrlr_id(ctrlr));
+			}
+		}
+		vu_group->stats.coalesce_timeouts++;
+		count++;
+	}
+
+	if (!pending) {
+		spdk_poller_unregister(&vu_group->coalesce_poller);
+	}
+
+	return count != 0 ? SPDK_POLLER_BUSY : SPDK_POLLER_IDLE;
+}
+
 static int
 vfio_user_poll_group_intr(void *ctx)
 {
@@ -5765,6 +6004,12 @@ nvmf_vfio_user_poll_group_poll(struct spdk_nvmf_transport_poll_group *group)
 			return ret;
 		}
 
+		if (ret > 0) {
+			sq->idle_polls = 0;
+		} else if (sq->idle_polls < UINT32_MAX) {
+			sq->idle_polls++;
+		}
+
 		count += ret;
 	}
 
@@ -5857,6 +6102,9 @@ nvmf_vfio_user_poll_group_dump_stat(struct spdk_nvmf_transport_poll_group *group
 	spdk_json_write_named_uint64(w, "lost", vu_group->stats.lost);
 	spdk_json_write_named_uint64(w, "lost_count", vu_group->stats.lost_count);
 	spdk_json_write_named_uint64(w, "rearms", vu_group->stats.rearms);
+	spdk_json_write_named_uint64(w, "adaptive_polls", vu_group->stats.adaptive_polls);
+	spdk_json_write_named_uint64(w, "coalesced_irqs", vu_group->stats.coalesced_irqs);
+	spdk_json_write_named_uint64(w, "coalesce_timeouts", vu_group->stats.coalesce_timeouts);
 	spdk_json_write_named_uint64(w, "pg_process_count", vu_group->stats.pg_process_count);
 	spdk_json_write_named_uint64(w, "intr", vu_group->stats.intr);
 	spdk_json_write_named_uint64(w, "polls", vu_group->stats.polls);
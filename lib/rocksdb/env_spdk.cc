@@ -652,6 +652,14 @@ static void
 rocksdb_shutdown(void)
 {
 	if (g_fs != NULL) {
+		struct spdk_fs_sync_stats stats;
+
+		spdk_fs_get_sync_stats(g_fs, &stats);
+		printf("blobfs syncs: %" PRIu64 " metadata updates: %" PRIu64 " max batch: %" PRIu64 "\n",
+		       stats.num_syncs, stats.num_md_syncs, stats.max_batch_size);
+		printf("blobfs sync latency (us): p50 %" PRIu64 " p99 %" PRIu64 " p99.9 %" PRIu64
+		       " max %" PRIu64 "\n", stats.latency_p50_us, stats.latency_p99_us,
+		       stats.latency_p999_us, stats.max_latency_us);
 		spdk_fs_unload(g_fs, fs_unload_cb, NULL);
 	} else {
 		fs_unload_cb(NULL, 0);
@@ -601,6 +601,12 @@ spdk_sock_is_connected(struct spdk_sock *sock)
 	return sock->net_impl->is_connected(sock);
 }
 
+bool
+spdk_sock_has_unsent_data(struct spdk_sock *sock)
+{
+	return !TAILQ_EMPTY(&sock->queued_reqs) || !TAILQ_EMPTY(&sock->pending_reqs);
+}
+
 struct spdk_sock_group *
 spdk_sock_group_create(void *ctx)
 {
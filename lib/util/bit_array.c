@@ -447,6 +447,51 @@ spdk_bit_pool_allocate_bit(struct spdk_bit_pool *pool)
 	return bit_index;
 }
 
+bool
+spdk_bit_pool_allocate_bit_at(struct spdk_bit_pool *pool, uint32_t bit_index)
+{
+	if (bit_index >= spdk_bit_array_capacity(pool->array) ||
+	    spdk_bit_array_get(pool->array, bit_index)) {
+		return false;
+	}
+
+	spdk_bit_array_set(pool->array, bit_index);
+	if (pool->lowest_free_bit == bit_index) {
+		pool->lowest_free_bit = spdk_bit_array_find_first_clear(pool->array, bit_index);
+	}
+	pool->free_count--;
+	return true;
+}
+
+uint32_t
+spdk_bit_pool_find_free_range(const struct spdk_bit_pool *pool, uint32_t start_bit_index,
+			      uint32_t num_bits)
+{
+	uint32_t capacity = spdk_bit_array_capacity(pool->array);
+	uint32_t bit_index, end;
+
+	if (num_bits == 0 || num_bits > capacity) {
+		return UINT32_MAX;
+	}
+
+	bit_index = spdk_max(start_bit_index, pool->lowest_free_bit);
+	while (bit_index <= capacity - num_bits) {
+		bit_index = spdk_bit_array_find_first_clear(pool->array, bit_index);
+		if (bit_index == UINT32_MAX || bit_index > capacity - num_bits) {
+			break;
+		}
+
+		/* The range is free if the next allocated bit is past its end */
+		end = spdk_bit_array_find_first_set(pool->array, bit_index);
+		if (end == UINT32_MAX || end >= bit_index + num_bits) {
+			return bit_index;
+		}
+		bit_index = end + 1;
+	}
+
+	return UINT32_MAX;
+}
+
 void
 spdk_bit_pool_free_bit(struct spdk_bit_pool *pool, uint32_t bit_index)
 {
@@ -2223,7 +2223,7 @@ _vbdev_lvol_shallow_copy_cb(void *cb_arg, int lvolerrno)
 	struct spdk_lvol *lvol = req->lvol;
 
 	if (lvolerrno != 0) {
-		SPDK_ERRLOG("Could not make a shallow copy of lvol %s due to error: %d\n",
+		SPDK_ERRLOG("Could not make a copy of lvol %s due to error: %d\n",
 			    lvol->name, lvolerrno);
 	}
 
@@ -2232,10 +2232,10 @@ _vbdev_lvol_shallow_copy_cb(void *cb_arg, int lvolerrno)
 	free(req);
 }
 
-int
-vbdev_lvol_shallow_copy(struct spdk_lvol *lvol, const char *bdev_name,
-			spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
-			spdk_lvol_op_complete cb_fn, void *cb_arg)
+static int
+_vbdev_lvol_copy(struct spdk_lvol *lvol, struct spdk_lvol *base, bool diff, uint32_t queue_depth,
+		 const char *bdev_name, spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
+		 spdk_lvol_op_complete cb_fn, void *cb_arg)
 {
 	struct spdk_bs_dev *ext_dev;
 	struct spdk_lvol_copy_req *req;
@@ -2280,8 +2280,13 @@ vbdev_lvol_shallow_copy(struct spdk_lvol *lvol, const char *bdev_name,
 	req->lvol = lvol;
 	req->ext_dev = ext_dev;
 
-	rc = spdk_lvol_shallow_copy(lvol, ext_dev, status_cb_fn, status_cb_arg, _vbdev_lvol_shallow_copy_cb,
-				    req);
+	if (diff) {
+		rc = spdk_lvol_diff_copy(lvol, base, ext_dev, queue_depth, status_cb_fn, status_cb_arg,
+					 _vbdev_lvol_shallow_copy_cb, req);
+	} else {
+		rc = spdk_lvol_shallow_copy(lvol, ext_dev, status_cb_fn, status_cb_arg,
+					    _vbdev_lvol_shallow_copy_cb, req);
+	}
 
 	if (rc < 0) {
 		ext_dev->destroy(ext_dev);
@@ -2291,6 +2296,24 @@ vbdev_lvol_shallow_copy(struct spdk_lvol *lvol, const char *bdev_name,
 	return rc;
 }
 
+int
+vbdev_lvol_shallow_copy(struct spdk_lvol *lvol, const char *bdev_name,
+			spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
+			spdk_lvol_op_complete cb_fn, void *cb_arg)
+{
+	return _vbdev_lvol_copy(lvol, NULL, false, 0, bdev_name, status_cb_fn, status_cb_arg,
+				cb_fn, cb_arg);
+}
+
+int
+vbdev_lvol_diff_copy(struct spdk_lvol *lvol, struct spdk_lvol *base, uint32_t queue_depth,
+		     const char *bdev_name, spdk_blob_shallow_copy_status status_cb_fn,
+		     void *status_cb_arg, spdk_lvol_op_complete cb_fn, void *cb_arg)
+{
+	return _vbdev_lvol_copy(lvol, base, true, queue_depth, bdev_name, status_cb_fn, status_cb_arg,
+				cb_fn, cb_arg);
+}
+
 void
 vbdev_lvol_set_external_parent(struct spdk_lvol *lvol, const char *esnap_name,
 			       spdk_lvol_op_complete cb_fn, void *cb_arg)
@@ -1325,11 +1325,14 @@ static const struct spdk_json_object_decoder rpc_bdev_lvol_get_lvstores_decoders
 static void
 rpc_dump_lvol_store_info(struct spdk_json_write_ctx *w, struct lvol_store_bdev *lvs_bdev)
 {
+	struct spdk_lvol_store *lvs = lvs_bdev->lvs;
 	struct spdk_blob_store *bs;
-	uint64_t cluster_size;
+	uint64_t cluster_size, used_clusters, saved_clusters;
 
-	bs = lvs_bdev->lvs->blobstore;
+	bs = lvs->blobstore;
 	cluster_size = spdk_bs_get_cluster_size(bs);
+	used_clusters = spdk_bs_total_data_cluster_count(bs) - spdk_bs_free_cluster_count(bs);
+	saved_clusters = spdk_bs_saved_cluster_count(bs);
 
 	spdk_json_write_object_begin(w);
 
@@ -1341,6 +1344,16 @@ rpc_dump_lvol_store_info(struct spdk_json_write_ctx *w, struct lvol_store_bdev *
 	spdk_json_write_named_uint64(w, "block_size", spdk_bs_get_io_unit_size(bs));
 	spdk_json_write_named_uint64(w, "cluster_size", cluster_size);
 
+	spdk_json_write_named_object_begin(w, "dedup");
+	spdk_json_write_named_bool(w, "in_progress", lvs->dedup != NULL);
+	spdk_json_write_named_uint64(w, "scanned_clusters", lvs->dedup_scanned_clusters);
+	spdk_json_write_named_uint64(w, "deduplicated_clusters", lvs->dedup_shared_clusters);
+	spdk_json_write_named_uint64(w, "saved_clusters", saved_clusters);
+	/* Clusters the lvols would use without sharing, for each cluster they do use */
+	spdk_json_write_named_double(w, "ratio", used_clusters == 0 ? 1.0 :
+				     (double)(used_clusters + saved_clusters) / used_clusters);
+	spdk_json_write_object_end(w);
+
 	spdk_json_write_object_end(w);
 }
 
@@ -1432,6 +1445,12 @@ rpc_dump_lvol(struct spdk_json_write_ctx *w, struct spdk_lvol *lvol)
 	spdk_json_write_named_bool(w, "is_clone", spdk_blob_is_clone(lvol->blob));
 	spdk_json_write_named_bool(w, "is_esnap_clone", spdk_blob_is_esnap_clone(lvol->blob));
 	spdk_json_write_named_bool(w, "is_degraded", spdk_blob_is_degraded(lvol->blob));
+	spdk_json_write_named_uint64(w, "num_fragments", spdk_blob_get_num_fragments(lvol->blob));
+
+	spdk_json_write_named_object_begin(w, "defrag");
+	spdk_json_write_named_bool(w, "in_progress", lvol->defrag_in_progress);
+	spdk_json_write_named_uint64(w, "clusters_moved", lvol->defrag_clusters_moved);
+	spdk_json_write_object_end(w);
 
 	spdk_json_write_named_object_begin(w, "lvs");
 	spdk_json_write_named_string(w, "name", lvs->name);
@@ -1697,6 +1716,135 @@ cleanup:
 SPDK_RPC_REGISTER("bdev_lvol_start_shallow_copy", rpc_bdev_lvol_start_shallow_copy,
 		  SPDK_RPC_RUNTIME)
 
+struct rpc_bdev_lvol_diff_copy {
+	char *src_lvol_name;
+	char *base_lvol_name;
+	char *dst_bdev_name;
+	uint32_t queue_depth;
+};
+
+static void
+free_rpc_bdev_lvol_diff_copy(struct rpc_bdev_lvol_diff_copy *req)
+{
+	free(req->src_lvol_name);
+	free(req->base_lvol_name);
+	free(req->dst_bdev_name);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_lvol_diff_copy_decoders[] = {
+	{"src_lvol_name", offsetof(struct rpc_bdev_lvol_diff_copy, src_lvol_name), spdk_json_decode_string},
+	{"base_lvol_name", offsetof(struct rpc_bdev_lvol_diff_copy, base_lvol_name), spdk_json_decode_string, true},
+	{"dst_bdev_name", offsetof(struct rpc_bdev_lvol_diff_copy, dst_bdev_name), spdk_json_decode_string},
+	{"queue_depth", offsetof(struct rpc_bdev_lvol_diff_copy, queue_depth), spdk_json_decode_uint32, true},
+};
+
+static void
+rpc_bdev_lvol_start_diff_copy(struct spdk_jsonrpc_request *request,
+			      const struct spdk_json_val *params)
+{
+	struct rpc_bdev_lvol_diff_copy req = {};
+	struct rpc_bdev_lvol_shallow_copy_ctx *ctx;
+	struct spdk_lvol *src_lvol, *base_lvol = NULL;
+	struct spdk_bdev *bdev;
+	struct rpc_shallow_copy_status *status;
+	struct spdk_json_write_ctx *w;
+	spdk_blob_id base_id = SPDK_BLOBID_INVALID;
+	uint64_t cluster;
+	int rc;
+
+	SPDK_INFOLOG(lvol_rpc, "Diff copying lvol\n");
+
+	if (spdk_json_decode_object(params, rpc_bdev_lvol_diff_copy_decoders,
+				    SPDK_COUNTOF(rpc_bdev_lvol_diff_copy_decoders),
+				    &req)) {
+		SPDK_INFOLOG(lvol_rpc, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	bdev = spdk_bdev_get_by_name(req.src_lvol_name);
+	if (bdev == NULL) {
+		SPDK_ERRLOG("lvol bdev '%s' does not exist\n", req.src_lvol_name);
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	src_lvol = vbdev_lvol_get_from_bdev(bdev);
+	if (src_lvol == NULL) {
+		SPDK_ERRLOG("lvol does not exist\n");
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	if (req.base_lvol_name != NULL) {
+		bdev = spdk_bdev_get_by_name(req.base_lvol_name);
+		if (bdev == NULL) {
+			SPDK_ERRLOG("lvol bdev '%s' does not exist\n", req.base_lvol_name);
+			spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+			goto cleanup;
+		}
+
+		base_lvol = vbdev_lvol_get_from_bdev(bdev);
+		if (base_lvol == NULL) {
+			SPDK_ERRLOG("lvol does not exist\n");
+			spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+			goto cleanup;
+		}
+		base_id = spdk_blob_get_id(base_lvol->blob);
+	}
+
+	status = calloc(1, sizeof(*status));
+	if (status == NULL) {
+		SPDK_ERRLOG("Cannot allocate status entry for diff copy of '%s'\n", req.src_lvol_name);
+		spdk_jsonrpc_send_error_response(request, -ENOMEM, spdk_strerror(ENOMEM));
+		goto cleanup;
+	}
+
+	status->operation_id = ++g_shallow_copy_count;
+	cluster = spdk_blob_get_next_changed_cluster(src_lvol->blob, base_id, 0);
+	while (cluster != UINT64_MAX) {
+		status->total_clusters++;
+		cluster = spdk_blob_get_next_changed_cluster(src_lvol->blob, base_id, cluster + 1);
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		SPDK_ERRLOG("Cannot allocate context for diff copy of '%s'\n", req.src_lvol_name);
+		spdk_jsonrpc_send_error_response(request, -ENOMEM, spdk_strerror(ENOMEM));
+		free(status);
+		goto cleanup;
+	}
+	ctx->request = request;
+	ctx->status = status;
+
+	LIST_INSERT_HEAD(&g_shallow_copy_status_list, status, link);
+	rc = vbdev_lvol_diff_copy(src_lvol, base_lvol, req.queue_depth, req.dst_bdev_name,
+				  rpc_bdev_lvol_shallow_copy_status_cb, status,
+				  rpc_bdev_lvol_shallow_copy_cb, ctx);
+
+	if (rc < 0) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 spdk_strerror(-rc));
+		LIST_REMOVE(status, link);
+		free(ctx);
+		free(status);
+	} else {
+		w = spdk_jsonrpc_begin_result(request);
+
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_uint32(w, "operation_id", status->operation_id);
+		spdk_json_write_object_end(w);
+
+		spdk_jsonrpc_end_result(request, w);
+	}
+
+cleanup:
+	free_rpc_bdev_lvol_diff_copy(&req);
+}
+
+SPDK_RPC_REGISTER("bdev_lvol_start_diff_copy", rpc_bdev_lvol_start_diff_copy, SPDK_RPC_RUNTIME)
+
 struct rpc_bdev_lvol_shallow_copy_status {
 	char		*src_lvol_name;
 	uint32_t	operation_id;
@@ -2131,3 +2279,186 @@ cleanup:
 
 SPDK_RPC_REGISTER("bdev_lvol_get_snapshot_checksum", rpc_bdev_lvol_get_snapshot_checksum,
 		  SPDK_RPC_RUNTIME)
+
+struct rpc_bdev_lvs_bg_task {
+	char *uuid;
+	char *lvs_name;
+	uint64_t max_bw_mbps;
+};
+
+static void
+free_rpc_bdev_lvs_bg_task(struct rpc_bdev_lvs_bg_task *req)
+{
+	free(req->uuid);
+	free(req->lvs_name);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_lvol_start_defrag_decoders[] = {
+	{"uuid", offsetof(struct rpc_bdev_lvs_bg_task, uuid), spdk_json_decode_string, true},
+	{"lvs_name", offsetof(struct rpc_bdev_lvs_bg_task, lvs_name), spdk_json_decode_string, true},
+	{"max_bw_mbps", offsetof(struct rpc_bdev_lvs_bg_task, max_bw_mbps), spdk_json_decode_uint64, true},
+};
+
+static void
+rpc_bdev_lvol_start_defrag(struct spdk_jsonrpc_request *request,
+			   const struct spdk_json_val *params)
+{
+	struct rpc_bdev_lvs_bg_task req = {};
+	struct spdk_lvol_store *lvs = NULL;
+	int rc;
+
+	if (spdk_json_decode_object(params, rpc_bdev_lvol_start_defrag_decoders,
+				    SPDK_COUNTOF(rpc_bdev_lvol_start_defrag_decoders),
+				    &req)) {
+		SPDK_INFOLOG(lvol_rpc, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	rc = vbdev_get_lvol_store_by_uuid_xor_name(req.uuid, req.lvs_name, &lvs);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	rc = spdk_lvs_defrag_start(lvs, req.max_bw_mbps);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	spdk_jsonrpc_send_bool_response(request, true);
+
+cleanup:
+	free_rpc_bdev_lvs_bg_task(&req);
+}
+
+SPDK_RPC_REGISTER("bdev_lvol_start_defrag", rpc_bdev_lvol_start_defrag, SPDK_RPC_RUNTIME)
+
+static const struct spdk_json_object_decoder rpc_bdev_lvol_stop_defrag_decoders[] = {
+	{"uuid", offsetof(struct rpc_bdev_lvs_bg_task, uuid), spdk_json_decode_string, true},
+	{"lvs_name", offsetof(struct rpc_bdev_lvs_bg_task, lvs_name), spdk_json_decode_string, true},
+};
+
+static void
+rpc_bdev_lvol_stop_defrag(struct spdk_jsonrpc_request *request,
+			  const struct spdk_json_val *params)
+{
+	struct rpc_bdev_lvs_bg_task req = {};
+	struct spdk_lvol_store *lvs = NULL;
+	int rc;
+
+	if (spdk_json_decode_object(params, rpc_bdev_lvol_stop_defrag_decoders,
+				    SPDK_COUNTOF(rpc_bdev_lvol_stop_defrag_decoders),
+				    &req)) {
+		SPDK_INFOLOG(lvol_rpc, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	rc = vbdev_get_lvol_store_by_uuid_xor_name(req.uuid, req.lvs_name, &lvs);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	rc = spdk_lvs_defrag_stop(lvs);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	spdk_jsonrpc_send_bool_response(request, true);
+
+cleanup:
+	free_rpc_bdev_lvs_bg_task(&req);
+}
+
+SPDK_RPC_REGISTER("bdev_lvol_stop_defrag", rpc_bdev_lvol_stop_defrag, SPDK_RPC_RUNTIME)
+
+static const struct spdk_json_object_decoder rpc_bdev_lvol_start_dedup_decoders[] = {
+	{"uuid", offsetof(struct rpc_bdev_lvs_bg_task, uuid), spdk_json_decode_string, true},
+	{"lvs_name", offsetof(struct rpc_bdev_lvs_bg_task, lvs_name), spdk_json_decode_string, true},
+	{"max_bw_mbps", offsetof(struct rpc_bdev_lvs_bg_task, max_bw_mbps), spdk_json_decode_uint64, true},
+};
+
+static void
+rpc_bdev_lvol_start_dedup(struct spdk_jsonrpc_request *request,
+			  const struct spdk_json_val *params)
+{
+	struct rpc_bdev_lvs_bg_task req = {};
+	struct spdk_lvol_store *lvs = NULL;
+	int rc;
+
+	if (spdk_json_decode_object(params, rpc_bdev_lvol_start_dedup_decoders,
+				    SPDK_COUNTOF(rpc_bdev_lvol_start_dedup_decoders),
+				    &req)) {
+		SPDK_INFOLOG(lvol_rpc, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	rc = vbdev_get_lvol_store_by_uuid_xor_name(req.uuid, req.lvs_name, &lvs);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	rc = spdk_lvs_dedup_start(lvs, req.max_bw_mbps);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	spdk_jsonrpc_send_bool_response(request, true);
+
+cleanup:
+	free_rpc_bdev_lvs_bg_task(&req);
+}
+
+SPDK_RPC_REGISTER("bdev_lvol_start_dedup", rpc_bdev_lvol_start_dedup, SPDK_RPC_RUNTIME)
+
+static const struct spdk_json_object_decoder rpc_bdev_lvol_stop_dedup_decoders[] = {
+	{"uuid", offsetof(struct rpc_bdev_lvs_bg_task, uuid), spdk_json_decode_string, true},
+	{"lvs_name", offsetof(struct rpc_bdev_lvs_bg_task, lvs_name), spdk_json_decode_string, true},
+};
+
+static void
+rpc_bdev_lvol_stop_dedup(struct spdk_jsonrpc_request *request,
+			 const struct spdk_json_val *params)
+{
+	struct rpc_bdev_lvs_bg_task req = {};
+	struct spdk_lvol_store *lvs = NULL;
+	int rc;
+
+	if (spdk_json_decode_object(params, rpc_bdev_lvol_stop_dedup_decoders,
+				    SPDK_COUNTOF(rpc_bdev_lvol_stop_dedup_decoders),
+				    &req)) {
+		SPDK_INFOLOG(lvol_rpc, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	rc = vbdev_get_lvol_store_by_uuid_xor_name(req.uuid, req.lvs_name, &lvs);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	rc = spdk_lvs_dedup_stop(lvs);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	spdk_jsonrpc_send_bool_response(request, true);
+
+cleanup:
+	free_rpc_bdev_lvs_bg_task(&req);
+}
+
+SPDK_RPC_REGISTER("bdev_lvol_stop_dedup", rpc_bdev_lvol_stop_dedup, SPDK_RPC_RUNTIME)
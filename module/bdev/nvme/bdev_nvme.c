@@ -86,6 +86,9 @@ struct nvme_bdev_io {
 	/* How many times the current I/O was retried. */
 	int32_t retry_count;
 
+	/* How many times the current I/O was resubmitted to another I/O path immediately. */
+	uint32_t failover_count;
+
 	/** Expiration value in ticks to retry the current I/O. */
 	uint64_t retry_ticks;
 
@@ -98,6 +101,12 @@ struct nvme_bdev_io {
 	/* Current tsc at submit time. */
 	uint64_t submit_tsc;
 
+	/* Bytes accounted to the I/O path and tsc at which the I/O was submitted to it.
+	 * Used only by the service_time selector.
+	 */
+	uint64_t path_bytes;
+	uint64_t path_submit_tsc;
+
 	/* Used to put nvme_bdev_io into the list */
 	TAILQ_ENTRY(nvme_bdev_io) retry_link;
 };
@@ -148,6 +157,9 @@ static struct spdk_bdev_nvme_opts g_opts = {
 	.allow_accel_sequence = false,
 	.dhchap_digests = BDEV_NVME_DEFAULT_DIGESTS,
 	.dhchap_dhgroups = BDEV_NVME_DEFAULT_DHGROUPS,
+	.immediate_failover_count = 0,
+	.path_breaker_threshold = 0,
+	.path_breaker_backoff_ms = 1000,
 };
 
 #define NVME_HOTPLUG_POLL_PERIOD_MAX			10000000ULL
@@ -1018,6 +1030,28 @@ nvme_io_path_is_available(struct nvme_io_path *io_path)
 	return true;
 }
 
+static inline bool
+nvme_io_path_is_tripped(struct nvme_io_path *io_path)
+{
+	if (spdk_likely(io_path->breaker_expire_ticks == 0)) {
+		return false;
+	}
+
+	if (io_path->nbdev_ch->ignore_path_breakers) {
+		return false;
+	}
+
+	if (spdk_get_ticks() < io_path->breaker_expire_ticks) {
+		return true;
+	}
+
+	/* The backoff period passed. Let new I/Os probe the path again. The failure count
+	 * is kept, and hence a single failure trips the breaker again.
+	 */
+	io_path->breaker_expire_ticks = 0;
+	return false;
+}
+
 static inline bool
 nvme_ctrlr_is_failed(struct nvme_ctrlr *nvme_ctrlr)
 {
@@ -1099,7 +1133,8 @@ _bdev_nvme_find_io_path(struct nvme_bdev_channel *nbdev_ch)
 
 	io_path = start;
 	do {
-		if (spdk_likely(nvme_io_path_is_available(io_path))) {
+		if (spdk_likely(nvme_io_path_is_available(io_path) &&
+				!nvme_io_path_is_tripped(io_path))) {
 			switch (io_path->nvme_ns->ana_state) {
 			case SPDK_NVME_ANA_OPTIMIZED_STATE:
 				nbdev_ch->current_io_path = io_path;
@@ -1145,6 +1180,10 @@ _bdev_nvme_find_io_path_min_qd(struct nvme_bdev_channel *nbdev_ch)
 			continue;
 		}
 
+		if (spdk_unlikely(nvme_io_path_is_tripped(io_path))) {
+			continue;
+		}
+
 		num_outstanding_reqs = spdk_nvme_qpair_get_num_outstanding_reqs(io_path->qpair->qpair);
 		switch (io_path->nvme_ns->ana_state) {
 		case SPDK_NVME_ANA_OPTIMIZED_STATE:
@@ -1172,9 +1211,146 @@ _bdev_nvme_find_io_path_min_qd(struct nvme_bdev_channel *nbdev_ch)
 	return non_optimized;
 }
 
+/* Expected service time of a new I/O on the path. A path without any latency sample
+ * yet has zero cost so that every path gets probed, but only with one I/O at a time,
+ * so that it doesn't attract all I/Os until its first completion.
+ */
+static inline uint64_t
+nvme_io_path_service_time(struct nvme_io_path *io_path)
+{
+	if (spdk_unlikely(io_path->ewma_latency_ticks == 0)) {
+		return io_path->outstanding_bytes == 0 ? 0 : UINT64_MAX - 1;
+	}
+
+	return (io_path->outstanding_bytes + 1) * io_path->ewma_latency_ticks;
+}
+
+static struct nvme_io_path *
+_bdev_nvme_find_io_path_min_service_time(struct nvme_bdev_channel *nbdev_ch)
+{
+	struct nvme_io_path *io_path;
+	struct nvme_io_path *optimized = NULL, *non_optimized = NULL;
+	uint64_t opt_min_st = UINT64_MAX, non_opt_min_st = UINT64_MAX;
+	uint64_t service_time;
+
+	STAILQ_FOREACH(io_path, &nbdev_ch->io_path_list, stailq) {
+		if (spdk_unlikely(!nvme_qpair_is_connected(io_path->qpair))) {
+			/* The device is currently resetting. */
+			continue;
+		}
+
+		if (spdk_unlikely(!nvme_ns_is_active(io_path->nvme_ns))) {
+			continue;
+		}
+
+		if (spdk_unlikely(nvme_io_path_is_tripped(io_path))) {
+			continue;
+		}
+
+		service_time = nvme_io_path_service_time(io_path);
+		switch (io_path->nvme_ns->ana_state) {
+		case SPDK_NVME_ANA_OPTIMIZED_STATE:
+			if (service_time < opt_min_st) {
+				opt_min_st = service_time;
+				optimized = io_path;
+			}
+			break;
+		case SPDK_NVME_ANA_NON_OPTIMIZED_STATE:
+			if (service_time < non_opt_min_st) {
+				non_opt_min_st = service_time;
+				non_optimized = io_path;
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	/* don't cache io path for BDEV_NVME_MP_SELECTOR_SERVICE_TIME selector */
+	if (optimized != NULL) {
+		return optimized;
+	}
+
+	return non_optimized;
+}
+
+/* Smooth weighted round-robin among the available paths in the given ANA state. */
+static struct nvme_io_path *
+bdev_nvme_find_io_path_wrr(struct nvme_bdev_channel *nbdev_ch, enum spdk_nvme_ana_state ana_state)
+{
+	struct nvme_io_path *io_path, *selected = NULL;
+	int64_t total_weight = 0;
+
+	STAILQ_FOREACH(io_path, &nbdev_ch->io_path_list, stailq) {
+		if (spdk_unlikely(!nvme_qpair_is_connected(io_path->qpair))) {
+			continue;
+		}
+
+		if (spdk_unlikely(!nvme_ns_is_active(io_path->nvme_ns))) {
+			continue;
+		}
+
+		if (spdk_unlikely(nvme_io_path_is_tripped(io_path))) {
+			continue;
+		}
+
+		if (io_path->nvme_ns->ana_state != ana_state) {
+			continue;
+		}
+
+		io_path->wrr_current_weight += io_path->nvme_ns->path_weight;
+		total_weight += io_path->nvme_ns->path_weight;
+
+		if (selected == NULL || io_path->wrr_current_weight > selected->wrr_current_weight) {
+			selected = io_path;
+		}
+	}
+
+	if (selected != NULL) {
+		selected->wrr_current_weight -= total_weight;
+	}
+
+	return selected;
+}
+
+static struct nvme_io_path *
+_bdev_nvme_find_io_path_weighted(struct nvme_bdev_channel *nbdev_ch)
+{
+	struct nvme_io_path *io_path;
+
+	/* don't cache io path for BDEV_NVME_MP_SELECTOR_WEIGHTED_ROUND_ROBIN selector */
+	io_path = bdev_nvme_find_io_path_wrr(nbdev_ch, SPDK_NVME_ANA_OPTIMIZED_STATE);
+	if (io_path != NULL) {
+		return io_path;
+	}
+
+	return bdev_nvme_find_io_path_wrr(nbdev_ch, SPDK_NVME_ANA_NON_OPTIMIZED_STATE);
+}
+
+static struct nvme_io_path *
+_bdev_nvme_select_io_path(struct nvme_bdev_channel *nbdev_ch)
+{
+	if (nbdev_ch->mp_policy == BDEV_NVME_MP_POLICY_ACTIVE_PASSIVE) {
+		return _bdev_nvme_find_io_path(nbdev_ch);
+	}
+
+	switch (nbdev_ch->mp_selector) {
+	case BDEV_NVME_MP_SELECTOR_QUEUE_DEPTH:
+		return _bdev_nvme_find_io_path_min_qd(nbdev_ch);
+	case BDEV_NVME_MP_SELECTOR_SERVICE_TIME:
+		return _bdev_nvme_find_io_path_min_service_time(nbdev_ch);
+	case BDEV_NVME_MP_SELECTOR_WEIGHTED_ROUND_ROBIN:
+		return _bdev_nvme_find_io_path_weighted(nbdev_ch);
+	default:
+		return _bdev_nvme_find_io_path(nbdev_ch);
+	}
+}
+
 static inline struct nvme_io_path *
 bdev_nvme_find_io_path(struct nvme_bdev_channel *nbdev_ch)
 {
+	struct nvme_io_path *io_path;
+
 	if (spdk_likely(nbdev_ch->current_io_path != NULL)) {
 		if (nbdev_ch->mp_policy == BDEV_NVME_MP_POLICY_ACTIVE_PASSIVE) {
 			return nbdev_ch->current_io_path;
@@ -1186,11 +1362,60 @@ bdev_nvme_find_io_path(struct nvme_bdev_channel *nbdev_ch)
 		}
 	}
 
-	if (nbdev_ch->mp_policy == BDEV_NVME_MP_POLICY_ACTIVE_PASSIVE ||
-	    nbdev_ch->mp_selector == BDEV_NVME_MP_SELECTOR_ROUND_ROBIN) {
-		return _bdev_nvme_find_io_path(nbdev_ch);
+	io_path = _bdev_nvme_select_io_path(nbdev_ch);
+	if (spdk_unlikely(io_path == NULL && g_opts.path_breaker_threshold != 0)) {
+		/* All available I/O paths are tripped. Using a flapping path is
+		 * better than failing or delaying I/Os.
+		 */
+		nbdev_ch->ignore_path_breakers = true;
+		io_path = _bdev_nvme_select_io_path(nbdev_ch);
+		nbdev_ch->ignore_path_breakers = false;
+	}
+
+	return io_path;
+}
+
+/* Weight of a new latency sample in the moving average is 1 / 2^NVME_IO_PATH_EWMA_SHIFT. */
+#define NVME_IO_PATH_EWMA_SHIFT	3
+
+static inline void
+bdev_nvme_io_path_start(struct nvme_bdev_io *bio, uint64_t lba_count)
+{
+	struct nvme_io_path *io_path = bio->io_path;
+	struct nvme_bdev_channel *nbdev_ch = io_path->nbdev_ch;
+
+	if (spdk_likely(nbdev_ch->mp_selector != BDEV_NVME_MP_SELECTOR_SERVICE_TIME ||
+			nbdev_ch->mp_policy != BDEV_NVME_MP_POLICY_ACTIVE_ACTIVE)) {
+		return;
+	}
+
+	bio->path_bytes = lba_count * spdk_bdev_io_from_ctx(bio)->bdev->blocklen;
+	bio->path_submit_tsc = spdk_get_ticks();
+	io_path->outstanding_bytes += bio->path_bytes;
+}
+
+static inline void
+bdev_nvme_io_path_end(struct nvme_bdev_io *bio)
+{
+	struct nvme_io_path *io_path = bio->io_path;
+	uint64_t latency_ticks;
+
+	if (spdk_likely(bio->path_bytes == 0)) {
+		return;
+	}
+
+	assert(io_path != NULL);
+	assert(io_path->outstanding_bytes >= bio->path_bytes);
+	io_path->outstanding_bytes -= bio->path_bytes;
+	bio->path_bytes = 0;
+
+	/* A zero sample would make the path look free forever */
+	latency_ticks = spdk_max(spdk_get_ticks() - bio->path_submit_tsc, 1);
+	if (io_path->ewma_latency_ticks == 0) {
+		io_path->ewma_latency_ticks = latency_ticks;
 	} else {
-		return _bdev_nvme_find_io_path_min_qd(nbdev_ch);
+		io_path->ewma_latency_ticks = (io_path->ewma_latency_ticks * ((1 << NVME_IO_PATH_EWMA_SHIFT) - 1) +
+					       latency_ticks) >> NVME_IO_PATH_EWMA_SHIFT;
 	}
 }
 
@@ -1456,6 +1681,55 @@ bdev_nvme_update_io_path_stat(struct nvme_bdev_io *bio)
 	}
 }
 
+static void
+nvme_io_path_record_failure(struct nvme_io_path *io_path)
+{
+	struct nvme_bdev_channel *nbdev_ch = io_path->nbdev_ch;
+
+	if (g_opts.path_breaker_threshold == 0) {
+		return;
+	}
+
+	if (++io_path->num_path_failures < g_opts.path_breaker_threshold) {
+		return;
+	}
+
+	io_path->breaker_expire_ticks = spdk_get_ticks() +
+					g_opts.path_breaker_backoff_ms * spdk_get_ticks_hz() / 1000ULL;
+	io_path->num_breaker_trips++;
+
+	if (nbdev_ch->current_io_path == io_path) {
+		bdev_nvme_clear_current_io_path(nbdev_ch);
+	}
+}
+
+/* Resubmit an I/O failed on failed_path to another available I/O path in the
+ * completion context instead of queueing it to the retry poller.
+ */
+static bool
+bdev_nvme_failover_io(struct nvme_bdev_channel *nbdev_ch, struct nvme_bdev_io *bio,
+		      struct nvme_io_path *failed_path)
+{
+	struct nvme_io_path *io_path;
+
+	if (bio->failover_count >= g_opts.immediate_failover_count) {
+		return false;
+	}
+
+	io_path = bdev_nvme_find_io_path(nbdev_ch);
+	if (io_path == NULL || io_path == failed_path) {
+		return false;
+	}
+
+	failed_path->num_immediate_retries++;
+	bio->failover_count++;
+	bio->io_path = io_path;
+	io_path->num_selected_ios++;
+
+	_bdev_nvme_submit_request(nbdev_ch, spdk_bdev_io_from_ctx(bio));
+	return true;
+}
+
 static bool
 bdev_nvme_check_retry_io(struct nvme_bdev_io *bio,
 			 const struct spdk_nvme_cpl *cpl,
@@ -1472,6 +1746,7 @@ bdev_nvme_check_retry_io(struct nvme_bdev_io *bio,
 	    !nvme_ctrlr_is_available(nvme_ctrlr)) {
 		bdev_nvme_clear_current_io_path(nbdev_ch);
 		bio->io_path = NULL;
+		nvme_io_path_record_failure(io_path);
 		if (spdk_nvme_cpl_is_ana_error(cpl)) {
 			if (nvme_ctrlr_read_ana_log_page(nvme_ctrlr) == 0) {
 				io_path->nvme_ns->ana_state_updating = true;
@@ -1502,12 +1777,16 @@ bdev_nvme_io_complete_nvme_status(struct nvme_bdev_io *bio,
 {
 	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
 	struct nvme_bdev_channel *nbdev_ch;
+	struct nvme_io_path *io_path;
 	uint64_t delay_ms;
 
 	assert(!bdev_nvme_io_type_is_admin(bdev_io->type));
 
 	if (spdk_likely(spdk_nvme_cpl_is_success(cpl))) {
 		bdev_nvme_update_io_path_stat(bio);
+		if (spdk_unlikely(bio->io_path->num_path_failures != 0)) {
+			bio->io_path->num_path_failures = 0;
+		}
 		goto complete;
 	}
 
@@ -1528,14 +1807,21 @@ bdev_nvme_io_complete_nvme_status(struct nvme_bdev_io *bio,
 	}
 
 	nbdev_ch = spdk_io_channel_get_ctx(spdk_bdev_io_get_io_channel(bdev_io));
+	io_path = bio->io_path;
 
 	if (bdev_nvme_check_retry_io(bio, cpl, nbdev_ch, &delay_ms)) {
+		/* bio->io_path was cleared if the I/O failed by a path error. */
+		if (bio->io_path == NULL && bdev_nvme_failover_io(nbdev_ch, bio, io_path)) {
+			return;
+		}
+		io_path->num_delayed_retries++;
 		bdev_nvme_queue_retry_io(nbdev_ch, bio, delay_ms);
 		return;
 	}
 
 complete:
 	bio->retry_count = 0;
+	bio->failover_count = 0;
 	bio->submit_tsc = 0;
 	bdev_io->u.bdev.accel_sequence = NULL;
 	__bdev_nvme_io_complete(bdev_io, 0, cpl);
@@ -1546,6 +1832,7 @@ bdev_nvme_io_complete(struct nvme_bdev_io *bio, int rc)
 {
 	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
 	struct nvme_bdev_channel *nbdev_ch;
+	struct nvme_io_path *io_path;
 	enum spdk_bdev_io_status io_status;
 
 	assert(!bdev_nvme_io_type_is_admin(bdev_io->type));
@@ -1560,11 +1847,22 @@ bdev_nvme_io_complete(struct nvme_bdev_io *bio, int rc)
 	case -ENXIO:
 		if (g_opts.bdev_retry_count == -1 || bio->retry_count < g_opts.bdev_retry_count) {
 			nbdev_ch = spdk_io_channel_get_ctx(spdk_bdev_io_get_io_channel(bdev_io));
+			io_path = bio->io_path;
 
 			bdev_nvme_clear_current_io_path(nbdev_ch);
 			bio->io_path = NULL;
 
+			if (io_path != NULL) {
+				nvme_io_path_record_failure(io_path);
+				if (bdev_nvme_failover_io(nbdev_ch, bio, io_path)) {
+					return;
+				}
+			}
+
 			if (any_io_path_may_become_available(nbdev_ch)) {
+				if (io_path != NULL) {
+					io_path->num_delayed_retries++;
+				}
 				bdev_nvme_queue_retry_io(nbdev_ch, bio, 1000ULL);
 				return;
 			}
@@ -1579,6 +1877,7 @@ bdev_nvme_io_complete(struct nvme_bdev_io *bio, int rc)
 	}
 
 	bio->retry_count = 0;
+	bio->failover_count = 0;
 	bio->submit_tsc = 0;
 	__bdev_nvme_io_complete(bdev_io, io_status, NULL);
 }
@@ -1885,6 +2184,7 @@ bdev_nvme_create_qpair(struct nvme_qpair *nvme_qpair)
 	opts.create_only = true;
 	opts.async_mode = true;
 	opts.io_queue_requests = spdk_max(g_opts.io_queue_requests, opts.io_queue_requests);
+	opts.num_connections = nvme_ctrlr->opts.num_io_connections;
 	g_opts.io_queue_requests = opts.io_queue_requests;
 
 	qpair = spdk_nvme_ctrlr_alloc_io_qpair(nvme_ctrlr->ctrlr, &opts, sizeof(opts));
@@ -3290,6 +3590,9 @@ bdev_nvme_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_i
 		nbdev_io->submit_tsc = spdk_get_ticks();
 	}
 
+	/* The driver context isn't zeroed, don't let a stale value pass for an accounted I/O */
+	nbdev_io->path_bytes = 0;
+
 	spdk_trace_record(TRACE_BDEV_NVME_IO_START, 0, 0, (uintptr_t)nbdev_io, (uintptr_t)bdev_io);
 	nbdev_io->io_path = bdev_nvme_find_io_path(nbdev_ch);
 	if (spdk_unlikely(!nbdev_io->io_path)) {
@@ -3301,6 +3604,8 @@ bdev_nvme_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_i
 		/* Admin commands do not use the optimal I/O path.
 		 * Simply fall through even if it is not found.
 		 */
+	} else {
+		nbdev_io->io_path->num_selected_ios++;
 	}
 
 	_bdev_nvme_submit_request(nbdev_ch, bdev_io);
@@ -3943,6 +4248,10 @@ nvme_bdev_get_mp_selector_str(struct nvme_bdev *nbdev)
 		return "round_robin";
 	case BDEV_NVME_MP_SELECTOR_QUEUE_DEPTH:
 		return "queue_depth";
+	case BDEV_NVME_MP_SELECTOR_SERVICE_TIME:
+		return "service_time";
+	case BDEV_NVME_MP_SELECTOR_WEIGHTED_ROUND_ROBIN:
+		return "weighted_round_robin";
 	default:
 		assert(false);
 		return "invalid";
@@ -4615,6 +4924,8 @@ nvme_ns_alloc(void)
 		return NULL;
 	}
 
+	nvme_ns->path_weight = 1;
+
 	if (g_opts.io_path_stat) {
 		nvme_ns->stat = calloc(1, sizeof(struct spdk_bdev_io_stat));
 		if (nvme_ns->stat == NULL) {
@@ -5261,6 +5572,63 @@ err_alloc:
 	cb_fn(cb_arg, rc);
 }
 
+/* Set the weight used by the weighted_round_robin selector for the path of the
+ * NVMe bdev to the NVMe-oF controller specified by cntlid. Channels pick up the
+ * new weight at the next path selection.
+ */
+int
+bdev_nvme_set_path_weight(const char *name, uint16_t cntlid, uint32_t weight)
+{
+	struct spdk_bdev_desc *desc;
+	struct spdk_bdev *bdev;
+	struct nvme_bdev *nbdev;
+	struct nvme_ns *nvme_ns;
+	int rc;
+
+	if (weight == 0) {
+		SPDK_ERRLOG("Path weight must be greater than zero.\n");
+		return -EINVAL;
+	}
+
+	rc = spdk_bdev_open_ext(name, false, dummy_bdev_event_cb, NULL, &desc);
+	if (rc != 0) {
+		SPDK_ERRLOG("Failed to open bdev %s.\n", name);
+		return rc;
+	}
+
+	bdev = spdk_bdev_desc_get_bdev(desc);
+
+	if (bdev->module != &nvme_if) {
+		SPDK_ERRLOG("bdev %s is not registered in this module.\n", name);
+		rc = -ENODEV;
+		goto exit;
+	}
+
+	nbdev = SPDK_CONTAINEROF(bdev, struct nvme_bdev, disk);
+
+	rc = -ENODEV;
+
+	pthread_mutex_lock(&nbdev->mutex);
+
+	TAILQ_FOREACH(nvme_ns, &nbdev->nvme_ns_list, tailq) {
+		if (spdk_nvme_ctrlr_get_data(nvme_ns->ctrlr->ctrlr)->cntlid == cntlid) {
+			nvme_ns->path_weight = weight;
+			rc = 0;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&nbdev->mutex);
+
+	if (rc != 0) {
+		SPDK_ERRLOG("bdev %s does not have namespace to controller %u.\n", name, cntlid);
+	}
+
+exit:
+	spdk_bdev_close(desc);
+	return rc;
+}
+
 struct bdev_nvme_set_multipath_policy_ctx {
 	struct spdk_bdev_desc *desc;
 	spdk_bdev_nvme_set_multipath_policy_cb cb_fn;
@@ -5322,6 +5690,8 @@ spdk_bdev_nvme_set_multipath_policy(const char *name, enum spdk_bdev_nvme_multip
 			}
 			break;
 		case BDEV_NVME_MP_SELECTOR_QUEUE_DEPTH:
+		case BDEV_NVME_MP_SELECTOR_SERVICE_TIME:
+		case BDEV_NVME_MP_SELECTOR_WEIGHTED_ROUND_ROBIN:
 			break;
 		default:
 			rc = -EINVAL;
@@ -5775,6 +6145,7 @@ spdk_bdev_nvme_get_default_ctrlr_opts(struct spdk_bdev_nvme_ctrlr_opts *opts)
 	opts->reconnect_delay_sec = g_opts.reconnect_delay_sec;
 	opts->fast_io_fail_timeout_sec = g_opts.fast_io_fail_timeout_sec;
 	opts->multipath = false;
+	opts->num_io_connections = 1;
 }
 
 static void
@@ -5920,6 +6291,11 @@ bdev_nvme_validate_opts(const struct spdk_bdev_nvme_opts *opts)
 		return -EINVAL;
 	}
 
+	if (opts->path_breaker_threshold != 0 && opts->path_breaker_backoff_ms == 0) {
+		SPDK_WARNLOG("Invalid option: path_breaker_backoff_ms can't be 0 if path_breaker_threshold is set.\n");
+		return -EINVAL;
+	}
+
 	if (!bdev_nvme_check_io_error_resiliency_params(opts->ctrlr_loss_timeout_sec,
 			opts->reconnect_delay_sec,
 			opts->fast_io_fail_timeout_sec)) {
@@ -7534,6 +7910,8 @@ bdev_nvme_readv_done(void *ref, const struct spdk_nvme_cpl *cpl)
 	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
 	int ret;
 
+	bdev_nvme_io_path_end(bio);
+
 	if (spdk_unlikely(spdk_nvme_cpl_is_pi_error(cpl))) {
 		SPDK_ERRLOG("readv completed with PI error (sct=%d, sc=%d)\n",
 			    cpl->status.sct, cpl->status.sc);
@@ -7563,6 +7941,8 @@ bdev_nvme_writev_done(void *ref, const struct spdk_nvme_cpl *cpl)
 {
 	struct nvme_bdev_io *bio = ref;
 
+	bdev_nvme_io_path_end(bio);
+
 	if (spdk_unlikely(spdk_nvme_cpl_is_pi_error(cpl))) {
 		SPDK_ERRLOG("writev completed with PI error (sct=%d, sc=%d)\n",
 			    cpl->status.sct, cpl->status.sc);
@@ -7986,7 +8366,9 @@ bdev_nvme_readv(struct nvme_bdev_io *bio, struct iovec *iov, int iovcnt,
 						    bdev_nvme_queued_next_sge, md, 0, 0);
 	}
 
-	if (spdk_unlikely(rc != 0 && rc != -ENOMEM)) {
+	if (spdk_likely(rc == 0)) {
+		bdev_nvme_io_path_start(bio, lba_count);
+	} else if (rc != -ENOMEM) {
 		SPDK_ERRLOG("readv failed: rc = %d\n", rc);
 	}
 	return rc;
@@ -8041,7 +8423,9 @@ bdev_nvme_writev(struct nvme_bdev_io *bio, struct iovec *iov, int iovcnt,
 						     bdev_nvme_queued_next_sge, md, 0, 0);
 	}
 
-	if (spdk_unlikely(rc != 0 && rc != -ENOMEM)) {
+	if (spdk_likely(rc == 0)) {
+		bdev_nvme_io_path_start(bio, lba_count);
+	} else if (rc != -ENOMEM) {
 		SPDK_ERRLOG("writev failed: rc = %d\n", rc);
 	}
 	return rc;
@@ -8521,6 +8905,9 @@ bdev_nvme_opts_config_json(struct spdk_json_write_ctx *w)
 	spdk_json_write_named_bool(w, "allow_accel_sequence", g_opts.allow_accel_sequence);
 	spdk_json_write_named_uint32(w, "rdma_max_cq_size", g_opts.rdma_max_cq_size);
 	spdk_json_write_named_uint16(w, "rdma_cm_event_timeout_ms", g_opts.rdma_cm_event_timeout_ms);
+	spdk_json_write_named_uint32(w, "immediate_failover_count", g_opts.immediate_failover_count);
+	spdk_json_write_named_uint32(w, "path_breaker_threshold", g_opts.path_breaker_threshold);
+	spdk_json_write_named_uint32(w, "path_breaker_backoff_ms", g_opts.path_breaker_backoff_ms);
 	spdk_json_write_named_array_begin(w, "dhchap_digests");
 	for (i = 0; i < 32; ++i) {
 		if (g_opts.dhchap_digests & SPDK_BIT(i)) {
@@ -8626,6 +9013,9 @@ nvme_ctrlr_config_json(struct spdk_json_write_ctx *w,
 	spdk_json_write_named_uint32(w, "reconnect_delay_sec", nvme_ctrlr->opts.reconnect_delay_sec);
 	spdk_json_write_named_uint32(w, "fast_io_fail_timeout_sec",
 				     nvme_ctrlr->opts.fast_io_fail_timeout_sec);
+	if (nvme_ctrlr->opts.num_io_connections > 1) {
+		spdk_json_write_named_uint8(w, "num_io_connections", nvme_ctrlr->opts.num_io_connections);
+	}
 	if (nvme_ctrlr->psk != NULL) {
 		spdk_json_write_named_string(w, "psk", spdk_key_get_name(nvme_ctrlr->psk));
 	}
@@ -8656,6 +9046,61 @@ nvme_ctrlr_config_json(struct spdk_json_write_ctx *w,
 	spdk_json_write_object_end(w);
 }
 
+/* Path weights are set with the multipath policy, dump both if any weight was changed */
+static void
+nvme_bdev_path_weights_config_json(struct spdk_json_write_ctx *w, struct nvme_bdev *nbdev)
+{
+	struct nvme_ns *nvme_ns;
+	bool weighted = false;
+
+	pthread_mutex_lock(&nbdev->mutex);
+
+	TAILQ_FOREACH(nvme_ns, &nbdev->nvme_ns_list, tailq) {
+		if (nvme_ns->ctrlr->opts.from_discovery_service) {
+			/* The bdev may not exist yet when the config is loaded */
+			goto exit;
+		}
+
+		if (nvme_ns->path_weight != 1) {
+			weighted = true;
+		}
+	}
+
+	if (!weighted) {
+		goto exit;
+	}
+
+	spdk_json_write_object_begin(w);
+
+	spdk_json_write_named_string(w, "method", "bdev_nvme_set_multipath_policy");
+
+	spdk_json_write_named_object_begin(w, "params");
+	spdk_json_write_named_string(w, "name", nbdev->disk.name);
+	spdk_json_write_named_string(w, "policy", nvme_bdev_get_mp_policy_str(nbdev));
+	if (nbdev->mp_policy == BDEV_NVME_MP_POLICY_ACTIVE_ACTIVE) {
+		spdk_json_write_named_string(w, "selector", nvme_bdev_get_mp_selector_str(nbdev));
+		if (nbdev->mp_selector == BDEV_NVME_MP_SELECTOR_ROUND_ROBIN) {
+			spdk_json_write_named_uint32(w, "rr_min_io", nbdev->rr_min_io);
+		}
+	}
+
+	spdk_json_write_named_array_begin(w, "path_weights");
+	TAILQ_FOREACH(nvme_ns, &nbdev->nvme_ns_list, tailq) {
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_uint16(w, "cntlid",
+					     spdk_nvme_ctrlr_get_data(nvme_ns->ctrlr->ctrlr)->cntlid);
+		spdk_json_write_named_uint32(w, "weight", nvme_ns->path_weight);
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+	spdk_json_write_object_end(w);
+
+	spdk_json_write_object_end(w);
+
+exit:
+	pthread_mutex_unlock(&nbdev->mutex);
+}
+
 static void
 bdev_nvme_hotplug_config_json(struct spdk_json_write_ctx *w)
 {
@@ -8675,6 +9120,7 @@ bdev_nvme_config_json(struct spdk_json_write_ctx *w)
 {
 	struct nvme_bdev_ctrlr	*nbdev_ctrlr;
 	struct nvme_ctrlr	*nvme_ctrlr;
+	struct nvme_bdev	*nbdev;
 	struct discovery_ctx	*ctx;
 	struct nvme_path_id	*path_id;
 
@@ -8698,6 +9144,10 @@ bdev_nvme_config_json(struct spdk_json_write_ctx *w)
 			nvme_ctrlr_cuse_config_json(w, nvme_ctrlr);
 #endif
 		}
+
+		TAILQ_FOREACH(nbdev, &nbdev_ctrlr->bdevs, tailq) {
+			nvme_bdev_path_weights_config_json(w, nbdev);
+		}
 	}
 
 	TAILQ_FOREACH(ctx, &g_discovery_ctxs, tailq) {
@@ -9022,6 +9472,16 @@ nvme_io_path_info_json(struct spdk_json_write_ctx *w, struct nvme_io_path *io_pa
 	spdk_json_write_named_bool(w, "current", nvme_io_path_is_current(io_path));
 	spdk_json_write_named_bool(w, "connected", nvme_qpair_is_connected(io_path->qpair));
 	spdk_json_write_named_bool(w, "accessible", nvme_ns_is_accessible(nvme_ns));
+	spdk_json_write_named_uint64(w, "selected_ios", io_path->num_selected_ios);
+	spdk_json_write_named_uint32(w, "weight", nvme_ns->path_weight);
+	spdk_json_write_named_uint64(w, "outstanding_bytes", io_path->outstanding_bytes);
+	spdk_json_write_named_uint64(w, "latency_us",
+				     io_path->ewma_latency_ticks * SPDK_SEC_TO_USEC / spdk_get_ticks_hz());
+	spdk_json_write_named_uint64(w, "immediate_retries", io_path->num_immediate_retries);
+	spdk_json_write_named_uint64(w, "delayed_retries", io_path->num_delayed_retries);
+	spdk_json_write_named_uint64(w, "breaker_trips", io_path->num_breaker_trips);
+	spdk_json_write_named_bool(w, "breaker_open", io_path->breaker_expire_ticks != 0 &&
+				   spdk_get_ticks() < io_path->breaker_expire_ticks);
 
 	spdk_json_write_named_object_begin(w, "transport");
 	spdk_json_write_named_string(w, "trtype", trid->trstring);
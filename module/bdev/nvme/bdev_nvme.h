@@ -54,6 +54,8 @@ struct nvme_ns {
 	enum spdk_nvme_ana_state	ana_state;
 	bool				ana_state_updating;
 	bool				ana_transition_timedout;
+	/* Weight of this path for the weighted_round_robin multipath selector. */
+	uint32_t			path_weight;
 	struct spdk_poller		*anatt_timer;
 	struct nvme_async_probe_ctx	*probe_ctx;
 	TAILQ_ENTRY(nvme_ns)		tailq;
@@ -201,6 +203,29 @@ struct nvme_io_path {
 
 	/* allocation of stat is decided by option io_path_stat of RPC bdev_nvme_set_options */
 	struct spdk_bdev_io_stat	*stat;
+
+	/* Number of I/Os for which this path was selected. */
+	uint64_t			num_selected_ios;
+
+	/* The following are used by the service_time selector. */
+	uint64_t			outstanding_bytes;
+	uint64_t			ewma_latency_ticks;
+
+	/* Used by the weighted_round_robin selector. */
+	int64_t				wrr_current_weight;
+
+	/* Circuit breaker. New I/Os are not routed to this path until breaker_expire_ticks
+	 * once num_path_failures consecutive I/Os failed with path errors.
+	 */
+	uint32_t			num_path_failures;
+	uint64_t			breaker_expire_ticks;
+	uint64_t			num_breaker_trips;
+
+	/* Number of I/Os failed on this path that were resubmitted to another path
+	 * immediately or queued for a delayed retry.
+	 */
+	uint64_t			num_immediate_retries;
+	uint64_t			num_delayed_retries;
 };
 
 struct nvme_bdev_channel {
@@ -213,6 +238,8 @@ struct nvme_bdev_channel {
 	TAILQ_HEAD(retry_io_head, nvme_bdev_io)	retry_io_list;
 	struct spdk_poller			*retry_io_poller;
 	bool					resetting;
+	/* Select I/O paths regardless of their circuit breakers. */
+	bool					ignore_path_breakers;
 };
 
 struct nvme_poll_group {
@@ -318,6 +345,15 @@ struct spdk_bdev_nvme_opts {
 	uint16_t rdma_cm_event_timeout_ms;
 	uint32_t dhchap_digests;
 	uint32_t dhchap_dhgroups;
+	/* The number of times per I/O that an I/O failed by a path error is resubmitted to
+	 * another available I/O path in the completion context. 0 means always delaying retries.
+	 */
+	uint32_t immediate_failover_count;
+	/* The number of consecutive I/Os failed by path errors that stops routing new I/Os to
+	 * the I/O path for path_breaker_backoff_ms. 0 disables circuit breakers.
+	 */
+	uint32_t path_breaker_threshold;
+	uint32_t path_breaker_backoff_ms;
 };
 
 struct spdk_nvme_qpair *bdev_nvme_get_io_qpair(struct spdk_io_channel *ctrlr_io_ch);
@@ -415,4 +451,15 @@ typedef void (*bdev_nvme_set_preferred_path_cb)(void *cb_arg, int rc);
 void bdev_nvme_set_preferred_path(const char *name, uint16_t cntlid,
 				  bdev_nvme_set_preferred_path_cb cb_fn, void *cb_arg);
 
+/**
+ * Set the weight of an I/O path of an NVMe bdev for the weighted_round_robin
+ * multipath selector.
+ *
+ * \param name NVMe bdev name
+ * \param cntlid NVMe-oF controller ID
+ * \param weight Weight of the I/O path, must be non-zero.
+ * \return 0 on success, negated errno on failure.
+ */
+int bdev_nvme_set_path_weight(const char *name, uint16_t cntlid, uint32_t weight);
+
 #endif /* SPDK_BDEV_NVME_H */
@@ -138,6 +138,9 @@ static const struct spdk_json_object_decoder rpc_bdev_nvme_options_decoders[] =
 	{"rdma_cm_event_timeout_ms", offsetof(struct spdk_bdev_nvme_opts, rdma_cm_event_timeout_ms), spdk_json_decode_uint16, true},
 	{"dhchap_digests", offsetof(struct spdk_bdev_nvme_opts, dhchap_digests), rpc_decode_digest_array, true},
 	{"dhchap_dhgroups", offsetof(struct spdk_bdev_nvme_opts, dhchap_dhgroups), rpc_decode_dhgroup_array, true},
+	{"immediate_failover_count", offsetof(struct spdk_bdev_nvme_opts, immediate_failover_count), spdk_json_decode_uint32, true},
+	{"path_breaker_threshold", offsetof(struct spdk_bdev_nvme_opts, path_breaker_threshold), spdk_json_decode_uint32, true},
+	{"path_breaker_backoff_ms", offsetof(struct spdk_bdev_nvme_opts, path_breaker_backoff_ms), spdk_json_decode_uint32, true},
 };
 
 static void
@@ -338,6 +341,7 @@ static const struct spdk_json_object_decoder rpc_bdev_nvme_attach_controller_dec
 	{"dhchap_key", offsetof(struct rpc_bdev_nvme_attach_controller, dhchap_key), spdk_json_decode_string, true},
 	{"dhchap_ctrlr_key", offsetof(struct rpc_bdev_nvme_attach_controller, dhchap_ctrlr_key), spdk_json_decode_string, true},
 	{"allow_unrecognized_csi", offsetof(struct rpc_bdev_nvme_attach_controller, bdev_opts.allow_unrecognized_csi), spdk_json_decode_bool, true},
+	{"num_io_connections", offsetof(struct rpc_bdev_nvme_attach_controller, bdev_opts.num_io_connections), spdk_json_decode_uint8, true},
 };
 
 #define DEFAULT_MAX_BDEVS_PER_RPC 128
@@ -1215,6 +1219,7 @@ rpc_bdev_nvme_tcp_stats(struct spdk_json_write_ctx *w,
 	spdk_json_write_named_uint64(w, "nvme_completions", stat->tcp.nvme_completions);
 	spdk_json_write_named_uint64(w, "queued_requests", stat->tcp.queued_requests);
 	spdk_json_write_named_uint64(w, "submitted_requests", stat->tcp.submitted_requests);
+	spdk_json_write_named_uint64(w, "striped_requests", stat->tcp.striped_requests);
 }
 
 static void
@@ -2286,11 +2291,24 @@ cleanup:
 SPDK_RPC_REGISTER("bdev_nvme_set_preferred_path", rpc_bdev_nvme_set_preferred_path,
 		  SPDK_RPC_RUNTIME)
 
+#define RPC_MAX_PATH_WEIGHTS 32
+
+struct rpc_path_weight {
+	uint16_t cntlid;
+	uint32_t weight;
+};
+
+struct rpc_path_weights {
+	size_t num_path_weights;
+	struct rpc_path_weight path_weights[RPC_MAX_PATH_WEIGHTS];
+};
+
 struct rpc_set_multipath_policy {
 	char *name;
 	enum spdk_bdev_nvme_multipath_policy policy;
 	enum spdk_bdev_nvme_multipath_selector selector;
 	uint32_t rr_min_io;
+	struct rpc_path_weights path_weights;
 };
 
 static void
@@ -2325,6 +2343,10 @@ rpc_decode_mp_selector(const struct spdk_json_val *val, void *out)
 		*selector = BDEV_NVME_MP_SELECTOR_ROUND_ROBIN;
 	} else if (spdk_json_strequal(val, "queue_depth") == true) {
 		*selector = BDEV_NVME_MP_SELECTOR_QUEUE_DEPTH;
+	} else if (spdk_json_strequal(val, "service_time") == true) {
+		*selector = BDEV_NVME_MP_SELECTOR_SERVICE_TIME;
+	} else if (spdk_json_strequal(val, "weighted_round_robin") == true) {
+		*selector = BDEV_NVME_MP_SELECTOR_WEIGHTED_ROUND_ROBIN;
 	} else {
 		SPDK_NOTICELOG("Invalid parameter value: selector\n");
 		return -EINVAL;
@@ -2333,11 +2355,34 @@ rpc_decode_mp_selector(const struct spdk_json_val *val, void *out)
 	return 0;
 }
 
+static const struct spdk_json_object_decoder rpc_path_weight_decoders[] = {
+	{"cntlid", offsetof(struct rpc_path_weight, cntlid), spdk_json_decode_uint16},
+	{"weight", offsetof(struct rpc_path_weight, weight), spdk_json_decode_uint32},
+};
+
+static int
+rpc_decode_path_weight(const struct spdk_json_val *val, void *out)
+{
+	return spdk_json_decode_object(val, rpc_path_weight_decoders,
+				       SPDK_COUNTOF(rpc_path_weight_decoders), out);
+}
+
+static int
+rpc_decode_path_weights(const struct spdk_json_val *val, void *out)
+{
+	struct rpc_path_weights *path_weights = out;
+
+	return spdk_json_decode_array(val, rpc_decode_path_weight, path_weights->path_weights,
+				      RPC_MAX_PATH_WEIGHTS, &path_weights->num_path_weights,
+				      sizeof(struct rpc_path_weight));
+}
+
 static const struct spdk_json_object_decoder rpc_set_multipath_policy_decoders[] = {
 	{"name", offsetof(struct rpc_set_multipath_policy, name), spdk_json_decode_string},
 	{"policy", offsetof(struct rpc_set_multipath_policy, policy), rpc_decode_mp_policy},
 	{"selector", offsetof(struct rpc_set_multipath_policy, selector), rpc_decode_mp_selector, true},
 	{"rr_min_io", offsetof(struct rpc_set_multipath_policy, rr_min_io), spdk_json_decode_uint32, true},
+	{"path_weights", offsetof(struct rpc_set_multipath_policy, path_weights), rpc_decode_path_weights, true},
 };
 
 struct rpc_set_multipath_policy_ctx {
@@ -2349,6 +2394,14 @@ static void
 rpc_bdev_nvme_set_multipath_policy_done(void *cb_arg, int rc)
 {
 	struct rpc_set_multipath_policy_ctx *ctx = cb_arg;
+	struct rpc_path_weight *path_weight;
+	size_t i;
+
+	/* The weights are only applied once the policy was accepted */
+	for (i = 0; rc == 0 && i < ctx->req.path_weights.num_path_weights; i++) {
+		path_weight = &ctx->req.path_weights.path_weights[i];
+		rc = bdev_nvme_set_path_weight(ctx->req.name, path_weight->cntlid, path_weight->weight);
+	}
 
 	if (rc == 0) {
 		spdk_jsonrpc_send_bool_response(ctx->request, true);
@@ -23,17 +23,19 @@
 
 struct rpc_blobfs_set_cache_size {
 	uint64_t size_in_mb;
+	uint32_t buffer_size_in_kb;
 };
 
 static const struct spdk_json_object_decoder rpc_blobfs_set_cache_size_decoders[] = {
 	{"size_in_mb", offsetof(struct rpc_blobfs_set_cache_size, size_in_mb), spdk_json_decode_uint64},
+	{"buffer_size_in_kb", offsetof(struct rpc_blobfs_set_cache_size, buffer_size_in_kb), spdk_json_decode_uint32, true},
 };
 
 static void
 rpc_blobfs_set_cache_size(struct spdk_jsonrpc_request *request,
 			  const struct spdk_json_val *params)
 {
-	struct rpc_blobfs_set_cache_size req;
+	struct rpc_blobfs_set_cache_size req = {};
 	int rc;
 
 	if (spdk_json_decode_object(params, rpc_blobfs_set_cache_size_decoders,
@@ -53,7 +55,23 @@ rpc_blobfs_set_cache_size(struct spdk_jsonrpc_request *request,
 		return;
 	}
 
-	rc = spdk_fs_set_cache_size(req.size_in_mb);
+	/* The cache has to hold a buffer after each step, so larger buffers are set
+	 * after the cache size and smaller ones before it.
+	 */
+	if (req.buffer_size_in_kb > spdk_fs_get_cache_buffer_size()) {
+		rc = spdk_fs_set_cache_size(req.size_in_mb);
+		if (rc == 0) {
+			rc = spdk_fs_set_cache_buffer_size(req.buffer_size_in_kb);
+		}
+	} else {
+		rc = 0;
+		if (req.buffer_size_in_kb != 0) {
+			rc = spdk_fs_set_cache_buffer_size(req.buffer_size_in_kb);
+		}
+		if (rc == 0) {
+			rc = spdk_fs_set_cache_size(req.size_in_mb);
+		}
+	}
 
 	if (rc == 0) {
 		spdk_jsonrpc_send_bool_response(request, true);
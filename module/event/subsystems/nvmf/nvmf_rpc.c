@@ -231,6 +231,9 @@ static const struct spdk_json_object_decoder nvmf_rpc_subsystem_tgt_conf_decoder
 	{"discovery_filter", offsetof(struct spdk_nvmf_tgt_conf, opts.discovery_filter), decode_discovery_filter, true},
 	{"dhchap_digests", offsetof(struct spdk_nvmf_tgt_conf, opts.dhchap_digests), decode_digest_array, true},
 	{"dhchap_dhgroups", offsetof(struct spdk_nvmf_tgt_conf, opts.dhchap_dhgroups), decode_dhgroup_array, true},
+	{"load_sample_period_us", offsetof(struct spdk_nvmf_tgt_conf, opts.load_sample_period_us), spdk_json_decode_uint64, true},
+	{"rebalance_period_us", offsetof(struct spdk_nvmf_tgt_conf, opts.rebalance_period_us), spdk_json_decode_uint64, true},
+	{"rebalance_threshold", offsetof(struct spdk_nvmf_tgt_conf, opts.rebalance_threshold), spdk_json_decode_uint32, true},
 };
 
 static void
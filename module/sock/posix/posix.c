@@ -16,6 +16,7 @@
 
 #if defined(__linux__)
 #include <linux/errqueue.h>
+#include <linux/tls.h>
 #endif
 
 #include "spdk/env.h"
@@ -40,6 +41,15 @@
 #define SPDK_ZEROCOPY
 #endif
 
+#if defined(__linux__) && defined(SSL_OP_ENABLE_KTLS) && defined(TLS_GET_RECORD_TYPE)
+#define SPDK_KTLS
+#endif
+
+/* TLS record content types, as reported by TLS_GET_RECORD_TYPE */
+#define TLS_RECORD_TYPE_ALERT		21
+#define TLS_RECORD_TYPE_HANDSHAKE	22
+#define TLS_RECORD_TYPE_DATA		23
+
 struct spdk_posix_sock {
 	struct spdk_sock	base;
 	int			fd;
@@ -56,6 +66,9 @@ struct spdk_posix_sock {
 
 	SSL_CTX			*ctx;
 	SSL			*ssl;
+	/* Set once the kernel encrypts/decrypts the records and OpenSSL is out of the data path */
+	bool			ktls_tx;
+	bool			ktls_rx;
 
 	TAILQ_ENTRY(spdk_posix_sock)	link;
 
@@ -927,6 +940,151 @@ SSL_writev(SSL *ssl, struct iovec *iov, int iovcnt)
 	}
 }
 
+/* Once the handshake is done and OpenSSL has installed the keys in the kernel (TLS_TX/TLS_RX),
+ * the socket is read and written directly, which keeps vectored I/O and the receive pipe. */
+static void
+posix_sock_update_ktls(struct spdk_posix_sock *sock)
+{
+#ifdef SPDK_KTLS
+	int saved_errno = errno;
+
+	if (!sock->base.impl_opts.enable_ktls || (sock->ktls_tx && sock->ktls_rx) ||
+	    !SSL_is_init_finished(sock->ssl)) {
+		return;
+	}
+
+	if (!sock->ktls_tx && BIO_get_ktls_send(SSL_get_wbio(sock->ssl))) {
+		SPDK_DEBUGLOG(sock_posix, "kTLS TX enabled on sock %p\n", sock);
+		sock->ktls_tx = true;
+	}
+
+	/* Records OpenSSL already pulled off the socket have to be consumed through it first */
+	if (!sock->ktls_rx && BIO_get_ktls_recv(SSL_get_rbio(sock->ssl)) &&
+	    !SSL_has_pending(sock->ssl)) {
+		SPDK_DEBUGLOG(sock_posix, "kTLS RX enabled on sock %p\n", sock);
+		sock->ktls_rx = true;
+	}
+
+	errno = saved_errno;
+#endif
+}
+
+#ifdef SPDK_KTLS
+/* A control record of len bytes was received into the user's buffers, it isn't reported as
+ * data and gets overwritten by whatever comes next.  Returns 0 if the record can be skipped,
+ * -ESHUTDOWN if the peer closed the connection, or -ENOTCONN for any other record. */
+static int
+posix_sock_ktls_ctrl_record(struct spdk_posix_sock *sock, uint8_t record_type,
+			    struct iovec *iov, int iovcnt, size_t len)
+{
+	uint8_t record[2] = {};
+
+	/* Only the message type of a handshake record, or the level and description of an
+	 * alert are needed, and they may be split across the iovs. */
+	spdk_copy_iovs_to_buf(record, spdk_min(len, sizeof(record)), iov, iovcnt);
+
+	switch (record_type) {
+	case TLS_RECORD_TYPE_HANDSHAKE:
+		/* Post-handshake messages other than session tickets (e.g. KeyUpdate) would need
+		 * new keys to be installed, which isn't supported. */
+		if (len >= 1 && record[0] == SSL3_MT_NEWSESSION_TICKET) {
+			SPDK_DEBUGLOG(sock_posix, "Ignoring NewSessionTicket on sock %p\n", sock);
+			return 0;
+		}
+		SPDK_ERRLOG("Unsupported post-handshake message %u on sock %p\n", record[0], sock);
+		return -ENOTCONN;
+	case TLS_RECORD_TYPE_ALERT:
+		if (len >= 2 && record[1] == SSL_AD_CLOSE_NOTIFY) {
+			return -ESHUTDOWN;
+		}
+		SPDK_ERRLOG("Received TLS alert %u on sock %p\n", record[1], sock);
+		return -ENOTCONN;
+	default:
+		SPDK_ERRLOG("Unexpected TLS record type %u on sock %p\n", record_type, sock);
+		return -ENOTCONN;
+	}
+}
+
+static ssize_t
+posix_sock_ktls_readv(struct spdk_posix_sock *sock, struct iovec *iov, int iovcnt)
+{
+	char cbuf[CMSG_SPACE(sizeof(uint8_t))];
+	struct msghdr msg = {};
+	struct cmsghdr *cmsg;
+	uint8_t record_type;
+	ssize_t rc;
+
+	while (true) {
+		msg.msg_iov = iov;
+		msg.msg_iovlen = iovcnt;
+		msg.msg_control = cbuf;
+		msg.msg_controllen = sizeof(cbuf);
+		msg.msg_flags = 0;
+
+		rc = recvmsg(sock->fd, &msg, 0);
+		if (rc <= 0) {
+			return rc;
+		}
+
+		cmsg = CMSG_FIRSTHDR(&msg);
+		if (cmsg == NULL || cmsg->cmsg_level != SOL_TLS || cmsg->cmsg_type != TLS_GET_RECORD_TYPE) {
+			return rc;
+		}
+
+		record_type = *(uint8_t *)CMSG_DATA(cmsg);
+		if (record_type == TLS_RECORD_TYPE_DATA) {
+			return rc;
+		}
+
+		rc = posix_sock_ktls_ctrl_record(sock, record_type, iov, iovcnt, rc);
+		if (rc != 0) {
+			errno = ENOTCONN;
+			return rc == -ESHUTDOWN ? 0 : -1;
+		}
+	}
+}
+#endif
+
+static ssize_t
+posix_sock_fd_readv(struct spdk_posix_sock *sock, struct iovec *iov, int iovcnt)
+{
+	ssize_t rc;
+
+	if (sock->ssl == NULL) {
+		return readv(sock->fd, iov, iovcnt);
+	}
+
+#ifdef SPDK_KTLS
+	if (sock->ktls_rx) {
+		return posix_sock_ktls_readv(sock, iov, iovcnt);
+	}
+#endif
+
+	rc = SSL_readv(sock->ssl, iov, iovcnt);
+	posix_sock_update_ktls(sock);
+
+	return rc;
+}
+
+static ssize_t
+posix_sock_fd_writev(struct spdk_posix_sock *sock, struct iovec *iov, int iovcnt, int flags)
+{
+	struct msghdr msg = {};
+	ssize_t rc;
+
+	if (sock->ssl == NULL || sock->ktls_tx) {
+		msg.msg_iov = iov;
+		msg.msg_iovlen = iovcnt;
+
+		return sendmsg(sock->fd, &msg, flags);
+	}
+
+	rc = SSL_writev(sock->ssl, iov, iovcnt);
+	posix_sock_update_ktls(sock);
+
+	return rc;
+}
+
 static struct spdk_sock *
 posix_sock_create(const char *ip, int port,
 		  enum posix_sock_create_type type,
@@ -1347,7 +1505,6 @@ static int
 _sock_flush(struct spdk_sock *sock)
 {
 	struct spdk_posix_sock *psock = __posix_sock(sock);
-	struct msghdr msg = {};
 	int flags;
 	struct iovec iovs[IOV_BATCH_SIZE];
 	int iovcnt;
@@ -1384,14 +1541,7 @@ _sock_flush(struct spdk_sock *sock)
 #endif
 
 	/* Perform the vectored write */
-	msg.msg_iov = iovs;
-	msg.msg_iovlen = iovcnt;
-
-	if (psock->ssl) {
-		rc = SSL_writev(psock->ssl, iovs, iovcnt);
-	} else {
-		rc = sendmsg(psock->fd, &msg, flags);
-	}
+	rc = posix_sock_fd_writev(psock, iovs, iovcnt, flags);
 	if (rc <= 0) {
 		if (rc == 0 || errno == EAGAIN || errno == EWOULDBLOCK || (errno == ENOBUFS && psock->zcopy)) {
 			errno = EAGAIN;
@@ -1536,11 +1686,7 @@ posix_sock_read(struct spdk_posix_sock *sock)
 		return bytes_avail;
 	}
 
-	if (sock->ssl) {
-		bytes_recvd = SSL_readv(sock->ssl, iov, 2);
-	} else {
-		bytes_recvd = readv(sock->fd, iov, 2);
-	}
+	bytes_recvd = posix_sock_fd_readv(sock, iov, 2);
 
 	assert(sock->pipe_has_data == false);
 
@@ -1587,11 +1733,7 @@ posix_sock_readv(struct spdk_sock *_sock, struct iovec *iov, int iovcnt)
 			sock->socket_has_data = false;
 			TAILQ_REMOVE(&group->socks_with_data, sock, link);
 		}
-		if (sock->ssl) {
-			return SSL_readv(sock->ssl, iov, iovcnt);
-		} else {
-			return readv(sock->fd, iov, iovcnt);
-		}
+		return posix_sock_fd_readv(sock, iov, iovcnt);
 	}
 
 	/* If the socket is not in a group, we must assume it always has
@@ -1606,11 +1748,7 @@ posix_sock_readv(struct spdk_sock *_sock, struct iovec *iov, int iovcnt)
 
 		if (len >= MIN_SOCK_PIPE_SIZE) {
 			/* TODO: Should this detect if kernel socket is drained? */
-			if (sock->ssl) {
-				return SSL_readv(sock->ssl, iov, iovcnt);
-			} else {
-				return readv(sock->fd, iov, iovcnt);
-			}
+			return posix_sock_fd_readv(sock, iov, iovcnt);
 		}
 
 		/* Otherwise, do a big read into our pipe */
@@ -1653,11 +1791,7 @@ posix_sock_writev(struct spdk_sock *_sock, struct iovec *iov, int iovcnt)
 		return -1;
 	}
 
-	if (sock->ssl) {
-		return SSL_writev(sock->ssl, iov, iovcnt);
-	} else {
-		return writev(sock->fd, iov, iovcnt);
-	}
+	return posix_sock_fd_writev(sock, iov, iovcnt, 0);
 }
 
 static int
@@ -639,7 +639,8 @@ def bdev_nvme_set_options(client, action_on_timeout=None, timeout_us=None, timeo
                           fast_io_fail_timeout_sec=None, disable_auto_failback=None, generate_uuids=None,
                           transport_tos=None, nvme_error_stat=None, rdma_srq_size=None, io_path_stat=None,
                           allow_accel_sequence=None, rdma_max_cq_size=None, rdma_cm_event_timeout_ms=None,
-                          dhchap_digests=None, dhchap_dhgroups=None):
+                          dhchap_digests=None, dhchap_dhgroups=None, immediate_failover_count=None,
+                          path_breaker_threshold=None, path_breaker_backoff_ms=None):
     """Set options for the bdev nvme. This is startup command.
     Args:
         action_on_timeout:  action to take on command time out. Valid values are: none, reset, abort (optional)
@@ -688,6 +689,11 @@ def bdev_nvme_set_options(client, action_on_timeout=None, timeout_us=None, timeo
         rdma_cm_event_timeout_ms: Time to wait for RDMA CM event. Only applicable for RDMA transports.
         dhchap_digests: List of allowed DH-HMAC-CHAP digests. (optional)
         dhchap_dhgroups: List of allowed DH-HMAC-CHAP DH groups. (optional)
+        immediate_failover_count: The number of times per I/O that an I/O failed by a path error is resubmitted
+        to another available I/O path immediately. Default: 0 (disabled) (optional)
+        path_breaker_threshold: The number of consecutive I/Os failed by path errors that stops routing new I/Os
+        to the I/O path for path_breaker_backoff_ms. Default: 0 (disabled) (optional)
+        path_breaker_backoff_ms: Time to stop routing new I/Os to a tripped I/O path. Default: 1000 (optional)
     """
     params = dict()
     if action_on_timeout is not None:
@@ -748,6 +754,12 @@ def bdev_nvme_set_options(client, action_on_timeout=None, timeout_us=None, timeo
         params['dhchap_digests'] = dhchap_digests
     if dhchap_dhgroups is not None:
         params['dhchap_dhgroups'] = dhchap_dhgroups
+    if immediate_failover_count is not None:
+        params['immediate_failover_count'] = immediate_failover_count
+    if path_breaker_threshold is not None:
+        params['path_breaker_threshold'] = path_breaker_threshold
+    if path_breaker_backoff_ms is not None:
+        params['path_breaker_backoff_ms'] = path_breaker_backoff_ms
     return client.call('bdev_nvme_set_options', params)
 
 
@@ -771,7 +783,7 @@ def bdev_nvme_attach_controller(client, name, trtype, traddr, adrfam=None, trsvc
                                 multipath=None, num_io_queues=None, ctrlr_loss_timeout_sec=None,
                                 reconnect_delay_sec=None, fast_io_fail_timeout_sec=None,
                                 psk=None, max_bdevs=None, dhchap_key=None, dhchap_ctrlr_key=None,
-                                allow_unrecognized_csi=None):
+                                allow_unrecognized_csi=None, num_io_connections=None):
     """Construct block device for each NVMe namespace in the attached controller.
     Args:
         name: bdev name prefix; "n" + namespace ID will be appended to create unique names
@@ -811,6 +823,7 @@ def bdev_nvme_attach_controller(client, name, trtype, traddr, adrfam=None, trsvc
         dhchap_ctrlr_key: DH-HMAC-CHAP controller key name.
         allow_unrecognized_csi: Allow attaching namespaces with unrecognized command set identifiers. These will only support NVMe
         passthrough.
+        num_io_connections: Number of TCP connections each I/O qpair is striped across. Default is 1. (optional)
     Returns:
         Names of created block devices.
     """
@@ -862,6 +875,8 @@ def bdev_nvme_attach_controller(client, name, trtype, traddr, adrfam=None, trsvc
         params['dhchap_ctrlr_key'] = dhchap_ctrlr_key
     if allow_unrecognized_csi is not None:
         params['allow_unrecognized_csi'] = allow_unrecognized_csi
+    if num_io_connections is not None:
+        params['num_io_connections'] = num_io_connections
     return client.call('bdev_nvme_attach_controller', params)
 
 
@@ -1034,13 +1049,14 @@ def bdev_nvme_set_preferred_path(client, name, cntlid):
     return client.call('bdev_nvme_set_preferred_path', params)
 
 
-def bdev_nvme_set_multipath_policy(client, name, policy, selector=None, rr_min_io=None):
+def bdev_nvme_set_multipath_policy(client, name, policy, selector=None, rr_min_io=None, path_weights=None):
     """Set multipath policy of the NVMe bdev
     Args:
         name: NVMe bdev name
         policy: Multipath policy (active_passive or active_active)
-        selector: Multipath selector (round_robin, queue_depth)
+        selector: Multipath selector (round_robin, queue_depth, service_time, weighted_round_robin)
         rr_min_io: Number of IO to route to a path before switching to another one (optional)
+        path_weights: List of {'cntlid': cntlid, 'weight': weight} for the weighted_round_robin selector (optional)
     """
     params = dict()
     params['name'] = name
@@ -1049,6 +1065,8 @@ def bdev_nvme_set_multipath_policy(client, name, policy, selector=None, rr_min_i
         params['selector'] = selector
     if rr_min_io is not None:
         params['rr_min_io'] = rr_min_io
+    if path_weights is not None:
+        params['path_weights'] = path_weights
     return client.call('bdev_nvme_set_multipath_policy', params)
 
 
@@ -47,11 +47,12 @@ def blobfs_mount(client, bdev_name, mountpoint):
     return client.call('blobfs_mount', params)
 
 
-def blobfs_set_cache_size(client, size_in_mb):
+def blobfs_set_cache_size(client, size_in_mb, buffer_size_in_kb=None):
     """Set cache size for the blobstore filesystem.
 
     Args:
         size_in_mb: Cache size in megabytes
+        buffer_size_in_kb: Size of a single cache buffer in kilobytes (optional)
 
     Returns:
         True if cache size is set successfully; False if failed to set.
@@ -59,4 +60,6 @@ def blobfs_set_cache_size(client, size_in_mb):
     params = {
         'size_in_mb': size_in_mb
     }
+    if buffer_size_in_kb is not None:
+        params['buffer_size_in_kb'] = buffer_size_in_kb
     return client.call('blobfs_set_cache_size', params)
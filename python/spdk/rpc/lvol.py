@@ -59,6 +59,80 @@ def bdev_lvol_grow_lvstore(client, uuid=None, lvs_name=None):
     return client.call('bdev_lvol_grow_lvstore', params)
 
 
+def bdev_lvol_start_defrag(client, uuid=None, lvs_name=None, max_bw_mbps=None):
+    """Start defragmentation of the logical volume store
+
+    Args:
+        uuid: UUID of logical volume store to defragment (optional)
+        lvs_name: name of logical volume store to defragment (optional)
+        max_bw_mbps: bandwidth limit of the cluster moves in MiB/s, 0 for no limit (optional)
+    """
+    if (uuid and lvs_name):
+        raise ValueError("Exactly one of uuid or lvs_name may be specified")
+    params = {}
+    if uuid:
+        params['uuid'] = uuid
+    if lvs_name:
+        params['lvs_name'] = lvs_name
+    if max_bw_mbps is not None:
+        params['max_bw_mbps'] = max_bw_mbps
+    return client.call('bdev_lvol_start_defrag', params)
+
+
+def bdev_lvol_stop_defrag(client, uuid=None, lvs_name=None):
+    """Stop defragmentation of the logical volume store
+
+    Args:
+        uuid: UUID of logical volume store (optional)
+        lvs_name: name of logical volume store (optional)
+    """
+    if (uuid and lvs_name):
+        raise ValueError("Exactly one of uuid or lvs_name may be specified")
+    params = {}
+    if uuid:
+        params['uuid'] = uuid
+    if lvs_name:
+        params['lvs_name'] = lvs_name
+    return client.call('bdev_lvol_stop_defrag', params)
+
+
+def bdev_lvol_start_dedup(client, uuid=None, lvs_name=None, max_bw_mbps=None):
+    """Start deduplication of the logical volume store
+
+    Args:
+        uuid: UUID of logical volume store to deduplicate (optional)
+        lvs_name: name of logical volume store to deduplicate (optional)
+        max_bw_mbps: bandwidth limit of the cluster reads in MiB/s, 0 for no limit (optional)
+    """
+    if (uuid and lvs_name):
+        raise ValueError("Exactly one of uuid or lvs_name may be specified")
+    params = {}
+    if uuid:
+        params['uuid'] = uuid
+    if lvs_name:
+        params['lvs_name'] = lvs_name
+    if max_bw_mbps is not None:
+        params['max_bw_mbps'] = max_bw_mbps
+    return client.call('bdev_lvol_start_dedup', params)
+
+
+def bdev_lvol_stop_dedup(client, uuid=None, lvs_name=None):
+    """Stop deduplication of the logical volume store
+
+    Args:
+        uuid: UUID of logical volume store (optional)
+        lvs_name: name of logical volume store (optional)
+    """
+    if (uuid and lvs_name):
+        raise ValueError("Exactly one of uuid or lvs_name may be specified")
+    params = {}
+    if uuid:
+        params['uuid'] = uuid
+    if lvs_name:
+        params['lvs_name'] = lvs_name
+    return client.call('bdev_lvol_stop_dedup', params)
+
+
 def bdev_lvol_create(client, lvol_name, size_in_mib, thin_provision=False, uuid=None, lvs_name=None, clear_method=None):
     """Create a logical volume on a logical volume store.
 
@@ -284,6 +358,28 @@ def bdev_lvol_start_shallow_copy(client, src_lvol_name, dst_bdev_name):
     return client.call('bdev_lvol_start_shallow_copy', params)
 
 
+def bdev_lvol_start_diff_copy(client, src_lvol_name, dst_bdev_name, base_lvol_name=None,
+                              queue_depth=None):
+    """Start a copy of the clusters of an lvol changed since one of its snapshots over
+    a given bdev. The status of the operation can be obtained with bdev_lvol_check_shallow_copy
+
+    Args:
+        src_lvol_name: name of lvol to create a copy from
+        dst_bdev_name: name of the bdev that acts as destination for the copy
+        base_lvol_name: name of the snapshot of src_lvol the copy is relative to (optional)
+        queue_depth: maximum number of clusters copied at a time (optional)
+    """
+    params = {
+        'src_lvol_name': src_lvol_name,
+        'dst_bdev_name': dst_bdev_name
+    }
+    if base_lvol_name:
+        params['base_lvol_name'] = base_lvol_name
+    if queue_depth is not None:
+        params['queue_depth'] = queue_depth
+    return client.call('bdev_lvol_start_diff_copy', params)
+
+
 def bdev_lvol_check_shallow_copy(client, operation_id):
     """Get shallow copy status
 
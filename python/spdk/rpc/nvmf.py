@@ -24,7 +24,8 @@ def nvmf_set_max_subsystems(client,
 def nvmf_set_config(client,
                     passthru_identify_ctrlr=None,
                     poll_groups_mask=None,
-                    discovery_filter=None, dhchap_digests=None, dhchap_dhgroups=None):
+                    discovery_filter=None, dhchap_digests=None, dhchap_dhgroups=None,
+                    load_sample_period_us=None, rebalance_period_us=None, rebalance_threshold=None):
     """Set NVMe-oF target subsystem configuration.
 
     Args:
@@ -32,6 +33,9 @@ def nvmf_set_config(client,
          comma separated values: `transport`, `address`, `svcid`
         dhchap_digests: List of allowed DH-HMAC-CHAP digests. (optional)
         dhchap_dhgroups: List of allowed DH-HMAC-CHAP DH groups. (optional)
+        load_sample_period_us: Period of poll group load sampling; enables load-aware qpair placement. (optional)
+        rebalance_period_us: Period of the qpair rebalancer; 0 disables it. (optional)
+        rebalance_threshold: Load imbalance in percent that triggers a qpair migration. (optional)
     Returns:
         True or False
     """
@@ -49,6 +53,12 @@ def nvmf_set_config(client,
         params['dhchap_digests'] = dhchap_digests
     if dhchap_dhgroups is not None:
         params['dhchap_dhgroups'] = dhchap_dhgroups
+    if load_sample_period_us is not None:
+        params['load_sample_period_us'] = load_sample_period_us
+    if rebalance_period_us is not None:
+        params['rebalance_period_us'] = rebalance_period_us
+    if rebalance_threshold is not None:
+        params['rebalance_threshold'] = rebalance_threshold
 
     return client.call('nvmf_set_config', params)
 
@@ -118,6 +128,10 @@ def nvmf_create_transport(client, **params):
         zcopy: Use zero-copy operations if the underlying bdev supports them (optional)
         num_cqe: The number of CQ entries to configure CQ size. Only used when no_srq=true - RDMA specific (optional)
         max_srq_depth: Max number of outstanding I/O per shared receive queue - RDMA specific (optional)
+        min_srq_depth: Initial and minimal number of receives posted to a shared receive queue. When set,
+         the depth adapts to the load between min_srq_depth and max_srq_depth - RDMA specific (optional)
+        srq_mem_budget_mb: Memory limit for the in-capsule data buffers of all adaptive shared receive
+         queues in MiB, 0 means unlimited - RDMA specific (optional)
         no_srq: Boolean flag to disable SRQ even for devices that support it - RDMA specific (optional)
         c2h_success: Boolean flag to disable the C2H success optimization - TCP specific (optional)
         dif_insert_or_strip: Boolean flag to enable DIF insert/strip for I/O - TCP specific (optional)
@@ -125,9 +139,13 @@ def nvmf_create_transport(client, **params):
         abort_timeout_sec: Abort execution timeout value, in seconds (optional)
         no_wr_batching: Boolean flag to disable work requests batching - RDMA specific (optional)
         control_msg_num: The number of control messages per poll group - TCP specific (optional)
+        shared_buf_pool: Take request PDUs and in-capsule data buffers from a pool shared by the qpairs
+         of a poll group instead of preallocating them per qpair - TCP specific (optional)
         disable_mappable_bar0: disable client mmap() of BAR0 - VFIO-USER specific (optional)
         disable_adaptive_irq: Disable adaptive interrupt feature - VFIO-USER specific (optional)
         disable_shadow_doorbells: disable shadow doorbell support - VFIO-USER specific (optional)
+        intr_mode_idle_polls: In interrupt mode, number of polls without new commands after which an SQ
+         is switched back from polling to interrupts, 0 disables it - VFIO-USER specific (optional)
         acceptor_poll_rate: Acceptor poll period in microseconds (optional)
         ack_timeout: ACK timeout in milliseconds (optional)
         data_wr_pool_size: RDMA data WR pool size. RDMA specific (optional)
@@ -474,6 +492,7 @@ def nvmf_subsystem_add_ns(client, **params):
         uuid: Namespace UUID (optional).
         anagrpid: ANA group ID (optional).
         no_auto_visible: Do not automatically make namespace visible to controllers
+        read_cache_size_mb: Size of the namespace read cache in MiB (optional).
 
     Returns:
         The namespace ID
@@ -482,7 +501,8 @@ def nvmf_subsystem_add_ns(client, **params):
     strip_globals(params)
     apply_defaults(params, tgt_name=None)
     group_as(params, 'namespace', ['bdev_name', 'ptpl_file', 'nsid',
-                                   'nguid', 'eui64', 'uuid', 'anagrpid', 'no_auto_visible'])
+                                   'nguid', 'eui64', 'uuid', 'anagrpid', 'no_auto_visible',
+                                   'read_cache_size_mb'])
     remove_null(params)
 
     return client.call('nvmf_subsystem_add_ns', params)
@@ -510,6 +530,93 @@ def nvmf_subsystem_set_ns_ana_group(client, nqn, nsid, anagrpid, tgt_name=None):
     return client.call('nvmf_subsystem_set_ns_ana_group', params)
 
 
+def nvmf_subsystem_set_qos(client, nqn, host=None, nsid=None, rw_ios_per_sec=None,
+                           rw_mbytes_per_sec=None, min_rw_ios_per_sec=None,
+                           min_rw_mbytes_per_sec=None, tgt_name=None):
+    """Set the QoS limits of the I/O of a host to a namespace of a subsystem.
+
+    Args:
+        nqn: Subsystem NQN.
+        host: Host NQN the limits apply to, all hosts if not specified (optional).
+        nsid: Namespace ID the limits apply to, all namespaces if not specified (optional).
+        rw_ios_per_sec: Maximum read/write I/O per second, 0 means unlimited (optional).
+        rw_mbytes_per_sec: Maximum read/write MiB per second, 0 means unlimited (optional).
+        min_rw_ios_per_sec: Read/write I/O per second of the host not held back by
+        the limits shared with other hosts (optional).
+        min_rw_mbytes_per_sec: Read/write MiB per second of the host not held back by
+        the limits shared with other hosts (optional).
+        tgt_name: name of the parent NVMe-oF target (optional).
+
+    Returns:
+        True or False
+    """
+    params = {'nqn': nqn}
+
+    if host:
+        params['host'] = host
+    if nsid is not None:
+        params['nsid'] = nsid
+    if rw_ios_per_sec is not None:
+        params['rw_ios_per_sec'] = rw_ios_per_sec
+    if rw_mbytes_per_sec is not None:
+        params['rw_mbytes_per_sec'] = rw_mbytes_per_sec
+    if min_rw_ios_per_sec is not None:
+        params['min_rw_ios_per_sec'] = min_rw_ios_per_sec
+    if min_rw_mbytes_per_sec is not None:
+        params['min_rw_mbytes_per_sec'] = min_rw_mbytes_per_sec
+    if tgt_name:
+        params['tgt_name'] = tgt_name
+
+    return client.call('nvmf_subsystem_set_qos', params)
+
+
+def nvmf_subsystem_set_telemetry(client, nqn, enable, tgt_name=None):
+    """Enable or disable the I/O telemetry of a subsystem.
+
+    Args:
+        nqn: Subsystem NQN.
+        enable: Whether to collect the telemetry.
+        tgt_name: name of the parent NVMe-oF target (optional).
+
+    Returns:
+        True or False
+    """
+    params = {'nqn': nqn,
+              'enable': enable}
+
+    if tgt_name:
+        params['tgt_name'] = tgt_name
+
+    return client.call('nvmf_subsystem_set_telemetry', params)
+
+
+def nvmf_subsystem_get_telemetry(client, nqn, host=None, nsid=None, delta=None, tgt_name=None):
+    """Get the I/O telemetry of the hosts on the namespaces of a subsystem.
+
+    Args:
+        nqn: Subsystem NQN.
+        host: Host NQN, all hosts if not specified (optional).
+        nsid: Namespace ID, all namespaces if not specified (optional).
+        delta: Report the statistics since the previous delta read (optional).
+        tgt_name: name of the parent NVMe-oF target (optional).
+
+    Returns:
+        The statistics of each host on each namespace.
+    """
+    params = {'nqn': nqn}
+
+    if host:
+        params['host'] = host
+    if nsid is not None:
+        params['nsid'] = nsid
+    if delta is not None:
+        params['delta'] = delta
+    if tgt_name:
+        params['tgt_name'] = tgt_name
+
+    return client.call('nvmf_subsystem_get_telemetry', params)
+
+
 def nvmf_subsystem_remove_ns(client, nqn, nsid, tgt_name=None):
     """Remove a existing namespace from a subsystem.
 
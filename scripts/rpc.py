@@ -623,7 +623,10 @@ if __name__ == "__main__":
                                        rdma_max_cq_size=args.rdma_max_cq_size,
                                        rdma_cm_event_timeout_ms=args.rdma_cm_event_timeout_ms,
                                        dhchap_digests=args.dhchap_digests,
-                                       dhchap_dhgroups=args.dhchap_dhgroups)
+                                       dhchap_dhgroups=args.dhchap_dhgroups,
+                                       immediate_failover_count=args.immediate_failover_count,
+                                       path_breaker_threshold=args.path_breaker_threshold,
+                                       path_breaker_backoff_ms=args.path_breaker_backoff_ms)
 
     p = subparsers.add_parser('bdev_nvme_set_options',
                               help='Set options for the bdev nvme type. This is startup command.')
@@ -710,6 +713,14 @@ if __name__ == "__main__":
                    type=lambda d: d.split(','))
     p.add_argument('--dhchap-dhgroups', help='Comma-separated list of allowed DH-HMAC-CHAP DH groups',
                    type=lambda d: d.split(','))
+    p.add_argument('--immediate-failover-count',
+                   help="""The number of times per I/O that an I/O failed by a path error is resubmitted to
+                   another available I/O path immediately. Default: 0 (disabled)""", type=int)
+    p.add_argument('--path-breaker-threshold',
+                   help="""The number of consecutive I/Os failed by path errors that stops routing new I/Os
+                   to the I/O path for path_breaker_backoff_ms. Default: 0 (disabled)""", type=int)
+    p.add_argument('--path-breaker-backoff-ms',
+                   help='Time to stop routing new I/Os to a tripped I/O path. Default: 1000', type=int)
 
     p.set_defaults(func=bdev_nvme_set_options)
 
@@ -749,7 +760,8 @@ if __name__ == "__main__":
                                                          max_bdevs=args.max_bdevs,
                                                          dhchap_key=args.dhchap_key,
                                                          dhchap_ctrlr_key=args.dhchap_ctrlr_key,
-                                                         allow_unrecognized_csi=args.allow_unrecognized_csi))
+                                                         allow_unrecognized_csi=args.allow_unrecognized_csi,
+                                                         num_io_connections=args.num_io_connections))
 
     p = subparsers.add_parser('bdev_nvme_attach_controller', help='Add bdevs with nvme backend')
     p.add_argument('-b', '--name', help="Name of the NVMe controller, prefix for each bdev name", required=True)
@@ -811,6 +823,8 @@ if __name__ == "__main__":
     p.add_argument('--dhchap-ctrlr-key', help='DH-HMAC-CHAP controller key name')
     p.add_argument('-U', '--allow-unrecognized-csi', help="""Allow attaching namespaces with unrecognized command set identifiers.
                    These will only support NVMe passthrough.""", action='store_true')
+    p.add_argument('--num-io-connections', help='Number of TCP connections each I/O qpair is striped across. Default: 1',
+                   type=int)
 
     p.set_defaults(func=bdev_nvme_attach_controller)
 
@@ -970,20 +984,31 @@ if __name__ == "__main__":
     p.set_defaults(func=bdev_nvme_set_preferred_path)
 
     def bdev_nvme_set_multipath_policy(args):
+        path_weights = None
+        if args.path_weights is not None:
+            path_weights = []
+            for u in args.path_weights.strip().split(','):
+                cntlid, weight = u.split(':')
+                path_weights.append({'cntlid': int(cntlid), 'weight': int(weight)})
         rpc.bdev.bdev_nvme_set_multipath_policy(args.client,
                                                 name=args.name,
                                                 policy=args.policy,
                                                 selector=args.selector,
-                                                rr_min_io=args.rr_min_io)
+                                                rr_min_io=args.rr_min_io,
+                                                path_weights=path_weights)
 
     p = subparsers.add_parser('bdev_nvme_set_multipath_policy',
                               help="""Set multipath policy of the NVMe bdev""")
     p.add_argument('-b', '--name', help='Name of the NVMe bdev', required=True)
     p.add_argument('-p', '--policy', help='Multipath policy (active_passive or active_active)', required=True)
-    p.add_argument('-s', '--selector', help='Multipath selector (round_robin, queue_depth)')
+    p.add_argument('-s', '--selector',
+                   help='Multipath selector (round_robin, queue_depth, service_time, weighted_round_robin)')
     p.add_argument('-r', '--rr-min-io',
                    help='Number of IO to route to a path before switching to another for round-robin',
                    type=int)
+    p.add_argument('-w', '--path-weights',
+                   help="""Comma-separated list of cntlid:weight pairs for weighted_round_robin selector.
+                   Example: '0:3,1:1'""")
     p.set_defaults(func=bdev_nvme_set_multipath_policy)
 
     def bdev_nvme_get_path_iostat(args):
@@ -2080,6 +2105,56 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('-l', '--lvs-name', help='lvol store name')
     p.set_defaults(func=bdev_lvol_grow_lvstore)
 
+    def bdev_lvol_start_defrag(args):
+        print_dict(rpc.lvol.bdev_lvol_start_defrag(args.client,
+                                                   uuid=args.uuid,
+                                                   lvs_name=args.lvs_name,
+                                                   max_bw_mbps=args.max_bw_mbps))
+
+    p = subparsers.add_parser('bdev_lvol_start_defrag',
+                              help='Start moving lvol clusters so each lvol becomes physically contiguous')
+    p.add_argument('-u', '--uuid', help='lvol store UUID')
+    p.add_argument('-l', '--lvs-name', help='lvol store name')
+    p.add_argument('-b', '--max-bw-mbps', help='Bandwidth limit of the cluster moves in MiB/s, 0 for no limit',
+                   type=int)
+    p.set_defaults(func=bdev_lvol_start_defrag)
+
+    def bdev_lvol_stop_defrag(args):
+        print_dict(rpc.lvol.bdev_lvol_stop_defrag(args.client,
+                                                  uuid=args.uuid,
+                                                  lvs_name=args.lvs_name))
+
+    p = subparsers.add_parser('bdev_lvol_stop_defrag',
+                              help='Stop the lvol store defragmentation')
+    p.add_argument('-u', '--uuid', help='lvol store UUID')
+    p.add_argument('-l', '--lvs-name', help='lvol store name')
+    p.set_defaults(func=bdev_lvol_stop_defrag)
+
+    def bdev_lvol_start_dedup(args):
+        print_dict(rpc.lvol.bdev_lvol_start_dedup(args.client,
+                                                  uuid=args.uuid,
+                                                  lvs_name=args.lvs_name,
+                                                  max_bw_mbps=args.max_bw_mbps))
+
+    p = subparsers.add_parser('bdev_lvol_start_dedup',
+                              help='Start sharing identical clusters between the lvols of an lvol store')
+    p.add_argument('-u', '--uuid', help='lvol store UUID')
+    p.add_argument('-l', '--lvs-name', help='lvol store name')
+    p.add_argument('-b', '--max-bw-mbps', help='Bandwidth limit of the cluster reads in MiB/s, 0 for no limit',
+                   type=int)
+    p.set_defaults(func=bdev_lvol_start_dedup)
+
+    def bdev_lvol_stop_dedup(args):
+        print_dict(rpc.lvol.bdev_lvol_stop_dedup(args.client,
+                                                 uuid=args.uuid,
+                                                 lvs_name=args.lvs_name))
+
+    p = subparsers.add_parser('bdev_lvol_stop_dedup',
+                              help='Stop the lvol store deduplication')
+    p.add_argument('-u', '--uuid', help='lvol store UUID')
+    p.add_argument('-l', '--lvs-name', help='lvol store name')
+    p.set_defaults(func=bdev_lvol_stop_dedup)
+
     def bdev_lvol_create(args):
         print_json(rpc.lvol.bdev_lvol_create(args.client,
                                              lvol_name=args.lvol_name,
@@ -2237,6 +2312,22 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('dst_bdev_name', help='destination bdev name')
     p.set_defaults(func=bdev_lvol_start_shallow_copy)
 
+    def bdev_lvol_start_diff_copy(args):
+        print_json(rpc.lvol.bdev_lvol_start_diff_copy(args.client,
+                                                      src_lvol_name=args.src_lvol_name,
+                                                      dst_bdev_name=args.dst_bdev_name,
+                                                      base_lvol_name=args.base_lvol_name,
+                                                      queue_depth=args.queue_depth))
+
+    p = subparsers.add_parser('bdev_lvol_start_diff_copy',
+                              help="""Start a copy of the clusters of an lvol changed since one of its snapshots
+    over a given bdev. The status of the operation can be obtained with bdev_lvol_check_shallow_copy""")
+    p.add_argument('src_lvol_name', help='source lvol name')
+    p.add_argument('dst_bdev_name', help='destination bdev name')
+    p.add_argument('-b', '--base-lvol-name', help='snapshot of the source lvol the copy is relative to')
+    p.add_argument('-q', '--queue-depth', help='maximum number of clusters copied at a time', type=int)
+    p.set_defaults(func=bdev_lvol_start_diff_copy)
+
     def bdev_lvol_check_shallow_copy(args):
         print_json(rpc.lvol.bdev_lvol_check_shallow_copy(args.client,
                                                          operation_id=args.operation_id))
@@ -2690,7 +2781,10 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
                                  poll_groups_mask=args.poll_groups_mask,
                                  discovery_filter=args.discovery_filter,
                                  dhchap_digests=args.dhchap_digests,
-                                 dhchap_dhgroups=args.dhchap_dhgroups)
+                                 dhchap_dhgroups=args.dhchap_dhgroups,
+                                 load_sample_period_us=args.load_sample_period_us,
+                                 rebalance_period_us=args.rebalance_period_us,
+                                 rebalance_threshold=args.rebalance_threshold)
 
     p = subparsers.add_parser('nvmf_set_config', help='Set NVMf target config')
     p.add_argument('-i', '--passthru-identify-ctrlr', help="""Passthrough fields like serial number and model number
@@ -2702,6 +2796,11 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
                    type=lambda d: d.split(','))
     p.add_argument('--dhchap-dhgroups', help='Comma-separated list of allowed DH-HMAC-CHAP DH groups',
                    type=lambda d: d.split(','))
+    p.add_argument('--load-sample-period-us', help="""Period of poll group load sampling in microseconds.
+    Non-zero places new qpairs on the least loaded poll group""", type=int)
+    p.add_argument('--rebalance-period-us', help="""Period of the qpair rebalancer in microseconds.
+    0 disables live qpair migration""", type=int)
+    p.add_argument('--rebalance-threshold', help='Load imbalance in percent that triggers a qpair migration', type=int)
     p.set_defaults(func=nvmf_set_config)
 
     def nvmf_create_transport(args):
@@ -2723,6 +2822,10 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('-d', '--num-cqe', help="""The number of CQ entries. Only used when no_srq=true.
     Relevant only for RDMA transport""", type=int)
     p.add_argument('-s', '--max-srq-depth', help='Max number of outstanding I/O per SRQ. Relevant only for RDMA transport', type=int)
+    p.add_argument('--min-srq-depth', help="""Initial and minimal number of receives posted to an SRQ. When set, the
+    SRQ depth adapts to the load up to max_srq_depth. Relevant only for RDMA transport""", type=int)
+    p.add_argument('--srq-mem-budget-mb', help="""Memory limit for the in-capsule data buffers of all adaptive SRQs
+    in MiB, 0 means unlimited. Relevant only for RDMA transport""", type=int)
     p.add_argument('-r', '--no-srq', action='store_true', help='Disable per-thread shared receive queue. Relevant only for RDMA transport')
     p.add_argument('-o', '--c2h-success', action='store_false', help='Disable C2H success optimization. Relevant only for TCP transport')
     p.add_argument('-f', '--dif-insert-or-strip', action='store_true', help='Enable DIF insert/strip. Relevant only for TCP transport')
@@ -2732,12 +2835,16 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('-w', '--no-wr-batching', action='store_true', help='Disable work requests batching. Relevant only for RDMA transport')
     p.add_argument('-e', '--control-msg-num', help="""The number of control messages per poll group.
     Relevant only for TCP transport""", type=int)
+    p.add_argument('--shared-buf-pool', action='store_true', help="""Take request PDUs and in-capsule data buffers
+    from a pool shared by the qpairs of a poll group. Relevant only for TCP transport""")
     p.add_argument('-M', '--disable-mappable-bar0', action='store_true', help="""Disable mmap() of BAR0.
     Relevant only for VFIO-USER transport""")
     p.add_argument('-I', '--disable-adaptive-irq', action='store_true', help="""Disable adaptive interrupt feature.
     Relevant only for VFIO-USER transport""")
     p.add_argument('-S', '--disable-shadow-doorbells', action='store_true', help="""Disable shadow doorbell support.
     Relevant only for VFIO-USER transport""")
+    p.add_argument('--intr-mode-idle-polls', help="""In interrupt mode, number of polls without new commands
+    after which an SQ is switched back from polling to interrupts. Relevant only for VFIO-USER transport""", type=int)
     p.add_argument('--acceptor-poll-rate', help='Polling interval of the acceptor for incoming connections (usec)', type=int)
     p.add_argument('--ack-timeout', help='ACK timeout in milliseconds', type=int)
     p.add_argument('--data-wr-pool-size', help='RDMA data WR pool size. Relevant only for RDMA transport', type=int)
@@ -2918,6 +3025,7 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('-a', '--anagrpid', help='ANA group ID (optional)', type=int)
     p.add_argument('-i', '--no-auto-visible', action='store_true',
                    help='Do not auto make namespace visible to controllers (optional)')
+    p.add_argument('-r', '--read-cache-size-mb', help='Namespace read cache size in MiB (optional)', type=int)
     p.set_defaults(func=nvmf_subsystem_add_ns)
 
     def nvmf_subsystem_set_ns_ana_group(args):
@@ -2934,6 +3042,60 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('-t', '--tgt-name', help='The name of the parent NVMe-oF target (optional)', type=str)
     p.set_defaults(func=nvmf_subsystem_set_ns_ana_group)
 
+    def nvmf_subsystem_set_qos(args):
+        rpc.nvmf.nvmf_subsystem_set_qos(args.client,
+                                        nqn=args.nqn,
+                                        host=args.host,
+                                        nsid=args.nsid,
+                                        rw_ios_per_sec=args.rw_ios_per_sec,
+                                        rw_mbytes_per_sec=args.rw_mbytes_per_sec,
+                                        min_rw_ios_per_sec=args.min_rw_ios_per_sec,
+                                        min_rw_mbytes_per_sec=args.min_rw_mbytes_per_sec,
+                                        tgt_name=args.tgt_name)
+
+    p = subparsers.add_parser('nvmf_subsystem_set_qos',
+                              help="""Set the QoS limits of the I/O of a host to a namespace of an NVMe-oF subsystem.
+    Setting all the limits to 0 removes them.""")
+    p.add_argument('nqn', help='NVMe-oF subsystem NQN')
+    p.add_argument('-H', '--host', help='Host NQN, all hosts if not specified (optional)')
+    p.add_argument('-n', '--nsid', help='Namespace ID, all namespaces if not specified (optional)', type=int)
+    p.add_argument('-i', '--rw-ios-per-sec', help='Maximum read/write IOs per second, 0 means unlimited', type=int)
+    p.add_argument('-m', '--rw-mbytes-per-sec', help='Maximum read/write MiB per second, 0 means unlimited', type=int)
+    p.add_argument('--min-rw-ios-per-sec', help='Read/write IOs per second of the host not held back by limits shared with other hosts', type=int)
+    p.add_argument('--min-rw-mbytes-per-sec', help='Read/write MiB per second of the host not held back by limits shared with other hosts', type=int)
+    p.add_argument('-t', '--tgt-name', help='The name of the parent NVMe-oF target (optional)', type=str)
+    p.set_defaults(func=nvmf_subsystem_set_qos)
+
+    def nvmf_subsystem_set_telemetry(args):
+        rpc.nvmf.nvmf_subsystem_set_telemetry(args.client,
+                                              nqn=args.nqn,
+                                              enable=args.enable,
+                                              tgt_name=args.tgt_name)
+
+    p = subparsers.add_parser('nvmf_subsystem_set_telemetry',
+                              help='Enable the I/O telemetry of an NVMe-oF subsystem, or disable it with -d')
+    p.add_argument('nqn', help='NVMe-oF subsystem NQN')
+    p.add_argument('-d', '--disable', help='Stop collecting the telemetry and drop it', action='store_false', dest='enable')
+    p.add_argument('-t', '--tgt-name', help='The name of the parent NVMe-oF target (optional)', type=str)
+    p.set_defaults(func=nvmf_subsystem_set_telemetry, enable=True)
+
+    def nvmf_subsystem_get_telemetry(args):
+        print_dict(rpc.nvmf.nvmf_subsystem_get_telemetry(args.client,
+                                                         nqn=args.nqn,
+                                                         host=args.host,
+                                                         nsid=args.nsid,
+                                                         delta=args.delta,
+                                                         tgt_name=args.tgt_name))
+
+    p = subparsers.add_parser('nvmf_subsystem_get_telemetry',
+                              help='Get the I/O telemetry of the hosts on the namespaces of an NVMe-oF subsystem')
+    p.add_argument('nqn', help='NVMe-oF subsystem NQN')
+    p.add_argument('-H', '--host', help='Host NQN, all hosts if not specified (optional)')
+    p.add_argument('-n', '--nsid', help='Namespace ID, all namespaces if not specified (optional)', type=int)
+    p.add_argument('-D', '--delta', help='Report the statistics since the previous delta read', action='store_true')
+    p.add_argument('-t', '--tgt-name', help='The name of the parent NVMe-oF target (optional)', type=str)
+    p.set_defaults(func=nvmf_subsystem_get_telemetry)
+
     def nvmf_subsystem_remove_ns(args):
         rpc.nvmf.nvmf_subsystem_remove_ns(args.client,
                                           nqn=args.nqn,
@@ -3746,10 +3908,13 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
 
     def blobfs_set_cache_size(args):
         print(rpc.blobfs.blobfs_set_cache_size(args.client,
-                                               size_in_mb=args.size_in_mb))
+                                               size_in_mb=args.size_in_mb,
+                                               buffer_size_in_kb=args.buffer_size_in_kb))
 
     p = subparsers.add_parser('blobfs_set_cache_size', help='Set cache size for blobfs')
     p.add_argument('size_in_mb', help='Cache size for blobfs in megabytes.', type=int)
+    p.add_argument('-b', '--buffer-size-in-kb', help='Size of a single cache buffer in kilobytes. Power of two '
+                   'between 64 and 16384. Default: 256.', type=int)
     p.set_defaults(func=blobfs_set_cache_size)
 
     # fsdev
@@ -161,11 +161,22 @@ cat << EOL >> writesync_flags.txt
 --num=$NUM_KEYS
 EOL
 
+# Full manual compaction, dominated by long sequential reads of the SST files
+cp $testdir/common_flags.txt compact_flags.txt
+cat << EOL >> compact_flags.txt
+--benchmarks=compact
+--threads=1
+--disable_wal=1
+--use_existing_db=1
+--num=$NUM_KEYS
+EOL
+
 run_test "rocksdb_insert" run_step insert
 run_test "rocksdb_overwrite" run_step overwrite
 run_test "rocksdb_readwrite" run_step readwrite
 run_test "rocksdb_writesync" run_step writesync
 run_test "rocksdb_randread" run_step randread
+run_test "rocksdb_compact" run_step compact
 
 trap - SIGINT SIGTERM EXIT
 
@@ -0,0 +1,79 @@
+#!/usr/bin/env bash
+#  SPDX-License-Identifier: BSD-3-Clause
+#  Copyright (C) 2026 agent
+#  All rights reserved.
+#
+# Measure how fast random writes fill a fresh thin provisioned lvol, i.e. how
+# many clusters per second the blobstore can allocate, and compare the write
+# rate with a thick provisioned lvol of the same size. Run it on two builds to
+# compare the cluster allocation path before and after a change. Either way,
+# check that the cluster accounting of the lvol store stays consistent: the
+# clusters a thin lvol allocates while being written are exactly the ones
+# taken from the free pool, and a thick lvol allocates nothing on write.
+
+testdir=$(readlink -f $(dirname $0))
+rootdir=$(readlink -f $testdir/../../..)
+source $rootdir/test/common/autotest_common.sh
+
+runtime=${RUNTIME:-5}
+cpumask=${CPUMASK:-0xf}
+malloc_size_mb=1024
+malloc_block_size=4096
+cluster_sz=$((64 * 1024))
+lvol_size_mb=1000
+lvol_clusters=$((lvol_size_mb * 1024 * 1024 / cluster_sz))
+
+function free_clusters() {
+	$rpc_py bdev_lvol_get_lvstores -l lvs0 | jq -r '.[0].free_clusters'
+}
+
+function allocated_clusters() {
+	$rpc_py bdev_get_bdevs -b lvs0/lvol0 | jq -r '.[0].driver_specific.lvol.num_allocated_clusters'
+}
+
+function run_fill() {
+	local thin=$1
+	local before after filled allocated
+
+	"$rootdir/build/examples/bdevperf" -z -m $cpumask -C -q 128 -o 4096 -w randwrite \
+		-t $runtime -T lvs0/lvol0 &
+	bdevperf_pid=$!
+	trap 'killprocess $bdevperf_pid; exit 1' SIGINT SIGTERM EXIT
+	waitforlisten $bdevperf_pid
+
+	$rpc_py bdev_malloc_create -b malloc0 $malloc_size_mb $malloc_block_size
+	$rpc_py bdev_lvol_create_lvstore -c $cluster_sz malloc0 lvs0
+	if [[ $thin == thin ]]; then
+		$rpc_py bdev_lvol_create -l lvs0 -t lvol0 $lvol_size_mb
+	else
+		$rpc_py bdev_lvol_create -l lvs0 lvol0 $lvol_size_mb
+	fi
+	waitforbdev lvs0/lvol0
+
+	before=$(free_clusters)
+	$rootdir/examples/bdev/bdevperf/bdevperf.py perform_tests
+	after=$(free_clusters)
+
+	filled=$((before - after))
+	allocated=$(allocated_clusters)
+
+	if [[ $thin == thin ]]; then
+		# Clusters reserved by the bdevperf channels still count as free, so
+		# the pool shrank by exactly the clusters inserted into the lvol
+		((filled > 0))
+		((allocated == filled))
+		((allocated <= lvol_clusters))
+		echo "thin lvol: allocated $filled clusters in ${runtime}s ($((filled / runtime)) clusters/s)"
+	else
+		# All clusters were allocated when the lvol was created
+		((filled == 0))
+		((allocated == lvol_clusters))
+		echo "thick lvol: all $allocated clusters allocated at creation"
+	fi
+
+	killprocess $bdevperf_pid
+	trap - SIGINT SIGTERM EXIT
+}
+
+run_fill thin
+run_fill thick
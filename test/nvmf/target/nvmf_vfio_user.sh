@@ -91,6 +91,20 @@ function run_nvmf_vfio_user() {
 	done
 }
 
+# Light and heavy load in interrupt mode: compare the IRQs, rearms and SQs kept
+# in polling mode reported in the stats
+function perf_intr_mode_vfio_user() {
+	local test_traddr=/var/run/vfio-user/domain/vfio-user1/1
+	local test_subnqn=nqn.2019-07.io.spdk:cnode1
+	local qd
+
+	for qd in 1 32; do
+		$SPDK_BIN_DIR/spdk_nvme_perf -r "trtype:$TEST_TRANSPORT traddr:$test_traddr subnqn:$test_subnqn" -s 256 -g -q $qd -o 4096 -w randread -t 3 -c 0x2
+		$rpc_py nvmf_get_stats | jq '.poll_groups[].transports[] | select(.trtype == "VFIOUSER") |
+			{intr, rearms, adaptive_polls, coalesced_irqs, coalesce_timeouts}'
+	done
+}
+
 function stop_nvmf_vfio_user() {
 	killprocess $nvmfpid
 
@@ -107,3 +121,8 @@ stop_nvmf_vfio_user
 # Start the target in interrupt mode
 setup_nvmf_vfio_user '--interrupt-mode' '-M -I'
 stop_nvmf_vfio_user
+
+# Interrupt mode with the recently active SQs kept in polling mode
+setup_nvmf_vfio_user '--interrupt-mode' '-M -I --intr-mode-idle-polls 64'
+perf_intr_mode_vfio_user
+stop_nvmf_vfio_user
@@ -4729,6 +4729,201 @@ test_retry_io_for_io_path_error(void)
 	g_opts.bdev_retry_count = 0;
 }
 
+static void
+test_immediate_failover(void)
+{
+	struct nvme_path_id path1 = {}, path2 = {};
+	struct spdk_nvme_ctrlr *ctrlr1, *ctrlr2;
+	struct spdk_nvme_ctrlr_opts opts = {.hostnqn = UT_HOSTNQN};
+	struct nvme_bdev_ctrlr *nbdev_ctrlr;
+	struct nvme_ctrlr *nvme_ctrlr1, *nvme_ctrlr2;
+	const int STRING_SIZE = 32;
+	const char *attached_names[STRING_SIZE];
+	struct nvme_bdev *bdev;
+	struct spdk_bdev_io *bdev_io;
+	struct nvme_bdev_io *bio;
+	struct spdk_io_channel *ch;
+	struct nvme_bdev_channel *nbdev_ch;
+	struct nvme_io_path *io_path1, *io_path2;
+	struct nvme_qpair *nvme_qpair1, *nvme_qpair2;
+	struct ut_nvme_req *req;
+	struct spdk_uuid uuid1 = { .u.raw = { 0x1 } };
+	int rc;
+
+	memset(attached_names, 0, sizeof(char *) * STRING_SIZE);
+	ut_init_trid(&path1.trid);
+	ut_init_trid2(&path2.trid);
+
+	g_opts.bdev_retry_count = 1;
+	g_opts.immediate_failover_count = 1;
+	g_opts.path_breaker_threshold = 1;
+	g_opts.path_breaker_backoff_ms = 1000;
+
+	set_thread(0);
+
+	g_ut_attach_ctrlr_status = 0;
+	g_ut_attach_bdev_count = 1;
+
+	ctrlr1 = ut_attach_ctrlr(&path1.trid, 1, true, true);
+	SPDK_CU_ASSERT_FATAL(ctrlr1 != NULL);
+
+	ctrlr1->ns[0].uuid = &uuid1;
+
+	rc = spdk_bdev_nvme_create(&path1.trid, "nvme0", attached_names, STRING_SIZE,
+				   attach_ctrlr_done, NULL, &opts, NULL, true);
+	CU_ASSERT(rc == 0);
+
+	spdk_delay_us(1000);
+	poll_threads();
+
+	spdk_delay_us(g_opts.nvme_adminq_poll_period_us);
+	poll_threads();
+
+	ctrlr2 = ut_attach_ctrlr(&path2.trid, 1, true, true);
+	SPDK_CU_ASSERT_FATAL(ctrlr2 != NULL);
+
+	ctrlr2->ns[0].uuid = &uuid1;
+
+	rc = spdk_bdev_nvme_create(&path2.trid, "nvme0", attached_names, STRING_SIZE,
+				   attach_ctrlr_done, NULL, &opts, NULL, true);
+	CU_ASSERT(rc == 0);
+
+	spdk_delay_us(1000);
+	poll_threads();
+
+	spdk_delay_us(g_opts.nvme_adminq_poll_period_us);
+	poll_threads();
+
+	nbdev_ctrlr = nvme_bdev_ctrlr_get_by_name("nvme0");
+	SPDK_CU_ASSERT_FATAL(nbdev_ctrlr != NULL);
+
+	nvme_ctrlr1 = nvme_bdev_ctrlr_get_ctrlr(nbdev_ctrlr, &path1.trid, opts.hostnqn);
+	CU_ASSERT(nvme_ctrlr1 != NULL);
+
+	nvme_ctrlr2 = nvme_bdev_ctrlr_get_ctrlr(nbdev_ctrlr, &path2.trid, opts.hostnqn);
+	CU_ASSERT(nvme_ctrlr2 != NULL);
+
+	bdev = nvme_bdev_ctrlr_get_bdev(nbdev_ctrlr, 1);
+	CU_ASSERT(bdev != NULL);
+
+	bdev_io = ut_alloc_bdev_io(SPDK_BDEV_IO_TYPE_WRITE, bdev, NULL);
+	ut_bdev_io_set_buf(bdev_io);
+
+	bio = (struct nvme_bdev_io *)bdev_io->driver_ctx;
+
+	ch = spdk_get_io_channel(bdev);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+
+	nbdev_ch = spdk_io_channel_get_ctx(ch);
+
+	io_path1 = ut_get_io_path_by_ctrlr(nbdev_ch, nvme_ctrlr1);
+	SPDK_CU_ASSERT_FATAL(io_path1 != NULL);
+	io_path2 = ut_get_io_path_by_ctrlr(nbdev_ch, nvme_ctrlr2);
+	SPDK_CU_ASSERT_FATAL(io_path2 != NULL);
+
+	nvme_qpair1 = io_path1->qpair;
+	nvme_qpair2 = io_path2->qpair;
+
+	bdev_io->internal.ch = (struct spdk_bdev_channel *)ch;
+
+	/* I/O got a path error on io_path1. io_path1 is tripped and the I/O is
+	 * resubmitted to io_path2 in the completion context.
+	 */
+	bdev_io->internal.f.in_submit_request = true;
+
+	bdev_nvme_submit_request(ch, bdev_io);
+
+	CU_ASSERT(nvme_qpair1->qpair->num_outstanding_reqs == 1);
+	CU_ASSERT(nvme_qpair2->qpair->num_outstanding_reqs == 0);
+
+	req = ut_get_outstanding_nvme_request(nvme_qpair1->qpair, bio);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+
+	req->cpl.status.sc = SPDK_NVME_SC_INTERNAL_PATH_ERROR;
+	req->cpl.status.sct = SPDK_NVME_SCT_PATH;
+
+	/* qpair2 is polled after qpair1 in the same poll group. Hence the resubmitted
+	 * I/O completes in the same iteration without going through the retry queue.
+	 */
+	poll_thread_times(0, 1);
+
+	CU_ASSERT(nvme_qpair1->qpair->num_outstanding_reqs == 0);
+	CU_ASSERT(nvme_qpair2->qpair->num_outstanding_reqs == 0);
+	CU_ASSERT(TAILQ_EMPTY(&nbdev_ch->retry_io_list));
+	CU_ASSERT(bio->io_path == io_path2);
+	CU_ASSERT(io_path1->num_immediate_retries == 1);
+	CU_ASSERT(io_path1->num_delayed_retries == 0);
+	CU_ASSERT(io_path1->num_breaker_trips == 1);
+	CU_ASSERT(bdev_io->internal.f.in_submit_request == false);
+	CU_ASSERT(bdev_io->internal.status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(bio->failover_count == 0);
+
+	/* New I/Os avoid io_path1 while its breaker is open. */
+	bdev_io->internal.f.in_submit_request = true;
+
+	bdev_nvme_submit_request(ch, bdev_io);
+
+	CU_ASSERT(nvme_qpair1->qpair->num_outstanding_reqs == 0);
+	CU_ASSERT(nvme_qpair2->qpair->num_outstanding_reqs == 1);
+
+	/* I/O got a path error on io_path2 too. Both paths are tripped, but I/O is
+	 * still resubmitted to io_path1 immediately rather than failed.
+	 */
+	req = ut_get_outstanding_nvme_request(nvme_qpair2->qpair, bio);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+
+	req->cpl.status.sc = SPDK_NVME_SC_INTERNAL_PATH_ERROR;
+	req->cpl.status.sct = SPDK_NVME_SCT_PATH;
+
+	poll_thread_times(0, 1);
+
+	CU_ASSERT(nvme_qpair1->qpair->num_outstanding_reqs == 1);
+	CU_ASSERT(nvme_qpair2->qpair->num_outstanding_reqs == 0);
+	CU_ASSERT(io_path2->num_immediate_retries == 1);
+	CU_ASSERT(io_path2->num_breaker_trips == 1);
+
+	/* The immediate failover budget of the I/O is used up. The I/O is queued
+	 * to the retry queue instead.
+	 */
+	req = ut_get_outstanding_nvme_request(nvme_qpair1->qpair, bio);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+
+	req->cpl.status.sc = SPDK_NVME_SC_INTERNAL_PATH_ERROR;
+	req->cpl.status.sct = SPDK_NVME_SCT_PATH;
+
+	poll_thread_times(0, 1);
+
+	CU_ASSERT(nvme_qpair1->qpair->num_outstanding_reqs == 0);
+	CU_ASSERT(nvme_qpair2->qpair->num_outstanding_reqs == 0);
+	CU_ASSERT(bdev_io == spdk_bdev_io_from_ctx(TAILQ_FIRST(&nbdev_ch->retry_io_list)));
+	CU_ASSERT(io_path1->num_immediate_retries == 1);
+	CU_ASSERT(io_path1->num_delayed_retries == 1);
+
+	poll_threads();
+
+	CU_ASSERT(bdev_io->internal.f.in_submit_request == false);
+	CU_ASSERT(bdev_io->internal.status == SPDK_BDEV_IO_STATUS_SUCCESS);
+
+	free(bdev_io);
+
+	spdk_put_io_channel(ch);
+
+	poll_threads();
+
+	rc = bdev_nvme_delete("nvme0", &g_any_path, NULL, NULL);
+	CU_ASSERT(rc == 0);
+
+	poll_threads();
+	spdk_delay_us(1000);
+	poll_threads();
+
+	CU_ASSERT(nvme_bdev_ctrlr_get_by_name("nvme0") == NULL);
+
+	g_opts.bdev_retry_count = 0;
+	g_opts.immediate_failover_count = 0;
+	g_opts.path_breaker_threshold = 0;
+}
+
 static void
 test_retry_io_count(void)
 {
@@ -6194,6 +6389,138 @@ test_find_io_path_min_qd(void)
 	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path1);
 }
 
+static void
+test_find_io_path_service_time(void)
+{
+	struct nvme_bdev_channel nbdev_ch = {
+		.io_path_list = STAILQ_HEAD_INITIALIZER(nbdev_ch.io_path_list),
+		.mp_policy = BDEV_NVME_MP_POLICY_ACTIVE_ACTIVE,
+		.mp_selector = BDEV_NVME_MP_SELECTOR_SERVICE_TIME,
+	};
+	struct spdk_nvme_qpair qpair1 = {}, qpair2 = {}, qpair3 = {};
+	struct spdk_nvme_ctrlr ctrlr1 = {}, ctrlr2 = {}, ctrlr3 = {};
+	struct spdk_nvme_ns ns1 = {}, ns2 = {}, ns3 = {};
+	struct nvme_ctrlr nvme_ctrlr1 = { .ctrlr = &ctrlr1, };
+	struct nvme_ctrlr nvme_ctrlr2 = { .ctrlr = &ctrlr2, };
+	struct nvme_ctrlr nvme_ctrlr3 = { .ctrlr = &ctrlr3, };
+	struct nvme_ctrlr_channel ctrlr_ch1 = {};
+	struct nvme_ctrlr_channel ctrlr_ch2 = {};
+	struct nvme_ctrlr_channel ctrlr_ch3 = {};
+	struct nvme_qpair nvme_qpair1 = { .ctrlr_ch = &ctrlr_ch1, .ctrlr = &nvme_ctrlr1, .qpair = &qpair1, };
+	struct nvme_qpair nvme_qpair2 = { .ctrlr_ch = &ctrlr_ch2, .ctrlr = &nvme_ctrlr2, .qpair = &qpair2, };
+	struct nvme_qpair nvme_qpair3 = { .ctrlr_ch = &ctrlr_ch3, .ctrlr = &nvme_ctrlr3, .qpair = &qpair3, };
+	struct nvme_ns nvme_ns1 = { .ns = &ns1, }, nvme_ns2 = { .ns = &ns2, }, nvme_ns3 = { .ns = &ns3, };
+	struct nvme_io_path io_path1 = { .qpair = &nvme_qpair1, .nvme_ns = &nvme_ns1, };
+	struct nvme_io_path io_path2 = { .qpair = &nvme_qpair2, .nvme_ns = &nvme_ns2, };
+	struct nvme_io_path io_path3 = { .qpair = &nvme_qpair3, .nvme_ns = &nvme_ns3, };
+
+	STAILQ_INSERT_TAIL(&nbdev_ch.io_path_list, &io_path1, stailq);
+	STAILQ_INSERT_TAIL(&nbdev_ch.io_path_list, &io_path2, stailq);
+	STAILQ_INSERT_TAIL(&nbdev_ch.io_path_list, &io_path3, stailq);
+
+	nvme_ns1.ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	nvme_ns2.ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	nvme_ns3.ana_state = SPDK_NVME_ANA_NON_OPTIMIZED_STATE;
+
+	/* A path without any latency sample is probed first. */
+	io_path1.ewma_latency_ticks = 10;
+	io_path2.ewma_latency_ticks = 0;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path2);
+
+	/* But only with one I/O at a time, until it completes. */
+	io_path2.outstanding_bytes = 4096;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path1);
+	io_path1.ewma_latency_ticks = 0;
+	io_path1.outstanding_bytes = 4096;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) != NULL);
+	io_path1.outstanding_bytes = 0;
+
+	/* The path with the lowest expected service time is selected even if it
+	 * has more outstanding bytes.
+	 */
+	io_path1.ewma_latency_ticks = 100;
+	io_path1.outstanding_bytes = 4096;
+	io_path2.ewma_latency_ticks = 10;
+	io_path2.outstanding_bytes = 8192;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path2);
+
+	io_path2.outstanding_bytes = 65536;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path1);
+
+	/* Optimized paths are preferred over faster non-optimized paths. */
+	io_path3.ewma_latency_ticks = 1;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path1);
+
+	nvme_ns1.ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+	nvme_ns2.ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path3);
+}
+
+static void
+test_find_io_path_weighted_round_robin(void)
+{
+	struct nvme_bdev_channel nbdev_ch = {
+		.io_path_list = STAILQ_HEAD_INITIALIZER(nbdev_ch.io_path_list),
+		.mp_policy = BDEV_NVME_MP_POLICY_ACTIVE_ACTIVE,
+		.mp_selector = BDEV_NVME_MP_SELECTOR_WEIGHTED_ROUND_ROBIN,
+	};
+	struct spdk_nvme_qpair qpair1 = {}, qpair2 = {}, qpair3 = {};
+	struct spdk_nvme_ctrlr ctrlr1 = {}, ctrlr2 = {}, ctrlr3 = {};
+	struct spdk_nvme_ns ns1 = {}, ns2 = {}, ns3 = {};
+	struct nvme_ctrlr nvme_ctrlr1 = { .ctrlr = &ctrlr1, };
+	struct nvme_ctrlr nvme_ctrlr2 = { .ctrlr = &ctrlr2, };
+	struct nvme_ctrlr nvme_ctrlr3 = { .ctrlr = &ctrlr3, };
+	struct nvme_ctrlr_channel ctrlr_ch1 = {};
+	struct nvme_ctrlr_channel ctrlr_ch2 = {};
+	struct nvme_ctrlr_channel ctrlr_ch3 = {};
+	struct nvme_qpair nvme_qpair1 = { .ctrlr_ch = &ctrlr_ch1, .ctrlr = &nvme_ctrlr1, .qpair = &qpair1, };
+	struct nvme_qpair nvme_qpair2 = { .ctrlr_ch = &ctrlr_ch2, .ctrlr = &nvme_ctrlr2, .qpair = &qpair2, };
+	struct nvme_qpair nvme_qpair3 = { .ctrlr_ch = &ctrlr_ch3, .ctrlr = &nvme_ctrlr3, .qpair = &qpair3, };
+	struct nvme_ns nvme_ns1 = { .ns = &ns1, .path_weight = 3, };
+	struct nvme_ns nvme_ns2 = { .ns = &ns2, .path_weight = 1, };
+	struct nvme_ns nvme_ns3 = { .ns = &ns3, .path_weight = 1, };
+	struct nvme_io_path io_path1 = { .qpair = &nvme_qpair1, .nvme_ns = &nvme_ns1, };
+	struct nvme_io_path io_path2 = { .qpair = &nvme_qpair2, .nvme_ns = &nvme_ns2, };
+	struct nvme_io_path io_path3 = { .qpair = &nvme_qpair3, .nvme_ns = &nvme_ns3, };
+	struct nvme_io_path *io_path;
+	int count1 = 0, count2 = 0, i;
+
+	STAILQ_INSERT_TAIL(&nbdev_ch.io_path_list, &io_path1, stailq);
+	STAILQ_INSERT_TAIL(&nbdev_ch.io_path_list, &io_path2, stailq);
+	STAILQ_INSERT_TAIL(&nbdev_ch.io_path_list, &io_path3, stailq);
+
+	nvme_ns1.ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	nvme_ns2.ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	nvme_ns3.ana_state = SPDK_NVME_ANA_NON_OPTIMIZED_STATE;
+
+	/* I/Os are distributed among the optimized paths in proportion to their
+	 * weights, and the heavier path does not get consecutive bursts.
+	 */
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path1);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path1);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path2);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path1);
+
+	for (i = 0; i < 400; i++) {
+		io_path = bdev_nvme_find_io_path(&nbdev_ch);
+		if (io_path == &io_path1) {
+			count1++;
+		} else if (io_path == &io_path2) {
+			count2++;
+		} else {
+			CU_ASSERT(false);
+		}
+	}
+	CU_ASSERT(count1 == 300);
+	CU_ASSERT(count2 == 100);
+
+	/* Non-optimized paths are used only if no optimized path is available. */
+	nvme_ns1.ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+	nvme_ns2.ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path3);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev_ch) == &io_path3);
+}
+
 static void
 test_disable_auto_failback(void)
 {
@@ -7758,6 +8085,7 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_find_io_path);
 	CU_ADD_TEST(suite, test_retry_io_if_ana_state_is_updating);
 	CU_ADD_TEST(suite, test_retry_io_for_io_path_error);
+	CU_ADD_TEST(suite, test_immediate_failover);
 	CU_ADD_TEST(suite, test_retry_io_count);
 	CU_ADD_TEST(suite, test_concurrent_read_ana_log_page);
 	CU_ADD_TEST(suite, test_retry_io_for_ana_error);
@@ -7771,6 +8099,8 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_set_preferred_path);
 	CU_ADD_TEST(suite, test_find_next_io_path);
 	CU_ADD_TEST(suite, test_find_io_path_min_qd);
+	CU_ADD_TEST(suite, test_find_io_path_service_time);
+	CU_ADD_TEST(suite, test_find_io_path_weighted_round_robin);
 	CU_ADD_TEST(suite, test_disable_auto_failback);
 	CU_ADD_TEST(suite, test_set_multipath_policy);
 	CU_ADD_TEST(suite, test_uuid_generation);
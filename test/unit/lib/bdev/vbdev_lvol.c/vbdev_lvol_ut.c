@@ -933,6 +933,23 @@ spdk_lvol_shallow_copy(struct spdk_lvol *lvol, struct spdk_bs_dev *ext_dev,
 	return 0;
 }
 
+int
+spdk_lvol_diff_copy(struct spdk_lvol *lvol, struct spdk_lvol *base, struct spdk_bs_dev *ext_dev,
+		    uint32_t queue_depth, spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
+		    spdk_lvol_op_complete cb_fn, void *cb_arg)
+{
+	if (lvol == NULL) {
+		return -ENODEV;
+	}
+
+	if (ext_dev == NULL) {
+		return -ENODEV;
+	}
+
+	cb_fn(cb_arg, 0);
+	return 0;
+}
+
 void
 spdk_lvol_set_external_parent(struct spdk_lvol *lvol, const void *esnap_id, uint32_t id_len,
 			      spdk_lvol_op_complete cb_fn, void *cb_arg)
@@ -2257,6 +2274,19 @@ ut_lvol_shallow_copy(void)
 	CU_ASSERT(rc == 0);
 	CU_ASSERT(g_lvolerrno == 0);
 
+	/* Diff copy error with NULL bdev name */
+	rc = vbdev_lvol_diff_copy(g_lvol, NULL, 0, NULL, NULL, NULL, vbdev_lvol_shallow_copy_complete,
+				  NULL);
+	CU_ASSERT(rc == -EINVAL);
+
+	/* Successful diff copy */
+	g_lvolerrno = -1;
+	lvol_already_opened = false;
+	rc = vbdev_lvol_diff_copy(g_lvol, NULL, 0, DEFAULT_BDEV_NAME, NULL, NULL,
+				  vbdev_lvol_shallow_copy_complete, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvolerrno == 0);
+
 	/* Successful lvol destroy */
 	vbdev_lvol_destroy(g_lvol, lvol_store_op_complete, NULL);
 	CU_ASSERT(g_lvol == NULL);
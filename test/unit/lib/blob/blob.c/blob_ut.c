@@ -1669,6 +1669,8 @@ blob_rw_verify_iov_nomem(void)
 {
 	struct spdk_blob_store *bs = g_bs;
 	struct spdk_blob *blob = g_blob;
+	struct spdk_blob *blob2;
+	struct spdk_blob_opts opts;
 	struct spdk_io_channel *channel;
 	uint8_t payload_write[10 * 4096];
 	struct iovec iov_write[3];
@@ -1677,9 +1679,23 @@ blob_rw_verify_iov_nomem(void)
 	channel = spdk_bs_alloc_io_channel(bs);
 	CU_ASSERT(channel != NULL);
 
+	/*
+	 * I/O is split only where the clusters are not adjacent on the device, so allocate
+	 *  a cluster to another blob in between the two clusters of this one.
+	 */
+	spdk_blob_resize(blob, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.num_clusters = 1;
+	blob2 = ut_blob_create_and_open(bs, &opts);
+	g_blob = blob;
+
 	spdk_blob_resize(blob, 2, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(blob->active.clusters[1] != blob->active.clusters[0] + bs_cluster_to_lba(bs, 1));
 
 	/*
 	 * Choose a page offset just before the cluster boundary.  The first 6 pages of payload
@@ -1699,6 +1715,9 @@ blob_rw_verify_iov_nomem(void)
 	CU_ASSERT(req_count == bs_channel_get_req_count(channel));
 	MOCK_CLEAR(calloc);
 
+	ut_blob_close_and_delete(bs, blob2);
+	g_blob = blob;
+
 	spdk_bs_free_io_channel(channel);
 	poll_threads();
 }
@@ -2091,650 +2110,964 @@ blob_operation_split_rw_iov(void)
 }
 
 static void
-blob_unmap(void)
+blob_operation_contiguous_clusters(void)
 {
 	struct spdk_blob_store *bs = g_bs;
 	struct spdk_blob *blob;
 	struct spdk_io_channel *channel;
 	struct spdk_blob_opts opts;
-	uint8_t payload[4096];
-	int i;
+	struct iovec iov[3];
+	uint64_t cluster_size;
+	uint64_t io_units_per_cluster;
+	uint8_t *payload_read;
+	uint8_t *payload_write;
+
+	cluster_size = spdk_bs_get_cluster_size(bs);
+	io_units_per_cluster = cluster_size / spdk_bs_get_io_unit_size(bs);
+
+	payload_read = malloc(cluster_size * 3);
+	SPDK_CU_ASSERT_FATAL(payload_read != NULL);
+	payload_write = malloc(cluster_size * 3);
+	SPDK_CU_ASSERT_FATAL(payload_write != NULL);
+	memset(payload_write, 0xE5, cluster_size * 3);
+	payload_write[0] = 1;
+	payload_write[cluster_size * 3 - 1] = 2;
 
 	channel = spdk_bs_alloc_io_channel(bs);
-	CU_ASSERT(channel != NULL);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
 
+	/* Thick provisioned blob, its clusters are adjacent on the device */
 	ut_spdk_blob_opts_init(&opts);
-	opts.num_clusters = 10;
-
+	opts.num_clusters = 3;
 	blob = ut_blob_create_and_open(bs, &opts);
+	CU_ASSERT(blob->active.clusters[1] == blob->active.clusters[0] + bs_cluster_to_lba(bs, 1));
+	CU_ASSERT(blob->active.clusters[2] == blob->active.clusters[1] + bs_cluster_to_lba(bs, 1));
 
-	spdk_blob_resize(blob, 10, blob_op_complete, NULL);
+	/* I/O across all of the clusters is not split */
+	g_dev_write_ops = 0;
+	spdk_blob_io_write(blob, channel, payload_write, 0, io_units_per_cluster * 3,
+			   blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 10);
+	CU_ASSERT(g_dev_write_ops == 1);
 
-	memset(payload, 0, sizeof(payload));
-	payload[0] = 0xFF;
+	g_dev_read_ops = 0;
+	memset(payload_read, 0, cluster_size * 3);
+	spdk_blob_io_read(blob, channel, payload_read, 0, io_units_per_cluster * 3,
+			  blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_dev_read_ops == 1);
+	CU_ASSERT(memcmp(payload_read, payload_write, cluster_size * 3) == 0);
 
-	/*
-	 * Set first byte of every cluster to 0xFF.
-	 * First cluster on device is reserved so let's start from cluster number 1
-	 */
-	for (i = 1; i < 11; i++) {
-		g_dev_buffer[i * SPDK_BLOB_OPTS_CLUSTER_SZ] = 0xFF;
-	}
+	g_dev_read_ops = 0;
+	memset(payload_read, 0, cluster_size * 3);
+	iov[0].iov_base = payload_read;
+	iov[0].iov_len = cluster_size / 2;
+	iov[1].iov_base = payload_read + cluster_size / 2;
+	iov[1].iov_len = cluster_size;
+	iov[2].iov_base = payload_read + cluster_size * 3 / 2;
+	iov[2].iov_len = cluster_size * 3 / 2 - 8192;
+	spdk_blob_io_readv(blob, channel, iov, 3, 1, io_units_per_cluster * 3 - 2,
+			   blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_dev_read_ops == 1);
+	CU_ASSERT(memcmp(payload_read, payload_write + 4096, cluster_size * 3 - 8192) == 0);
 
-	/* Confirm writes */
-	for (i = 0; i < 10; i++) {
-		payload[0] = 0;
-		spdk_blob_io_read(blob, channel, &payload, i * SPDK_BLOB_OPTS_CLUSTER_SZ / 4096, 1,
-				  blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-		CU_ASSERT(payload[0] == 0xFF);
-	}
+	ut_blob_close_and_delete(bs, blob);
 
-	/* Mark some clusters as unallocated */
-	blob->active.clusters[1] = 0;
-	blob->active.clusters[2] = 0;
-	blob->active.clusters[3] = 0;
-	blob->active.clusters[6] = 0;
-	blob->active.clusters[8] = 0;
-	blob->active.num_allocated_clusters -= 5;
+	/* Thin provisioned blob with clusters allocated out of order */
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 3;
+	blob = ut_blob_create_and_open(bs, &opts);
 
-	/* Unmap clusters by resizing to 0 */
-	spdk_blob_resize(blob, 0, blob_op_complete, NULL);
+	spdk_blob_io_write(blob, channel, payload_write + cluster_size, io_units_per_cluster,
+			   io_units_per_cluster, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-
-	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	spdk_blob_io_write(blob, channel, payload_write, 0, io_units_per_cluster,
+			   blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+	CU_ASSERT(blob->active.clusters[1] != blob->active.clusters[0] + bs_cluster_to_lba(bs, 1));
 
-	/* Confirm that only 'allocated' clusters were unmapped */
-	for (i = 1; i < 11; i++) {
-		switch (i) {
-		case 2:
-		case 3:
-		case 4:
-		case 7:
-		case 9:
-			CU_ASSERT(g_dev_buffer[i * SPDK_BLOB_OPTS_CLUSTER_SZ] == 0xFF);
-			break;
-		default:
-			CU_ASSERT(g_dev_buffer[i * SPDK_BLOB_OPTS_CLUSTER_SZ] == 0);
-			break;
-		}
-	}
+	/* I/O is split where clusters are not adjacent and at unallocated clusters */
+	g_dev_read_ops = 0;
+	memset(payload_read, 0xFF, cluster_size * 3);
+	spdk_blob_io_read(blob, channel, payload_read, 0, io_units_per_cluster * 3,
+			  blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_dev_read_ops == 2);
+	CU_ASSERT(memcmp(payload_read, payload_write, cluster_size * 2) == 0);
+	CU_ASSERT(spdk_mem_all_zero(payload_read + cluster_size * 2, cluster_size));
 
 	spdk_bs_free_io_channel(channel);
 	poll_threads();
 
+	free(payload_read);
+	free(payload_write);
+
 	ut_blob_close_and_delete(bs, blob);
 }
 
 static void
-blob_iter(void)
+ut_blob_move_cluster_verify(struct spdk_blob *blob, struct spdk_io_channel *channel,
+			    uint8_t *payload_read, uint8_t *payload_expected, uint64_t num_clusters)
 {
-	struct spdk_blob_store *bs = g_bs;
-	struct spdk_blob *blob;
-	spdk_blob_id blobid;
-	struct spdk_blob_opts blob_opts;
-
-	spdk_bs_iter_first(bs, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_blob == NULL);
-	CU_ASSERT(g_bserrno == -ENOENT);
+	uint64_t io_units_per_cluster = spdk_bs_get_cluster_size(blob->bs) /
+					spdk_bs_get_io_unit_size(blob->bs);
 
-	ut_spdk_blob_opts_init(&blob_opts);
-	spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
-	blobid = g_blobid;
-
-	spdk_bs_iter_first(bs, blob_op_with_handle_complete, NULL);
+	memset(payload_read, 0, spdk_bs_get_cluster_size(blob->bs) * num_clusters);
+	spdk_blob_io_read(blob, channel, payload_read, 0, io_units_per_cluster * num_clusters,
+			  blob_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_blob != NULL);
 	CU_ASSERT(g_bserrno == 0);
-	blob = g_blob;
-	CU_ASSERT(spdk_blob_get_id(blob) == blobid);
-
-	spdk_bs_iter_next(bs, blob, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_blob == NULL);
-	CU_ASSERT(g_bserrno == -ENOENT);
+	CU_ASSERT(memcmp(payload_read, payload_expected,
+			 spdk_bs_get_cluster_size(blob->bs) * num_clusters) == 0);
 }
 
 static void
-blob_xattr(void)
+blob_move_cluster(void)
 {
 	struct spdk_blob_store *bs = g_bs;
-	struct spdk_blob *blob = g_blob;
-	spdk_blob_id blobid = spdk_blob_get_id(blob);
-	uint64_t length;
-	int rc;
-	const char *name1, *name2;
-	const void *value;
-	size_t value_len;
-	struct spdk_xattr_names *names;
+	struct spdk_blob *blob, *snapshot;
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts opts;
+	spdk_blob_id blobid, snapshotid;
+	uint64_t cluster_size, io_units_per_cluster, free_clusters, dst, i;
+	uint64_t order[] = { 3, 1, 0, 2 };
+	uint8_t *payload_read, *payload_write;
 
-	rc = spdk_blob_set_xattr(blob, "name", "log.txt", strlen("log.txt") + 1);
-	CU_ASSERT(rc == 0);
+	cluster_size = spdk_bs_get_cluster_size(bs);
+	io_units_per_cluster = cluster_size / spdk_bs_get_io_unit_size(bs);
 
-	length = 2345;
-	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
-	CU_ASSERT(rc == 0);
+	payload_read = malloc(cluster_size * 5);
+	SPDK_CU_ASSERT_FATAL(payload_read != NULL);
+	payload_write = calloc(5, cluster_size);
+	SPDK_CU_ASSERT_FATAL(payload_write != NULL);
+	for (i = 0; i < 4; i++) {
+		memset(payload_write + i * cluster_size, i + 1, cluster_size);
+	}
 
-	/* Overwrite "length" xattr. */
-	length = 3456;
-	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
-	CU_ASSERT(rc == 0);
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
 
-	/* get_xattr should still work even if md_ro flag is set. */
-	value = NULL;
-	blob->md_ro = true;
-	rc = spdk_blob_get_xattr_value(blob, "length", &value, &value_len);
-	CU_ASSERT(rc == 0);
-	SPDK_CU_ASSERT_FATAL(value != NULL);
-	CU_ASSERT(*(uint64_t *)value == length);
-	CU_ASSERT(value_len == 8);
-	blob->md_ro = false;
+	/* Thin provisioned blob with its first 4 clusters allocated out of order */
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 5;
+	blob = ut_blob_create_and_open(bs, &opts);
+	blobid = spdk_blob_get_id(blob);
 
-	rc = spdk_blob_get_xattr_value(blob, "foobar", &value, &value_len);
-	CU_ASSERT(rc == -ENOENT);
+	for (i = 0; i < SPDK_COUNTOF(order); i++) {
+		spdk_blob_io_write(blob, channel, payload_write + order[i] * cluster_size,
+				   order[i] * io_units_per_cluster, io_units_per_cluster, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+	}
+	CU_ASSERT(spdk_blob_get_num_fragments(blob) > 1);
+	CU_ASSERT(spdk_blob_get_cluster_location(blob, 4) == UINT64_MAX);
+	free_clusters = spdk_bs_free_cluster_count(bs);
 
-	names = NULL;
-	rc = spdk_blob_get_xattr_names(blob, &names);
-	CU_ASSERT(rc == 0);
-	SPDK_CU_ASSERT_FATAL(names != NULL);
-	CU_ASSERT(spdk_xattr_names_get_count(names) == 2);
-	name1 = spdk_xattr_names_get_name(names, 0);
-	SPDK_CU_ASSERT_FATAL(name1 != NULL);
-	CU_ASSERT(!strcmp(name1, "name") || !strcmp(name1, "length"));
-	name2 = spdk_xattr_names_get_name(names, 1);
-	SPDK_CU_ASSERT_FATAL(name2 != NULL);
-	CU_ASSERT(!strcmp(name2, "name") || !strcmp(name2, "length"));
-	CU_ASSERT(strcmp(name1, name2));
-	spdk_xattr_names_free(names);
+	/* Unallocated clusters can't be moved, neither can clusters be moved onto used ones */
+	dst = spdk_bs_find_free_clusters(bs, 0, 4);
+	SPDK_CU_ASSERT_FATAL(dst != UINT64_MAX);
+	spdk_bs_blob_move_cluster(bs, blobid, 4, dst, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
+	spdk_bs_blob_move_cluster(bs, blobid, 0, spdk_blob_get_cluster_location(blob, 1),
+				  blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EBUSY);
+	spdk_bs_blob_move_cluster(bs, blobid, 0, bs->total_clusters, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
 
-	blob->md_ro = false;
-	rc = spdk_blob_remove_xattr(blob, "name");
-	CU_ASSERT(rc == 0);
+	/* Move the clusters into the free range in order, writing to the blob while the first one moves */
+	memset(payload_write, 0xAA, cluster_size / 2);
+	for (i = 0; i < 4; i++) {
+		g_bserrno = -1;
+		spdk_bs_blob_move_cluster(bs, blobid, i, dst + i, blob_op_complete, NULL);
+		if (i == 0) {
+			spdk_blob_io_write(blob, channel, payload_write, 0, io_units_per_cluster / 2,
+					   blob_op_complete, NULL);
+		}
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(spdk_blob_get_cluster_location(blob, i) == dst + i);
+	}
+	CU_ASSERT(spdk_blob_get_num_fragments(blob) == 1);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
+	ut_blob_move_cluster_verify(blob, channel, payload_read, payload_write, 5);
 
-	rc = spdk_blob_remove_xattr(blob, "foobar");
-	CU_ASSERT(rc == -ENOENT);
+	/* The blob is a clone of the snapshot, which holds the clusters now */
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	snapshotid = g_blobid;
 
-	/* Set internal xattr */
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
+	CU_ASSERT(spdk_blob_get_cluster_location(snapshot, 2) == dst + 2);
 
-	/* test that set_xattr fails for internal xattr if md_ro flag is set. */
-	blob->md_ro = true;
-	rc = blob_set_xattr(blob, "internal", &length, sizeof(length), true);
-	CU_ASSERT(rc == -EPERM);
+	/* Move a cluster of the snapshot away, the clone reads it from the new location */
+	dst = spdk_bs_find_free_clusters(bs, dst + 8, 1);
+	SPDK_CU_ASSERT_FATAL(dst != UINT64_MAX);
+	spdk_bs_blob_move_cluster(bs, snapshotid, 2, dst, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_cluster_location(snapshot, 2) == dst);
+	CU_ASSERT(spdk_blob_get_num_fragments(snapshot) == 3);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
+	ut_blob_move_cluster_verify(blob, channel, payload_read, payload_write, 5);
 
-	blob->md_ro = false;
-	length = 7898;
-	rc = blob_set_xattr(blob, "internal", &length, sizeof(length), true);
-	CU_ASSERT(rc == 0);
-	rc = blob_get_xattr_value(blob, "internal", &value, &value_len, true);
-	CU_ASSERT(rc == 0);
-	CU_ASSERT(*(uint64_t *)value == length);
-	/* try to get public xattr with same name */
-	rc = spdk_blob_get_xattr_value(blob, "internal", &value, &value_len);
-	CU_ASSERT(rc != 0);
-	rc = blob_get_xattr_value(blob, "internal", &value, &value_len, false);
-	CU_ASSERT(rc != 0);
-	/* Check if SPDK_BLOB_INTERNAL_XATTR is set */
-	CU_ASSERT((blob->invalid_flags & SPDK_BLOB_INTERNAL_XATTR) ==
-		  SPDK_BLOB_INTERNAL_XATTR);
+	/* Copy-on-write of the moved cluster into the clone */
+	memset(payload_write + cluster_size * 2, 0x55, 4096);
+	spdk_blob_io_write(blob, channel, payload_write + cluster_size * 2, io_units_per_cluster * 2,
+			   4096 / spdk_bs_get_io_unit_size(bs), blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_cluster_location(blob, 2) != UINT64_MAX);
+	ut_blob_move_cluster_verify(blob, channel, payload_read, payload_write, 5);
 
+	spdk_blob_close(snapshot, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
 	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
 
-	/* Check if xattrs are persisted */
+	/* The moved clusters are persisted */
 	ut_bs_reload(&bs, NULL);
 
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
+	CU_ASSERT(spdk_blob_get_cluster_location(snapshot, 2) == dst);
+
 	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
 	blob = g_blob;
+	ut_blob_move_cluster_verify(blob, channel, payload_read, payload_write, 5);
 
-	rc = blob_get_xattr_value(blob, "internal", &value, &value_len, true);
-	CU_ASSERT(rc == 0);
-	CU_ASSERT(*(uint64_t *)value == length);
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
 
-	/* try to get internal xattr through public call */
-	rc = spdk_blob_get_xattr_value(blob, "internal", &value, &value_len);
-	CU_ASSERT(rc != 0);
-
-	/* Confirm that remove_xattr fails for internal xattr if md_ro is set to true. */
-	blob->md_ro = true;
-	rc = blob_remove_xattr(blob, "internal", true);
-	CU_ASSERT(rc == -EPERM);
-
-	blob->md_ro = false;
-	rc = blob_remove_xattr(blob, "internal", true);
-	CU_ASSERT(rc == 0);
+	ut_blob_close_and_delete(bs, blob);
+	ut_blob_close_and_delete(bs, snapshot);
 
-	CU_ASSERT((blob->invalid_flags & SPDK_BLOB_INTERNAL_XATTR) == 0);
+	free(payload_read);
+	free(payload_write);
 }
 
 static void
-blob_parse_md(void)
+blob_move_cluster_drain(void)
 {
 	struct spdk_blob_store *bs = g_bs;
 	struct spdk_blob *blob;
-	int rc;
-	uint32_t used_pages;
-	size_t xattr_length;
-	char *xattr;
+	struct spdk_io_channel *channel;
+	struct spdk_bs_channel *bs_ch;
+	struct spdk_blob_opts opts;
+	spdk_blob_id blobid;
+	uint64_t free_clusters, src, dst;
 
-	used_pages = spdk_bit_array_count_set(bs->used_md_pages);
-	blob = ut_blob_create_and_open(bs, NULL);
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+	bs_ch = spdk_io_channel_get_ctx(channel);
 
-	/* Create large extent to force more than 1 page of metadata. */
-	xattr_length = SPDK_BS_MAX_DESC_SIZE - sizeof(struct spdk_blob_md_descriptor_xattr) -
-		       strlen("large_xattr");
-	xattr = calloc(xattr_length, sizeof(char));
-	SPDK_CU_ASSERT_FATAL(xattr != NULL);
-	rc = spdk_blob_set_xattr(blob, "large_xattr", xattr, xattr_length);
-	free(xattr);
-	SPDK_CU_ASSERT_FATAL(rc == 0);
+	ut_spdk_blob_opts_init(&opts);
+	opts.num_clusters = 1;
+	blob = ut_blob_create_and_open(bs, &opts);
+	blobid = spdk_blob_get_id(blob);
+	src = spdk_blob_get_cluster_location(blob, 0);
+	free_clusters = spdk_bs_free_cluster_count(bs);
 
-	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	/* Pretend an I/O to the blob was translated before the freeze and is still outstanding */
+	SPDK_CU_ASSERT_FATAL(bs_ch->req_mem[0].io_blob == NULL);
+	bs_ch->req_mem[0].io_blob = blob;
+
+	dst = spdk_bs_find_free_clusters(bs, 0, 1);
+	g_bserrno = -1;
+	spdk_bs_blob_move_cluster(bs, blobid, 0, dst, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -1);
+	CU_ASSERT(spdk_blob_get_cluster_location(blob, 0) == src);
+
+	/* The move keeps waiting without spinning while the I/O is outstanding */
+	spdk_delay_us(BS_CLUSTER_DRAIN_RETRY_US);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -1);
+	CU_ASSERT(spdk_blob_get_cluster_location(blob, 0) == src);
+
+	bs_ch->req_mem[0].io_blob = NULL;
+	spdk_delay_us(BS_CLUSTER_DRAIN_RETRY_US);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_cluster_location(blob, 0) == dst);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
+
+	spdk_bs_free_io_channel(channel);
 	poll_threads();
 
-	/* Delete the blob and verify that number of pages returned to before its creation. */
-	SPDK_CU_ASSERT_FATAL(used_pages != spdk_bit_array_count_set(bs->used_md_pages));
 	ut_blob_close_and_delete(bs, blob);
-	SPDK_CU_ASSERT_FATAL(used_pages == spdk_bit_array_count_set(bs->used_md_pages));
 }
 
 static void
-bs_load(void)
+blob_move_cluster_sync_fail(void)
 {
-	struct spdk_blob_store *bs;
-	struct spdk_bs_dev *dev;
-	spdk_blob_id blobid;
+	struct spdk_blob_store *bs = g_bs;
 	struct spdk_blob *blob;
-	struct spdk_bs_super_block *super_block;
-	uint64_t length;
-	int rc;
-	const void *value;
-	size_t value_len;
-	struct spdk_bs_opts opts;
-	struct spdk_blob_opts blob_opts;
-
-	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
-
-	/* Initialize a new blob store */
-	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	bs = g_bs;
+	struct spdk_blob_opts opts;
+	struct spdk_power_failure_thresholds thresholds = {};
+	spdk_blob_id blobid;
+	uint64_t free_clusters, dst;
+	bool dst_claimed = false;
+	int i;
 
-	/* Try to open a blobid that does not exist */
-	spdk_bs_open_blob(bs, 0, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == -ENOENT);
-	CU_ASSERT(g_blob == NULL);
+	/* Only the extent table writes the new location out before the rest of the metadata */
+	if (!g_use_extent_table) {
+		return;
+	}
 
-	/* Create a blob */
-	blob = ut_blob_create_and_open(bs, NULL);
+	ut_spdk_blob_opts_init(&opts);
+	opts.num_clusters = 1;
+	blob = ut_blob_create_and_open(bs, &opts);
 	blobid = spdk_blob_get_id(blob);
+	free_clusters = spdk_bs_free_cluster_count(bs);
 
-	/* Try again to open valid blob but without the upper bit set */
-	spdk_bs_open_blob(bs, blobid & 0xFFFFFFFF, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == -ENOENT);
-	CU_ASSERT(g_blob == NULL);
-
-	/* Set some xattrs */
-	rc = spdk_blob_set_xattr(blob, "name", "log.txt", strlen("log.txt") + 1);
-	CU_ASSERT(rc == 0);
+	/* Let the copy and the extent page through, then fail the metadata pages */
+	thresholds.write_threshold = g_dev_copy_enabled ? 2 : 3;
+	dev_set_power_failure_thresholds(thresholds);
 
-	length = 2345;
-	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
-	CU_ASSERT(rc == 0);
+	dst = spdk_bs_find_free_clusters(bs, 0, 1);
+	g_bserrno = -1;
+	spdk_bs_blob_move_cluster(bs, blobid, 0, dst, blob_op_complete, NULL);
 
-	/* Resize the blob */
-	spdk_blob_resize(blob, 10, blob_op_complete, NULL);
+	/* Power comes back once the old cluster is released, so that the blob can be closed */
+	for (i = 0; i < 1000 && g_bserrno == -1; i++) {
+		poll_thread_times(0, 1);
+		if (spdk_bs_free_cluster_count(bs) < free_clusters) {
+			dst_claimed = true;
+		} else if (dst_claimed) {
+			break;
+		}
+	}
+	CU_ASSERT(dst_claimed);
+	CU_ASSERT(g_bserrno == -1);
+	dev_reset_power_failure_event();
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	blob = NULL;
-	g_blob = NULL;
-	g_blobid = SPDK_BLOBID_INVALID;
+	/* The extent page already pointed at the new cluster, so the move was completed */
+	CU_ASSERT(g_bserrno == -EIO);
+	CU_ASSERT(spdk_blob_get_cluster_location(blob, 0) == dst);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
 
-	/* Unload the blob store */
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	g_bs = NULL;
-	g_blob = NULL;
-	g_blobid = 0;
 
-	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
-	CU_ASSERT(super_block->clean == 1);
+	ut_bs_reload(&bs, NULL);
 
-	/* Load should fail for device with an unsupported blocklen */
-	dev = init_dev();
-	dev->blocklen = SPDK_BS_PAGE_SIZE * 2;
-	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == -EINVAL);
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(spdk_blob_get_cluster_location(blob, 0) == dst);
 
-	/* Load should when max_md_ops is set to zero */
-	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.max_md_ops = 0;
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == -EINVAL);
+	ut_blob_close_and_delete(bs, blob);
+}
 
-	/* Load should when max_channel_ops is set to zero */
-	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.max_channel_ops = 0;
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == -EINVAL);
+static void
+ut_blob_share_cluster_verify(struct spdk_blob *blob, struct spdk_io_channel *channel,
+			     uint64_t cluster_num, uint8_t *payload_read, uint8_t *payload_expected)
+{
+	uint64_t io_units_per_cluster = spdk_bs_get_cluster_size(blob->bs) /
+					spdk_bs_get_io_unit_size(blob->bs);
 
-	/* Load an existing blob store */
-	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	spdk_blob_io_read(blob, channel, payload_read, cluster_num * io_units_per_cluster,
+			  io_units_per_cluster, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	bs = g_bs;
+	CU_ASSERT(memcmp(payload_read, payload_expected, spdk_bs_get_cluster_size(blob->bs)) == 0);
+}
 
-	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
-	CU_ASSERT(super_block->clean == 1);
-	CU_ASSERT(super_block->size == dev->blockcnt * dev->blocklen);
+static void
+blob_share_cluster(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob1, *blob2, *thick;
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts opts;
+	struct spdk_bs_super_block *super;
+	spdk_blob_id blobid1, blobid2;
+	uint64_t cluster_size, io_units_per_cluster, free_clusters, fp1, fp2, i;
+	uint8_t *payload_read, *payload_write;
+	uint8_t pattern1[] = { 0x11, 0x22, 0x44 };
+	uint8_t pattern2[] = { 0x11, 0x33, 0x44 };
 
-	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blob != NULL);
-	blob = g_blob;
+	cluster_size = spdk_bs_get_cluster_size(bs);
+	io_units_per_cluster = cluster_size / spdk_bs_get_io_unit_size(bs);
 
-	/* Verify that blobstore is marked dirty after first metadata sync */
-	spdk_blob_sync_md(blob, blob_op_complete, NULL);
-	CU_ASSERT(super_block->clean == 1);
+	payload_read = malloc(cluster_size);
+	SPDK_CU_ASSERT_FATAL(payload_read != NULL);
+	payload_write = malloc(cluster_size);
+	SPDK_CU_ASSERT_FATAL(payload_write != NULL);
 
-	/* Get the xattrs */
-	value = NULL;
-	rc = spdk_blob_get_xattr_value(blob, "length", &value, &value_len);
-	CU_ASSERT(rc == 0);
-	SPDK_CU_ASSERT_FATAL(value != NULL);
-	CU_ASSERT(*(uint64_t *)value == length);
-	CU_ASSERT(value_len == 8);
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
 
-	rc = spdk_blob_get_xattr_value(blob, "foobar", &value, &value_len);
-	CU_ASSERT(rc == -ENOENT);
+	/* Two thin provisioned blobs, with the same data in clusters 0 and 2 */
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 4;
+	blob1 = ut_blob_create_and_open(bs, &opts);
+	blobid1 = spdk_blob_get_id(blob1);
+	blob2 = ut_blob_create_and_open(bs, &opts);
+	blobid2 = spdk_blob_get_id(blob2);
 
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 10);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 10);
+	for (i = 0; i < SPDK_COUNTOF(pattern1); i++) {
+		memset(payload_write, pattern1[i], cluster_size);
+		spdk_blob_io_write(blob1, channel, payload_write, i * io_units_per_cluster,
+				   io_units_per_cluster, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		memset(payload_write, pattern2[i], cluster_size);
+		spdk_blob_io_write(blob2, channel, payload_write, i * io_units_per_cluster,
+				   io_units_per_cluster, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+	}
+	free_clusters = spdk_bs_free_cluster_count(bs);
+	CU_ASSERT(spdk_bs_saved_cluster_count(bs) == 0);
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
+	/* Same data gives the same fingerprint */
+	spdk_bs_blob_cluster_fingerprint(bs, channel, blobid1, 0, &fp1, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	blob = NULL;
-	g_blob = NULL;
-
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+	spdk_bs_blob_cluster_fingerprint(bs, channel, blobid2, 0, &fp2, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	g_bs = NULL;
-
-	/* Load should fail: bdev size < saved size */
-	dev = init_dev();
-	dev->blockcnt /= 2;
-
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(fp1 == fp2);
+	spdk_bs_blob_cluster_fingerprint(bs, channel, blobid2, 1, &fp2, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(fp1 != fp2);
+	spdk_bs_blob_cluster_fingerprint(bs, channel, blobid2, 3, &fp2, blob_op_complete, NULL);
 	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
 
+	/* Clusters with different data or unallocated clusters are not shared */
+	spdk_bs_blob_share_cluster(bs, blobid2, 1, blobid1, 1, blob_op_complete, NULL);
+	poll_threads();
 	CU_ASSERT(g_bserrno == -EILSEQ);
+	spdk_bs_blob_share_cluster(bs, blobid2, 3, blobid1, 0, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
+	CU_ASSERT(!spdk_blob_is_cluster_shared(blob1, 1));
 
-	/* Load should succeed: bdev size > saved size */
-	dev = init_dev();
-	dev->blockcnt *= 4;
-
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	/* Share clusters 0 and 2, a cluster is saved for each */
+	spdk_bs_blob_share_cluster(bs, blobid2, 0, blobid1, 0, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	bs = g_bs;
+	spdk_bs_blob_share_cluster(bs, blobid2, 2, blobid1, 2, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_cluster_location(blob2, 0) == spdk_blob_get_cluster_location(blob1, 0));
+	CU_ASSERT(spdk_blob_get_cluster_location(blob2, 2) == spdk_blob_get_cluster_location(blob1, 2));
+	CU_ASSERT(spdk_blob_is_cluster_shared(blob1, 0));
+	CU_ASSERT(spdk_blob_is_cluster_shared(blob2, 0));
+	CU_ASSERT(!spdk_blob_is_cluster_shared(blob2, 1));
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters + 2);
+	CU_ASSERT(spdk_bs_saved_cluster_count(bs) == 2);
+	free_clusters += 2;
 
+	/* Sharing again is a no-op, shared clusters can't be moved */
+	spdk_bs_blob_share_cluster(bs, blobid2, 0, blobid1, 0, blob_op_complete, NULL);
+	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+	CU_ASSERT(spdk_bs_saved_cluster_count(bs) == 2);
+	spdk_bs_blob_move_cluster(bs, blobid1, 0, spdk_bs_find_free_clusters(bs, 0, 1),
+				  blob_op_complete, NULL);
 	poll_threads();
+	CU_ASSERT(g_bserrno == -EPERM);
 
+	/* Thick provisioned blobs can't share clusters */
+	ut_spdk_blob_opts_init(&opts);
+	opts.num_clusters = 1;
+	thick = ut_blob_create_and_open(bs, &opts);
+	spdk_bs_blob_share_cluster(bs, spdk_blob_get_id(thick), 0, blobid1, 0, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EPERM);
+	ut_blob_close_and_delete(bs, thick);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
 
-	/* Test compatibility mode */
+	/* A write to a shared cluster goes to a copy of it */
+	memset(payload_write, 0xAA, cluster_size / 2);
+	memset(payload_write + cluster_size / 2, 0x11, cluster_size / 2);
+	spdk_blob_io_write(blob2, channel, payload_write, 0, io_units_per_cluster / 2,
+			   blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_cluster_location(blob2, 0) != spdk_blob_get_cluster_location(blob1, 0));
+	CU_ASSERT(!spdk_blob_is_cluster_shared(blob1, 0));
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 1);
+	CU_ASSERT(spdk_bs_saved_cluster_count(bs) == 1);
+	free_clusters--;
+	ut_blob_share_cluster_verify(blob2, channel, 0, payload_read, payload_write);
+	memset(payload_write, 0x11, cluster_size);
+	ut_blob_share_cluster_verify(blob1, channel, 0, payload_read, payload_write);
 
-	dev = init_dev();
-	super_block->size = 0;
-	super_block->crc = blob_md_page_calc_crc(super_block);
+	/* Unmapping a shared cluster only drops the reference */
+	spdk_blob_io_unmap(blob1, channel, 2 * io_units_per_cluster, io_units_per_cluster,
+			   blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_cluster_location(blob1, 2) == UINT64_MAX);
+	CU_ASSERT(!spdk_blob_is_cluster_shared(blob2, 2));
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
+	CU_ASSERT(spdk_bs_saved_cluster_count(bs) == 0);
+	memset(payload_write, 0x44, cluster_size);
+	ut_blob_share_cluster_verify(blob2, channel, 2, payload_read, payload_write);
 
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	/* Share cluster 1 once it holds the same data */
+	memset(payload_write, 0x22, cluster_size);
+	spdk_blob_io_write(blob2, channel, payload_write, io_units_per_cluster, io_units_per_cluster,
+			   blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	bs = g_bs;
+	spdk_bs_blob_share_cluster(bs, blobid2, 1, blobid1, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters + 1);
+	CU_ASSERT(spdk_bs_saved_cluster_count(bs) == 1);
+	free_clusters++;
 
-	/* Create a blob */
-	ut_spdk_blob_opts_init(&blob_opts);
-	spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
+	spdk_blob_close(blob1, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	spdk_blob_close(blob2, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
 
-	/* Blobstore should update number of blocks in super_block */
-	CU_ASSERT(super_block->size == dev->blockcnt * dev->blocklen);
-	CU_ASSERT(super_block->clean == 0);
+	/* The references are rebuilt from the metadata on load */
+	ut_bs_reload(&bs, NULL);
+	CU_ASSERT(bs->shared_clusters);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
+	CU_ASSERT(spdk_bs_saved_cluster_count(bs) == 1);
 
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+
+	spdk_bs_open_blob(bs, blobid1, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(super_block->clean == 1);
-	g_bs = NULL;
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob1 = g_blob;
+	spdk_bs_open_blob(bs, blobid2, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob2 = g_blob;
+	CU_ASSERT(spdk_blob_is_cluster_shared(blob1, 1));
+	CU_ASSERT(spdk_blob_is_cluster_shared(blob2, 1));
+
+	/* Deleting one of the blobs keeps the shared cluster for the other */
+	ut_blob_close_and_delete(bs, blob1);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters + 1);
+	CU_ASSERT(spdk_bs_saved_cluster_count(bs) == 0);
+	memset(payload_write, 0x22, cluster_size);
+	ut_blob_share_cluster_verify(blob2, channel, 1, payload_read, payload_write);
+
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
+
+	ut_blob_close_and_delete(bs, blob2);
+
+	/* Once no cluster is shared, a clean unload brings the version back down so that
+	 * the next load doesn't need to rebuild the references.
+	 */
+	ut_bs_reload(&bs, NULL);
+	CU_ASSERT(!bs->shared_clusters);
+	super = (struct spdk_bs_super_block *)g_dev_buffer;
+	CU_ASSERT(super->version == SPDK_BS_VERSION);
 
+	free(payload_read);
+	free(payload_write);
 }
 
 static void
-bs_load_pending_removal(void)
+blob_share_cluster_drain(void)
 {
 	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob1, *blob2;
+	struct spdk_io_channel *channel;
+	struct spdk_bs_channel *bs_ch;
 	struct spdk_blob_opts opts;
-	struct spdk_blob *blob, *snapshot;
-	spdk_blob_id blobid, snapshotid;
-	const void *value;
-	size_t value_len;
-	int rc;
+	spdk_blob_id blobid1, blobid2;
+	uint64_t cluster_size, io_units_per_cluster, free_clusters;
+	uint8_t *payload_write;
 
-	/* Create blob */
-	ut_spdk_blob_opts_init(&opts);
-	opts.num_clusters = 10;
+	cluster_size = spdk_bs_get_cluster_size(bs);
+	io_units_per_cluster = cluster_size / spdk_bs_get_io_unit_size(bs);
 
-	blob = ut_blob_create_and_open(bs, &opts);
-	blobid = spdk_blob_get_id(blob);
+	payload_write = malloc(cluster_size);
+	SPDK_CU_ASSERT_FATAL(payload_write != NULL);
+	memset(payload_write, 0x5A, cluster_size);
 
-	/* Create snapshot */
-	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+	bs_ch = spdk_io_channel_get_ctx(channel);
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 1;
+	blob1 = ut_blob_create_and_open(bs, &opts);
+	blobid1 = spdk_blob_get_id(blob1);
+	blob2 = ut_blob_create_and_open(bs, &opts);
+	blobid2 = spdk_blob_get_id(blob2);
+
+	spdk_blob_io_write(blob1, channel, payload_write, 0, io_units_per_cluster, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
-	snapshotid = g_blobid;
-
-	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
+	spdk_blob_io_write(blob2, channel, payload_write, 0, io_units_per_cluster, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
-	snapshot = g_blob;
+	free_clusters = spdk_bs_free_cluster_count(bs);
 
-	/* Set SNAPSHOT_PENDING_REMOVAL xattr */
-	snapshot->md_ro = false;
-	rc = blob_set_xattr(snapshot, SNAPSHOT_PENDING_REMOVAL, &blobid, sizeof(spdk_blob_id), true);
-	CU_ASSERT(rc == 0);
-	snapshot->md_ro = true;
+	/* Pretend a write to the source blob was translated before the freeze and is still outstanding */
+	SPDK_CU_ASSERT_FATAL(bs_ch->req_mem[0].io_blob == NULL);
+	bs_ch->req_mem[0].io_blob = blob1;
 
-	spdk_blob_close(snapshot, blob_op_complete, NULL);
+	g_bserrno = -1;
+	spdk_bs_blob_share_cluster(bs, blobid2, 0, blobid1, 0, blob_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_bserrno == -1);
+	CU_ASSERT(!spdk_blob_is_cluster_shared(blob2, 0));
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
+	/* The share keeps waiting without spinning while the write is outstanding */
+	spdk_delay_us(BS_CLUSTER_DRAIN_RETRY_US);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-
-	/* Reload blobstore */
-	ut_bs_reload(&bs, NULL);
+	CU_ASSERT(g_bserrno == -1);
+	CU_ASSERT(!spdk_blob_is_cluster_shared(blob2, 0));
 
-	/* Snapshot should not be removed as blob is still pointing to it */
-	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
+	bs_ch->req_mem[0].io_blob = NULL;
+	spdk_delay_us(BS_CLUSTER_DRAIN_RETRY_US);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
-	snapshot = g_blob;
+	CU_ASSERT(spdk_blob_is_cluster_shared(blob2, 0));
+	CU_ASSERT(spdk_blob_get_cluster_location(blob2, 0) == spdk_blob_get_cluster_location(blob1, 0));
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters + 1);
 
-	/* SNAPSHOT_PENDING_REMOVAL xattr should be removed during load */
-	rc = spdk_blob_get_xattr_value(snapshot, SNAPSHOT_PENDING_REMOVAL, &value, &value_len);
-	CU_ASSERT(rc != 0);
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
 
-	/* Set SNAPSHOT_PENDING_REMOVAL xattr again */
-	snapshot->md_ro = false;
-	rc = blob_set_xattr(snapshot, SNAPSHOT_PENDING_REMOVAL, &blobid, sizeof(spdk_blob_id), true);
-	CU_ASSERT(rc == 0);
-	snapshot->md_ro = true;
+	ut_blob_close_and_delete(bs, blob1);
+	ut_blob_close_and_delete(bs, blob2);
 
-	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
-	blob = g_blob;
+	free(payload_write);
+}
 
-	/* Remove parent_id from blob by removing BLOB_SNAPSHOT xattr */
-	blob_remove_xattr(blob, BLOB_SNAPSHOT, true);
+static void
+blob_unmap(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts opts;
+	uint8_t payload[4096];
+	int i;
 
-	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	channel = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel != NULL);
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.num_clusters = 10;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+
+	spdk_blob_resize(blob, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 10);
 
-	spdk_blob_close(snapshot, blob_op_complete, NULL);
+	memset(payload, 0, sizeof(payload));
+	payload[0] = 0xFF;
+
+	/*
+	 * Set first byte of every cluster to 0xFF.
+	 * First cluster on device is reserved so let's start from cluster number 1
+	 */
+	for (i = 1; i < 11; i++) {
+		g_dev_buffer[i * SPDK_BLOB_OPTS_CLUSTER_SZ] = 0xFF;
+	}
+
+	/* Confirm writes */
+	for (i = 0; i < 10; i++) {
+		payload[0] = 0;
+		spdk_blob_io_read(blob, channel, &payload, i * SPDK_BLOB_OPTS_CLUSTER_SZ / 4096, 1,
+				  blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(payload[0] == 0xFF);
+	}
+
+	/* Mark some clusters as unallocated */
+	blob->active.clusters[1] = 0;
+	blob->active.clusters[2] = 0;
+	blob->active.clusters[3] = 0;
+	blob->active.clusters[6] = 0;
+	blob->active.clusters[8] = 0;
+	blob->active.num_allocated_clusters -= 5;
+
+	/* Unmap clusters by resizing to 0 */
+	spdk_blob_resize(blob, 0, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
 
-	/* Reload blobstore */
-	ut_bs_reload(&bs, NULL);
+	/* Confirm that only 'allocated' clusters were unmapped */
+	for (i = 1; i < 11; i++) {
+		switch (i) {
+		case 2:
+		case 3:
+		case 4:
+		case 7:
+		case 9:
+			CU_ASSERT(g_dev_buffer[i * SPDK_BLOB_OPTS_CLUSTER_SZ] == 0xFF);
+			break;
+		default:
+			CU_ASSERT(g_dev_buffer[i * SPDK_BLOB_OPTS_CLUSTER_SZ] == 0);
+			break;
+		}
+	}
 
-	/* Snapshot should be removed as blob is not pointing to it anymore */
-	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
+	spdk_bs_free_io_channel(channel);
 	poll_threads();
-	CU_ASSERT(g_bserrno != 0);
+
+	ut_blob_close_and_delete(bs, blob);
 }
 
 static void
-bs_load_custom_cluster_size(void)
+blob_iter(void)
 {
-	struct spdk_blob_store *bs;
-	struct spdk_bs_dev *dev;
-	struct spdk_bs_super_block *super_block;
-	struct spdk_bs_opts opts;
-	uint32_t custom_cluster_size = 4194304; /* 4MiB */
-	uint32_t cluster_sz;
-	uint64_t total_clusters;
-
-	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.cluster_sz = custom_cluster_size;
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	spdk_blob_id blobid;
+	struct spdk_blob_opts blob_opts;
 
-	/* Initialize a new blob store */
-	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	spdk_bs_iter_first(bs, blob_op_with_handle_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	bs = g_bs;
-	cluster_sz = bs->cluster_sz;
-	total_clusters = bs->total_clusters;
+	CU_ASSERT(g_blob == NULL);
+	CU_ASSERT(g_bserrno == -ENOENT);
 
-	/* Unload the blob store */
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+	ut_spdk_blob_opts_init(&blob_opts);
+	spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	g_bs = NULL;
-	g_blob = NULL;
-	g_blobid = 0;
-
-	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
-	CU_ASSERT(super_block->clean == 1);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	blobid = g_blobid;
 
-	/* Load an existing blob store */
-	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	spdk_bs_iter_first(bs, blob_op_with_handle_complete, NULL);
 	poll_threads();
+	CU_ASSERT(g_blob != NULL);
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	bs = g_bs;
-	/* Compare cluster size and number to one after initialization */
-	CU_ASSERT(cluster_sz == bs->cluster_sz);
-	CU_ASSERT(total_clusters == bs->total_clusters);
+	blob = g_blob;
+	CU_ASSERT(spdk_blob_get_id(blob) == blobid);
 
-	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
-	CU_ASSERT(super_block->clean == 1);
-	CU_ASSERT(super_block->size == dev->blockcnt * dev->blocklen);
+	spdk_bs_iter_next(bs, blob, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_blob == NULL);
+	CU_ASSERT(g_bserrno == -ENOENT);
+}
 
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+static void
+blob_xattr(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob = g_blob;
+	spdk_blob_id blobid = spdk_blob_get_id(blob);
+	uint64_t length;
+	int rc;
+	const char *name1, *name2;
+	const void *value;
+	size_t value_len;
+	struct spdk_xattr_names *names;
+
+	rc = spdk_blob_set_xattr(blob, "name", "log.txt", strlen("log.txt") + 1);
+	CU_ASSERT(rc == 0);
+
+	length = 2345;
+	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
+	CU_ASSERT(rc == 0);
+
+	/* Overwrite "length" xattr. */
+	length = 3456;
+	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
+	CU_ASSERT(rc == 0);
+
+	/* get_xattr should still work even if md_ro flag is set. */
+	value = NULL;
+	blob->md_ro = true;
+	rc = spdk_blob_get_xattr_value(blob, "length", &value, &value_len);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(value != NULL);
+	CU_ASSERT(*(uint64_t *)value == length);
+	CU_ASSERT(value_len == 8);
+	blob->md_ro = false;
+
+	rc = spdk_blob_get_xattr_value(blob, "foobar", &value, &value_len);
+	CU_ASSERT(rc == -ENOENT);
+
+	names = NULL;
+	rc = spdk_blob_get_xattr_names(blob, &names);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(names != NULL);
+	CU_ASSERT(spdk_xattr_names_get_count(names) == 2);
+	name1 = spdk_xattr_names_get_name(names, 0);
+	SPDK_CU_ASSERT_FATAL(name1 != NULL);
+	CU_ASSERT(!strcmp(name1, "name") || !strcmp(name1, "length"));
+	name2 = spdk_xattr_names_get_name(names, 1);
+	SPDK_CU_ASSERT_FATAL(name2 != NULL);
+	CU_ASSERT(!strcmp(name2, "name") || !strcmp(name2, "length"));
+	CU_ASSERT(strcmp(name1, name2));
+	spdk_xattr_names_free(names);
+
+	blob->md_ro = false;
+	rc = spdk_blob_remove_xattr(blob, "name");
+	CU_ASSERT(rc == 0);
+
+	rc = spdk_blob_remove_xattr(blob, "foobar");
+	CU_ASSERT(rc == -ENOENT);
+
+	/* Set internal xattr */
+
+	/* test that set_xattr fails for internal xattr if md_ro flag is set. */
+	blob->md_ro = true;
+	rc = blob_set_xattr(blob, "internal", &length, sizeof(length), true);
+	CU_ASSERT(rc == -EPERM);
+
+	blob->md_ro = false;
+	length = 7898;
+	rc = blob_set_xattr(blob, "internal", &length, sizeof(length), true);
+	CU_ASSERT(rc == 0);
+	rc = blob_get_xattr_value(blob, "internal", &value, &value_len, true);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(*(uint64_t *)value == length);
+	/* try to get public xattr with same name */
+	rc = spdk_blob_get_xattr_value(blob, "internal", &value, &value_len);
+	CU_ASSERT(rc != 0);
+	rc = blob_get_xattr_value(blob, "internal", &value, &value_len, false);
+	CU_ASSERT(rc != 0);
+	/* Check if SPDK_BLOB_INTERNAL_XATTR is set */
+	CU_ASSERT((blob->invalid_flags & SPDK_BLOB_INTERNAL_XATTR) ==
+		  SPDK_BLOB_INTERNAL_XATTR);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+
+	/* Check if xattrs are persisted */
+	ut_bs_reload(&bs, NULL);
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(super_block->clean == 1);
-	g_bs = NULL;
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+
+	rc = blob_get_xattr_value(blob, "internal", &value, &value_len, true);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(*(uint64_t *)value == length);
+
+	/* try to get internal xattr through public call */
+	rc = spdk_blob_get_xattr_value(blob, "internal", &value, &value_len);
+	CU_ASSERT(rc != 0);
+
+	/* Confirm that remove_xattr fails for internal xattr if md_ro is set to true. */
+	blob->md_ro = true;
+	rc = blob_remove_xattr(blob, "internal", true);
+	CU_ASSERT(rc == -EPERM);
+
+	blob->md_ro = false;
+	rc = blob_remove_xattr(blob, "internal", true);
+	CU_ASSERT(rc == 0);
+
+	CU_ASSERT((blob->invalid_flags & SPDK_BLOB_INTERNAL_XATTR) == 0);
 }
 
 static void
-bs_load_after_failed_grow(void)
+blob_parse_md(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	int rc;
+	uint32_t used_pages;
+	size_t xattr_length;
+	char *xattr;
+
+	used_pages = spdk_bit_array_count_set(bs->used_md_pages);
+	blob = ut_blob_create_and_open(bs, NULL);
+
+	/* Create large extent to force more than 1 page of metadata. */
+	xattr_length = SPDK_BS_MAX_DESC_SIZE - sizeof(struct spdk_blob_md_descriptor_xattr) -
+		       strlen("large_xattr");
+	xattr = calloc(xattr_length, sizeof(char));
+	SPDK_CU_ASSERT_FATAL(xattr != NULL);
+	rc = spdk_blob_set_xattr(blob, "large_xattr", xattr, xattr_length);
+	free(xattr);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	poll_threads();
+
+	/* Delete the blob and verify that number of pages returned to before its creation. */
+	SPDK_CU_ASSERT_FATAL(used_pages != spdk_bit_array_count_set(bs->used_md_pages));
+	ut_blob_close_and_delete(bs, blob);
+	SPDK_CU_ASSERT_FATAL(used_pages == spdk_bit_array_count_set(bs->used_md_pages));
+}
+
+static void
+bs_load(void)
 {
 	struct spdk_blob_store *bs;
 	struct spdk_bs_dev *dev;
+	spdk_blob_id blobid;
+	struct spdk_blob *blob;
 	struct spdk_bs_super_block *super_block;
+	uint64_t length;
+	int rc;
+	const void *value;
+	size_t value_len;
 	struct spdk_bs_opts opts;
-	struct spdk_bs_md_mask *mask;
 	struct spdk_blob_opts blob_opts;
-	struct spdk_blob *blob, *snapshot;
-	spdk_blob_id blobid, snapshotid;
-	uint64_t total_data_clusters;
 
 	dev = init_dev();
 	spdk_bs_opts_init(&opts, sizeof(opts));
 	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
-	/*
-	 * The bdev_size is 64M, cluster_sz is 1M, so there are 64 clusters. The
-	 * blobstore will create 64 md pages by default. We set num_md_pages to 128,
-	 * thus the blobstore could grow to the double size.
-	 */
-	opts.num_md_pages = 128;
 
 	/* Initialize a new blob store */
 	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
@@ -2743,36 +3076,41 @@ bs_load_after_failed_grow(void)
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
 
-	/* Create blob */
-	ut_spdk_blob_opts_init(&blob_opts);
-	blob_opts.num_clusters = 10;
+	/* Try to open a blobid that does not exist */
+	spdk_bs_open_blob(bs, 0, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -ENOENT);
+	CU_ASSERT(g_blob == NULL);
 
-	blob = ut_blob_create_and_open(bs, &blob_opts);
+	/* Create a blob */
+	blob = ut_blob_create_and_open(bs, NULL);
 	blobid = spdk_blob_get_id(blob);
 
-	/* Create snapshot */
-	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	/* Try again to open valid blob but without the upper bit set */
+	spdk_bs_open_blob(bs, blobid & 0xFFFFFFFF, blob_op_with_handle_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
-	snapshotid = g_blobid;
+	CU_ASSERT(g_bserrno == -ENOENT);
+	CU_ASSERT(g_blob == NULL);
 
-	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
-	snapshot = g_blob;
+	/* Set some xattrs */
+	rc = spdk_blob_set_xattr(blob, "name", "log.txt", strlen("log.txt") + 1);
+	CU_ASSERT(rc == 0);
 
-	spdk_blob_close(snapshot, blob_op_complete, NULL);
+	length = 2345;
+	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
+	CU_ASSERT(rc == 0);
+
+	/* Resize the blob */
+	spdk_blob_resize(blob, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 
 	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-
-	total_data_clusters = bs->total_data_clusters;
-	CU_ASSERT(bs->num_free_clusters + 10 == total_data_clusters);
+	blob = NULL;
+	g_blob = NULL;
+	g_blobid = SPDK_BLOBID_INVALID;
 
 	/* Unload the blob store */
 	spdk_bs_unload(bs, bs_op_complete, NULL);
@@ -2785,21 +3123,32 @@ bs_load_after_failed_grow(void)
 	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
 	CU_ASSERT(super_block->clean == 1);
 
-	mask = (struct spdk_bs_md_mask *)(g_dev_buffer + super_block->used_cluster_mask_start * 4096);
-	CU_ASSERT(mask->type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
-	CU_ASSERT(mask->length == super_block->size / super_block->cluster_size);
+	/* Load should fail for device with an unsupported blocklen */
+	dev = init_dev();
+	dev->blocklen = SPDK_BS_PAGE_SIZE * 2;
+	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
 
-	/*
-	 * We change the mask->length to emulate this scenario: A spdk_bs_grow failed after it changed
-	 * the used_cluster bitmap length, but it didn't change the super block yet.
-	 */
-	mask->length *= 2;
+	/* Load should when max_md_ops is set to zero */
+	dev = init_dev();
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	opts.max_md_ops = 0;
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
+
+	/* Load should when max_channel_ops is set to zero */
+	dev = init_dev();
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	opts.max_channel_ops = 0;
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
 
 	/* Load an existing blob store */
 	dev = init_dev();
-	dev->blockcnt *= 2;
 	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.clear_method = BS_CLEAR_WITH_NONE;
 	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
 	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
@@ -2807,132 +3156,215 @@ bs_load_after_failed_grow(void)
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
 
-	/* Check the capacity is the same as before */
-	CU_ASSERT(bs->total_data_clusters == total_data_clusters);
-	CU_ASSERT(bs->num_free_clusters + 10 == total_data_clusters);
+	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
+	CU_ASSERT(super_block->clean == 1);
+	CU_ASSERT(super_block->size == dev->blockcnt * dev->blocklen);
 
-	/* Check the blob and the snapshot are still available */
 	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	CU_ASSERT(g_blob != NULL);
 	blob = g_blob;
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
+	/* Verify that blobstore is marked dirty after first metadata sync */
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	CU_ASSERT(super_block->clean == 1);
 
-	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
-	snapshot = g_blob;
+	/* Get the xattrs */
+	value = NULL;
+	rc = spdk_blob_get_xattr_value(blob, "length", &value, &value_len);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(value != NULL);
+	CU_ASSERT(*(uint64_t *)value == length);
+	CU_ASSERT(value_len == 8);
 
-	spdk_blob_close(snapshot, blob_op_complete, NULL);
+	rc = spdk_blob_get_xattr_value(blob, "foobar", &value, &value_len);
+	CU_ASSERT(rc == -ENOENT);
+
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 10);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 10);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	blob = NULL;
+	g_blob = NULL;
 
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(super_block->clean == 1);
 	g_bs = NULL;
-}
-
-static void
-bs_type(void)
-{
-	struct spdk_blob_store *bs;
-	struct spdk_bs_dev *dev;
-	struct spdk_bs_opts opts;
 
+	/* Load should fail: bdev size < saved size */
 	dev = init_dev();
+	dev->blockcnt /= 2;
+
 	spdk_bs_opts_init(&opts, sizeof(opts));
 	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
 
-	/* Initialize a new blob store */
-	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	CU_ASSERT(g_bserrno == -EILSEQ);
+
+	/* Load should succeed: bdev size > saved size */
+	dev = init_dev();
+	dev->blockcnt *= 4;
+
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
 
-	/* Unload the blob store */
+	CU_ASSERT(g_bserrno == 0);
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	g_bs = NULL;
-	g_blob = NULL;
-	g_blobid = 0;
 
-	/* Load non existing blobstore type */
-	dev = init_dev();
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "NONEXISTING");
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno != 0);
 
-	/* Load with empty blobstore type */
+	/* Test compatibility mode */
+
 	dev = init_dev();
-	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
+	super_block->size = 0;
+	super_block->crc = blob_md_page_calc_crc(super_block);
+
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
 	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
 
+	/* Create a blob */
+	ut_spdk_blob_opts_init(&blob_opts);
+	spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+
+	/* Blobstore should update number of blocks in super_block */
+	CU_ASSERT(super_block->size == dev->blockcnt * dev->blocklen);
+	CU_ASSERT(super_block->clean == 0);
+
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(super_block->clean == 1);
 	g_bs = NULL;
 
-	/* Initialize a new blob store with empty bstype */
-	dev = init_dev();
-	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
-	spdk_bs_init(dev, NULL, bs_op_with_handle_complete, NULL);
+}
+
+static void
+bs_load_pending_removal(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob_opts opts;
+	struct spdk_blob *blob, *snapshot;
+	spdk_blob_id blobid, snapshotid;
+	const void *value;
+	size_t value_len;
+	int rc;
+
+	/* Create blob */
+	ut_spdk_blob_opts_init(&opts);
+	opts.num_clusters = 10;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+	blobid = spdk_blob_get_id(blob);
+
+	/* Create snapshot */
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	bs = g_bs;
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	snapshotid = g_blobid;
 
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	g_bs = NULL;
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
 
-	/* Load non existing blobstore type */
-	dev = init_dev();
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "NONEXISTING");
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	/* Set SNAPSHOT_PENDING_REMOVAL xattr */
+	snapshot->md_ro = false;
+	rc = blob_set_xattr(snapshot, SNAPSHOT_PENDING_REMOVAL, &blobid, sizeof(spdk_blob_id), true);
+	CU_ASSERT(rc == 0);
+	snapshot->md_ro = true;
+
+	spdk_blob_close(snapshot, blob_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno != 0);
+	CU_ASSERT(g_bserrno == 0);
 
-	/* Load with empty blobstore type */
-	dev = init_dev();
-	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	bs = g_bs;
 
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+	/* Reload blobstore */
+	ut_bs_reload(&bs, NULL);
+
+	/* Snapshot should not be removed as blob is still pointing to it */
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	g_bs = NULL;
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
+
+	/* SNAPSHOT_PENDING_REMOVAL xattr should be removed during load */
+	rc = spdk_blob_get_xattr_value(snapshot, SNAPSHOT_PENDING_REMOVAL, &value, &value_len);
+	CU_ASSERT(rc != 0);
+
+	/* Set SNAPSHOT_PENDING_REMOVAL xattr again */
+	snapshot->md_ro = false;
+	rc = blob_set_xattr(snapshot, SNAPSHOT_PENDING_REMOVAL, &blobid, sizeof(spdk_blob_id), true);
+	CU_ASSERT(rc == 0);
+	snapshot->md_ro = true;
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+
+	/* Remove parent_id from blob by removing BLOB_SNAPSHOT xattr */
+	blob_remove_xattr(blob, BLOB_SNAPSHOT, true);
+
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_blob_close(snapshot, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	/* Reload blobstore */
+	ut_bs_reload(&bs, NULL);
+
+	/* Snapshot should be removed as blob is not pointing to it anymore */
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno != 0);
 }
 
 static void
-bs_super_block(void)
+bs_load_custom_cluster_size(void)
 {
 	struct spdk_blob_store *bs;
 	struct spdk_bs_dev *dev;
 	struct spdk_bs_super_block *super_block;
 	struct spdk_bs_opts opts;
-	struct spdk_bs_super_block_ver1 super_block_v1;
+	uint32_t custom_cluster_size = 4194304; /* 4MiB */
+	uint32_t cluster_sz;
+	uint64_t total_clusters;
 
 	dev = init_dev();
 	spdk_bs_opts_init(&opts, sizeof(opts));
+	opts.cluster_sz = custom_cluster_size;
 	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
 
 	/* Initialize a new blob store */
@@ -2941,6 +3373,8 @@ bs_super_block(void)
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
+	cluster_sz = bs->cluster_sz;
+	total_clusters = bs->total_clusters;
 
 	/* Unload the blob store */
 	spdk_bs_unload(bs, bs_op_complete, NULL);
@@ -2950,302 +3384,210 @@ bs_super_block(void)
 	g_blob = NULL;
 	g_blobid = 0;
 
-	/* Load an existing blob store with version newer than supported */
 	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
-	super_block->version++;
-
-	dev = init_dev();
-	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno != 0);
+	CU_ASSERT(super_block->clean == 1);
 
-	/* Create a new blob store with super block version 1 */
+	/* Load an existing blob store */
 	dev = init_dev();
-	super_block_v1.version = 1;
-	memcpy(super_block_v1.signature, "SPDKBLOB", sizeof(super_block_v1.signature));
-	super_block_v1.length = 0x1000;
-	super_block_v1.clean = 1;
-	super_block_v1.super_blob = 0xFFFFFFFFFFFFFFFF;
-	super_block_v1.cluster_size = 0x100000;
-	super_block_v1.used_page_mask_start = 0x01;
-	super_block_v1.used_page_mask_len = 0x01;
-	super_block_v1.used_cluster_mask_start = 0x02;
-	super_block_v1.used_cluster_mask_len = 0x01;
-	super_block_v1.md_start = 0x03;
-	super_block_v1.md_len = 0x40;
-	memset(super_block_v1.reserved, 0, 4036);
-	super_block_v1.crc = blob_md_page_calc_crc(&super_block_v1);
-	memcpy(g_dev_buffer, &super_block_v1, sizeof(struct spdk_bs_super_block_ver1));
-
-	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
 	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
+	/* Compare cluster size and number to one after initialization */
+	CU_ASSERT(cluster_sz == bs->cluster_sz);
+	CU_ASSERT(total_clusters == bs->total_clusters);
+
+	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
+	CU_ASSERT(super_block->clean == 1);
+	CU_ASSERT(super_block->size == dev->blockcnt * dev->blocklen);
 
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(super_block->clean == 1);
 	g_bs = NULL;
 }
 
 static void
-bs_test_recover_cluster_count(void)
+bs_load_after_failed_grow(void)
 {
 	struct spdk_blob_store *bs;
 	struct spdk_bs_dev *dev;
-	struct spdk_bs_super_block super_block;
+	struct spdk_bs_super_block *super_block;
 	struct spdk_bs_opts opts;
+	struct spdk_bs_md_mask *mask;
+	struct spdk_blob_opts blob_opts;
+	struct spdk_blob *blob, *snapshot;
+	spdk_blob_id blobid, snapshotid;
+	uint64_t total_data_clusters;
 
 	dev = init_dev();
 	spdk_bs_opts_init(&opts, sizeof(opts));
 	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
+	/*
+	 * The bdev_size is 64M, cluster_sz is 1M, so there are 64 clusters. The
+	 * blobstore will create 64 md pages by default. We set num_md_pages to 128,
+	 * thus the blobstore could grow to the double size.
+	 */
+	opts.num_md_pages = 128;
 
-	super_block.version = 3;
-	memcpy(super_block.signature, "SPDKBLOB", sizeof(super_block.signature));
-	super_block.length = 0x1000;
-	super_block.clean = 0;
-	super_block.super_blob = 0xFFFFFFFFFFFFFFFF;
-	super_block.cluster_size = 4096;
-	super_block.used_page_mask_start = 0x01;
-	super_block.used_page_mask_len = 0x01;
-	super_block.used_cluster_mask_start = 0x02;
-	super_block.used_cluster_mask_len = 0x01;
-	super_block.used_blobid_mask_start = 0x03;
-	super_block.used_blobid_mask_len = 0x01;
-	super_block.md_start = 0x04;
-	super_block.md_len = 0x40;
-	memset(super_block.bstype.bstype, 0, sizeof(super_block.bstype.bstype));
-	super_block.size = dev->blockcnt * dev->blocklen;
-	super_block.io_unit_size = 0x1000;
-	memset(super_block.reserved, 0, 4000);
-	super_block.crc = blob_md_page_calc_crc(&super_block);
-	memcpy(g_dev_buffer, &super_block, sizeof(struct spdk_bs_super_block));
-
-	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	/* Initialize a new blob store */
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
-	CU_ASSERT(bs->num_free_clusters == bs->total_clusters - (super_block.md_start +
-			super_block.md_len));
 
+	/* Create blob */
+	ut_spdk_blob_opts_init(&blob_opts);
+	blob_opts.num_clusters = 10;
+
+	blob = ut_blob_create_and_open(bs, &blob_opts);
+	blobid = spdk_blob_get_id(blob);
+
+	/* Create snapshot */
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	snapshotid = g_blobid;
+
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
+
+	spdk_blob_close(snapshot, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	total_data_clusters = bs->total_data_clusters;
+	CU_ASSERT(bs->num_free_clusters + 10 == total_data_clusters);
+
+	/* Unload the blob store */
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	g_bs = NULL;
-}
+	g_blob = NULL;
+	g_blobid = 0;
 
-static void
-bs_grow_live_size(uint64_t new_blockcnt)
-{
-	struct spdk_blob_store *bs;
-	struct spdk_bs_dev *dev;
-	struct spdk_bs_super_block super_block;
-	struct spdk_bs_opts opts;
-	struct spdk_bs_md_mask mask;
-	uint64_t bdev_size;
-	uint64_t total_data_clusters;
+	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
+	CU_ASSERT(super_block->clean == 1);
+
+	mask = (struct spdk_bs_md_mask *)(g_dev_buffer + super_block->used_cluster_mask_start * 4096);
+	CU_ASSERT(mask->type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
+	CU_ASSERT(mask->length == super_block->size / super_block->cluster_size);
 
 	/*
-	 * Further down the test the dev size will be larger than the g_dev_buffer size,
-	 * so we set clear_method to NONE, or the blobstore will try to clear the dev and
-	 * will write beyond the end of g_dev_buffer.
+	 * We change the mask->length to emulate this scenario: A spdk_bs_grow failed after it changed
+	 * the used_cluster bitmap length, but it didn't change the super block yet.
 	 */
+	mask->length *= 2;
+
+	/* Load an existing blob store */
 	dev = init_dev();
+	dev->blockcnt *= 2;
 	spdk_bs_opts_init(&opts, sizeof(opts));
 	opts.clear_method = BS_CLEAR_WITH_NONE;
-	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
-	CU_ASSERT(spdk_bs_total_data_cluster_count(bs) == 63);
 
-	/*
-	 * Set the dev size according to the new_blockcnt,
-	 * then the blobstore will adjust the metadata according to the new size.
-	 */
-	dev->blockcnt = new_blockcnt;
-	bdev_size = dev->blockcnt * dev->blocklen;
-	spdk_bs_grow_live(bs, bs_op_complete, NULL);
+	/* Check the capacity is the same as before */
+	CU_ASSERT(bs->total_data_clusters == total_data_clusters);
+	CU_ASSERT(bs->num_free_clusters + 10 == total_data_clusters);
+
+	/* Check the blob and the snapshot are still available */
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	total_data_clusters = spdk_bs_total_data_cluster_count(bs);
-	/* One cluster of 1MiB size is used for metadata */
-	CU_ASSERT(total_data_clusters == (bdev_size / (1 * 1024 * 1024)) - 1);
-
-	/* Make sure the super block is updated. */
-	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
-	CU_ASSERT(super_block.size == bdev_size);
-	CU_ASSERT(super_block.clean == 0);
-	/* The used_cluster mask is not written out until first spdk_bs_unload. */
-	memcpy(&mask, g_dev_buffer + super_block.used_cluster_mask_start * 4096,
-	       sizeof(struct spdk_bs_md_mask));
-	CU_ASSERT(mask.type == 0);
-	CU_ASSERT(mask.length == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
 
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	g_bs = NULL;
-
-	/* Make sure all metadata is correct, super block and used_cluster mask. */
-	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
-	CU_ASSERT(super_block.size == bdev_size);
-	CU_ASSERT(super_block.clean == 1);
-	memcpy(&mask, g_dev_buffer + super_block.used_cluster_mask_start * 4096,
-	       sizeof(struct spdk_bs_md_mask));
-	CU_ASSERT(mask.type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
-	CU_ASSERT(mask.length == bdev_size / (1 * 1024 * 1024));
 
-	/* Load blobstore and check the cluster counts again. */
-	dev = init_dev();
-	dev->blockcnt = new_blockcnt;
-	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	CU_ASSERT(super_block.clean == 1);
-	bs = g_bs;
-	CU_ASSERT(total_data_clusters == spdk_bs_total_data_cluster_count(bs));
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
 
-	/* Perform grow without change in size, expected pass. */
-	spdk_bs_grow_live(bs, bs_op_complete, NULL);
+	spdk_blob_close(snapshot, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(total_data_clusters == spdk_bs_total_data_cluster_count(bs));
-	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
-	CU_ASSERT(super_block.size == bdev_size);
-	CU_ASSERT(super_block.clean == 1);
 
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(super_block->clean == 1);
 	g_bs = NULL;
 }
 
 static void
-bs_grow_live(void)
-{
-	/* No change expected */
-	bs_grow_live_size(DEV_BUFFER_BLOCKCNT);
-
-	/* Size slightly increased, but not enough to increase cluster count */
-	bs_grow_live_size(DEV_BUFFER_BLOCKCNT + 1);
-
-	/* Size doubled, increasing the cluster count */
-	bs_grow_live_size(DEV_BUFFER_BLOCKCNT * 2);
-}
-
-static void
-bs_grow_live_no_space(void)
+bs_type(void)
 {
 	struct spdk_blob_store *bs;
 	struct spdk_bs_dev *dev;
-	struct spdk_bs_super_block super_block;
 	struct spdk_bs_opts opts;
-	struct spdk_bs_md_mask mask;
-	uint64_t bdev_size_init;
-	uint64_t total_data_clusters, max_clusters;
 
-	/*
-	 * Further down the test the dev size will be larger than the g_dev_buffer size,
-	 * so we set clear_method to NONE, or the blobstore will try to clear the dev and
-	 * will write beyond the end of g_dev_buffer.
-	 */
 	dev = init_dev();
-	bdev_size_init = dev->blockcnt * dev->blocklen;
 	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.clear_method = BS_CLEAR_WITH_NONE;
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
+
+	/* Initialize a new blob store */
 	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
-	total_data_clusters = spdk_bs_total_data_cluster_count(bs);
-	CU_ASSERT(total_data_clusters == 63);
-
-	/*
-	 * The default dev size is 64M, here we set the dev size to 32M,
-	 * expecting EILSEQ due to super_block validation and no change in blobstore.
-	 */
-	dev->blockcnt = (32L * 1024L * 1024L) / dev->blocklen;
-	spdk_bs_grow_live(bs, bs_op_complete, NULL);
-	poll_threads();
-	/* This error code comes from bs_super_validate() */
-	CU_ASSERT(g_bserrno == -EILSEQ);
-	CU_ASSERT(total_data_clusters == spdk_bs_total_data_cluster_count(bs));
-	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
-	CU_ASSERT(super_block.size == bdev_size_init);
-
-	/*
-	 * Blobstore in this test has only space for single md_page for used_clusters,
-	 * which fits 1 bit per cluster minus the md header.
-	 *
-	 * Dev size is increased to exceed the reserved space for the used_cluster_mask
-	 * in the metadata, expecting ENOSPC and no change in blobstore.
-	 */
-	max_clusters = (spdk_bs_get_page_size(bs) - sizeof(struct spdk_bs_md_mask)) * 8;
-	max_clusters += 1;
-	dev->blockcnt = (max_clusters * spdk_bs_get_cluster_size(bs)) / dev->blocklen;
-	spdk_bs_grow_live(bs, bs_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == -ENOSPC);
-	CU_ASSERT(total_data_clusters == spdk_bs_total_data_cluster_count(bs));
-	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
-	CU_ASSERT(super_block.size == bdev_size_init);
 
-	/*
-	 * No change should have occurred for the duration of the test,
-	 * unload blobstore and check metadata.
-	 */
+	/* Unload the blob store */
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	g_bs = NULL;
+	g_blob = NULL;
+	g_blobid = 0;
 
-	/* Make sure all metadata is correct, super block and used_cluster mask. */
-	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
-	CU_ASSERT(super_block.size == bdev_size_init);
-	CU_ASSERT(super_block.clean == 1);
-	memcpy(&mask, g_dev_buffer + super_block.used_cluster_mask_start * 4096,
-	       sizeof(struct spdk_bs_md_mask));
-	CU_ASSERT(mask.type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
-	CU_ASSERT(mask.length == bdev_size_init / (1 * 1024 * 1024));
+	/* Load non existing blobstore type */
+	dev = init_dev();
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "NONEXISTING");
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno != 0);
 
-	/* Load blobstore and check the cluster counts again. */
+	/* Load with empty blobstore type */
 	dev = init_dev();
-	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
-	CU_ASSERT(total_data_clusters == spdk_bs_total_data_cluster_count(bs));
 
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	g_bs = NULL;
-}
-
-static void
-bs_test_grow(void)
-{
-	struct spdk_blob_store *bs;
-	struct spdk_bs_dev *dev;
-	struct spdk_bs_super_block super_block;
-	struct spdk_bs_opts opts;
-	struct spdk_bs_md_mask mask;
-	uint64_t bdev_size;
 
+	/* Initialize a new blob store with empty bstype */
 	dev = init_dev();
-	bdev_size = dev->blockcnt * dev->blocklen;
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
+	spdk_bs_init(dev, NULL, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
@@ -3256,388 +3598,331 @@ bs_test_grow(void)
 	CU_ASSERT(g_bserrno == 0);
 	g_bs = NULL;
 
-	/*
-	 * To make sure all the metadata are updated to the disk,
-	 * we check the g_dev_buffer after spdk_bs_unload.
-	 */
-	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
-	CU_ASSERT(super_block.size == bdev_size);
+	/* Load non existing blobstore type */
+	dev = init_dev();
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "NONEXISTING");
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno != 0);
 
-	/*
-	 * Make sure the used_cluster mask is correct.
-	 */
-	memcpy(&mask, g_dev_buffer + super_block.used_cluster_mask_start * 4096,
-	       sizeof(struct spdk_bs_md_mask));
-	CU_ASSERT(mask.type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
-	CU_ASSERT(mask.length == bdev_size / (1 * 1024 * 1024));
-
-	/*
-	 * The default dev size is 64M, here we set the dev size to 128M,
-	 * then the blobstore will adjust the metadata according to the new size.
-	 * The dev size is larger than the g_dev_buffer size, so we set clear_method
-	 * to NONE, or the blobstore will try to clear the dev and will write beyond
-	 * the end of g_dev_buffer.
-	 */
+	/* Load with empty blobstore type */
 	dev = init_dev();
-	dev->blockcnt = (128L * 1024L * 1024L) / dev->blocklen;
-	bdev_size = dev->blockcnt * dev->blocklen;
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.clear_method = BS_CLEAR_WITH_NONE;
-	spdk_bs_grow(dev, &opts, bs_op_with_handle_complete, NULL);
+	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
 
-	/*
-	 * After spdk_bs_grow, all metadata are updated to the disk.
-	 * So we can check g_dev_buffer now.
-	 */
-	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
-	CU_ASSERT(super_block.size == bdev_size);
-
-	/*
-	 * Make sure the used_cluster mask has been updated according to the bdev size
-	 */
-	memcpy(&mask, g_dev_buffer + super_block.used_cluster_mask_start * 4096,
-	       sizeof(struct spdk_bs_md_mask));
-	CU_ASSERT(mask.type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
-	CU_ASSERT(mask.length == bdev_size / (1 * 1024 * 1024));
-
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	g_bs = NULL;
 }
 
-/*
- * Create a blobstore and then unload it.
- */
-static void
-bs_unload(void)
-{
-	struct spdk_blob_store *bs = g_bs;
-	struct spdk_blob *blob;
-
-	/* Create a blob and open it. */
-	blob = ut_blob_create_and_open(bs, NULL);
-
-	/* Try to unload blobstore, should fail with open blob */
-	g_bserrno = -1;
-	spdk_bs_unload(bs, bs_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == -EBUSY);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-
-	/* Close the blob, then successfully unload blobstore */
-	g_bserrno = -1;
-	spdk_blob_close(blob, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-}
-
-/*
- * Create a blobstore with a cluster size different than the default, and ensure it is
- *  persisted.
- */
 static void
-bs_cluster_sz(void)
+bs_super_block(void)
 {
 	struct spdk_blob_store *bs;
 	struct spdk_bs_dev *dev;
+	struct spdk_bs_super_block *super_block;
 	struct spdk_bs_opts opts;
-	uint32_t cluster_sz;
+	struct spdk_bs_super_block_ver1 super_block_v1;
 
-	/* Set cluster size to zero */
 	dev = init_dev();
 	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.cluster_sz = 0;
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
 
 	/* Initialize a new blob store */
 	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == -EINVAL);
-	SPDK_CU_ASSERT_FATAL(g_bs == NULL);
-
-	/*
-	 * Set cluster size to blobstore page size,
-	 * to work it is required to be at least twice the blobstore page size.
-	 */
-	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.cluster_sz = SPDK_BS_PAGE_SIZE;
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
 
-	/* Initialize a new blob store */
-	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	/* Unload the blob store */
+	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == -ENOMEM);
-	SPDK_CU_ASSERT_FATAL(g_bs == NULL);
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+	g_blob = NULL;
+	g_blobid = 0;
 
-	/*
-	 * Set cluster size to lower than page size,
-	 * to work it is required to be at least twice the blobstore page size.
-	 */
-	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.cluster_sz = SPDK_BS_PAGE_SIZE - 1;
+	/* Load an existing blob store with version newer than supported */
+	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
+	super_block->version++;
 
-	/* Initialize a new blob store */
-	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	dev = init_dev();
+	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == -EINVAL);
-	SPDK_CU_ASSERT_FATAL(g_bs == NULL);
+	CU_ASSERT(g_bserrno != 0);
 
-	/* Set cluster size to twice the default */
+	/* Create a new blob store with super block version 1 */
 	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.cluster_sz *= 2;
-	cluster_sz = opts.cluster_sz;
+	super_block_v1.version = 1;
+	memcpy(super_block_v1.signature, "SPDKBLOB", sizeof(super_block_v1.signature));
+	super_block_v1.length = 0x1000;
+	super_block_v1.clean = 1;
+	super_block_v1.super_blob = 0xFFFFFFFFFFFFFFFF;
+	super_block_v1.cluster_size = 0x100000;
+	super_block_v1.used_page_mask_start = 0x01;
+	super_block_v1.used_page_mask_len = 0x01;
+	super_block_v1.used_cluster_mask_start = 0x02;
+	super_block_v1.used_cluster_mask_len = 0x01;
+	super_block_v1.md_start = 0x03;
+	super_block_v1.md_len = 0x40;
+	memset(super_block_v1.reserved, 0, 4036);
+	super_block_v1.crc = blob_md_page_calc_crc(&super_block_v1);
+	memcpy(g_dev_buffer, &super_block_v1, sizeof(struct spdk_bs_super_block_ver1));
 
-	/* Initialize a new blob store */
-	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
 
-	CU_ASSERT(spdk_bs_get_cluster_size(bs) == cluster_sz);
-
-	ut_bs_reload(&bs, &opts);
-
-	CU_ASSERT(spdk_bs_get_cluster_size(bs) == cluster_sz);
-
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	g_bs = NULL;
 }
 
-/*
- * Create a blobstore, reload it and ensure total usable cluster count
- *  stays the same.
- */
 static void
-bs_usable_clusters(void)
+bs_test_recover_cluster_count(void)
 {
-	struct spdk_blob_store *bs = g_bs;
-	struct spdk_blob *blob;
-	uint32_t clusters;
-	int i;
-
-
-	clusters = spdk_bs_total_data_cluster_count(bs);
-
-	ut_bs_reload(&bs, NULL);
-
-	CU_ASSERT(spdk_bs_total_data_cluster_count(bs) == clusters);
-
-	/* Create and resize blobs to make sure that usable cluster count won't change */
-	for (i = 0; i < 4; i++) {
-		g_bserrno = -1;
-		g_blobid = SPDK_BLOBID_INVALID;
-		blob = ut_blob_create_and_open(bs, NULL);
-
-		spdk_blob_resize(blob, 10, blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_super_block super_block;
+	struct spdk_bs_opts opts;
 
-		g_bserrno = -1;
-		spdk_blob_close(blob, blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
+	dev = init_dev();
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
 
-		CU_ASSERT(spdk_bs_total_data_cluster_count(bs) == clusters);
-	}
+	super_block.version = 3;
+	memcpy(super_block.signature, "SPDKBLOB", sizeof(super_block.signature));
+	super_block.length = 0x1000;
+	super_block.clean = 0;
+	super_block.super_blob = 0xFFFFFFFFFFFFFFFF;
+	super_block.cluster_size = 4096;
+	super_block.used_page_mask_start = 0x01;
+	super_block.used_page_mask_len = 0x01;
+	super_block.used_cluster_mask_start = 0x02;
+	super_block.used_cluster_mask_len = 0x01;
+	super_block.used_blobid_mask_start = 0x03;
+	super_block.used_blobid_mask_len = 0x01;
+	super_block.md_start = 0x04;
+	super_block.md_len = 0x40;
+	memset(super_block.bstype.bstype, 0, sizeof(super_block.bstype.bstype));
+	super_block.size = dev->blockcnt * dev->blocklen;
+	super_block.io_unit_size = 0x1000;
+	memset(super_block.reserved, 0, 4000);
+	super_block.crc = blob_md_page_calc_crc(&super_block);
+	memcpy(g_dev_buffer, &super_block, sizeof(struct spdk_bs_super_block));
 
-	/* Reload the blob store to make sure that nothing changed */
-	ut_bs_reload(&bs, NULL);
+	memset(opts.bstype.bstype, 0, sizeof(opts.bstype.bstype));
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+	CU_ASSERT(bs->num_free_clusters == bs->total_clusters - (super_block.md_start +
+			super_block.md_len));
 
-	CU_ASSERT(spdk_bs_total_data_cluster_count(bs) == clusters);
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
 }
 
-/*
- * Test resizing of the metadata blob.  This requires creating enough blobs
- *  so that one cluster is not enough to fit the metadata for those blobs.
- *  To induce this condition to happen more quickly, we reduce the cluster
- *  size to 16KB, which means only 4 4KB blob metadata pages can fit.
- */
 static void
-bs_resize_md(void)
+bs_grow_live_size(uint64_t new_blockcnt)
 {
 	struct spdk_blob_store *bs;
-	const int CLUSTER_PAGE_COUNT = 4;
-	const int NUM_BLOBS = CLUSTER_PAGE_COUNT * 4;
 	struct spdk_bs_dev *dev;
+	struct spdk_bs_super_block super_block;
 	struct spdk_bs_opts opts;
-	struct spdk_blob *blob;
-	struct spdk_blob_opts blob_opts;
-	uint32_t cluster_sz;
-	spdk_blob_id blobids[NUM_BLOBS];
-	int i;
-
+	struct spdk_bs_md_mask mask;
+	uint64_t bdev_size;
+	uint64_t total_data_clusters;
 
+	/*
+	 * Further down the test the dev size will be larger than the g_dev_buffer size,
+	 * so we set clear_method to NONE, or the blobstore will try to clear the dev and
+	 * will write beyond the end of g_dev_buffer.
+	 */
 	dev = init_dev();
 	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.cluster_sz = CLUSTER_PAGE_COUNT * 4096;
-	cluster_sz = opts.cluster_sz;
-
-	/* Initialize a new blob store */
+	opts.clear_method = BS_CLEAR_WITH_NONE;
 	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
+	CU_ASSERT(spdk_bs_total_data_cluster_count(bs) == 63);
 
-	CU_ASSERT(spdk_bs_get_cluster_size(bs) == cluster_sz);
-
-	ut_spdk_blob_opts_init(&blob_opts);
-
-	for (i = 0; i < NUM_BLOBS; i++) {
-		g_bserrno = -1;
-		g_blobid = SPDK_BLOBID_INVALID;
-		spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-		CU_ASSERT(g_blobid !=  SPDK_BLOBID_INVALID);
-		blobids[i] = g_blobid;
-	}
-
-	ut_bs_reload(&bs, &opts);
-
-	CU_ASSERT(spdk_bs_get_cluster_size(bs) == cluster_sz);
+	/*
+	 * Set the dev size according to the new_blockcnt,
+	 * then the blobstore will adjust the metadata according to the new size.
+	 */
+	dev->blockcnt = new_blockcnt;
+	bdev_size = dev->blockcnt * dev->blocklen;
+	spdk_bs_grow_live(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	total_data_clusters = spdk_bs_total_data_cluster_count(bs);
+	/* One cluster of 1MiB size is used for metadata */
+	CU_ASSERT(total_data_clusters == (bdev_size / (1 * 1024 * 1024)) - 1);
 
-	for (i = 0; i < NUM_BLOBS; i++) {
-		g_bserrno = -1;
-		g_blob = NULL;
-		spdk_bs_open_blob(bs, blobids[i], blob_op_with_handle_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-		CU_ASSERT(g_blob !=  NULL);
-		blob = g_blob;
-		g_bserrno = -1;
-		spdk_blob_close(blob, blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-	}
+	/* Make sure the super block is updated. */
+	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
+	CU_ASSERT(super_block.size == bdev_size);
+	CU_ASSERT(super_block.clean == 0);
+	/* The used_cluster mask is not written out until first spdk_bs_unload. */
+	memcpy(&mask, g_dev_buffer + super_block.used_cluster_mask_start * 4096,
+	       sizeof(struct spdk_bs_md_mask));
+	CU_ASSERT(mask.type == 0);
+	CU_ASSERT(mask.length == 0);
 
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	g_bs = NULL;
-}
 
-static void
-bs_destroy(void)
-{
-	struct spdk_blob_store *bs;
-	struct spdk_bs_dev *dev;
+	/* Make sure all metadata is correct, super block and used_cluster mask. */
+	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
+	CU_ASSERT(super_block.size == bdev_size);
+	CU_ASSERT(super_block.clean == 1);
+	memcpy(&mask, g_dev_buffer + super_block.used_cluster_mask_start * 4096,
+	       sizeof(struct spdk_bs_md_mask));
+	CU_ASSERT(mask.type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
+	CU_ASSERT(mask.length == bdev_size / (1 * 1024 * 1024));
 
-	/* Initialize a new blob store */
+	/* Load blobstore and check the cluster counts again. */
 	dev = init_dev();
-	spdk_bs_init(dev, NULL, bs_op_with_handle_complete, NULL);
+	dev->blockcnt = new_blockcnt;
+	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	CU_ASSERT(super_block.clean == 1);
 	bs = g_bs;
+	CU_ASSERT(total_data_clusters == spdk_bs_total_data_cluster_count(bs));
 
-	/* Destroy the blob store */
-	g_bserrno = -1;
-	spdk_bs_destroy(bs, bs_op_complete, NULL);
+	/* Perform grow without change in size, expected pass. */
+	spdk_bs_grow_live(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(total_data_clusters == spdk_bs_total_data_cluster_count(bs));
+	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
+	CU_ASSERT(super_block.size == bdev_size);
+	CU_ASSERT(super_block.clean == 1);
 
-	/* Loading an non-existent blob store should fail. */
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
 	g_bs = NULL;
-	dev = init_dev();
+}
 
-	g_bserrno = 0;
-	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno != 0);
+static void
+bs_grow_live(void)
+{
+	/* No change expected */
+	bs_grow_live_size(DEV_BUFFER_BLOCKCNT);
+
+	/* Size slightly increased, but not enough to increase cluster count */
+	bs_grow_live_size(DEV_BUFFER_BLOCKCNT + 1);
+
+	/* Size doubled, increasing the cluster count */
+	bs_grow_live_size(DEV_BUFFER_BLOCKCNT * 2);
 }
 
-/* Try to hit all of the corner cases associated with serializing
- * a blob to disk
- */
 static void
-blob_serialize_test(void)
+bs_grow_live_no_space(void)
 {
+	struct spdk_blob_store *bs;
 	struct spdk_bs_dev *dev;
+	struct spdk_bs_super_block super_block;
 	struct spdk_bs_opts opts;
-	struct spdk_blob_store *bs;
-	spdk_blob_id blobid[2];
-	struct spdk_blob *blob[2];
-	uint64_t i;
-	char *value;
-	int rc;
+	struct spdk_bs_md_mask mask;
+	uint64_t bdev_size_init;
+	uint64_t total_data_clusters, max_clusters;
 
+	/*
+	 * Further down the test the dev size will be larger than the g_dev_buffer size,
+	 * so we set clear_method to NONE, or the blobstore will try to clear the dev and
+	 * will write beyond the end of g_dev_buffer.
+	 */
 	dev = init_dev();
-
-	/* Initialize a new blobstore with very small clusters */
+	bdev_size_init = dev->blockcnt * dev->blocklen;
 	spdk_bs_opts_init(&opts, sizeof(opts));
-	opts.cluster_sz = dev->blocklen * 8;
+	opts.clear_method = BS_CLEAR_WITH_NONE;
 	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
+	total_data_clusters = spdk_bs_total_data_cluster_count(bs);
+	CU_ASSERT(total_data_clusters == 63);
 
-	/* Create and open two blobs */
-	for (i = 0; i < 2; i++) {
-		blob[i] = ut_blob_create_and_open(bs, NULL);
-		blobid[i] = spdk_blob_get_id(blob[i]);
-
-		/* Set a fairly large xattr on both blobs to eat up
-		 * metadata space
-		 */
-		value = calloc(dev->blocklen - 64, sizeof(char));
-		SPDK_CU_ASSERT_FATAL(value != NULL);
-		memset(value, i, dev->blocklen / 2);
-		rc = spdk_blob_set_xattr(blob[i], "name", value, dev->blocklen - 64);
-		CU_ASSERT(rc == 0);
-		free(value);
-	}
-
-	/* Resize the blobs, alternating 1 cluster at a time.
-	 * This thwarts run length encoding and will cause spill
-	 * over of the extents.
+	/*
+	 * The default dev size is 64M, here we set the dev size to 32M,
+	 * expecting EILSEQ due to super_block validation and no change in blobstore.
 	 */
-	for (i = 0; i < 6; i++) {
-		spdk_blob_resize(blob[i % 2], (i / 2) + 1, blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-	}
-
-	for (i = 0; i < 2; i++) {
-		spdk_blob_sync_md(blob[i], blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-	}
-
-	/* Close the blobs */
-	for (i = 0; i < 2; i++) {
-		spdk_blob_close(blob[i], blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-	}
-
-	ut_bs_reload(&bs, &opts);
+	dev->blockcnt = (32L * 1024L * 1024L) / dev->blocklen;
+	spdk_bs_grow_live(bs, bs_op_complete, NULL);
+	poll_threads();
+	/* This error code comes from bs_super_validate() */
+	CU_ASSERT(g_bserrno == -EILSEQ);
+	CU_ASSERT(total_data_clusters == spdk_bs_total_data_cluster_count(bs));
+	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
+	CU_ASSERT(super_block.size == bdev_size_init);
 
-	for (i = 0; i < 2; i++) {
-		blob[i] = NULL;
+	/*
+	 * Blobstore in this test has only space for single md_page for used_clusters,
+	 * which fits 1 bit per cluster minus the md header.
+	 *
+	 * Dev size is increased to exceed the reserved space for the used_cluster_mask
+	 * in the metadata, expecting ENOSPC and no change in blobstore.
+	 */
+	max_clusters = (spdk_bs_get_page_size(bs) - sizeof(struct spdk_bs_md_mask)) * 8;
+	max_clusters += 1;
+	dev->blockcnt = (max_clusters * spdk_bs_get_cluster_size(bs)) / dev->blocklen;
+	spdk_bs_grow_live(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -ENOSPC);
+	CU_ASSERT(total_data_clusters == spdk_bs_total_data_cluster_count(bs));
+	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
+	CU_ASSERT(super_block.size == bdev_size_init);
 
-		spdk_bs_open_blob(bs, blobid[i], blob_op_with_handle_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-		CU_ASSERT(g_blob != NULL);
-		blob[i] = g_blob;
+	/*
+	 * No change should have occurred for the duration of the test,
+	 * unload blobstore and check metadata.
+	 */
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
 
-		CU_ASSERT(spdk_blob_get_num_clusters(blob[i]) == 3);
+	/* Make sure all metadata is correct, super block and used_cluster mask. */
+	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
+	CU_ASSERT(super_block.size == bdev_size_init);
+	CU_ASSERT(super_block.clean == 1);
+	memcpy(&mask, g_dev_buffer + super_block.used_cluster_mask_start * 4096,
+	       sizeof(struct spdk_bs_md_mask));
+	CU_ASSERT(mask.type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
+	CU_ASSERT(mask.length == bdev_size_init / (1 * 1024 * 1024));
 
-		spdk_blob_close(blob[i], blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-	}
+	/* Load blobstore and check the cluster counts again. */
+	dev = init_dev();
+	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+	CU_ASSERT(total_data_clusters == spdk_bs_total_data_cluster_count(bs));
 
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
@@ -3646,767 +3931,1991 @@ blob_serialize_test(void)
 }
 
 static void
-blob_crc(void)
+bs_test_grow(void)
 {
-	struct spdk_blob_store *bs = g_bs;
-	struct spdk_blob *blob;
-	spdk_blob_id blobid;
-	uint32_t page_num;
-	int index;
-	struct spdk_blob_md_page *page;
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_super_block super_block;
+	struct spdk_bs_opts opts;
+	struct spdk_bs_md_mask mask;
+	uint64_t bdev_size;
 
-	blob = ut_blob_create_and_open(bs, NULL);
-	blobid = spdk_blob_get_id(blob);
+	dev = init_dev();
+	bdev_size = dev->blockcnt * dev->blocklen;
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
+	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
 
-	page_num = bs_blobid_to_page(blobid);
-	index = DEV_BUFFER_BLOCKLEN * (bs->md_start + page_num);
-	page = (struct spdk_blob_md_page *)&g_dev_buffer[index];
-	page->crc = 0;
-
-	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == -EINVAL);
-	CU_ASSERT(g_blob == NULL);
-	g_bserrno = 0;
-
-	spdk_bs_delete_blob(bs, blobid, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == -EINVAL);
-}
+	/*
+	 * To make sure all the metadata are updated to the disk,
+	 * we check the g_dev_buffer after spdk_bs_unload.
+	 */
+	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
+	CU_ASSERT(super_block.size == bdev_size);
 
-static void
-super_block_crc(void)
-{
-	struct spdk_blob_store *bs;
-	struct spdk_bs_dev *dev;
-	struct spdk_bs_super_block *super_block;
+	/*
+	 * Make sure the used_cluster mask is correct.
+	 */
+	memcpy(&mask, g_dev_buffer + super_block.used_cluster_mask_start * 4096,
+	       sizeof(struct spdk_bs_md_mask));
+	CU_ASSERT(mask.type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
+	CU_ASSERT(mask.length == bdev_size / (1 * 1024 * 1024));
 
+	/*
+	 * The default dev size is 64M, here we set the dev size to 128M,
+	 * then the blobstore will adjust the metadata according to the new size.
+	 * The dev size is larger than the g_dev_buffer size, so we set clear_method
+	 * to NONE, or the blobstore will try to clear the dev and will write beyond
+	 * the end of g_dev_buffer.
+	 */
 	dev = init_dev();
-	spdk_bs_init(dev, NULL, bs_op_with_handle_complete, NULL);
+	dev->blockcnt = (128L * 1024L * 1024L) / dev->blocklen;
+	bdev_size = dev->blockcnt * dev->blocklen;
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	opts.clear_method = BS_CLEAR_WITH_NONE;
+	spdk_bs_grow(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
 
+	/*
+	 * After spdk_bs_grow, all metadata are updated to the disk.
+	 * So we can check g_dev_buffer now.
+	 */
+	memcpy(&super_block, g_dev_buffer, sizeof(struct spdk_bs_super_block));
+	CU_ASSERT(super_block.size == bdev_size);
+
+	/*
+	 * Make sure the used_cluster mask has been updated according to the bdev size
+	 */
+	memcpy(&mask, g_dev_buffer + super_block.used_cluster_mask_start * 4096,
+	       sizeof(struct spdk_bs_md_mask));
+	CU_ASSERT(mask.type == SPDK_MD_MASK_TYPE_USED_CLUSTERS);
+	CU_ASSERT(mask.length == bdev_size / (1 * 1024 * 1024));
+
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	g_bs = NULL;
-
-	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
-	super_block->crc = 0;
-	dev = init_dev();
-
-	/* Load an existing blob store */
-	g_bserrno = 0;
-	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == -EILSEQ);
 }
 
-/* For blob dirty shutdown test case we do the following sub-test cases:
- * 1 Initialize new blob store and create 1 super blob with some xattrs, then we
- *   dirty shutdown and reload the blob store and verify the xattrs.
- * 2 Resize the blob from 10 clusters to 20 clusters and then dirty shutdown,
- *   reload the blob store and verify the clusters number.
- * 3 Create the second blob and then dirty shutdown, reload the blob store
- *   and verify the second blob.
- * 4 Delete the second blob and then dirty shutdown, reload the blob store
- *   and verify the second blob is invalid.
- * 5 Create the second blob again and also create the third blob, modify the
- *   md of second blob which makes the md invalid, and then dirty shutdown,
- *   reload the blob store verify the second blob, it should invalid and also
- *   verify the third blob, it should correct.
+/*
+ * Create a blobstore and then unload it.
  */
 static void
-blob_dirty_shutdown(void)
+bs_unload(void)
 {
-	int rc;
-	int index;
 	struct spdk_blob_store *bs = g_bs;
-	spdk_blob_id blobid1, blobid2, blobid3;
-	struct spdk_blob *blob = g_blob;
-	uint64_t length;
-	uint64_t free_clusters;
-	const void *value;
-	size_t value_len;
-	uint32_t page_num;
-	struct spdk_blob_md_page *page;
-	struct spdk_blob_opts blob_opts;
-
-	/* Create first blob */
-	blobid1 = spdk_blob_get_id(blob);
-
-	/* Set some xattrs */
-	rc = spdk_blob_set_xattr(blob, "name", "log.txt", strlen("log.txt") + 1);
-	CU_ASSERT(rc == 0);
-
-	length = 2345;
-	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
-	CU_ASSERT(rc == 0);
-
-	/* Put xattr that fits exactly single page.
-	 * This results in adding additional pages to MD.
-	 * First is flags and smaller xattr, second the large xattr,
-	 * third are just the extents.
-	 */
-	size_t xattr_length = 4072 - sizeof(struct spdk_blob_md_descriptor_xattr) -
-			      strlen("large_xattr");
-	char *xattr = calloc(xattr_length, sizeof(char));
-	SPDK_CU_ASSERT_FATAL(xattr != NULL);
-	rc = spdk_blob_set_xattr(blob, "large_xattr", xattr, xattr_length);
-	free(xattr);
-	SPDK_CU_ASSERT_FATAL(rc == 0);
+	struct spdk_blob *blob;
 
-	/* Resize the blob */
-	spdk_blob_resize(blob, 10, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
+	/* Create a blob and open it. */
+	blob = ut_blob_create_and_open(bs, NULL);
 
-	/* Set the blob as the super blob */
-	spdk_bs_set_super(bs, blobid1, blob_op_complete, NULL);
+	/* Try to unload blobstore, should fail with open blob */
+	g_bserrno = -1;
+	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-
-	free_clusters = spdk_bs_free_cluster_count(bs);
+	CU_ASSERT(g_bserrno == -EBUSY);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 
+	/* Close the blob, then successfully unload blobstore */
+	g_bserrno = -1;
 	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	blob = NULL;
-	g_blob = NULL;
-	g_blobid = SPDK_BLOBID_INVALID;
+}
 
-	ut_bs_dirty_load(&bs, NULL);
+/*
+ * Create a blobstore with a cluster size different than the default, and ensure it is
+ *  persisted.
+ */
+static void
+bs_cluster_sz(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_opts opts;
+	uint32_t cluster_sz;
 
-	/* Get the super blob */
-	spdk_bs_get_super(bs, blob_op_with_id_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(blobid1 == g_blobid);
+	/* Set cluster size to zero */
+	dev = init_dev();
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	opts.cluster_sz = 0;
 
-	spdk_bs_open_blob(bs, blobid1, blob_op_with_handle_complete, NULL);
+	/* Initialize a new blob store */
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blob != NULL);
-	blob = g_blob;
-
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(g_bserrno == -EINVAL);
+	SPDK_CU_ASSERT_FATAL(g_bs == NULL);
 
-	/* Get the xattrs */
-	value = NULL;
-	rc = spdk_blob_get_xattr_value(blob, "length", &value, &value_len);
-	CU_ASSERT(rc == 0);
-	SPDK_CU_ASSERT_FATAL(value != NULL);
-	CU_ASSERT(*(uint64_t *)value == length);
-	CU_ASSERT(value_len == 8);
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 10);
+	/*
+	 * Set cluster size to blobstore page size,
+	 * to work it is required to be at least twice the blobstore page size.
+	 */
+	dev = init_dev();
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	opts.cluster_sz = SPDK_BS_PAGE_SIZE;
 
-	/* Resize the blob */
-	spdk_blob_resize(blob, 20, blob_op_complete, NULL);
+	/* Initialize a new blob store */
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_bserrno == -ENOMEM);
+	SPDK_CU_ASSERT_FATAL(g_bs == NULL);
 
-	free_clusters = spdk_bs_free_cluster_count(bs);
+	/*
+	 * Set cluster size to lower than page size,
+	 * to work it is required to be at least twice the blobstore page size.
+	 */
+	dev = init_dev();
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	opts.cluster_sz = SPDK_BS_PAGE_SIZE - 1;
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
+	/* Initialize a new blob store */
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	blob = NULL;
-	g_blob = NULL;
-	g_blobid = SPDK_BLOBID_INVALID;
-
-	ut_bs_dirty_load(&bs, NULL);
+	CU_ASSERT(g_bserrno == -EINVAL);
+	SPDK_CU_ASSERT_FATAL(g_bs == NULL);
 
-	spdk_bs_open_blob(bs, blobid1, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blob != NULL);
-	blob = g_blob;
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 20);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	/* Set cluster size to twice the default */
+	dev = init_dev();
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	opts.cluster_sz *= 2;
+	cluster_sz = opts.cluster_sz;
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
+	/* Initialize a new blob store */
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	blob = NULL;
-	g_blob = NULL;
-	g_blobid = SPDK_BLOBID_INVALID;
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
 
-	/* Create second blob */
-	blob = ut_blob_create_and_open(bs, NULL);
-	blobid2 = spdk_blob_get_id(blob);
+	CU_ASSERT(spdk_bs_get_cluster_size(bs) == cluster_sz);
 
-	/* Set some xattrs */
-	rc = spdk_blob_set_xattr(blob, "name", "log1.txt", strlen("log1.txt") + 1);
-	CU_ASSERT(rc == 0);
+	ut_bs_reload(&bs, &opts);
 
-	length = 5432;
-	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
-	CU_ASSERT(rc == 0);
+	CU_ASSERT(spdk_bs_get_cluster_size(bs) == cluster_sz);
 
-	/* Resize the blob */
-	spdk_blob_resize(blob, 10, blob_op_complete, NULL);
+	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
+/*
+ * Create a blobstore, reload it and ensure total usable cluster count
+ *  stays the same.
+ */
+static void
+bs_usable_clusters(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	uint32_t clusters;
+	int i;
+
+
+	clusters = spdk_bs_total_data_cluster_count(bs);
+
+	ut_bs_reload(&bs, NULL);
+
+	CU_ASSERT(spdk_bs_total_data_cluster_count(bs) == clusters);
+
+	/* Create and resize blobs to make sure that usable cluster count won't change */
+	for (i = 0; i < 4; i++) {
+		g_bserrno = -1;
+		g_blobid = SPDK_BLOBID_INVALID;
+		blob = ut_blob_create_and_open(bs, NULL);
+
+		spdk_blob_resize(blob, 10, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+
+		g_bserrno = -1;
+		spdk_blob_close(blob, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+
+		CU_ASSERT(spdk_bs_total_data_cluster_count(bs) == clusters);
+	}
+
+	/* Reload the blob store to make sure that nothing changed */
+	ut_bs_reload(&bs, NULL);
+
+	CU_ASSERT(spdk_bs_total_data_cluster_count(bs) == clusters);
+}
+
+/*
+ * Test resizing of the metadata blob.  This requires creating enough blobs
+ *  so that one cluster is not enough to fit the metadata for those blobs.
+ *  To induce this condition to happen more quickly, we reduce the cluster
+ *  size to 16KB, which means only 4 4KB blob metadata pages can fit.
+ */
+static void
+bs_resize_md(void)
+{
+	struct spdk_blob_store *bs;
+	const int CLUSTER_PAGE_COUNT = 4;
+	const int NUM_BLOBS = CLUSTER_PAGE_COUNT * 4;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_opts opts;
+	struct spdk_blob *blob;
+	struct spdk_blob_opts blob_opts;
+	uint32_t cluster_sz;
+	spdk_blob_id blobids[NUM_BLOBS];
+	int i;
+
+
+	dev = init_dev();
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	opts.cluster_sz = CLUSTER_PAGE_COUNT * 4096;
+	cluster_sz = opts.cluster_sz;
+
+	/* Initialize a new blob store */
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	CU_ASSERT(spdk_bs_get_cluster_size(bs) == cluster_sz);
+
+	ut_spdk_blob_opts_init(&blob_opts);
+
+	for (i = 0; i < NUM_BLOBS; i++) {
+		g_bserrno = -1;
+		g_blobid = SPDK_BLOBID_INVALID;
+		spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(g_blobid !=  SPDK_BLOBID_INVALID);
+		blobids[i] = g_blobid;
+	}
+
+	ut_bs_reload(&bs, &opts);
+
+	CU_ASSERT(spdk_bs_get_cluster_size(bs) == cluster_sz);
+
+	for (i = 0; i < NUM_BLOBS; i++) {
+		g_bserrno = -1;
+		g_blob = NULL;
+		spdk_bs_open_blob(bs, blobids[i], blob_op_with_handle_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(g_blob !=  NULL);
+		blob = g_blob;
+		g_bserrno = -1;
+		spdk_blob_close(blob, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+	}
+
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
+static void
+bs_destroy(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+
+	/* Initialize a new blob store */
+	dev = init_dev();
+	spdk_bs_init(dev, NULL, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	/* Destroy the blob store */
+	g_bserrno = -1;
+	spdk_bs_destroy(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	/* Loading an non-existent blob store should fail. */
+	g_bs = NULL;
+	dev = init_dev();
+
+	g_bserrno = 0;
+	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno != 0);
+}
+
+/* Try to hit all of the corner cases associated with serializing
+ * a blob to disk
+ */
+static void
+blob_serialize_test(void)
+{
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_opts opts;
+	struct spdk_blob_store *bs;
+	spdk_blob_id blobid[2];
+	struct spdk_blob *blob[2];
+	uint64_t i;
+	char *value;
+	int rc;
+
+	dev = init_dev();
+
+	/* Initialize a new blobstore with very small clusters */
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	opts.cluster_sz = dev->blocklen * 8;
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	/* Create and open two blobs */
+	for (i = 0; i < 2; i++) {
+		blob[i] = ut_blob_create_and_open(bs, NULL);
+		blobid[i] = spdk_blob_get_id(blob[i]);
+
+		/* Set a fairly large xattr on both blobs to eat up
+		 * metadata space
+		 */
+		value = calloc(dev->blocklen - 64, sizeof(char));
+		SPDK_CU_ASSERT_FATAL(value != NULL);
+		memset(value, i, dev->blocklen / 2);
+		rc = spdk_blob_set_xattr(blob[i], "name", value, dev->blocklen - 64);
+		CU_ASSERT(rc == 0);
+		free(value);
+	}
+
+	/* Resize the blobs, alternating 1 cluster at a time.
+	 * This thwarts run length encoding and will cause spill
+	 * over of the extents.
+	 */
+	for (i = 0; i < 6; i++) {
+		spdk_blob_resize(blob[i % 2], (i / 2) + 1, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+	}
+
+	for (i = 0; i < 2; i++) {
+		spdk_blob_sync_md(blob[i], blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+	}
+
+	/* Close the blobs */
+	for (i = 0; i < 2; i++) {
+		spdk_blob_close(blob[i], blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+	}
+
+	ut_bs_reload(&bs, &opts);
+
+	for (i = 0; i < 2; i++) {
+		blob[i] = NULL;
+
+		spdk_bs_open_blob(bs, blobid[i], blob_op_with_handle_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(g_blob != NULL);
+		blob[i] = g_blob;
+
+		CU_ASSERT(spdk_blob_get_num_clusters(blob[i]) == 3);
+
+		spdk_blob_close(blob[i], blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+	}
+
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+}
+
+static void
+blob_crc(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	spdk_blob_id blobid;
+	uint32_t page_num;
+	int index;
+	struct spdk_blob_md_page *page;
+
+	blob = ut_blob_create_and_open(bs, NULL);
+	blobid = spdk_blob_get_id(blob);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	page_num = bs_blobid_to_page(blobid);
+	index = DEV_BUFFER_BLOCKLEN * (bs->md_start + page_num);
+	page = (struct spdk_blob_md_page *)&g_dev_buffer[index];
+	page->crc = 0;
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
+	CU_ASSERT(g_blob == NULL);
+	g_bserrno = 0;
+
+	spdk_bs_delete_blob(bs, blobid, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
+}
+
+static void
+super_block_crc(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_super_block *super_block;
+
+	dev = init_dev();
+	spdk_bs_init(dev, NULL, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+
+	super_block = (struct spdk_bs_super_block *)g_dev_buffer;
+	super_block->crc = 0;
+	dev = init_dev();
+
+	/* Load an existing blob store */
+	g_bserrno = 0;
+	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EILSEQ);
+}
+
+/* For blob dirty shutdown test case we do the following sub-test cases:
+ * 1 Initialize new blob store and create 1 super blob with some xattrs, then we
+ *   dirty shutdown and reload the blob store and verify the xattrs.
+ * 2 Resize the blob from 10 clusters to 20 clusters and then dirty shutdown,
+ *   reload the blob store and verify the clusters number.
+ * 3 Create the second blob and then dirty shutdown, reload the blob store
+ *   and verify the second blob.
+ * 4 Delete the second blob and then dirty shutdown, reload the blob store
+ *   and verify the second blob is invalid.
+ * 5 Create the second blob again and also create the third blob, modify the
+ *   md of second blob which makes the md invalid, and then dirty shutdown,
+ *   reload the blob store verify the second blob, it should invalid and also
+ *   verify the third blob, it should correct.
+ */
+static void
+blob_dirty_shutdown(void)
+{
+	int rc;
+	int index;
+	struct spdk_blob_store *bs = g_bs;
+	spdk_blob_id blobid1, blobid2, blobid3;
+	struct spdk_blob *blob = g_blob;
+	uint64_t length;
+	uint64_t free_clusters;
+	const void *value;
+	size_t value_len;
+	uint32_t page_num;
+	struct spdk_blob_md_page *page;
+	struct spdk_blob_opts blob_opts;
+
+	/* Create first blob */
+	blobid1 = spdk_blob_get_id(blob);
+
+	/* Set some xattrs */
+	rc = spdk_blob_set_xattr(blob, "name", "log.txt", strlen("log.txt") + 1);
+	CU_ASSERT(rc == 0);
+
+	length = 2345;
+	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
+	CU_ASSERT(rc == 0);
+
+	/* Put xattr that fits exactly single page.
+	 * This results in adding additional pages to MD.
+	 * First is flags and smaller xattr, second the large xattr,
+	 * third are just the extents.
+	 */
+	size_t xattr_length = 4072 - sizeof(struct spdk_blob_md_descriptor_xattr) -
+			      strlen("large_xattr");
+	char *xattr = calloc(xattr_length, sizeof(char));
+	SPDK_CU_ASSERT_FATAL(xattr != NULL);
+	rc = spdk_blob_set_xattr(blob, "large_xattr", xattr, xattr_length);
+	free(xattr);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+
+	/* Resize the blob */
+	spdk_blob_resize(blob, 10, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	/* Set the blob as the super blob */
+	spdk_bs_set_super(bs, blobid1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	free_clusters = spdk_bs_free_cluster_count(bs);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	blob = NULL;
+	g_blob = NULL;
+	g_blobid = SPDK_BLOBID_INVALID;
+
+	ut_bs_dirty_load(&bs, NULL);
+
+	/* Get the super blob */
+	spdk_bs_get_super(bs, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(blobid1 == g_blobid);
+
+	spdk_bs_open_blob(bs, blobid1, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blob != NULL);
+	blob = g_blob;
+
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	/* Get the xattrs */
+	value = NULL;
+	rc = spdk_blob_get_xattr_value(blob, "length", &value, &value_len);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(value != NULL);
+	CU_ASSERT(*(uint64_t *)value == length);
+	CU_ASSERT(value_len == 8);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 10);
+
+	/* Resize the blob */
+	spdk_blob_resize(blob, 20, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	free_clusters = spdk_bs_free_cluster_count(bs);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	blob = NULL;
+	g_blob = NULL;
+	g_blobid = SPDK_BLOBID_INVALID;
+
+	ut_bs_dirty_load(&bs, NULL);
+
+	spdk_bs_open_blob(bs, blobid1, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 20);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	blob = NULL;
+	g_blob = NULL;
+	g_blobid = SPDK_BLOBID_INVALID;
+
+	/* Create second blob */
+	blob = ut_blob_create_and_open(bs, NULL);
+	blobid2 = spdk_blob_get_id(blob);
+
+	/* Set some xattrs */
+	rc = spdk_blob_set_xattr(blob, "name", "log1.txt", strlen("log1.txt") + 1);
+	CU_ASSERT(rc == 0);
+
+	length = 5432;
+	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
+	CU_ASSERT(rc == 0);
+
+	/* Resize the blob */
+	spdk_blob_resize(blob, 10, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	free_clusters = spdk_bs_free_cluster_count(bs);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	blob = NULL;
+	g_blob = NULL;
+	g_blobid = SPDK_BLOBID_INVALID;
+
+	ut_bs_dirty_load(&bs, NULL);
+
+	spdk_bs_open_blob(bs, blobid2, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blob != NULL);
+	blob = g_blob;
+
+	/* Get the xattrs */
+	value = NULL;
+	rc = spdk_blob_get_xattr_value(blob, "length", &value, &value_len);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(value != NULL);
+	CU_ASSERT(*(uint64_t *)value == length);
+	CU_ASSERT(value_len == 8);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 10);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	ut_blob_close_and_delete(bs, blob);
+
+	free_clusters = spdk_bs_free_cluster_count(bs);
+
+	ut_bs_dirty_load(&bs, NULL);
+
+	spdk_bs_open_blob(bs, blobid2, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno != 0);
+	CU_ASSERT(g_blob == NULL);
+
+	spdk_bs_open_blob(bs, blobid1, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	ut_bs_reload(&bs, NULL);
+
+	/* Create second blob */
+	ut_spdk_blob_opts_init(&blob_opts);
+	spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	blobid2 = g_blobid;
+
+	/* Create third blob */
+	spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	blobid3 = g_blobid;
+
+	spdk_bs_open_blob(bs, blobid2, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blob != NULL);
+	blob = g_blob;
+
+	/* Set some xattrs for second blob */
+	rc = spdk_blob_set_xattr(blob, "name", "log1.txt", strlen("log1.txt") + 1);
+	CU_ASSERT(rc == 0);
+
+	length = 5432;
+	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
+	CU_ASSERT(rc == 0);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	blob = NULL;
+	g_blob = NULL;
+	g_blobid = SPDK_BLOBID_INVALID;
+
+	spdk_bs_open_blob(bs, blobid3, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blob != NULL);
+	blob = g_blob;
+
+	/* Set some xattrs for third blob */
+	rc = spdk_blob_set_xattr(blob, "name", "log2.txt", strlen("log2.txt") + 1);
+	CU_ASSERT(rc == 0);
+
+	length = 5432;
+	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
+	CU_ASSERT(rc == 0);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	blob = NULL;
+	g_blob = NULL;
+	g_blobid = SPDK_BLOBID_INVALID;
+
+	/* Mark second blob as invalid */
+	page_num = bs_blobid_to_page(blobid2);
+
+	index = DEV_BUFFER_BLOCKLEN * (bs->md_start + page_num);
+	page = (struct spdk_blob_md_page *)&g_dev_buffer[index];
+	page->sequence_num = 1;
+	page->crc = blob_md_page_calc_crc(page);
+
+	free_clusters = spdk_bs_free_cluster_count(bs);
+
+	ut_bs_dirty_load(&bs, NULL);
+
+	spdk_bs_open_blob(bs, blobid2, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno != 0);
+	CU_ASSERT(g_blob == NULL);
+
+	spdk_bs_open_blob(bs, blobid3, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blob != NULL);
+	blob = g_blob;
+
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+}
+
+static void
+blob_flags(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	spdk_blob_id blobid_invalid, blobid_data_ro, blobid_md_ro;
+	struct spdk_blob *blob_invalid, *blob_data_ro, *blob_md_ro;
+	struct spdk_blob_opts blob_opts;
+	int rc;
+
+	/* Create three blobs - one each for testing invalid, data_ro and md_ro flags. */
+	blob_invalid = ut_blob_create_and_open(bs, NULL);
+	blobid_invalid = spdk_blob_get_id(blob_invalid);
+
+	blob_data_ro = ut_blob_create_and_open(bs, NULL);
+	blobid_data_ro = spdk_blob_get_id(blob_data_ro);
+
+	ut_spdk_blob_opts_init(&blob_opts);
+	blob_opts.clear_method = BLOB_CLEAR_WITH_WRITE_ZEROES;
+	blob_md_ro = ut_blob_create_and_open(bs, &blob_opts);
+	blobid_md_ro = spdk_blob_get_id(blob_md_ro);
+	CU_ASSERT((blob_md_ro->md_ro_flags & SPDK_BLOB_MD_RO_FLAGS_MASK) == BLOB_CLEAR_WITH_WRITE_ZEROES);
+
+	/* Change the size of blob_data_ro to check if flags are serialized
+	 * when blob has non zero number of extents */
+	spdk_blob_resize(blob_data_ro, 10, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	/* Set the xattr to check if flags are serialized
+	 * when blob has non zero number of xattrs */
+	rc = spdk_blob_set_xattr(blob_md_ro, "name", "log.txt", strlen("log.txt") + 1);
+	CU_ASSERT(rc == 0);
+
+	blob_invalid->invalid_flags = (1ULL << 63);
+	blob_invalid->state = SPDK_BLOB_STATE_DIRTY;
+	blob_data_ro->data_ro_flags = (1ULL << 62);
+	blob_data_ro->state = SPDK_BLOB_STATE_DIRTY;
+	blob_md_ro->md_ro_flags = (1ULL << 61);
+	blob_md_ro->state = SPDK_BLOB_STATE_DIRTY;
+
+	g_bserrno = -1;
+	spdk_blob_sync_md(blob_invalid, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bserrno = -1;
+	spdk_blob_sync_md(blob_data_ro, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bserrno = -1;
+	spdk_blob_sync_md(blob_md_ro, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	g_bserrno = -1;
+	spdk_blob_close(blob_invalid, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	blob_invalid = NULL;
+	g_bserrno = -1;
+	spdk_blob_close(blob_data_ro, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	blob_data_ro = NULL;
+	g_bserrno = -1;
+	spdk_blob_close(blob_md_ro, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	blob_md_ro = NULL;
+
+	g_blob = NULL;
+	g_blobid = SPDK_BLOBID_INVALID;
+
+	ut_bs_reload(&bs, NULL);
+
+	g_blob = NULL;
+	g_bserrno = 0;
+	spdk_bs_open_blob(bs, blobid_invalid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno != 0);
+	CU_ASSERT(g_blob == NULL);
+
+	g_blob = NULL;
+	g_bserrno = -1;
+	spdk_bs_open_blob(bs, blobid_data_ro, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob_data_ro = g_blob;
+	/* If an unknown data_ro flag was found, the blob should be marked both data and md read-only. */
+	CU_ASSERT(blob_data_ro->data_ro == true);
+	CU_ASSERT(blob_data_ro->md_ro == true);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob_data_ro) == 10);
+
+	g_blob = NULL;
+	g_bserrno = -1;
+	spdk_bs_open_blob(bs, blobid_md_ro, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob_md_ro = g_blob;
+	CU_ASSERT(blob_md_ro->data_ro == false);
+	CU_ASSERT(blob_md_ro->md_ro == true);
+
+	g_bserrno = -1;
+	spdk_blob_sync_md(blob_md_ro, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	ut_blob_close_and_delete(bs, blob_data_ro);
+	ut_blob_close_and_delete(bs, blob_md_ro);
+}
+
+static void
+bs_version(void)
+{
+	struct spdk_bs_super_block *super;
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_blob *blob;
+	struct spdk_blob_opts blob_opts;
+	spdk_blob_id blobid;
+
+	/* Unload the blob store */
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+
+	/*
+	 * Change the bs version on disk.  This will allow us to
+	 *  test that the version does not get modified automatically
+	 *  when loading and unloading the blobstore.
+	 */
+	super = (struct spdk_bs_super_block *)&g_dev_buffer[0];
+	CU_ASSERT(super->version == SPDK_BS_VERSION);
+	CU_ASSERT(super->clean == 1);
+	super->version = 2;
+	/*
+	 * Version 2 metadata does not have a used blobid mask, so clear
+	 *  those fields in the super block and zero the corresponding
+	 *  region on "disk".  We will use this to ensure blob IDs are
+	 *  correctly reconstructed.
+	 */
+	memset(&g_dev_buffer[super->used_blobid_mask_start * SPDK_BS_PAGE_SIZE], 0,
+	       super->used_blobid_mask_len * SPDK_BS_PAGE_SIZE);
+	super->used_blobid_mask_start = 0;
+	super->used_blobid_mask_len = 0;
+	super->crc = blob_md_page_calc_crc(super);
+
+	/* Load an existing blob store */
+	dev = init_dev();
+	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	CU_ASSERT(super->clean == 1);
+	bs = g_bs;
+
+	/*
+	 * Create a blob - just to make sure that when we unload it
+	 *  results in writing the super block (since metadata pages
+	 *  were allocated.
+	 */
+	ut_spdk_blob_opts_init(&blob_opts);
+	spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	blobid = g_blobid;
+
+	/* Unload the blob store */
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+	CU_ASSERT(super->version == 2);
+	CU_ASSERT(super->used_blobid_mask_start == 0);
+	CU_ASSERT(super->used_blobid_mask_len == 0);
+
+	dev = init_dev();
+	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	g_blob = NULL;
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blob != NULL);
+	blob = g_blob;
+
+	ut_blob_close_and_delete(bs, blob);
+
+	CU_ASSERT(super->version == 2);
+	CU_ASSERT(super->used_blobid_mask_start == 0);
+	CU_ASSERT(super->used_blobid_mask_len == 0);
+}
+
+static void
+blob_set_xattrs_test(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	struct spdk_blob_opts opts;
+	const void *value;
+	size_t value_len;
+	char *xattr;
+	size_t xattr_length;
+	int rc;
+
+	/* Create blob with extra attributes */
+	ut_spdk_blob_opts_init(&opts);
+
+	opts.xattrs.names = g_xattr_names;
+	opts.xattrs.get_value = _get_xattr_value;
+	opts.xattrs.count = 3;
+	opts.xattrs.ctx = &g_ctx;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+
+	/* Get the xattrs */
+	value = NULL;
+
+	rc = spdk_blob_get_xattr_value(blob, g_xattr_names[0], &value, &value_len);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(value != NULL);
+	CU_ASSERT(value_len == strlen(g_xattr_values[0]));
+	CU_ASSERT_NSTRING_EQUAL_FATAL(value, g_xattr_values[0], value_len);
+
+	rc = spdk_blob_get_xattr_value(blob, g_xattr_names[1], &value, &value_len);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(value != NULL);
+	CU_ASSERT(value_len == strlen(g_xattr_values[1]));
+	CU_ASSERT_NSTRING_EQUAL((char *)value, g_xattr_values[1], value_len);
+
+	rc = spdk_blob_get_xattr_value(blob, g_xattr_names[2], &value, &value_len);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(value != NULL);
+	CU_ASSERT(value_len == strlen(g_xattr_values[2]));
+	CU_ASSERT_NSTRING_EQUAL((char *)value, g_xattr_values[2], value_len);
+
+	/* Try to get non existing attribute */
+
+	rc = spdk_blob_get_xattr_value(blob, "foobar", &value, &value_len);
+	CU_ASSERT(rc == -ENOENT);
+
+	/* Try xattr exceeding maximum length of descriptor in single page */
+	xattr_length = SPDK_BS_MAX_DESC_SIZE - sizeof(struct spdk_blob_md_descriptor_xattr) -
+		       strlen("large_xattr") + 1;
+	xattr = calloc(xattr_length, sizeof(char));
+	SPDK_CU_ASSERT_FATAL(xattr != NULL);
+	rc = spdk_blob_set_xattr(blob, "large_xattr", xattr, xattr_length);
+	free(xattr);
+	SPDK_CU_ASSERT_FATAL(rc == -ENOMEM);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	blob = NULL;
+	g_blob = NULL;
+	g_blobid = SPDK_BLOBID_INVALID;
+
+	/* NULL callback */
+	ut_spdk_blob_opts_init(&opts);
+	opts.xattrs.names = g_xattr_names;
+	opts.xattrs.get_value = NULL;
+	opts.xattrs.count = 1;
+	opts.xattrs.ctx = &g_ctx;
+
+	spdk_bs_create_blob_ext(bs, &opts, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+
+	/* NULL values */
+	ut_spdk_blob_opts_init(&opts);
+	opts.xattrs.names = g_xattr_names;
+	opts.xattrs.get_value = _get_xattr_value_null;
+	opts.xattrs.count = 1;
+	opts.xattrs.ctx = NULL;
+
+	spdk_bs_create_blob_ext(bs, &opts, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
+}
+
+static void
+blob_thin_prov_alloc(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	struct spdk_blob_opts opts;
+	spdk_blob_id blobid;
+	uint64_t free_clusters;
+
+	free_clusters = spdk_bs_free_cluster_count(bs);
+
+	/* Set blob as thin provisioned */
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+	blobid = spdk_blob_get_id(blob);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	CU_ASSERT(blob->active.num_clusters == 0);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 0);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+
+	/* The blob started at 0 clusters. Resize it to be 5, but still unallocated. */
+	spdk_blob_resize(blob, 5, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(blob->active.num_clusters == 5);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 5);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+
+	/* Grow it to 1TB - still unallocated */
+	spdk_blob_resize(blob, 262144, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(blob->active.num_clusters == 262144);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 262144);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	/* Sync must not change anything */
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(blob->active.num_clusters == 262144);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 262144);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+	/* Since clusters are not allocated,
+	 * number of metadata pages is expected to be minimal.
+	 */
+	CU_ASSERT(blob->active.num_pages == 1);
+
+	/* Shrink the blob to 3 clusters - still unallocated */
+	spdk_blob_resize(blob, 3, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(blob->active.num_clusters == 3);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 3);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	/* Sync must not change anything */
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(blob->active.num_clusters == 3);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 3);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	ut_bs_reload(&bs, NULL);
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+
+	/* Check that clusters allocation and size is still the same */
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(blob->active.num_clusters == 3);
+
+	ut_blob_close_and_delete(bs, blob);
+}
+
+static void
+blob_insert_cluster_msg_test(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	struct spdk_blob_opts opts;
+	spdk_blob_id blobid;
+	uint64_t free_clusters;
+	uint64_t new_cluster = 0;
+	uint32_t cluster_num = 3;
+	uint32_t extent_page = 0;
 
 	free_clusters = spdk_bs_free_cluster_count(bs);
 
+	/* Set blob as thin provisioned */
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 4;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+	blobid = spdk_blob_get_id(blob);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	CU_ASSERT(blob->active.num_clusters == 4);
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 4);
+	CU_ASSERT(blob->active.clusters[cluster_num] == 0);
+
+	/* Specify cluster_num to allocate and new_cluster will be returned to insert on md_thread.
+	 * This is to simulate behaviour when cluster is allocated after blob creation.
+	 * Such as _spdk_bs_allocate_and_copy_cluster(). */
+	spdk_spin_lock(&bs->used_lock);
+	bs_allocate_cluster(blob, cluster_num, &new_cluster, &extent_page, false);
+	CU_ASSERT(blob->active.clusters[cluster_num] == 0);
+	spdk_spin_unlock(&bs->used_lock);
+
+	blob_insert_cluster_on_md_thread(blob, cluster_num, new_cluster, extent_page, 0, 0,
+					 blob_op_complete, NULL);
+	poll_threads();
+
+	CU_ASSERT(blob->active.clusters[cluster_num] != 0);
+
 	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	blob = NULL;
-	g_blob = NULL;
-	g_blobid = SPDK_BLOBID_INVALID;
 
-	ut_bs_dirty_load(&bs, NULL);
+	ut_bs_reload(&bs, NULL);
 
-	spdk_bs_open_blob(bs, blobid2, blob_op_with_handle_complete, NULL);
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blob != NULL);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
 	blob = g_blob;
 
-	/* Get the xattrs */
-	value = NULL;
-	rc = spdk_blob_get_xattr_value(blob, "length", &value, &value_len);
-	CU_ASSERT(rc == 0);
-	SPDK_CU_ASSERT_FATAL(value != NULL);
-	CU_ASSERT(*(uint64_t *)value == length);
-	CU_ASSERT(value_len == 8);
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 10);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(blob->active.clusters[cluster_num] != 0);
 
 	ut_blob_close_and_delete(bs, blob);
+}
+
+static void
+blob_thin_prov_rw(void)
+{
+	static const uint8_t zero[10 * 4096] = { 0 };
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob, *blob_id0;
+	struct spdk_io_channel *channel, *channel_thread1;
+	struct spdk_blob_opts opts;
+	uint64_t free_clusters;
+	uint64_t page_size;
+	uint8_t payload_read[10 * 4096];
+	uint8_t payload_write[10 * 4096];
+	uint64_t write_bytes;
+	uint64_t write_zeroes_bytes;
+	uint64_t read_bytes;
 
 	free_clusters = spdk_bs_free_cluster_count(bs);
+	page_size = spdk_bs_get_page_size(bs);
 
-	ut_bs_dirty_load(&bs, NULL);
+	channel = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel != NULL);
 
-	spdk_bs_open_blob(bs, blobid2, blob_op_with_handle_complete, NULL);
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+
+	/* Create and delete blob at md page 0, so that next md page allocation
+	 * for extent will use that. */
+	blob_id0 = ut_blob_create_and_open(bs, &opts);
+	blob = ut_blob_create_and_open(bs, &opts);
+	ut_blob_close_and_delete(bs, blob_id0);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	CU_ASSERT(blob->active.num_clusters == 0);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+
+	/* The blob started at 0 clusters. Resize it to be 5, but still unallocated. */
+	spdk_blob_resize(blob, 5, blob_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno != 0);
-	CU_ASSERT(g_blob == NULL);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(blob->active.num_clusters == 5);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
 
-	spdk_bs_open_blob(bs, blobid1, blob_op_with_handle_complete, NULL);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blob != NULL);
-	blob = g_blob;
+	/* Sync must not change anything */
 	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(blob->active.num_clusters == 5);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+
+	/* Payload should be all zeros from unallocated clusters */
+	memset(payload_read, 0xFF, sizeof(payload_read));
+	spdk_blob_io_read(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(zero, payload_read, 10 * 4096) == 0);
 
-	ut_bs_reload(&bs, NULL);
+	write_bytes = g_dev_write_bytes;
+	write_zeroes_bytes = g_dev_write_zeroes_bytes;
+	read_bytes = g_dev_read_bytes;
 
-	/* Create second blob */
-	ut_spdk_blob_opts_init(&blob_opts);
-	spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
+	/* Perform write on thread 1. That will allocate cluster on thread 0 via send_msg */
+	set_thread(1);
+	channel_thread1 = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel_thread1 != NULL);
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	spdk_blob_io_write(blob, channel_thread1, payload_write, 4, 10, blob_op_complete, NULL);
+	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
+	/* Perform write on thread 0. That will try to allocate cluster,
+	 * but fail due to another thread issuing the cluster allocation first. */
+	set_thread(0);
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	spdk_blob_io_write(blob, channel, payload_write, 4, 10, blob_op_complete, NULL);
+	CU_ASSERT(free_clusters - 2 == spdk_bs_free_cluster_count(bs));
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
-	blobid2 = g_blobid;
+	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 1);
+	/* For thin-provisioned blob we need to write 20 pages plus one page metadata and
+	 * read 0 bytes */
+	if (g_use_extent_table) {
+		/* Add one more page for EXTENT_PAGE write */
+		CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) == page_size * 22);
+	} else {
+		CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) == page_size * 21);
+	}
+	CU_ASSERT(g_dev_read_bytes - read_bytes == 0);
 
-	/* Create third blob */
-	spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
+	spdk_blob_io_read(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
-	blobid3 = g_blobid;
+	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
 
-	spdk_bs_open_blob(bs, blobid2, blob_op_with_handle_complete, NULL);
+	ut_blob_close_and_delete(bs, blob);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	set_thread(1);
+	spdk_bs_free_io_channel(channel_thread1);
+	set_thread(0);
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
+	g_blob = NULL;
+	g_blobid = 0;
+}
+
+static void
+blob_thin_prov_write_count_io(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_blob *blob;
+	struct spdk_io_channel *ch;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_opts bs_opts;
+	struct spdk_blob_opts opts;
+	uint64_t free_clusters;
+	uint64_t page_size;
+	uint8_t payload_write[4096];
+	uint64_t write_bytes;
+	uint64_t write_zeroes_bytes;
+	uint64_t read_bytes;
+	const uint32_t CLUSTER_SZ = 16384;
+	uint32_t pages_per_cluster;
+	uint32_t pages_per_extent_page;
+	uint32_t i;
+
+	/* Use a very small cluster size for this test.  This ensures we need multiple
+	 * extent pages to hold all of the clusters even for relatively small blobs like
+	 * we are restricted to for the unit tests (i.e. we don't want to allocate multi-GB
+	 * buffers).
+	 */
+	dev = init_dev();
+	spdk_bs_opts_init(&bs_opts, sizeof(bs_opts));
+	bs_opts.cluster_sz = CLUSTER_SZ;
+
+	spdk_bs_init(dev, &bs_opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blob != NULL);
-	blob = g_blob;
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
 
-	/* Set some xattrs for second blob */
-	rc = spdk_blob_set_xattr(blob, "name", "log1.txt", strlen("log1.txt") + 1);
-	CU_ASSERT(rc == 0);
+	free_clusters = spdk_bs_free_cluster_count(bs);
+	page_size = spdk_bs_get_page_size(bs);
+	pages_per_cluster = CLUSTER_SZ / page_size;
+	pages_per_extent_page = SPDK_EXTENTS_PER_EP * pages_per_cluster;
 
-	length = 5432;
-	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
-	CU_ASSERT(rc == 0);
+	ch = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	/* Resize the blob so that it will require 8 extent pages to hold all of
+	 * the clusters.
+	 */
+	g_bserrno = -1;
+	spdk_blob_resize(blob, SPDK_EXTENTS_PER_EP * 8, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	blob = NULL;
-	g_blob = NULL;
-	g_blobid = SPDK_BLOBID_INVALID;
 
-	spdk_bs_open_blob(bs, blobid3, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blob != NULL);
-	blob = g_blob;
+	g_bserrno = -1;
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(blob->active.num_clusters == SPDK_EXTENTS_PER_EP * 8);
+
+	memset(payload_write, 0, sizeof(payload_write));
+	for (i = 0; i < 8; i++) {
+		write_bytes = g_dev_write_bytes;
+		write_zeroes_bytes = g_dev_write_zeroes_bytes;
+		read_bytes = g_dev_read_bytes;
+
+		g_bserrno = -1;
+		spdk_blob_io_write(blob, ch, payload_write, pages_per_extent_page * i, 1, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(free_clusters - (2 * i + 1) == spdk_bs_free_cluster_count(bs));
+
+		CU_ASSERT(g_dev_read_bytes == read_bytes);
+		if (!g_use_extent_table) {
+			/* For legacy metadata, we should have written two pages - one for the
+			 * write I/O itself, another for the blob's primary metadata.
+			 */
+			CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) / page_size == 2);
+		} else {
+			/* For extent table metadata, we should have written three pages - one
+			 * for the write I/O, one for the extent page, one for the blob's primary
+			 * metadata.
+			 */
+			CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) / page_size == 3);
+		}
+
+		/* The write should have synced the metadata already.  Do another sync here
+		 * just to confirm.
+		 */
+		write_bytes = g_dev_write_bytes;
+		write_zeroes_bytes = g_dev_write_zeroes_bytes;
+		read_bytes = g_dev_read_bytes;
 
-	/* Set some xattrs for third blob */
-	rc = spdk_blob_set_xattr(blob, "name", "log2.txt", strlen("log2.txt") + 1);
-	CU_ASSERT(rc == 0);
+		g_bserrno = -1;
+		spdk_blob_sync_md(blob, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(free_clusters - (2 * i + 1) == spdk_bs_free_cluster_count(bs));
+		CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 2 * i + 1);
 
-	length = 5432;
-	rc = spdk_blob_set_xattr(blob, "length", &length, sizeof(length));
-	CU_ASSERT(rc == 0);
+		CU_ASSERT(g_dev_read_bytes == read_bytes);
+		CU_ASSERT(g_dev_write_bytes == write_bytes);
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	blob = NULL;
-	g_blob = NULL;
-	g_blobid = SPDK_BLOBID_INVALID;
+		/* Now write to another unallocated cluster that is part of the same extent page. */
+		g_bserrno = -1;
+		spdk_blob_io_write(blob, ch, payload_write, pages_per_extent_page * i + pages_per_cluster,
+				   1, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(free_clusters - (2 * i + 2) == spdk_bs_free_cluster_count(bs));
+		CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 2 * i + 2);
 
-	/* Mark second blob as invalid */
-	page_num = bs_blobid_to_page(blobid2);
+		CU_ASSERT(g_dev_read_bytes == read_bytes);
+		/*
+		 * For legacy metadata, we should have written the I/O and the primary metadata page.
+		 * For extent table metadata, we should have written the I/O and the extent metadata page.
+		 */
+		CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) / page_size == 2);
 
-	index = DEV_BUFFER_BLOCKLEN * (bs->md_start + page_num);
-	page = (struct spdk_blob_md_page *)&g_dev_buffer[index];
-	page->sequence_num = 1;
-	page->crc = blob_md_page_calc_crc(page);
+		/* Send unmap aligned to the whole cluster - should free it up */
+		g_bserrno = -1;
+		spdk_blob_io_unmap(blob, ch, pages_per_extent_page * i, pages_per_cluster, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(free_clusters - (2 * i + 1) == spdk_bs_free_cluster_count(bs));
 
-	free_clusters = spdk_bs_free_cluster_count(bs);
+		/* Write back to the freed cluster */
+		g_bserrno = -1;
+		spdk_blob_io_write(blob, ch, payload_write, pages_per_extent_page * i, 1, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(free_clusters - (2 * i + 2) == spdk_bs_free_cluster_count(bs));
+	}
 
-	ut_bs_dirty_load(&bs, NULL);
+	ut_blob_close_and_delete(bs, blob);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
 
-	spdk_bs_open_blob(bs, blobid2, blob_op_with_handle_complete, NULL);
+	spdk_bs_free_io_channel(ch);
 	poll_threads();
-	CU_ASSERT(g_bserrno != 0);
-	CU_ASSERT(g_blob == NULL);
+	g_blob = NULL;
+	g_blobid = 0;
 
-	spdk_bs_open_blob(bs, blobid3, blob_op_with_handle_complete, NULL);
+	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blob != NULL);
-	blob = g_blob;
-
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	g_bs = NULL;
 }
 
 static void
-blob_flags(void)
+blob_thin_prov_write_batch_alloc(void)
 {
-	struct spdk_blob_store *bs = g_bs;
-	spdk_blob_id blobid_invalid, blobid_data_ro, blobid_md_ro;
-	struct spdk_blob *blob_invalid, *blob_data_ro, *blob_md_ro;
-	struct spdk_blob_opts blob_opts;
-	int rc;
-
-	/* Create three blobs - one each for testing invalid, data_ro and md_ro flags. */
-	blob_invalid = ut_blob_create_and_open(bs, NULL);
-	blobid_invalid = spdk_blob_get_id(blob_invalid);
-
-	blob_data_ro = ut_blob_create_and_open(bs, NULL);
-	blobid_data_ro = spdk_blob_get_id(blob_data_ro);
+	struct spdk_blob_store *bs;
+	struct spdk_blob *blob;
+	struct spdk_io_channel *ch;
+	struct spdk_bs_channel *bs_ch;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_opts bs_opts;
+	struct spdk_blob_opts opts;
+	uint64_t free_clusters;
+	uint64_t page_size;
+	uint8_t payload_write[4096];
+	uint64_t write_bytes;
+	uint64_t write_zeroes_bytes;
+	const uint32_t CLUSTER_SZ = 16384;
+	const uint32_t NUM_WRITES = 8;
+	uint32_t pages_per_cluster;
+	uint32_t i;
 
-	ut_spdk_blob_opts_init(&blob_opts);
-	blob_opts.clear_method = BLOB_CLEAR_WITH_WRITE_ZEROES;
-	blob_md_ro = ut_blob_create_and_open(bs, &blob_opts);
-	blobid_md_ro = spdk_blob_get_id(blob_md_ro);
-	CU_ASSERT((blob_md_ro->md_ro_flags & SPDK_BLOB_MD_RO_FLAGS_MASK) == BLOB_CLEAR_WITH_WRITE_ZEROES);
+	/* Use a small cluster size, so that the blobstore has enough free clusters
+	 * for the channel to reserve more than one at a time. */
+	dev = init_dev();
+	spdk_bs_opts_init(&bs_opts, sizeof(bs_opts));
+	bs_opts.cluster_sz = CLUSTER_SZ;
 
-	/* Change the size of blob_data_ro to check if flags are serialized
-	 * when blob has non zero number of extents */
-	spdk_blob_resize(blob_data_ro, 10, blob_op_complete, NULL);
+	spdk_bs_init(dev, &bs_opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
 
-	/* Set the xattr to check if flags are serialized
-	 * when blob has non zero number of xattrs */
-	rc = spdk_blob_set_xattr(blob_md_ro, "name", "log.txt", strlen("log.txt") + 1);
-	CU_ASSERT(rc == 0);
-
-	blob_invalid->invalid_flags = (1ULL << 63);
-	blob_invalid->state = SPDK_BLOB_STATE_DIRTY;
-	blob_data_ro->data_ro_flags = (1ULL << 62);
-	blob_data_ro->state = SPDK_BLOB_STATE_DIRTY;
-	blob_md_ro->md_ro_flags = (1ULL << 61);
-	blob_md_ro->state = SPDK_BLOB_STATE_DIRTY;
-
-	g_bserrno = -1;
-	spdk_blob_sync_md(blob_invalid, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	g_bserrno = -1;
-	spdk_blob_sync_md(blob_data_ro, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	g_bserrno = -1;
-	spdk_blob_sync_md(blob_md_ro, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
+	free_clusters = spdk_bs_free_cluster_count(bs);
+	page_size = spdk_bs_get_page_size(bs);
+	pages_per_cluster = CLUSTER_SZ / page_size;
 
-	g_bserrno = -1;
-	spdk_blob_close(blob_invalid, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	blob_invalid = NULL;
-	g_bserrno = -1;
-	spdk_blob_close(blob_data_ro, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	blob_data_ro = NULL;
-	g_bserrno = -1;
-	spdk_blob_close(blob_md_ro, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	blob_md_ro = NULL;
+	ch = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	bs_ch = spdk_io_channel_get_ctx(ch);
 
-	g_blob = NULL;
-	g_blobid = SPDK_BLOBID_INVALID;
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = SPDK_EXTENTS_PER_EP;
 
-	ut_bs_reload(&bs, NULL);
+	blob = ut_blob_create_and_open(bs, &opts);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
 
-	g_blob = NULL;
-	g_bserrno = 0;
-	spdk_bs_open_blob(bs, blobid_invalid, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno != 0);
-	CU_ASSERT(g_blob == NULL);
+	write_bytes = g_dev_write_bytes;
+	write_zeroes_bytes = g_dev_write_zeroes_bytes;
 
-	g_blob = NULL;
-	g_bserrno = -1;
-	spdk_bs_open_blob(bs, blobid_data_ro, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
-	blob_data_ro = g_blob;
-	/* If an unknown data_ro flag was found, the blob should be marked both data and md read-only. */
-	CU_ASSERT(blob_data_ro->data_ro == true);
-	CU_ASSERT(blob_data_ro->md_ro == true);
-	CU_ASSERT(spdk_blob_get_num_clusters(blob_data_ro) == 10);
+	/* Write to several unallocated clusters at once. All of the allocations
+	 * are in progress at the same time and are served from one reservation. */
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	for (i = 0; i < NUM_WRITES; i++) {
+		spdk_blob_io_write(blob, ch, payload_write, pages_per_cluster * i, 1, blob_op_complete, NULL);
+	}
+	CU_ASSERT(bs_ch->num_cluster_allocs == NUM_WRITES);
+	CU_ASSERT(bs_ch->num_reserved_clusters > 0);
+	CU_ASSERT(free_clusters - NUM_WRITES == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(bs->num_free_clusters < free_clusters - NUM_WRITES);
 
-	g_blob = NULL;
 	g_bserrno = -1;
-	spdk_bs_open_blob(bs, blobid_md_ro, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
-	blob_md_ro = g_blob;
-	CU_ASSERT(blob_md_ro->data_ro == false);
-	CU_ASSERT(blob_md_ro->md_ro == true);
+	CU_ASSERT(bs_ch->num_cluster_allocs == 0);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == NUM_WRITES);
+	CU_ASSERT(free_clusters - NUM_WRITES == spdk_bs_free_cluster_count(bs));
 
-	g_bserrno = -1;
-	spdk_blob_sync_md(blob_md_ro, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
+	/* Clusters taken from the reservation are allocated in ascending order */
+	for (i = 1; i < NUM_WRITES; i++) {
+		CU_ASSERT(blob->active.clusters[i] == blob->active.clusters[i - 1] + bs_cluster_to_lba(bs, 1));
+	}
 
-	ut_blob_close_and_delete(bs, blob_data_ro);
-	ut_blob_close_and_delete(bs, blob_md_ro);
-}
+	/* All of the cluster insertions were committed together. */
+	if (!g_use_extent_table) {
+		/* One page for each write I/O and a single primary metadata page. */
+		CU_ASSERT(((g_dev_write_bytes - write_bytes) - (g_dev_write_zeroes_bytes - write_zeroes_bytes)) /
+			  page_size == NUM_WRITES + 1);
+	} else {
+		/* One page for each write I/O, a single extent page and a single primary
+		 * metadata page. */
+		CU_ASSERT(((g_dev_write_bytes - write_bytes) - (g_dev_write_zeroes_bytes - write_zeroes_bytes)) /
+			  page_size == NUM_WRITES + 2);
+	}
 
-static void
-bs_version(void)
-{
-	struct spdk_bs_super_block *super;
-	struct spdk_blob_store *bs = g_bs;
-	struct spdk_bs_dev *dev;
-	struct spdk_blob *blob;
-	struct spdk_blob_opts blob_opts;
-	spdk_blob_id blobid;
+	ut_blob_close_and_delete(bs, blob);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
 
-	/* Unload the blob store */
+	/* Unload while the channel still holds reserved clusters. They must be
+	 * returned before the used cluster mask is written. */
+	CU_ASSERT(bs_ch->num_reserved_clusters > 0);
+	g_bserrno = -1;
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
+	CU_ASSERT(bs_ch->num_reserved_clusters == 0);
+	spdk_bs_free_io_channel(ch);
+	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	g_bs = NULL;
+	g_blob = NULL;
+	g_blobid = 0;
 
-	/*
-	 * Change the bs version on disk.  This will allow us to
-	 *  test that the version does not get modified automatically
-	 *  when loading and unloading the blobstore.
-	 */
-	super = (struct spdk_bs_super_block *)&g_dev_buffer[0];
-	CU_ASSERT(super->version == SPDK_BS_VERSION);
-	CU_ASSERT(super->clean == 1);
-	super->version = 2;
-	/*
-	 * Version 2 metadata does not have a used blobid mask, so clear
-	 *  those fields in the super block and zero the corresponding
-	 *  region on "disk".  We will use this to ensure blob IDs are
-	 *  correctly reconstructed.
-	 */
-	memset(&g_dev_buffer[super->used_blobid_mask_start * SPDK_BS_PAGE_SIZE], 0,
-	       super->used_blobid_mask_len * SPDK_BS_PAGE_SIZE);
-	super->used_blobid_mask_start = 0;
-	super->used_blobid_mask_len = 0;
-	super->crc = blob_md_page_calc_crc(super);
-
-	/* Load an existing blob store */
 	dev = init_dev();
-	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	spdk_bs_load(dev, &bs_opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	CU_ASSERT(super->clean == 1);
 	bs = g_bs;
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(free_clusters == bs->num_free_clusters);
 
-	/*
-	 * Create a blob - just to make sure that when we unload it
-	 *  results in writing the super block (since metadata pages
-	 *  were allocated.
-	 */
-	ut_spdk_blob_opts_init(&blob_opts);
-	spdk_bs_create_blob_ext(bs, &blob_opts, blob_op_with_id_complete, NULL);
+	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
-	blobid = g_blobid;
+	g_bs = NULL;
+}
 
-	/* Unload the blob store */
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+static void
+ut_reserve_clusters(struct spdk_blob *blob, struct spdk_io_channel *ch, uint64_t offset)
+{
+	struct spdk_bs_channel *bs_ch = spdk_io_channel_get_ctx(ch);
+	uint8_t payload_write[4096];
+
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	spdk_blob_io_write(blob, ch, payload_write, offset, 1, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	g_bs = NULL;
-	CU_ASSERT(super->version == 2);
-	CU_ASSERT(super->used_blobid_mask_start == 0);
-	CU_ASSERT(super->used_blobid_mask_len == 0);
+	CU_ASSERT(bs_ch->num_reserved_clusters > 0);
+}
+
+static void
+blob_thin_prov_reserved_enospc(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_blob *blob, *thin;
+	struct spdk_io_channel *ch;
+	struct spdk_bs_channel *bs_ch;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_opts bs_opts;
+	struct spdk_blob_opts opts;
+	uint64_t free_clusters;
+	const uint32_t CLUSTER_SZ = 16384;
 
 	dev = init_dev();
-	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	spdk_bs_opts_init(&bs_opts, sizeof(bs_opts));
+	bs_opts.cluster_sz = CLUSTER_SZ;
+
+	spdk_bs_init(dev, &bs_opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
+	free_clusters = spdk_bs_free_cluster_count(bs);
 
-	g_blob = NULL;
-	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	ch = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	bs_ch = spdk_io_channel_get_ctx(ch);
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = free_clusters;
+	thin = ut_blob_create_and_open(bs, &opts);
+
+	/* The clusters reserved by the channel are reported as free, so a thick blob using
+	 * all of them can be created */
+	ut_reserve_clusters(thin, ch, 0);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 1);
+	CU_ASSERT(bs->num_free_clusters < free_clusters - 1);
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.num_clusters = free_clusters - 1;
+	blob = ut_blob_create_and_open(bs, &opts);
+	CU_ASSERT(bs_ch->num_reserved_clusters == 0);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == 0);
+
+	/* Same for a resize */
+	spdk_blob_resize(blob, 0, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(g_blob != NULL);
-	blob = g_blob;
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	ut_reserve_clusters(thin, ch, CLUSTER_SZ / spdk_bs_get_io_unit_size(bs));
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 2);
+
+	spdk_blob_resize(blob, free_clusters - 2, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(bs_ch->num_reserved_clusters == 0);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == 0);
 
+	/* And for an inflate */
 	ut_blob_close_and_delete(bs, blob);
+	ut_reserve_clusters(thin, ch, 2 * CLUSTER_SZ / spdk_bs_get_io_unit_size(bs));
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 3);
 
-	CU_ASSERT(super->version == 2);
-	CU_ASSERT(super->used_blobid_mask_start == 0);
-	CU_ASSERT(super->used_blobid_mask_len == 0);
+	spdk_bs_inflate_blob(bs, ch, spdk_blob_get_id(thin), blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(thin) == free_clusters);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == 0);
+
+	/* Without enough clusters even counting the reserves, these still fail */
+	ut_spdk_blob_opts_init(&opts);
+	opts.num_clusters = 1;
+	spdk_bs_create_blob_ext(bs, &opts, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -ENOSPC);
+
+	ut_blob_close_and_delete(bs, thin);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
+
+	spdk_bs_free_io_channel(ch);
+	poll_threads();
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+	g_blob = NULL;
+	g_blobid = 0;
 }
 
 static void
-blob_set_xattrs_test(void)
+blob_thin_prov_unmap_cluster(void)
 {
-	struct spdk_blob_store *bs = g_bs;
-	struct spdk_blob *blob;
+	struct spdk_blob_store *bs;
+	struct spdk_blob *blob, *snapshot;
+	struct spdk_io_channel *ch;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_opts bs_opts;
 	struct spdk_blob_opts opts;
-	const void *value;
-	size_t value_len;
-	char *xattr;
-	size_t xattr_length;
-	int rc;
+	uint64_t free_clusters;
+	uint64_t page_size;
+	uint8_t payload_write[4096];
+	uint8_t payload_read[4096];
+	const uint32_t CLUSTER_COUNT = 3;
+	uint32_t pages_per_cluster;
+	spdk_blob_id blobid, snapshotid;
+	uint32_t i;
+	int err;
 
-	/* Create blob with extra attributes */
-	ut_spdk_blob_opts_init(&opts);
+	/* Use a very large cluster size for this test. Check how the unmap/release cluster code path behaves when
+	 * clusters are fully used.
+	 */
+	dev = init_dev();
+	spdk_bs_opts_init(&bs_opts, sizeof(bs_opts));
+	bs_opts.cluster_sz = dev->blocklen * dev->blockcnt / (CLUSTER_COUNT + 1);
 
-	opts.xattrs.names = g_xattr_names;
-	opts.xattrs.get_value = _get_xattr_value;
-	opts.xattrs.count = 3;
-	opts.xattrs.ctx = &g_ctx;
+	spdk_bs_init(dev, &bs_opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
 
-	blob = ut_blob_create_and_open(bs, &opts);
+	free_clusters = spdk_bs_free_cluster_count(bs);
+	page_size = spdk_bs_get_page_size(bs);
+	pages_per_cluster = bs_opts.cluster_sz / page_size;
 
-	/* Get the xattrs */
-	value = NULL;
+	ch = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
 
-	rc = spdk_blob_get_xattr_value(blob, g_xattr_names[0], &value, &value_len);
-	CU_ASSERT(rc == 0);
-	SPDK_CU_ASSERT_FATAL(value != NULL);
-	CU_ASSERT(value_len == strlen(g_xattr_values[0]));
-	CU_ASSERT_NSTRING_EQUAL_FATAL(value, g_xattr_values[0], value_len);
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
 
-	rc = spdk_blob_get_xattr_value(blob, g_xattr_names[1], &value, &value_len);
-	CU_ASSERT(rc == 0);
-	SPDK_CU_ASSERT_FATAL(value != NULL);
-	CU_ASSERT(value_len == strlen(g_xattr_values[1]));
-	CU_ASSERT_NSTRING_EQUAL((char *)value, g_xattr_values[1], value_len);
+	blob = ut_blob_create_and_open(bs, &opts);
+	CU_ASSERT(free_clusters == CLUSTER_COUNT);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	blobid = spdk_blob_get_id(blob);
 
-	rc = spdk_blob_get_xattr_value(blob, g_xattr_names[2], &value, &value_len);
-	CU_ASSERT(rc == 0);
-	SPDK_CU_ASSERT_FATAL(value != NULL);
-	CU_ASSERT(value_len == strlen(g_xattr_values[2]));
-	CU_ASSERT_NSTRING_EQUAL((char *)value, g_xattr_values[2], value_len);
+	g_bserrno = -1;
+	spdk_blob_resize(blob, CLUSTER_COUNT, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
 
-	/* Try to get non existing attribute */
+	g_bserrno = -1;
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(blob->active.num_clusters == CLUSTER_COUNT);
 
-	rc = spdk_blob_get_xattr_value(blob, "foobar", &value, &value_len);
-	CU_ASSERT(rc == -ENOENT);
+	/* Fill all clusters */
+	for (i = 0; i < CLUSTER_COUNT; i++) {
+		memset(payload_write, i + 1, sizeof(payload_write));
+		g_bserrno = -1;
+		spdk_blob_io_write(blob, ch, payload_write, pages_per_cluster * i, 1, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(free_clusters - (i + 1) == spdk_bs_free_cluster_count(bs));
+	}
+	CU_ASSERT(0 == spdk_bs_free_cluster_count(bs));
 
-	/* Try xattr exceeding maximum length of descriptor in single page */
-	xattr_length = SPDK_BS_MAX_DESC_SIZE - sizeof(struct spdk_blob_md_descriptor_xattr) -
-		       strlen("large_xattr") + 1;
-	xattr = calloc(xattr_length, sizeof(char));
-	SPDK_CU_ASSERT_FATAL(xattr != NULL);
-	rc = spdk_blob_set_xattr(blob, "large_xattr", xattr, xattr_length);
-	free(xattr);
-	SPDK_CU_ASSERT_FATAL(rc == -ENOMEM);
+	/* Unmap one whole cluster */
+	g_bserrno = -1;
+	spdk_blob_io_unmap(blob, ch, pages_per_cluster, pages_per_cluster, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(1 == spdk_bs_free_cluster_count(bs));
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
+	/* Verify the data read from the cluster is zeroed out */
+	memset(payload_write, 0, sizeof(payload_write));
+	spdk_blob_io_read(blob, ch, payload_read, pages_per_cluster, 1, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	blob = NULL;
-	g_blob = NULL;
-	g_blobid = SPDK_BLOBID_INVALID;
+	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
 
-	/* NULL callback */
-	ut_spdk_blob_opts_init(&opts);
-	opts.xattrs.names = g_xattr_names;
-	opts.xattrs.get_value = NULL;
-	opts.xattrs.count = 1;
-	opts.xattrs.ctx = &g_ctx;
+	/* Fill the same cluster with data */
+	memset(payload_write, 3, sizeof(payload_write));
+	g_bserrno = -1;
+	spdk_blob_io_write(blob, ch, payload_write, pages_per_cluster, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(0 == spdk_bs_free_cluster_count(bs));
 
-	spdk_bs_create_blob_ext(bs, &opts, blob_op_with_id_complete, NULL);
+	/* Verify the data read from the cluster has the expected data */
+	spdk_blob_io_read(blob, ch, payload_read, pages_per_cluster, 1, blob_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == -EINVAL);
-	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
 
-	/* NULL values */
-	ut_spdk_blob_opts_init(&opts);
-	opts.xattrs.names = g_xattr_names;
-	opts.xattrs.get_value = _get_xattr_value_null;
-	opts.xattrs.count = 1;
-	opts.xattrs.ctx = NULL;
+	/* Send an unaligned unmap that ecompasses one whole cluster */
+	g_bserrno = -1;
+	spdk_blob_io_unmap(blob, ch, pages_per_cluster - 1, pages_per_cluster + 2, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(1 == spdk_bs_free_cluster_count(bs));
 
-	spdk_bs_create_blob_ext(bs, &opts, blob_op_with_id_complete, NULL);
+	/* Verify the data read from the cluster is zeroed out */
+	g_bserrno = -1;
+	memset(payload_write, 0, sizeof(payload_write));
+	spdk_blob_io_read(blob, ch, payload_read, pages_per_cluster, 1, blob_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == -EINVAL);
-}
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
 
-static void
-blob_thin_prov_alloc(void)
-{
-	struct spdk_blob_store *bs = g_bs;
-	struct spdk_blob *blob;
-	struct spdk_blob_opts opts;
-	spdk_blob_id blobid;
-	uint64_t free_clusters;
+	/* Send a simultaneous unmap with a write to an unallocated area -
+	 * check that writes don't claim the currently unmapped cluster */
+	g_bserrno = -1;
+	memset(payload_write, 7, sizeof(payload_write));
+	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, NULL);
+	spdk_blob_io_write(blob, ch, payload_write, pages_per_cluster, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(1 == spdk_bs_free_cluster_count(bs));
 
-	free_clusters = spdk_bs_free_cluster_count(bs);
+	/* Verify the contents of written sector */
+	g_bserrno = -1;
+	spdk_blob_io_read(blob, ch, payload_read, pages_per_cluster, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
 
-	/* Set blob as thin provisioned */
-	ut_spdk_blob_opts_init(&opts);
-	opts.thin_provision = true;
+	/* Verify the contents of unmapped sector */
+	g_bserrno = -1;
+	memset(payload_write, 0, sizeof(payload_write));
+	spdk_blob_io_read(blob, ch, payload_read, 0, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
 
-	blob = ut_blob_create_and_open(bs, &opts);
-	blobid = spdk_blob_get_id(blob);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	/* Make sure clusters are not freed until the unmap to the drive is done */
+	g_bserrno = -1;
+	memset(payload_write, 7, sizeof(payload_write));
+	spdk_blob_io_write(blob, ch, payload_write, 0, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(0 == spdk_bs_free_cluster_count(bs));
 
-	CU_ASSERT(blob->active.num_clusters == 0);
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 0);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+	g_bserrno = -1;
+	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, NULL);
+	while (memcmp(payload_write, &g_dev_buffer[4096 * pages_per_cluster], 4096) == 0) {
+		CU_ASSERT(0 == spdk_bs_free_cluster_count(bs));
+		poll_thread_times(0, 1);
+	}
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(1 == spdk_bs_free_cluster_count(bs));
 
-	/* The blob started at 0 clusters. Resize it to be 5, but still unallocated. */
-	spdk_blob_resize(blob, 5, blob_op_complete, NULL);
+	/* Issue #3358 had a bug with concurrent trims to the same cluster causing an assert, check for regressions.
+	 * Send three concurrent unmaps to the same cluster.
+	 */
+	g_bserrno = -1;
+	memset(payload_write, 7, sizeof(payload_write));
+	spdk_blob_io_write(blob, ch, payload_write, 0, 1, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	CU_ASSERT(blob->active.num_clusters == 5);
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 5);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+	CU_ASSERT(0 == spdk_bs_free_cluster_count(bs));
 
-	/* Grow it to 1TB - still unallocated */
-	spdk_blob_resize(blob, 262144, blob_op_complete, NULL);
+	g_bserrno = -1;
+	err = -1;
+	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, NULL);
+	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, NULL);
+	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, &err);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	CU_ASSERT(blob->active.num_clusters == 262144);
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 262144);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+	CU_ASSERT(err == 0);
+	CU_ASSERT(1 == spdk_bs_free_cluster_count(bs));
 
+	/* Test thin-provisioned blob that is backed */
+	spdk_blob_resize(blob, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
 	spdk_blob_sync_md(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	/* Sync must not change anything */
 	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	CU_ASSERT(blob->active.num_clusters == 262144);
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 262144);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
-	/* Since clusters are not allocated,
-	 * number of metadata pages is expected to be minimal.
-	 */
-	CU_ASSERT(blob->active.num_pages == 1);
 
-	/* Shrink the blob to 3 clusters - still unallocated */
-	spdk_blob_resize(blob, 3, blob_op_complete, NULL);
+	g_bserrno = -1;
+	memset(payload_write, 1, sizeof(payload_write));
+	spdk_blob_io_write(blob, ch, payload_write, 0, 1, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	CU_ASSERT(blob->active.num_clusters == 3);
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 3);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
 
-	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	/* Create a snapshot */
+	CU_ASSERT_EQUAL(_get_snapshots_count(bs), 0);
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	/* Sync must not change anything */
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	CU_ASSERT(blob->active.num_clusters == 3);
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 3);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	CU_ASSERT_EQUAL(_get_snapshots_count(bs), 1);
+	snapshotid = g_blobid;
+	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
 
-	spdk_blob_close(blob, blob_op_complete, NULL);
+	/* Write data to blob, it will alloc new cluster */
+	g_bserrno = -1;
+	memset(payload_write, 2, sizeof(payload_write));
+	spdk_blob_io_write(blob, ch, payload_write, 0, 1, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters - 2 == spdk_bs_free_cluster_count(bs));
 
-	ut_bs_reload(&bs, NULL);
+	/* Unmap one whole cluster, but do not release this cluster */
+	g_bserrno = -1;
+	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters - 2 == spdk_bs_free_cluster_count(bs));
 
-	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	/* Verify the data read from the cluster is zeroed out */
+	g_bserrno = -1;
+	memset(payload_write, 0, sizeof(payload_write));
+	spdk_blob_io_read(blob, ch, payload_read, 0, 1, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
-	blob = g_blob;
+	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
 
-	/* Check that clusters allocation and size is still the same */
+	ut_blob_close_and_delete(bs, blob);
+	ut_blob_close_and_delete(bs, snapshot);
 	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	CU_ASSERT(blob->active.num_clusters == 3);
 
-	ut_blob_close_and_delete(bs, blob);
+	spdk_bs_free_io_channel(ch);
+	poll_threads();
+	g_blob = NULL;
+	g_blobid = 0;
+
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
 }
 
 static void
-blob_insert_cluster_msg_test(void)
+blob_thin_prov_rle(void)
 {
+	static const uint8_t zero[10 * 4096] = { 0 };
 	struct spdk_blob_store *bs = g_bs;
 	struct spdk_blob *blob;
+	struct spdk_io_channel *channel;
 	struct spdk_blob_opts opts;
-	struct spdk_blob_md_page page = {};
 	spdk_blob_id blobid;
 	uint64_t free_clusters;
-	uint64_t new_cluster = 0;
-	uint32_t cluster_num = 3;
-	uint32_t extent_page = 0;
+	uint64_t page_size;
+	uint8_t payload_read[10 * 4096];
+	uint8_t payload_write[10 * 4096];
+	uint64_t write_bytes;
+	uint64_t write_zeroes_bytes;
+	uint64_t read_bytes;
+	uint64_t io_unit;
 
 	free_clusters = spdk_bs_free_cluster_count(bs);
+	page_size = spdk_bs_get_page_size(bs);
 
-	/* Set blob as thin provisioned */
 	ut_spdk_blob_opts_init(&opts);
 	opts.thin_provision = true;
-	opts.num_clusters = 4;
+	opts.num_clusters = 5;
 
 	blob = ut_blob_create_and_open(bs, &opts);
 	blobid = spdk_blob_get_id(blob);
 	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
 
-	CU_ASSERT(blob->active.num_clusters == 4);
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 4);
-	CU_ASSERT(blob->active.clusters[cluster_num] == 0);
+	channel = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel != NULL);
 
-	/* Specify cluster_num to allocate and new_cluster will be returned to insert on md_thread.
-	 * This is to simulate behaviour when cluster is allocated after blob creation.
-	 * Such as _spdk_bs_allocate_and_copy_cluster(). */
-	spdk_spin_lock(&bs->used_lock);
-	bs_allocate_cluster(blob, cluster_num, &new_cluster, &extent_page, false);
-	CU_ASSERT(blob->active.clusters[cluster_num] == 0);
-	spdk_spin_unlock(&bs->used_lock);
+	/* Target specifically second cluster in a blob as first allocation */
+	io_unit = bs_cluster_to_page(bs, 1) * bs_io_unit_per_page(bs);
 
-	blob_insert_cluster_on_md_thread(blob, cluster_num, new_cluster, extent_page, &page,
-					 blob_op_complete, NULL);
+	/* Payload should be all zeros from unallocated clusters */
+	memset(payload_read, 0xFF, sizeof(payload_read));
+	spdk_blob_io_read(blob, channel, payload_read, io_unit, 10, blob_op_complete, NULL);
 	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(zero, payload_read, 10 * 4096) == 0);
 
-	CU_ASSERT(blob->active.clusters[cluster_num] != 0);
+	write_bytes = g_dev_write_bytes;
+	write_zeroes_bytes = g_dev_write_zeroes_bytes;
+	read_bytes = g_dev_read_bytes;
+
+	/* Issue write to second cluster in a blob */
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	spdk_blob_io_write(blob, channel, payload_write, io_unit, 10, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
+	/* For thin-provisioned blob we need to write 10 pages plus one page metadata and
+	 * read 0 bytes */
+	if (g_use_extent_table) {
+		/* Add one more page for EXTENT_PAGE write */
+		CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) == page_size * 12);
+	} else {
+		CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) == page_size * 11);
+	}
+	CU_ASSERT(g_dev_read_bytes - read_bytes == 0);
+
+	spdk_blob_io_read(blob, channel, payload_read, io_unit, 10, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
+
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
 
 	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
@@ -4420,29 +5929,36 @@ blob_insert_cluster_msg_test(void)
 	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
 	blob = g_blob;
 
-	CU_ASSERT(blob->active.clusters[cluster_num] != 0);
+	channel = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel != NULL);
+
+	/* Read second cluster after blob reload to confirm data written */
+	spdk_blob_io_read(blob, channel, payload_read, io_unit, 10, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
+
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
 
 	ut_blob_close_and_delete(bs, blob);
 }
 
 static void
-blob_thin_prov_rw(void)
+blob_thin_prov_rw_iov(void)
 {
 	static const uint8_t zero[10 * 4096] = { 0 };
 	struct spdk_blob_store *bs = g_bs;
-	struct spdk_blob *blob, *blob_id0;
-	struct spdk_io_channel *channel, *channel_thread1;
+	struct spdk_blob *blob;
+	struct spdk_io_channel *channel;
 	struct spdk_blob_opts opts;
 	uint64_t free_clusters;
-	uint64_t page_size;
 	uint8_t payload_read[10 * 4096];
 	uint8_t payload_write[10 * 4096];
-	uint64_t write_bytes;
-	uint64_t write_zeroes_bytes;
-	uint64_t read_bytes;
+	struct iovec iov_read[3];
+	struct iovec iov_write[3];
 
 	free_clusters = spdk_bs_free_cluster_count(bs);
-	page_size = spdk_bs_get_page_size(bs);
 
 	channel = spdk_bs_alloc_io_channel(bs);
 	CU_ASSERT(channel != NULL);
@@ -4450,15 +5966,10 @@ blob_thin_prov_rw(void)
 	ut_spdk_blob_opts_init(&opts);
 	opts.thin_provision = true;
 
-	/* Create and delete blob at md page 0, so that next md page allocation
-	 * for extent will use that. */
-	blob_id0 = ut_blob_create_and_open(bs, &opts);
 	blob = ut_blob_create_and_open(bs, &opts);
-	ut_blob_close_and_delete(bs, blob_id0);
 	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
 
 	CU_ASSERT(blob->active.num_clusters == 0);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
 
 	/* The blob started at 0 clusters. Resize it to be 5, but still unallocated. */
 	spdk_blob_resize(blob, 5, blob_op_complete, NULL);
@@ -4466,7 +5977,6 @@ blob_thin_prov_rw(void)
 	CU_ASSERT(g_bserrno == 0);
 	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
 	CU_ASSERT(blob->active.num_clusters == 5);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
 
 	spdk_blob_sync_md(blob, blob_op_complete, NULL);
 	poll_threads();
@@ -4474,850 +5984,805 @@ blob_thin_prov_rw(void)
 	/* Sync must not change anything */
 	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
 	CU_ASSERT(blob->active.num_clusters == 5);
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 0);
 
 	/* Payload should be all zeros from unallocated clusters */
-	memset(payload_read, 0xFF, sizeof(payload_read));
-	spdk_blob_io_read(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(zero, payload_read, 10 * 4096) == 0);
-
-	write_bytes = g_dev_write_bytes;
-	write_zeroes_bytes = g_dev_write_zeroes_bytes;
-	read_bytes = g_dev_read_bytes;
+	memset(payload_read, 0xAA, sizeof(payload_read));
+	iov_read[0].iov_base = payload_read;
+	iov_read[0].iov_len = 3 * 4096;
+	iov_read[1].iov_base = payload_read + 3 * 4096;
+	iov_read[1].iov_len = 4 * 4096;
+	iov_read[2].iov_base = payload_read + 7 * 4096;
+	iov_read[2].iov_len = 3 * 4096;
+	spdk_blob_io_readv(blob, channel, iov_read, 3, 250, 10, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(zero, payload_read, 10 * 4096) == 0);
 
-	/* Perform write on thread 1. That will allocate cluster on thread 0 via send_msg */
-	set_thread(1);
-	channel_thread1 = spdk_bs_alloc_io_channel(bs);
-	CU_ASSERT(channel_thread1 != NULL);
-	memset(payload_write, 0xE5, sizeof(payload_write));
-	spdk_blob_io_write(blob, channel_thread1, payload_write, 4, 10, blob_op_complete, NULL);
-	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
-	/* Perform write on thread 0. That will try to allocate cluster,
-	 * but fail due to another thread issuing the cluster allocation first. */
-	set_thread(0);
 	memset(payload_write, 0xE5, sizeof(payload_write));
-	spdk_blob_io_write(blob, channel, payload_write, 4, 10, blob_op_complete, NULL);
-	CU_ASSERT(free_clusters - 2 == spdk_bs_free_cluster_count(bs));
+	iov_write[0].iov_base = payload_write;
+	iov_write[0].iov_len = 1 * 4096;
+	iov_write[1].iov_base = payload_write + 1 * 4096;
+	iov_write[1].iov_len = 5 * 4096;
+	iov_write[2].iov_base = payload_write + 6 * 4096;
+	iov_write[2].iov_len = 4 * 4096;
+
+	spdk_blob_io_writev(blob, channel, iov_write, 3, 250, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
-	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 1);
-	/* For thin-provisioned blob we need to write 20 pages plus one page metadata and
-	 * read 0 bytes */
-	if (g_use_extent_table) {
-		/* Add one more page for EXTENT_PAGE write */
-		CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) == page_size * 22);
-	} else {
-		CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) == page_size * 21);
-	}
-	CU_ASSERT(g_dev_read_bytes - read_bytes == 0);
 
-	spdk_blob_io_read(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
+	memset(payload_read, 0xAA, sizeof(payload_read));
+	iov_read[0].iov_base = payload_read;
+	iov_read[0].iov_len = 3 * 4096;
+	iov_read[1].iov_base = payload_read + 3 * 4096;
+	iov_read[1].iov_len = 4 * 4096;
+	iov_read[2].iov_base = payload_read + 7 * 4096;
+	iov_read[2].iov_len = 3 * 4096;
+	spdk_blob_io_readv(blob, channel, iov_read, 3, 250, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
 
-	ut_blob_close_and_delete(bs, blob);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-
-	set_thread(1);
-	spdk_bs_free_io_channel(channel_thread1);
-	set_thread(0);
 	spdk_bs_free_io_channel(channel);
 	poll_threads();
-	g_blob = NULL;
-	g_blobid = 0;
+
+	ut_blob_close_and_delete(bs, blob);
 }
 
+struct iter_ctx {
+	int		current_iter;
+	spdk_blob_id	blobid[4];
+};
+
 static void
-blob_thin_prov_write_count_io(void)
+test_iter(void *arg, struct spdk_blob *blob, int bserrno)
+{
+	struct iter_ctx *iter_ctx = arg;
+	spdk_blob_id blobid;
+
+	CU_ASSERT(bserrno == 0);
+	blobid = spdk_blob_get_id(blob);
+	CU_ASSERT(blobid == iter_ctx->blobid[iter_ctx->current_iter++]);
+}
+
+static void
+bs_load_iter_test(void)
 {
 	struct spdk_blob_store *bs;
-	struct spdk_blob *blob;
-	struct spdk_io_channel *ch;
 	struct spdk_bs_dev *dev;
-	struct spdk_bs_opts bs_opts;
-	struct spdk_blob_opts opts;
-	uint64_t free_clusters;
-	uint64_t page_size;
-	uint8_t payload_write[4096];
-	uint64_t write_bytes;
-	uint64_t write_zeroes_bytes;
-	uint64_t read_bytes;
-	const uint32_t CLUSTER_SZ = 16384;
-	uint32_t pages_per_cluster;
-	uint32_t pages_per_extent_page;
-	uint32_t i;
+	struct iter_ctx iter_ctx = { 0 };
+	struct spdk_blob *blob;
+	int i, rc;
+	struct spdk_bs_opts opts;
 
-	/* Use a very small cluster size for this test.  This ensures we need multiple
-	 * extent pages to hold all of the clusters even for relatively small blobs like
-	 * we are restricted to for the unit tests (i.e. we don't want to allocate multi-GB
-	 * buffers).
-	 */
 	dev = init_dev();
-	spdk_bs_opts_init(&bs_opts, sizeof(bs_opts));
-	bs_opts.cluster_sz = CLUSTER_SZ;
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
 
-	spdk_bs_init(dev, &bs_opts, bs_op_with_handle_complete, NULL);
+	/* Initialize a new blob store */
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
 
-	free_clusters = spdk_bs_free_cluster_count(bs);
-	page_size = spdk_bs_get_page_size(bs);
-	pages_per_cluster = CLUSTER_SZ / page_size;
-	pages_per_extent_page = SPDK_EXTENTS_PER_EP * pages_per_cluster;
-
-	ch = spdk_bs_alloc_io_channel(bs);
-	SPDK_CU_ASSERT_FATAL(ch != NULL);
-
-	ut_spdk_blob_opts_init(&opts);
-	opts.thin_provision = true;
-
-	blob = ut_blob_create_and_open(bs, &opts);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-
-	/* Resize the blob so that it will require 8 extent pages to hold all of
-	 * the clusters.
-	 */
-	g_bserrno = -1;
-	spdk_blob_resize(blob, SPDK_EXTENTS_PER_EP * 8, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-
-	g_bserrno = -1;
-	spdk_blob_sync_md(blob, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	CU_ASSERT(blob->active.num_clusters == SPDK_EXTENTS_PER_EP * 8);
+	for (i = 0; i < 4; i++) {
+		blob = ut_blob_create_and_open(bs, NULL);
+		iter_ctx.blobid[i] = spdk_blob_get_id(blob);
 
-	memset(payload_write, 0, sizeof(payload_write));
-	for (i = 0; i < 8; i++) {
-		write_bytes = g_dev_write_bytes;
-		write_zeroes_bytes = g_dev_write_zeroes_bytes;
-		read_bytes = g_dev_read_bytes;
+		/* Just save the blobid as an xattr for testing purposes. */
+		rc = spdk_blob_set_xattr(blob, "blobid", &iter_ctx.blobid[i], sizeof(spdk_blob_id));
+		CU_ASSERT(rc == 0);
 
-		g_bserrno = -1;
-		spdk_blob_io_write(blob, ch, payload_write, pages_per_extent_page * i, 1, blob_op_complete, NULL);
+		/* Resize the blob */
+		spdk_blob_resize(blob, i, blob_op_complete, NULL);
 		poll_threads();
 		CU_ASSERT(g_bserrno == 0);
-		CU_ASSERT(free_clusters - (2 * i + 1) == spdk_bs_free_cluster_count(bs));
-
-		CU_ASSERT(g_dev_read_bytes == read_bytes);
-		if (!g_use_extent_table) {
-			/* For legacy metadata, we should have written two pages - one for the
-			 * write I/O itself, another for the blob's primary metadata.
-			 */
-			CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) / page_size == 2);
-		} else {
-			/* For extent table metadata, we should have written three pages - one
-			 * for the write I/O, one for the extent page, one for the blob's primary
-			 * metadata.
-			 */
-			CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) / page_size == 3);
-		}
-
-		/* The write should have synced the metadata already.  Do another sync here
-		 * just to confirm.
-		 */
-		write_bytes = g_dev_write_bytes;
-		write_zeroes_bytes = g_dev_write_zeroes_bytes;
-		read_bytes = g_dev_read_bytes;
 
-		g_bserrno = -1;
-		spdk_blob_sync_md(blob, blob_op_complete, NULL);
+		spdk_blob_close(blob, blob_op_complete, NULL);
 		poll_threads();
 		CU_ASSERT(g_bserrno == 0);
-		CU_ASSERT(free_clusters - (2 * i + 1) == spdk_bs_free_cluster_count(bs));
-		CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 2 * i + 1);
-
-		CU_ASSERT(g_dev_read_bytes == read_bytes);
-		CU_ASSERT(g_dev_write_bytes == write_bytes);
+	}
 
-		/* Now write to another unallocated cluster that is part of the same extent page. */
-		g_bserrno = -1;
-		spdk_blob_io_write(blob, ch, payload_write, pages_per_extent_page * i + pages_per_cluster,
-				   1, blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-		CU_ASSERT(free_clusters - (2 * i + 2) == spdk_bs_free_cluster_count(bs));
-		CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == 2 * i + 2);
+	g_bserrno = -1;
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
 
-		CU_ASSERT(g_dev_read_bytes == read_bytes);
-		/*
-		 * For legacy metadata, we should have written the I/O and the primary metadata page.
-		 * For extent table metadata, we should have written the I/O and the extent metadata page.
-		 */
-		CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) / page_size == 2);
+	dev = init_dev();
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
+	opts.iter_cb_fn = test_iter;
+	opts.iter_cb_arg = &iter_ctx;
 
-		/* Send unmap aligned to the whole cluster - should free it up */
-		g_bserrno = -1;
-		spdk_blob_io_unmap(blob, ch, pages_per_extent_page * i, pages_per_cluster, blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-		CU_ASSERT(free_clusters - (2 * i + 1) == spdk_bs_free_cluster_count(bs));
+	/* Test blob iteration during load after a clean shutdown. */
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
 
-		/* Write back to the freed cluster */
-		g_bserrno = -1;
-		spdk_blob_io_write(blob, ch, payload_write, pages_per_extent_page * i, 1, blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-		CU_ASSERT(free_clusters - (2 * i + 2) == spdk_bs_free_cluster_count(bs));
-	}
+	/* Dirty shutdown */
+	bs_free(bs);
 
-	ut_blob_close_and_delete(bs, blob);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	dev = init_dev();
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
+	opts.iter_cb_fn = test_iter;
+	iter_ctx.current_iter = 0;
+	opts.iter_cb_arg = &iter_ctx;
 
-	spdk_bs_free_io_channel(ch);
+	/* Test blob iteration during load after a dirty shutdown. */
+	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
-	g_blob = NULL;
-	g_blobid = 0;
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
 
 	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	g_bs = NULL;
-}
-
-static void
-blob_thin_prov_unmap_cluster(void)
-{
-	struct spdk_blob_store *bs;
-	struct spdk_blob *blob, *snapshot;
-	struct spdk_io_channel *ch;
-	struct spdk_bs_dev *dev;
-	struct spdk_bs_opts bs_opts;
-	struct spdk_blob_opts opts;
-	uint64_t free_clusters;
-	uint64_t page_size;
-	uint8_t payload_write[4096];
-	uint8_t payload_read[4096];
-	const uint32_t CLUSTER_COUNT = 3;
-	uint32_t pages_per_cluster;
-	spdk_blob_id blobid, snapshotid;
-	uint32_t i;
-	int err;
+	g_bs = NULL;
+}
+
+static void
+bs_load_md_read_ahead(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_opts opts;
+	struct spdk_blob_opts blob_opts;
+	struct spdk_io_channel *channel;
+	struct spdk_blob *blob;
+	spdk_blob_id blobids[300];
+	spdk_blob_id thin_blobid;
+	uint8_t payload[4096];
+	uint8_t large_xattr[3000];
+	const void *value;
+	size_t value_len;
+	uint64_t num_ep = BS_LOAD_EXTENT_PAGES_BATCH + 8;
+	uint64_t i;
+	int rc;
 
-	/* Use a very large cluster size for this test. Check how the unmap/release cluster code path behaves when
-	 * clusters are fully used.
-	 */
 	dev = init_dev();
-	spdk_bs_opts_init(&bs_opts, sizeof(bs_opts));
-	bs_opts.cluster_sz = dev->blocklen * dev->blockcnt / (CLUSTER_COUNT + 1);
+	memset(g_dev_buffer, 0, DEV_BUFFER_SIZE);
+	spdk_bs_opts_init(&opts, sizeof(opts));
+	opts.cluster_sz = 16 * 1024;
 
-	spdk_bs_init(dev, &bs_opts, bs_op_with_handle_complete, NULL);
+	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
 	bs = g_bs;
+	/* Blobs have to span more metadata than is read ahead during recovery */
+	SPDK_CU_ASSERT_FATAL(bs->md_len > BS_LOAD_REPLAY_WINDOWS * BS_LOAD_REPLAY_WINDOW_PAGES);
 
-	free_clusters = spdk_bs_free_cluster_count(bs);
-	page_size = spdk_bs_get_page_size(bs);
-	pages_per_cluster = bs_opts.cluster_sz / page_size;
+	/* Create blobs, some of them with md chains that extend past the first page */
+	memset(large_xattr, 0xA5, sizeof(large_xattr));
+	for (i = 0; i < SPDK_COUNTOF(blobids); i++) {
+		blob = ut_blob_create_and_open(bs, NULL);
+		blobids[i] = spdk_blob_get_id(blob);
 
-	ch = spdk_bs_alloc_io_channel(bs);
-	SPDK_CU_ASSERT_FATAL(ch != NULL);
+		rc = spdk_blob_set_xattr(blob, "index", &i, sizeof(i));
+		CU_ASSERT(rc == 0);
+		if (i % 10 == 0) {
+			rc = spdk_blob_set_xattr(blob, "large", large_xattr, sizeof(large_xattr));
+			CU_ASSERT(rc == 0);
+			rc = spdk_blob_set_xattr(blob, "large2", large_xattr, sizeof(large_xattr));
+			CU_ASSERT(rc == 0);
+		}
 
-	ut_spdk_blob_opts_init(&opts);
-	opts.thin_provision = true;
+		spdk_blob_sync_md(blob, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
 
-	blob = ut_blob_create_and_open(bs, &opts);
-	CU_ASSERT(free_clusters == CLUSTER_COUNT);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	blobid = spdk_blob_get_id(blob);
+		spdk_blob_close(blob, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+	}
 
-	g_bserrno = -1;
-	spdk_blob_resize(blob, CLUSTER_COUNT, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
+	/* Create a thin blob with more extent pages than are read at once on open */
+	ut_spdk_blob_opts_init(&blob_opts);
+	blob_opts.thin_provision = true;
+	blob_opts.num_clusters = num_ep * SPDK_EXTENTS_PER_EP;
+	blob = ut_blob_create_and_open(bs, &blob_opts);
+	thin_blobid = spdk_blob_get_id(blob);
 
-	g_bserrno = -1;
-	spdk_blob_sync_md(blob, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	CU_ASSERT(blob->active.num_clusters == CLUSTER_COUNT);
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
 
-	/* Fill all clusters */
-	for (i = 0; i < CLUSTER_COUNT; i++) {
-		memset(payload_write, i + 1, sizeof(payload_write));
-		g_bserrno = -1;
-		spdk_blob_io_write(blob, ch, payload_write, pages_per_cluster * i, 1, blob_op_complete, NULL);
+	/* Allocate a cluster in every other extent page */
+	for (i = 0; i < num_ep; i += 2) {
+		memset(payload, (int)i + 1, sizeof(payload));
+		spdk_blob_io_write(blob, channel, payload, i * SPDK_EXTENTS_PER_EP * 4, 1,
+				   blob_op_complete, NULL);
 		poll_threads();
 		CU_ASSERT(g_bserrno == 0);
-		CU_ASSERT(free_clusters - (i + 1) == spdk_bs_free_cluster_count(bs));
 	}
-	CU_ASSERT(0 == spdk_bs_free_cluster_count(bs));
-
-	/* Unmap one whole cluster */
-	g_bserrno = -1;
-	spdk_blob_io_unmap(blob, ch, pages_per_cluster, pages_per_cluster, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(1 == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == num_ep / 2);
 
-	/* Verify the data read from the cluster is zeroed out */
-	memset(payload_write, 0, sizeof(payload_write));
-	spdk_blob_io_read(blob, ch, payload_read, pages_per_cluster, 1, blob_op_complete, NULL);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
 
-	/* Fill the same cluster with data */
-	memset(payload_write, 3, sizeof(payload_write));
-	g_bserrno = -1;
-	spdk_blob_io_write(blob, ch, payload_write, pages_per_cluster, 1, blob_op_complete, NULL);
+	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(0 == spdk_bs_free_cluster_count(bs));
 
-	/* Verify the data read from the cluster has the expected data */
-	spdk_blob_io_read(blob, ch, payload_read, pages_per_cluster, 1, blob_op_complete, NULL);
+	spdk_bs_free_io_channel(channel);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
 
-	/* Send an unaligned unmap that ecompasses one whole cluster */
-	g_bserrno = -1;
-	spdk_blob_io_unmap(blob, ch, pages_per_cluster - 1, pages_per_cluster + 2, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(1 == spdk_bs_free_cluster_count(bs));
+	/* Recover the blobstore and verify every blob was found */
+	ut_bs_dirty_load(&bs, &opts);
 
-	/* Verify the data read from the cluster is zeroed out */
-	g_bserrno = -1;
-	memset(payload_write, 0, sizeof(payload_write));
-	spdk_blob_io_read(blob, ch, payload_read, pages_per_cluster, 1, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
+	CU_ASSERT(spdk_bit_array_count_set(bs->used_blobids) == SPDK_COUNTOF(blobids) + 1);
+	for (i = 0; i < SPDK_COUNTOF(blobids); i++) {
+		spdk_bs_open_blob(bs, blobids[i], blob_op_with_handle_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+		blob = g_blob;
 
-	/* Send a simultaneous unmap with a write to an unallocated area -
-	 * check that writes don't claim the currently unmapped cluster */
-	g_bserrno = -1;
-	memset(payload_write, 7, sizeof(payload_write));
-	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, NULL);
-	spdk_blob_io_write(blob, ch, payload_write, pages_per_cluster, 1, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(1 == spdk_bs_free_cluster_count(bs));
+		rc = spdk_blob_get_xattr_value(blob, "index", &value, &value_len);
+		CU_ASSERT(rc == 0);
+		SPDK_CU_ASSERT_FATAL(value != NULL);
+		CU_ASSERT(value_len == sizeof(i));
+		CU_ASSERT(*(const uint64_t *)value == i);
+		if (i % 10 == 0) {
+			rc = spdk_blob_get_xattr_value(blob, "large2", &value, &value_len);
+			CU_ASSERT(rc == 0);
+			SPDK_CU_ASSERT_FATAL(value != NULL);
+			CU_ASSERT(value_len == sizeof(large_xattr));
+			CU_ASSERT(memcmp(value, large_xattr, sizeof(large_xattr)) == 0);
+		}
 
-	/* Verify the contents of written sector */
-	g_bserrno = -1;
-	spdk_blob_io_read(blob, ch, payload_read, pages_per_cluster, 1, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
+		spdk_blob_close(blob, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+	}
 
-	/* Verify the contents of unmapped sector */
-	g_bserrno = -1;
-	memset(payload_write, 0, sizeof(payload_write));
-	spdk_blob_io_read(blob, ch, payload_read, 0, 1, blob_op_complete, NULL);
+	/* Open the thin blob, its extent pages are read in batches */
+	spdk_bs_open_blob(bs, thin_blobid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == num_ep * SPDK_EXTENTS_PER_EP);
+	CU_ASSERT(spdk_blob_get_num_allocated_clusters(blob) == num_ep / 2);
 
-	/* Make sure clusters are not freed until the unmap to the drive is done */
-	g_bserrno = -1;
-	memset(payload_write, 7, sizeof(payload_write));
-	spdk_blob_io_write(blob, ch, payload_write, 0, 1, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(0 == spdk_bs_free_cluster_count(bs));
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
 
-	g_bserrno = -1;
-	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, NULL);
-	while (memcmp(payload_write, &g_dev_buffer[4096 * pages_per_cluster], 4096) == 0) {
-		CU_ASSERT(0 == spdk_bs_free_cluster_count(bs));
-		poll_thread_times(0, 1);
+	for (i = 0; i < num_ep; i++) {
+		CU_ASSERT(bs_cluster_to_lba(bs, blob->active.clusters[i * SPDK_EXTENTS_PER_EP]) != 0 ||
+			  i % 2 == 1);
+		spdk_blob_io_read(blob, channel, payload, i * SPDK_EXTENTS_PER_EP * 4, 1,
+				  blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		CU_ASSERT(payload[0] == (i % 2 == 0 ? i + 1 : 0));
+		CU_ASSERT(payload[sizeof(payload) - 1] == (i % 2 == 0 ? i + 1 : 0));
 	}
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(1 == spdk_bs_free_cluster_count(bs));
 
-	/* Issue #3358 had a bug with concurrent trims to the same cluster causing an assert, check for regressions.
-	 * Send three concurrent unmaps to the same cluster.
-	 */
-	g_bserrno = -1;
-	memset(payload_write, 7, sizeof(payload_write));
-	spdk_blob_io_write(blob, ch, payload_write, 0, 1, blob_op_complete, NULL);
+	spdk_bs_free_io_channel(channel);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(0 == spdk_bs_free_cluster_count(bs));
 
-	g_bserrno = -1;
-	err = -1;
-	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, NULL);
-	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, NULL);
-	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, &err);
+	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(err == 0);
-	CU_ASSERT(1 == spdk_bs_free_cluster_count(bs));
 
-	/* Test thin-provisioned blob that is backed */
-	spdk_blob_resize(blob, 1, blob_op_complete, NULL);
+	spdk_bs_unload(bs, bs_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	g_bs = NULL;
+}
+
+static void
+blob_snapshot_rw(void)
+{
+	static const uint8_t zero[10 * 4096] = { 0 };
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob, *snapshot;
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts opts;
+	spdk_blob_id blobid, snapshotid;
+	uint64_t free_clusters;
+	uint64_t cluster_size;
+	uint64_t page_size;
+	uint8_t payload_read[10 * 4096];
+	uint8_t payload_write[10 * 4096];
+	uint64_t write_bytes_start;
+	uint64_t read_bytes_start;
+	uint64_t copy_bytes_start;
+	uint64_t write_bytes;
+	uint64_t read_bytes;
+	uint64_t copy_bytes;
+
+	free_clusters = spdk_bs_free_cluster_count(bs);
+	cluster_size = spdk_bs_get_cluster_size(bs);
+	page_size = spdk_bs_get_page_size(bs);
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel != NULL);
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 5;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+	blobid = spdk_blob_get_id(blob);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 5);
+
+	memset(payload_read, 0xFF, sizeof(payload_read));
+	spdk_blob_io_read(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(memcmp(zero, payload_read, 10 * 4096) == 0);
 
-	g_bserrno = -1;
-	memset(payload_write, 1, sizeof(payload_write));
-	spdk_blob_io_write(blob, ch, payload_write, 0, 1, blob_op_complete, NULL);
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	spdk_blob_io_write(blob, channel, payload_write, 4, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(free_clusters != spdk_bs_free_cluster_count(bs));
 
-	/* Create a snapshot */
-	CU_ASSERT_EQUAL(_get_snapshots_count(bs), 0);
+	/* Create snapshot from blob */
 	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
-	CU_ASSERT_EQUAL(_get_snapshots_count(bs), 1);
 	snapshotid = g_blobid;
-	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
+
 	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
 	snapshot = g_blob;
+	CU_ASSERT(snapshot->data_ro == true);
+	CU_ASSERT(snapshot->md_ro == true);
 
-	/* Write data to blob, it will alloc new cluster */
-	g_bserrno = -1;
-	memset(payload_write, 2, sizeof(payload_write));
-	spdk_blob_io_write(blob, ch, payload_write, 0, 1, blob_op_complete, NULL);
+	CU_ASSERT(spdk_blob_get_num_clusters(snapshot) == 5);
+
+	write_bytes_start = g_dev_write_bytes;
+	read_bytes_start = g_dev_read_bytes;
+	copy_bytes_start = g_dev_copy_bytes;
+
+	memset(payload_write, 0xAA, sizeof(payload_write));
+	spdk_blob_io_write(blob, channel, payload_write, 4, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters - 2 == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(free_clusters != spdk_bs_free_cluster_count(bs));
 
-	/* Unmap one whole cluster, but do not release this cluster */
-	g_bserrno = -1;
-	spdk_blob_io_unmap(blob, ch, 0, pages_per_cluster, blob_op_complete, NULL);
+	/* For a clone we need to allocate and copy one cluster, update one page of metadata
+	 * and then write 10 pages of payload.
+	 */
+	write_bytes = g_dev_write_bytes - write_bytes_start;
+	read_bytes = g_dev_read_bytes - read_bytes_start;
+	copy_bytes = g_dev_copy_bytes - copy_bytes_start;
+	if (g_dev_copy_enabled) {
+		CU_ASSERT(copy_bytes == cluster_size);
+	} else {
+		CU_ASSERT(copy_bytes == 0);
+	}
+	if (g_use_extent_table) {
+		/* Add one more page for EXTENT_PAGE write */
+		CU_ASSERT(write_bytes + copy_bytes == page_size * 12 + cluster_size);
+	} else {
+		CU_ASSERT(write_bytes + copy_bytes == page_size * 11 + cluster_size);
+	}
+	CU_ASSERT(read_bytes + copy_bytes == cluster_size);
+
+	spdk_blob_io_read(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters - 2 == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
 
-	/* Verify the data read from the cluster is zeroed out */
-	g_bserrno = -1;
-	memset(payload_write, 0, sizeof(payload_write));
-	spdk_blob_io_read(blob, ch, payload_read, 0, 1, blob_op_complete, NULL);
+	/* Data on snapshot should not change after write to clone */
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	spdk_blob_io_read(snapshot, channel, payload_read, 4, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(payload_write, payload_read, 4096) == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
 
 	ut_blob_close_and_delete(bs, blob);
 	ut_blob_close_and_delete(bs, snapshot);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
 
-	spdk_bs_free_io_channel(ch);
+	spdk_bs_free_io_channel(channel);
 	poll_threads();
 	g_blob = NULL;
 	g_blobid = 0;
-
-	spdk_bs_unload(bs, bs_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	g_bs = NULL;
 }
 
 static void
-blob_thin_prov_rle(void)
+blob_snapshot_rw_cow_bw_limit(void)
 {
-	static const uint8_t zero[10 * 4096] = { 0 };
 	struct spdk_blob_store *bs = g_bs;
-	struct spdk_blob *blob;
+	struct spdk_blob *blob, *snapshot;
 	struct spdk_io_channel *channel;
+	struct spdk_bs_channel *bs_ch;
 	struct spdk_blob_opts opts;
-	spdk_blob_id blobid;
-	uint64_t free_clusters;
-	uint64_t page_size;
+	spdk_blob_id blobid, snapshotid;
+	uint64_t cluster_size;
 	uint8_t payload_read[10 * 4096];
 	uint8_t payload_write[10 * 4096];
-	uint64_t write_bytes;
-	uint64_t write_zeroes_bytes;
-	uint64_t read_bytes;
-	uint64_t io_unit;
+	uint64_t read_bytes_start;
+	int i;
 
-	free_clusters = spdk_bs_free_cluster_count(bs);
-	page_size = spdk_bs_get_page_size(bs);
+	if (g_dev_copy_enabled) {
+		/* The limit only applies to copies through host memory */
+		return;
+	}
+
+	cluster_size = spdk_bs_get_cluster_size(bs);
+	SPDK_CU_ASSERT_FATAL(cluster_size > BS_COW_CHUNK_SIZE * BS_COW_CHUNK_DEPTH);
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+	bs_ch = spdk_io_channel_get_ctx(channel);
 
 	ut_spdk_blob_opts_init(&opts);
 	opts.thin_provision = true;
-	opts.num_clusters = 5;
+	opts.num_clusters = 2;
 
 	blob = ut_blob_create_and_open(bs, &opts);
 	blobid = spdk_blob_get_id(blob);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
 
-	channel = spdk_bs_alloc_io_channel(bs);
-	CU_ASSERT(channel != NULL);
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	spdk_blob_io_write(blob, channel, payload_write, 4, 10, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
 
-	/* Target specifically second cluster in a blob as first allocation */
-	io_unit = bs_cluster_to_page(bs, 1) * bs_io_unit_per_page(bs);
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	snapshotid = g_blobid;
 
-	/* Payload should be all zeros from unallocated clusters */
-	memset(payload_read, 0xFF, sizeof(payload_read));
-	spdk_blob_io_read(blob, channel, payload_read, io_unit, 10, blob_op_complete, NULL);
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(zero, payload_read, 10 * 4096) == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
 
-	write_bytes = g_dev_write_bytes;
-	write_zeroes_bytes = g_dev_write_zeroes_bytes;
-	read_bytes = g_dev_read_bytes;
+	/* Allow copying one cluster per second */
+	spdk_bs_set_cow_bandwidth_limit(bs, cluster_size);
 
-	/* Issue write to second cluster in a blob */
-	memset(payload_write, 0xE5, sizeof(payload_write));
-	spdk_blob_io_write(blob, channel, payload_write, io_unit, 10, blob_op_complete, NULL);
+	read_bytes_start = g_dev_read_bytes;
+	memset(payload_write, 0xAA, sizeof(payload_write));
+	g_bserrno = -1;
+	spdk_blob_io_write(blob, channel, payload_write, 4, 10, blob_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
-	/* For thin-provisioned blob we need to write 10 pages plus one page metadata and
-	 * read 0 bytes */
-	if (g_use_extent_table) {
-		/* Add one more page for EXTENT_PAGE write */
-		CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) == page_size * 12);
-	} else {
-		CU_ASSERT(((g_dev_write_bytes - write_bytes)-(g_dev_write_zeroes_bytes - write_zeroes_bytes)) == page_size * 11);
+
+	/* The copy is throttled, so only part of the cluster has been read */
+	CU_ASSERT(g_bserrno == -1);
+	CU_ASSERT(g_dev_read_bytes - read_bytes_start < cluster_size);
+	CU_ASSERT(bs_ch->num_cow_bufs == BS_COW_BUFS_PER_CHANNEL);
+	CU_ASSERT(!TAILQ_EMPTY(&bs_ch->cow_waiting));
+	CU_ASSERT(bs_ch->cow_poller != NULL);
+
+	for (i = 0; i < 20 && g_bserrno == -1; i++) {
+		spdk_delay_us(100000);
+		poll_threads();
 	}
-	CU_ASSERT(g_dev_read_bytes - read_bytes == 0);
+	CU_ASSERT(g_bserrno == 0);
+	/* Close to a second, minus the initial burst */
+	CU_ASSERT(i >= 8);
+	CU_ASSERT(g_dev_read_bytes - read_bytes_start == cluster_size);
+	CU_ASSERT(bs_ch->num_cow_bufs == BS_COW_BUFS_PER_CHANNEL);
+	CU_ASSERT(TAILQ_EMPTY(&bs_ch->cow_waiting));
 
-	spdk_blob_io_read(blob, channel, payload_read, io_unit, 10, blob_op_complete, NULL);
+	spdk_blob_io_read(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
 
-	spdk_bs_free_io_channel(channel);
+	/* The rest of the cluster was copied from the snapshot */
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	spdk_blob_io_read(blob, channel, payload_read, 14, 10, blob_op_complete, NULL);
 	poll_threads();
-
-	spdk_blob_close(blob, blob_op_complete, NULL);
+	CU_ASSERT(g_bserrno == 0);
+	spdk_blob_io_read(snapshot, channel, payload_write, 14, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
 
-	ut_bs_reload(&bs, NULL);
+	spdk_bs_set_cow_bandwidth_limit(bs, 0);
 
-	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	ut_blob_close_and_delete(bs, blob);
+	ut_blob_close_and_delete(bs, snapshot);
+
+	spdk_bs_free_io_channel(channel);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
-	blob = g_blob;
+	g_blob = NULL;
+	g_blobid = 0;
+}
 
-	channel = spdk_bs_alloc_io_channel(bs);
-	CU_ASSERT(channel != NULL);
+static void
+ut_cow_units_write(struct spdk_blob *blob, struct spdk_io_channel *channel, uint8_t *expected,
+		   uint64_t offset, uint64_t length, uint8_t pattern)
+{
+	uint64_t io_unit_size = spdk_bs_get_io_unit_size(blob->bs);
 
-	/* Read second cluster after blob reload to confirm data written */
-	spdk_blob_io_read(blob, channel, payload_read, io_unit, 10, blob_op_complete, NULL);
+	memset(expected + offset * io_unit_size, pattern, length * io_unit_size);
+	spdk_blob_io_write(blob, channel, expected + offset * io_unit_size, offset, length,
+			   blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
+}
 
-	spdk_bs_free_io_channel(channel);
+static void
+ut_cow_units_verify(struct spdk_blob *blob, struct spdk_io_channel *channel, uint8_t *expected)
+{
+	uint64_t size = spdk_blob_get_num_clusters(blob) * spdk_bs_get_cluster_size(blob->bs);
+	uint8_t *payload;
+
+	payload = calloc(1, size);
+	SPDK_CU_ASSERT_FATAL(payload != NULL);
+
+	spdk_blob_io_read(blob, channel, payload, 0, spdk_blob_get_num_io_units(blob),
+			  blob_op_complete, NULL);
 	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(expected, payload, size) == 0);
 
-	ut_blob_close_and_delete(bs, blob);
+	free(payload);
 }
 
 static void
-blob_thin_prov_rw_iov(void)
+blob_snapshot_cow_units(void)
 {
-	static const uint8_t zero[10 * 4096] = { 0 };
 	struct spdk_blob_store *bs = g_bs;
-	struct spdk_blob *blob;
+	struct spdk_blob *blob, *snapshot;
 	struct spdk_io_channel *channel;
 	struct spdk_blob_opts opts;
-	uint64_t free_clusters;
-	uint8_t payload_read[10 * 4096];
-	uint8_t payload_write[10 * 4096];
-	struct iovec iov_read[3];
-	struct iovec iov_write[3];
+	spdk_blob_id blobid, snapshotid, snapshotid2;
+	uint64_t cluster_size, io_unit_size, unit_size, upu;
+	uint64_t free_clusters, copied_start, all;
+	uint8_t *expected;
+	uint64_t i;
 
-	free_clusters = spdk_bs_free_cluster_count(bs);
+	cluster_size = spdk_bs_get_cluster_size(bs);
+	io_unit_size = spdk_bs_get_io_unit_size(bs);
+	unit_size = cluster_size / 16;
+	upu = unit_size / io_unit_size;
+	all = (1ULL << 16) - 1;
+
+	expected = calloc(2, cluster_size);
+	SPDK_CU_ASSERT_FATAL(expected != NULL);
 
 	channel = spdk_bs_alloc_io_channel(bs);
-	CU_ASSERT(channel != NULL);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
 
+	/* Unit size has to divide the cluster */
 	ut_spdk_blob_opts_init(&opts);
 	opts.thin_provision = true;
+	opts.num_clusters = 2;
+	opts.cow_unit_size = unit_size + io_unit_size;
+	spdk_bs_create_blob_ext(bs, &opts, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
 
+	opts.cow_unit_size = unit_size;
 	blob = ut_blob_create_and_open(bs, &opts);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-
-	CU_ASSERT(blob->active.num_clusters == 0);
+	blobid = spdk_blob_get_id(blob);
+	CU_ASSERT(blob->cow_unit_size == unit_size);
 
-	/* The blob started at 0 clusters. Resize it to be 5, but still unallocated. */
-	spdk_blob_resize(blob, 5, blob_op_complete, NULL);
+	/* Fill the blob with data unique to each io_unit and snapshot it */
+	for (i = 0; i < 2 * cluster_size / io_unit_size; i++) {
+		memset(expected + i * io_unit_size, (i % 255) + 1, io_unit_size);
+	}
+	spdk_blob_io_write(blob, channel, expected, 0, spdk_blob_get_num_io_units(blob),
+			   blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	CU_ASSERT(blob->active.num_clusters == 5);
 
-	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	/* Sync must not change anything */
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-	CU_ASSERT(blob->active.num_clusters == 5);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	snapshotid = g_blobid;
+	CU_ASSERT(blob->active.num_allocated_clusters == 0);
+	free_clusters = spdk_bs_free_cluster_count(bs);
 
-	/* Payload should be all zeros from unallocated clusters */
-	memset(payload_read, 0xAA, sizeof(payload_read));
-	iov_read[0].iov_base = payload_read;
-	iov_read[0].iov_len = 3 * 4096;
-	iov_read[1].iov_base = payload_read + 3 * 4096;
-	iov_read[1].iov_len = 4 * 4096;
-	iov_read[2].iov_base = payload_read + 7 * 4096;
-	iov_read[2].iov_len = 3 * 4096;
-	spdk_blob_io_readv(blob, channel, iov_read, 3, 250, 10, blob_op_complete, NULL);
+	/* A small write copies only the unit it touches */
+	copied_start = g_dev_read_bytes + g_dev_copy_bytes;
+	ut_cow_units_write(blob, channel, expected, 1, 2, 0xAA);
+	CU_ASSERT(g_dev_read_bytes + g_dev_copy_bytes - copied_start == unit_size);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 1);
+	CU_ASSERT(bs_cluster_cow_units(blob, 0) == (all & ~1ULL));
+	ut_cow_units_verify(blob, channel, expected);
+
+	/* The snapshot cannot go away while the clone still reads from it */
+	spdk_bs_delete_blob(bs, snapshotid, blob_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(zero, payload_read, 10 * 4096) == 0);
+	CU_ASSERT(g_bserrno == -EBUSY);
 
-	memset(payload_write, 0xE5, sizeof(payload_write));
-	iov_write[0].iov_base = payload_write;
-	iov_write[0].iov_len = 1 * 4096;
-	iov_write[1].iov_base = payload_write + 1 * 4096;
-	iov_write[1].iov_len = 5 * 4096;
-	iov_write[2].iov_base = payload_write + 6 * 4096;
-	iov_write[2].iov_len = 4 * 4096;
+	copied_start = g_dev_read_bytes + g_dev_copy_bytes;
+	ut_cow_units_write(blob, channel, expected, 5 * upu + upu / 2, 1, 0xBB);
+	CU_ASSERT(g_dev_read_bytes + g_dev_copy_bytes - copied_start == unit_size);
+	CU_ASSERT(bs_cluster_cow_units(blob, 0) == (all & ~(1ULL | 1ULL << 5)));
 
-	spdk_blob_io_writev(blob, channel, iov_write, 3, 250, 10, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
+	/* Only the units not copied yet are copied */
+	copied_start = g_dev_read_bytes + g_dev_copy_bytes;
+	ut_cow_units_write(blob, channel, expected, upu, 10 * upu, 0xCC);
+	CU_ASSERT(g_dev_read_bytes + g_dev_copy_bytes - copied_start == 9 * unit_size);
+	CU_ASSERT(bs_cluster_cow_units(blob, 0) == (all & ~((1ULL << 11) - 1)));
 
-	memset(payload_read, 0xAA, sizeof(payload_read));
-	iov_read[0].iov_base = payload_read;
-	iov_read[0].iov_len = 3 * 4096;
-	iov_read[1].iov_base = payload_read + 3 * 4096;
-	iov_read[1].iov_len = 4 * 4096;
-	iov_read[2].iov_base = payload_read + 7 * 4096;
-	iov_read[2].iov_len = 3 * 4096;
-	spdk_blob_io_readv(blob, channel, iov_read, 3, 250, 10, blob_op_complete, NULL);
+	/* Once only a few units would be left in the parent, the cluster is completed */
+	copied_start = g_dev_read_bytes + g_dev_copy_bytes;
+	ut_cow_units_write(blob, channel, expected, 11 * upu, 1, 0xDD);
+	CU_ASSERT(g_dev_read_bytes + g_dev_copy_bytes - copied_start == 5 * unit_size);
+	CU_ASSERT(bs_cluster_cow_units(blob, 0) == 0);
+	ut_cow_units_verify(blob, channel, expected);
+
+	/* Units still in the parent are persisted */
+	ut_cow_units_write(blob, channel, expected, cluster_size / io_unit_size + 3 * upu, 1, 0xEE);
+	CU_ASSERT(bs_cluster_cow_units(blob, 1) == (all & ~(1ULL << 3)));
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
+	ut_bs_reload(&bs, NULL);
 
 	spdk_bs_free_io_channel(channel);
 	poll_threads();
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
 
-	ut_blob_close_and_delete(bs, blob);
-}
-
-struct iter_ctx {
-	int		current_iter;
-	spdk_blob_id	blobid[4];
-};
-
-static void
-test_iter(void *arg, struct spdk_blob *blob, int bserrno)
-{
-	struct iter_ctx *iter_ctx = arg;
-	spdk_blob_id blobid;
-
-	CU_ASSERT(bserrno == 0);
-	blobid = spdk_blob_get_id(blob);
-	CU_ASSERT(blobid == iter_ctx->blobid[iter_ctx->current_iter++]);
-}
-
-static void
-bs_load_iter_test(void)
-{
-	struct spdk_blob_store *bs;
-	struct spdk_bs_dev *dev;
-	struct iter_ctx iter_ctx = { 0 };
-	struct spdk_blob *blob;
-	int i, rc;
-	struct spdk_bs_opts opts;
-
-	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
-
-	/* Initialize a new blob store */
-	spdk_bs_init(dev, &opts, bs_op_with_handle_complete, NULL);
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	bs = g_bs;
-
-	for (i = 0; i < 4; i++) {
-		blob = ut_blob_create_and_open(bs, NULL);
-		iter_ctx.blobid[i] = spdk_blob_get_id(blob);
-
-		/* Just save the blobid as an xattr for testing purposes. */
-		rc = spdk_blob_set_xattr(blob, "blobid", &iter_ctx.blobid[i], sizeof(spdk_blob_id));
-		CU_ASSERT(rc == 0);
-
-		/* Resize the blob */
-		spdk_blob_resize(blob, i, blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(blob->cow_unit_size == unit_size);
+	CU_ASSERT(bs_cluster_cow_units(blob, 0) == 0);
+	CU_ASSERT(bs_cluster_cow_units(blob, 1) == (all & ~(1ULL << 3)));
+	ut_cow_units_verify(blob, channel, expected);
 
-		spdk_blob_close(blob, blob_op_complete, NULL);
-		poll_threads();
-		CU_ASSERT(g_bserrno == 0);
-	}
+	/* A snapshot, being read-only, could never complete the partially copied clusters */
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EBUSY);
+	CU_ASSERT(bs_cluster_cow_units(blob, 1) == (all & ~(1ULL << 3)));
+	ut_cow_units_verify(blob, channel, expected);
 
-	g_bserrno = -1;
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+	spdk_bs_blob_cow_fill(bs, channel, blobid, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(bs_cluster_cow_units(blob, 0) == 0);
+	CU_ASSERT(bs_cluster_cow_units(blob, 1) == 0);
+	CU_ASSERT(blob->active.num_allocated_clusters == 2);
+	ut_cow_units_verify(blob, channel, expected);
 
-	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
-	opts.iter_cb_fn = test_iter;
-	opts.iter_cb_arg = &iter_ctx;
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	snapshotid2 = g_blobid;
+	CU_ASSERT(blob->active.num_allocated_clusters == 0);
 
-	/* Test blob iteration during load after a clean shutdown. */
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	spdk_bs_open_blob(bs, snapshotid2, blob_op_with_handle_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	bs = g_bs;
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
+	CU_ASSERT(!blob_has_cow_units(snapshot));
+	spdk_blob_close(snapshot, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	ut_cow_units_verify(blob, channel, expected);
 
-	/* Dirty shutdown */
-	bs_free(bs);
+	/* The clone copies only the units it touches from the complete snapshot */
+	ut_cow_units_write(blob, channel, expected, cluster_size / io_unit_size, 1, 0x11);
+	CU_ASSERT(bs_cluster_cow_units(blob, 1) == (all & ~1ULL));
+	ut_cow_units_verify(blob, channel, expected);
 
-	dev = init_dev();
-	spdk_bs_opts_init(&opts, sizeof(opts));
-	snprintf(opts.bstype.bstype, sizeof(opts.bstype.bstype), "TESTTYPE");
-	opts.iter_cb_fn = test_iter;
-	iter_ctx.current_iter = 0;
-	opts.iter_cb_arg = &iter_ctx;
+	spdk_bs_blob_cow_fill(bs, channel, blobid, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(bs_cluster_cow_units(blob, 1) == 0);
+	CU_ASSERT(blob->active.num_allocated_clusters == 1);
 
-	/* Test blob iteration during load after a dirty shutdown. */
-	spdk_bs_load(dev, &opts, bs_op_with_handle_complete, NULL);
+	/* The second snapshot goes away, its clone takes over the clusters it does not have */
+	spdk_bs_delete_blob(bs, snapshotid2, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
-	bs = g_bs;
+	ut_cow_units_verify(blob, channel, expected);
 
-	spdk_bs_unload(bs, bs_op_complete, NULL);
+	ut_blob_close_and_delete(bs, blob);
+	spdk_bs_delete_blob(bs, snapshotid, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	g_bs = NULL;
+
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
+	free(expected);
+	g_blob = NULL;
+	g_blobid = 0;
 }
 
 static void
-blob_snapshot_rw(void)
+blob_cow_units_concurrent(void)
 {
-	static const uint8_t zero[10 * 4096] = { 0 };
 	struct spdk_blob_store *bs = g_bs;
-	struct spdk_blob *blob, *snapshot;
+	struct spdk_blob *blob;
 	struct spdk_io_channel *channel;
 	struct spdk_blob_opts opts;
 	spdk_blob_id blobid, snapshotid;
-	uint64_t free_clusters;
-	uint64_t cluster_size;
-	uint64_t page_size;
-	uint8_t payload_read[10 * 4096];
-	uint8_t payload_write[10 * 4096];
-	uint64_t write_bytes_start;
-	uint64_t read_bytes_start;
-	uint64_t copy_bytes_start;
-	uint64_t write_bytes;
-	uint64_t read_bytes;
-	uint64_t copy_bytes;
+	uint64_t cluster_size, io_unit_size, unit_size, upc, upu, all;
+	uint64_t num_clusters = BS_MAX_CLUSTER_ALLOCS_PER_CHANNEL;
+	int rc[2 * BS_MAX_CLUSTER_ALLOCS_PER_CHANNEL];
+	uint8_t *expected;
+	uint64_t i;
 
-	free_clusters = spdk_bs_free_cluster_count(bs);
 	cluster_size = spdk_bs_get_cluster_size(bs);
-	page_size = spdk_bs_get_page_size(bs);
+	io_unit_size = spdk_bs_get_io_unit_size(bs);
+	unit_size = cluster_size / 16;
+	upc = cluster_size / io_unit_size;
+	upu = unit_size / io_unit_size;
+	all = (1ULL << 16) - 1;
+
+	expected = calloc(num_clusters, cluster_size);
+	SPDK_CU_ASSERT_FATAL(expected != NULL);
 
 	channel = spdk_bs_alloc_io_channel(bs);
-	CU_ASSERT(channel != NULL);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
 
 	ut_spdk_blob_opts_init(&opts);
 	opts.thin_provision = true;
-	opts.num_clusters = 5;
-
+	opts.num_clusters = num_clusters;
+	opts.cow_unit_size = unit_size;
 	blob = ut_blob_create_and_open(bs, &opts);
 	blobid = spdk_blob_get_id(blob);
-	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
-
-	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 5);
-
-	memset(payload_read, 0xFF, sizeof(payload_read));
-	spdk_blob_io_read(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(zero, payload_read, 10 * 4096) == 0);
 
-	memset(payload_write, 0xE5, sizeof(payload_write));
-	spdk_blob_io_write(blob, channel, payload_write, 4, 10, blob_op_complete, NULL);
+	memset(expected, 0x5A, num_clusters * cluster_size);
+	spdk_blob_io_write(blob, channel, expected, 0, spdk_blob_get_num_io_units(blob),
+			   blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters != spdk_bs_free_cluster_count(bs));
 
-	/* Create snapshot from blob */
 	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
 	snapshotid = g_blobid;
 
-	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
-	snapshot = g_blob;
-	CU_ASSERT(snapshot->data_ro == true);
-	CU_ASSERT(snapshot->md_ro == true);
-
-	CU_ASSERT(spdk_blob_get_num_clusters(snapshot) == 5);
-
-	write_bytes_start = g_dev_write_bytes;
-	read_bytes_start = g_dev_read_bytes;
-	copy_bytes_start = g_dev_copy_bytes;
-
-	memset(payload_write, 0xAA, sizeof(payload_write));
-	spdk_blob_io_write(blob, channel, payload_write, 4, 10, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(free_clusters != spdk_bs_free_cluster_count(bs));
-
-	/* For a clone we need to allocate and copy one cluster, update one page of metadata
-	 * and then write 10 pages of payload.
+	/*
+	 * Take every cluster allocation slot of the channel, and queue a write to another
+	 * unit behind each of them. Once an allocation completes, the queued write needs a
+	 * slot of its own to copy its unit.
 	 */
-	write_bytes = g_dev_write_bytes - write_bytes_start;
-	read_bytes = g_dev_read_bytes - read_bytes_start;
-	copy_bytes = g_dev_copy_bytes - copy_bytes_start;
-	if (g_dev_copy_enabled) {
-		CU_ASSERT(copy_bytes == cluster_size);
-	} else {
-		CU_ASSERT(copy_bytes == 0);
+	memset(expected, 0xA5, num_clusters * cluster_size);
+	for (i = 0; i < num_clusters; i++) {
+		rc[2 * i] = rc[2 * i + 1] = 1;
+		spdk_blob_io_write(blob, channel, expected + i * cluster_size, i * upc, 1,
+				   blob_op_complete, &rc[2 * i]);
+		spdk_blob_io_write(blob, channel, expected + i * cluster_size + 8 * unit_size,
+				   i * upc + 8 * upu, 1, blob_op_complete, &rc[2 * i + 1]);
 	}
-	if (g_use_extent_table) {
-		/* Add one more page for EXTENT_PAGE write */
-		CU_ASSERT(write_bytes + copy_bytes == page_size * 12 + cluster_size);
-	} else {
-		CU_ASSERT(write_bytes + copy_bytes == page_size * 11 + cluster_size);
+	memset(expected, 0x5A, num_clusters * cluster_size);
+	for (i = 0; i < num_clusters; i++) {
+		memset(expected + i * cluster_size, 0xA5, io_unit_size);
+		memset(expected + i * cluster_size + 8 * unit_size, 0xA5, io_unit_size);
 	}
-	CU_ASSERT(read_bytes + copy_bytes == cluster_size);
-
-	spdk_blob_io_read(blob, channel, payload_read, 4, 10, blob_op_complete, NULL);
 	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
 
-	/* Data on snapshot should not change after write to clone */
-	memset(payload_write, 0xE5, sizeof(payload_write));
-	spdk_blob_io_read(snapshot, channel, payload_read, 4, 10, blob_op_complete, NULL);
-	poll_threads();
-	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
+	for (i = 0; i < 2 * num_clusters; i++) {
+		CU_ASSERT(rc[i] == 0);
+	}
+	for (i = 0; i < num_clusters; i++) {
+		CU_ASSERT(bs_cluster_cow_units(blob, i) == (all & ~(1ULL | 1ULL << 8)));
+	}
+	ut_cow_units_verify(blob, channel, expected);
 
 	ut_blob_close_and_delete(bs, blob);
-	ut_blob_close_and_delete(bs, snapshot);
+	spdk_bs_delete_blob(bs, snapshotid, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
 
 	spdk_bs_free_io_channel(channel);
 	poll_threads();
+	free(expected);
 	g_blob = NULL;
 	g_blobid = 0;
 }
@@ -9670,6 +11135,164 @@ blob_shallow_copy(void)
 	poll_threads();
 }
 
+static void
+ut_blob_write_cluster(struct spdk_blob *blob, struct spdk_io_channel *channel, uint64_t cluster_num,
+		      uint8_t pattern)
+{
+	uint64_t io_units_per_cluster = bs_io_units_per_cluster(blob);
+	uint8_t *payload;
+
+	payload = calloc(1, spdk_bs_get_cluster_size(blob->bs));
+	SPDK_CU_ASSERT_FATAL(payload != NULL);
+	memset(payload, pattern, spdk_bs_get_cluster_size(blob->bs));
+
+	spdk_blob_io_write(blob, channel, payload, cluster_num * io_units_per_cluster,
+			   io_units_per_cluster, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	free(payload);
+}
+
+static void
+ut_ext_dev_check_cluster(struct spdk_bs_dev *ext_dev, struct spdk_io_channel *channel,
+			 uint64_t cluster_num, uint64_t cluster_sz, uint8_t pattern)
+{
+	struct spdk_bs_dev_cb_args ext_args = { .cb_fn = bs_dev_io_complete_cb };
+	uint8_t *expected, *payload;
+
+	expected = calloc(1, cluster_sz);
+	payload = calloc(1, cluster_sz);
+	SPDK_CU_ASSERT_FATAL(expected != NULL && payload != NULL);
+	memset(expected, pattern, cluster_sz);
+
+	ext_dev->read(ext_dev, channel, payload, cluster_num * cluster_sz / ext_dev->blocklen,
+		      cluster_sz / ext_dev->blocklen, &ext_args);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(expected, payload, cluster_sz) == 0);
+
+	free(expected);
+	free(payload);
+}
+
+static void
+blob_diff_copy(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob_opts blob_opts;
+	struct spdk_blob *blob, *snapshot;
+	spdk_blob_id blobid, snapshotid1, snapshotid2, snapshotid3;
+	uint64_t num_clusters = 4;
+	uint64_t cluster_sz = spdk_bs_get_cluster_size(bs);
+	struct spdk_bs_dev *ext_dev;
+	struct spdk_io_channel *bdev_ch, *blob_ch;
+	uint64_t i;
+	int rc;
+
+	blob_ch = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(blob_ch != NULL);
+
+	ut_spdk_blob_opts_init(&blob_opts);
+	blob_opts.thin_provision = true;
+	blob_opts.num_clusters = num_clusters;
+	blob = ut_blob_create_and_open(bs, &blob_opts);
+	SPDK_CU_ASSERT_FATAL(blob != NULL);
+	blobid = spdk_blob_get_id(blob);
+
+	/* snapshot1 holds cluster 0, snapshot2 cluster 1 and snapshot3 cluster 2 */
+	ut_blob_write_cluster(blob, blob_ch, 0, 0x01);
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	snapshotid1 = g_blobid;
+
+	ut_blob_write_cluster(blob, blob_ch, 1, 0x02);
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	snapshotid2 = g_blobid;
+
+	ut_blob_write_cluster(blob, blob_ch, 2, 0x03);
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	snapshotid3 = g_blobid;
+
+	spdk_bs_open_blob(bs, snapshotid3, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
+
+	/* Changed clusters are found through the cluster maps of the lineage */
+	CU_ASSERT(spdk_blob_get_next_changed_cluster(snapshot, snapshotid2, 0) == 2);
+	CU_ASSERT(spdk_blob_get_next_changed_cluster(snapshot, snapshotid1, 0) == 1);
+	CU_ASSERT(spdk_blob_get_next_changed_cluster(snapshot, snapshotid1, 2) == 2);
+	CU_ASSERT(spdk_blob_get_next_changed_cluster(snapshot, snapshotid1, 3) == UINT64_MAX);
+	CU_ASSERT(spdk_blob_get_next_changed_cluster(snapshot, SPDK_BLOBID_INVALID, 0) == 0);
+	CU_ASSERT(spdk_blob_get_next_changed_cluster(blob, snapshotid3, 0) == UINT64_MAX);
+
+	ext_dev = init_ext_dev(num_clusters * cluster_sz / DEV_BUFFER_BLOCKLEN, DEV_BUFFER_BLOCKLEN);
+	bdev_ch = ext_dev->create_channel(ext_dev);
+	SPDK_CU_ASSERT_FATAL(bdev_ch != NULL);
+
+	/* The base must be a snapshot of the blob */
+	rc = spdk_bs_blob_diff_copy(bs, blob_ch, snapshotid3, snapshotid3, ext_dev, 0,
+				    blob_shallow_copy_status_cb, NULL, blob_op_complete, NULL);
+	CU_ASSERT(rc == -EINVAL);
+
+	rc = spdk_bs_blob_diff_copy(bs, blob_ch, snapshotid2, snapshotid3, ext_dev, 0,
+				    blob_shallow_copy_status_cb, NULL, blob_op_complete, NULL);
+	CU_ASSERT(rc == 0);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EINVAL);
+
+	/* The blob must be read only */
+	rc = spdk_bs_blob_diff_copy(bs, blob_ch, blobid, snapshotid1, ext_dev, 0,
+				    blob_shallow_copy_status_cb, NULL, blob_op_complete, NULL);
+	CU_ASSERT(rc == 0);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -EPERM);
+
+	/* Only the clusters written after snapshot1 are copied, two at a time */
+	memset(g_ext_dev_buffer, 0xff, num_clusters * cluster_sz);
+	g_copied_clusters_count = 0;
+	rc = spdk_bs_blob_diff_copy(bs, blob_ch, snapshotid3, snapshotid1, ext_dev, 2,
+				    blob_shallow_copy_status_cb, NULL, blob_op_complete, NULL);
+	CU_ASSERT(rc == 0);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_copied_clusters_count == 2);
+	ut_ext_dev_check_cluster(ext_dev, bdev_ch, 0, cluster_sz, 0xff);
+	ut_ext_dev_check_cluster(ext_dev, bdev_ch, 1, cluster_sz, 0x02);
+	ut_ext_dev_check_cluster(ext_dev, bdev_ch, 2, cluster_sz, 0x03);
+	ut_ext_dev_check_cluster(ext_dev, bdev_ch, 3, cluster_sz, 0xff);
+
+	/* Without a base the whole lineage is copied */
+	memset(g_ext_dev_buffer, 0xff, num_clusters * cluster_sz);
+	g_copied_clusters_count = 0;
+	rc = spdk_bs_blob_diff_copy(bs, blob_ch, snapshotid3, SPDK_BLOBID_INVALID, ext_dev, 0,
+				    blob_shallow_copy_status_cb, NULL, blob_op_complete, NULL);
+	CU_ASSERT(rc == 0);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_copied_clusters_count == 3);
+	for (i = 0; i < 3; i++) {
+		ut_ext_dev_check_cluster(ext_dev, bdev_ch, i, cluster_sz, i + 1);
+	}
+	ut_ext_dev_check_cluster(ext_dev, bdev_ch, 3, cluster_sz, 0xff);
+
+	ext_dev->destroy_channel(ext_dev, bdev_ch);
+	ext_dev->destroy(ext_dev);
+	spdk_blob_close(snapshot, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	spdk_bs_free_io_channel(blob_ch);
+	ut_blob_close_and_delete(bs, blob);
+	poll_threads();
+}
+
 static void
 blob_set_parent(void)
 {
@@ -10276,11 +11899,17 @@ main(int argc, char **argv)
 		CU_ADD_TEST(suite_bs, blob_insert_cluster_msg_test);
 		CU_ADD_TEST(suite_bs, blob_thin_prov_rw);
 		CU_ADD_TEST(suite, blob_thin_prov_write_count_io);
+		CU_ADD_TEST(suite, blob_thin_prov_write_batch_alloc);
+		CU_ADD_TEST(suite, blob_thin_prov_reserved_enospc);
 		CU_ADD_TEST(suite, blob_thin_prov_unmap_cluster);
 		CU_ADD_TEST(suite_bs, blob_thin_prov_rle);
 		CU_ADD_TEST(suite_bs, blob_thin_prov_rw_iov);
 		CU_ADD_TEST(suite, bs_load_iter_test);
+		CU_ADD_TEST(suite, bs_load_md_read_ahead);
 		CU_ADD_TEST(suite_bs, blob_snapshot_rw);
+		CU_ADD_TEST(suite_bs, blob_snapshot_rw_cow_bw_limit);
+		CU_ADD_TEST(suite_bs, blob_snapshot_cow_units);
+		CU_ADD_TEST(suite_bs, blob_cow_units_concurrent);
 		CU_ADD_TEST(suite_bs, blob_snapshot_rw_iov);
 		CU_ADD_TEST(suite, blob_relations);
 		CU_ADD_TEST(suite, blob_relations2);
@@ -10292,6 +11921,12 @@ main(int argc, char **argv)
 		CU_ADD_TEST(suite_bs, blob_snapshot_freeze_io);
 		CU_ADD_TEST(suite_bs, blob_operation_split_rw);
 		CU_ADD_TEST(suite_bs, blob_operation_split_rw_iov);
+		CU_ADD_TEST(suite_bs, blob_operation_contiguous_clusters);
+		CU_ADD_TEST(suite_bs, blob_move_cluster);
+		CU_ADD_TEST(suite_bs, blob_move_cluster_drain);
+		CU_ADD_TEST(suite_bs, blob_move_cluster_sync_fail);
+		CU_ADD_TEST(suite_bs, blob_share_cluster);
+		CU_ADD_TEST(suite_bs, blob_share_cluster_drain);
 		CU_ADD_TEST(suite, blob_io_unit);
 		CU_ADD_TEST(suite, blob_io_unit_compatibility);
 		CU_ADD_TEST(suite_bs, blob_simultaneous_operations);
@@ -10316,6 +11951,7 @@ main(int argc, char **argv)
 		CU_ADD_TEST(suite_bs, blob_clone_resize);
 		CU_ADD_TEST(suite, blob_esnap_clone_resize);
 		CU_ADD_TEST(suite_bs, blob_shallow_copy);
+		CU_ADD_TEST(suite_bs, blob_diff_copy);
 		CU_ADD_TEST(suite_esnap_bs, blob_set_parent);
 		CU_ADD_TEST(suite_esnap_bs, blob_set_external_parent);
 		CU_ADD_TEST(suite_bs, snapshot_checksum);
@@ -13,8 +13,10 @@
 #define DEV_BUFFER_BLOCKCNT (DEV_BUFFER_SIZE / DEV_BUFFER_BLOCKLEN)
 uint8_t *g_dev_buffer;
 uint64_t g_dev_write_bytes;
+uint64_t g_dev_write_ops;
 uint64_t g_dev_write_zeroes_bytes;
 uint64_t g_dev_read_bytes;
+uint64_t g_dev_read_ops;
 uint64_t g_dev_copy_bytes;
 bool g_dev_writev_ext_called;
 bool g_dev_readv_ext_called;
@@ -139,6 +141,7 @@ dev_read(struct spdk_bs_dev *dev, struct spdk_io_channel *channel, void *payload
 		if (length > 0) {
 			memcpy(payload, &g_dev_buffer[offset], length);
 			g_dev_read_bytes += length;
+			g_dev_read_ops++;
 		}
 	} else {
 		g_power_failure_rc = -EIO;
@@ -172,6 +175,7 @@ dev_write(struct spdk_bs_dev *dev, struct spdk_io_channel *channel, void *payloa
 
 		memcpy(&g_dev_buffer[offset], payload, length);
 		g_dev_write_bytes += length;
+		g_dev_write_ops++;
 	} else {
 		g_power_failure_rc = -EIO;
 	}
@@ -223,6 +227,7 @@ dev_readv(struct spdk_bs_dev *dev, struct spdk_io_channel *channel,
 		}
 
 		g_dev_read_bytes += length;
+		g_dev_read_ops++;
 	} else {
 		g_power_failure_rc = -EIO;
 	}
@@ -274,6 +279,7 @@ dev_writev(struct spdk_bs_dev *dev, struct spdk_io_channel *channel,
 		}
 
 		g_dev_write_bytes += length;
+		g_dev_write_ops++;
 	} else {
 		g_power_failure_rc = -EIO;
 	}
@@ -370,6 +376,7 @@ dev_write_zeroes(struct spdk_bs_dev *dev, struct spdk_io_channel *channel,
 		memset(&g_dev_buffer[offset], 0, length);
 		g_dev_write_zeroes_bytes += length;
 		g_dev_write_bytes += length;
+		g_dev_write_ops++;
 	} else {
 		g_power_failure_rc = -EIO;
 	}
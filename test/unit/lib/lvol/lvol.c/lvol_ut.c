@@ -56,6 +56,8 @@ struct spdk_blob {
 	bool			thin_provisioned;
 	struct spdk_bs_dev	*back_bs_dev;
 	uint64_t		num_clusters;
+	/* Location of each cluster on the device, 0 if the cluster is not allocated */
+	uint64_t		clusters[BS_FREE_CLUSTERS];
 };
 
 int g_lvserrno;
@@ -72,6 +74,8 @@ spdk_blob_id g_blobid = 1;
 struct spdk_io_channel *g_io_channel;
 struct lvol_ut_bs_dev g_esnap_dev;
 bool g_checksum_registered = false;
+int g_move_cluster_rc;
+int g_share_cluster_rc;
 
 struct spdk_blob_store {
 	struct spdk_bs_opts	bs_opts;
@@ -79,6 +83,11 @@ struct spdk_blob_store {
 	TAILQ_HEAD(, spdk_blob)	blobs;
 	int			get_super_status;
 	spdk_bs_esnap_dev_create esnap_bs_dev_create;
+	bool			used_clusters[BS_FREE_CLUSTERS];
+	/* Number of additional blobs referencing each cluster */
+	uint32_t		cluster_refs[BS_FREE_CLUSTERS];
+	/* Stands for the data of each cluster */
+	uint64_t		cluster_data[BS_FREE_CLUSTERS];
 };
 
 struct lvol_ut_bs_dev {
@@ -154,6 +163,253 @@ spdk_blob_get_num_clusters(struct spdk_blob *blob)
 	return blob->num_clusters;
 }
 
+uint64_t
+spdk_blob_get_num_allocated_clusters(struct spdk_blob *blob)
+{
+	uint64_t i, num_allocated = 0;
+
+	for (i = 0; i < blob->num_clusters; i++) {
+		if (blob->clusters[i] != 0) {
+			num_allocated++;
+		}
+	}
+
+	return num_allocated;
+}
+
+uint64_t
+spdk_blob_get_num_fragments(struct spdk_blob *blob)
+{
+	uint64_t i, prev = 0, num_fragments = 0;
+
+	for (i = 0; i < blob->num_clusters; i++) {
+		if (blob->clusters[i] == 0) {
+			continue;
+		}
+		if (prev == 0 || blob->clusters[i] != prev + 1) {
+			num_fragments++;
+		}
+		prev = blob->clusters[i];
+	}
+
+	return num_fragments;
+}
+
+uint64_t
+spdk_blob_get_cluster_location(struct spdk_blob *blob, uint64_t cluster_num)
+{
+	if (cluster_num >= blob->num_clusters || blob->clusters[cluster_num] == 0) {
+		return UINT64_MAX;
+	}
+
+	return blob->clusters[cluster_num];
+}
+
+uint64_t
+spdk_bs_find_free_clusters(struct spdk_blob_store *bs, uint64_t start_cluster,
+			   uint64_t num_clusters)
+{
+	uint64_t i, run = 0;
+
+	for (i = start_cluster; i < BS_FREE_CLUSTERS; i++) {
+		run = bs->used_clusters[i] ? 0 : run + 1;
+		if (run == num_clusters) {
+			return i + 1 - num_clusters;
+		}
+	}
+
+	return UINT64_MAX;
+}
+
+struct ut_move_cluster {
+	struct spdk_blob_store	*bs;
+	spdk_blob_id		blobid;
+	uint64_t		cluster_num;
+	uint64_t		dst_cluster;
+	spdk_blob_op_complete	cb_fn;
+	void			*cb_arg;
+};
+
+static void
+ut_move_cluster_msg(void *arg)
+{
+	struct ut_move_cluster *move = arg;
+	struct spdk_blob *blob;
+	int rc = -ENOENT;
+
+	TAILQ_FOREACH(blob, &move->bs->blobs, link) {
+		if (blob->id != move->blobid) {
+			continue;
+		}
+		if (g_move_cluster_rc != 0) {
+			rc = g_move_cluster_rc;
+		} else if (move->cluster_num >= blob->num_clusters ||
+			   blob->clusters[move->cluster_num] == 0) {
+			rc = -EINVAL;
+		} else if (move->bs->used_clusters[move->dst_cluster]) {
+			rc = -EBUSY;
+		} else {
+			move->bs->used_clusters[blob->clusters[move->cluster_num]] = false;
+			move->bs->used_clusters[move->dst_cluster] = true;
+			blob->clusters[move->cluster_num] = move->dst_cluster;
+			rc = 0;
+		}
+		break;
+	}
+
+	move->cb_fn(move->cb_arg, rc);
+	free(move);
+}
+
+void
+spdk_bs_blob_move_cluster(struct spdk_blob_store *bs, spdk_blob_id blobid, uint64_t cluster_num,
+			  uint64_t dst_cluster, spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	struct ut_move_cluster *move;
+
+	move = calloc(1, sizeof(*move));
+	SPDK_CU_ASSERT_FATAL(move != NULL);
+
+	move->bs = bs;
+	move->blobid = blobid;
+	move->cluster_num = cluster_num;
+	move->dst_cluster = dst_cluster;
+	move->cb_fn = cb_fn;
+	move->cb_arg = cb_arg;
+
+	spdk_thread_send_msg(spdk_get_thread(), ut_move_cluster_msg, move);
+}
+
+bool
+spdk_blob_is_cluster_shared(struct spdk_blob *blob, uint64_t cluster_num)
+{
+	return cluster_num < blob->num_clusters && blob->clusters[cluster_num] != 0 &&
+	       blob->bs->cluster_refs[blob->clusters[cluster_num]] != 0;
+}
+
+static struct spdk_blob *
+ut_bs_find_blob(struct spdk_blob_store *bs, spdk_blob_id blobid)
+{
+	struct spdk_blob *blob;
+
+	TAILQ_FOREACH(blob, &bs->blobs, link) {
+		if (blob->id == blobid) {
+			return blob;
+		}
+	}
+
+	return NULL;
+}
+
+struct ut_cluster_op {
+	struct spdk_blob_store	*bs;
+	spdk_blob_id		blobid;
+	uint64_t		cluster_num;
+	spdk_blob_id		src_blobid;
+	uint64_t		src_cluster_num;
+	uint64_t		*fingerprint;
+	spdk_blob_op_complete	cb_fn;
+	void			*cb_arg;
+};
+
+/* The fingerprint only looks at the low byte of the data, so that collisions can be tested */
+static void
+ut_cluster_fingerprint_msg(void *arg)
+{
+	struct ut_cluster_op *op = arg;
+	struct spdk_blob *blob = ut_bs_find_blob(op->bs, op->blobid);
+	int rc = 0;
+
+	if (blob == NULL) {
+		rc = -ENOENT;
+	} else if (op->cluster_num >= blob->num_clusters || blob->clusters[op->cluster_num] == 0) {
+		rc = -EINVAL;
+	} else {
+		*op->fingerprint = op->bs->cluster_data[blob->clusters[op->cluster_num]] & 0xFF;
+	}
+
+	op->cb_fn(op->cb_arg, rc);
+	free(op);
+}
+
+void
+spdk_bs_blob_cluster_fingerprint(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+				 spdk_blob_id blobid, uint64_t cluster_num, uint64_t *fingerprint,
+				 spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	struct ut_cluster_op *op;
+
+	op = calloc(1, sizeof(*op));
+	SPDK_CU_ASSERT_FATAL(op != NULL);
+
+	op->bs = bs;
+	op->blobid = blobid;
+	op->cluster_num = cluster_num;
+	op->fingerprint = fingerprint;
+	op->cb_fn = cb_fn;
+	op->cb_arg = cb_arg;
+
+	spdk_thread_send_msg(spdk_get_thread(), ut_cluster_fingerprint_msg, op);
+}
+
+static void
+ut_share_cluster_msg(void *arg)
+{
+	struct ut_cluster_op *op = arg;
+	struct spdk_blob_store *bs = op->bs;
+	struct spdk_blob *blob = ut_bs_find_blob(bs, op->blobid);
+	struct spdk_blob *src_blob = ut_bs_find_blob(bs, op->src_blobid);
+	uint64_t old, shared;
+	int rc = 0;
+
+	if (blob == NULL || src_blob == NULL) {
+		rc = -ENOENT;
+	} else if (g_share_cluster_rc != 0) {
+		rc = g_share_cluster_rc;
+	} else if (blob->clusters[op->cluster_num] == 0 ||
+		   src_blob->clusters[op->src_cluster_num] == 0) {
+		rc = -EINVAL;
+	} else {
+		old = blob->clusters[op->cluster_num];
+		shared = src_blob->clusters[op->src_cluster_num];
+		if (bs->cluster_data[old] != bs->cluster_data[shared]) {
+			rc = -EILSEQ;
+		} else if (old != shared) {
+			if (bs->cluster_refs[old] != 0) {
+				bs->cluster_refs[old]--;
+			} else {
+				bs->used_clusters[old] = false;
+			}
+			bs->cluster_refs[shared]++;
+			blob->clusters[op->cluster_num] = shared;
+		}
+	}
+
+	op->cb_fn(op->cb_arg, rc);
+	free(op);
+}
+
+void
+spdk_bs_blob_share_cluster(struct spdk_blob_store *bs, spdk_blob_id blobid, uint64_t cluster_num,
+			   spdk_blob_id src_blobid, uint64_t src_cluster_num,
+			   spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	struct ut_cluster_op *op;
+
+	op = calloc(1, sizeof(*op));
+	SPDK_CU_ASSERT_FATAL(op != NULL);
+
+	op->bs = bs;
+	op->blobid = blobid;
+	op->cluster_num = cluster_num;
+	op->src_blobid = src_blobid;
+	op->src_cluster_num = src_cluster_num;
+	op->cb_fn = cb_fn;
+	op->cb_arg = cb_arg;
+
+	spdk_thread_send_msg(spdk_get_thread(), ut_share_cluster_msg, op);
+}
+
 void
 spdk_bs_get_super(struct spdk_blob_store *bs,
 		  spdk_blob_op_with_id_complete cb_fn, void *cb_arg)
@@ -276,6 +532,20 @@ spdk_bs_blob_shallow_copy(struct spdk_blob_store *bs, struct spdk_io_channel *ch
 	return 0;
 }
 
+static spdk_blob_id g_diff_copy_base_id;
+
+int
+spdk_bs_blob_diff_copy(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+		       spdk_blob_id blobid, spdk_blob_id base_blobid,
+		       struct spdk_bs_dev *ext_dev, uint32_t queue_depth,
+		       spdk_blob_shallow_copy_status status_cb_fn, void *status_cb_arg,
+		       spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	g_diff_copy_base_id = base_blobid;
+	cb_fn(cb_arg, 0);
+	return 0;
+}
+
 bool
 spdk_blob_is_snapshot(struct spdk_blob *blob)
 {
@@ -3571,6 +3841,82 @@ lvol_shallow_copy(void)
 	CU_ASSERT(g_io_channel == NULL);
 }
 
+static void
+lvol_diff_copy(void)
+{
+	struct lvol_ut_bs_dev bs_dev;
+	struct spdk_lvs_opts opts;
+	struct spdk_bs_dev ext_dev;
+	struct spdk_lvol *lvol, *snap;
+	int rc = 0;
+
+	init_dev(&bs_dev);
+
+	ext_dev.blocklen = DEV_BUFFER_BLOCKLEN;
+	ext_dev.blockcnt = BS_CLUSTER_SIZE / DEV_BUFFER_BLOCKLEN;
+
+	spdk_lvs_opts_init(&opts);
+	snprintf(opts.name, sizeof(opts.name), "lvs");
+
+	g_lvserrno = -1;
+	rc = spdk_lvs_init(&bs_dev.bs_dev, &opts, lvol_store_op_with_handle_complete, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol_store != NULL);
+
+	spdk_lvol_create(g_lvol_store, "lvol", BS_CLUSTER_SIZE, true, LVOL_CLEAR_WITH_DEFAULT,
+			 lvol_op_with_handle_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	lvol = g_lvol;
+
+	spdk_lvol_create_snapshot(lvol, "snap", lvol_op_with_handle_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	snap = g_lvol;
+
+	/* Diff copy relative to a snapshot */
+	g_blob_read_only = true;
+	rc = spdk_lvol_diff_copy(lvol, snap, &ext_dev, 0, NULL, NULL, op_complete, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvserrno == 0);
+	CU_ASSERT(g_diff_copy_base_id == snap->blob_id);
+
+	/* Diff copy of the whole lineage */
+	rc = spdk_lvol_diff_copy(lvol, NULL, &ext_dev, 0, NULL, NULL, op_complete, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvserrno == 0);
+	CU_ASSERT(g_diff_copy_base_id == SPDK_BLOBID_INVALID);
+
+	/* Diff copy with null lvol */
+	rc = spdk_lvol_diff_copy(NULL, snap, &ext_dev, 0, NULL, NULL, op_complete, NULL);
+	CU_ASSERT(rc == -EINVAL);
+
+	/* Diff copy with null ext_dev */
+	rc = spdk_lvol_diff_copy(lvol, snap, NULL, 0, NULL, NULL, op_complete, NULL);
+	CU_ASSERT(rc == -EINVAL);
+	g_blob_read_only = false;
+
+	spdk_lvol_close(lvol, op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	spdk_lvol_destroy(lvol, op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	spdk_lvol_close(snap, op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	spdk_lvol_destroy(snap, op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+
+	g_lvserrno = -1;
+	rc = spdk_lvs_unload(g_lvol_store, op_complete, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvserrno == 0);
+	g_lvol_store = NULL;
+
+	free_dev(&bs_dev);
+
+	CU_ASSERT(g_io_channel == NULL);
+}
+
 static void
 lvol_set_parent(void)
 {
@@ -3790,6 +4136,344 @@ lvol_snapshot_checksum(void)
 	free_dev(&bs_dev);
 }
 
+static void
+ut_defrag_set_clusters(struct spdk_lvol *lvol, const uint64_t *clusters, uint64_t num_clusters)
+{
+	struct spdk_blob *blob = lvol->blob;
+	uint64_t i;
+
+	for (i = 0; i < num_clusters; i++) {
+		blob->clusters[i] = clusters[i];
+		if (clusters[i] != 0) {
+			blob->bs->used_clusters[clusters[i]] = true;
+		}
+	}
+}
+
+static void
+lvol_defrag(void)
+{
+	struct lvol_ut_bs_dev dev;
+	struct spdk_lvs_opts opts;
+	struct spdk_lvol_store *lvs;
+	struct spdk_blob_store *bs;
+	struct spdk_lvol *lvol1, *lvol2;
+	uint64_t clusters1[] = { 10, 3, 0, 7 };
+	uint64_t clusters2[] = { 20, 21 };
+	uint64_t fragmented1[] = { 4, 9, 0, 12 };
+	uint64_t fragmented2[] = { 20, 23 };
+	uint64_t i;
+	int rc;
+
+	init_dev(&dev);
+
+	spdk_lvs_opts_init(&opts);
+	snprintf(opts.name, sizeof(opts.name), "lvs");
+
+	g_lvserrno = -1;
+	rc = spdk_lvs_init(&dev.bs_dev, &opts, lvol_store_op_with_handle_complete, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol_store != NULL);
+	lvs = g_lvol_store;
+	bs = lvs->blobstore;
+
+	spdk_lvol_create(lvs, "lvol1", 4 * BS_CLUSTER_SIZE, true, LVOL_CLEAR_WITH_DEFAULT,
+			 lvol_op_with_handle_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	lvol1 = g_lvol;
+
+	spdk_lvol_create(lvs, "lvol2", 2 * BS_CLUSTER_SIZE, true, LVOL_CLEAR_WITH_DEFAULT,
+			 lvol_op_with_handle_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	lvol2 = g_lvol;
+
+	/* Clusters 0 and 1 hold the metadata */
+	bs->used_clusters[0] = true;
+	bs->used_clusters[1] = true;
+	ut_defrag_set_clusters(lvol1, clusters1, SPDK_COUNTOF(clusters1));
+	ut_defrag_set_clusters(lvol2, clusters2, SPDK_COUNTOF(clusters2));
+	CU_ASSERT(spdk_blob_get_num_fragments(lvol1->blob) == 3);
+
+	CU_ASSERT(spdk_lvs_defrag_stop(lvs) == -ENOENT);
+
+	/* Without a limit lvol1 is compacted at once into the first free range large enough */
+	rc = spdk_lvs_defrag_start(lvs, 0);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(lvs->defrag != NULL);
+	spdk_delay_us(LVS_DEFRAG_POLL_PERIOD_US);
+	poll_threads();
+	CU_ASSERT(lvs->defrag == NULL);
+	CU_ASSERT(lvol1->blob->clusters[0] == 4);
+	CU_ASSERT(lvol1->blob->clusters[1] == 5);
+	CU_ASSERT(lvol1->blob->clusters[2] == 0);
+	CU_ASSERT(lvol1->blob->clusters[3] == 6);
+	CU_ASSERT(spdk_blob_get_num_fragments(lvol1->blob) == 1);
+	CU_ASSERT(!bs->used_clusters[3] && !bs->used_clusters[7] && !bs->used_clusters[10]);
+	CU_ASSERT(lvol1->defrag_clusters_moved == 3);
+	CU_ASSERT(lvol1->defrag_in_progress == false);
+	CU_ASSERT(lvol2->blob->clusters[0] == 20);
+	CU_ASSERT(lvol2->defrag_clusters_moved == 0);
+
+	/*
+	 * No free range is large enough, clusters are only moved next to their predecessor.
+	 * At 1 MiB/s, one 1 MiB cluster is moved per second.
+	 */
+	for (i = 0; i < BS_FREE_CLUSTERS; i++) {
+		bs->used_clusters[i] = true;
+	}
+	bs->used_clusters[5] = false;
+	bs->used_clusters[6] = false;
+	bs->used_clusters[10] = false;
+	ut_defrag_set_clusters(lvol1, fragmented1, SPDK_COUNTOF(fragmented1));
+
+	rc = spdk_lvs_defrag_start(lvs, 1);
+	CU_ASSERT(rc == 0);
+	spdk_delay_us(LVS_DEFRAG_POLL_PERIOD_US);
+	poll_threads();
+	CU_ASSERT(lvol1->blob->clusters[1] == 5);
+	CU_ASSERT(lvol1->blob->clusters[3] == 12);
+	CU_ASSERT(lvol1->defrag_in_progress == true);
+
+	spdk_delay_us(LVS_DEFRAG_POLL_PERIOD_US);
+	poll_threads();
+	CU_ASSERT(lvol1->blob->clusters[3] == 12);
+
+	spdk_delay_us(SPDK_SEC_TO_USEC);
+	poll_threads();
+	CU_ASSERT(lvol1->blob->clusters[3] == 6);
+	CU_ASSERT(spdk_blob_get_num_fragments(lvol1->blob) == 1);
+	CU_ASSERT(lvol1->defrag_clusters_moved == 5);
+
+	spdk_delay_us(SPDK_SEC_TO_USEC);
+	poll_threads();
+	CU_ASSERT(lvs->defrag == NULL);
+	CU_ASSERT(lvol1->defrag_in_progress == false);
+
+	/* Destroying the lvol being defragmented moves on to the next one */
+	spdk_lvol_close(lvol1, op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+
+	rc = spdk_lvs_defrag_start(lvs, 0);
+	CU_ASSERT(rc == 0);
+	SPDK_CU_ASSERT_FATAL(lvs->defrag != NULL);
+	CU_ASSERT(lvs->defrag->lvol == lvol1);
+	spdk_lvol_destroy(lvol1, op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	CU_ASSERT(lvs->defrag->lvol == lvol2);
+
+	spdk_delay_us(LVS_DEFRAG_POLL_PERIOD_US);
+	poll_threads();
+	CU_ASSERT(lvs->defrag == NULL);
+
+	/* The lvol store can't be unloaded while a cluster is moved, stopping waits for the move */
+	memset(bs->used_clusters, 0, sizeof(bs->used_clusters));
+	bs->used_clusters[0] = true;
+	bs->used_clusters[1] = true;
+	ut_defrag_set_clusters(lvol2, fragmented2, SPDK_COUNTOF(fragmented2));
+
+	rc = spdk_lvs_defrag_start(lvs, 0);
+	CU_ASSERT(rc == 0);
+	spdk_delay_us(LVS_DEFRAG_POLL_PERIOD_US);
+	poll_thread_times(0, 1);
+	SPDK_CU_ASSERT_FATAL(lvs->defrag != NULL);
+	CU_ASSERT(lvs->defrag->move_in_progress == true);
+
+	spdk_lvol_close(lvol2, op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+
+	g_lvserrno = 0;
+	rc = spdk_lvs_unload(lvs, op_complete, NULL);
+	CU_ASSERT(rc == -EBUSY);
+	CU_ASSERT(g_lvserrno == -EBUSY);
+
+	CU_ASSERT(spdk_lvs_defrag_stop(lvs) == 0);
+	CU_ASSERT(lvs->defrag != NULL);
+	CU_ASSERT(spdk_lvs_defrag_start(lvs, 0) == -EBUSY);
+	CU_ASSERT(spdk_lvs_defrag_stop(lvs) == -ENOENT);
+
+	poll_threads();
+	CU_ASSERT(lvs->defrag == NULL);
+	CU_ASSERT(lvol2->defrag_clusters_moved == 1);
+	CU_ASSERT(lvol2->defrag_in_progress == false);
+
+	g_lvserrno = -1;
+	rc = spdk_lvs_unload(lvs, op_complete, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvserrno == 0);
+	g_lvol_store = NULL;
+
+	free_dev(&dev);
+}
+
+static void
+ut_dedup_set_clusters(struct spdk_lvol *lvol, const uint64_t *clusters, const uint64_t *data,
+		      uint64_t num_clusters)
+{
+	struct spdk_blob_store *bs = lvol->blob->bs;
+	uint64_t i;
+
+	ut_defrag_set_clusters(lvol, clusters, num_clusters);
+	for (i = 0; i < num_clusters; i++) {
+		bs->cluster_data[clusters[i]] = data[i];
+	}
+}
+
+static void
+lvol_dedup(void)
+{
+	struct lvol_ut_bs_dev dev;
+	struct spdk_lvs_opts opts;
+	struct spdk_lvol_store *lvs;
+	struct spdk_blob_store *bs;
+	struct spdk_lvol *lvol1, *lvol2, *lvol3;
+	uint64_t clusters1[] = { 10, 11, 0, 12 };
+	uint64_t data1[] = { 0xA, 0xB, 0, 0xA };
+	uint64_t clusters2[] = { 20, 21, 22 };
+	uint64_t data2[] = { 0xB, 0xC, 0xA };
+	uint64_t clusters3[] = { 30 };
+	uint64_t data3[] = { 0xA };
+	uint64_t collide2[] = { 0x10B, 0xC, 0xA };
+	int rc;
+
+	init_dev(&dev);
+	g_blob_read_only = false;
+
+	spdk_lvs_opts_init(&opts);
+	snprintf(opts.name, sizeof(opts.name), "lvs");
+
+	g_lvserrno = -1;
+	rc = spdk_lvs_init(&dev.bs_dev, &opts, lvol_store_op_with_handle_complete, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol_store != NULL);
+	lvs = g_lvol_store;
+	bs = lvs->blobstore;
+
+	spdk_lvol_create(lvs, "lvol1", 4 * BS_CLUSTER_SIZE, true, LVOL_CLEAR_WITH_DEFAULT,
+			 lvol_op_with_handle_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	lvol1 = g_lvol;
+
+	spdk_lvol_create(lvs, "lvol2", 3 * BS_CLUSTER_SIZE, true, LVOL_CLEAR_WITH_DEFAULT,
+			 lvol_op_with_handle_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	lvol2 = g_lvol;
+
+	spdk_lvol_create(lvs, "lvol3", BS_CLUSTER_SIZE, false, LVOL_CLEAR_WITH_DEFAULT,
+			 lvol_op_with_handle_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	lvol3 = g_lvol;
+
+	ut_dedup_set_clusters(lvol1, clusters1, data1, SPDK_COUNTOF(clusters1));
+	ut_dedup_set_clusters(lvol2, clusters2, data2, SPDK_COUNTOF(clusters2));
+	ut_dedup_set_clusters(lvol3, clusters3, data3, SPDK_COUNTOF(clusters3));
+
+	CU_ASSERT(spdk_lvs_dedup_stop(lvs) == -ENOENT);
+
+	/* Without a limit all lvols are scanned at once, the thick provisioned one is skipped */
+	rc = spdk_lvs_dedup_start(lvs, 0);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(lvs->dedup != NULL);
+	spdk_delay_us(LVS_DEDUP_POLL_PERIOD_US);
+	poll_threads();
+	CU_ASSERT(lvs->dedup == NULL);
+	CU_ASSERT(lvol1->blob->clusters[0] == 10);
+	CU_ASSERT(lvol1->blob->clusters[1] == 11);
+	CU_ASSERT(lvol1->blob->clusters[3] == 10);
+	CU_ASSERT(lvol2->blob->clusters[0] == 11);
+	CU_ASSERT(lvol2->blob->clusters[1] == 21);
+	CU_ASSERT(lvol2->blob->clusters[2] == 10);
+	CU_ASSERT(lvol3->blob->clusters[0] == 30);
+	CU_ASSERT(bs->cluster_refs[10] == 2);
+	CU_ASSERT(bs->cluster_refs[11] == 1);
+	CU_ASSERT(!bs->used_clusters[12] && !bs->used_clusters[20] && !bs->used_clusters[22]);
+	CU_ASSERT(spdk_blob_is_cluster_shared(lvol2->blob, 0));
+	CU_ASSERT(!spdk_blob_is_cluster_shared(lvol2->blob, 1));
+	CU_ASSERT(lvs->dedup_scanned_clusters == 6);
+	CU_ASSERT(lvs->dedup_shared_clusters == 3);
+	CU_ASSERT(g_io_channel == NULL);
+
+	/* Clusters with the same fingerprint but different data are not shared */
+	memset(bs->cluster_refs, 0, sizeof(bs->cluster_refs));
+	ut_dedup_set_clusters(lvol1, clusters1, data1, SPDK_COUNTOF(clusters1));
+	ut_dedup_set_clusters(lvol2, clusters2, collide2, SPDK_COUNTOF(clusters2));
+	lvs->dedup_scanned_clusters = 0;
+	lvs->dedup_shared_clusters = 0;
+
+	rc = spdk_lvs_dedup_start(lvs, 0);
+	CU_ASSERT(rc == 0);
+	spdk_delay_us(LVS_DEDUP_POLL_PERIOD_US);
+	poll_threads();
+	CU_ASSERT(lvs->dedup == NULL);
+	CU_ASSERT(lvol2->blob->clusters[0] == 20);
+	CU_ASSERT(lvol2->blob->clusters[2] == 10);
+	CU_ASSERT(bs->used_clusters[20]);
+	CU_ASSERT(lvs->dedup_scanned_clusters == 6);
+	CU_ASSERT(lvs->dedup_shared_clusters == 2);
+
+	/* At 1 MiB/s, one 1 MiB cluster is read or shared per second */
+	memset(bs->cluster_refs, 0, sizeof(bs->cluster_refs));
+	ut_dedup_set_clusters(lvol1, clusters1, data1, SPDK_COUNTOF(clusters1));
+	ut_dedup_set_clusters(lvol2, clusters2, data2, SPDK_COUNTOF(clusters2));
+	lvs->dedup_scanned_clusters = 0;
+
+	rc = spdk_lvs_dedup_start(lvs, 1);
+	CU_ASSERT(rc == 0);
+	spdk_delay_us(LVS_DEDUP_POLL_PERIOD_US);
+	poll_threads();
+	CU_ASSERT(lvs->dedup_scanned_clusters == 1);
+
+	spdk_delay_us(LVS_DEDUP_POLL_PERIOD_US);
+	poll_threads();
+	CU_ASSERT(lvs->dedup_scanned_clusters == 1);
+
+	spdk_delay_us(SPDK_SEC_TO_USEC);
+	poll_threads();
+	CU_ASSERT(lvs->dedup_scanned_clusters == 2);
+
+	/* The lvol store can't be unloaded while a cluster is read, stopping waits for it */
+	spdk_delay_us(SPDK_SEC_TO_USEC);
+	poll_thread_times(0, 1);
+	SPDK_CU_ASSERT_FATAL(lvs->dedup != NULL);
+	CU_ASSERT(lvs->dedup->op_in_progress == true);
+
+	spdk_lvol_close(lvol1, op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	spdk_lvol_close(lvol2, op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	spdk_lvol_close(lvol3, op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+
+	g_lvserrno = 0;
+	rc = spdk_lvs_unload(lvs, op_complete, NULL);
+	CU_ASSERT(rc == -EBUSY);
+	CU_ASSERT(g_lvserrno == -EBUSY);
+
+	CU_ASSERT(spdk_lvs_dedup_stop(lvs) == 0);
+	CU_ASSERT(lvs->dedup != NULL);
+	CU_ASSERT(spdk_lvs_dedup_start(lvs, 0) == -EBUSY);
+	CU_ASSERT(spdk_lvs_dedup_stop(lvs) == -ENOENT);
+
+	poll_threads();
+	CU_ASSERT(lvs->dedup == NULL);
+	CU_ASSERT(lvs->dedup_scanned_clusters == 3);
+	CU_ASSERT(g_io_channel == NULL);
+
+	g_lvserrno = -1;
+	rc = spdk_lvs_unload(lvs, op_complete, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvserrno == 0);
+	g_lvol_store = NULL;
+
+	free_dev(&dev);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -3837,9 +4521,12 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, lvol_esnap_hotplug);
 	CU_ADD_TEST(suite, lvol_get_by);
 	CU_ADD_TEST(suite, lvol_shallow_copy);
+	CU_ADD_TEST(suite, lvol_diff_copy);
 	CU_ADD_TEST(suite, lvol_set_parent);
 	CU_ADD_TEST(suite, lvol_set_external_parent);
 	CU_ADD_TEST(suite, lvol_snapshot_checksum);
+	CU_ADD_TEST(suite, lvol_defrag);
+	CU_ADD_TEST(suite, lvol_dedup);
 
 	allocate_threads(1);
 	set_thread(0);
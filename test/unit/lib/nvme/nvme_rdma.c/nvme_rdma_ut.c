@@ -822,6 +822,7 @@ test_nvme_rdma_req_init(void)
 	rqpair.rdma_qp = (struct spdk_rdma_provider_qp *)0xdeadbeef;
 	rqpair.qpair.ctrlr = &ctrlr;
 	rqpair.cmds = &cmd;
+	rqpair.max_send_sge = NVME_RDMA_DEFAULT_TX_SGE;
 	cmd.sgl[0].address = 0x1111;
 	rdma_req.id = 0;
 	req.cmd.opc = SPDK_NVME_DATA_HOST_TO_CONTROLLER;
@@ -875,6 +876,20 @@ test_nvme_rdma_req_init(void)
 	CU_ASSERT(req.cmd.dptr.sgl1.address == (uint64_t)req.payload.contig_or_cb_arg);
 	CU_ASSERT(rdma_req.send_sgl[0].length == sizeof(struct spdk_nvme_cmd));
 
+	/* icd_supported is false, the send queue has no SGE for in-capsule data */
+	rdma_req.req = NULL;
+	rqpair.qpair.ctrlr->icdoff = 0;
+	rqpair.max_send_sge = 1;
+	req.payload_offset = 0;
+	req.payload_size = 1024;
+	req.payload = NVME_PAYLOAD_CONTIG((void *)0xdeadbeef, NULL);
+	rc = nvme_rdma_req_init(&rqpair, &req, &rdma_req);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(req.cmd.dptr.sgl1.keyed.type == SPDK_NVME_SGL_TYPE_KEYED_DATA_BLOCK);
+	CU_ASSERT(req.cmd.dptr.sgl1.keyed.length == req.payload_size);
+	CU_ASSERT(rdma_req.send_wr.num_sge == 1);
+	rqpair.max_send_sge = NVME_RDMA_DEFAULT_TX_SGE;
+
 	/* case 3: payload_type == NVME_PAYLOAD_TYPE_SGL, expect: pass. */
 	/* icd_supported is true */
 	rdma_req.req = NULL;
@@ -975,16 +990,24 @@ test_nvme_rdma_qpair_init(void)
 	MOCK_SET(spdk_rdma_utils_get_pd, pd);
 	MOCK_SET(spdk_rdma_utils_get_memory_domain, domain);
 
+	/* The controller doesn't support in-capsule data, only the command is sent. */
 	rc = nvme_rdma_qpair_init(&rqpair);
 	CU_ASSERT(rc == 0);
 
 	CU_ASSERT(rqpair.cm_id->context == &rqpair.qpair);
-	CU_ASSERT(rqpair.max_send_sge == NVME_RDMA_DEFAULT_TX_SGE);
+	CU_ASSERT(rqpair.max_send_sge == 1);
 	CU_ASSERT(rqpair.max_recv_sge == NVME_RDMA_DEFAULT_RX_SGE);
 	CU_ASSERT(rqpair.current_num_sends == 0);
 	CU_ASSERT(rqpair.cq == (struct ibv_cq *)0xFEEDBEEF);
 	CU_ASSERT(rqpair.memory_domain == domain);
 
+	/* In-capsule data is supported, an additional SGE is needed for it. */
+	rctrlr.ctrlr.ioccsz_bytes = 4096;
+	rqpair.cq = NULL;
+	rc = nvme_rdma_qpair_init(&rqpair);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(rqpair.max_send_sge == NVME_RDMA_DEFAULT_TX_SGE);
+
 	MOCK_CLEAR(spdk_rdma_utils_get_pd);
 	MOCK_CLEAR(spdk_rdma_utils_get_memory_domain);
 }
@@ -1369,6 +1392,84 @@ test_nvme_rdma_qpair_set_poller(void)
 	CU_ASSERT(rc == 0);
 }
 
+static void
+test_nvme_rdma_poller_srq_recvs(void)
+{
+	struct spdk_nvme_transport_poll_group *tgroup;
+	struct nvme_rdma_poll_group *group;
+	struct nvme_rdma_poller *poller;
+	struct nvme_rdma_rsps *rsps;
+	struct nvme_rdma_qpair rqpair1 = {}, rqpair2 = {};
+	struct rdma_cm_id cm_id = { .verbs = (void *)0xFEEDBEEF };
+	int rc;
+
+	g_spdk_nvme_transport_opts.rdma_srq_size = 4;
+	MOCK_SET(spdk_rdma_utils_get_pd, (struct ibv_pd *)0xFEEDBEEF);
+	MOCK_SET(spdk_rdma_utils_create_mem_map, (struct spdk_rdma_utils_mem_map *)0xDEADBEEF);
+
+	tgroup = nvme_rdma_poll_group_create();
+	SPDK_CU_ASSERT_FATAL(tgroup != NULL);
+	group = nvme_rdma_poll_group(tgroup);
+
+	/* Only the receives required by the first qpair are posted */
+	rqpair1.qpair.poll_group = tgroup;
+	rqpair1.qpair.trtype = SPDK_NVME_TRANSPORT_RDMA;
+	rqpair1.cm_id = &cm_id;
+	rqpair1.num_entries = 3;
+
+	rc = nvme_rdma_qpair_set_poller(&rqpair1.qpair);
+	CU_ASSERT(rc == 0);
+	poller = rqpair1.poller;
+	SPDK_CU_ASSERT_FATAL(poller != NULL);
+	CU_ASSERT(poller->srq == &g_spdk_rdma_srq);
+	rsps = poller->rsps;
+	SPDK_CU_ASSERT_FATAL(rsps != NULL);
+	CU_ASSERT(rqpair1.rsps == rsps);
+	CU_ASSERT(rsps->num_entries == 4);
+	CU_ASSERT(poller->required_num_recvs == 3);
+	CU_ASSERT(rsps->current_num_recvs == 3);
+	CU_ASSERT(poller->free_recv_wrs == &rsps->rsp_recv_wrs[3]);
+
+	/* The second qpair needs more receives than the SRQ has, all of them are posted */
+	rqpair2.qpair.poll_group = tgroup;
+	rqpair2.qpair.trtype = SPDK_NVME_TRANSPORT_RDMA;
+	rqpair2.cm_id = &cm_id;
+	rqpair2.num_entries = 3;
+
+	rc = nvme_rdma_qpair_set_poller(&rqpair2.qpair);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(rqpair2.poller == poller);
+	CU_ASSERT(poller->required_num_recvs == 6);
+	CU_ASSERT(rsps->current_num_recvs == 4);
+	CU_ASSERT(poller->free_recv_wrs == NULL);
+
+	/* The second qpair goes away, completed receives are parked until the SRQ shrank */
+	poller->required_num_recvs -= rqpair2.num_entries;
+	nvme_rdma_poll_group_put_poller(group, poller);
+
+	rsps->current_num_recvs--;
+	nvme_rdma_poller_queue_recv(poller, &rsps->rsp_recv_wrs[0]);
+	CU_ASSERT(rsps->current_num_recvs == 3);
+	CU_ASSERT(poller->free_recv_wrs == &rsps->rsp_recv_wrs[0]);
+
+	rsps->current_num_recvs--;
+	nvme_rdma_poller_queue_recv(poller, &rsps->rsp_recv_wrs[1]);
+	CU_ASSERT(rsps->current_num_recvs == 3);
+	CU_ASSERT(poller->free_recv_wrs == &rsps->rsp_recv_wrs[0]);
+	CU_ASSERT(rsps->rsp_recv_wrs[0].next == NULL);
+
+	rqpair1.qpair.poll_group_tailq_head = &tgroup->disconnected_qpairs;
+	nvme_rdma_poll_group_put_poller(group, poller);
+	CU_ASSERT(STAILQ_EMPTY(&group->pollers));
+
+	rc = nvme_rdma_poll_group_destroy(tgroup);
+	CU_ASSERT(rc == 0);
+
+	g_spdk_nvme_transport_opts.rdma_srq_size = 0;
+	MOCK_CLEAR(spdk_rdma_utils_get_pd);
+	MOCK_CLEAR(spdk_rdma_utils_create_mem_map);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -1399,6 +1500,7 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_nvme_rdma_ctrlr_get_max_sges);
 	CU_ADD_TEST(suite, test_nvme_rdma_poll_group_get_stats);
 	CU_ADD_TEST(suite, test_nvme_rdma_qpair_set_poller);
+	CU_ADD_TEST(suite, test_nvme_rdma_poller_srq_recvs);
 
 	num_failures = spdk_ut_run_tests(argc, argv, NULL);
 	CU_cleanup_registry();
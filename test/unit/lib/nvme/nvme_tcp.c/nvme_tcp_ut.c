@@ -57,6 +57,23 @@ DEFINE_STUB(spdk_memory_domain_translate_data, int,
 	    (struct spdk_memory_domain *src_domain, void *src_domain_ctx,
 	     struct spdk_memory_domain *dst_domain, struct spdk_memory_domain_translation_ctx *dst_domain_ctx,
 	     void *addr, size_t len, struct spdk_memory_domain_translation_result *result), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_free_io_qpair, int, (struct spdk_nvme_qpair *qpair), 0);
+
+static int32_t g_ut_next_qid;
+static uint32_t g_ut_num_free_qid;
+
+int32_t
+spdk_nvme_ctrlr_alloc_qid(struct spdk_nvme_ctrlr *ctrlr)
+{
+	return g_ut_next_qid++;
+}
+
+void
+spdk_nvme_ctrlr_free_qid(struct spdk_nvme_ctrlr *ctrlr, uint16_t qid)
+{
+	g_ut_num_free_qid++;
+}
+
 DEFINE_STUB_V(spdk_memory_domain_invalidate_data, (struct spdk_memory_domain *domain,
 		void *domain_ctx, struct iovec *iov, uint32_t iovcnt));
 
@@ -1335,6 +1352,126 @@ test_nvme_tcp_pdu_payload_handle(void)
 	CU_ASSERT(tqpair.recv_state == NVME_TCP_PDU_RECV_STATE_QUIESCING);
 }
 
+static struct {
+	uint32_t *dst;
+	struct iovec *iovs;
+	uint32_t iovcnt;
+	spdk_nvme_accel_step_cb cb_fn;
+	void *cb_arg;
+	int count;
+} g_ut_append_crc32c;
+
+static int
+ut_append_crc32c(void *ctx, void **seq, uint32_t *dst, struct iovec *iovs, uint32_t iovcnt,
+		 struct spdk_memory_domain *memory_domain, void *domain_ctx,
+		 uint32_t seed, spdk_nvme_accel_step_cb cb_fn, void *cb_arg)
+{
+	g_ut_append_crc32c.dst = dst;
+	g_ut_append_crc32c.iovs = iovs;
+	g_ut_append_crc32c.iovcnt = iovcnt;
+	g_ut_append_crc32c.cb_fn = cb_fn;
+	g_ut_append_crc32c.cb_arg = cb_arg;
+	g_ut_append_crc32c.count++;
+	*seq = (void *)0xDEADBEEF;
+
+	return 0;
+}
+
+static void
+test_nvme_tcp_pdu_payload_handle_multi_pdu_ddgst(void)
+{
+	struct nvme_tcp_qpair	tqpair = {};
+	struct spdk_nvme_tcp_stat	stats = {};
+	struct spdk_nvme_poll_group	group = {};
+	struct nvme_tcp_poll_group	tgroup = { .group.group = &group };
+	struct spdk_nvme_ctrlr	ctrlr = {};
+	struct nvme_tcp_pdu	recv_pdu = {};
+	struct nvme_tcp_req	*tcp_req;
+	struct nvme_request	req = {};
+	struct nvme_tcp_recv_ddgst *ddgst;
+	uint8_t			data[2048] = {};
+	uint32_t		crc32c, reaped = 0;
+	int			rc;
+
+	ctrlr.opts.data_digest = true;
+	tqpair.qpair.ctrlr = &ctrlr;
+	tqpair.qpair.poll_group = &tgroup.group;
+	tqpair.qpair.state = NVME_QPAIR_CONNECTED;
+	tqpair.qpair.id = 1;
+	tqpair.num_entries = 1;
+	tqpair.stats = &stats;
+	group.accel_fn_table.append_crc32c = ut_append_crc32c;
+
+	rc = nvme_tcp_alloc_reqs(&tqpair);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	SPDK_CU_ASSERT_FATAL(tqpair.recv_ddgsts != NULL);
+	tcp_req = &tqpair.tcp_reqs[0];
+	tcp_req->req = &req;
+	tcp_req->state = NVME_TCP_REQ_ACTIVE;
+	req.payload_size = sizeof(data);
+	req.qpair = &tqpair.qpair;
+
+	/* The first out of two C2H PDUs: digest is chained to the request's sequence */
+	tqpair.recv_pdu = &recv_pdu;
+	tqpair.recv_state = NVME_TCP_PDU_RECV_STATE_AWAIT_PDU_PAYLOAD;
+	recv_pdu.req = tcp_req;
+	recv_pdu.ddgst_enable = true;
+	recv_pdu.hdr.common.pdu_type = SPDK_NVME_TCP_PDU_TYPE_C2H_DATA;
+	recv_pdu.data_len = sizeof(data) / 2;
+	recv_pdu.data_iov[0].iov_base = data;
+	recv_pdu.data_iov[0].iov_len = sizeof(data) / 2;
+	recv_pdu.data_iovcnt = 1;
+	crc32c = nvme_tcp_pdu_calc_data_digest(&recv_pdu) ^ SPDK_CRC32C_XOR;
+	MAKE_DIGEST_WORD(recv_pdu.data_digest, crc32c);
+
+	nvme_tcp_pdu_payload_handle(&tqpair, &reaped);
+	CU_ASSERT(tqpair.recv_state == NVME_TCP_PDU_RECV_STATE_AWAIT_PDU_READY);
+	CU_ASSERT(g_ut_append_crc32c.count == 1);
+	CU_ASSERT(req.accel_sequence == (void *)0xDEADBEEF);
+	ddgst = g_ut_append_crc32c.cb_arg;
+	SPDK_CU_ASSERT_FATAL(ddgst != NULL);
+	CU_ASSERT(ddgst->treq == tcp_req);
+	CU_ASSERT(g_ut_append_crc32c.dst == &ddgst->crc32c);
+	CU_ASSERT(g_ut_append_crc32c.iovs == ddgst->iov);
+	CU_ASSERT(g_ut_append_crc32c.iovcnt == 1);
+	CU_ASSERT(ddgst->iov[0].iov_base == data);
+	CU_ASSERT(STAILQ_FIRST(&tqpair.free_recv_ddgsts) != ddgst);
+
+	/* Simulate the execution of the sequence with a matching digest */
+	ddgst->crc32c = nvme_tcp_pdu_calc_data_digest(&recv_pdu);
+	g_ut_append_crc32c.cb_fn(g_ut_append_crc32c.cb_arg);
+	CU_ASSERT(tcp_req->rsp.status.sc == SPDK_NVME_SC_SUCCESS);
+	CU_ASSERT(STAILQ_FIRST(&tqpair.free_recv_ddgsts) == ddgst);
+
+	/* The second PDU with a corrupted digest */
+	tqpair.recv_state = NVME_TCP_PDU_RECV_STATE_AWAIT_PDU_PAYLOAD;
+	recv_pdu.data_iov[0].iov_base = data + sizeof(data) / 2;
+	recv_pdu.data_digest[0] ^= 0xff;
+
+	nvme_tcp_pdu_payload_handle(&tqpair, &reaped);
+	CU_ASSERT(g_ut_append_crc32c.count == 2);
+	ddgst = g_ut_append_crc32c.cb_arg;
+	ddgst->crc32c = nvme_tcp_pdu_calc_data_digest(&recv_pdu);
+	g_ut_append_crc32c.cb_fn(g_ut_append_crc32c.cb_arg);
+	CU_ASSERT(tcp_req->rsp.status.sc == SPDK_NVME_SC_COMMAND_TRANSIENT_TRANSPORT_ERROR);
+	CU_ASSERT(STAILQ_FIRST(&tqpair.free_recv_ddgsts) == ddgst);
+
+	/* No digest contexts left: the digest is calculated in place */
+	STAILQ_INIT(&tqpair.free_recv_ddgsts);
+	tqpair.recv_state = NVME_TCP_PDU_RECV_STATE_AWAIT_PDU_PAYLOAD;
+	tcp_req->rsp.status.sc = SPDK_NVME_SC_SUCCESS;
+	recv_pdu.data_digest[0] ^= 0xff;
+
+	nvme_tcp_pdu_payload_handle(&tqpair, &reaped);
+	CU_ASSERT(g_ut_append_crc32c.count == 2);
+	CU_ASSERT(tcp_req->rsp.status.sc == SPDK_NVME_SC_SUCCESS);
+	CU_ASSERT(tqpair.recv_state == NVME_TCP_PDU_RECV_STATE_AWAIT_PDU_READY);
+
+	nvme_tcp_free_reqs(&tqpair);
+	CU_ASSERT(tqpair.recv_ddgsts == NULL);
+	memset(&g_ut_append_crc32c, 0, sizeof(g_ut_append_crc32c));
+}
+
 static void
 test_nvme_tcp_capsule_resp_hdr_handle(void)
 {
@@ -1919,6 +2056,111 @@ test_nvme_tcp_qpair_submit_request(void)
 	free(tctrlr);
 }
 
+static void
+test_nvme_tcp_qpair_striping(void)
+{
+	struct nvme_tcp_ctrlr tctrlr = {};
+	struct spdk_nvme_ctrlr *ctrlr = &tctrlr.ctrlr;
+	struct spdk_nvme_io_qpair_opts opts = {
+		.io_queue_size = 4,
+		.qprio = SPDK_NVME_QPRIO_URGENT,
+		.io_queue_requests = 4,
+		.num_connections = 3,
+	};
+	struct spdk_nvme_tcp_stat stats = {};
+	struct nvme_request req[4] = {};
+	struct spdk_nvme_qpair *qpair;
+	struct nvme_tcp_qpair *tqpair, *conn0, *conn1;
+	uint32_t i;
+	int rc;
+
+	ctrlr->trid.priority = 1;
+	ctrlr->trid.adrfam = SPDK_NVMF_ADRFAM_IPV4;
+	memcpy(ctrlr->trid.traddr, "192.168.1.78", sizeof("192.168.1.78"));
+	memcpy(ctrlr->trid.trsvcid, "23", sizeof("23"));
+
+	/* Create a qpair striped across 3 connections */
+	g_ut_next_qid = 2;
+	g_ut_num_free_qid = 0;
+	qpair = nvme_tcp_ctrlr_create_io_qpair(ctrlr, 1, &opts);
+	SPDK_CU_ASSERT_FATAL(qpair != NULL);
+	tqpair = nvme_tcp_qpair(qpair);
+	CU_ASSERT(tqpair->num_entries == 3);
+	CU_ASSERT(tqpair->cid_base == 0);
+	SPDK_CU_ASSERT_FATAL(tqpair->num_conns == 2);
+	conn0 = tqpair->conns[0];
+	conn1 = tqpair->conns[1];
+	CU_ASSERT(conn0->parent == tqpair);
+	CU_ASSERT(conn1->parent == tqpair);
+	CU_ASSERT(conn0->qpair.id == 2);
+	CU_ASSERT(conn1->qpair.id == 3);
+	CU_ASSERT(conn0->sock != NULL);
+	CU_ASSERT(conn1->sock != NULL);
+
+	/* CIDs are unique across all connections */
+	CU_ASSERT(conn0->cid_base == 3);
+	CU_ASSERT(conn1->cid_base == 6);
+	CU_ASSERT(conn1->tcp_reqs[2].cid == 8);
+	CU_ASSERT(get_nvme_active_req_by_cid(conn0, 3) == NULL);
+	conn0->tcp_reqs[0].state = NVME_TCP_REQ_ACTIVE;
+	CU_ASSERT(get_nvme_active_req_by_cid(conn0, 3) == &conn0->tcp_reqs[0]);
+	CU_ASSERT(get_nvme_active_req_by_cid(conn0, 0) == NULL);
+	CU_ASSERT(get_nvme_active_req_by_cid(conn0, 6) == NULL);
+	conn0->tcp_reqs[0].state = NVME_TCP_REQ_FREE;
+
+	tqpair->stats = conn0->stats = conn1->stats = &stats;
+	tqpair->shared_stats = conn0->shared_stats = conn1->shared_stats = true;
+	for (i = 0; i < SPDK_COUNTOF(req); i++) {
+		req[i].qpair = qpair;
+		req[i].cb_fn = ut_nvme_complete_request;
+		req[i].payload = NVME_PAYLOAD_CONTIG(NULL, NULL);
+		req[i].cmd.opc = SPDK_NVME_OPC_FLUSH;
+	}
+
+	/* Until the qpair is running, requests are sent on its own connection */
+	tqpair->state = NVME_TCP_QPAIR_STATE_FABRIC_CONNECT_POLL;
+	rc = nvme_tcp_qpair_submit_request(qpair, &req[0]);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(req[0].cmd.cid < 3);
+	CU_ASSERT(tqpair->qpair.queue_depth == 1);
+
+	/* Connections that aren't running are skipped, the least loaded one is picked */
+	tqpair->state = NVME_TCP_QPAIR_STATE_RUNNING;
+	conn0->state = NVME_TCP_QPAIR_STATE_RUNNING;
+	nvme_qpair_set_state(&conn0->qpair, NVME_QPAIR_CONNECTED);
+	rc = nvme_tcp_qpair_submit_request(qpair, &req[1]);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(req[1].cmd.cid == 3);
+	CU_ASSERT(conn0->qpair.queue_depth == 1);
+	CU_ASSERT(TAILQ_FIRST(&conn0->outstanding_reqs)->req == &req[1]);
+	CU_ASSERT(stats.striped_requests == 1);
+
+	conn1->state = NVME_TCP_QPAIR_STATE_RUNNING;
+	nvme_qpair_set_state(&conn1->qpair, NVME_QPAIR_CONNECTED);
+	rc = nvme_tcp_qpair_submit_request(qpair, &req[2]);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(req[2].cmd.cid == 6);
+	CU_ASSERT(conn1->qpair.queue_depth == 1);
+	CU_ASSERT(stats.striped_requests == 2);
+
+	/* With equal load, the connections are used in a round-robin fashion */
+	rc = nvme_tcp_qpair_submit_request(qpair, &req[3]);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(req[3].cmd.cid < 3);
+	CU_ASSERT(tqpair->qpair.queue_depth == 2);
+	CU_ASSERT(stats.striped_requests == 2);
+	CU_ASSERT(stats.submitted_requests == 4);
+
+	/* Requests outstanding on any of the connections are visited */
+	CU_ASSERT(!nvme_tcp_qpair_outstanding_empty(tqpair));
+
+	/* Deleting the qpair aborts the requests on all connections and releases their qids */
+	qpair->num_outstanding_reqs = 4;
+	rc = nvme_tcp_ctrlr_delete_io_qpair(ctrlr, qpair);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_ut_num_free_qid == 2);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -1947,6 +2189,7 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_nvme_tcp_c2h_payload_handle);
 	CU_ADD_TEST(suite, test_nvme_tcp_icresp_handle);
 	CU_ADD_TEST(suite, test_nvme_tcp_pdu_payload_handle);
+	CU_ADD_TEST(suite, test_nvme_tcp_pdu_payload_handle_multi_pdu_ddgst);
 	CU_ADD_TEST(suite, test_nvme_tcp_capsule_resp_hdr_handle);
 	CU_ADD_TEST(suite, test_nvme_tcp_ctrlr_connect_qpair);
 	CU_ADD_TEST(suite, test_nvme_tcp_ctrlr_disconnect_qpair);
@@ -1955,6 +2198,7 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_nvme_tcp_poll_group_get_stats);
 	CU_ADD_TEST(suite, test_nvme_tcp_ctrlr_construct);
 	CU_ADD_TEST(suite, test_nvme_tcp_qpair_submit_request);
+	CU_ADD_TEST(suite, test_nvme_tcp_qpair_striping);
 
 	num_failures = spdk_ut_run_tests(argc, argv, NULL);
 	CU_cleanup_registry();
@@ -228,6 +228,27 @@ DEFINE_STUB(spdk_nvmf_subsystem_get_nqn, const char *,
 DEFINE_STUB(spdk_bdev_io_type_supported, bool,
 	    (struct spdk_bdev *bdev, enum spdk_bdev_io_type io_type), false);
 
+DEFINE_STUB(nvmf_bdev_ctrlr_cached_read_cmd,
+	    int,
+	    (struct spdk_bdev *bdev, struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+	     struct spdk_nvmf_request *req, struct nvmf_ns_read_cache_shard *shard),
+	    0);
+
+DEFINE_STUB(nvmf_bdev_ctrlr_cached_zcopy_start,
+	    int,
+	    (struct spdk_bdev *bdev, struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+	     struct spdk_nvmf_request *req, struct nvmf_ns_read_cache_shard *shard),
+	    0);
+
+DEFINE_STUB(nvmf_ns_read_cache_cmd_modifies, bool, (const struct spdk_nvme_cmd *cmd), false);
+
+DEFINE_STUB_V(nvmf_ns_read_cache_invalidate,
+	      (struct nvmf_ns_read_cache *cache, const struct spdk_nvme_cmd *cmd));
+DEFINE_STUB(nvmf_qos_admit, bool, (struct spdk_nvmf_poll_group *group,
+				   struct spdk_nvmf_subsystem_poll_group *sgroup, struct spdk_nvmf_request *req), true);
+DEFINE_STUB_V(nvmf_telemetry_record, (struct spdk_nvmf_subsystem_poll_group *sgroup,
+				      struct spdk_nvmf_request *req));
+
 void
 nvmf_qpair_set_state(struct spdk_nvmf_qpair *qpair, enum spdk_nvmf_qpair_state state)
 {
@@ -509,6 +530,7 @@ test_connect(void)
 	subsystem.thread = spdk_get_thread();
 	subsystem.id = 1;
 	TAILQ_INIT(&subsystem.ctrlrs);
+	TAILQ_INIT(&subsystem.host_states);
 	subsystem.tgt = &tgt;
 	subsystem.subtype = SPDK_NVMF_SUBTYPE_NVME;
 	subsystem.state = SPDK_NVMF_SUBSYSTEM_ACTIVE;
@@ -948,6 +970,7 @@ test_connect(void)
 	MOCK_CLEAR(spdk_nvmf_tgt_find_subsystem);
 	MOCK_CLEAR(spdk_nvmf_poll_group_create);
 
+	nvmf_ctrlr_free_host_states(&subsystem);
 	spdk_bit_array_free(&ctrlr.qpair_mask);
 	free(sgroups);
 }
@@ -2580,6 +2603,7 @@ test_nvmf_ctrlr_create_destruct(void)
 	subsystem.thread = spdk_get_thread();
 	subsystem.id = 1;
 	TAILQ_INIT(&subsystem.ctrlrs);
+	TAILQ_INIT(&subsystem.host_states);
 	subsystem.tgt = &tgt;
 	subsystem.subtype = SPDK_NVMF_SUBTYPE_NVME;
 	subsystem.state = SPDK_NVMF_SUBSYSTEM_ACTIVE;
@@ -2643,6 +2667,7 @@ test_nvmf_ctrlr_create_destruct(void)
 	poll_threads();
 	CU_ASSERT(TAILQ_EMPTY(&subsystem.ctrlrs));
 	CU_ASSERT(TAILQ_EMPTY(&qpair.outstanding));
+	nvmf_ctrlr_free_host_states(&subsystem);
 }
 
 static void
@@ -3377,6 +3402,75 @@ test_nvmf_ctrlr_ns_attachment(void)
 	free(subsystem.ns);
 }
 
+static void
+test_nvmf_ctrlr_host_state_cache(void)
+{
+	struct spdk_nvmf_subsystem subsystem = {};
+	struct spdk_nvmf_ns ns1 = { .nsid = 1, .always_visible = false };
+	struct spdk_nvmf_ns ns2 = { .nsid = 2, .always_visible = true };
+	struct spdk_nvmf_ctrlr ctrlr = { .subsys = &subsystem };
+	struct nvmf_ctrlr_host_state *state;
+	struct spdk_nvmf_host *host;
+
+	subsystem.max_nsid = 2;
+	subsystem.ns = calloc(subsystem.max_nsid, sizeof(subsystem.ns));
+	SPDK_CU_ASSERT_FATAL(subsystem.ns != NULL);
+	subsystem.ns[0] = &ns1;
+	subsystem.ns[1] = &ns2;
+	TAILQ_INIT(&ns1.hosts);
+	TAILQ_INIT(&subsystem.host_states);
+
+	snprintf(ctrlr.hostnqn, sizeof(ctrlr.hostnqn), "nqn.2016-06.io.spdk:host1");
+	spdk_uuid_generate(&ctrlr.hostid);
+	ctrlr.visible_ns = spdk_bit_array_create(subsystem.max_nsid);
+	SPDK_CU_ASSERT_FATAL(ctrlr.visible_ns != NULL);
+
+	/* The first controller of the host computes the state and caches it */
+	CU_ASSERT(!nvmf_ctrlr_init_ns_state(&ctrlr));
+	CU_ASSERT(!spdk_bit_array_get(ctrlr.visible_ns, 0));
+	CU_ASSERT(spdk_bit_array_get(ctrlr.visible_ns, 1));
+	CU_ASSERT(subsystem.num_host_states == 1);
+	state = TAILQ_FIRST(&subsystem.host_states);
+	SPDK_CU_ASSERT_FATAL(state != NULL);
+	CU_ASSERT(state->ns_gen == 0);
+
+	/* Attach namespace 1 behind the cache's back, the next controller reuses the cached mask */
+	host = calloc(1, sizeof(*host));
+	SPDK_CU_ASSERT_FATAL(host != NULL);
+	snprintf(host->nqn, sizeof(host->nqn), "%s", ctrlr.hostnqn);
+	TAILQ_INSERT_HEAD(&ns1.hosts, host, link);
+	spdk_bit_array_clear_mask(ctrlr.visible_ns);
+	CU_ASSERT(!nvmf_ctrlr_init_ns_state(&ctrlr));
+	CU_ASSERT(!spdk_bit_array_get(ctrlr.visible_ns, 0));
+	CU_ASSERT(spdk_bit_array_get(ctrlr.visible_ns, 1));
+	CU_ASSERT(subsystem.num_host_states == 1);
+
+	/* Once the namespace generation changes, the state is recomputed */
+	subsystem.ns_gen++;
+	spdk_bit_array_clear_mask(ctrlr.visible_ns);
+	CU_ASSERT(!nvmf_ctrlr_init_ns_state(&ctrlr));
+	CU_ASSERT(spdk_bit_array_get(ctrlr.visible_ns, 0));
+	CU_ASSERT(spdk_bit_array_get(ctrlr.visible_ns, 1));
+	CU_ASSERT(subsystem.num_host_states == 1);
+	CU_ASSERT(TAILQ_FIRST(&subsystem.host_states)->ns_gen == 1);
+
+	/* A different host ID gets its own entry */
+	spdk_uuid_generate(&ctrlr.hostid);
+	spdk_bit_array_clear_mask(ctrlr.visible_ns);
+	CU_ASSERT(!nvmf_ctrlr_init_ns_state(&ctrlr));
+	CU_ASSERT(spdk_bit_array_get(ctrlr.visible_ns, 0));
+	CU_ASSERT(subsystem.num_host_states == 2);
+
+	nvmf_ctrlr_free_host_states(&subsystem);
+	CU_ASSERT(TAILQ_EMPTY(&subsystem.host_states));
+	CU_ASSERT(subsystem.num_host_states == 0);
+
+	TAILQ_REMOVE(&ns1.hosts, host, link);
+	free(host);
+	spdk_bit_array_free(&ctrlr.visible_ns);
+	free(subsystem.ns);
+}
+
 static void
 test_nvmf_check_qpair_active(void)
 {
@@ -3479,6 +3573,7 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_nvmf_ctrlr_get_features_host_behavior_support);
 	CU_ADD_TEST(suite, test_nvmf_ctrlr_set_features_host_behavior_support);
 	CU_ADD_TEST(suite, test_nvmf_ctrlr_ns_attachment);
+	CU_ADD_TEST(suite, test_nvmf_ctrlr_host_state_cache);
 	CU_ADD_TEST(suite, test_nvmf_check_qpair_active);
 
 	allocate_threads(1);
@@ -234,6 +234,27 @@ DEFINE_STUB(spdk_bdev_copy_blocks, int,
 
 DEFINE_STUB(spdk_bdev_get_max_copy, uint32_t, (const struct spdk_bdev *bdev), 0);
 
+DEFINE_STUB(nvmf_ns_read_cache_read, bool,
+	    (struct nvmf_ns_read_cache_shard *shard, uint64_t start_lba, uint64_t num_blocks,
+	     struct iovec *iovs, int iovcnt), false);
+
+DEFINE_STUB(nvmf_ns_read_cache_get, int,
+	    (struct nvmf_ns_read_cache_shard *shard, uint64_t start_lba, uint64_t num_blocks,
+	     struct iovec *iovs, int iovcnt), 0);
+
+DEFINE_STUB_V(nvmf_ns_read_cache_put,
+	      (struct nvmf_ns_read_cache_shard *shard, struct iovec *iovs, int iovcnt));
+
+DEFINE_STUB(nvmf_ns_read_cache_fill_start, struct nvmf_ns_read_cache_fill *,
+	    (struct nvmf_ns_read_cache_shard *shard, struct spdk_nvmf_request *req,
+	     uint64_t start_lba, uint64_t num_blocks), NULL);
+
+DEFINE_STUB(nvmf_ns_read_cache_fill_get_req, struct spdk_nvmf_request *,
+	    (struct nvmf_ns_read_cache_fill *fill), NULL);
+
+DEFINE_STUB_V(nvmf_ns_read_cache_fill_done,
+	      (struct nvmf_ns_read_cache_fill *fill, bool success, struct iovec *iovs, int iovcnt));
+
 struct spdk_nvmf_ns *
 spdk_nvmf_subsystem_get_ns(struct spdk_nvmf_subsystem *subsystem, uint32_t nsid)
 {
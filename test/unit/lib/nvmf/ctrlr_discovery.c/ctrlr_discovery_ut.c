@@ -88,6 +88,12 @@ DEFINE_STUB(nvmf_auth_is_supported, bool, (void), false);
 DEFINE_STUB(spdk_bdev_get_nvme_ctratt, union spdk_bdev_nvme_ctratt,
 	    (struct spdk_bdev *bdev), {});
 DEFINE_STUB(nvmf_tgt_update_mdns_prr, int, (struct spdk_nvmf_tgt *tgt), 0);
+DEFINE_STUB(nvmf_ns_read_cache_create, struct nvmf_ns_read_cache *,
+	    (struct spdk_bdev *bdev, uint32_t size_mb), NULL);
+DEFINE_STUB_V(nvmf_ns_read_cache_destroy, (struct nvmf_ns_read_cache *cache));
+DEFINE_STUB_V(nvmf_subsystem_qos_free, (struct spdk_nvmf_subsystem *subsystem));
+DEFINE_STUB_V(nvmf_subsystem_telemetry_free, (struct spdk_nvmf_subsystem *subsystem));
+DEFINE_STUB_V(nvmf_ctrlr_free_host_states, (struct spdk_nvmf_subsystem *subsystem));
 
 const char *
 spdk_bdev_get_name(const struct spdk_bdev *bdev)
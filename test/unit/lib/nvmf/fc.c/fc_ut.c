@@ -39,6 +39,27 @@ DEFINE_STUB(spdk_nvme_transport_id_compare, int,
 	     const struct spdk_nvme_transport_id *trid2), 0);
 DEFINE_STUB(spdk_bdev_get_name, const char *, (const struct spdk_bdev *bdev), "fc_ut_test");
 DEFINE_STUB_V(nvmf_ctrlr_destruct, (struct spdk_nvmf_ctrlr *ctrlr));
+DEFINE_STUB(nvmf_ns_read_cache_shard_create, struct nvmf_ns_read_cache_shard *,
+	    (struct nvmf_ns_read_cache *cache, uint32_t num_shards), NULL);
+DEFINE_STUB_V(nvmf_ns_read_cache_shard_destroy, (struct nvmf_ns_read_cache_shard *shard));
+DEFINE_STUB(nvmf_ns_read_cache_create, struct nvmf_ns_read_cache *,
+	    (struct spdk_bdev *bdev, uint32_t size_mb), NULL);
+DEFINE_STUB_V(nvmf_ns_read_cache_destroy, (struct nvmf_ns_read_cache *cache));
+DEFINE_STUB(nvmf_poll_group_qos_update, int, (struct spdk_nvmf_subsystem_poll_group *sgroup,
+		struct spdk_nvmf_subsystem *subsystem), 0);
+DEFINE_STUB_V(nvmf_poll_group_qos_destroy, (struct spdk_nvmf_subsystem_poll_group *sgroup));
+DEFINE_STUB_V(nvmf_poll_group_qos_dump_stat, (struct spdk_nvmf_poll_group *group,
+		struct spdk_json_write_ctx *w));
+DEFINE_STUB_V(nvmf_subsystem_qos_write_config_json, (struct spdk_nvmf_subsystem *subsystem,
+		struct spdk_json_write_ctx *w));
+DEFINE_STUB_V(nvmf_poll_group_telemetry_update, (struct spdk_nvmf_subsystem_poll_group *sgroup,
+		struct spdk_nvmf_subsystem *subsystem));
+DEFINE_STUB_V(nvmf_poll_group_telemetry_destroy, (struct spdk_nvmf_subsystem_poll_group *sgroup));
+DEFINE_STUB_V(nvmf_subsystem_telemetry_write_config_json, (struct spdk_nvmf_subsystem *subsystem,
+		struct spdk_json_write_ctx *w));
+DEFINE_STUB_V(nvmf_subsystem_qos_free, (struct spdk_nvmf_subsystem *subsystem));
+DEFINE_STUB_V(nvmf_subsystem_telemetry_free, (struct spdk_nvmf_subsystem *subsystem));
+DEFINE_STUB_V(nvmf_ctrlr_free_host_states, (struct spdk_nvmf_subsystem *subsystem));
 DEFINE_STUB_V(nvmf_qpair_free_aer, (struct spdk_nvmf_qpair *qpair));
 DEFINE_STUB_V(nvmf_qpair_abort_pending_zcopy_reqs, (struct spdk_nvmf_qpair *qpair));
 DEFINE_STUB(spdk_bdev_get_io_channel, struct spdk_io_channel *, (struct spdk_bdev_desc *desc),
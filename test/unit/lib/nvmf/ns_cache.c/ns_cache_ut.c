@@ -0,0 +1,409 @@
+/*   SPDX-License-Identifier: BSD-3-Clause
+ *   Copyright (C) 2026 agent. All rights reserved.
+ */
+
+#include "spdk/stdinc.h"
+#include "spdk_internal/cunit.h"
+#include "common/lib/test_env.c"
+#include "spdk/util.h"
+
+/* Lets a test run a modifying command in the middle of nvmf_ns_read_cache_fill_done() */
+size_t ut_iov_xfer_to_buf(struct spdk_iov_xfer *ix, const void *buf, size_t buf_len);
+#define spdk_iov_xfer_to_buf ut_iov_xfer_to_buf
+#include "nvmf/ns_cache.c"
+#undef spdk_iov_xfer_to_buf
+#include "spdk/bdev_module.h"
+
+#define BLOCK_SIZE	512
+#define LINE_BLOCKS	(NVMF_NS_READ_CACHE_LINE_SIZE / BLOCK_SIZE)
+#define NUM_LINES	NVMF_NS_READ_CACHE_MIN_LINES
+
+uint32_t
+spdk_bdev_get_block_size(const struct spdk_bdev *bdev)
+{
+	return bdev->blocklen;
+}
+
+uint32_t
+spdk_bdev_get_md_size(const struct spdk_bdev *bdev)
+{
+	return bdev->md_len;
+}
+
+const char *
+spdk_bdev_get_name(const struct spdk_bdev *bdev)
+{
+	return bdev->name;
+}
+
+static void (*g_xfer_to_buf_hook)(void);
+
+size_t
+ut_iov_xfer_to_buf(struct spdk_iov_xfer *ix, const void *buf, size_t buf_len)
+{
+	void (*hook)(void) = g_xfer_to_buf_hook;
+	size_t rc;
+
+	rc = spdk_iov_xfer_to_buf(ix, buf, buf_len);
+	g_xfer_to_buf_hook = NULL;
+	if (hook != NULL) {
+		hook();
+	}
+
+	return rc;
+}
+
+static struct spdk_bdev g_bdev = {
+	.name = "ns_cache_ut",
+	.blocklen = BLOCK_SIZE,
+};
+
+/* Backing data, each block filled with the low byte of its LBA + 1 */
+static uint8_t g_data[(NUM_LINES + 1) * NVMF_NS_READ_CACHE_LINE_SIZE];
+
+static void
+init_data(void)
+{
+	uint64_t lba;
+
+	for (lba = 0; lba < sizeof(g_data) / BLOCK_SIZE; lba++) {
+		memset(&g_data[lba * BLOCK_SIZE], (uint8_t)(lba + 1), BLOCK_SIZE);
+	}
+}
+
+static struct nvmf_ns_read_cache_shard *
+create_shard(struct nvmf_ns_read_cache **cache)
+{
+	struct nvmf_ns_read_cache_shard *shard;
+
+	/* Anything below the minimum gives NUM_LINES lines per shard */
+	*cache = nvmf_ns_read_cache_create(&g_bdev, 1);
+	SPDK_CU_ASSERT_FATAL(*cache != NULL);
+	shard = nvmf_ns_read_cache_shard_create(*cache, 4);
+	SPDK_CU_ASSERT_FATAL(shard != NULL);
+	CU_ASSERT(shard->num_lines == NUM_LINES);
+
+	return shard;
+}
+
+static void
+destroy_shard(struct nvmf_ns_read_cache *cache, struct nvmf_ns_read_cache_shard *shard)
+{
+	nvmf_ns_read_cache_shard_destroy(shard);
+	nvmf_ns_read_cache_destroy(cache);
+}
+
+/* Complete a read of the backing data through the cache */
+static void
+fill(struct nvmf_ns_read_cache_shard *shard, uint64_t start_lba, uint64_t num_blocks)
+{
+	struct nvmf_ns_read_cache_fill *fill;
+	struct iovec iov;
+
+	fill = nvmf_ns_read_cache_fill_start(shard, NULL, start_lba, num_blocks);
+	SPDK_CU_ASSERT_FATAL(fill != NULL);
+
+	iov.iov_base = &g_data[start_lba * BLOCK_SIZE];
+	iov.iov_len = num_blocks * BLOCK_SIZE;
+	nvmf_ns_read_cache_fill_done(fill, true, &iov, 1);
+}
+
+static bool
+cached(struct nvmf_ns_read_cache_shard *shard, uint64_t start_lba, uint64_t num_blocks)
+{
+	uint8_t buf[NVMF_NS_READ_CACHE_LINE_SIZE * 4];
+	struct iovec iov = { .iov_base = buf, .iov_len = num_blocks * BLOCK_SIZE };
+
+	SPDK_CU_ASSERT_FATAL(iov.iov_len <= sizeof(buf));
+	memset(buf, 0, sizeof(buf));
+	if (!nvmf_ns_read_cache_read(shard, start_lba, num_blocks, &iov, 1)) {
+		return false;
+	}
+
+	CU_ASSERT(memcmp(buf, &g_data[start_lba * BLOCK_SIZE], iov.iov_len) == 0);
+	return true;
+}
+
+static void
+write_cmd(struct spdk_nvme_cmd *cmd, uint8_t opc, uint64_t start_lba, uint32_t num_blocks)
+{
+	memset(cmd, 0, sizeof(*cmd));
+	cmd->opc = opc;
+	to_le64(&cmd->cdw10, start_lba);
+	to_le32(&cmd->cdw12, num_blocks - 1);
+}
+
+static void
+test_nvmf_ns_read_cache_create(void)
+{
+	struct nvmf_ns_read_cache *cache;
+	struct spdk_bdev bdev = { .name = "bdev", .blocklen = 8192 };
+
+	/* Lines are at least a block */
+	cache = nvmf_ns_read_cache_create(&bdev, 16);
+	SPDK_CU_ASSERT_FATAL(cache != NULL);
+	CU_ASSERT(cache->line_size == 8192);
+	CU_ASSERT(cache->line_blocks == 1);
+	CU_ASSERT(cache->size == 16 * 1024 * 1024);
+	nvmf_ns_read_cache_destroy(cache);
+
+	bdev.blocklen = BLOCK_SIZE;
+	cache = nvmf_ns_read_cache_create(&bdev, 16);
+	SPDK_CU_ASSERT_FATAL(cache != NULL);
+	CU_ASSERT(cache->line_size == NVMF_NS_READ_CACHE_LINE_SIZE);
+	CU_ASSERT(cache->line_blocks == LINE_BLOCKS);
+	nvmf_ns_read_cache_destroy(cache);
+
+	/* Block sizes not dividing the line size and metadata are not supported */
+	bdev.blocklen = 520;
+	CU_ASSERT(nvmf_ns_read_cache_create(&bdev, 16) == NULL);
+
+	bdev.blocklen = BLOCK_SIZE;
+	bdev.md_len = 8;
+	CU_ASSERT(nvmf_ns_read_cache_create(&bdev, 16) == NULL);
+}
+
+static void
+test_nvmf_ns_read_cache_fill(void)
+{
+	struct nvmf_ns_read_cache *cache;
+	struct nvmf_ns_read_cache_shard *shard;
+
+	shard = create_shard(&cache);
+
+	CU_ASSERT(!cached(shard, 0, 1));
+
+	/* Only lines 1 and 2 are fully covered by the read */
+	fill(shard, LINE_BLOCKS / 2, LINE_BLOCKS * 3);
+	CU_ASSERT(!cached(shard, LINE_BLOCKS / 2, 1));
+	CU_ASSERT(cached(shard, LINE_BLOCKS, LINE_BLOCKS * 2));
+	CU_ASSERT(cached(shard, LINE_BLOCKS + 3, LINE_BLOCKS));
+	CU_ASSERT(!cached(shard, LINE_BLOCKS * 3, 1));
+	CU_ASSERT(!cached(shard, LINE_BLOCKS * 2, LINE_BLOCKS + 1));
+
+	/* Filling a cached line again doesn't use another line */
+	fill(shard, LINE_BLOCKS, LINE_BLOCKS);
+	CU_ASSERT(cached(shard, LINE_BLOCKS, LINE_BLOCKS * 2));
+
+	/* Failed reads are not cached */
+	nvmf_ns_read_cache_fill_done(nvmf_ns_read_cache_fill_start(shard, NULL, 0, LINE_BLOCKS),
+				     false, NULL, 0);
+	CU_ASSERT(!cached(shard, 0, 1));
+
+	destroy_shard(cache, shard);
+}
+
+static void
+test_nvmf_ns_read_cache_invalidate(void)
+{
+	struct nvmf_ns_read_cache *cache;
+	struct nvmf_ns_read_cache_shard *shard, *shard2;
+	struct nvmf_ns_read_cache_fill *f;
+	struct spdk_nvme_cmd cmd;
+	struct iovec iov;
+
+	shard = create_shard(&cache);
+	shard2 = nvmf_ns_read_cache_shard_create(cache, 4);
+	SPDK_CU_ASSERT_FATAL(shard2 != NULL);
+
+	write_cmd(&cmd, SPDK_NVME_OPC_READ, 0, 1);
+	CU_ASSERT(!nvmf_ns_read_cache_cmd_modifies(&cmd));
+	write_cmd(&cmd, SPDK_NVME_OPC_WRITE, 0, 1);
+	CU_ASSERT(nvmf_ns_read_cache_cmd_modifies(&cmd));
+	write_cmd(&cmd, SPDK_NVME_OPC_DATASET_MANAGEMENT, 0, 1);
+	CU_ASSERT(nvmf_ns_read_cache_cmd_modifies(&cmd));
+
+	/* A write only invalidates the lines it overlaps, in all shards */
+	fill(shard, 0, LINE_BLOCKS * 4);
+	fill(shard2, 0, LINE_BLOCKS * 4);
+	write_cmd(&cmd, SPDK_NVME_OPC_WRITE, LINE_BLOCKS + 1, LINE_BLOCKS);
+	nvmf_ns_read_cache_invalidate(cache, &cmd);
+	CU_ASSERT(cached(shard, 0, LINE_BLOCKS));
+	CU_ASSERT(!cached(shard, LINE_BLOCKS, 1));
+	CU_ASSERT(!cached(shard, LINE_BLOCKS * 2, 1));
+	CU_ASSERT(cached(shard, LINE_BLOCKS * 3, LINE_BLOCKS));
+	CU_ASSERT(cached(shard2, 0, LINE_BLOCKS));
+	CU_ASSERT(!cached(shard2, LINE_BLOCKS * 2, 1));
+
+	/* Commands without a single range invalidate everything */
+	write_cmd(&cmd, SPDK_NVME_OPC_DATASET_MANAGEMENT, 0, 1);
+	nvmf_ns_read_cache_invalidate(cache, &cmd);
+	CU_ASSERT(!cached(shard, 0, 1));
+	CU_ASSERT(!cached(shard, LINE_BLOCKS * 3, 1));
+	CU_ASSERT(!cached(shard2, 0, 1));
+
+	/* New fills are cached again */
+	fill(shard, 0, LINE_BLOCKS * 4);
+	CU_ASSERT(cached(shard, 0, LINE_BLOCKS * 4));
+
+	/* A read racing with a write to any range is not cached */
+	f = nvmf_ns_read_cache_fill_start(shard2, NULL, 0, LINE_BLOCKS);
+	SPDK_CU_ASSERT_FATAL(f != NULL);
+	write_cmd(&cmd, SPDK_NVME_OPC_WRITE, LINE_BLOCKS * 10, 1);
+	nvmf_ns_read_cache_invalidate(cache, &cmd);
+	iov.iov_base = g_data;
+	iov.iov_len = NVMF_NS_READ_CACHE_LINE_SIZE;
+	nvmf_ns_read_cache_fill_done(f, true, &iov, 1);
+	CU_ASSERT(!cached(shard2, 0, 1));
+
+	nvmf_ns_read_cache_shard_destroy(shard2);
+	destroy_shard(cache, shard);
+}
+
+static void
+test_nvmf_ns_read_cache_get_put(void)
+{
+	struct nvmf_ns_read_cache *cache;
+	struct nvmf_ns_read_cache_shard *shard;
+	struct nvmf_ns_read_cache_line *line;
+	struct spdk_nvme_cmd cmd;
+	struct iovec iovs[2];
+	uint64_t i;
+
+	shard = create_shard(&cache);
+
+	fill(shard, 0, LINE_BLOCKS * 2);
+
+	/* Not enough iovs */
+	CU_ASSERT(nvmf_ns_read_cache_get(shard, 0, LINE_BLOCKS * 2, iovs, 1) == 0);
+	/* Not cached */
+	CU_ASSERT(nvmf_ns_read_cache_get(shard, LINE_BLOCKS, LINE_BLOCKS * 2, iovs, 2) == 0);
+
+	CU_ASSERT(nvmf_ns_read_cache_get(shard, 4, LINE_BLOCKS, iovs, 2) == 2);
+	CU_ASSERT(iovs[0].iov_len == (LINE_BLOCKS - 4) * BLOCK_SIZE);
+	CU_ASSERT(iovs[1].iov_len == 4 * BLOCK_SIZE);
+	CU_ASSERT(memcmp(iovs[0].iov_base, &g_data[4 * BLOCK_SIZE], iovs[0].iov_len) == 0);
+	CU_ASSERT(memcmp(iovs[1].iov_base, &g_data[LINE_BLOCKS * BLOCK_SIZE], iovs[1].iov_len) == 0);
+	line = &shard->lines[((uint8_t *)iovs[0].iov_base - (uint8_t *)shard->buf) /
+			     NVMF_NS_READ_CACHE_LINE_SIZE];
+	CU_ASSERT(line->ref == 1);
+
+	/* Referenced lines are not evicted */
+	for (i = 2; i < NUM_LINES + 1; i++) {
+		fill(shard, i * LINE_BLOCKS, LINE_BLOCKS);
+	}
+	CU_ASSERT(line->valid);
+	CU_ASSERT(line->line == 0);
+	CU_ASSERT(cached(shard, 0, LINE_BLOCKS * 2));
+
+	/* An invalidated line is kept until it's put */
+	write_cmd(&cmd, SPDK_NVME_OPC_WRITE, 0, 1);
+	nvmf_ns_read_cache_invalidate(cache, &cmd);
+	CU_ASSERT(!cached(shard, 0, 1));
+	CU_ASSERT(!line->valid);
+	CU_ASSERT(line->ref == 1);
+
+	nvmf_ns_read_cache_put(shard, iovs, 2);
+	CU_ASSERT(line->ref == 0);
+	CU_ASSERT(TAILQ_FIRST(&shard->lru) == line);
+
+	destroy_shard(cache, shard);
+}
+
+static void
+test_nvmf_ns_read_cache_evict(void)
+{
+	struct nvmf_ns_read_cache *cache;
+	struct nvmf_ns_read_cache_shard *shard;
+	uint64_t i;
+
+	shard = create_shard(&cache);
+
+	for (i = 0; i < NUM_LINES; i++) {
+		fill(shard, i * LINE_BLOCKS, LINE_BLOCKS);
+	}
+	for (i = 0; i < NUM_LINES; i++) {
+		CU_ASSERT(cached(shard, i * LINE_BLOCKS, LINE_BLOCKS));
+	}
+
+	/* Line 0 was used most recently, so line 1 is evicted */
+	CU_ASSERT(cached(shard, 0, 1));
+	fill(shard, NUM_LINES * LINE_BLOCKS, LINE_BLOCKS);
+	CU_ASSERT(cached(shard, NUM_LINES * LINE_BLOCKS, LINE_BLOCKS));
+	CU_ASSERT(cached(shard, 0, 1));
+	CU_ASSERT(!cached(shard, LINE_BLOCKS, 1));
+	CU_ASSERT(cached(shard, LINE_BLOCKS * 2, 1));
+
+	destroy_shard(cache, shard);
+}
+
+static struct nvmf_ns_read_cache *g_race_cache;
+static uint8_t g_race_opc;
+
+static void
+race_write(void)
+{
+	struct spdk_nvme_cmd cmd;
+
+	/* Line 1 is the first one copied by the fill below */
+	write_cmd(&cmd, g_race_opc, LINE_BLOCKS, 1);
+	nvmf_ns_read_cache_invalidate(g_race_cache, &cmd);
+}
+
+static void
+test_nvmf_ns_read_cache_fill_race(void)
+{
+	struct nvmf_ns_read_cache_shard *shard;
+	struct nvmf_ns_read_cache_fill *f;
+	struct iovec iov;
+
+	shard = create_shard(&g_race_cache);
+
+	/* Line 0 was cached before the read started and stays valid */
+	fill(shard, 0, LINE_BLOCKS);
+
+	/*
+	 * A write to line 1 lands after its data was copied, but before its sequence number is
+	 * loaded.  Neither line 1 nor line 2, filled after the write, may be trusted.
+	 */
+	g_race_opc = SPDK_NVME_OPC_WRITE;
+	f = nvmf_ns_read_cache_fill_start(shard, NULL, LINE_BLOCKS, LINE_BLOCKS * 2);
+	SPDK_CU_ASSERT_FATAL(f != NULL);
+	g_xfer_to_buf_hook = race_write;
+	iov.iov_base = &g_data[LINE_BLOCKS * BLOCK_SIZE];
+	iov.iov_len = LINE_BLOCKS * 2 * BLOCK_SIZE;
+	nvmf_ns_read_cache_fill_done(f, true, &iov, 1);
+	CU_ASSERT(g_xfer_to_buf_hook == NULL);
+	CU_ASSERT(!cached(shard, LINE_BLOCKS, 1));
+	CU_ASSERT(!cached(shard, LINE_BLOCKS * 2, 1));
+	CU_ASSERT(cached(shard, 0, LINE_BLOCKS));
+
+	/* Same for commands bumping the epoch */
+	g_race_opc = SPDK_NVME_OPC_DATASET_MANAGEMENT;
+	f = nvmf_ns_read_cache_fill_start(shard, NULL, LINE_BLOCKS, LINE_BLOCKS * 2);
+	SPDK_CU_ASSERT_FATAL(f != NULL);
+	g_xfer_to_buf_hook = race_write;
+	nvmf_ns_read_cache_fill_done(f, true, &iov, 1);
+	CU_ASSERT(!cached(shard, LINE_BLOCKS, 1));
+	CU_ASSERT(!cached(shard, LINE_BLOCKS * 2, 1));
+
+	/* Without a racing command the lines are cached */
+	fill(shard, LINE_BLOCKS, LINE_BLOCKS * 2);
+	CU_ASSERT(cached(shard, LINE_BLOCKS, LINE_BLOCKS * 2));
+
+	destroy_shard(g_race_cache, shard);
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	CU_initialize_registry();
+
+	suite = CU_add_suite("nvmf_ns_cache", NULL, NULL);
+
+	init_data();
+
+	CU_ADD_TEST(suite, test_nvmf_ns_read_cache_create);
+	CU_ADD_TEST(suite, test_nvmf_ns_read_cache_fill);
+	CU_ADD_TEST(suite, test_nvmf_ns_read_cache_invalidate);
+	CU_ADD_TEST(suite, test_nvmf_ns_read_cache_get_put);
+	CU_ADD_TEST(suite, test_nvmf_ns_read_cache_evict);
+	CU_ADD_TEST(suite, test_nvmf_ns_read_cache_fill_race);
+
+	num_failures = spdk_ut_run_tests(argc, argv, NULL);
+	CU_cleanup_registry();
+	return num_failures;
+}
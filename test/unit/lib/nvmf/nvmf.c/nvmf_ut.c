@@ -11,9 +11,6 @@
 
 DEFINE_STUB_V(nvmf_transport_poll_group_destroy, (struct spdk_nvmf_transport_poll_group *group));
 DEFINE_STUB_V(nvmf_ctrlr_destruct, (struct spdk_nvmf_ctrlr *ctrlr));
-DEFINE_STUB_V(nvmf_transport_qpair_fini, (struct spdk_nvmf_qpair *qpair,
-		spdk_nvmf_transport_qpair_fini_cb cb_fn,
-		void *cb_arg));
 DEFINE_STUB_V(nvmf_qpair_free_aer, (struct spdk_nvmf_qpair *qpair));
 DEFINE_STUB_V(nvmf_qpair_abort_pending_zcopy_reqs, (struct spdk_nvmf_qpair *qpair));
 DEFINE_STUB(nvmf_transport_poll_group_create, struct spdk_nvmf_transport_poll_group *,
@@ -28,6 +25,10 @@ DEFINE_STUB(nvmf_transport_poll_group_remove, int, (struct spdk_nvmf_transport_p
 		struct spdk_nvmf_qpair *qpair), 0);
 DEFINE_STUB(nvmf_transport_req_free, int, (struct spdk_nvmf_request *req), 0);
 DEFINE_STUB(nvmf_transport_poll_group_poll, int, (struct spdk_nvmf_transport_poll_group *group), 0);
+DEFINE_STUB(nvmf_transport_poll_group_migrate_out, int,
+	    (struct spdk_nvmf_transport_poll_group *group, struct spdk_nvmf_qpair *qpair), 0);
+DEFINE_STUB(nvmf_transport_poll_group_migrate_in, int,
+	    (struct spdk_nvmf_transport_poll_group *group, struct spdk_nvmf_qpair *qpair), 0);
 DEFINE_STUB_V(nvmf_subsystem_remove_all_listeners, (struct spdk_nvmf_subsystem *subsystem,
 		bool stop));
 DEFINE_STUB(spdk_nvmf_subsystem_destroy, int, (struct spdk_nvmf_subsystem *subsystem,
@@ -117,6 +118,21 @@ DEFINE_STUB(spdk_key_get_name, const char *, (struct spdk_key *k), NULL);
 DEFINE_STUB(nvmf_qpair_auth_init, int, (struct spdk_nvmf_qpair *q), 0);
 DEFINE_STUB_V(nvmf_qpair_auth_destroy, (struct spdk_nvmf_qpair *q));
 DEFINE_STUB_V(nvmf_tgt_stop_mdns_prr, (struct spdk_nvmf_tgt *tgt));
+DEFINE_STUB(nvmf_ns_read_cache_shard_create, struct nvmf_ns_read_cache_shard *,
+	    (struct nvmf_ns_read_cache *cache, uint32_t num_shards), NULL);
+DEFINE_STUB_V(nvmf_ns_read_cache_shard_destroy, (struct nvmf_ns_read_cache_shard *shard));
+DEFINE_STUB(nvmf_poll_group_qos_update, int, (struct spdk_nvmf_subsystem_poll_group *sgroup,
+		struct spdk_nvmf_subsystem *subsystem), 0);
+DEFINE_STUB_V(nvmf_poll_group_qos_destroy, (struct spdk_nvmf_subsystem_poll_group *sgroup));
+DEFINE_STUB_V(nvmf_poll_group_qos_dump_stat, (struct spdk_nvmf_poll_group *group,
+		struct spdk_json_write_ctx *w));
+DEFINE_STUB_V(nvmf_subsystem_qos_write_config_json, (struct spdk_nvmf_subsystem *subsystem,
+		struct spdk_json_write_ctx *w));
+DEFINE_STUB_V(nvmf_poll_group_telemetry_update, (struct spdk_nvmf_subsystem_poll_group *sgroup,
+		struct spdk_nvmf_subsystem *subsystem));
+DEFINE_STUB_V(nvmf_poll_group_telemetry_destroy, (struct spdk_nvmf_subsystem_poll_group *sgroup));
+DEFINE_STUB_V(nvmf_subsystem_telemetry_write_config_json, (struct spdk_nvmf_subsystem *subsystem,
+		struct spdk_json_write_ctx *w));
 
 struct spdk_io_channel {
 	struct spdk_thread		*thread;
@@ -141,6 +157,16 @@ spdk_bdev_get_uuid(const struct spdk_bdev *bdev)
 	return &bdev->uuid;
 }
 
+static void *g_qpair_fini_cb_arg;
+
+void
+nvmf_transport_qpair_fini(struct spdk_nvmf_qpair *qpair,
+			  spdk_nvmf_transport_qpair_fini_cb cb_fn,
+			  void *cb_arg)
+{
+	g_qpair_fini_cb_arg = cb_arg;
+}
+
 static void
 test_nvmf_tgt_create_poll_group(void)
 {
@@ -223,6 +249,165 @@ test_nvmf_tgt_create_poll_group(void)
 	MOCK_CLEAR(spdk_bdev_get_io_channel);
 }
 
+static void
+test_nvmf_poll_group_migrate_qpair(void)
+{
+	struct spdk_thread		*thread;
+	struct spdk_nvmf_tgt		tgt = {};
+	struct spdk_nvmf_poll_group	src = {}, dst = {};
+	struct spdk_nvmf_subsystem_poll_group sgroup = { .state = SPDK_NVMF_SUBSYSTEM_ACTIVE };
+	struct spdk_nvmf_transport	transport = {};
+	struct spdk_nvmf_transport_poll_group src_tgroup = {}, dst_tgroup = {};
+	struct spdk_nvmf_subsystem	subsystem = {};
+	struct spdk_nvmf_ctrlr		ctrlr = {};
+	struct spdk_nvmf_qpair		qpair = {};
+	struct spdk_nvmf_request	req = {};
+	struct nvmf_qpair_migrate_ctx	*ctx;
+	int rc;
+
+	thread = spdk_thread_create(NULL, NULL);
+	SPDK_CU_ASSERT_FATAL(thread != NULL);
+	spdk_set_thread(thread);
+
+	pthread_mutex_init(&tgt.mutex, NULL);
+	pthread_mutex_init(&src.mutex, NULL);
+	pthread_mutex_init(&dst.mutex, NULL);
+	TAILQ_INIT(&tgt.poll_groups);
+
+	src.thread = dst.thread = thread;
+	src.sgroups = dst.sgroups = &sgroup;
+	src.num_sgroups = dst.num_sgroups = 1;
+	TAILQ_INIT(&src.tgroups);
+	TAILQ_INIT(&dst.tgroups);
+	TAILQ_INIT(&src.qpairs);
+	TAILQ_INIT(&dst.qpairs);
+	src_tgroup.transport = dst_tgroup.transport = &transport;
+	TAILQ_INSERT_TAIL(&src.tgroups, &src_tgroup, link);
+	TAILQ_INSERT_TAIL(&dst.tgroups, &dst_tgroup, link);
+
+	subsystem.id = 0;
+	ctrlr.subsys = &subsystem;
+	qpair.qid = 1;
+	qpair.ctrlr = &ctrlr;
+	qpair.transport = &transport;
+	qpair.group = &src;
+	qpair.state = SPDK_NVMF_QPAIR_ENABLED;
+	TAILQ_INIT(&qpair.outstanding);
+	TAILQ_INSERT_TAIL(&src.qpairs, &qpair, link);
+	src.stat.current_io_qpairs = 1;
+
+	/* The admin qpair is never moved */
+	qpair.qid = 0;
+	rc = nvmf_poll_group_migrate_qpair(&qpair, &dst);
+	CU_ASSERT(rc == -EBUSY);
+	qpair.qid = 1;
+
+	/* Neither is a qpair with requests outstanding */
+	TAILQ_INSERT_TAIL(&qpair.outstanding, &req, link);
+	rc = nvmf_poll_group_migrate_qpair(&qpair, &dst);
+	CU_ASSERT(rc == -EBUSY);
+	TAILQ_REMOVE(&qpair.outstanding, &req, link);
+
+	/* The transport isn't ready to let the qpair go */
+	MOCK_SET(nvmf_transport_poll_group_migrate_out, -EBUSY);
+	rc = nvmf_poll_group_migrate_qpair(&qpair, &dst);
+	CU_ASSERT(rc == -EBUSY);
+	CU_ASSERT(qpair.group == &src);
+	CU_ASSERT(TAILQ_FIRST(&src.qpairs) == &qpair);
+	CU_ASSERT(dst.migrating_in_qpairs == 0);
+	MOCK_SET(nvmf_transport_poll_group_migrate_out, 0);
+
+	/* A poll group being destroyed takes no new qpairs */
+	dst.destroying = true;
+	rc = nvmf_poll_group_migrate_qpair(&qpair, &dst);
+	CU_ASSERT(rc == -EBUSY);
+	CU_ASSERT(qpair.group == &src);
+	CU_ASSERT(dst.migrating_in_qpairs == 0);
+	dst.destroying = false;
+
+	/* The rebalancer drops the move if either poll group is gone from the target */
+	TAILQ_INSERT_TAIL(&tgt.poll_groups, &src, link);
+	ctx = calloc(1, sizeof(*ctx));
+	SPDK_CU_ASSERT_FATAL(ctx != NULL);
+	ctx->tgt = &tgt;
+	ctx->src = &src;
+	ctx->dst = &dst;
+	_nvmf_poll_group_rebalance(ctx);
+	CU_ASSERT(qpair.group == &src);
+	CU_ASSERT(TAILQ_FIRST(&src.qpairs) == &qpair);
+
+	/* Successful move */
+	TAILQ_INSERT_TAIL(&tgt.poll_groups, &dst, link);
+	ctx = calloc(1, sizeof(*ctx));
+	SPDK_CU_ASSERT_FATAL(ctx != NULL);
+	ctx->tgt = &tgt;
+	ctx->src = &src;
+	ctx->dst = &dst;
+	_nvmf_poll_group_rebalance(ctx);
+	CU_ASSERT(qpair.group == &dst);
+	CU_ASSERT(qpair.migrating);
+	CU_ASSERT(TAILQ_EMPTY(&src.qpairs));
+	CU_ASSERT(src.stat.migrated_out_qpairs == 1);
+	CU_ASSERT(dst.migrating_in_qpairs == 1);
+
+	spdk_thread_poll(thread, 0, 0);
+	CU_ASSERT(!qpair.migrating);
+	CU_ASSERT(TAILQ_FIRST(&dst.qpairs) == &qpair);
+	CU_ASSERT(dst.stat.current_io_qpairs == 1);
+	CU_ASSERT(dst.stat.migrated_in_qpairs == 1);
+	CU_ASSERT(dst.migrating_in_qpairs == 0);
+
+	/* Least loaded poll group is picked for new qpairs, ties broken by qpair count */
+	src.load = 100;
+	dst.load = 40;
+	dst.load_io_qpairs = 2;
+	CU_ASSERT(nvmf_tgt_get_least_loaded_poll_group(&tgt) == &dst);
+	CU_ASSERT(dst.load == 60);
+
+	src.load = 0;
+	dst.load = 0;
+	src.load_io_qpairs = 1;
+	dst.load_io_qpairs = 0;
+	CU_ASSERT(nvmf_tgt_get_least_loaded_poll_group(&tgt) == &dst);
+	CU_ASSERT(dst.load == 1);
+	CU_ASSERT(nvmf_tgt_get_least_loaded_poll_group(&tgt) == &src);
+
+	/* A disconnect of a qpair in flight waits for it to arrive instead of being resent */
+	ctx = calloc(1, sizeof(*ctx));
+	SPDK_CU_ASSERT_FATAL(ctx != NULL);
+	ctx->tgt = &tgt;
+	ctx->src = &dst;
+	ctx->dst = &src;
+	_nvmf_poll_group_rebalance(ctx);
+	CU_ASSERT(qpair.group == &src);
+	CU_ASSERT(qpair.migrating);
+
+	rc = spdk_nvmf_qpair_disconnect(&qpair);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(qpair.disconnect_deferred);
+	CU_ASSERT(!qpair.disconnect_started);
+	CU_ASSERT(qpair.state == SPDK_NVMF_QPAIR_ENABLED);
+
+	spdk_thread_poll(thread, 0, 0);
+	CU_ASSERT(!qpair.migrating);
+	CU_ASSERT(!qpair.disconnect_deferred);
+	CU_ASSERT(qpair.disconnect_started);
+	CU_ASSERT(TAILQ_EMPTY(&src.qpairs));
+	SPDK_CU_ASSERT_FATAL(g_qpair_fini_cb_arg != NULL);
+	free(g_qpair_fini_cb_arg);
+	g_qpair_fini_cb_arg = NULL;
+
+	pthread_mutex_destroy(&dst.mutex);
+	pthread_mutex_destroy(&src.mutex);
+	pthread_mutex_destroy(&tgt.mutex);
+
+	spdk_thread_exit(thread);
+	while (!spdk_thread_is_exited(thread)) {
+		spdk_thread_poll(thread, 0, 0);
+	}
+	spdk_thread_destroy(thread);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -234,6 +419,7 @@ main(int argc, char **argv)
 	suite = CU_add_suite("nvmf", NULL, NULL);
 
 	CU_ADD_TEST(suite, test_nvmf_tgt_create_poll_group);
+	CU_ADD_TEST(suite, test_nvmf_poll_group_migrate_qpair);
 
 	num_failures = spdk_ut_run_tests(argc, argv, NULL);
 	CU_cleanup_registry();
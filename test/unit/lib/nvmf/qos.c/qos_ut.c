@@ -0,0 +1,354 @@
+/*   SPDX-License-Identifier: BSD-3-Clause
+ *   Copyright (C) 2026 agent. All rights reserved.
+ */
+
+#include "spdk/stdinc.h"
+#include "spdk_internal/cunit.h"
+#include "common/lib/ut_multithread.c"
+#include "nvmf/qos.c"
+
+#define HOST1 "nqn.2016-06.io.spdk:host1"
+#define HOST2 "nqn.2016-06.io.spdk:host2"
+
+static int g_resubmitted;
+
+void
+nvmf_qos_resubmit(struct spdk_nvmf_request *req)
+{
+	g_resubmitted++;
+}
+
+struct qos_ut_req {
+	struct spdk_nvmf_request	req;
+	union nvmf_h2c_msg		cmd;
+};
+
+static struct spdk_nvmf_subsystem g_subsystem = {
+	.subnqn = "nqn.2016-06.io.spdk:cnode1",
+};
+static struct spdk_nvmf_subsystem_poll_group g_sgroup;
+static struct spdk_nvmf_poll_group g_group = {
+	.sgroups = &g_sgroup,
+	.num_sgroups = 1,
+};
+static struct spdk_nvmf_ctrlr g_ctrlr1 = { .hostnqn = HOST1 };
+static struct spdk_nvmf_ctrlr g_ctrlr2 = { .hostnqn = HOST2 };
+static struct spdk_nvmf_qpair g_qpair1 = {
+	.ctrlr = &g_ctrlr1,
+	.group = &g_group,
+	.state = SPDK_NVMF_QPAIR_ENABLED,
+};
+static struct spdk_nvmf_qpair g_qpair2 = {
+	.ctrlr = &g_ctrlr2,
+	.group = &g_group,
+	.state = SPDK_NVMF_QPAIR_ENABLED,
+};
+
+static void
+init_req(struct qos_ut_req *r, struct spdk_nvmf_qpair *qpair, uint32_t nsid, uint32_t length)
+{
+	memset(r, 0, sizeof(*r));
+	r->req.qpair = qpair;
+	r->req.cmd = &r->cmd;
+	r->req.length = length;
+	r->cmd.nvme_cmd.opc = SPDK_NVME_OPC_READ;
+	r->cmd.nvme_cmd.nsid = nsid;
+}
+
+static void
+set_limits(const char *hostnqn, uint32_t nsid, uint64_t iops, uint64_t bps, uint64_t min_iops)
+{
+	uint64_t limits[SPDK_NVMF_QOS_NUM_LIMITS] = { iops, bps, min_iops, 0 };
+
+	CU_ASSERT(spdk_nvmf_subsystem_set_qos_limits(&g_subsystem, hostnqn, nsid, limits) == 0);
+}
+
+static void
+setup_subsystem(void)
+{
+	TAILQ_INIT(&g_subsystem.qos_rules);
+	g_subsystem.state = SPDK_NVMF_SUBSYSTEM_INACTIVE;
+	TAILQ_INIT(&g_sgroup.qos_rules);
+	g_resubmitted = 0;
+}
+
+static void
+cleanup_subsystem(void)
+{
+	nvmf_poll_group_qos_destroy(&g_sgroup);
+	nvmf_subsystem_qos_free(&g_subsystem);
+	spdk_poller_unregister(&g_group.qos_poller);
+	CU_ASSERT(TAILQ_EMPTY(&g_subsystem.qos_rules));
+}
+
+static void
+test_nvmf_qos_set_limits(void)
+{
+	uint64_t limits[SPDK_NVMF_QOS_NUM_LIMITS] = {};
+	struct nvmf_qos_rule *rule;
+
+	setup_subsystem();
+
+	/* Only while inactive or paused */
+	limits[SPDK_NVMF_QOS_RW_IOPS_MAX] = 10000;
+	g_subsystem.state = SPDK_NVMF_SUBSYSTEM_ACTIVE;
+	CU_ASSERT(spdk_nvmf_subsystem_set_qos_limits(&g_subsystem, NULL, 0, limits) == -EAGAIN);
+	g_subsystem.state = SPDK_NVMF_SUBSYSTEM_PAUSED;
+
+	/* IOPS must be a multiple of 1000 */
+	limits[SPDK_NVMF_QOS_RW_IOPS_MAX] = 1500;
+	CU_ASSERT(spdk_nvmf_subsystem_set_qos_limits(&g_subsystem, NULL, 0, limits) == -EINVAL);
+
+	/* Minimums are only for hosts and can't exceed the maximums */
+	limits[SPDK_NVMF_QOS_RW_IOPS_MAX] = 10000;
+	limits[SPDK_NVMF_QOS_RW_IOPS_MIN] = 2000;
+	CU_ASSERT(spdk_nvmf_subsystem_set_qos_limits(&g_subsystem, NULL, 0, limits) == -EINVAL);
+	limits[SPDK_NVMF_QOS_RW_IOPS_MIN] = 20000;
+	CU_ASSERT(spdk_nvmf_subsystem_set_qos_limits(&g_subsystem, HOST1, 1, limits) == -EINVAL);
+	CU_ASSERT(TAILQ_EMPTY(&g_subsystem.qos_rules));
+
+	/* Removing limits that aren't set */
+	memset(limits, 0, sizeof(limits));
+	CU_ASSERT(spdk_nvmf_subsystem_set_qos_limits(&g_subsystem, HOST1, 1, limits) == -ENOENT);
+
+	/* Create, then update in place */
+	set_limits(HOST1, 1, 10000, 0, 2000);
+	rule = TAILQ_FIRST(&g_subsystem.qos_rules);
+	SPDK_CU_ASSERT_FATAL(rule != NULL);
+	CU_ASSERT(strcmp(rule->hostnqn, HOST1) == 0);
+	CU_ASSERT(rule->nsid == 1);
+	CU_ASSERT(rule->max[NVMF_QOS_IOS].quota == 10);
+	CU_ASSERT(rule->max[NVMF_QOS_BYTES].quota == 0);
+	CU_ASSERT(rule->min[NVMF_QOS_IOS].quota == 2);
+
+	set_limits(HOST1, 1, 0, 1024 * 1024, 0);
+	CU_ASSERT(TAILQ_FIRST(&g_subsystem.qos_rules) == rule);
+	CU_ASSERT(TAILQ_NEXT(rule, link) == NULL);
+	CU_ASSERT(rule->max[NVMF_QOS_IOS].quota == 0);
+	CU_ASSERT(rule->max[NVMF_QOS_BYTES].quota == 1048);
+	CU_ASSERT(rule->min[NVMF_QOS_IOS].quota == 0);
+
+	/* Same host, other namespace */
+	set_limits(HOST1, 0, 1000, 0, 0);
+	CU_ASSERT(TAILQ_NEXT(rule, link) != NULL);
+
+	/* The poll groups keep the rules they use until they're updated */
+	CU_ASSERT(nvmf_poll_group_qos_update(&g_sgroup, &g_subsystem) == 0);
+	CU_ASSERT(rule->ref == 2);
+	CU_ASSERT(spdk_nvmf_subsystem_set_qos_limits(&g_subsystem, HOST1, 1, limits) == 0);
+	CU_ASSERT(rule->ref == 1);
+	CU_ASSERT(TAILQ_FIRST(&g_sgroup.qos_rules)->rule == rule);
+	CU_ASSERT(nvmf_poll_group_qos_update(&g_sgroup, &g_subsystem) == 0);
+	CU_ASSERT(TAILQ_FIRST(&g_sgroup.qos_rules)->rule == TAILQ_FIRST(&g_subsystem.qos_rules));
+	CU_ASSERT(TAILQ_NEXT(TAILQ_FIRST(&g_sgroup.qos_rules), link) == NULL);
+
+	cleanup_subsystem();
+}
+
+static void
+test_nvmf_qos_iops(void)
+{
+	struct qos_ut_req reqs[40];
+	int i;
+
+	setup_subsystem();
+
+	/* 32 I/O per timeslice, taken by the poll group 2 at a time */
+	set_limits(NULL, 0, 32000, 0, 0);
+	CU_ASSERT(nvmf_poll_group_qos_update(&g_sgroup, &g_subsystem) == 0);
+
+	for (i = 0; i < 32; i++) {
+		init_req(&reqs[i], &g_qpair1, 1, 4096);
+		CU_ASSERT(nvmf_qos_admit(&g_group, &g_sgroup, &reqs[i].req));
+	}
+	CU_ASSERT(g_group.qos_poller == NULL);
+
+	/* Over the limit, queued until the next timeslice */
+	init_req(&reqs[32], &g_qpair1, 1, 4096);
+	CU_ASSERT(!nvmf_qos_admit(&g_group, &g_sgroup, &reqs[32].req));
+	CU_ASSERT(g_group.qos_poller != NULL);
+
+	/* Other hosts and namespaces share the limit */
+	init_req(&reqs[33], &g_qpair2, 2, 4096);
+	CU_ASSERT(!nvmf_qos_admit(&g_group, &g_sgroup, &reqs[33].req));
+
+	nvmf_poll_group_qos_poll(&g_group);
+	CU_ASSERT(g_resubmitted == 0);
+
+	spdk_delay_us(NVMF_QOS_TIMESLICE_IN_USEC);
+	nvmf_poll_group_qos_poll(&g_group);
+	CU_ASSERT(g_resubmitted == 2);
+	CU_ASSERT(g_group.qos_poller == NULL);
+
+	/* Unused tokens don't accumulate */
+	spdk_delay_us(10 * NVMF_QOS_TIMESLICE_IN_USEC);
+	for (i = 0; i < 32; i++) {
+		init_req(&reqs[i], &g_qpair1, 1, 4096);
+		CU_ASSERT(nvmf_qos_admit(&g_group, &g_sgroup, &reqs[i].req));
+	}
+	init_req(&reqs[32], &g_qpair1, 1, 4096);
+	CU_ASSERT(!nvmf_qos_admit(&g_group, &g_sgroup, &reqs[32].req));
+
+	/* Requests of disconnected qpairs are let go without waiting */
+	g_qpair1.state = SPDK_NVMF_QPAIR_DEACTIVATING;
+	nvmf_poll_group_qos_poll(&g_group);
+	CU_ASSERT(g_resubmitted == 3);
+	g_qpair1.state = SPDK_NVMF_QPAIR_ENABLED;
+
+	CU_ASSERT(TAILQ_FIRST(&g_sgroup.qos_rules)->ios == 66);
+	CU_ASSERT(TAILQ_FIRST(&g_sgroup.qos_rules)->throttled_ios == 3);
+
+	cleanup_subsystem();
+}
+
+static void
+test_nvmf_qos_bandwidth(void)
+{
+	struct qos_ut_req req;
+
+	setup_subsystem();
+
+	/* 1048 bytes per timeslice, a larger request leaves a debt */
+	set_limits(NULL, 1, 0, 1024 * 1024, 0);
+	CU_ASSERT(nvmf_poll_group_qos_update(&g_sgroup, &g_subsystem) == 0);
+
+	init_req(&req, &g_qpair1, 1, 4096);
+	CU_ASSERT(nvmf_qos_admit(&g_group, &g_sgroup, &req.req));
+
+	/* Other namespaces aren't limited */
+	init_req(&req, &g_qpair1, 2, 4096);
+	CU_ASSERT(nvmf_qos_admit(&g_group, &g_sgroup, &req.req));
+
+	init_req(&req, &g_qpair1, 1, 512);
+	CU_ASSERT(!nvmf_qos_admit(&g_group, &g_sgroup, &req.req));
+
+	/* The debt is paid off over the next timeslices */
+	spdk_delay_us(NVMF_QOS_TIMESLICE_IN_USEC);
+	nvmf_poll_group_qos_poll(&g_group);
+	spdk_delay_us(NVMF_QOS_TIMESLICE_IN_USEC);
+	nvmf_poll_group_qos_poll(&g_group);
+	CU_ASSERT(g_resubmitted == 0);
+
+	spdk_delay_us(NVMF_QOS_TIMESLICE_IN_USEC);
+	nvmf_poll_group_qos_poll(&g_group);
+	CU_ASSERT(g_resubmitted == 1);
+
+	cleanup_subsystem();
+}
+
+static void
+test_nvmf_qos_min(void)
+{
+	struct qos_ut_req reqs[4];
+	int i;
+
+	setup_subsystem();
+
+	/* One I/O per timeslice for all hosts, but at least 2 for host1 */
+	set_limits(NULL, 0, 1000, 0, 0);
+	set_limits(HOST1, 0, 0, 0, 2000);
+	CU_ASSERT(nvmf_poll_group_qos_update(&g_sgroup, &g_subsystem) == 0);
+
+	for (i = 0; i < 2; i++) {
+		init_req(&reqs[i], &g_qpair1, 1, 4096);
+		CU_ASSERT(nvmf_qos_admit(&g_group, &g_sgroup, &reqs[i].req));
+	}
+
+	init_req(&reqs[2], &g_qpair1, 1, 4096);
+	CU_ASSERT(!nvmf_qos_admit(&g_group, &g_sgroup, &reqs[2].req));
+	init_req(&reqs[3], &g_qpair2, 1, 4096);
+	CU_ASSERT(!nvmf_qos_admit(&g_group, &g_sgroup, &reqs[3].req));
+
+	/* The I/O above the shared limit still count against it, so host2 waits for the debt */
+	spdk_delay_us(NVMF_QOS_TIMESLICE_IN_USEC);
+	nvmf_poll_group_qos_poll(&g_group);
+	CU_ASSERT(g_resubmitted == 1);
+
+	spdk_delay_us(NVMF_QOS_TIMESLICE_IN_USEC);
+	nvmf_poll_group_qos_poll(&g_group);
+	CU_ASSERT(g_resubmitted == 1);
+	CU_ASSERT(g_group.qos_poller != NULL);
+
+	spdk_delay_us(NVMF_QOS_TIMESLICE_IN_USEC);
+	nvmf_poll_group_qos_poll(&g_group);
+	CU_ASSERT(g_resubmitted == 2);
+	CU_ASSERT(g_group.qos_poller == NULL);
+
+	cleanup_subsystem();
+}
+
+static void
+test_nvmf_qos_outstanding(void)
+{
+	struct qos_ut_req reqs[4];
+	struct spdk_nvmf_request *req;
+	int i, count;
+
+	setup_subsystem();
+	TAILQ_INIT(&g_qpair1.outstanding);
+
+	set_limits(NULL, 0, 2000, 0, 0);
+	CU_ASSERT(nvmf_poll_group_qos_update(&g_sgroup, &g_subsystem) == 0);
+
+	/* Requests are on the outstanding list of their qpair before they're admitted */
+	for (i = 0; i < 4; i++) {
+		init_req(&reqs[i], &g_qpair1, 1, 4096);
+		TAILQ_INSERT_TAIL(&g_qpair1.outstanding, &reqs[i].req, link);
+	}
+	CU_ASSERT(nvmf_qos_admit(&g_group, &g_sgroup, &reqs[0].req));
+	CU_ASSERT(nvmf_qos_admit(&g_group, &g_sgroup, &reqs[1].req));
+	CU_ASSERT(!nvmf_qos_admit(&g_group, &g_sgroup, &reqs[2].req));
+	CU_ASSERT(!nvmf_qos_admit(&g_group, &g_sgroup, &reqs[3].req));
+
+	/* Completing an admitted request leaves both lists intact */
+	TAILQ_REMOVE(&g_qpair1.outstanding, &reqs[1].req, link);
+	count = 0;
+	TAILQ_FOREACH(req, &g_qpair1.outstanding, link) {
+		CU_ASSERT(req != &reqs[1].req);
+		count++;
+	}
+	CU_ASSERT(count == 3);
+	CU_ASSERT(TAILQ_FIRST(&TAILQ_FIRST(&g_sgroup.qos_rules)->queued) == &reqs[2].req);
+	CU_ASSERT(TAILQ_NEXT(&reqs[2].req, qos_link) == &reqs[3].req);
+	CU_ASSERT(TAILQ_NEXT(&reqs[3].req, qos_link) == NULL);
+
+	/* So does completing a request that is still queued, once it got through */
+	spdk_delay_us(NVMF_QOS_TIMESLICE_IN_USEC);
+	nvmf_poll_group_qos_poll(&g_group);
+	CU_ASSERT(g_resubmitted == 2);
+	TAILQ_REMOVE(&g_qpair1.outstanding, &reqs[2].req, link);
+	TAILQ_REMOVE(&g_qpair1.outstanding, &reqs[0].req, link);
+	CU_ASSERT(TAILQ_FIRST(&g_qpair1.outstanding) == &reqs[3].req);
+	TAILQ_REMOVE(&g_qpair1.outstanding, &reqs[3].req, link);
+	CU_ASSERT(TAILQ_EMPTY(&g_qpair1.outstanding));
+	CU_ASSERT(TAILQ_EMPTY(&TAILQ_FIRST(&g_sgroup.qos_rules)->queued));
+
+	cleanup_subsystem();
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	CU_initialize_registry();
+
+	suite = CU_add_suite("nvmf_qos", NULL, NULL);
+
+	CU_ADD_TEST(suite, test_nvmf_qos_set_limits);
+	CU_ADD_TEST(suite, test_nvmf_qos_iops);
+	CU_ADD_TEST(suite, test_nvmf_qos_bandwidth);
+	CU_ADD_TEST(suite, test_nvmf_qos_min);
+	CU_ADD_TEST(suite, test_nvmf_qos_outstanding);
+
+	allocate_threads(1);
+	set_thread(0);
+
+	num_failures = spdk_ut_run_tests(argc, argv, NULL);
+	CU_cleanup_registry();
+
+	free_threads();
+
+	return num_failures;
+}
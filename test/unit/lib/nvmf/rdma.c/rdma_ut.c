@@ -50,6 +50,8 @@ DEFINE_STUB(nvmf_ctrlr_abort_request, int, (struct spdk_nvmf_request *req), 0);
 DEFINE_STUB(spdk_nvme_transport_id_adrfam_str, const char *, (enum spdk_nvmf_adrfam adrfam), NULL);
 DEFINE_STUB(ibv_dereg_mr, int, (struct ibv_mr *mr), 0);
 DEFINE_STUB(ibv_resize_cq, int, (struct ibv_cq *cq, int cqe), 0);
+DEFINE_STUB(ibv_modify_srq, int, (struct ibv_srq *srq, struct ibv_srq_attr *srq_attr,
+				  int srq_attr_mask), 0);
 DEFINE_STUB(spdk_mempool_lookup, struct spdk_mempool *, (const char *name), NULL);
 DEFINE_STUB(spdk_rdma_cm_id_get_numa_id, int32_t, (struct rdma_cm_id *cm_id), 0);
 
@@ -1349,6 +1351,192 @@ test_nvmf_rdma_resources_create(void)
 	nvmf_rdma_resources_destroy(rdma_resource);
 }
 
+static void
+test_nvmf_rdma_srq_scale(void)
+{
+	struct spdk_nvmf_rdma_transport rtransport = {};
+	struct spdk_nvmf_rdma_resource_opts opts = {};
+	struct spdk_nvmf_rdma_poller rpoller = {};
+	struct spdk_nvmf_rdma_resources *resources;
+	const uint32_t DEPTH = 512, ICD = 4096;
+	uint64_t now;
+	uint32_t i;
+	int rc;
+
+	opts.max_queue_depth = DEPTH;
+	opts.in_capsule_data_size = ICD;
+	opts.shared = true;
+	opts.qp = &g_spdk_rdma_srq;
+	opts.buf_chunk_size = NVMF_RDMA_SRQ_CHUNK_SIZE;
+
+	/* In capsule data buffers are allocated on demand */
+	resources = nvmf_rdma_resources_create(&opts);
+	SPDK_CU_ASSERT_FATAL(resources != NULL);
+	CU_ASSERT(resources->bufs == NULL);
+	CU_ASSERT(resources->recvs[0].buf == NULL);
+	CU_ASSERT(resources->recvs[0].wr.num_sge == 1);
+
+	rpoller.srq = &g_spdk_rdma_srq;
+	rpoller.resources = resources;
+	rpoller.rtransport = &rtransport;
+	rpoller.srq_autoscale = true;
+	rpoller.max_srq_depth = DEPTH;
+	rpoller.min_srq_depth = NVMF_RDMA_SRQ_CHUNK_SIZE;
+	STAILQ_INIT(&rpoller.srq_parked);
+	for (i = 0; i < DEPTH; i++) {
+		STAILQ_INSERT_TAIL(&rpoller.srq_parked, &resources->recvs[i], link);
+	}
+	rpoller.srq_num_parked = DEPTH;
+
+	/* The minimal depth is posted regardless of the budget */
+	rtransport.rdma_opts.srq_mem_budget_mb = 1;
+	rtransport.srq_buf_mem = 1024 * 1024;
+	rc = nvmf_rdma_poller_srq_grow(&rtransport, &rpoller, rpoller.min_srq_depth, true);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(rpoller.srq_depth == 128);
+	CU_ASSERT(rpoller.srq_alloc_depth == 128);
+	CU_ASSERT(rpoller.srq_num_parked == DEPTH - 128);
+	CU_ASSERT(resources->recvs[127].buf != NULL);
+	CU_ASSERT(resources->recvs[127].wr.num_sge == 2);
+	CU_ASSERT(resources->recvs[128].buf == NULL);
+	CU_ASSERT(rtransport.srq_buf_mem == 1024 * 1024 + 128 * ICD);
+	rtransport.srq_buf_mem -= 1024 * 1024;
+
+	/* 3/4 of the receives are in use, the depth doubles */
+	now = spdk_get_ticks();
+	rpoller.srq_in_use = 96;
+	nvmf_rdma_poller_srq_scale(&rtransport, &rpoller, now);
+	CU_ASSERT(rpoller.srq_depth == 256);
+	CU_ASSERT(rpoller.srq_alloc_depth == 256);
+	CU_ASSERT(rpoller.srq_num_parked == DEPTH - 256);
+	CU_ASSERT(rpoller.stat.srq_grows == 1);
+	CU_ASSERT(rtransport.srq_buf_mem == 256 * ICD);
+
+	/* The budget is exhausted, the depth stays and the grow isn't retried in this period */
+	rtransport.rdma_opts.srq_mem_budget_mb = 1;
+	rpoller.srq_in_use = 192;
+	nvmf_rdma_poller_srq_scale(&rtransport, &rpoller, now);
+	CU_ASSERT(rpoller.srq_depth == 256);
+	CU_ASSERT(rpoller.stat.srq_budget_exhausted == 1);
+	CU_ASSERT(rpoller.srq_grow_failed == true);
+	nvmf_rdma_poller_srq_scale(&rtransport, &rpoller, now);
+	CU_ASSERT(rpoller.stat.srq_budget_exhausted == 1);
+
+	/* SRQ limit event without a budget */
+	rtransport.rdma_opts.srq_mem_budget_mb = 0;
+	rpoller.srq_limit_reached = true;
+	nvmf_rdma_poller_srq_scale(&rtransport, &rpoller, now);
+	CU_ASSERT(rpoller.srq_limit_reached == false);
+	CU_ASSERT(rpoller.stat.srq_limit_events == 1);
+	CU_ASSERT(rpoller.srq_depth == DEPTH);
+	CU_ASSERT(rpoller.srq_alloc_depth == DEPTH);
+	CU_ASSERT(rpoller.srq_num_parked == 0);
+	CU_ASSERT(rpoller.stat.srq_grows == 2);
+
+	/* Idle for a period, the depth goes down one chunk */
+	rpoller.srq_in_use = 0;
+	now = rpoller.srq_next_scale_tsc;
+	nvmf_rdma_poller_srq_scale(&rtransport, &rpoller, now);
+	CU_ASSERT(rpoller.srq_depth == DEPTH);
+	now = rpoller.srq_next_scale_tsc;
+	nvmf_rdma_poller_srq_scale(&rtransport, &rpoller, now);
+	CU_ASSERT(rpoller.srq_depth == DEPTH - 128);
+	CU_ASSERT(rpoller.stat.srq_shrinks == 1);
+
+	/* Receives above the depth are parked as they come back, then their buffers are released */
+	rpoller.srq_in_use = 128;
+	for (i = DEPTH - 128; i < DEPTH - 1; i++) {
+		nvmf_rdma_srq_queue_recv(&rpoller, &resources->recvs[i]);
+	}
+	nvmf_rdma_poller_srq_release(&rtransport, &rpoller);
+	CU_ASSERT(rpoller.srq_alloc_depth == DEPTH);
+	nvmf_rdma_srq_queue_recv(&rpoller, &resources->recvs[DEPTH - 1]);
+	CU_ASSERT(rpoller.srq_num_parked == 128);
+	CU_ASSERT(rpoller.srq_in_use == 0);
+	nvmf_rdma_poller_srq_release(&rtransport, &rpoller);
+	CU_ASSERT(rpoller.srq_alloc_depth == DEPTH - 128);
+	CU_ASSERT(resources->buf_chunks[3] == NULL);
+	CU_ASSERT(resources->recvs[DEPTH - 1].buf == NULL);
+	CU_ASSERT(resources->recvs[DEPTH - 1].wr.num_sge == 1);
+	CU_ASSERT(rtransport.srq_buf_mem == (DEPTH - 128) * ICD);
+
+	nvmf_rdma_resources_destroy(resources);
+}
+
+static struct ibv_wc g_ut_wc;
+static int g_ut_num_wc;
+
+static int
+ut_poll_cq(struct ibv_cq *cq, int num_entries, struct ibv_wc *wc)
+{
+	int num_wc = g_ut_num_wc;
+
+	if (num_wc > 0) {
+		*wc = g_ut_wc;
+		g_ut_num_wc = 0;
+	}
+
+	return num_wc;
+}
+
+static void
+test_nvmf_rdma_poller_poll_recv_overflow(void)
+{
+	struct spdk_nvmf_rdma_transport rtransport = {};
+	struct spdk_nvmf_rdma_poll_group rgroup = {};
+	struct spdk_nvmf_rdma_poller rpoller = {};
+	struct spdk_nvmf_rdma_resources resources = {};
+	struct spdk_nvmf_rdma_qpair rqpair = {};
+	struct spdk_nvmf_rdma_recv rdma_recv = {};
+	struct ibv_context context = {};
+	struct ibv_cq cq = {};
+	int rc;
+
+	context.ops.poll_cq = ut_poll_cq;
+	cq.context = &context;
+
+	STAILQ_INIT(&resources.incoming_queue);
+	STAILQ_INIT(&resources.free_queue);
+	STAILQ_INIT(&rgroup.group.pending_buf_queue);
+
+	rpoller.group = &rgroup;
+	rpoller.cq = &cq;
+	rpoller.srq = &g_spdk_rdma_srq;
+	rpoller.resources = &resources;
+	RB_INIT(&rpoller.qpairs);
+	STAILQ_INIT(&rpoller.qpairs_pending_recv);
+	STAILQ_INIT(&rpoller.qpairs_pending_send);
+
+	rqpair.qp_num = 1;
+	rqpair.poller = &rpoller;
+	rqpair.srq = rpoller.srq;
+	rqpair.resources = &resources;
+	rqpair.qpair.transport = &rtransport.transport;
+	rqpair.qpair.state = SPDK_NVMF_QPAIR_ENABLED;
+	rqpair.max_queue_depth = 4;
+	rqpair.current_recv_depth = 4;
+	STAILQ_INIT(&rqpair.pending_rdma_read_queue);
+	STAILQ_INIT(&rqpair.pending_rdma_write_queue);
+	STAILQ_INIT(&rqpair.pending_rdma_send_queue);
+	RB_INSERT(qpairs_tree, &rpoller.qpairs, &rqpair);
+
+	rdma_recv.rdma_wr.type = RDMA_WR_TYPE_RECV;
+
+	/* A receive beyond the queue depth disconnects the qpair and goes back to the SRQ */
+	g_ut_wc.wr_id = (uintptr_t)&rdma_recv.rdma_wr;
+	g_ut_wc.status = IBV_WC_SUCCESS;
+	g_ut_wc.opcode = IBV_WC_RECV;
+	g_ut_wc.qp_num = rqpair.qp_num;
+	g_ut_num_wc = 1;
+
+	rc = nvmf_rdma_poller_poll(&rtransport, &rpoller);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(rpoller.srq_in_use == 0);
+	CU_ASSERT(rqpair.current_recv_depth == 4);
+	CU_ASSERT(STAILQ_EMPTY(&resources.incoming_queue));
+	CU_ASSERT(rpoller.stat.requests == 0);
+}
+
 static void
 test_nvmf_rdma_qpair_compare(void)
 {
@@ -1454,6 +1642,8 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_nvmf_rdma_opts_init);
 	CU_ADD_TEST(suite, test_nvmf_rdma_request_free_data);
 	CU_ADD_TEST(suite, test_nvmf_rdma_resources_create);
+	CU_ADD_TEST(suite, test_nvmf_rdma_srq_scale);
+	CU_ADD_TEST(suite, test_nvmf_rdma_poller_poll_recv_overflow);
 	CU_ADD_TEST(suite, test_nvmf_rdma_qpair_compare);
 	CU_ADD_TEST(suite, test_nvmf_rdma_resize_cq);
 
@@ -77,6 +77,12 @@ DEFINE_STUB(nvmf_tgt_update_mdns_prr, int, (struct spdk_nvmf_tgt *tgt), 0);
 DEFINE_STUB(spdk_bdev_get_module_name, const char *, (const struct spdk_bdev *bdev), "nvme");
 DEFINE_STUB(spdk_bdev_get_module_ctx, void *, (struct spdk_bdev_desc *desc), NULL);
 DEFINE_STUB(spdk_nvme_ns_get_id, uint32_t, (struct spdk_nvme_ns *ns), 0);
+DEFINE_STUB(nvmf_ns_read_cache_create, struct nvmf_ns_read_cache *,
+	    (struct spdk_bdev *bdev, uint32_t size_mb), NULL);
+DEFINE_STUB_V(nvmf_ns_read_cache_destroy, (struct nvmf_ns_read_cache *cache));
+DEFINE_STUB_V(nvmf_subsystem_qos_free, (struct spdk_nvmf_subsystem *subsystem));
+DEFINE_STUB_V(nvmf_subsystem_telemetry_free, (struct spdk_nvmf_subsystem *subsystem));
+DEFINE_STUB_V(nvmf_ctrlr_free_host_states, (struct spdk_nvmf_subsystem *subsystem));
 
 static struct spdk_nvmf_transport g_transport = {};
 
@@ -1723,6 +1729,7 @@ test_nvmf_subsystem_add_ctrlr(void)
 
 	nvmf_subsystem_remove_ctrlr(subsystem, &ctrlr);
 	CU_ASSERT(TAILQ_EMPTY(&subsystem->ctrlrs));
+	CU_ASSERT(nvmf_subsystem_get_ctrlr(subsystem, 1) == NULL);
 	rc = spdk_nvmf_subsystem_destroy(subsystem, test_nvmf_subsystem_destroy_cb, NULL);
 	CU_ASSERT(rc == 0);
 	spdk_bit_array_free(&tgt.subsystem_ids);
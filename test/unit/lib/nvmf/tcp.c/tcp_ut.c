@@ -194,7 +194,36 @@ DEFINE_STUB(nvmf_bdev_ctrlr_zcopy_start,
 	     struct spdk_nvmf_request *req),
 	    0);
 
-DEFINE_STUB_V(nvmf_bdev_ctrlr_zcopy_end, (struct spdk_nvmf_request *req, bool commit));
+void
+nvmf_bdev_ctrlr_zcopy_end(struct spdk_nvmf_request *req, bool commit)
+{
+	/* Only the read cache lines are released synchronously */
+	if (req->zcopy_cached) {
+		req->zcopy_cached = 0;
+		spdk_nvmf_request_complete(req);
+	}
+}
+
+DEFINE_STUB(nvmf_bdev_ctrlr_cached_read_cmd,
+	    int,
+	    (struct spdk_bdev *bdev, struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+	     struct spdk_nvmf_request *req, struct nvmf_ns_read_cache_shard *shard),
+	    0);
+
+DEFINE_STUB(nvmf_bdev_ctrlr_cached_zcopy_start,
+	    int,
+	    (struct spdk_bdev *bdev, struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+	     struct spdk_nvmf_request *req, struct nvmf_ns_read_cache_shard *shard),
+	    0);
+
+DEFINE_STUB(nvmf_ns_read_cache_cmd_modifies, bool, (const struct spdk_nvme_cmd *cmd), false);
+
+DEFINE_STUB_V(nvmf_ns_read_cache_invalidate,
+	      (struct nvmf_ns_read_cache *cache, const struct spdk_nvme_cmd *cmd));
+DEFINE_STUB(nvmf_qos_admit, bool, (struct spdk_nvmf_poll_group *group,
+				   struct spdk_nvmf_subsystem_poll_group *sgroup, struct spdk_nvmf_request *req), true);
+DEFINE_STUB_V(nvmf_telemetry_record, (struct spdk_nvmf_subsystem_poll_group *sgroup,
+				      struct spdk_nvmf_request *req));
 
 DEFINE_STUB_V(spdk_nvmf_request_free_buffers,
 	      (struct spdk_nvmf_request *req, struct spdk_nvmf_transport_poll_group *group,
@@ -749,6 +778,7 @@ test_nvmf_tcp_in_capsule_data_handle(void)
 
 	tcp_group.sock_group = &grp;
 	TAILQ_INIT(&tcp_group.qpairs);
+	TAILQ_INIT(&tcp_group.flush_qpairs);
 	group = &tcp_group.group;
 	group->transport = &ttransport.transport;
 	tqpair.group = &tcp_group;
@@ -887,6 +917,213 @@ test_nvmf_tcp_qpair_init_mem_resource(void)
 	spdk_thread_destroy(thread);
 }
 
+static void
+test_nvmf_tcp_shared_buf_pool(void)
+{
+	struct spdk_nvmf_tcp_qpair *tqpair;
+	struct spdk_nvmf_tcp_poll_group tgroup = {};
+	struct spdk_nvmf_transport transport = {};
+	struct spdk_nvmf_tcp_buf_pool *pool;
+	struct spdk_nvmf_tcp_buf *bufs[NVMF_TCP_BUF_POOL_CHUNK_SIZE + 1];
+	struct spdk_nvmf_tcp_req *tcp_req;
+	struct spdk_thread *thread;
+	uint32_t i;
+	int rc;
+
+	thread = spdk_thread_create(NULL, NULL);
+	SPDK_CU_ASSERT_FATAL(thread != NULL);
+	spdk_set_thread(thread);
+
+	pool = nvmf_tcp_buf_pool_create(4096);
+	SPDK_CU_ASSERT_FATAL(pool != NULL);
+	CU_ASSERT(pool->num_chunks == 0);
+	CU_ASSERT(pool->num_free == 0);
+
+	/* The pool grows one chunk at a time */
+	for (i = 0; i < NVMF_TCP_BUF_POOL_CHUNK_SIZE + 1; i++) {
+		bufs[i] = nvmf_tcp_buf_pool_get(pool);
+		SPDK_CU_ASSERT_FATAL(bufs[i] != NULL);
+		CU_ASSERT(bufs[i]->pdu != NULL);
+		CU_ASSERT(bufs[i]->buf != NULL);
+	}
+	CU_ASSERT(pool->num_chunks == 2);
+	CU_ASSERT(pool->num_grows == 2);
+	CU_ASSERT(pool->num_free == NVMF_TCP_BUF_POOL_CHUNK_SIZE - 1);
+
+	/* And gives back a chunk once it's unused and there's a spare one */
+	for (i = 0; i < NVMF_TCP_BUF_POOL_CHUNK_SIZE + 1; i++) {
+		nvmf_tcp_buf_pool_put(bufs[i]);
+	}
+	CU_ASSERT(pool->num_chunks == 1);
+	CU_ASSERT(pool->num_shrinks == 1);
+	CU_ASSERT(pool->num_free == NVMF_TCP_BUF_POOL_CHUNK_SIZE);
+
+	/* Qpairs only keep the receive PDUs, requests take their PDU and buffer from the pool */
+	tgroup.buf_pool = pool;
+	tqpair = calloc(1, sizeof(*tqpair));
+	SPDK_CU_ASSERT_FATAL(tqpair != NULL);
+	tqpair->qpair.transport = &transport;
+	tqpair->group = &tgroup;
+	nvmf_tcp_opts_init(&transport.opts);
+
+	rc = nvmf_tcp_qpair_init(&tqpair->qpair);
+	CU_ASSERT(rc == 0);
+	rc = nvmf_tcp_qpair_init_mem_resource(tqpair);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(tqpair->bufs == NULL);
+	CU_ASSERT(tqpair->reqs[0].pdu == NULL);
+	CU_ASSERT(tqpair->reqs[0].buf == NULL);
+	CU_ASSERT(tqpair->mgmt_pdu == &tqpair->pdus[NVMF_TCP_QPAIR_RECV_PDU_NUM]);
+	CU_ASSERT(tqpair->pdu_in_progress == &tqpair->pdus[NVMF_TCP_QPAIR_RECV_PDU_NUM - 1]);
+
+	tcp_req = nvmf_tcp_req_get(tqpair);
+	SPDK_CU_ASSERT_FATAL(tcp_req != NULL);
+	CU_ASSERT(tcp_req->pool_buf != NULL);
+	CU_ASSERT(tcp_req->pdu->qpair == tqpair);
+	CU_ASSERT(tcp_req->buf != NULL);
+	CU_ASSERT(pool->num_free == NVMF_TCP_BUF_POOL_CHUNK_SIZE - 1);
+
+	nvmf_tcp_req_put(tqpair, tcp_req);
+	CU_ASSERT(tcp_req->pool_buf == NULL);
+	CU_ASSERT(tcp_req->pdu == NULL);
+	CU_ASSERT(pool->num_free == NVMF_TCP_BUF_POOL_CHUNK_SIZE);
+
+	/* An outstanding entry keeps the pool alive past the poll group */
+	tcp_req = nvmf_tcp_req_get(tqpair);
+	SPDK_CU_ASSERT_FATAL(tcp_req != NULL);
+	nvmf_tcp_buf_pool_destroy(pool);
+	CU_ASSERT(pool->orphaned == true);
+	nvmf_tcp_req_put(tqpair, tcp_req);
+
+	tqpair->group = NULL;
+	nvmf_tcp_qpair_destroy(tqpair);
+
+	spdk_thread_exit(thread);
+	while (!spdk_thread_is_exited(thread)) {
+		spdk_thread_poll(thread, 0, 0);
+	}
+	spdk_thread_destroy(thread);
+}
+
+static void
+test_nvmf_tcp_poll_group_flush(void)
+{
+	struct spdk_nvmf_tcp_poll_group tgroup = {};
+	struct spdk_nvmf_tcp_qpair tqpair1 = {}, tqpair2 = {};
+	struct spdk_sock sock1 = {}, sock2 = {};
+	struct spdk_sock_request req = {};
+
+	TAILQ_INIT(&tgroup.qpairs);
+	TAILQ_INIT(&tgroup.flush_qpairs);
+	TAILQ_INIT(&sock1.queued_reqs);
+	TAILQ_INIT(&sock2.queued_reqs);
+	tqpair1.group = &tgroup;
+	tqpair1.sock = &sock1;
+	tqpair2.group = &tgroup;
+	tqpair2.sock = &sock2;
+
+	/* Each qpair is queued once, no matter how many PDUs it wrote */
+	nvmf_tcp_qpair_queue_flush(&tqpair1);
+	nvmf_tcp_qpair_queue_flush(&tqpair1);
+	nvmf_tcp_qpair_queue_flush(&tqpair2);
+	CU_ASSERT(TAILQ_FIRST(&tgroup.flush_qpairs) == &tqpair1);
+	CU_ASSERT(TAILQ_NEXT(&tqpair1, flush_link) == &tqpair2);
+	CU_ASSERT(TAILQ_NEXT(&tqpair2, flush_link) == NULL);
+	CU_ASSERT(tqpair1.unflushed_pdus == 2);
+	CU_ASSERT(tqpair2.unflushed_pdus == 1);
+
+	/* A qpair that couldn't be flushed stays on the list */
+	MOCK_SET(spdk_sock_flush, -1);
+	errno = EAGAIN;
+	nvmf_tcp_poll_group_flush(&tgroup);
+	CU_ASSERT(tqpair1.pending_flush == true);
+	CU_ASSERT(tqpair2.pending_flush == true);
+	CU_ASSERT(TAILQ_FIRST(&tgroup.flush_qpairs) == &tqpair1);
+	CU_ASSERT(TAILQ_NEXT(&tqpair1, flush_link) == &tqpair2);
+	CU_ASSERT(tqpair1.unflushed_pdus == 2);
+	CU_ASSERT(tqpair2.unflushed_pdus == 1);
+	CU_ASSERT(tgroup.stat.flushes == 0);
+
+	/* Then all of the PDUs of a socket are written by a single flush */
+	MOCK_SET(spdk_sock_flush, 4096);
+	nvmf_tcp_poll_group_flush(&tgroup);
+	CU_ASSERT(TAILQ_EMPTY(&tgroup.flush_qpairs));
+	CU_ASSERT(tqpair1.pending_flush == false);
+	CU_ASSERT(tqpair1.unflushed_pdus == 0);
+	CU_ASSERT(tqpair2.pending_flush == false);
+	CU_ASSERT(tgroup.stat.flushes == 2);
+	CU_ASSERT(tgroup.stat.flushed_pdus == 3);
+
+	/* The rest of a partial write goes out on the next flush */
+	nvmf_tcp_qpair_queue_flush(&tqpair1);
+	nvmf_tcp_qpair_queue_flush(&tqpair2);
+	TAILQ_INSERT_TAIL(&sock1.queued_reqs, &req, internal.link);
+	nvmf_tcp_poll_group_flush(&tgroup);
+	CU_ASSERT(TAILQ_FIRST(&tgroup.flush_qpairs) == &tqpair1);
+	CU_ASSERT(TAILQ_NEXT(&tqpair1, flush_link) == NULL);
+	CU_ASSERT(tqpair1.pending_flush == true);
+	CU_ASSERT(tqpair1.unflushed_pdus == 0);
+	CU_ASSERT(tqpair2.pending_flush == false);
+	CU_ASSERT(tgroup.stat.flushes == 4);
+	CU_ASSERT(tgroup.stat.flushed_pdus == 5);
+
+	TAILQ_REMOVE(&sock1.queued_reqs, &req, internal.link);
+	nvmf_tcp_poll_group_flush(&tgroup);
+	CU_ASSERT(TAILQ_EMPTY(&tgroup.flush_qpairs));
+	CU_ASSERT(tqpair1.pending_flush == false);
+	CU_ASSERT(tgroup.stat.flushes == 5);
+	CU_ASSERT(tgroup.stat.flushed_pdus == 5);
+
+	/* Removing the qpair from the group drops it from the list */
+	nvmf_tcp_qpair_queue_flush(&tqpair1);
+	nvmf_tcp_qpair_remove_flush(&tqpair1);
+	CU_ASSERT(TAILQ_EMPTY(&tgroup.flush_qpairs));
+	CU_ASSERT(tqpair1.pending_flush == false);
+
+	MOCK_SET(spdk_sock_flush, 0);
+}
+
+static void
+test_nvmf_tcp_poll_group_migrate_out(void)
+{
+	struct spdk_nvmf_tcp_poll_group tgroup = {};
+	struct spdk_nvmf_tcp_qpair tqpair = {};
+	struct spdk_sock sock = {};
+	struct spdk_sock_group grp = {};
+
+	TAILQ_INIT(&tgroup.qpairs);
+	TAILQ_INIT(&tgroup.flush_qpairs);
+	tgroup.sock_group = &grp;
+	tqpair.group = &tgroup;
+	tqpair.sock = &sock;
+	tqpair.state = NVMF_TCP_QPAIR_STATE_RUNNING;
+	tqpair.recv_state = NVME_TCP_PDU_RECV_STATE_AWAIT_PDU_READY;
+	TAILQ_INSERT_TAIL(&tgroup.qpairs, &tqpair, link);
+
+	/* A qpair whose PDUs can't be written out yet stays in the group, on the flush list */
+	nvmf_tcp_qpair_queue_flush(&tqpair);
+	MOCK_SET(spdk_sock_flush, -1);
+	MOCK_SET(spdk_sock_has_unsent_data, true);
+	errno = EAGAIN;
+	CU_ASSERT(nvmf_tcp_poll_group_migrate_out(&tgroup.group, &tqpair.qpair) == -EBUSY);
+	CU_ASSERT(tqpair.pending_flush == true);
+	CU_ASSERT(TAILQ_FIRST(&tgroup.flush_qpairs) == &tqpair);
+	CU_ASSERT(tqpair.group == &tgroup);
+
+	/* Nor can it move while zero copy writes are still in flight */
+	MOCK_SET(spdk_sock_flush, 4096);
+	CU_ASSERT(nvmf_tcp_poll_group_migrate_out(&tgroup.group, &tqpair.qpair) == -EBUSY);
+	CU_ASSERT(TAILQ_EMPTY(&tgroup.flush_qpairs));
+	CU_ASSERT(tqpair.group == &tgroup);
+
+	MOCK_SET(spdk_sock_has_unsent_data, false);
+	CU_ASSERT(nvmf_tcp_poll_group_migrate_out(&tgroup.group, &tqpair.qpair) == 0);
+	CU_ASSERT(TAILQ_EMPTY(&tgroup.qpairs));
+	CU_ASSERT(tqpair.group == NULL);
+
+	MOCK_SET(spdk_sock_flush, 0);
+}
+
 static void
 test_nvmf_tcp_send_c2h_term_req(void)
 {
@@ -1044,6 +1281,7 @@ test_nvmf_tcp_check_xfer_type(void)
 
 	tcp_group.sock_group = &grp;
 	TAILQ_INIT(&tcp_group.qpairs);
+	TAILQ_INIT(&tcp_group.flush_qpairs);
 	group = &tcp_group.group;
 	group->transport = &ttransport.transport;
 	tqpair.group = &tcp_group;
@@ -1117,6 +1355,7 @@ test_nvmf_tcp_invalid_sgl(void)
 
 	tcp_group.sock_group = &grp;
 	TAILQ_INIT(&tcp_group.qpairs);
+	TAILQ_INIT(&tcp_group.flush_qpairs);
 	group = &tcp_group.group;
 	group->transport = &ttransport.transport;
 	tqpair.group = &tcp_group;
@@ -1522,6 +1761,99 @@ test_nvmf_tcp_tls_generate_tls_psk(void)
 					  NVME_TCP_CIPHER_AES_128_GCM_SHA256) < 0);
 }
 
+static void
+ut_sgroup_paused(void *cb_arg, int status)
+{
+	*(int *)cb_arg = status;
+}
+
+static void
+test_nvmf_tcp_zcopy_cached_release(void)
+{
+	struct spdk_thread *thread;
+	struct spdk_nvmf_tcp_transport ttransport = {};
+	struct spdk_nvmf_tcp_poll_group tcp_group = {};
+	struct spdk_nvmf_tcp_qpair tqpair = {};
+	struct spdk_nvmf_tcp_req tcp_req = {};
+	struct spdk_nvmf_poll_group group = {};
+	struct spdk_nvmf_subsystem_poll_group sgroup = {};
+	struct spdk_nvmf_subsystem_pg_ns_info ns_info = {};
+	struct spdk_nvmf_subsystem subsystem = {};
+	struct spdk_nvmf_ctrlr ctrlr = {};
+	union nvmf_c2h_msg rsp = {};
+	int paused = -1;
+
+	thread = spdk_thread_create(NULL, NULL);
+	SPDK_CU_ASSERT_FATAL(thread != NULL);
+	spdk_set_thread(thread);
+
+	subsystem.id = 0;
+	ctrlr.subsys = &subsystem;
+	group.thread = thread;
+	group.sgroups = &sgroup;
+	sgroup.ns_info = &ns_info;
+	sgroup.num_ns = 1;
+	sgroup.state = SPDK_NVMF_SUBSYSTEM_ACTIVE;
+	ns_info.state = SPDK_NVMF_SUBSYSTEM_ACTIVE;
+
+	TAILQ_INIT(&tcp_group.qpairs);
+	tcp_group.group.transport = &ttransport.transport;
+	tqpair.group = &tcp_group;
+	TAILQ_INIT(&tqpair.tcp_req_free_queue);
+	TAILQ_INIT(&tqpair.tcp_req_working_queue);
+	TAILQ_INIT(&tqpair.qpair.outstanding);
+	tqpair.qpair.transport = &ttransport.transport;
+	tqpair.qpair.group = &group;
+	tqpair.qpair.ctrlr = &ctrlr;
+	tqpair.qpair.qid = 1;
+	tqpair.qpair.state = SPDK_NVMF_QPAIR_ENABLED;
+	tqpair.state = NVMF_TCP_QPAIR_STATE_RUNNING;
+
+	tcp_req.req.qpair = &tqpair.qpair;
+	tcp_req.req.cmd = (union nvmf_h2c_msg *)&tcp_req.cmd;
+	tcp_req.req.rsp = &rsp;
+	tcp_req.req.xfer = SPDK_NVME_DATA_CONTROLLER_TO_HOST;
+	tcp_req.cmd.opc = SPDK_NVME_OPC_READ;
+	tcp_req.cmd.nsid = 1;
+	TAILQ_INSERT_TAIL(&tqpair.tcp_req_working_queue, &tcp_req, state_link);
+	tcp_req.state = TCP_REQUEST_STATE_EXECUTING;
+	tqpair.state_cntr[TCP_REQUEST_STATE_EXECUTING]++;
+
+	/* A read served from the read cache completes the zcopy start right away */
+	TAILQ_INSERT_TAIL(&tqpair.qpair.outstanding, &tcp_req.req, link);
+	ns_info.io_outstanding = 1;
+	tcp_req.req.zcopy_phase = NVMF_ZCOPY_PHASE_INIT;
+	tcp_req.req.zcopy_bdev_io = NULL;
+	tcp_req.req.zcopy_cached = 1;
+	spdk_nvmf_request_complete(&tcp_req.req);
+	CU_ASSERT(tcp_req.req.zcopy_phase == NVMF_ZCOPY_PHASE_EXECUTE);
+	CU_ASSERT(spdk_nvmf_request_zcopy_buffers_held(&tcp_req.req));
+	CU_ASSERT(ns_info.io_outstanding == 1);
+
+	/* The subsystem can't be paused while the cache lines are held */
+	sgroup.state = SPDK_NVMF_SUBSYSTEM_PAUSING;
+	ns_info.state = SPDK_NVMF_SUBSYSTEM_PAUSING;
+	sgroup.cb_fn = ut_sgroup_paused;
+	sgroup.cb_arg = &paused;
+
+	/* Once the data is sent, the transport releases the lines and the pause completes */
+	nvmf_tcp_req_set_state(&tcp_req, TCP_REQUEST_STATE_COMPLETED);
+	nvmf_tcp_req_process(&ttransport, &tcp_req);
+	CU_ASSERT(tcp_req.state == TCP_REQUEST_STATE_AWAITING_ZCOPY_RELEASE);
+	CU_ASSERT(tcp_req.req.zcopy_phase == NVMF_ZCOPY_PHASE_COMPLETE);
+	CU_ASSERT(!spdk_nvmf_request_zcopy_buffers_held(&tcp_req.req));
+	CU_ASSERT(TAILQ_EMPTY(&tqpair.qpair.outstanding));
+	CU_ASSERT(ns_info.io_outstanding == 0);
+	CU_ASSERT(sgroup.state == SPDK_NVMF_SUBSYSTEM_PAUSED);
+	CU_ASSERT(paused == 0);
+
+	spdk_thread_exit(thread);
+	while (!spdk_thread_is_exited(thread)) {
+		spdk_thread_poll(thread, 0, 0);
+	}
+	spdk_thread_destroy(thread);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -1539,6 +1871,9 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_nvmf_tcp_h2c_data_hdr_handle);
 	CU_ADD_TEST(suite, test_nvmf_tcp_in_capsule_data_handle);
 	CU_ADD_TEST(suite, test_nvmf_tcp_qpair_init_mem_resource);
+	CU_ADD_TEST(suite, test_nvmf_tcp_shared_buf_pool);
+	CU_ADD_TEST(suite, test_nvmf_tcp_poll_group_flush);
+	CU_ADD_TEST(suite, test_nvmf_tcp_poll_group_migrate_out);
 	CU_ADD_TEST(suite, test_nvmf_tcp_send_c2h_term_req);
 	CU_ADD_TEST(suite, test_nvmf_tcp_send_capsule_resp_pdu);
 	CU_ADD_TEST(suite, test_nvmf_tcp_icreq_handle);
@@ -1549,6 +1884,7 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_nvmf_tcp_tls_generate_psk_id);
 	CU_ADD_TEST(suite, test_nvmf_tcp_tls_generate_retained_psk);
 	CU_ADD_TEST(suite, test_nvmf_tcp_tls_generate_tls_psk);
+	CU_ADD_TEST(suite, test_nvmf_tcp_zcopy_cached_release);
 
 	num_failures = spdk_ut_run_tests(argc, argv, NULL);
 	CU_cleanup_registry();
@@ -0,0 +1,432 @@
+/*   SPDX-License-Identifier: BSD-3-Clause
+ *   Copyright (C) 2026 agent. All rights reserved.
+ */
+
+#include "spdk/stdinc.h"
+#include "spdk_internal/cunit.h"
+#include "common/lib/ut_multithread.c"
+#include "nvmf/telemetry.c"
+
+#define HOST1 "nqn.2016-06.io.spdk:host1"
+#define HOST2 "nqn.2016-06.io.spdk:host2"
+#define NUM_NS 2
+
+struct telemetry_ut_req {
+	struct spdk_nvmf_request	req;
+	union nvmf_h2c_msg		cmd;
+	union nvmf_c2h_msg		rsp;
+};
+
+static struct spdk_nvmf_tgt g_tgt;
+static struct spdk_nvmf_subsystem g_subsystem = {
+	.subnqn = "nqn.2016-06.io.spdk:cnode1",
+	.tgt = &g_tgt,
+};
+static struct spdk_nvmf_ctrlr g_ctrlr1 = { .hostnqn = HOST1 };
+static struct spdk_nvmf_ctrlr g_ctrlr2 = { .hostnqn = HOST2 };
+static struct spdk_io_channel *g_ch[2];
+static struct spdk_nvmf_qpair g_qpair[2][2];
+
+static struct nvmf_telemetry_report *g_report;
+static int g_status;
+
+struct spdk_nvmf_subsystem *
+spdk_nvmf_tgt_find_subsystem(struct spdk_nvmf_tgt *tgt, const char *subnqn)
+{
+	return strcmp(subnqn, g_subsystem.subnqn) == 0 ? &g_subsystem : NULL;
+}
+
+static int
+ut_poll_group_create(void *io_device, void *ctx_buf)
+{
+	struct spdk_nvmf_poll_group *group = ctx_buf;
+	struct spdk_nvmf_subsystem_poll_group *sgroup;
+	uint32_t i;
+
+	group->sgroups = calloc(1, sizeof(*group->sgroups));
+	SPDK_CU_ASSERT_FATAL(group->sgroups != NULL);
+	group->num_sgroups = 1;
+
+	sgroup = &group->sgroups[0];
+	TAILQ_INIT(&sgroup->telemetry_hosts);
+	sgroup->ns_info = calloc(NUM_NS, sizeof(*sgroup->ns_info));
+	SPDK_CU_ASSERT_FATAL(sgroup->ns_info != NULL);
+	sgroup->num_ns = NUM_NS;
+	for (i = 0; i < NUM_NS; i++) {
+		spdk_uuid_generate(&sgroup->ns_info[i].uuid);
+	}
+
+	return 0;
+}
+
+static void
+ut_poll_group_destroy(void *io_device, void *ctx_buf)
+{
+	struct spdk_nvmf_poll_group *group = ctx_buf;
+
+	nvmf_poll_group_telemetry_destroy(&group->sgroups[0]);
+	free(group->sgroups[0].ns_info);
+	free(group->sgroups);
+}
+
+static struct spdk_nvmf_subsystem_poll_group *
+get_sgroup(int i)
+{
+	struct spdk_nvmf_poll_group *group = spdk_io_channel_get_ctx(g_ch[i]);
+
+	return &group->sgroups[0];
+}
+
+static void
+setup(void)
+{
+	struct spdk_nvmf_poll_group *group;
+	int i;
+
+	allocate_threads(2);
+	set_thread(0);
+	spdk_io_device_register(&g_tgt, ut_poll_group_create, ut_poll_group_destroy,
+				sizeof(struct spdk_nvmf_poll_group), "nvmf_tgt");
+
+	g_subsystem.state = SPDK_NVMF_SUBSYSTEM_INACTIVE;
+	g_subsystem.telemetry = false;
+	TAILQ_INIT(&g_subsystem.telemetry_baseline);
+
+	for (i = 0; i < 2; i++) {
+		set_thread(i);
+		g_ch[i] = spdk_get_io_channel(&g_tgt);
+		SPDK_CU_ASSERT_FATAL(g_ch[i] != NULL);
+		group = spdk_io_channel_get_ctx(g_ch[i]);
+		memset(g_qpair[i], 0, sizeof(g_qpair[i]));
+		g_qpair[i][0].ctrlr = &g_ctrlr1;
+		g_qpair[i][0].group = group;
+		g_qpair[i][1].ctrlr = &g_ctrlr2;
+		g_qpair[i][1].group = group;
+	}
+	set_thread(0);
+}
+
+static void
+cleanup(void)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		set_thread(i);
+		spdk_put_io_channel(g_ch[i]);
+	}
+	poll_threads();
+	set_thread(0);
+	spdk_io_device_unregister(&g_tgt, NULL);
+	poll_threads();
+	nvmf_subsystem_telemetry_free(&g_subsystem);
+	free_threads();
+}
+
+static void
+update_poll_groups(void)
+{
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		nvmf_poll_group_telemetry_update(get_sgroup(i), &g_subsystem);
+	}
+}
+
+static void
+complete_io(int pg, int host, uint32_t nsid, uint8_t opc, uint32_t length, uint64_t latency_us,
+	    bool error)
+{
+	struct telemetry_ut_req r = {};
+
+	set_thread(pg);
+	r.req.qpair = &g_qpair[pg][host];
+	r.req.cmd = &r.cmd;
+	r.req.rsp = &r.rsp;
+	r.req.length = length;
+	r.cmd.nvme_cmd.opc = opc;
+	r.cmd.nvme_cmd.nsid = nsid;
+	if (error) {
+		r.rsp.nvme_cpl.status.sc = SPDK_NVME_SC_INTERNAL_DEVICE_ERROR;
+	}
+
+	/* The test environment runs at 1 tick per microsecond */
+	r.req.submit_tsc = spdk_get_ticks();
+	r.req.telemetry = 1;
+	spdk_delay_us(latency_us);
+	nvmf_telemetry_record(get_sgroup(pg), &r.req);
+	set_thread(0);
+}
+
+static void
+collect_done(void *cb_arg, struct nvmf_telemetry_report *report, int status)
+{
+	g_report = report;
+	g_status = status;
+}
+
+static struct nvmf_telemetry_report *
+collect(const char *hostnqn, uint32_t nsid, bool delta)
+{
+	g_report = NULL;
+	g_status = 1;
+	CU_ASSERT(nvmf_subsystem_telemetry_collect(&g_subsystem, hostnqn, nsid, delta,
+			collect_done, NULL) == 0);
+	poll_threads();
+	CU_ASSERT(g_status == 0);
+
+	return g_report;
+}
+
+static struct nvmf_telemetry_entry *
+find_entry(struct nvmf_telemetry_report *report, const char *hostnqn, uint32_t nsid)
+{
+	struct nvmf_telemetry_entry *entry;
+
+	TAILQ_FOREACH(entry, &report->entries, link) {
+		if (entry->nsid == nsid && strcmp(entry->hostnqn, hostnqn) == 0) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static int
+count_entries(struct nvmf_telemetry_report *report)
+{
+	struct nvmf_telemetry_entry *entry;
+	int count = 0;
+
+	TAILQ_FOREACH(entry, &report->entries, link) {
+		count++;
+	}
+
+	return count;
+}
+
+static void
+test_nvmf_telemetry_enable(void)
+{
+	struct spdk_nvmf_subsystem_poll_group *sgroup;
+	struct nvmf_telemetry_report *report;
+	uint64_t gen;
+
+	setup();
+	sgroup = get_sgroup(0);
+
+	/* Only changed while the subsystem isn't active */
+	g_subsystem.state = SPDK_NVMF_SUBSYSTEM_ACTIVE;
+	CU_ASSERT(spdk_nvmf_subsystem_set_telemetry(&g_subsystem, true) == -EAGAIN);
+	CU_ASSERT(!g_subsystem.telemetry);
+	g_subsystem.state = SPDK_NVMF_SUBSYSTEM_PAUSED;
+	CU_ASSERT(spdk_nvmf_subsystem_set_telemetry(&g_subsystem, true) == 0);
+	CU_ASSERT(g_subsystem.telemetry);
+
+	/* Nothing is collected until the poll groups pick it up */
+	report = collect(NULL, 0, false);
+	SPDK_CU_ASSERT_FATAL(report != NULL);
+	CU_ASSERT(TAILQ_EMPTY(&report->entries));
+	nvmf_telemetry_report_free(report);
+
+	/* The poll groups pick it up on resume */
+	CU_ASSERT(!sgroup->telemetry);
+	update_poll_groups();
+	CU_ASSERT(sgroup->telemetry);
+	gen = sgroup->telemetry_gen;
+	CU_ASSERT(gen != 0);
+
+	/* The qpairs look their host up once and then use the cached state */
+	complete_io(0, 0, 1, SPDK_NVME_OPC_READ, 4096, 10, false);
+	CU_ASSERT(g_qpair[0][0].telemetry_gen == gen);
+	CU_ASSERT(g_qpair[0][0].telemetry_host == TAILQ_FIRST(&sgroup->telemetry_hosts));
+	complete_io(0, 0, 2, SPDK_NVME_OPC_READ, 4096, 10, false);
+	CU_ASSERT(TAILQ_NEXT(TAILQ_FIRST(&sgroup->telemetry_hosts), link) == NULL);
+
+	/* Disabling it drops the statistics */
+	CU_ASSERT(spdk_nvmf_subsystem_set_telemetry(&g_subsystem, false) == 0);
+	update_poll_groups();
+	CU_ASSERT(!sgroup->telemetry);
+	CU_ASSERT(TAILQ_EMPTY(&sgroup->telemetry_hosts));
+	CU_ASSERT(sgroup->telemetry_gen != gen);
+	CU_ASSERT(nvmf_subsystem_telemetry_collect(&g_subsystem, NULL, 0, false, collect_done,
+			NULL) == -EINVAL);
+
+	/* I/O submitted before that are ignored */
+	complete_io(0, 0, 1, SPDK_NVME_OPC_READ, 4096, 10, false);
+	CU_ASSERT(TAILQ_EMPTY(&sgroup->telemetry_hosts));
+
+	cleanup();
+}
+
+static void
+test_nvmf_telemetry_collect(void)
+{
+	struct nvmf_telemetry_report *report;
+	struct nvmf_telemetry_entry *entry;
+	struct spdk_histogram_data *latency;
+
+	setup();
+	CU_ASSERT(spdk_nvmf_subsystem_set_telemetry(&g_subsystem, true) == 0);
+	update_poll_groups();
+
+	/* Host 1 on namespace 1 from both poll groups */
+	complete_io(0, 0, 1, SPDK_NVME_OPC_READ, 4096, 10, false);
+	complete_io(1, 0, 1, SPDK_NVME_OPC_READ, 8192, 20, false);
+	complete_io(1, 0, 1, SPDK_NVME_OPC_WRITE, 512, 100, true);
+	/* Host 2 on namespace 2 */
+	complete_io(0, 1, 2, SPDK_NVME_OPC_FLUSH, 0, 1000, false);
+	/* Invalid namespaces aren't accounted for */
+	complete_io(0, 1, NUM_NS + 1, SPDK_NVME_OPC_READ, 4096, 10, false);
+
+	report = collect(NULL, 0, false);
+	SPDK_CU_ASSERT_FATAL(report != NULL);
+	CU_ASSERT(report->tick_rate == spdk_get_ticks_hz());
+	CU_ASSERT(count_entries(report) == 2);
+
+	entry = find_entry(report, HOST1, 1);
+	SPDK_CU_ASSERT_FATAL(entry != NULL);
+	CU_ASSERT(entry->stat.read_ios == 2);
+	CU_ASSERT(entry->stat.write_ios == 1);
+	CU_ASSERT(entry->stat.other_ios == 0);
+	CU_ASSERT(entry->stat.bytes_read == 4096 + 8192);
+	CU_ASSERT(entry->stat.bytes_written == 512);
+	CU_ASSERT(entry->stat.errors == 1);
+	CU_ASSERT(entry->stat.latency_ticks == 130);
+	/* 10 and 20 ticks land in [8, 16) and [16, 32), 100 in [64, 128) */
+	latency = entry->stat.latency;
+	CU_ASSERT(latency->bucket[4] == 1);
+	CU_ASSERT(latency->bucket[5] == 1);
+	CU_ASSERT(latency->bucket[7] == 1);
+
+	entry = find_entry(report, HOST2, 2);
+	SPDK_CU_ASSERT_FATAL(entry != NULL);
+	CU_ASSERT(entry->stat.other_ios == 1);
+	CU_ASSERT(entry->stat.errors == 0);
+	CU_ASSERT(entry->stat.latency->bucket[10] == 1);
+	nvmf_telemetry_report_free(report);
+
+	/* Filter on a host and a namespace */
+	report = collect(HOST2, 0, false);
+	SPDK_CU_ASSERT_FATAL(report != NULL);
+	CU_ASSERT(count_entries(report) == 1);
+	CU_ASSERT(find_entry(report, HOST2, 2) != NULL);
+	nvmf_telemetry_report_free(report);
+
+	report = collect(HOST1, 2, false);
+	SPDK_CU_ASSERT_FATAL(report != NULL);
+	CU_ASSERT(count_entries(report) == 0);
+	nvmf_telemetry_report_free(report);
+
+	/* Replacing a namespace drops its statistics */
+	spdk_uuid_generate(&get_sgroup(0)->ns_info[1].uuid);
+	update_poll_groups();
+	report = collect(NULL, 0, false);
+	SPDK_CU_ASSERT_FATAL(report != NULL);
+	CU_ASSERT(count_entries(report) == 1);
+	CU_ASSERT(find_entry(report, HOST2, 2) == NULL);
+	nvmf_telemetry_report_free(report);
+
+	/* Fail if the subsystem is gone in the meantime */
+	g_report = NULL;
+	g_status = 0;
+	CU_ASSERT(nvmf_subsystem_telemetry_collect(&g_subsystem, NULL, 0, false, collect_done,
+			NULL) == 0);
+	snprintf(g_subsystem.subnqn, sizeof(g_subsystem.subnqn), "nqn.2016-06.io.spdk:cnode2");
+	poll_threads();
+	CU_ASSERT(g_status == -ENODEV);
+	CU_ASSERT(g_report == NULL);
+	snprintf(g_subsystem.subnqn, sizeof(g_subsystem.subnqn), "nqn.2016-06.io.spdk:cnode1");
+
+	cleanup();
+}
+
+static void
+test_nvmf_telemetry_delta(void)
+{
+	struct nvmf_telemetry_report *report;
+	struct nvmf_telemetry_entry *entry;
+
+	setup();
+	CU_ASSERT(spdk_nvmf_subsystem_set_telemetry(&g_subsystem, true) == 0);
+	update_poll_groups();
+
+	complete_io(0, 0, 1, SPDK_NVME_OPC_READ, 4096, 10, false);
+	complete_io(1, 0, 1, SPDK_NVME_OPC_READ, 4096, 10, false);
+
+	/* The first delta read reports everything since the telemetry was enabled */
+	spdk_delay_us(1000);
+	report = collect(NULL, 0, true);
+	SPDK_CU_ASSERT_FATAL(report != NULL);
+	CU_ASSERT(report->delta);
+	CU_ASSERT(report->interval_ticks == 1020);
+	entry = find_entry(report, HOST1, 1);
+	SPDK_CU_ASSERT_FATAL(entry != NULL);
+	CU_ASSERT(entry->stat.read_ios == 2);
+	CU_ASSERT(entry->stat.latency->bucket[4] == 2);
+	nvmf_telemetry_report_free(report);
+
+	/* The next one only what happened since then */
+	complete_io(1, 0, 1, SPDK_NVME_OPC_READ, 4096, 100, false);
+	report = collect(NULL, 0, true);
+	SPDK_CU_ASSERT_FATAL(report != NULL);
+	CU_ASSERT(report->interval_ticks == 100);
+	entry = find_entry(report, HOST1, 1);
+	SPDK_CU_ASSERT_FATAL(entry != NULL);
+	CU_ASSERT(entry->stat.read_ios == 1);
+	CU_ASSERT(entry->stat.bytes_read == 4096);
+	CU_ASSERT(entry->stat.latency_ticks == 100);
+	CU_ASSERT(entry->stat.latency->bucket[4] == 0);
+	CU_ASSERT(entry->stat.latency->bucket[7] == 1);
+	nvmf_telemetry_report_free(report);
+
+	/* Reading the totals doesn't move the baseline */
+	report = collect(NULL, 0, false);
+	SPDK_CU_ASSERT_FATAL(report != NULL);
+	entry = find_entry(report, HOST1, 1);
+	SPDK_CU_ASSERT_FATAL(entry != NULL);
+	CU_ASSERT(entry->stat.read_ios == 3);
+	nvmf_telemetry_report_free(report);
+
+	report = collect(NULL, 0, true);
+	SPDK_CU_ASSERT_FATAL(report != NULL);
+	entry = find_entry(report, HOST1, 1);
+	SPDK_CU_ASSERT_FATAL(entry != NULL);
+	CU_ASSERT(entry->stat.read_ios == 0);
+	nvmf_telemetry_report_free(report);
+
+	/* Statistics that were dropped and collected again are reported as they are */
+	spdk_uuid_generate(&get_sgroup(0)->ns_info[0].uuid);
+	spdk_uuid_generate(&get_sgroup(1)->ns_info[0].uuid);
+	update_poll_groups();
+	complete_io(0, 0, 1, SPDK_NVME_OPC_WRITE, 4096, 10, false);
+	report = collect(NULL, 0, true);
+	SPDK_CU_ASSERT_FATAL(report != NULL);
+	entry = find_entry(report, HOST1, 1);
+	SPDK_CU_ASSERT_FATAL(entry != NULL);
+	CU_ASSERT(entry->stat.read_ios == 0);
+	CU_ASSERT(entry->stat.write_ios == 1);
+	nvmf_telemetry_report_free(report);
+
+	cleanup();
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite suite = NULL;
+	unsigned int num_failures;
+
+	CU_initialize_registry();
+
+	suite = CU_add_suite("nvmf_telemetry", NULL, NULL);
+
+	CU_ADD_TEST(suite, test_nvmf_telemetry_enable);
+	CU_ADD_TEST(suite, test_nvmf_telemetry_collect);
+	CU_ADD_TEST(suite, test_nvmf_telemetry_delta);
+
+	num_failures = spdk_ut_run_tests(argc, argv, NULL);
+	CU_cleanup_registry();
+
+	return num_failures;
+}
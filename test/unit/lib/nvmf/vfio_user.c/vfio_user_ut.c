@@ -4,7 +4,7 @@
 
 #include "spdk/stdinc.h"
 #include "spdk_internal/cunit.h"
-#include "common/lib/test_env.c"
+#include "common/lib/ut_multithread.c"
 #include "nvmf/vfio_user.c"
 #include "nvmf/transport.c"
 
@@ -247,6 +247,100 @@ test_nvmf_vfio_user_create_destroy(void)
 	CU_ASSERT(done == 1);
 }
 
+static void
+test_nvmf_vfio_user_intr_coalescing(void)
+{
+	struct nvmf_vfio_user_transport vu_transport = {};
+	struct nvmf_vfio_user_endpoint endpoint = {};
+	struct nvmf_vfio_user_poll_group vu_group = {};
+	struct nvmf_vfio_user_ctrlr ctrlr = {};
+	struct nvmf_vfio_user_cq admin_cq = {};
+	struct nvmf_vfio_user_cq cq = {};
+	struct nvmf_vfio_user_sq sq = {};
+	struct spdk_nvme_cmd cmd = {};
+
+	allocate_threads(1);
+	set_thread(0);
+
+	ctrlr.transport = &vu_transport;
+	ctrlr.endpoint = &endpoint;
+	ctrlr.state = VFIO_USER_CTRLR_RUNNING;
+	ctrlr.cqs[0] = &admin_cq;
+	ctrlr.cqs[1] = &cq;
+	cq.qid = 1;
+	cq.iv = 1;
+	cq.group = &vu_group.group;
+	sq.qid = 1;
+	sq.cqid = 1;
+	sq.ctrlr = &ctrlr;
+	TAILQ_INIT(&vu_group.sqs);
+	TAILQ_INSERT_TAIL(&vu_group.sqs, &sq, link);
+
+	/* Coalescing is off until the host sets it */
+	CU_ASSERT(!cq_coalesce_irq(&ctrlr, &cq));
+
+	/* The feature can't be saved */
+	cmd.opc = SPDK_NVME_OPC_SET_FEATURES;
+	cmd.cdw10_bits.set_features.fid = SPDK_NVME_FEAT_INTERRUPT_COALESCING;
+	cmd.cdw10_bits.set_features.sv = 1;
+	cmd.cdw11_bits.feat_interrupt_coalescing.bits.thr = 2;
+	cmd.cdw11_bits.feat_interrupt_coalescing.bits.time = 10;
+	CU_ASSERT(is_intr_feature(cmd.cdw10_bits.set_features.fid));
+	CU_ASSERT(handle_intr_feature(&ctrlr, &cmd) == 0);
+	CU_ASSERT(ctrlr.intr_coalescing.raw == 0);
+
+	/* Fire an IRQ every 3 completions */
+	cmd.cdw10_bits.set_features.sv = 0;
+	CU_ASSERT(handle_intr_feature(&ctrlr, &cmd) == 0);
+	CU_ASSERT(ctrlr.intr_coalescing.bits.thr == 2);
+	CU_ASSERT(ctrlr.intr_coalescing.bits.time == 10);
+	CU_ASSERT(ctrlr.intr_coalescing_ticks == 1000 * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC);
+
+	CU_ASSERT(cq_coalesce_irq(&ctrlr, &cq));
+	CU_ASSERT(vu_group.coalesce_poller != NULL);
+	CU_ASSERT(cq_coalesce_irq(&ctrlr, &cq));
+	CU_ASSERT(cq.coalesced_cpls == 2);
+	CU_ASSERT(!cq_coalesce_irq(&ctrlr, &cq));
+	CU_ASSERT(cq.coalesced_cpls == 0);
+	CU_ASSERT(vu_group.stats.coalesced_irqs == 2);
+
+	/* The poller fires the IRQs once the aggregation time expires */
+	CU_ASSERT(cq_coalesce_irq(&ctrlr, &cq));
+	CU_ASSERT(vfio_user_poll_group_coalesce(&vu_group) == SPDK_POLLER_IDLE);
+	CU_ASSERT(cq.coalesced_cpls == 1);
+	CU_ASSERT(vu_group.coalesce_poller != NULL);
+	cq.coalesce_deadline = 0;
+	CU_ASSERT(vfio_user_poll_group_coalesce(&vu_group) == SPDK_POLLER_BUSY);
+	CU_ASSERT(cq.coalesced_cpls == 0);
+	CU_ASSERT(vu_group.stats.coalesce_timeouts == 1);
+	CU_ASSERT(vu_group.coalesce_poller == NULL);
+
+	/* Coalescing can be disabled per vector, but never enabled for the admin CQ's one */
+	cmd.cdw10_bits.set_features.fid = SPDK_NVME_FEAT_INTERRUPT_VECTOR_CONFIGURATION;
+	cmd.cdw11 = 0;
+	cmd.cdw11_bits.feat_interrupt_vector_configuration.bits.iv = 1;
+	cmd.cdw11_bits.feat_interrupt_vector_configuration.bits.cd = 1;
+	CU_ASSERT(handle_intr_feature(&ctrlr, &cmd) == 0);
+	CU_ASSERT(!cq_coalesce_irq(&ctrlr, &cq));
+
+	cmd.cdw11_bits.feat_interrupt_vector_configuration.bits.cd = 0;
+	CU_ASSERT(handle_intr_feature(&ctrlr, &cmd) == 0);
+	CU_ASSERT(cq_coalesce_irq(&ctrlr, &cq));
+	cq.coalesced_cpls = 0;
+
+	cmd.cdw11_bits.feat_interrupt_vector_configuration.bits.iv = 0;
+	cmd.cdw11_bits.feat_interrupt_vector_configuration.bits.cd = 1;
+	CU_ASSERT(handle_intr_feature(&ctrlr, &cmd) == 0);
+	CU_ASSERT(ctrlr.intr_coalescing_disabled[0] == 1);
+	cmd.cdw11_bits.feat_interrupt_vector_configuration.bits.cd = 0;
+	CU_ASSERT(handle_intr_feature(&ctrlr, &cmd) == 0);
+	CU_ASSERT(ctrlr.intr_coalescing_disabled[0] == 1);
+
+	spdk_poller_unregister(&vu_group.coalesce_poller);
+	poll_threads();
+	free_threads();
+}
+
 int
 main(int argc, char **argv)
 {
@@ -260,6 +354,7 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_nvme_cmd_map_prps);
 	CU_ADD_TEST(suite, test_nvme_cmd_map_sgls);
 	CU_ADD_TEST(suite, test_nvmf_vfio_user_create_destroy);
+	CU_ADD_TEST(suite, test_nvmf_vfio_user_intr_coalescing);
 
 	num_failures = spdk_ut_run_tests(argc, argv, NULL);
 	CU_cleanup_registry();
@@ -136,6 +136,52 @@ flush(void)
 	free(req2);
 }
 
+static void
+ktls_ctrl_record(void)
+{
+#ifdef SPDK_KTLS
+	struct spdk_posix_sock psock = {};
+	uint8_t buf1[1], buf2[8] = {};
+	struct iovec iov[2];
+
+	iov[0].iov_base = buf1;
+	iov[0].iov_len = sizeof(buf1);
+	iov[1].iov_base = buf2;
+	iov[1].iov_len = sizeof(buf2);
+
+	/* Session tickets are skipped, other post-handshake messages aren't supported */
+	buf1[0] = SSL3_MT_NEWSESSION_TICKET;
+	CU_ASSERT(posix_sock_ktls_ctrl_record(&psock, TLS_RECORD_TYPE_HANDSHAKE, iov, 2, 9) == 0);
+	buf1[0] = SSL3_MT_KEY_UPDATE;
+	CU_ASSERT(posix_sock_ktls_ctrl_record(&psock, TLS_RECORD_TYPE_HANDSHAKE, iov, 2, 9) == -ENOTCONN);
+
+	/* An empty record doesn't look at the buffer */
+	buf1[0] = SSL3_MT_NEWSESSION_TICKET;
+	CU_ASSERT(posix_sock_ktls_ctrl_record(&psock, TLS_RECORD_TYPE_HANDSHAKE, iov, 2, 0) == -ENOTCONN);
+
+	/* The level and description of an alert may be in different iovs */
+	buf1[0] = SSL3_AL_WARNING;
+	buf2[0] = SSL_AD_CLOSE_NOTIFY;
+	CU_ASSERT(posix_sock_ktls_ctrl_record(&psock, TLS_RECORD_TYPE_ALERT, iov, 2, 2) == -ESHUTDOWN);
+
+	/* A truncated alert isn't taken as close_notify */
+	CU_ASSERT(posix_sock_ktls_ctrl_record(&psock, TLS_RECORD_TYPE_ALERT, iov, 2, 1) == -ENOTCONN);
+
+	/* The first iov can be empty */
+	iov[0].iov_len = 0;
+	buf2[0] = SSL3_AL_WARNING;
+	buf2[1] = SSL_AD_CLOSE_NOTIFY;
+	CU_ASSERT(posix_sock_ktls_ctrl_record(&psock, TLS_RECORD_TYPE_ALERT, iov, 2, 2) == -ESHUTDOWN);
+
+	buf2[0] = SSL3_AL_FATAL;
+	buf2[1] = SSL_AD_BAD_RECORD_MAC;
+	CU_ASSERT(posix_sock_ktls_ctrl_record(&psock, TLS_RECORD_TYPE_ALERT, iov, 2, 2) == -ENOTCONN);
+
+	/* Anything else closes the connection */
+	CU_ASSERT(posix_sock_ktls_ctrl_record(&psock, 0, iov, 2, 2) == -ENOTCONN);
+#endif
+}
+
 int
 main(int argc, char **argv)
 {
@@ -147,6 +193,7 @@ main(int argc, char **argv)
 	suite = CU_add_suite("posix", NULL, NULL);
 
 	CU_ADD_TEST(suite, flush);
+	CU_ADD_TEST(suite, ktls_ctrl_record);
 
 
 	num_failures = spdk_ut_run_tests(argc, argv, NULL);
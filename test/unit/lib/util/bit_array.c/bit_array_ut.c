@@ -317,6 +317,42 @@ test_mask_clear(void)
 	spdk_bit_array_free(&ba);
 }
 
+static void
+test_pool_range(void)
+{
+	struct spdk_bit_pool *pool;
+	uint32_t i;
+
+	pool = spdk_bit_pool_create(200);
+	SPDK_CU_ASSERT_FATAL(pool != NULL);
+
+	/* Allocate 0-9, 70 and 150 */
+	for (i = 0; i < 10; i++) {
+		CU_ASSERT(spdk_bit_pool_allocate_bit(pool) == i);
+	}
+	CU_ASSERT(spdk_bit_pool_allocate_bit_at(pool, 70) == true);
+	CU_ASSERT(spdk_bit_pool_allocate_bit_at(pool, 150) == true);
+	CU_ASSERT(spdk_bit_pool_allocate_bit_at(pool, 150) == false);
+	CU_ASSERT(spdk_bit_pool_allocate_bit_at(pool, 200) == false);
+	CU_ASSERT(spdk_bit_pool_count_free(pool) == 188);
+
+	CU_ASSERT(spdk_bit_pool_find_free_range(pool, 0, 1) == 10);
+	CU_ASSERT(spdk_bit_pool_find_free_range(pool, 0, 60) == 10);
+	CU_ASSERT(spdk_bit_pool_find_free_range(pool, 0, 61) == 71);
+	CU_ASSERT(spdk_bit_pool_find_free_range(pool, 65, 10) == 71);
+	CU_ASSERT(spdk_bit_pool_find_free_range(pool, 100, 49) == 100);
+	CU_ASSERT(spdk_bit_pool_find_free_range(pool, 100, 51) == UINT32_MAX);
+	CU_ASSERT(spdk_bit_pool_find_free_range(pool, 151, 49) == 151);
+	CU_ASSERT(spdk_bit_pool_find_free_range(pool, 0, 80) == UINT32_MAX);
+	CU_ASSERT(spdk_bit_pool_find_free_range(pool, 0, 0) == UINT32_MAX);
+
+	/* Allocating the lowest free bit moves the pool's allocation cursor */
+	CU_ASSERT(spdk_bit_pool_allocate_bit_at(pool, 10) == true);
+	CU_ASSERT(spdk_bit_pool_allocate_bit(pool) == 11);
+
+	spdk_bit_pool_free(&pool);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -335,6 +371,7 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_count);
 	CU_ADD_TEST(suite, test_mask_store_load);
 	CU_ADD_TEST(suite, test_mask_clear);
+	CU_ADD_TEST(suite, test_pool_range);
 
 
 	num_failures = spdk_ut_run_tests(argc, argv, NULL);
@@ -111,6 +111,9 @@ function unittest_nvmf() {
 	$valgrind $testdir/lib/nvmf/subsystem.c/subsystem_ut
 	$valgrind $testdir/lib/nvmf/tcp.c/tcp_ut
 	$valgrind $testdir/lib/nvmf/nvmf.c/nvmf_ut
+	$valgrind $testdir/lib/nvmf/ns_cache.c/ns_cache_ut
+	$valgrind $testdir/lib/nvmf/qos.c/qos_ut
+	$valgrind $testdir/lib/nvmf/telemetry.c/telemetry_ut
 }
 
 function unittest_scsi() {